@@ -0,0 +1,78 @@
+/**
+ * @file calibrator.h
+ * @brief 相机标定参数上下文头文件
+ * @date 2026-10-14
+ *
+ * 标定参数只在首次使用或标定文件修改时间变化时加载一次，
+ * 并按图像尺寸预先计算 int16 定点畸变校正映射表，之后每帧只做一次 remap。
+ */
+
+#ifndef CALIBRATOR_H
+#define CALIBRATOR_H
+
+#include <string>
+#include <opencv2/core.hpp>
+
+/**
+ * @brief 标定参数上下文（不透明类型）
+ */
+typedef struct calib_context calib_context_t;
+
+/**
+ * @brief 创建标定参数上下文
+ *
+ * 只记录文件路径，不立即读取文件。
+ *
+ * @param calib_file 标定参数文件路径（OpenCV FileStorage 格式，包含 camera_matrix 和 dist_coeffs）
+ * @return calib_context_t* 上下文指针，内存不足返回 NULL
+ */
+calib_context_t *calib_context_create(const std::string& calib_file);
+
+/**
+ * @brief 销毁标定参数上下文
+ *
+ * @param ctx 上下文指针
+ */
+void calib_context_destroy(calib_context_t *ctx);
+
+/**
+ * @brief 检查标定文件并在修改时间变化时重新加载
+ *
+ * 只做一次 stat；文件未变化时直接返回缓存的结果。
+ * 参数重新加载后已计算的映射表失效，下一次校正时按新参数重建。
+ *
+ * @param ctx 上下文指针
+ * @return bool 标定参数是否可用
+ */
+bool calib_context_refresh(calib_context_t *ctx);
+
+/**
+ * @brief 对图像进行畸变校正
+ *
+ * 首次遇到某个图像尺寸（或参数更新后）调用 initUndistortRectifyMap 生成
+ * CV_16SC2 + CV_16UC1 定点映射表，之后复用映射表执行双线性 remap。
+ *
+ * @param ctx 上下文指针
+ * @param src 输入图像
+ * @param dst 输出图像（不能与 src 相同）
+ * @return bool 成功返回 true；标定参数不可用时返回 false，dst 不变
+ */
+bool calib_context_undistort(calib_context_t *ctx, const cv::Mat& src, cv::Mat& dst);
+
+/**
+ * @brief 只校正输出图像的部分行
+ *
+ * 映射表仍按整幅图像尺寸生成，只对 [row_begin, row_end) 行执行 remap，
+ * 用于只关心测量线附近条带的场景。
+ *
+ * @param ctx 上下文指针
+ * @param src 输入图像（整幅）
+ * @param dst 输出图像，行数为 row_end - row_begin
+ * @param row_begin 起始行（含）
+ * @param row_end 结束行（不含）
+ * @return bool 成功返回 true；标定参数不可用或行范围无效时返回 false
+ */
+bool calib_context_undistort_rows(calib_context_t *ctx, const cv::Mat& src, cv::Mat& dst,
+                                  int row_begin, int row_end);
+
+#endif // CALIBRATOR_H
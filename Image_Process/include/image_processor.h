@@ -4,27 +4,19 @@
  * @author TraeAI
  * @date 2026-01-22
  * 
- * 本头文件定义了图像处理算法的接口和数据结构，
- * 适用于海思CV610 Linux芯片平台。
+ * 本头文件定义了图像处理算法的 C++ 接口，
+ * 适用于海思CV610 Linux芯片平台。段落、像素格式和测量条带等类型
+ * 定义在 imageproc.h 中，与 C 接口共用。
  */
 
 #ifndef IMAGE_PROCESSOR_H
 #define IMAGE_PROCESSOR_H
 
+#include <stdint.h>
 #include <string>
 #include <vector>
-
-/**
- * @brief 段落宽度结构体定义
- * 
- * 用于存储检测到的段落的位置和尺寸信息
- */
-typedef struct {
-    int start_x;   ///< 段落起始x坐标
-    int end_x;     ///< 段落结束x坐标
-    int width_px;  ///< 段落宽度（像素）
-    float width_mm; ///< 段落宽度（毫米）
-} paragraph_t;
+#include <opencv2/core.hpp>
+#include "imageproc.h"
 
 /**
  * @brief 图像处理配置结构体
@@ -36,11 +28,71 @@ typedef struct {
     std::string output_dir;    ///< 输出结果目录
     bool use_calibration;      ///< 是否使用标定参数
     int max_images;            ///< 最大处理图像数量（0表示无限制）
+    int worker_count;          ///< 批处理工作线程数（0表示使用CPU核数）
 } image_processor_config_t;
 
+/**
+ * @brief 文件夹批处理汇总报告文件名（位于输出目录下）
+ */
+#define IMAGE_BATCH_REPORT_NAME "batch_measurements.txt"
+
+/**
+ * @brief 设置测量条带与测量线
+ * 
+ * 默认整帧处理，单条测量线位于图像中间（0.5）。
+ * 
+ * @param config 测量配置
+ * @return int 成功返回0，参数无效返回-1
+ */
+int image_processor_set_measure_config(const image_measure_config_t& config);
+
+/**
+ * @brief 设置调试中间图输出
+ * 
+ * 默认不输出中间图（生产模式），测量热路径上没有文件写入。
+ * 开启后每 sample_interval 帧保存一次模糊图、二值图和去噪二值图。
+ * 
+ * @param sample_interval 采样间隔：0 关闭，1 每帧输出，N 每 N 帧输出一次
+ * @param debug_dir 中间图输出目录，为空时使用 image_processor_process_image 的输出目录
+ */
+void image_processor_set_debug_output(int sample_interval, const std::string& debug_dir = "");
+
+/**
+ * @brief 测量内存中的图像
+ * 
+ * 各处理阶段复用线程内预分配的缓冲区，除调试采样外不产生任何文件 I/O。
+ * 
+ * @param image 输入图像，8位灰度或 BGR 三通道
+ * @param use_calibration 是否使用标定参数
+ * @param debug_name 调试中间图文件名前缀，为 NULL 时按帧序号命名
+ * @return std::vector<paragraph_t> 检测到的段落，输入无效或未检测到段落时为空
+ */
+std::vector<paragraph_t> image_processor_measure(const cv::Mat& image,
+                                                 bool use_calibration = false,
+                                                 const char *debug_name = NULL);
+
+/**
+ * @brief 测量原始像素缓冲区（例如 VPSS 输出帧）
+ * 
+ * 直接包装调用方的 Y 平面，不拷贝输入数据。
+ * 
+ * @param data 像素数据（NV12 时指向 Y 平面起始）
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param stride 行跨度（字节），0 表示等于宽度
+ * @param format 像素格式
+ * @param use_calibration 是否使用标定参数
+ * @return std::vector<paragraph_t> 检测到的段落
+ */
+std::vector<paragraph_t> image_processor_measure_raw(const uint8_t *data, int width, int height,
+                                                     int stride, image_pixel_format_t format,
+                                                     bool use_calibration = false);
+
 /**
  * @brief 处理单张图像
  * 
+ * 读取图像文件，测量后把结果写入 <output_dir>/<文件名>_measurements.txt。
+ * 
  * @param input_path 输入图像文件路径
  * @param output_dir 输出结果目录
  * @param use_calibration 是否使用标定参数
@@ -53,6 +105,9 @@ int image_processor_process_image(const std::string& input_path,
 /**
  * @brief 处理指定文件夹中的所有图像
  * 
+ * 多线程并行读取和处理，结果汇总到一份报告（IMAGE_BATCH_REPORT_NAME），
+ * 不再为每张图像单独生成 _measurements.txt。
+ * 
  * @param config 图像处理配置
  * @return int 处理结果，0表示成功，非0表示失败
  */
@@ -0,0 +1,204 @@
+/**
+ * @file imageproc.h
+ * @brief libimageproc C 接口头文件
+ * @date 2026-10-14
+ *
+ * libimageproc 是段落宽度测量算法的唯一实现，Image_Process 命令行工具和
+ * UART 进程都链接同一个静态库：
+ * 1. **上下文句柄**：测量结果保存在 imageproc_t 中，不再使用全局段落数组，
+ *    不同上下文可以在不同线程并行使用，同一上下文内部加锁
+ * 2. **可选内核**：模糊、二值化和开运算在编译时选择实现
+ *    （IMAGEPROC_KERNEL=opencv / neon / ive），见 imageproc_backend_name()
+ * 3. **C 兼容**：本头文件中的类型同时被 C++ 接口 image_processor.h 使用
+ */
+
+#ifndef IMAGEPROC_H
+#define IMAGEPROC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 段落宽度结构体定义
+ *
+ * 用于存储检测到的段落的位置和尺寸信息
+ */
+typedef struct {
+    int start_x;   ///< 段落起始x坐标
+    int end_x;     ///< 段落结束x坐标
+    int width_px;  ///< 段落宽度（像素）
+    float width_mm; ///< 段落宽度（毫米）
+} paragraph_t;
+
+/**
+ * @brief 原始像素格式
+ *
+ * 测量只使用亮度，NV12 直接取 Y 平面，不做颜色转换
+ */
+typedef enum {
+    IMAGE_PIXEL_GRAY8 = 0,  ///< 8位灰度
+    IMAGE_PIXEL_NV12,       ///< YUV420SP（Y 平面 + UV 交错平面）
+} image_pixel_format_t;
+
+/**
+ * @brief 最大测量线数量
+ */
+#define IMAGE_MAX_MEASURE_LINES 8
+
+/**
+ * @brief 测量条带配置
+ *
+ * 测量只读取少数几行像素，条带模式下模糊、二值化和开运算只在每条测量线
+ * 上下 band_half_height 行的条带内进行，OTSU 阈值也只由条带统计。
+ * 多条测量线时取段落数一致的测量线求平均，提高对噪点的鲁棒性。
+ */
+typedef struct {
+    int band_half_height;                     ///< 条带半高（行），0 表示处理整帧
+    int line_count;                           ///< 测量线数量（1 ~ IMAGE_MAX_MEASURE_LINES）
+    float line_pos[IMAGE_MAX_MEASURE_LINES];  ///< 测量线位置，占图像高度的比例（0.0 ~ 1.0）
+} image_measure_config_t;
+
+/**
+ * @brief 图像处理上下文（不透明类型）
+ */
+typedef struct imageproc imageproc_t;
+
+/**
+ * @brief 上下文选项
+ */
+typedef struct {
+    int use_calibration;              ///< 是否使用标定参数进行畸变校正
+    image_measure_config_t measure;   ///< 测量条带与测量线
+    int debug_interval;               ///< 调试中间图采样间隔，0 表示不输出
+    const char *debug_dir;            ///< 调试中间图输出目录，NULL 表示使用结果输出目录
+} imageproc_options_t;
+
+/**
+ * @brief 填充默认选项
+ *
+ * 不使用标定、整帧处理、单条测量线位于图像中间、不输出调试中间图。
+ *
+ * @param opts 选项指针
+ */
+void imageproc_default_options(imageproc_options_t *opts);
+
+/**
+ * @brief 创建图像处理上下文
+ *
+ * @param opts 选项，NULL 表示默认选项（内容被拷贝，调用后可释放）
+ * @return imageproc_t* 上下文指针，参数无效或内存不足返回 NULL
+ */
+imageproc_t *imageproc_create(const imageproc_options_t *opts);
+
+/**
+ * @brief 销毁图像处理上下文
+ *
+ * @param ctx 上下文指针
+ */
+void imageproc_destroy(imageproc_t *ctx);
+
+/**
+ * @brief 处理图像文件
+ *
+ * @param ctx 上下文指针
+ * @param input_path 输入图像文件路径
+ * @param output_dir 测量结果输出目录（写入 <文件名>_measurements.txt），NULL 表示不写文件
+ * @return int 成功返回0，失败返回-1
+ */
+int imageproc_process_file(imageproc_t *ctx, const char *input_path, const char *output_dir);
+
+/**
+ * @brief 测量内存中的原始图像
+ *
+ * @param ctx 上下文指针
+ * @param data 像素数据（NV12 时指向 Y 平面起始）
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param stride 行跨度（字节），0 表示等于宽度
+ * @param format 像素格式
+ * @return int 成功返回0，参数无效返回-1
+ */
+int imageproc_measure(imageproc_t *ctx, const uint8_t *data, int width, int height,
+                      int stride, image_pixel_format_t format);
+
+/**
+ * @brief 物理内存中的视频帧
+ *
+ * 例如 VPSS 输出的 VB 块：phys_addr 为 Y 平面物理地址，virt_addr 为
+ * ss_mpi_sys_mmap 得到的用户态映射。ive 内核直接读取物理地址，不经过 JPEG 编解码，
+ * 也不拷贝像素；其他内核只读取 virt_addr。
+ */
+typedef struct {
+    uint64_t phys_addr;          ///< Y 平面物理地址，0 表示未知
+    const uint8_t *virt_addr;    ///< Y 平面虚拟地址
+    int width;                   ///< 图像宽度
+    int height;                  ///< 图像高度
+    int stride;                  ///< 行跨度（字节），0 表示等于宽度
+    image_pixel_format_t format; ///< 像素格式
+} imageproc_frame_t;
+
+/**
+ * @brief 测量物理内存中的视频帧
+ *
+ * 帧尺寸不超过 640×480 且不使用标定时，整条流水线不拷贝输入像素；
+ * 建议把 VPSS 通道输出直接配置为测量分辨率，由 VPSS 硬件完成缩放。
+ *
+ * @param ctx 上下文指针
+ * @param frame 视频帧，调用返回前必须保持有效
+ * @return int 成功返回0，参数无效返回-1
+ */
+int imageproc_measure_frame(imageproc_t *ctx, const imageproc_frame_t *frame);
+
+/**
+ * @brief 获取最近一次处理检测到的段落数量
+ *
+ * @param ctx 上下文指针
+ * @return int 段落数量
+ */
+int imageproc_get_paragraph_count(imageproc_t *ctx);
+
+/**
+ * @brief 获取最近一次处理的指定段落
+ *
+ * @param ctx 上下文指针
+ * @param index 段落索引
+ * @param paragraph 输出段落信息
+ * @return int 0表示成功，非0表示失败
+ */
+int imageproc_get_paragraph(imageproc_t *ctx, int index, paragraph_t *paragraph);
+
+/**
+ * @brief 单次处理的耗时
+ *
+ * 用于端到端延迟跟踪区分解码和测量两个阶段。
+ */
+typedef struct {
+    uint32_t decode_us;   ///< 读取并解码图像文件（内存输入为 0）
+    uint32_t measure_us;  ///< 测量流水线
+} imageproc_timing_t;
+
+/**
+ * @brief 获取最近一次处理的耗时
+ *
+ * @param ctx 上下文指针
+ * @param timing 输出耗时
+ * @return int 0表示成功，非0表示失败
+ */
+int imageproc_get_timing(imageproc_t *ctx, imageproc_timing_t *timing);
+
+/**
+ * @brief 获取编译时选择的内核实现名称
+ *
+ * @return const char* 例如 "opencv"、"neon"、"ive"
+ */
+const char *imageproc_backend_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMAGEPROC_H
@@ -0,0 +1,79 @@
+/**
+ * @file imageproc_kernel.h
+ * @brief libimageproc 内核接口（库内部使用）
+ * @date 2026-10-14
+ *
+ * 测量流水线中计算量最大的三步（5×5 高斯模糊、OTSU 二值化、3×3 开运算）
+ * 由内核实现，编译时通过 IMAGEPROC_KERNEL 选择其中一个实现文件参与链接：
+ * - kernel_opencv.cpp：OpenCV imgproc
+ * - kernel_neon.cpp：手写整数实现，ARM 上使用 NEON 指令，其他平台为等价的标量代码
+ * - kernel_ive.cpp：海思 IVE 硬件加速，IVE 不可用或尺寸不支持时回退到 OpenCV
+ *
+ * kernel_common.cpp 提供各内核共用的 OTSU 阈值计算，始终参与链接。
+ */
+
+#ifndef IMAGEPROC_KERNEL_H
+#define IMAGEPROC_KERNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <opencv2/core.hpp>
+
+/**
+ * @brief 内核私有状态（不透明类型，由内核实现定义）
+ */
+typedef struct imageproc_kernel_state imageproc_kernel_state_t;
+
+/**
+ * @brief 二值化内核的中间结果
+ */
+typedef struct {
+    cv::Mat blur;       ///< 高斯模糊结果
+    cv::Mat binary;     ///< 二值化结果
+    cv::Mat denoised;   ///< 开运算结果
+    cv::Mat scratch;    ///< 内核内部使用的临时缓冲区（16位）
+    cv::Mat scratch8;   ///< 内核内部使用的临时缓冲区（8位）
+    imageproc_kernel_state_t *state; ///< 内核私有状态（如 IVE 的 MMZ 缓冲区），不使用时为 NULL
+} imageproc_kernel_buffers_t;
+
+/**
+ * @brief 模糊、二值化、开运算
+ *
+ * 结果写入 bufs 中预分配的缓冲区，尺寸不变时不重新分配内存。
+ *
+ * @param src 8位灰度输入（整帧或条带，可以是子矩阵）
+ * @param src_phys_addr src 首像素的物理地址（位于 MMZ/VB 中时），0 表示未知；
+ *                      只有 IVE 内核使用，用于省去输入拷贝
+ * @param bufs 输出缓冲区
+ */
+void imageproc_kernel_binarize(const cv::Mat& src, uint64_t src_phys_addr,
+                               imageproc_kernel_buffers_t& bufs);
+
+/**
+ * @brief 释放内核私有状态
+ *
+ * 流水线缓冲区销毁时调用，之后 bufs 中的图像不再有效。
+ *
+ * @param bufs 输出缓冲区
+ */
+void imageproc_kernel_release(imageproc_kernel_buffers_t& bufs);
+
+/**
+ * @brief 由直方图计算 OTSU 阈值
+ *
+ * 计算过程与 OpenCV 的实现一致，像素值大于阈值的置 255。
+ *
+ * @param hist 256 级直方图
+ * @param total 像素总数
+ * @return int 阈值
+ */
+int imageproc_kernel_otsu(const uint32_t hist[256], size_t total);
+
+/**
+ * @brief 内核实现名称
+ *
+ * @return const char* 名称
+ */
+const char *imageproc_kernel_name(void);
+
+#endif // IMAGEPROC_KERNEL_H
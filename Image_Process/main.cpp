@@ -39,7 +39,11 @@ static void print_help(const char* prog_name) {
     fprintf(stdout, "  -i, --input <path>      输入图像文件或文件夹路径\n");
     fprintf(stdout, "  -o, --output <dir>      输出结果目录\n");
     fprintf(stdout, "  -u, --use-calib         使用标定参数进行图像校正\n");
-    fprintf(stdout, "  -m, --max <num>         最大处理图像数量（默认：无限制）\n\n");
+    fprintf(stdout, "  -m, --max <num>         最大处理图像数量（默认：无限制）\n");
+    fprintf(stdout, "  -j, --jobs <num>        文件夹批处理工作线程数（默认：CPU核数）\n");
+    fprintf(stdout, "  -d, --debug <N>         每N张图像保存一次中间图（模糊/二值/去噪），默认不保存\n");
+    fprintf(stdout, "  -b, --band <K>          只处理测量线上下K行的条带（默认：处理整帧）\n");
+    fprintf(stdout, "  -l, --lines <list>      测量线位置（图像高度比例，逗号分隔，默认：0.5）\n\n");
     fprintf(stdout, "通用选项:\n");
     fprintf(stdout, "  -h, --help              显示此帮助信息\n");
     fprintf(stdout, "\n示例:\n");
@@ -47,6 +51,12 @@ static void print_help(const char* prog_name) {
     fprintf(stdout, "  %s -i input.jpg -o output -u\n\n", prog_name);
     fprintf(stdout, "  # 处理文件夹中的图像\n");
     fprintf(stdout, "  %s -i input_dir -o output -u -m 10\n\n", prog_name);
+    fprintf(stdout, "  # 使用4个线程批处理文件夹\n");
+    fprintf(stdout, "  %s -i input_dir -o output -j 4\n\n", prog_name);
+    fprintf(stdout, "  # 每10张图像保存一次中间图用于调试\n");
+    fprintf(stdout, "  %s -i input_dir -o output -d 10\n\n", prog_name);
+    fprintf(stdout, "  # 只处理三条测量线附近±8行的条带\n");
+    fprintf(stdout, "  %s -i input.jpg -o output -b 8 -l 0.4,0.5,0.6\n\n", prog_name);
 }
 
 /**
@@ -60,6 +70,34 @@ static bool path_exists(const string& path) {
     return (stat(path.c_str(), &st) == 0);
 }
 
+/**
+ * @brief 解析测量线位置列表
+ * 
+ * @param arg 逗号分隔的比例列表，例如 "0.4,0.5,0.6"
+ * @param config 输出测量配置
+ * @return bool 解析成功返回true
+ */
+static bool parse_measure_lines(const char* arg, image_measure_config_t* config) {
+    int count = 0;
+    const char* p = arg;
+    while (*p) {
+        char* end = NULL;
+        float pos = strtof(p, &end);
+        if (end == p || count >= IMAGE_MAX_MEASURE_LINES) {
+            return false;
+        }
+        config->line_pos[count++] = pos;
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return false;
+        }
+    }
+    config->line_count = count;
+    return count > 0;
+}
+
 /**
  * @brief 主程序入口
  * 
@@ -73,6 +111,9 @@ int main(int argc, char* argv[]) {
     string output_dir = "./output";  // 输出结果目录
     bool use_calibration = false;  // 是否使用标定参数
     int max_images = 0;         // 最大处理图像数量（0表示无限制）
+    int worker_count = 0;       // 批处理工作线程数（0表示使用CPU核数）
+    int debug_interval = 0;     // 调试中间图采样间隔（0表示不保存）
+    image_measure_config_t measure_config = { 0, 1, { 0.5f } };  // 测量条带配置
     
     // 长选项结构体
     struct option long_options[] = {
@@ -80,6 +121,10 @@ int main(int argc, char* argv[]) {
         {"output", required_argument, NULL, 'o'},
         {"use-calib", no_argument, NULL, 'u'},
         {"max", required_argument, NULL, 'm'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"debug", required_argument, NULL, 'd'},
+        {"band", required_argument, NULL, 'b'},
+        {"lines", required_argument, NULL, 'l'},
         {"help", no_argument, NULL, 'h'},
         {0, 0, 0, 0}
     };
@@ -87,7 +132,7 @@ int main(int argc, char* argv[]) {
     // 解析命令行参数
     int opt = 0;
     int long_index = 0;
-    while ((opt = getopt_long(argc, argv, "i:o:um:h", long_options, &long_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "i:o:um:j:d:b:l:h", long_options, &long_index)) != -1) {
         switch (opt) {
             case 'i':
                 input_path = optarg;
@@ -101,6 +146,21 @@ int main(int argc, char* argv[]) {
             case 'm':
                 max_images = atoi(optarg);
                 break;
+            case 'j':
+                worker_count = atoi(optarg);
+                break;
+            case 'd':
+                debug_interval = atoi(optarg);
+                break;
+            case 'b':
+                measure_config.band_half_height = atoi(optarg);
+                break;
+            case 'l':
+                if (!parse_measure_lines(optarg, &measure_config)) {
+                    LOGE("测量线位置格式错误: %s", optarg);
+                    return 1;
+                }
+                break;
             case 'h':
                 print_help(argv[0]);
                 return 0;
@@ -111,7 +171,11 @@ int main(int argc, char* argv[]) {
     }
     
     // 图像处理模式
-    LOGI("运行在图像处理模式");
+    LOGI("运行在图像处理模式（内核: %s）", imageproc_backend_name());
+    image_processor_set_debug_output(debug_interval);
+    if (image_processor_set_measure_config(measure_config) != 0) {
+        return 1;
+    }
     
     // 检查输入路径是否存在
     if (input_path.empty()) {
@@ -148,6 +212,7 @@ int main(int argc, char* argv[]) {
         config.output_dir = output_dir;
         config.use_calibration = use_calibration;
         config.max_images = max_images;
+        config.worker_count = worker_count;
         
         int ret = image_processor_process_folder(config);
         if (ret != 0) {
@@ -0,0 +1,142 @@
+/**
+ * @file calibrator.cpp
+ * @brief 相机标定参数上下文实现
+ * @date 2026-10-14
+ *
+ * cv::undistort 每次调用都会重新计算整幅畸变映射，这里把映射表计算
+ * 移到参数或图像尺寸变化时进行。映射表采用 CV_16SC2（整数坐标）+
+ * CV_16UC1（插值表索引）的定点格式，内存只有浮点映射的一半，
+ * remap 走 OpenCV 的定点双线性路径。
+ */
+
+#include "calibrator.h"
+#include <cstdio>
+#include <new>
+#include <sys/stat.h>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+using namespace std;
+using namespace cv;
+
+// 日志宏定义
+#define LOGI(...) fprintf(stdout, "[INFO] " __VA_ARGS__); fprintf(stdout, "\n")
+#define LOGW(...) fprintf(stdout, "[WARN] " __VA_ARGS__); fprintf(stdout, "\n")
+
+/**
+ * @brief 标定参数上下文
+ */
+struct calib_context {
+    string calib_file;     ///< 标定文件路径
+    bool checked;          ///< 是否已检查过文件
+    bool valid;            ///< 标定参数是否可用
+    time_t mtime_sec;      ///< 已加载文件的修改时间（秒）
+    long mtime_nsec;       ///< 已加载文件的修改时间（纳秒）
+    Mat camera_matrix;     ///< 相机内参
+    Mat dist_coeffs;       ///< 畸变系数
+    Size map_size;         ///< 映射表对应的图像尺寸
+    Mat map_xy;            ///< CV_16SC2 整数坐标映射
+    Mat map_frac;          ///< CV_16UC1 插值表索引
+};
+
+calib_context_t *calib_context_create(const string& calib_file) {
+    calib_context_t *ctx = new (std::nothrow) calib_context_t();
+    if (!ctx) {
+        return NULL;
+    }
+    ctx->calib_file = calib_file;
+    return ctx;
+}
+
+void calib_context_destroy(calib_context_t *ctx) {
+    delete ctx;
+}
+
+bool calib_context_refresh(calib_context_t *ctx) {
+    if (!ctx) {
+        return false;
+    }
+
+    struct stat st;
+    if (stat(ctx->calib_file.c_str(), &st) != 0) {
+        if (!ctx->checked || ctx->valid) {
+            LOGW("未找到标定参数文件: %s，使用原始图像", ctx->calib_file.c_str());
+        }
+        ctx->checked = true;
+        ctx->valid = false;
+        ctx->mtime_sec = 0;
+        ctx->mtime_nsec = 0;
+        return false;
+    }
+
+    if (ctx->checked && st.st_mtim.tv_sec == ctx->mtime_sec && st.st_mtim.tv_nsec == ctx->mtime_nsec) {
+        return ctx->valid;
+    }
+    ctx->checked = true;
+    ctx->mtime_sec = st.st_mtim.tv_sec;
+    ctx->mtime_nsec = st.st_mtim.tv_nsec;
+
+    // 参数变化，已有映射表作废
+    ctx->valid = false;
+    ctx->map_size = Size();
+    ctx->map_xy.release();
+    ctx->map_frac.release();
+
+    FileStorage fs(ctx->calib_file, FileStorage::READ);
+    if (!fs.isOpened()) {
+        LOGW("无法打开标定参数文件: %s", ctx->calib_file.c_str());
+        return false;
+    }
+    fs["camera_matrix"] >> ctx->camera_matrix;
+    fs["dist_coeffs"] >> ctx->dist_coeffs;
+    fs.release();
+
+    ctx->valid = !ctx->camera_matrix.empty() && !ctx->dist_coeffs.empty();
+    if (ctx->valid) {
+        LOGI("已加载相机标定参数: %s", ctx->calib_file.c_str());
+    } else {
+        LOGW("标定参数文件缺少 camera_matrix 或 dist_coeffs: %s", ctx->calib_file.c_str());
+    }
+    return ctx->valid;
+}
+
+/**
+ * @brief 确保映射表与图像尺寸一致
+ *
+ * @param ctx 上下文指针
+ * @param size 图像尺寸
+ */
+static void calib_context_prepare_map(calib_context_t *ctx, Size size) {
+    if (ctx->map_size.width == size.width && ctx->map_size.height == size.height) {
+        return;
+    }
+    // 与 cv::undistort 一致：不做旋转校正，新内参等于原内参
+    initUndistortRectifyMap(ctx->camera_matrix, ctx->dist_coeffs, Mat(), ctx->camera_matrix,
+                            size, CV_16SC2, ctx->map_xy, ctx->map_frac);
+    ctx->map_size = size;
+    LOGI("已生成畸变校正映射表: %dx%d", size.width, size.height);
+}
+
+bool calib_context_undistort(calib_context_t *ctx, const Mat& src, Mat& dst) {
+    if (!ctx || src.empty() || !calib_context_refresh(ctx)) {
+        return false;
+    }
+
+    calib_context_prepare_map(ctx, src.size());
+    remap(src, dst, ctx->map_xy, ctx->map_frac, INTER_LINEAR, BORDER_CONSTANT);
+    return true;
+}
+
+bool calib_context_undistort_rows(calib_context_t *ctx, const Mat& src, Mat& dst,
+                                  int row_begin, int row_end) {
+    if (!ctx || src.empty() || row_begin < 0 || row_end > src.rows || row_begin >= row_end ||
+        !calib_context_refresh(ctx)) {
+        return false;
+    }
+
+    calib_context_prepare_map(ctx, src.size());
+    remap(src, dst, ctx->map_xy.rowRange(row_begin, row_end), ctx->map_frac.rowRange(row_begin, row_end),
+          INTER_LINEAR, BORDER_CONSTANT);
+    return true;
+}
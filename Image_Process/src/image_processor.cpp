@@ -9,7 +9,10 @@
  */
 
 #include "image_processor.h"
+#include "calibrator.h"
+#include "imageproc_kernel.h"
 #include <iostream>
+#include <new>
 #include <fstream>
 #include <cstdio>
 #include <cstdlib>
@@ -19,6 +22,12 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <ctime>
+#include <unistd.h>
 
 // OpenCV库头文件
 #include <opencv2/core.hpp>       // 核心功能
@@ -88,162 +97,494 @@ static int ensure_directory_exists(const char *path) {
 }
 
 /**
- * @brief 处理单张图像
+ * @brief 图像处理流水线缓冲区
+ * 
+ * 每个线程一份。cv::Mat::create 在尺寸和类型不变时复用已有内存，
+ * 因此稳定运行后各阶段不再分配内存。
+ */
+typedef struct pipeline_buffers {
+    Mat gray;            ///< 彩色输入转换后的灰度图
+    Mat undistorted;     ///< 畸变校正结果
+    Mat scaled;          ///< 缩放结果
+    imageproc_kernel_buffers_t kbufs; ///< 模糊、二值化、开运算结果
+    calib_context_t *calib; ///< 标定参数与畸变校正映射表缓存
+    unsigned long frame_count; ///< 已处理帧数（用于调试采样）
+    vector<paragraph_t> line_paragraphs[IMAGE_MAX_MEASURE_LINES]; ///< 各测量线的段落
+
+    /// 线程退出时释放标定上下文和内核状态（批处理工作线程每次运行都会新建）
+    ~pipeline_buffers() {
+        calib_context_destroy(calib);
+        imageproc_kernel_release(kbufs);
+    }
+} pipeline_buffers_t;
+
+static thread_local pipeline_buffers_t g_pipeline = {};
+
+/**
+ * @brief 流水线选项
+ */
+typedef struct {
+    image_measure_config_t measure; ///< 测量条带与测量线
+    int debug_interval;             ///< 调试中间图采样间隔，0 表示关闭
+    string debug_dir;               ///< 调试中间图输出目录，为空时使用结果输出目录
+} pipeline_options_t;
+
+/**
+ * @brief C++ 接口使用的选项，默认整帧处理、一条位于图像中间的测量线、不输出调试图
+ */
+static pipeline_options_t g_options = { { 0, 1, { 0.5f } }, 0, string() };
+
+/**
+ * @brief 条带上下额外保留的行数
+ * 
+ * 5×5 高斯核半径 2 + 3×3 开运算半径 1，保证测量线附近的结果与整帧处理一致
+ */
+#define BAND_FILTER_MARGIN 3
+
+/**
+ * @brief 流水线单帧结果
+ */
+typedef struct {
+    int cols;   ///< 处理后图像宽度
+    int rows;   ///< 处理后图像高度
+    int mid_y;  ///< 测量线位置（多条测量线时为第一条）
+    float pixel_to_mm_ratio; ///< 像素到毫米比例
+} pipeline_result_t;
+
+/**
+ * @brief 设置调试中间图输出
+ * 
+ * @param sample_interval 采样间隔：0 关闭，1 每帧输出，N 每 N 帧输出一次
+ * @param debug_dir 中间图输出目录
+ */
+void image_processor_set_debug_output(int sample_interval, const string& debug_dir) {
+    g_options.debug_interval = sample_interval > 0 ? sample_interval : 0;
+    g_options.debug_dir = debug_dir;
+}
+
+/**
+ * @brief 检查测量配置
+ * 
+ * @param config 测量配置
+ * @return bool 配置是否有效
+ */
+static bool measure_config_valid(const image_measure_config_t& config) {
+    if (config.band_half_height < 0 || config.line_count < 1 ||
+        config.line_count > IMAGE_MAX_MEASURE_LINES) {
+        LOGE("测量配置无效: band=%d, lines=%d", config.band_half_height, config.line_count);
+        return false;
+    }
+    for (int i = 0; i < config.line_count; i++) {
+        if (config.line_pos[i] < 0.0f || config.line_pos[i] > 1.0f) {
+            LOGE("测量线位置无效: %.3f", config.line_pos[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 设置测量条带与测量线
+ * 
+ * @param config 测量配置
+ * @return int 成功返回0，参数无效返回-1
+ */
+int image_processor_set_measure_config(const image_measure_config_t& config) {
+    if (!measure_config_valid(config)) {
+        return -1;
+    }
+    g_options.measure = config;
+    return 0;
+}
+
+/**
+ * @brief 保存调试中间图
+ * 
+ * @param dir 输出目录
+ * @param name 文件名前缀
+ * @param suffix 文件名后缀
+ * @param image 图像
+ */
+static void pipeline_write_debug(const string& dir, const char *name, const char *suffix, const Mat& image) {
+    char path[512] = {0};
+    snprintf(path, sizeof(path), "%s/%s_%s.jpg", dir.c_str(), name, suffix);
+    if (!imwrite(path, image)) {
+        LOGE("保存调试图失败: %s", path);
+    }
+}
+
+/**
+ * @brief 查找从 x 开始第一个不等于 value 的像素
+ * 
+ * 每次比较 8 个像素，整段相同时直接跳过。
+ * 
+ * @param row 行像素指针
+ * @param x 起始位置
+ * @param cols 行宽度
+ * @param value 当前连续段的像素值（0 或 255）
+ * @return int 第一个不同像素的位置，整行剩余部分都相同时返回 cols
+ */
+static int find_run_end(const uchar *row, int x, int cols, uchar value) {
+    const uint64_t pattern = 0x0101010101010101ULL * value;
+    while (x + 8 <= cols) {
+        uint64_t word;
+        memcpy(&word, row + x, sizeof(word));
+        uint64_t diff = word ^ pattern;
+        if (diff != 0) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return x + (__builtin_clzll(diff) >> 3);
+#else
+            return x + (__builtin_ctzll(diff) >> 3);
+#endif
+        }
+        x += 8;
+    }
+    while (x < cols && row[x] == value) {
+        x++;
+    }
+    return x;
+}
+
+/**
+ * @brief 在二值图的一行上检测段落
+ * 
+ * 像素值0表示段落（前景），像素值255表示背景；
+ * 按连续段扫描，只在像素值变化处停下。
+ * 
+ * @param row 行像素指针
+ * @param cols 行宽度
+ * @param paragraphs 输出段落列表
+ */
+static void scan_paragraphs(const uchar *row, int cols, vector<paragraph_t>& paragraphs) {
+    paragraphs.clear();
+    int x = 0;
+    while (x < cols) {
+        // 跳过背景，找到段落起点
+        x = find_run_end(row, x, cols, 255);
+        if (x >= cols) {
+            break;
+        }
+        int start_x = x;
+        // 找到段落终点（图像边缘也视为终点）
+        x = find_run_end(row, x, cols, 0);
+
+        // 筛选宽度合适的段落
+        int width_px = x - start_x;
+        if (width_px >= MIN_PARAGRAPH_WIDTH) {
+            paragraph_t paragraph = { start_x, x - 1, width_px, 0.0f };
+            paragraphs.push_back(paragraph);
+        }
+    }
+}
+
+/**
+ * @brief 合并多条测量线的结果
+ * 
+ * 取段落数出现次数最多的那些测量线（相同时优先靠前的测量线），
+ * 对它们的起止坐标取平均，抑制单条扫描线上的噪点和毛刺。
+ * 
+ * @param lines 各测量线的段落
+ * @param line_count 测量线数量
+ * @param paragraphs 输出段落列表
+ */
+static void merge_line_paragraphs(const vector<paragraph_t> *lines, int line_count,
+                                  vector<paragraph_t>& paragraphs) {
+    if (line_count == 1) {
+        paragraphs = lines[0];
+        return;
+    }
+
+    size_t best_count = lines[0].size();
+    int best_votes = 0;
+    for (int i = 0; i < line_count; i++) {
+        int votes = 0;
+        for (int j = 0; j < line_count; j++) {
+            if (lines[j].size() == lines[i].size()) {
+                votes++;
+            }
+        }
+        if (votes > best_votes) {
+            best_votes = votes;
+            best_count = lines[i].size();
+        }
+    }
+
+    paragraphs.assign(best_count, paragraph_t());
+    for (size_t k = 0; k < best_count; k++) {
+        int sum_start = 0;
+        int sum_end = 0;
+        for (int i = 0; i < line_count; i++) {
+            if (lines[i].size() == best_count) {
+                sum_start += lines[i][k].start_x;
+                sum_end += lines[i][k].end_x;
+            }
+        }
+        paragraphs[k].start_x = (sum_start + best_votes / 2) / best_votes;
+        paragraphs[k].end_x = (sum_end + best_votes / 2) / best_votes;
+        paragraphs[k].width_px = paragraphs[k].end_x - paragraphs[k].start_x + 1;
+        paragraphs[k].width_mm = 0.0f;
+    }
+}
+
+/**
+ * @brief 运行图像处理流水线
  * 
- * 实现完整的图像处理流程：读取图像、畸变校正、高斯模糊、二值化、
- * 形态学去噪、段落检测和测量，并保存处理结果。
+ * 畸变校正、缩放、高斯模糊、二值化、形态学去噪和段落测量，
+ * 全部在预分配缓冲区上完成。条带模式下每条测量线只处理其上下
+ * band_half_height 行（再加滤波所需的余量），不处理整帧。
  * 
+ * 模糊、二值化和开运算由编译时选择的内核完成（见 imageproc_kernel.h），
+ * 条带模式下 OTSU 阈值只由条带统计。
+ * 
+ * @param buf 流水线缓冲区（每个线程或每个上下文一份）
+ * @param opts 流水线选项
+ * @param gray 8位灰度输入图像
+ * @param phys_addr gray 首像素的物理地址（VB/MMZ 中的帧），0 表示普通内存
+ * @param use_calibration 是否使用标定参数
+ * @param debug_dir 调试中间图输出目录（opts.debug_dir 为空时使用）
+ * @param debug_name 调试中间图文件名前缀，为 NULL 时按帧序号命名
+ * @param paragraphs 输出段落列表
+ * @param result 输出单帧结果，可为 NULL
+ */
+static void pipeline_run(pipeline_buffers_t& buf, const pipeline_options_t& opts,
+                         const Mat& gray, uint64_t phys_addr, bool use_calibration,
+                         const string& debug_dir,
+                         const char *debug_name, vector<paragraph_t>& paragraphs,
+                         pipeline_result_t *result) {
+    const image_measure_config_t& cfg = opts.measure;
+
+    buf.frame_count++;
+
+    // 标定参数只在文件修改时间变化时重新加载，映射表按图像尺寸缓存
+    bool undistort = false;
+    if (use_calibration) {
+        if (!buf.calib) {
+            buf.calib = calib_context_create(DEFAULT_CALIB_FILE);
+        }
+        undistort = calib_context_refresh(buf.calib);
+    }
+
+    // 仅在图像尺寸超过最大值时进行等比例缩放
+    int out_cols = gray.cols;
+    int out_rows = gray.rows;
+    float scale = 1.0f;
+    if (gray.cols > MAX_IMAGE_WIDTH || gray.rows > MAX_IMAGE_HEIGHT) {
+        scale = min(static_cast<float>(MAX_IMAGE_WIDTH) / gray.cols,
+                    static_cast<float>(MAX_IMAGE_HEIGHT) / gray.rows);
+        out_cols = static_cast<int>(gray.cols * scale);
+        out_rows = static_cast<int>(gray.rows * scale);
+    }
+
+    int first_y = 0;
+    for (int i = 0; i < cfg.line_count; i++) {
+        int y = static_cast<int>(cfg.line_pos[i] * out_rows);
+        y = y >= out_rows ? out_rows - 1 : y;
+
+        // 条带模式：只取测量线附近的行；整帧模式：第一条测量线处理整帧，其余测量线复用结果
+        int dst_begin = 0;
+        int dst_end = out_rows;
+        if (cfg.band_half_height > 0) {
+            int half = cfg.band_half_height + BAND_FILTER_MARGIN;
+            dst_begin = max(0, y - half);
+            dst_end = min(out_rows, y + half + 1);
+        }
+
+        if (cfg.band_half_height > 0 || i == 0) {
+            // 输出行范围换算回输入图像的行范围
+            int src_begin = static_cast<int>(dst_begin / scale);
+            int src_end = min(gray.rows, static_cast<int>(std::ceil(dst_end / scale)));
+            Mat stage = gray.rowRange(src_begin, src_end);
+            // 未经校正和缩放的条带仍位于调用方的物理内存中，IVE 内核可直接读取
+            uint64_t stage_phys = phys_addr ? phys_addr + (uint64_t)src_begin * gray.step : 0;
+
+            if (undistort && calib_context_undistort_rows(buf.calib, gray, buf.undistorted,
+                                                          src_begin, src_end)) {
+                stage = buf.undistorted;
+                stage_phys = 0;
+            }
+            if (scale != 1.0f) {
+                resize(stage, buf.scaled, Size(out_cols, dst_end - dst_begin));
+                stage = buf.scaled;
+                stage_phys = 0;
+            }
+            imageproc_kernel_binarize(stage, stage_phys, buf.kbufs);
+        }
+
+        scan_paragraphs(buf.kbufs.denoised.ptr<uchar>(y - dst_begin), buf.kbufs.denoised.cols, buf.line_paragraphs[i]);
+        if (i == 0) {
+            first_y = y;
+        }
+    }
+
+    // 调试中间图按采样间隔输出（条带模式下为最后一条测量线的条带），生产模式下不写文件
+    if (opts.debug_interval > 0 && (buf.frame_count % (unsigned long)opts.debug_interval) == 0) {
+        const string& dir = opts.debug_dir.empty() ? debug_dir : opts.debug_dir;
+        char frame_name[32] = {0};
+        if (!debug_name) {
+            snprintf(frame_name, sizeof(frame_name), "frame_%06lu", buf.frame_count);
+            debug_name = frame_name;
+        }
+        if (!dir.empty() && ensure_directory_exists(dir.c_str()) == 0) {
+            pipeline_write_debug(dir, debug_name, "blur", buf.kbufs.blur);
+            pipeline_write_debug(dir, debug_name, "binary", buf.kbufs.binary);
+            pipeline_write_debug(dir, debug_name, "binary_denoised", buf.kbufs.denoised);
+        }
+    }
+
+    merge_line_paragraphs(buf.line_paragraphs, cfg.line_count, paragraphs);
+
+    // 计算像素到毫米的转换比例，使用第一个段落作为标准
+    float pixel_to_mm_ratio = 0.0f;
+    if (!paragraphs.empty()) {
+        pixel_to_mm_ratio = SCALE_WIDTH_MM / paragraphs[0].width_px;
+        for (size_t i = 0; i < paragraphs.size(); i++) {
+            paragraphs[i].width_mm = paragraphs[i].width_px * pixel_to_mm_ratio;
+        }
+    }
+
+    if (result) {
+        result->cols = out_cols;
+        result->rows = out_rows;
+        result->mid_y = first_y;
+        result->pixel_to_mm_ratio = pixel_to_mm_ratio;
+    }
+}
+
+/**
+ * @brief 测量内存中的图像（8位灰度或 BGR 三通道）
+ * 
+ * @param buf 流水线缓冲区
+ * @param opts 流水线选项
+ * @param image 输入图像
+ * @param use_calibration 是否使用标定参数
+ * @param debug_name 调试中间图文件名前缀，为 NULL 时按帧序号命名
+ * @param paragraphs 输出段落列表
+ * @return int 成功返回0，输入无效返回-1
+ */
+static int pipeline_measure_mat(pipeline_buffers_t& buf, const pipeline_options_t& opts,
+                                const Mat& image, bool use_calibration, const char *debug_name,
+                                vector<paragraph_t>& paragraphs) {
+    paragraphs.clear();
+    if (image.empty() || image.depth() != CV_8U) {
+        LOGE("输入图像无效");
+        return -1;
+    }
+
+    if (image.channels() == 1) {
+        pipeline_run(buf, opts, image, 0, use_calibration, opts.debug_dir, debug_name, paragraphs, NULL);
+    } else if (image.channels() == 3) {
+        cvtColor(image, buf.gray, COLOR_BGR2GRAY);
+        pipeline_run(buf, opts, buf.gray, 0, use_calibration, opts.debug_dir, debug_name, paragraphs, NULL);
+    } else {
+        LOGE("不支持的图像通道数: %d", image.channels());
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 获取单调时钟（毫秒）
+ */
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+ * @brief 把原始像素缓冲区包装为灰度图
+ * 
+ * GRAY8 与 NV12 的 Y 平面布局相同，直接包装调用方内存，不拷贝。
+ * 
+ * @param data 像素数据（NV12 时指向 Y 平面起始）
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param stride 行跨度（字节），0 表示等于宽度
+ * @param format 像素格式
+ * @param gray 输出灰度图头
+ * @return int 成功返回0，参数无效返回-1
+ */
+static int wrap_raw_gray(const uint8_t *data, int width, int height, int stride,
+                         image_pixel_format_t format, Mat& gray) {
+    if (!data || width <= 0 || height <= 0 || (stride != 0 && stride < width)) {
+        LOGE("原始图像参数无效");
+        return -1;
+    }
+    if (format != IMAGE_PIXEL_GRAY8 && format != IMAGE_PIXEL_NV12) {
+        LOGE("不支持的像素格式: %d", (int)format);
+        return -1;
+    }
+    gray = Mat(height, width, CV_8UC1, const_cast<uint8_t *>(data),
+               stride > 0 ? (size_t)stride : (size_t)width);
+    return 0;
+}
+
+/**
+ * @brief 读取并处理单张图像文件
+ * 
+ * @param buf 流水线缓冲区
+ * @param opts 流水线选项
  * @param input_path 输入图像文件路径
- * @param output_dir 输出结果目录
+ * @param output_dir 测量结果输出目录，为 NULL 时不写结果文件
  * @param use_calibration 是否使用标定参数
+ * @param paragraphs 输出段落列表
+ * @param timing 输出解码与测量耗时，可为 NULL
  * @return int 处理结果，0表示成功，非0表示失败
  */
-int image_processor_process_image(const string& input_path, const string& output_dir, bool use_calibration) {
+static int pipeline_process_file(pipeline_buffers_t& buf, const pipeline_options_t& opts,
+                                 const char *input_path, const char *output_dir,
+                                 bool use_calibration, vector<paragraph_t>& paragraphs,
+                                 imageproc_timing_t *timing = NULL) {
     // 提取文件名（不含扩展名）
-    const char *filename = strrchr(input_path.c_str(), '/');
+    const char *filename = strrchr(input_path, '/');
     char base_filename[128] = {0};
     char output_path[512] = {0};
     
     if (!filename) {
-        filename = input_path.c_str();
+        filename = input_path;
     } else {
         filename++;
     }
     
     // 复制文件名（去掉扩展名）
-    strcpy(base_filename, filename);
+    snprintf(base_filename, sizeof(base_filename), "%s", filename);
     char *ext = strrchr(base_filename, '.');
     if (ext) {
         *ext = '\0';
     }
     
-    LOGI("开始处理图像: %s", input_path.c_str());
+    LOGI("开始处理图像: %s", input_path);
+    paragraphs.clear();
     
     // 确保输出目录存在
-    if (ensure_directory_exists(output_dir.c_str()) != 0) {
+    if (output_dir && ensure_directory_exists(output_dir) != 0) {
         return -1;
     }
     
     // 读取图像时直接转换为灰度图
+    double start = monotonic_ms();
     Mat gray = imread(input_path, IMREAD_GRAYSCALE);
-    if (gray.empty()) {
-        LOGE("无法读取图片: %s", input_path.c_str());
-        return -1;
-    }
-
-    // 如果启用标定功能，进行图像校正
-    if (use_calibration) {
-        // 加载标定参数
-        const char *calib_file = DEFAULT_CALIB_FILE;
-        FileStorage fs(calib_file, FileStorage::READ);
-        if (fs.isOpened()) {
-            Mat camera_matrix, dist_coeffs;
-            fs["camera_matrix"] >> camera_matrix;
-            fs["dist_coeffs"] >> dist_coeffs;
-            fs.release();
-            
-            // 进行图像校正
-            Mat undistorted;
-            cv::undistort(gray, undistorted, camera_matrix, dist_coeffs);
-            gray = undistorted.clone();
-            
-            LOGI("已应用相机标定参数进行图像校正");
-        } else {
-            LOGW("未找到标定参数文件: %s，使用原始图像", calib_file);
-        }
-    }
-
-    // 仅在图像尺寸超过最大值时进行等比例缩放
-    if (gray.cols > MAX_IMAGE_WIDTH || gray.rows > MAX_IMAGE_HEIGHT) {
-        float scale = min(static_cast<float>(MAX_IMAGE_WIDTH) / gray.cols, 
-                         static_cast<float>(MAX_IMAGE_HEIGHT) / gray.rows);
-        int new_width = static_cast<int>(gray.cols * scale);
-        int new_height = static_cast<int>(gray.rows * scale);
-        
-        resize(gray, gray, Size(new_width, new_height));
-        
-        LOGI("已压缩图片尺寸: %dx%d -> %dx%d", 
-            gray.cols, gray.rows, new_width, new_height);
+    double decoded = monotonic_ms();
+    if (timing) {
+        timing->decode_us = (uint32_t)((decoded - start) * 1000.0);
+        timing->measure_us = 0;
     }
-
-    // 高斯模糊：去除图像噪声
-    Mat blur;
-    GaussianBlur(gray, blur, Size(5, 5), 0);
-    snprintf(output_path, sizeof(output_path), "%s/%s_blur.jpg", output_dir.c_str(), base_filename);
-    if (!imwrite(output_path, blur)) {
-        LOGE("保存模糊图失败: %s", output_path);
-        return -1;
-    }
-    gray.release();
-
-    // 普通二值化：使用OTSU自动阈值
-    Mat binary;
-    threshold(blur, binary, 0, 255, THRESH_BINARY | THRESH_OTSU);
-    snprintf(output_path, sizeof(output_path), "%s/%s_binary.jpg", output_dir.c_str(), base_filename);
-    if (!imwrite(output_path, binary)) {
-        LOGE("保存二值图失败: %s", output_path);
+    if (gray.empty()) {
+        LOGE("无法读取图片: %s", input_path);
         return -1;
     }
-    blur.release();
 
-    // 形态学去噪：使用开运算去除小的噪点
-    Mat kernel = getStructuringElement(MORPH_RECT, Size(3, 3));
-    morphologyEx(binary, binary, MORPH_OPEN, kernel);
-    snprintf(output_path, sizeof(output_path), "%s/%s_binary_denoised.jpg", output_dir.c_str(), base_filename);
-    if (!imwrite(output_path, binary)) {
-        LOGE("保存去噪二值图失败: %s", output_path);
-        return -1;
+    pipeline_result_t result;
+    pipeline_run(buf, opts, gray, 0, use_calibration, output_dir ? output_dir : "", base_filename,
+                 paragraphs, &result);
+    if (timing) {
+        timing->measure_us = (uint32_t)((monotonic_ms() - decoded) * 1000.0);
     }
+    LOGI("使用中间线 y = %d 进行测量", result.mid_y);
 
-    // 在二值图中间取一条水平线，通过像素颜色变化检测段落
-    int mid_y = binary.rows / 2;
-    LOGI("使用中间线 y = %d 进行测量", mid_y);
-    
-    // 检测像素颜色变化并测量段落
-    vector<paragraph_t> paragraphs;
-    bool in_segment = false;
-    paragraph_t current_paragraph = {0};
-    float pixel_to_mm_ratio = 0.0f;
-    
-    for (int x = 0; x < binary.cols; x++) {
-        uchar pixel = binary.at<uchar>(mid_y, x);
-        
-        // 像素值0表示背景，像素值255表示前景
-        if (pixel == 0 && !in_segment) {
-            // 开始段落
-            in_segment = true;
-            current_paragraph.start_x = x;
-        } else if (pixel == 255 && in_segment) {
-            // 结束段落
-            in_segment = false;
-            current_paragraph.end_x = x - 1;
-            current_paragraph.width_px = current_paragraph.end_x - current_paragraph.start_x + 1;
-            
-            // 筛选宽度合适的段落
-            if (current_paragraph.width_px >= MIN_PARAGRAPH_WIDTH) {
-                paragraphs.push_back(current_paragraph);
-            }
-        }
-    }
-    
-    // 处理最后一个段落（如果图像边缘是段落）
-    if (in_segment) {
-        current_paragraph.end_x = binary.cols - 1;
-        current_paragraph.width_px = current_paragraph.end_x - current_paragraph.start_x + 1;
-        
-        if (current_paragraph.width_px >= MIN_PARAGRAPH_WIDTH) {
-            paragraphs.push_back(current_paragraph);
-        }
-    }
-    
-    // 计算像素到毫米的转换比例，使用第一个段落作为标准
     if (!paragraphs.empty()) {
-        pixel_to_mm_ratio = SCALE_WIDTH_MM / paragraphs[0].width_px;
-        
-        // 计算每个段落的毫米尺寸
         for (size_t i = 0; i < paragraphs.size(); i++) {
-            paragraphs[i].width_mm = paragraphs[i].width_px * pixel_to_mm_ratio;
-            LOGI("段落%d: %d-%d, 宽度: %dpx (%.2fmm)", 
+            LOGI("段落%zu: %d-%d, 宽度: %dpx (%.2fmm)", 
                    i+1, paragraphs[i].start_x, paragraphs[i].end_x,
                    paragraphs[i].width_px, paragraphs[i].width_mm);
         }
@@ -251,14 +592,19 @@ int image_processor_process_image(const string& input_path, const string& output
         LOGW("未检测到任何段落");
     }
     
+    if (!output_dir) {
+        LOGI("图像 %s 处理完成", input_path);
+        return 0;
+    }
+
     // 保存测量数据到文本文件
-    snprintf(output_path, sizeof(output_path), "%s/%s_measurements.txt", output_dir.c_str(), base_filename);
+    snprintf(output_path, sizeof(output_path), "%s/%s_measurements.txt", output_dir, base_filename);
     FILE *fp = fopen(output_path, "w");
     if (fp) {
         fprintf(fp, "图像文件名: %s\n", filename);
-        fprintf(fp, "图像尺寸: %dx%d\n", binary.cols, binary.rows);
-        fprintf(fp, "测量线位置: y = %d\n", mid_y);
-        fprintf(fp, "像素到毫米比例: %.4f\n", pixel_to_mm_ratio);
+        fprintf(fp, "图像尺寸: %dx%d\n", result.cols, result.rows);
+        fprintf(fp, "测量线位置: y = %d\n", result.mid_y);
+        fprintf(fp, "像素到毫米比例: %.4f\n", result.pixel_to_mm_ratio);
         fprintf(fp, "检测到的段落数量: %zu\n", paragraphs.size());
         fprintf(fp, "\n详细测量结果:\n");
         fprintf(fp, "------------------------------------\n");
@@ -280,21 +626,165 @@ int image_processor_process_image(const string& input_path, const string& output
         LOGE("无法创建测量数据文件: %s", output_path);
     }
     
-    binary.release();
-    LOGI("图像 %s 处理完成", input_path.c_str());
+    LOGI("图像 %s 处理完成", input_path);
     return 0;
 }
 
+/**
+ * @brief 测量内存中的图像
+ * 
+ * @param image 输入图像，8位灰度或 BGR 三通道
+ * @param use_calibration 是否使用标定参数
+ * @param debug_name 调试中间图文件名前缀，为 NULL 时按帧序号命名
+ * @return vector<paragraph_t> 检测到的段落
+ */
+vector<paragraph_t> image_processor_measure(const Mat& image, bool use_calibration, const char *debug_name) {
+    vector<paragraph_t> paragraphs;
+    pipeline_measure_mat(g_pipeline, g_options, image, use_calibration, debug_name, paragraphs);
+    return paragraphs;
+}
+
+/**
+ * @brief 测量原始像素缓冲区
+ * 
+ * @param data 像素数据（NV12 时指向 Y 平面起始）
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @param stride 行跨度（字节），0 表示等于宽度
+ * @param format 像素格式
+ * @param use_calibration 是否使用标定参数
+ * @return vector<paragraph_t> 检测到的段落
+ */
+vector<paragraph_t> image_processor_measure_raw(const uint8_t *data, int width, int height,
+                                                int stride, image_pixel_format_t format,
+                                                bool use_calibration) {
+    vector<paragraph_t> paragraphs;
+    Mat gray;
+    if (wrap_raw_gray(data, width, height, stride, format, gray) == 0) {
+        pipeline_run(g_pipeline, g_options, gray, 0, use_calibration, g_options.debug_dir, NULL,
+                     paragraphs, NULL);
+    }
+    return paragraphs;
+}
+
+/**
+ * @brief 处理单张图像
+ * 
+ * 读取图像文件后运行内存流水线，并把测量结果保存到文本文件。
+ * 调试中间图仅在 image_processor_set_debug_output 开启时按采样间隔输出。
+ * 
+ * @param input_path 输入图像文件路径
+ * @param output_dir 输出结果目录
+ * @param use_calibration 是否使用标定参数
+ * @return int 处理结果，0表示成功，非0表示失败
+ */
+int image_processor_process_image(const string& input_path, const string& output_dir, bool use_calibration) {
+    vector<paragraph_t> paragraphs;
+    return pipeline_process_file(g_pipeline, g_options, input_path.c_str(), output_dir.c_str(),
+                                 use_calibration, paragraphs);
+}
+
+/**
+ * @brief 批处理单张图像结果
+ */
+typedef struct {
+    string name;                   ///< 文件名
+    int status;                    ///< 0 成功，-1 读取失败
+    pipeline_result_t result;      ///< 流水线结果
+    vector<paragraph_t> paragraphs; ///< 段落测量结果
+    double elapsed_ms;             ///< 读取 + 处理耗时（毫秒）
+    bool done;                     ///< 是否已处理完成
+} batch_item_t;
+
+/**
+ * @brief 批处理任务共享状态
+ */
+typedef struct {
+    const image_processor_config_t *config;
+    vector<batch_item_t> items;    ///< 按文件名排序的待处理图像
+    std::atomic<size_t> next;      ///< 下一个待领取的图像序号
+    std::mutex lock;               ///< 保护 items[].done
+    std::condition_variable done_cond; ///< 有图像处理完成时通知
+} batch_job_t;
+
+/**
+ * @brief 批处理工作线程
+ * 
+ * 每个工作线程依次领取图像，完成读取解码和流水线处理；
+ * 多个线程并行时，图像 N+1 的解码与图像 N 的处理互相重叠，
+ * 报告由调用线程按顺序写出。
+ * 
+ * @param job 批处理任务
+ */
+static void batch_worker(batch_job_t *job) {
+    const image_processor_config_t& config = *job->config;
+    for (;;) {
+        size_t index = job->next.fetch_add(1);
+        if (index >= job->items.size()) {
+            break;
+        }
+        batch_item_t& item = job->items[index];
+        string input_path = config.input_dir + "/" + item.name;
+
+        // 调试中间图文件名去掉扩展名
+        string base_name = item.name;
+        size_t dot = base_name.rfind('.');
+        if (dot != string::npos) {
+            base_name.erase(dot);
+        }
+
+        double start = monotonic_ms();
+        Mat gray = imread(input_path, IMREAD_GRAYSCALE);
+        if (gray.empty()) {
+            LOGE("无法读取图片: %s", input_path.c_str());
+            item.status = -1;
+        } else {
+            pipeline_run(g_pipeline, g_options, gray, 0, config.use_calibration, config.output_dir,
+                         base_name.c_str(), item.paragraphs, &item.result);
+            item.status = 0;
+        }
+        item.elapsed_ms = monotonic_ms() - start;
+
+        std::lock_guard<std::mutex> guard(job->lock);
+        item.done = true;
+        job->done_cond.notify_all();
+    }
+}
+
+/**
+ * @brief 写出一张图像的汇总报告行
+ * 
+ * @param fp 报告文件
+ * @param index 序号（从1开始）
+ * @param item 图像结果
+ */
+static void batch_write_item(FILE *fp, size_t index, const batch_item_t& item) {
+    if (item.status != 0) {
+        fprintf(fp, "%5zu | %-32s | 读取失败\n", index, item.name.c_str());
+        return;
+    }
+    fprintf(fp, "%5zu | %-32s | %4dx%-4d | %6d | %8.4f | %6zu | %8.1f |",
+            index, item.name.c_str(), item.result.cols, item.result.rows, item.result.mid_y,
+            item.result.pixel_to_mm_ratio, item.paragraphs.size(), item.elapsed_ms);
+    for (size_t i = 0; i < item.paragraphs.size(); i++) {
+        fprintf(fp, " %d-%d:%.2f", item.paragraphs[i].start_x, item.paragraphs[i].end_x,
+                item.paragraphs[i].width_mm);
+    }
+    fputc('\n', fp);
+}
+
 /**
  * @brief 处理指定文件夹中的所有图像
  * 
+ * 按文件名排序后取前 max_images 张图像，由 worker_count 个工作线程并行读取和处理，
+ * 所有结果按顺序汇总到 <output_dir>/IMAGE_BATCH_REPORT_NAME，最后输出吞吐量统计。
+ * 
  * @param config 图像处理配置
  * @return int 处理结果，0表示成功，非0表示失败
  */
 int image_processor_process_folder(const image_processor_config_t& config) {
     DIR *dir;
     struct dirent *entry;
-    int processed_count = 0;
     
     LOGI("开始处理文件夹: %s", config.input_dir.c_str());
     
@@ -310,34 +800,97 @@ int image_processor_process_folder(const image_processor_config_t& config) {
         return -1;
     }
     
-    // 遍历目录中的文件
+    // 收集图片文件，排序后报告顺序与目录遍历顺序无关
+    vector<string> names;
     while ((entry = readdir(dir)) != NULL) {
         // 跳过.和..目录
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
             continue;
         }
-        
-        // 检查是否为图片文件
         if (is_image_file(entry->d_name)) {
-            // 构造完整的文件路径
-            char input_path[512] = {0};
-            snprintf(input_path, sizeof(input_path), "%s/%s", config.input_dir.c_str(), entry->d_name);
-            
-            // 处理图片
-            if (image_processor_process_image(input_path, config.output_dir, config.use_calibration) == 0) {
-                processed_count++;
-                LOGI("已处理图片: %s", entry->d_name);
-            }
-            
-            // 检查是否达到最大处理数量
-            if (config.max_images > 0 && processed_count >= config.max_images) {
-                break;
-            }
+            names.push_back(entry->d_name);
         }
     }
-    
     closedir(dir);
-    LOGI("文件夹处理完成，共处理了 %d 张图片", processed_count);
+    std::sort(names.begin(), names.end());
+    if (config.max_images > 0 && names.size() > (size_t)config.max_images) {
+        names.resize(config.max_images);
+    }
+
+    batch_job_t job;
+    job.config = &config;
+    job.next = 0;
+    job.items.resize(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        job.items[i].name = names[i];
+        job.items[i].status = -1;
+        job.items[i].elapsed_ms = 0.0;
+        job.items[i].done = false;
+    }
+
+    // 工作线程数：未配置时使用 CPU 核数，不超过图像数
+    int workers = config.worker_count;
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if ((size_t)workers > names.size()) {
+        workers = names.empty() ? 1 : (int)names.size();
+    }
+
+    char report_path[512] = {0};
+    snprintf(report_path, sizeof(report_path), "%s/%s", config.output_dir.c_str(), IMAGE_BATCH_REPORT_NAME);
+    FILE *fp = fopen(report_path, "w");
+    if (!fp) {
+        LOGE("无法创建汇总报告: %s", report_path);
+        return -1;
+    }
+    fprintf(fp, "输入目录: %s\n", config.input_dir.c_str());
+    fprintf(fp, "图像数量: %zu\n", names.size());
+    fprintf(fp, "工作线程: %d\n", workers);
+    fprintf(fp, "\n序号 | 文件名 | 尺寸 | 测量线 | 像素到毫米比例 | 段落数 | 耗时(ms) | 段落(起始X-结束X:宽度mm)\n");
+    fprintf(fp, "------------------------------------\n");
+
+    double start = monotonic_ms();
+    vector<std::thread> threads;
+    for (int i = 0; i < workers; i++) {
+        threads.push_back(std::thread(batch_worker, &job));
+    }
+
+    // 调用线程按顺序写报告，与后续图像的解码和处理并行
+    int processed_count = 0;
+    int failed_count = 0;
+    for (size_t i = 0; i < job.items.size(); i++) {
+        {
+            std::unique_lock<std::mutex> guard(job.lock);
+            while (!job.items[i].done) {
+                job.done_cond.wait(guard);
+            }
+        }
+        batch_item_t& item = job.items[i];
+        batch_write_item(fp, i + 1, item);
+        if (item.status == 0) {
+            processed_count++;
+        } else {
+            failed_count++;
+        }
+        vector<paragraph_t>().swap(item.paragraphs);
+    }
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    double elapsed_s = (monotonic_ms() - start) / 1000.0;
+    double throughput = elapsed_s > 0 ? processed_count / elapsed_s : 0.0;
+
+    fprintf(fp, "------------------------------------\n");
+    fprintf(fp, "成功: %d, 失败: %d, 总耗时: %.3fs, 吞吐量: %.2f 张/秒\n",
+            processed_count, failed_count, elapsed_s, throughput);
+    fclose(fp);
+
+    LOGI("已将汇总测量数据保存到: %s", report_path);
+    LOGI("文件夹处理完成，共处理了 %d 张图片（失败 %d 张），%d 个线程，耗时 %.3fs，%.2f 张/秒",
+         processed_count, failed_count, workers, elapsed_s, throughput);
     return 0;
 }
 
@@ -379,3 +932,136 @@ vector<string> image_processor_load_calibration_images(const string& calib_dir)
     LOGI("从目录 %s 加载了 %zu 张标定图像", calib_dir.c_str(), calib_images.size());
     return calib_images;
 }
+
+/**
+ * @brief C 接口图像处理上下文
+ * 
+ * 每个上下文持有独立的流水线缓冲区和标定缓存，
+ * 不同上下文可以在不同线程并行使用；同一上下文的调用由 lock 串行化。
+ */
+struct imageproc {
+    std::mutex lock;                ///< 保护以下成员
+    bool use_calibration;           ///< 是否使用标定参数
+    pipeline_options_t options;     ///< 流水线选项
+    pipeline_buffers_t buffers;     ///< 流水线缓冲区
+    vector<paragraph_t> paragraphs; ///< 最近一次处理的段落
+    imageproc_timing_t timing;      ///< 最近一次处理的耗时
+};
+
+void imageproc_default_options(imageproc_options_t *opts) {
+    if (!opts) {
+        return;
+    }
+    memset(opts, 0, sizeof(*opts));
+    opts->use_calibration = 0;
+    opts->measure.band_half_height = 0;
+    opts->measure.line_count = 1;
+    opts->measure.line_pos[0] = 0.5f;
+    opts->debug_interval = 0;
+    opts->debug_dir = NULL;
+}
+
+imageproc_t *imageproc_create(const imageproc_options_t *opts) {
+    imageproc_options_t defaults;
+    if (!opts) {
+        imageproc_default_options(&defaults);
+        opts = &defaults;
+    }
+    if (!measure_config_valid(opts->measure)) {
+        return NULL;
+    }
+
+    imageproc_t *ctx = new (std::nothrow) imageproc_t();
+    if (!ctx) {
+        LOGE("创建图像处理上下文失败: 内存不足");
+        return NULL;
+    }
+    ctx->use_calibration = opts->use_calibration != 0;
+    ctx->options.measure = opts->measure;
+    ctx->options.debug_interval = opts->debug_interval > 0 ? opts->debug_interval : 0;
+    ctx->options.debug_dir = opts->debug_dir ? opts->debug_dir : "";
+    LOGI("图像处理上下文已创建，内核: %s", imageproc_kernel_name());
+    return ctx;
+}
+
+void imageproc_destroy(imageproc_t *ctx) {
+    delete ctx;
+}
+
+int imageproc_process_file(imageproc_t *ctx, const char *input_path, const char *output_dir) {
+    if (!ctx || !input_path) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(ctx->lock);
+    return pipeline_process_file(ctx->buffers, ctx->options, input_path, output_dir,
+                                 ctx->use_calibration, ctx->paragraphs, &ctx->timing);
+}
+
+int imageproc_measure(imageproc_t *ctx, const uint8_t *data, int width, int height,
+                      int stride, image_pixel_format_t format) {
+    if (!ctx) {
+        return -1;
+    }
+    Mat gray;
+    if (wrap_raw_gray(data, width, height, stride, format, gray) != 0) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(ctx->lock);
+    double start = monotonic_ms();
+    pipeline_run(ctx->buffers, ctx->options, gray, 0, ctx->use_calibration, ctx->options.debug_dir,
+                 NULL, ctx->paragraphs, NULL);
+    ctx->timing.decode_us = 0;
+    ctx->timing.measure_us = (uint32_t)((monotonic_ms() - start) * 1000.0);
+    return 0;
+}
+
+int imageproc_measure_frame(imageproc_t *ctx, const imageproc_frame_t *frame) {
+    if (!ctx || !frame) {
+        return -1;
+    }
+    Mat gray;
+    if (wrap_raw_gray(frame->virt_addr, frame->width, frame->height, frame->stride,
+                      frame->format, gray) != 0) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(ctx->lock);
+    double start = monotonic_ms();
+    pipeline_run(ctx->buffers, ctx->options, gray, frame->phys_addr, ctx->use_calibration,
+                 ctx->options.debug_dir, NULL, ctx->paragraphs, NULL);
+    ctx->timing.decode_us = 0;
+    ctx->timing.measure_us = (uint32_t)((monotonic_ms() - start) * 1000.0);
+    return 0;
+}
+
+int imageproc_get_paragraph_count(imageproc_t *ctx) {
+    if (!ctx) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> guard(ctx->lock);
+    return (int)ctx->paragraphs.size();
+}
+
+int imageproc_get_paragraph(imageproc_t *ctx, int index, paragraph_t *paragraph) {
+    if (!ctx || !paragraph) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(ctx->lock);
+    if (index < 0 || index >= (int)ctx->paragraphs.size()) {
+        return -1;
+    }
+    *paragraph = ctx->paragraphs[index];
+    return 0;
+}
+
+int imageproc_get_timing(imageproc_t *ctx, imageproc_timing_t *timing) {
+    if (!ctx || !timing) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> guard(ctx->lock);
+    *timing = ctx->timing;
+    return 0;
+}
+
+const char *imageproc_backend_name(void) {
+    return imageproc_kernel_name();
+}
@@ -0,0 +1,46 @@
+/**
+ * @file kernel_common.cpp
+ * @brief libimageproc 各内核共用的计算
+ * @date 2026-10-14
+ *
+ * OTSU 阈值由 256 级直方图计算，neon 内核在模糊时统计直方图，
+ * ive 内核由 IVE 直方图算子得到直方图，两者共用同一个阈值计算。
+ */
+
+#include "imageproc_kernel.h"
+#include <float.h>
+
+int imageproc_kernel_otsu(const uint32_t hist[256], size_t total) {
+    if (total == 0) {
+        return 0;
+    }
+    double scale = 1.0 / (double)total;
+    double mu = 0.0;
+    for (int i = 0; i < 256; i++) {
+        mu += i * (double)hist[i];
+    }
+    mu *= scale;
+
+    double mu1 = 0.0;
+    double q1 = 0.0;
+    double max_sigma = 0.0;
+    int max_val = 0;
+    for (int i = 0; i < 256; i++) {
+        double p_i = hist[i] * scale;
+        mu1 *= q1;
+        q1 += p_i;
+        double q2 = 1.0 - q1;
+        // 与 OpenCV getThreshVal_Otsu_8u 相同的跳过条件，保证各内核阈值一致
+        if ((q1 < q2 ? q1 : q2) < FLT_EPSILON || (q1 > q2 ? q1 : q2) > 1.0 - FLT_EPSILON) {
+            continue;
+        }
+        mu1 = (mu1 + i * p_i) / q1;
+        double mu2 = (mu - q1 * mu1) / q2;
+        double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+        if (sigma > max_sigma) {
+            max_sigma = sigma;
+            max_val = i;
+        }
+    }
+    return max_val;
+}
@@ -0,0 +1,362 @@
+/**
+ * @file kernel_ive.cpp
+ * @brief libimageproc 海思 IVE 硬件加速内核
+ * @date 2026-10-14
+ *
+ * 5×5 高斯模糊、直方图、二值化、3×3 腐蚀和膨胀全部由 IVE 完成，ARM 只根据
+ * IVE 直方图计算 OTSU 阈值：
+ * 1. **零拷贝输入**：调用方给出物理地址（VPSS 输出的 VB 块）时 IVE 直接读取，
+ *    否则先把输入拷贝到 MMZ 暂存缓冲区
+ * 2. **MMZ 缓冲区复用**：中间结果缓冲区按图像尺寸分配一次，输出图像直接引用
+ *    MMZ 内存（非 cache 映射，CPU 读取前无需刷 cache）
+ * 3. **CPU 回退**：媒体系统未初始化、MMZ 分配失败、尺寸超出 IVE 范围或算子
+ *    执行失败时，本帧改用 OpenCV 完成
+ *
+ * IVE 与 OpenCV 的边界处理和舍入方式不完全相同，条带上下的滤波余量
+ * （BAND_FILTER_MARGIN）吸收垂直方向的边界差异。
+ */
+
+#include "imageproc_kernel.h"
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+
+#include <opencv2/imgproc.hpp>
+
+#include "ot_type.h"
+#include "ot_common_ive.h"
+#include "ss_mpi_ive.h"
+#include "ss_mpi_sys.h"
+
+using namespace cv;
+
+// 日志宏定义
+#define LOGI(...) fprintf(stdout, "[INFO] " __VA_ARGS__); fprintf(stdout, "\n")
+#define LOGW(...) fprintf(stdout, "[WARN] " __VA_ARGS__); fprintf(stdout, "\n")
+
+// IVE 约束
+#define IVE_ALIGN 16            // 行跨度与物理地址对齐（字节）
+#define IVE_MIN_SIZE 64         // 最小宽高（像素）
+#define IVE_MAX_WIDTH 1920      // 最大宽度（像素）
+#define IVE_MAX_HEIGHT 1080     // 最大高度（像素）
+#define IVE_HIST_BINS 256       // 直方图级数
+#define IVE_QUERY_SLEEP_US 100  // 查询任务状态超时后的等待时间（微秒）
+
+/**
+ * @brief MMZ 缓冲区
+ */
+typedef struct {
+    td_phys_addr_t phys;  ///< 物理地址
+    td_u8 *virt;          ///< 用户态虚拟地址
+    td_u32 size;          ///< 大小（字节）
+} mmz_buf_t;
+
+/**
+ * @brief IVE 内核私有状态
+ */
+struct imageproc_kernel_state {
+    bool unavailable;   ///< IVE 不可用（MMZ 分配失败），之后一律走 CPU
+    bool warned;        ///< 是否已输出过算子失败告警
+    int width;          ///< 缓冲区对应的图像宽度
+    int height;         ///< 缓冲区对应的图像高度
+    td_u32 stride;      ///< 缓冲区行跨度
+    mmz_buf_t src;      ///< 输入暂存（输入不在 MMZ 中时使用）
+    mmz_buf_t blur;     ///< 高斯模糊结果
+    mmz_buf_t binary;   ///< 二值化结果
+    mmz_buf_t eroded;   ///< 腐蚀结果
+    mmz_buf_t denoised; ///< 开运算结果
+    mmz_buf_t hist;     ///< 直方图（IVE_HIST_BINS 个 td_u32）
+};
+
+/**
+ * @brief 分配 MMZ 缓冲区
+ *
+ * @param buf 缓冲区
+ * @param size 大小（字节）
+ * @return int 成功返回0，失败返回-1
+ */
+static int mmz_alloc(mmz_buf_t *buf, td_u32 size) {
+    td_void *virt = TD_NULL;
+    td_s32 ret = ss_mpi_sys_mmz_alloc(&buf->phys, &virt, "imageproc", TD_NULL, size);
+    if (ret != TD_SUCCESS) {
+        LOGW("IVE 内核分配 MMZ 失败: %u 字节, ret=0x%x", size, ret);
+        memset(buf, 0, sizeof(*buf));
+        return -1;
+    }
+    buf->virt = (td_u8 *)virt;
+    buf->size = size;
+    return 0;
+}
+
+/**
+ * @brief 释放 MMZ 缓冲区
+ *
+ * @param buf 缓冲区
+ */
+static void mmz_free(mmz_buf_t *buf) {
+    if (buf->virt) {
+        ss_mpi_sys_mmz_free(buf->phys, buf->virt);
+    }
+    memset(buf, 0, sizeof(*buf));
+}
+
+/**
+ * @brief 释放所有图像缓冲区
+ *
+ * @param state 内核状态
+ */
+static void state_free_images(imageproc_kernel_state_t *state) {
+    mmz_free(&state->src);
+    mmz_free(&state->blur);
+    mmz_free(&state->binary);
+    mmz_free(&state->eroded);
+    mmz_free(&state->denoised);
+    state->width = 0;
+    state->height = 0;
+    state->stride = 0;
+}
+
+/**
+ * @brief 确保缓冲区与图像尺寸一致
+ *
+ * 尺寸变化时先解除 bufs 中对旧 MMZ 内存的引用，再重新分配。
+ *
+ * @param state 内核状态
+ * @param bufs 输出缓冲区
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @return int 成功返回0，失败返回-1
+ */
+static int state_prepare(imageproc_kernel_state_t *state, imageproc_kernel_buffers_t& bufs,
+                         int width, int height) {
+    if (state->width == width && state->height == height) {
+        return 0;
+    }
+
+    bufs.blur.release();
+    bufs.binary.release();
+    bufs.denoised.release();
+    state_free_images(state);
+
+    td_u32 stride = ((td_u32)width + IVE_ALIGN - 1) / IVE_ALIGN * IVE_ALIGN;
+    td_u32 size = stride * (td_u32)height;
+    if (!state->hist.virt && mmz_alloc(&state->hist, IVE_HIST_BINS * sizeof(td_u32)) != 0) {
+        return -1;
+    }
+    if (mmz_alloc(&state->src, size) != 0 || mmz_alloc(&state->blur, size) != 0 ||
+        mmz_alloc(&state->binary, size) != 0 || mmz_alloc(&state->eroded, size) != 0 ||
+        mmz_alloc(&state->denoised, size) != 0) {
+        state_free_images(state);
+        return -1;
+    }
+    state->width = width;
+    state->height = height;
+    state->stride = stride;
+    LOGI("IVE 内核缓冲区已分配: %dx%d, stride=%u", width, height, stride);
+    return 0;
+}
+
+/**
+ * @brief 填充 IVE 单通道图像描述
+ *
+ * @param img 图像描述
+ * @param phys 物理地址
+ * @param virt 虚拟地址
+ * @param stride 行跨度
+ * @param width 宽度
+ * @param height 高度
+ */
+static void ive_image(ot_svp_img *img, td_phys_addr_t phys, const td_u8 *virt, td_u32 stride,
+                      int width, int height) {
+    memset(img, 0, sizeof(*img));
+    img->type = OT_SVP_IMG_TYPE_U8C1;
+    img->phys_addr[0] = phys;
+    img->virt_addr[0] = (td_u64)(uintptr_t)virt;
+    img->stride[0] = stride;
+    img->width = (td_u32)width;
+    img->height = (td_u32)height;
+}
+
+/**
+ * @brief 等待 IVE 任务完成
+ *
+ * @param handle 任务句柄
+ * @return bool 任务是否成功完成
+ */
+static bool ive_wait(ot_ive_handle handle) {
+    td_bool finish = TD_FALSE;
+    td_s32 ret = ss_mpi_ive_query(handle, &finish, TD_TRUE);
+    while (ret == OT_ERR_IVE_QUERY_TIMEOUT) {
+        usleep(IVE_QUERY_SLEEP_US);
+        ret = ss_mpi_ive_query(handle, &finish, TD_TRUE);
+    }
+    return ret == TD_SUCCESS && finish == TD_TRUE;
+}
+
+/**
+ * @brief 输出一次算子失败告警（之后静默回退）
+ *
+ * @param state 内核状态
+ * @param op 算子名称
+ * @param ret 返回值
+ */
+static void ive_warn(imageproc_kernel_state_t *state, const char *op, td_s32 ret) {
+    if (!state->warned) {
+        LOGW("IVE %s 失败 (ret=0x%x)，回退到 CPU", op, ret);
+        state->warned = true;
+    }
+}
+
+/**
+ * @brief 用 IVE 执行模糊、二值化和开运算
+ *
+ * @param src 输入图像
+ * @param src_phys_addr 输入物理地址，0 表示未知
+ * @param bufs 输出缓冲区
+ * @return bool 成功返回 true；返回 false 时调用方改用 CPU
+ */
+static bool ive_binarize(const Mat& src, uint64_t src_phys_addr, imageproc_kernel_buffers_t& bufs) {
+    int rows = src.rows;
+    int cols = src.cols;
+    if (cols < IVE_MIN_SIZE || rows < IVE_MIN_SIZE || cols > IVE_MAX_WIDTH || rows > IVE_MAX_HEIGHT) {
+        return false;
+    }
+
+    if (!bufs.state) {
+        bufs.state = new (std::nothrow) imageproc_kernel_state_t();
+        if (!bufs.state) {
+            return false;
+        }
+    }
+    imageproc_kernel_state_t *state = bufs.state;
+    if (state->unavailable) {
+        return false;
+    }
+    if (state_prepare(state, bufs, cols, rows) != 0) {
+        LOGW("IVE 不可用，改用 CPU 内核");
+        state->unavailable = true;
+        return false;
+    }
+
+    // 输入已在物理内存中且满足对齐要求时直接使用，否则拷贝到暂存缓冲区
+    ot_svp_src_img in;
+    if (src_phys_addr != 0 && (src_phys_addr % IVE_ALIGN) == 0 && (src.step % IVE_ALIGN) == 0) {
+        ive_image(&in, (td_phys_addr_t)src_phys_addr, src.data, (td_u32)src.step, cols, rows);
+    } else {
+        for (int y = 0; y < rows; y++) {
+            memcpy(state->src.virt + (size_t)y * state->stride, src.ptr<uchar>(y), (size_t)cols);
+        }
+        ive_image(&in, state->src.phys, state->src.virt, state->stride, cols, rows);
+    }
+
+    ot_svp_dst_img blur;
+    ot_svp_dst_img binary;
+    ot_svp_dst_img eroded;
+    ot_svp_dst_img denoised;
+    ive_image(&blur, state->blur.phys, state->blur.virt, state->stride, cols, rows);
+    ive_image(&binary, state->binary.phys, state->binary.virt, state->stride, cols, rows);
+    ive_image(&eroded, state->eroded.phys, state->eroded.virt, state->stride, cols, rows);
+    ive_image(&denoised, state->denoised.phys, state->denoised.virt, state->stride, cols, rows);
+
+    ot_svp_dst_mem_info hist;
+    memset(&hist, 0, sizeof(hist));
+    hist.phys_addr = state->hist.phys;
+    hist.virt_addr = (td_u64)(uintptr_t)state->hist.virt;
+    hist.size = state->hist.size;
+
+    // 高斯模糊：[1 4 6 4 1] 外积，系数和 256，归一化右移 8 位
+    static const td_s8 gauss_row[5] = { 1, 4, 6, 4, 1 };
+    ot_ive_filter_ctrl filter_ctrl;
+    memset(&filter_ctrl, 0, sizeof(filter_ctrl));
+    for (int i = 0; i < OT_IVE_MASK_NUM; i++) {
+        filter_ctrl.mask[i] = (td_s8)(gauss_row[i / 5] * gauss_row[i % 5]);
+    }
+    filter_ctrl.norm = 8;
+
+    // 模糊与直方图连续提交，只等待最后一个任务
+    ot_ive_handle handle;
+    td_s32 ret = ss_mpi_ive_filter(&handle, &in, &blur, &filter_ctrl, TD_FALSE);
+    if (ret != TD_SUCCESS) {
+        ive_warn(state, "filter", ret);
+        return false;
+    }
+    ret = ss_mpi_ive_hist(&handle, &blur, &hist, TD_TRUE);
+    if (ret != TD_SUCCESS || !ive_wait(handle)) {
+        ive_warn(state, "hist", ret);
+        return false;
+    }
+
+    // 普通二值化：使用OTSU自动阈值（条带模式下阈值只由条带统计）
+    int thresh = imageproc_kernel_otsu((const uint32_t *)state->hist.virt, (size_t)rows * cols);
+    ot_ive_thresh_ctrl thresh_ctrl;
+    memset(&thresh_ctrl, 0, sizeof(thresh_ctrl));
+    thresh_ctrl.mode = OT_IVE_THRESH_MODE_BINARY;
+    thresh_ctrl.low_threshold = (td_u8)thresh;
+    thresh_ctrl.min_val = 0;
+    thresh_ctrl.max_val = 255;
+
+    // 形态学去噪：3×3 矩形结构元素（5×5 模板的中心 3×3）
+    ot_ive_erode_ctrl erode_ctrl;
+    ot_ive_dilate_ctrl dilate_ctrl;
+    memset(&erode_ctrl, 0, sizeof(erode_ctrl));
+    memset(&dilate_ctrl, 0, sizeof(dilate_ctrl));
+    for (int i = 0; i < OT_IVE_MASK_NUM; i++) {
+        int r = i / 5;
+        int c = i % 5;
+        td_u8 v = (r >= 1 && r <= 3 && c >= 1 && c <= 3) ? 255 : 0;
+        erode_ctrl.mask[i] = v;
+        dilate_ctrl.mask[i] = v;
+    }
+
+    ret = ss_mpi_ive_thresh(&handle, &blur, &binary, &thresh_ctrl, TD_FALSE);
+    if (ret != TD_SUCCESS) {
+        ive_warn(state, "thresh", ret);
+        return false;
+    }
+    ret = ss_mpi_ive_erode(&handle, &binary, &eroded, &erode_ctrl, TD_FALSE);
+    if (ret != TD_SUCCESS) {
+        ive_warn(state, "erode", ret);
+        return false;
+    }
+    ret = ss_mpi_ive_dilate(&handle, &eroded, &denoised, &dilate_ctrl, TD_TRUE);
+    if (ret != TD_SUCCESS || !ive_wait(handle)) {
+        ive_warn(state, "dilate", ret);
+        return false;
+    }
+
+    // 输出图像直接引用 MMZ 内存，不拷贝
+    bufs.blur = Mat(rows, cols, CV_8UC1, state->blur.virt, state->stride);
+    bufs.binary = Mat(rows, cols, CV_8UC1, state->binary.virt, state->stride);
+    bufs.denoised = Mat(rows, cols, CV_8UC1, state->denoised.virt, state->stride);
+    return true;
+}
+
+void imageproc_kernel_binarize(const Mat& src, uint64_t src_phys_addr, imageproc_kernel_buffers_t& bufs) {
+    if (ive_binarize(src, src_phys_addr, bufs)) {
+        return;
+    }
+
+    // CPU 回退，与 kernel_opencv.cpp 相同
+    static const Mat kernel = getStructuringElement(MORPH_RECT, Size(3, 3));
+    GaussianBlur(src, bufs.blur, Size(5, 5), 0);
+    threshold(bufs.blur, bufs.binary, 0, 255, THRESH_BINARY | THRESH_OTSU);
+    morphologyEx(bufs.binary, bufs.denoised, MORPH_OPEN, kernel);
+}
+
+void imageproc_kernel_release(imageproc_kernel_buffers_t& bufs) {
+    if (!bufs.state) {
+        return;
+    }
+    bufs.blur.release();
+    bufs.binary.release();
+    bufs.denoised.release();
+    state_free_images(bufs.state);
+    mmz_free(&bufs.state->hist);
+    delete bufs.state;
+    bufs.state = NULL;
+}
+
+const char *imageproc_kernel_name(void) {
+    return "ive";
+}
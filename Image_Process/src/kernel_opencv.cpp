@@ -0,0 +1,37 @@
+/**
+ * @file kernel_opencv.cpp
+ * @brief libimageproc OpenCV 内核
+ * @date 2026-10-14
+ *
+ * 直接调用 OpenCV imgproc。输入为整帧子矩阵时，高斯模糊会读取子矩阵以外的
+ * 父图像素，条带边缘与整帧处理结果一致。
+ */
+
+#include "imageproc_kernel.h"
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+
+void imageproc_kernel_binarize(const Mat& src, uint64_t src_phys_addr, imageproc_kernel_buffers_t& bufs) {
+    (void)src_phys_addr;
+
+    // 开运算结构元素只创建一次（C++11 局部静态变量初始化是线程安全的）
+    static const Mat kernel = getStructuringElement(MORPH_RECT, Size(3, 3));
+
+    // 高斯模糊：去除图像噪声
+    GaussianBlur(src, bufs.blur, Size(5, 5), 0);
+
+    // 普通二值化：使用OTSU自动阈值（条带模式下阈值只由条带统计）
+    threshold(bufs.blur, bufs.binary, 0, 255, THRESH_BINARY | THRESH_OTSU);
+
+    // 形态学去噪：使用开运算去除小的噪点
+    morphologyEx(bufs.binary, bufs.denoised, MORPH_OPEN, kernel);
+}
+
+void imageproc_kernel_release(imageproc_kernel_buffers_t& bufs) {
+    (void)bufs;
+}
+
+const char *imageproc_kernel_name(void) {
+    return "opencv";
+}
@@ -34,12 +34,19 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
-#include <dirent.h>
 #include <pthread.h>
 #include "mqtt_client.h"
 #include "fota_file_download.h"
 #include "mqtt_file_upload.h"
+#include "upload_queue.h"
 #include "message_queue.h"
+#include "process_manager.h"
+#include "fota_relay.h"
+#include "json_writer.h"
+#include "mqtt_command.h"
+#include "telemetry_batch.h"
+#include "mqtt_spool.h"
+#include "pm_metrics.h"
 #include <cJSON.h>
 #include <openssl/bio.h>
 #include <openssl/evp.h>
@@ -201,55 +208,6 @@ static char *build_topic(const char *device_id, const char *topic_format)
     return topic;
 }
 
-/**
- * @brief 扫描目录下的jpg文件并上传
- * @param device_id 设备ID
- * @param directory 要扫描的目录
- * @return 成功上传的文件数量
- */
-static int scan_and_upload_jpg_files(const char *device_id, const char *directory)
-{
-    int uploaded_count = 0;
-    DIR *dir = opendir(directory);
-    if (!dir) {
-        LOG_ERROR("Failed to open directory %s: %s", directory, strerror(errno));
-        return 0;
-    }
-    
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        // 跳过.和..目录
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-        
-        // 检查是否是jpg文件
-        size_t len = strlen(entry->d_name);
-        if (len > 4 && strcasecmp(entry->d_name + len - 4, ".jpg") == 0) {
-            // 构建完整的文件路径
-            char file_path[1024];
-            snprintf(file_path, sizeof(file_path), "%s/%s", directory, entry->d_name);
-            
-            // 检查是否是普通文件
-            struct stat stat_buf;
-            if (stat(file_path, &stat_buf) == 0 && S_ISREG(stat_buf.st_mode)) {
-                LOG_INFO("Found jpg file: %s, size: %llu bytes", file_path, (unsigned long long)stat_buf.st_size);
-                
-                // 上传文件
-                if (handle_file_chunk_upload(device_id, file_path)) {
-                    LOG_INFO("Successfully uploaded file: %s", file_path);
-                    uploaded_count++;
-                } else {
-                    LOG_ERROR("Failed to upload file: %s", file_path);
-                }
-            }
-        }
-    }
-    
-    closedir(dir);
-    return uploaded_count;
-}
-
 /**
  * @brief 设备ID
  */
@@ -277,156 +235,182 @@ static int g_mq_mqtt_to_uart = -1;
 static uint32_t g_seq_num = 0;
 
 /**
- * @brief 最后处理的命令ID，用于去重
+ * @brief 最近处理过的命令ID环，用于去重
+ * @details 服务器重发或乱序到达的旧命令只要还在环内就会被丢弃，较早的ID会被覆盖
  */
-static int g_last_command_id = -1;
+#define COMMAND_ID_HISTORY 32
+static int64_t g_recent_command_ids[COMMAND_ID_HISTORY];
+static int g_recent_command_count = 0;
+static int g_recent_command_next = 0;
+static pthread_mutex_t g_recent_command_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static pthread_t g_file_upload_thread;
-static pthread_mutex_t g_file_upload_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t g_file_upload_cond = PTHREAD_COND_INITIALIZER;
-static bool g_file_upload_thread_running = false;
-static bool g_file_upload_thread_started = false;
-static bool g_file_upload_request_pending = false;
-static bool g_file_upload_in_progress = false;
-static char g_file_upload_request_path[1024] = {0};
+/**
+ * @brief 上传队列与并行上传线程
+ * @details 图片目录由 inotify 驱动入队，服务器命令指定的文件以 HIGH 优先级插队；
+ *          队列持久化到日志，重启后继续未完成的上传
+ */
+#define UPLOAD_WORKER_COUNT 3
+#define UPLOAD_PICTURE_DIR "/appfs/nfs/picture"
+#define UPLOAD_QUEUE_JOURNAL "/appfs/nfs/upload_queue.journal"
 
-static void enqueue_file_upload_request(const char *file_path)
+static upload_queue_t *g_upload_queue = NULL;
+static pthread_t g_upload_workers[UPLOAD_WORKER_COUNT];
+static int g_upload_worker_count = 0;
+
+/**
+ * @brief 分片编码协商状态：start 消息声明 encodings，服务器在 started 响应中选择
+ */
+typedef enum {
+    UPLOAD_ENCODING_PENDING,    // 等待 started 响应
+    UPLOAD_ENCODING_HEX,        // hex/JSON 分片（兼容旧服务器）
+    UPLOAD_ENCODING_BINARY      // 二进制分片头 + 原始数据
+} upload_encoding_t;
+
+/**
+ * @brief 协商槽位，每个进行中的上传占用一个，按 file_id 匹配 started 响应
+ */
+typedef struct {
+    bool in_use;
+    char file_id[64];
+    upload_encoding_t encoding;
+} upload_negotiation_t;
+
+#define UPLOAD_NEGOTIATION_SLOTS (UPLOAD_WORKER_COUNT + 1)
+
+static pthread_mutex_t g_upload_neg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_upload_neg_cond = PTHREAD_COND_INITIALIZER;
+static upload_negotiation_t g_upload_neg[UPLOAD_NEGOTIATION_SLOTS];
+
+static void enqueue_file_upload_request(const char *file_path, upload_priority_t priority)
 {
-    if (!file_path || !file_path[0]) {
+    if (!file_path || !file_path[0] || !g_upload_queue) {
         return;
     }
 
-    pthread_mutex_lock(&g_file_upload_mutex);
-    strncpy(g_file_upload_request_path, file_path, sizeof(g_file_upload_request_path) - 1);
-    g_file_upload_request_path[sizeof(g_file_upload_request_path) - 1] = '\0';
-    g_file_upload_request_pending = true;
-    pthread_cond_signal(&g_file_upload_cond);
-    pthread_mutex_unlock(&g_file_upload_mutex);
+    // 服务器命令明确要求上传，忽略"刚上传过"的记录
+    bool force = priority == UPLOAD_PRIORITY_HIGH;
+    upload_queue_result_t rc = upload_queue_push(g_upload_queue, file_path, priority, force);
+    switch (rc) {
+        case UPLOAD_QUEUE_OK:
+            LOG_INFO("File upload queued: %s", file_path);
+            break;
+        case UPLOAD_QUEUE_DUPLICATE:
+            LOG_INFO("File upload already queued: %s", file_path);
+            break;
+        case UPLOAD_QUEUE_FULL:
+            LOG_ERROR("Upload queue full, dropping %s", file_path);
+            break;
+        default:
+            LOG_ERROR("Cannot queue %s for upload", file_path);
+            break;
+    }
 }
 
-static void *file_upload_thread_main(void *arg)
+static void *file_upload_worker_main(void *arg)
 {
-    (void)arg;
+    int worker = (int)(intptr_t)arg;
+    upload_job_t job;
 
-    pthread_mutex_lock(&g_file_upload_mutex);
-    while (g_file_upload_thread_running) {
-        while (!g_file_upload_request_pending && g_file_upload_thread_running) {
-            pthread_cond_wait(&g_file_upload_cond, &g_file_upload_mutex);
+    while (upload_queue_pop(g_upload_queue, &job, -1)) {
+        // 断线期间保持任务，连接恢复后再上传
+        while (g_running && !(g_client && mqtt_client_get_state(g_client) == MQTT_CLIENT_STATE_CONNECTED)) {
+            usleep(500000);
         }
-        if (!g_file_upload_thread_running) {
+        if (!g_running) {
+            // 不计入尝试次数，任务仍在日志中，重启后继续
             break;
         }
 
-        char file_path[1024] = {0};
-        strncpy(file_path, g_file_upload_request_path, sizeof(file_path) - 1);
-        g_file_upload_request_pending = false;
-        g_file_upload_in_progress = true;
-        pthread_mutex_unlock(&g_file_upload_mutex);
-
-        while (g_file_upload_thread_running) {
-            if (g_client && mqtt_client_get_state(g_client) == MQTT_CLIENT_STATE_CONNECTED) {
-                LOG_INFO("Starting queued file upload: %s", file_path);
-                if (handle_file_chunk_upload(g_device_id, file_path)) {
-                    LOG_INFO("Queued file upload finished: %s", file_path);
-                } else {
-                    LOG_ERROR("Queued file upload failed: %s", file_path);
-                }
-                break;
-            }
-            usleep(500000);
+        LOG_INFO("Upload worker %d starting %s (priority %d, attempt %d)",
+                 worker, job.path, (int)job.priority, job.attempts + 1);
+        bool ok = handle_file_chunk_upload(g_device_id, job.path);
+        if (ok) {
+            LOG_INFO("Upload worker %d finished %s", worker, job.path);
+        } else {
+            LOG_ERROR("Upload worker %d failed %s", worker, job.path);
         }
-
-        pthread_mutex_lock(&g_file_upload_mutex);
-        g_file_upload_in_progress = false;
+        upload_queue_complete(g_upload_queue, &job, ok);
     }
-    pthread_mutex_unlock(&g_file_upload_mutex);
 
     return NULL;
 }
 
-static bool start_file_upload_thread(void)
+static bool start_file_upload_workers(void)
 {
-    pthread_mutex_lock(&g_file_upload_mutex);
-    if (g_file_upload_thread_started) {
-        pthread_mutex_unlock(&g_file_upload_mutex);
-        return true;
+    g_upload_queue = upload_queue_create(UPLOAD_QUEUE_JOURNAL, UPLOAD_QUEUE_DEFAULT_CAPACITY);
+    if (!g_upload_queue) {
+        return false;
     }
-    g_file_upload_thread_running = true;
-    pthread_mutex_unlock(&g_file_upload_mutex);
 
-    int rc = pthread_create(&g_file_upload_thread, NULL, file_upload_thread_main, NULL);
-    if (rc != 0) {
-        pthread_mutex_lock(&g_file_upload_mutex);
-        g_file_upload_thread_running = false;
-        pthread_mutex_unlock(&g_file_upload_mutex);
+    for (int i = 0; i < UPLOAD_WORKER_COUNT; i++) {
+        if (pthread_create(&g_upload_workers[i], NULL, file_upload_worker_main, (void *)(intptr_t)i) != 0) {
+            LOG_ERROR("Failed to create upload worker %d", i);
+            break;
+        }
+        g_upload_worker_count++;
+    }
+    if (g_upload_worker_count == 0) {
+        upload_queue_destroy(g_upload_queue);
+        g_upload_queue = NULL;
         return false;
     }
 
-    pthread_mutex_lock(&g_file_upload_mutex);
-    g_file_upload_thread_started = true;
-    pthread_mutex_unlock(&g_file_upload_mutex);
+    if (upload_queue_watch_dir(g_upload_queue, UPLOAD_PICTURE_DIR, ".jpg") != 0) {
+        LOG_ERROR("Failed to watch %s, only commanded uploads will run", UPLOAD_PICTURE_DIR);
+    }
     return true;
 }
 
-static void stop_file_upload_thread(void)
+static void stop_file_upload_workers(void)
 {
-    pthread_mutex_lock(&g_file_upload_mutex);
-    if (!g_file_upload_thread_started) {
-        pthread_mutex_unlock(&g_file_upload_mutex);
+    if (!g_upload_queue) {
         return;
     }
-    g_file_upload_thread_running = false;
-    pthread_cond_signal(&g_file_upload_cond);
-    pthread_mutex_unlock(&g_file_upload_mutex);
 
-    pthread_join(g_file_upload_thread, NULL);
-
-    pthread_mutex_lock(&g_file_upload_mutex);
-    g_file_upload_thread_started = false;
-    g_file_upload_request_pending = false;
-    g_file_upload_in_progress = false;
-    g_file_upload_request_path[0] = '\0';
-    pthread_mutex_unlock(&g_file_upload_mutex);
+    upload_queue_unwatch(g_upload_queue);
+    upload_queue_shutdown(g_upload_queue);
+    for (int i = 0; i < g_upload_worker_count; i++) {
+        pthread_join(g_upload_workers[i], NULL);
+    }
+    g_upload_worker_count = 0;
+
+    upload_queue_stats_t stats;
+    upload_queue_get_stats(g_upload_queue, &stats);
+    LOG_INFO("Upload queue: %zu pending, %llu completed, %llu failed, %llu duplicates skipped",
+             stats.pending, (unsigned long long)stats.completed,
+             (unsigned long long)stats.failed, (unsigned long long)stats.duplicates);
+    upload_queue_destroy(g_upload_queue);
+    g_upload_queue = NULL;
 }
 
 /**
- * @brief 检查并处理命令去重
- * @param payload 消息内容
- * @param payload_len 消息长度
- * @return true表示命令已处理过，false表示命令未处理过
- */
-static bool check_command_duplicate(const void *payload, size_t payload_len) {
-    (void)payload_len; // 未使用参数
-    char *payload_str = (char *)payload;
-    char *command_id_start = strstr(payload_str, "\"command_id\":");
-    if (command_id_start) {
-        command_id_start += 13; // 跳过"command_id":
-        while (*command_id_start == ' ') {
-            command_id_start++;
-        }
-        char *command_id_end = strchr(command_id_start, ',');
-        if (!command_id_end) {
-            command_id_end = strchr(command_id_start, '}');
-        }
-        if (command_id_end) {
-            *command_id_end = '\0'; // 临时截断字符串
-            int command_id = atoi(command_id_start);
-            
-            // 检查是否与最后处理的命令ID相同
-            if (command_id == g_last_command_id) {
-                // 恢复字符串
-                *command_id_end = ',';
-                printf("Duplicate command detected, skipping: %d\n", command_id);
-                return true;
-            }
-            
-            // 更新最后处理的命令ID
-            g_last_command_id = command_id;
-            // 恢复字符串
-            *command_id_end = ',';
+ * @brief 检查并记录命令ID
+ * @param command_id 命令ID
+ * @return true表示命令已处理过，false表示命令未处理过（已记入最近命令环）
+ */
+static bool check_command_duplicate(int64_t command_id) {
+    bool duplicate = false;
+
+    pthread_mutex_lock(&g_recent_command_mutex);
+    for (int i = 0; i < g_recent_command_count; i++) {
+        if (g_recent_command_ids[i] == command_id) {
+            duplicate = true;
+            break;
         }
     }
-    return false;
+    if (!duplicate) {
+        g_recent_command_ids[g_recent_command_next] = command_id;
+        g_recent_command_next = (g_recent_command_next + 1) % COMMAND_ID_HISTORY;
+        if (g_recent_command_count < COMMAND_ID_HISTORY) {
+            g_recent_command_count++;
+        }
+    }
+    pthread_mutex_unlock(&g_recent_command_mutex);
+
+    if (duplicate) {
+        printf("Duplicate command detected, skipping: %lld\n", (long long)command_id);
+    }
+    return duplicate;
 }
 
 /**
@@ -434,6 +418,85 @@ static bool check_command_duplicate(const void *payload, size_t payload_len) {
  */
 static fota_context_t *g_fota_ctx = NULL;
 
+/**
+ * @brief Air8000 固件流式转发通道
+ * @details 下载 Air8000 固件时，连续前缀边接收边转发给 UART 进程，串口升级与下载同时进行
+ */
+static fota_relay_t g_fota_relay;
+
+/**
+ * @brief FOTA连续前缀数据回调：转发给 UART 进程
+ * @details 通道满时在此阻塞，MQTT 接收随串口速度放缓；超时后本次会话停止转发
+ */
+static void on_fota_prefix_data(fota_context_t *ctx, uint64_t offset, const uint8_t *data, size_t len, void *user_data) {
+    (void)ctx;
+    (void)user_data;
+    if (fota_relay_active(&g_fota_relay)) {
+        fota_relay_send(&g_fota_relay, (uint32_t)offset, data, len);
+    }
+}
+
+/**
+ * @brief 为 Air8000 固件下载开始流式转发
+ * @param ctx 已创建、尚未 fota_start 的FOTA上下文
+ * @param file_size 固件大小
+ * @details 先写入 START 记录再通知 UART 进程，fota_start 续传时回读的前缀也经通道转发
+ */
+static void fota_relay_start_session(fota_context_t *ctx, uint64_t file_size) {
+    if (!g_fota_relay.open || g_mq_mqtt_to_uart == -1 || strcmp(ctx->file_path, DEFAULT_FOTA_FILE_PATH) != 0 ||
+        file_size > UINT32_MAX) {
+        return;
+    }
+
+    uint32_t session = fota_relay_begin(&g_fota_relay, (uint32_t)file_size, ctx->file_path);
+    if (session == 0) {
+        LOG_WARNING("FOTA relay unavailable, Air8000 will be updated from file");
+        return;
+    }
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_TYPE_FOTA_START;
+    msg.seq_num = g_seq_num++;
+    msg.timestamp = (uint32_t)time(NULL);
+    msg.data_len = sizeof(session);
+    memcpy(msg.payload.data, &session, sizeof(session));
+    if (mq_send_msg(g_mq_mqtt_to_uart, &msg, 0) != 0) {
+        LOG_WARNING("Failed to notify UART of FOTA relay: %s", strerror(errno));
+        fota_relay_end(&g_fota_relay, false);
+        return;
+    }
+
+    fota_set_data_callback(ctx, on_fota_prefix_data, NULL);
+    LOG_INFO("FOTA relay session %u started", session);
+}
+
+/**
+ * @brief Air8000 固件接收结束
+ * @param ctx FOTA上下文
+ * @param success 是否接收完成且校验通过
+ * @details 转发仍在进行时写入结束记录，由 UART 进程决定是否让 Air8000 切换固件；
+ *          转发中途停止（UART 进程未及时消费）时通知 UART 进程按文件升级
+ */
+static void fota_relay_finish_session(fota_context_t *ctx, bool success) {
+    if (fota_relay_active(&g_fota_relay)) {
+        fota_relay_end(&g_fota_relay, success);
+        return;
+    }
+    if (!success || g_mq_mqtt_to_uart == -1 || strcmp(ctx->file_path, DEFAULT_FOTA_FILE_PATH) != 0) {
+        return;
+    }
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_TYPE_FOTA_COMPLETE;
+    msg.seq_num = g_seq_num++;
+    msg.timestamp = (uint32_t)time(NULL);
+    if (mq_send_msg(g_mq_mqtt_to_uart, &msg, 0) != 0) {
+        LOG_ERROR("Failed to notify UART of FOTA file: %s", strerror(errno));
+    }
+}
+
 /**
  * @brief 设备状态枚举
  */
@@ -558,222 +621,759 @@ static void check_and_publish_status() {
 }
 
 /**
- * @brief 计算MD5校验和
+ * @brief 离线缓存目录：断网期间的数据写入这里，重连后按限速回放
  */
-static char *calculate_md5(const unsigned char *data, size_t len) {
-    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-    if (!ctx) return NULL;
+#define MQTT_SPOOL_DIR "/appfs/nfs/mqtt_spool"
 
-    unsigned char md5_hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
+/**
+ * @brief 离线缓存
+ */
+static mqtt_spool_t *g_spool = NULL;
 
-    if (EVP_DigestInit_ex(ctx, EVP_md5(), NULL) != 1 ||
-        EVP_DigestUpdate(ctx, data, len) != 1 ||
-        EVP_DigestFinal_ex(ctx, md5_hash, &hash_len) != 1) {
-        EVP_MD_CTX_free(ctx);
-        return NULL;
+/**
+ * @brief 发布消息；未连接或发布失败时写入离线缓存
+ * @param mqtt_msg 消息
+ * @return 已发布返回0，已写入离线缓存返回1，失败返回-1
+ */
+static int publish_or_spool(const mqtt_message_t *mqtt_msg)
+{
+    if (g_client && mqtt_client_get_state(g_client) == MQTT_CLIENT_STATE_CONNECTED) {
+        int rc = mqtt_client_publish(g_client, mqtt_msg);
+        if (rc == MQTT_ERR_SUCCESS) {
+            return 0;
+        }
+        LOG_WARNING("Failed to publish to %s: %d, spooling", mqtt_msg->topic, rc);
+    }
+    if (g_spool && mqtt_spool_append(g_spool, mqtt_msg->topic, mqtt_msg->payload,
+                                     mqtt_msg->payload_len, mqtt_msg->qos) == 0) {
+        return 1;
+    }
+    return -1;
+}
+
+/**
+ * @brief 回放一条离线缓存的消息
+ */
+static int replay_spooled_message(const mqtt_spool_record_t *record, void *user_data)
+{
+    (void)user_data;
+    mqtt_message_t mqtt_msg = {
+        .topic = record->topic,
+        .payload = record->payload,
+        .payload_len = record->payload_len,
+        .qos = (mqtt_qos_t)record->qos,
+        .retain = false
+    };
+    return mqtt_client_publish(g_client, &mqtt_msg) == MQTT_ERR_SUCCESS ? 0 : -1;
+}
+
+/**
+ * @brief 发布写入器中的JSON到设备主题
+ * @param topic_format 主题格式（%s 为设备ID）
+ * @param w 已写完的写入器
+ * @param qos QoS级别
+ * @param what 日志中的消息名称
+ * @return 已发布返回0，已写入离线缓存返回1，失败返回-1
+ */
+static int publish_device_json(const char *topic_format, json_writer_t *w, mqtt_qos_t qos, const char *what)
+{
+    char topic[256];
+    size_t json_len = 0;
+    const char *json_str = json_writer_finish(w, &json_len);
+    if (!json_str) {
+        LOG_ERROR("Failed to build %s JSON (%zu bytes buffer)", what, (size_t)JSON_WRITER_THREAD_BUFFER_SIZE);
+        return -1;
+    }
+    int n = snprintf(topic, sizeof(topic), topic_format, g_device_id);
+    if (n < 0 || (size_t)n >= sizeof(topic)) {
+        LOG_ERROR("Failed to build %s topic", what);
+        return -1;
+    }
+
+    mqtt_message_t mqtt_msg = {
+        .topic = topic,
+        .payload = json_str,
+        .payload_len = json_len,
+        .qos = qos,
+        .retain = false
+    };
+    int rc = publish_or_spool(&mqtt_msg);
+    if (rc < 0) {
+        LOG_ERROR("Failed to publish %s, message lost", what);
+        return -1;
+    }
+    LOG_DEBUG("%s %s to %s: %s", rc == 0 ? "Published" : "Spooled", what, topic, json_str);
+    return rc;
+}
+
+/**
+ * @brief 遥测聚合配置，可在编译时用 -D 覆盖
+ * @details 传感器样本按窗口或条数合并成一条批量消息发布到 device/{device_id}/telemetry
+ *          （CBOR 格式发布到 device/{device_id}/telemetry/cbor）
+ */
+#ifndef TELEMETRY_WINDOW_MS
+#define TELEMETRY_WINDOW_MS 10000
+#endif
+#ifndef TELEMETRY_MAX_SAMPLES
+#define TELEMETRY_MAX_SAMPLES 32
+#endif
+#ifndef TELEMETRY_FORMAT
+#define TELEMETRY_FORMAT TELEMETRY_FORMAT_JSON
+#endif
+#ifndef TELEMETRY_DELTA
+#define TELEMETRY_DELTA 1
+#endif
+
+/**
+ * @brief 遥测聚合器与序列ID（只在主循环线程中使用）
+ */
+static telemetry_batch_t *g_telemetry = NULL;
+static int g_series_sensor = -1;
+static int g_series_heartbeat = -1;
+
+/**
+ * @brief 发布一批遥测样本
+ */
+static void on_telemetry_batch(const void *payload, size_t len, telemetry_format_t format,
+                               size_t sample_count, void *user_data)
+{
+    (void)user_data;
+    char topic[256];
+    snprintf(topic, sizeof(topic), format == TELEMETRY_FORMAT_CBOR ? "device/%s/telemetry/cbor" : "device/%s/telemetry",
+             g_device_id);
+
+    mqtt_message_t mqtt_msg = {
+        .topic = topic,
+        .payload = payload,
+        .payload_len = len,
+        .qos = MQTT_QOS_1,
+        .retain = false
+    };
+    int rc = publish_or_spool(&mqtt_msg);
+    if (rc < 0) {
+        LOG_ERROR("Failed to publish telemetry batch, %zu samples lost", sample_count);
+    } else {
+        LOG_DEBUG("%s %zu telemetry samples (%zu bytes) to %s", rc == 0 ? "Published" : "Spooled",
+                  sample_count, len, topic);
+    }
+}
+
+/**
+ * @brief 创建遥测聚合器并注册序列
+ */
+static bool init_telemetry(void)
+{
+    static const char *const sensor_fields[] = { "temperature_c", "humidity", "light", "battery" };
+
+    telemetry_batch_config_t config;
+    telemetry_batch_default_config(&config);
+    config.window_ms = TELEMETRY_WINDOW_MS;
+    config.max_samples = TELEMETRY_MAX_SAMPLES;
+    config.format = TELEMETRY_FORMAT;
+    config.delta = TELEMETRY_DELTA;
+    config.device_id = g_device_id;
+
+    g_telemetry = telemetry_batch_create(&config, on_telemetry_batch, NULL);
+    if (!g_telemetry) {
+        return false;
+    }
+    // 温度以0.01摄氏度为单位，保持整数便于差值编码
+    g_series_sensor = telemetry_batch_add_series(g_telemetry, "sensor", sensor_fields,
+                                                 sizeof(sensor_fields) / sizeof(sensor_fields[0]));
+    g_series_heartbeat = telemetry_batch_add_series(g_telemetry, "heartbeat", NULL, 0);
+    return true;
+}
+
+/**
+ * @brief 立即发送已聚合的遥测样本
+ */
+static void flush_telemetry(void)
+{
+    if (g_telemetry) {
+        telemetry_batch_flush(g_telemetry);
+    }
+}
+
+/**
+ * @brief 指标摘要发布周期（秒），0表示不发布，可在编译时用 -D 覆盖
+ * @details 摘要发布到 device/{device_id}/metrics，只包含主要计数器、延迟分位数和队列深度；
+ *          完整指标用 `process_manager stats` 在本机查看
+ */
+#ifndef METRICS_SUMMARY_INTERVAL
+#define METRICS_SUMMARY_INTERVAL 0
+#endif
+
+/**
+ * @brief 写入消息队列当前深度，队列不可用时跳过
+ */
+static void add_queue_depth(json_writer_t *w, const char *key, int mq_fd)
+{
+    struct msqid_ds attr;
+    if (mq_fd != -1 && mq_get_attr(mq_fd, &attr) == 0) {
+        json_writer_add_uint(w, key, (uint64_t)attr.msg_qnum);
+    }
+}
+
+/**
+ * @brief 周期发布指标摘要（只在主循环线程中调用）
+ */
+static void check_and_publish_metrics(void)
+{
+    static time_t s_last_publish = 0;
+    pm_metrics_snapshot_t snap;
+
+    time_t now = time(NULL);
+    if (METRICS_SUMMARY_INTERVAL <= 0 || now - s_last_publish < METRICS_SUMMARY_INTERVAL) {
+        return;
+    }
+    s_last_publish = now;
+    if (!g_client || mqtt_client_get_state(g_client) != MQTT_CLIENT_STATE_CONNECTED ||
+        pm_metrics_snapshot(&snap) != 0) {
+        return;
+    }
+
+    json_writer_t *w = json_writer_thread();
+    json_writer_object_begin(w);
+    json_writer_add_string(w, "device_id", g_device_id);
+    json_writer_add_uint(w, "timestamp", (uint64_t)now);
+    json_writer_add_uint(w, "uptime_s", (snap.taken_ms - snap.created_ms) / 1000);
+    json_writer_add_uint(w, "uart_rx", snap.counters[PM_CNT_UART_RX_FRAMES]);
+    json_writer_add_uint(w, "uart_tx", snap.counters[PM_CNT_UART_TX_FRAMES]);
+    json_writer_add_uint(w, "uart_crc_err", snap.counters[PM_CNT_UART_CRC_ERRORS]);
+    json_writer_add_uint(w, "uart_timeouts", snap.counters[PM_CNT_UART_TIMEOUTS]);
+    json_writer_add_uint(w, "uart_rtt_p50_us", pm_metrics_percentile(&snap.hists[PM_HIST_UART_RTT], 0.5));
+    json_writer_add_uint(w, "uart_rtt_p99_us", pm_metrics_percentile(&snap.hists[PM_HIST_UART_RTT], 0.99));
+    json_writer_add_uint(w, "uart_io_csw_inv", snap.counters[PM_CNT_UART_IO_CSW_INVOLUNTARY]);
+    json_writer_add_uint(w, "ipc_err", snap.counters[PM_CNT_IPC_ERRORS]);
+    add_queue_depth(w, "q_uart_to_mqtt", g_mq_uart_to_mqtt);
+    add_queue_depth(w, "q_mqtt_to_uart", g_mq_mqtt_to_uart);
+    json_writer_add_uint(w, "mqtt_pub", snap.counters[PM_CNT_MQTT_PUBLISHED]);
+    json_writer_add_uint(w, "mqtt_pub_err", snap.counters[PM_CNT_MQTT_PUBLISH_ERRORS]);
+    json_writer_add_uint(w, "mqtt_pub_p99_us", pm_metrics_percentile(&snap.hists[PM_HIST_MQTT_PUBLISH], 0.99));
+    json_writer_add_uint(w, "upload_bytes", snap.counters[PM_CNT_MQTT_UPLOAD_BYTES]);
+    json_writer_object_end(w);
+    size_t len = 0;
+    const char *json_str = json_writer_finish(w, &len);
+    if (!json_str) {
+        return;
+    }
+
+    char topic[256];
+    snprintf(topic, sizeof(topic), "device/%s/metrics", g_device_id);
+    mqtt_message_t mqtt_msg = {
+        .topic = topic,
+        .payload = json_str,
+        .payload_len = len,
+        .qos = MQTT_QOS_0,
+        .retain = false
+    };
+    if (mqtt_client_publish(g_client, &mqtt_msg) != MQTT_ERR_SUCCESS) {
+        LOG_DEBUG("Failed to publish metrics summary");
+    }
+}
+
+/**
+ * @brief FOTA回调函数
+ */
+static void fota_callback_handler(fota_context_t *ctx, fota_state_t state, fota_error_t error, void *user_data) {
+    (void)user_data;
+    
+    printf("FOTA Callback: state=%d, error=%d, progress=%d%%\n", 
+           state, error, ctx->progress);
+    
+    switch (state) {
+        case FOTA_STATE_RECEIVING:
+            printf("FOTA: Receiving... %d%%\n", ctx->progress);
+            // 发布下载中状态
+            publish_device_status(DEVICE_STATUS_DOWNLOADING);
+            break;
+        case FOTA_STATE_COMPLETE:
+            printf("FOTA: Receiving complete\n");
+            break;
+        case FOTA_STATE_SAVED:
+            printf("FOTA: File saved successfully to %s\n", ctx->file_path);
+            // 发布在线状态
+            publish_device_status(DEVICE_STATUS_ONLINE);
+            
+            // 直接发布FOTA完成响应到MQTT：device/{device_id}/file/download/response
+            LOG_INFO("Publishing FOTA complete response directly");
+            {
+                // 使用文件名作为文件ID
+                const char *filename = strrchr(ctx->file_path, '/');
+                filename = filename ? filename + 1 : ctx->file_path;
+
+                json_writer_t *w = json_writer_thread();
+                json_writer_object_begin(w);
+                json_writer_add_string(w, "file_id", filename);
+                json_writer_add_string(w, "file_name", filename);
+                json_writer_add_string(w, "status", "completed");
+                json_writer_key(w, "data");
+                json_writer_object_begin(w);
+                json_writer_add_string(w, "file_path", ctx->file_path);
+                json_writer_add_uint(w, "file_size", ctx->file_size);
+                json_writer_add_string(w, "checksum", ctx->checksum);
+                json_writer_add_string(w, "message", "FOTA update completed successfully");
+                json_writer_object_end(w);
+                json_writer_add_int(w, "timestamp", (int64_t)time(NULL));
+                json_writer_object_end(w);
+                publish_device_json("device/%s/file/download/response", w, MQTT_QOS_1, "FOTA complete");
+            }
+            break;
+        case FOTA_STATE_FAILED:
+            printf("FOTA: Failed with error %d\n", error);
+            // 发布错误状态
+            publish_device_status(DEVICE_STATUS_ERROR);
+            
+            // 直接发布FOTA失败响应到MQTT：device/{device_id}/file/download/response
+            LOG_INFO("Publishing FOTA error response directly");
+            {
+                json_writer_t *w = json_writer_thread();
+                json_writer_object_begin(w);
+                json_writer_add_string(w, "file_id", "unknown");
+                json_writer_add_string(w, "file_name", "unknown");
+                json_writer_add_string(w, "status", "error");
+                json_writer_key(w, "data");
+                json_writer_object_begin(w);
+                json_writer_add_string(w, "message", "FOTA update failed");
+                json_writer_add_int(w, "error_code", error);
+                json_writer_object_end(w);
+                json_writer_add_int(w, "timestamp", (int64_t)time(NULL));
+                json_writer_object_end(w);
+                publish_device_json("device/%s/file/download/response", w, MQTT_QOS_1, "FOTA error");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief 单次缺片响应最多列出的分片数，其余在下次结束命令时再报告
+ */
+#define FOTA_MISSING_REPORT_MAX 256
+
+/**
+ * @brief 结束命令到达时仍有缺失分片：报告缺失列表，服务器只需重发这些分片
+ */
+static void publish_fota_missing_chunks(fota_context_t *ctx)
+{
+    uint32_t missing[FOTA_MISSING_REPORT_MAX];
+    uint32_t missing_count = fota_get_missing_chunks(ctx, missing, FOTA_MISSING_REPORT_MAX);
+    uint32_t listed = missing_count < FOTA_MISSING_REPORT_MAX ? missing_count : FOTA_MISSING_REPORT_MAX;
+    LOG_WARNING("FOTA finish with %u of %u chunks missing", missing_count, ctx->total_chunks);
+
+    const char *filename = strrchr(ctx->file_path, '/');
+    filename = filename ? filename + 1 : ctx->file_path;
+
+    json_writer_t *w = json_writer_thread();
+    json_writer_object_begin(w);
+    json_writer_add_string(w, "file_id", filename);
+    json_writer_add_string(w, "file_name", filename);
+    json_writer_add_string(w, "status", "missing");
+    json_writer_key(w, "data");
+    json_writer_object_begin(w);
+    json_writer_key(w, "missing_chunks");
+    json_writer_array_begin(w);
+    for (uint32_t i = 0; i < listed; i++) {
+        json_writer_uint(w, missing[i]);
+    }
+    json_writer_array_end(w);
+    json_writer_add_uint(w, "missing_count", missing_count);
+    json_writer_add_uint(w, "received_chunks", ctx->received_chunks);
+    json_writer_add_uint(w, "total_chunks", ctx->total_chunks);
+    json_writer_object_end(w);
+    json_writer_add_int(w, "timestamp", (int64_t)time(NULL));
+    json_writer_object_end(w);
+
+    if (publish_device_json("device/%s/file/download/response", w, MQTT_QOS_1, "FOTA missing chunks") >= 0) {
+        LOG_INFO("Requested %u missing FOTA chunks", listed);
+    }
+}
+
+/**
+ * @brief 信号处理函数：用于优雅退出
+ */
+static void signal_handler(int sig) {
+    printf("\nReceived signal %d, stopping MQTT client...\n", sig);
+    g_running = false;
+}
+
+/**
+ * @brief 开始一次分片编码协商
+ * @return 协商槽位，无空闲槽位返回-1（直接使用 hex/JSON）
+ */
+static int upload_negotiation_begin(const char *file_id)
+{
+    int slot = -1;
+    pthread_mutex_lock(&g_upload_neg_mutex);
+    for (int i = 0; i < UPLOAD_NEGOTIATION_SLOTS; i++) {
+        if (!g_upload_neg[i].in_use) {
+            slot = i;
+            g_upload_neg[i].in_use = true;
+            strncpy(g_upload_neg[i].file_id, file_id, sizeof(g_upload_neg[i].file_id) - 1);
+            g_upload_neg[i].file_id[sizeof(g_upload_neg[i].file_id) - 1] = '\0';
+            g_upload_neg[i].encoding = UPLOAD_ENCODING_PENDING;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_upload_neg_mutex);
+    return slot;
+}
+
+/**
+ * @brief 记录服务器在 started 响应中选择的分片编码
+ * @details 由 MQTT 回调线程调用；file_id 不属于任何进行中的协商时忽略
+ */
+static void upload_negotiation_answer(const char *file_id, const char *encoding)
+{
+    pthread_mutex_lock(&g_upload_neg_mutex);
+    for (int i = 0; i < UPLOAD_NEGOTIATION_SLOTS; i++) {
+        upload_negotiation_t *neg = &g_upload_neg[i];
+        if (neg->in_use && neg->encoding == UPLOAD_ENCODING_PENDING && strcmp(file_id, neg->file_id) == 0) {
+            neg->encoding = (encoding && strcmp(encoding, "binary") == 0) ? UPLOAD_ENCODING_BINARY : UPLOAD_ENCODING_HEX;
+            pthread_cond_broadcast(&g_upload_neg_cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_upload_neg_mutex);
+}
+
+/**
+ * @brief 等待协商结果并释放槽位，超时未收到 started 响应时退回 hex/JSON
+ * @param slot upload_negotiation_begin 返回的槽位，<0 时仅释放
+ */
+static upload_encoding_t upload_negotiation_wait(int slot, int timeout_ms)
+{
+    if (slot < 0) {
+        return UPLOAD_ENCODING_HEX;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    upload_negotiation_t *neg = &g_upload_neg[slot];
+    pthread_mutex_lock(&g_upload_neg_mutex);
+    while (timeout_ms > 0 && neg->encoding == UPLOAD_ENCODING_PENDING) {
+        if (pthread_cond_timedwait(&g_upload_neg_cond, &g_upload_neg_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    upload_encoding_t encoding = neg->encoding == UPLOAD_ENCODING_PENDING ? UPLOAD_ENCODING_HEX : neg->encoding;
+    neg->in_use = false;
+    neg->file_id[0] = '\0';
+    pthread_mutex_unlock(&g_upload_neg_mutex);
+    return encoding;
+}
+
+/**
+ * @brief 分片发送窗口参数
+ * @details 窗口按 RTT 自适应：RTT 接近最小值时每个 RTT 加一，明显升高时减小，
+ *          超时重发时减半；RTO 按 RFC 6298 由平滑 RTT 计算
+ */
+#define UPLOAD_WINDOW_MAX 16
+#define UPLOAD_WINDOW_INIT 4
+#define UPLOAD_RTO_MIN_MS 500
+#define UPLOAD_STALL_TIMEOUT_MS 30000
+
+/**
+ * @brief 一个在途分片
+ */
+typedef struct {
+    bool in_use;
+    uint32_t chunk_id;
+    int mid;                    // -1 表示尚未发出或连接断开后需要重发
+    uint64_t sent_ms;
+    int retries;
+    bool retransmitted;         // 重发过的分片不参与 RTT 采样（Karn 算法）
+} upload_slot_t;
+
+/**
+ * @brief 分片发送窗口，由上传线程和 MQTT 回调线程共享
+ * @details 每个已发出的异步发布持有一个引用：超时重发后旧 mid 的 PUBACK
+ *          可能在上传结束后才到，窗口由最后一个引用释放
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    int refs;
+    bool closed;                // 上传已结束，迟到的回调只释放引用
+    pthread_cond_t cond;
+    upload_slot_t slots[UPLOAD_WINDOW_MAX];
+    int inflight;
+    double window;
+    uint64_t srtt_ms;
+    uint64_t rttvar_ms;
+    uint64_t min_rtt_ms;
+    uint64_t last_backoff_ms;
+    uint64_t last_progress_ms;
+    uint32_t acked;
+} upload_window_t;
+
+static uint64_t upload_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 在 w->mutex 下释放一个引用，返回true时调用方需在解锁后销毁窗口
+ */
+static bool upload_window_unref_locked(upload_window_t *w)
+{
+    return --w->refs == 0;
+}
+
+static void upload_window_destroy(upload_window_t *w)
+{
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+    free(w);
+}
+
+static uint64_t upload_rto_ms(const upload_window_t *w)
+{
+    if (w->srtt_ms == 0) {
+        return FILE_UPLOAD_OPERATION_TIMEOUT_MS;
+    }
+    uint64_t rto = w->srtt_ms + 4 * w->rttvar_ms;
+    if (rto < UPLOAD_RTO_MIN_MS) {
+        rto = UPLOAD_RTO_MIN_MS;
+    }
+    if (rto > FILE_UPLOAD_OPERATION_TIMEOUT_MS) {
+        rto = FILE_UPLOAD_OPERATION_TIMEOUT_MS;
+    }
+    return rto;
+}
+
+/**
+ * @brief 异步发布完成回调（MQTT 事件循环线程）
+ */
+static void on_upload_chunk_complete(int mid, int result, void *user_data)
+{
+    upload_window_t *w = (upload_window_t *)user_data;
+    uint64_t now = upload_now_ms();
+
+    pthread_mutex_lock(&w->mutex);
+    for (int i = 0; i < UPLOAD_WINDOW_MAX && !w->closed; i++) {
+        upload_slot_t *slot = &w->slots[i];
+        if (!slot->in_use || slot->mid != mid) {
+            continue;
+        }
+        if (result != MQTT_ERR_SUCCESS) {
+            // 连接断开，重连后只重发该分片
+            slot->mid = -1;
+            break;
+        }
+
+        if (!slot->retransmitted) {
+            uint64_t rtt = now - slot->sent_ms;
+            if (w->srtt_ms == 0) {
+                w->srtt_ms = rtt ? rtt : 1;
+                w->rttvar_ms = rtt / 2;
+                w->min_rtt_ms = w->srtt_ms;
+            } else {
+                uint64_t diff = rtt > w->srtt_ms ? rtt - w->srtt_ms : w->srtt_ms - rtt;
+                w->rttvar_ms = (3 * w->rttvar_ms + diff) / 4;
+                w->srtt_ms = (7 * w->srtt_ms + rtt) / 8;
+                if (rtt < w->min_rtt_ms) {
+                    w->min_rtt_ms = rtt ? rtt : 1;
+                }
+            }
+            // RTT 明显高于最小值说明链路开始排队
+            if (rtt > 2 * w->min_rtt_ms) {
+                w->window -= 0.5 / w->window;
+                if (w->window < 1.0) {
+                    w->window = 1.0;
+                }
+            } else if (w->window < UPLOAD_WINDOW_MAX) {
+                w->window += 1.0 / w->window;
+            }
+        }
+
+        slot->in_use = false;
+        w->inflight--;
+        w->acked++;
+        pm_metrics_add(PM_CNT_MQTT_UPLOAD_CHUNKS, 1);
+        w->last_progress_ms = now;
+        break;
+    }
+    pthread_cond_signal(&w->cond);
+    bool last = upload_window_unref_locked(w);
+    pthread_mutex_unlock(&w->mutex);
+    if (last) {
+        upload_window_destroy(w);
+    }
+}
+
+/**
+ * @brief 组装并异步发布一个分片
+ * @details 在 w->mutex 下调用，mid 在解锁前写入分片槽，回调不会错过早到的 PUBACK
+ */
+static int upload_send_chunk(upload_window_t *w, upload_slot_t *slot, file_upload_context_t *upload_ctx,
+                             upload_encoding_t encoding, const char *topic, uint8_t *buffer, size_t buffer_size)
+{
+    const uint8_t *chunk_data = NULL;
+    size_t chunk_data_len = 0;
+    if (!file_upload_map_chunk(upload_ctx, slot->chunk_id, &chunk_data, &chunk_data_len)) {
+        return MQTT_ERR_INVALID_PARAM;
     }
 
-    char *md5_str = (char *)malloc(hash_len * 2 + 1);
-    if (md5_str) {
-        for (unsigned int i = 0; i < hash_len; i++) {
-            snprintf(md5_str + i * 2, 3, "%02x", md5_hash[i]);
-        }
-        md5_str[hash_len * 2] = '\0';
+    size_t payload_len = encoding == UPLOAD_ENCODING_BINARY
+        ? file_upload_encode_binary_chunk(upload_ctx, slot->chunk_id, chunk_data, chunk_data_len,
+                                          buffer, buffer_size)
+        : file_upload_encode_hex_chunk(upload_ctx, slot->chunk_id, chunk_data, chunk_data_len,
+                                       (char *)buffer, buffer_size);
+    if (payload_len == 0) {
+        return MQTT_ERR_INVALID_PARAM;
     }
 
-    EVP_MD_CTX_free(ctx);
-    return md5_str;
+    mqtt_message_t mqtt_msg = {
+        .topic = topic,
+        .payload = buffer,
+        .payload_len = payload_len,
+        .qos = MQTT_QOS_1,
+        .retain = false
+    };
+    int mid = -1;
+    int rc = mqtt_client_publish_async(g_client, &mqtt_msg, on_upload_chunk_complete, w, &mid);
+    slot->mid = rc == MQTT_ERR_SUCCESS ? mid : -1;
+    if (rc == MQTT_ERR_SUCCESS) {
+        w->refs++;
+        pm_metrics_add(PM_CNT_MQTT_UPLOAD_BYTES, chunk_data_len);
+    }
+    slot->sent_ms = upload_now_ms();
+    return rc;
 }
 
 /**
- * @brief FOTA回调函数
+ * @brief 以自适应窗口发送全部分片，只重发未确认的分片
+ * @return 全部分片都收到 PUBACK 返回true
  */
-static void fota_callback_handler(fota_context_t *ctx, fota_state_t state, fota_error_t error, void *user_data) {
-    (void)user_data;
-    
-    printf("FOTA Callback: state=%d, error=%d, progress=%d%%\n", 
-           state, error, ctx->progress);
-    
-    switch (state) {
-        case FOTA_STATE_RECEIVING:
-            printf("FOTA: Receiving... %d%%\n", ctx->progress);
-            // 发布下载中状态
-            publish_device_status(DEVICE_STATUS_DOWNLOADING);
-            break;
-        case FOTA_STATE_COMPLETE:
-            printf("FOTA: Receiving complete\n");
+static bool upload_chunks_windowed(file_upload_context_t *upload_ctx, upload_encoding_t encoding,
+                                   const char *topic, uint8_t *buffer, size_t buffer_size)
+{
+    upload_window_t *w = (upload_window_t *)calloc(1, sizeof(upload_window_t));
+    if (!w) {
+        return false;
+    }
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&w->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    w->refs = 1;
+    w->window = UPLOAD_WINDOW_INIT;
+    w->last_progress_ms = upload_now_ms();
+
+    uint32_t total = upload_ctx->total_chunks;
+    uint32_t next_chunk = 0;
+    bool ok = true;
+
+    pthread_mutex_lock(&w->mutex);
+    while (w->acked < total) {
+        uint64_t now = upload_now_ms();
+        uint64_t rto = upload_rto_ms(w);
+        if (now - w->last_progress_ms >= UPLOAD_STALL_TIMEOUT_MS || !g_running) {
+            printf("Upload stalled: %u/%u chunks acknowledged\n", w->acked, total);
+            ok = false;
             break;
-        case FOTA_STATE_SAVED:
-            printf("FOTA: File saved successfully to %s\n", ctx->file_path);
-            // 发布在线状态
-            publish_device_status(DEVICE_STATUS_ONLINE);
-            
-            // 直接发布FOTA完成响应到MQTT
-            LOG_INFO("Publishing FOTA complete response directly");
-            // 构建文件下载响应主题：device/{device_id}/file/download/response
-            char *fota_complete_topic = build_topic(g_device_id, "device/%s/file/download/response");
-            if (fota_complete_topic) {
-                // 构建结构化的升级响应JSON
-                cJSON *root = cJSON_CreateObject();
-                if (root != NULL) {
-                    // 添加file_id字段（使用文件名作为文件ID）
-                    char file_id[256] = {0};
-                    const char *filename = strrchr(ctx->file_path, '/');
-                    if (filename) {
-                        strncpy(file_id, filename + 1, sizeof(file_id) - 1);
-                    } else {
-                        strncpy(file_id, ctx->file_path, sizeof(file_id) - 1);
-                    }
-                    cJSON_AddStringToObject(root, "file_id", file_id);
-                    
-                    // 添加file_name字段
-                    cJSON_AddStringToObject(root, "file_name", file_id);
-                    
-                    // 添加status字段
-                    cJSON_AddStringToObject(root, "status", "completed");
-                    
-                    // 添加data字段
-                    cJSON *data = cJSON_CreateObject();
-                    cJSON_AddStringToObject(data, "file_path", ctx->file_path);
-                    cJSON_AddNumberToObject(data, "file_size", ctx->file_size);
-                    cJSON_AddStringToObject(data, "checksum", ctx->checksum);
-                    cJSON_AddStringToObject(data, "message", "FOTA update completed successfully");
-                    cJSON_AddItemToObject(root, "data", data);
-                    
-                    // 添加timestamp字段
-                    cJSON_AddNumberToObject(root, "timestamp", (int)time(NULL));
-                    
-                    // 生成JSON字符串
-                    char *json_str = cJSON_PrintUnformatted(root);
-                    if (json_str != NULL) {
-                        // 准备MQTT消息
-                        mqtt_message_t mqtt_msg = {
-                            .topic = fota_complete_topic, // 消息主题
-                            .payload = json_str,         // 消息内容
-                            .payload_len = strlen(json_str), // 消息长度
-                            .qos = MQTT_QOS_1,           // QoS级别1（至少一次）
-                            .retain = false              // 非保留消息
-                        };
-                        
-                        // 检查MQTT客户端是否有效
-                        if (g_client) {
-                            // 发布消息
-                            int rc = mqtt_client_publish(g_client, &mqtt_msg);
-                            if (rc != MQTT_ERR_SUCCESS) {
-                                LOG_ERROR("Failed to publish FOTA complete: %d", rc);
-                            } else {
-                                LOG_INFO("Published FOTA complete to %s", fota_complete_topic);
-                                LOG_INFO("FOTA complete response: %s", json_str);
-                            }
-                        } else {
-                            LOG_ERROR("MQTT client not initialized, cannot publish FOTA complete");
-                        }
-                        
-                        // 释放JSON字符串
-                    cJSON_free(json_str);
+        }
+
+        bool connected = mqtt_client_get_state(g_client) == MQTT_CLIENT_STATE_CONNECTED;
+        uint64_t wake_ms = now + 100;
+
+        // 重发超时或因断线丢失的分片
+        for (int i = 0; i < UPLOAD_WINDOW_MAX && connected && ok; i++) {
+            upload_slot_t *slot = &w->slots[i];
+            if (!slot->in_use) {
+                continue;
+            }
+            bool lost = slot->mid < 0;
+            if (!lost && now - slot->sent_ms < rto) {
+                if (slot->sent_ms + rto < wake_ms) {
+                    wake_ms = slot->sent_ms + rto;
                 }
-                
-                // 释放JSON对象
-                cJSON_Delete(root);
-                } else {
-                    LOG_ERROR("Failed to create FOTA complete response JSON");
+                continue;
+            }
+            if (!lost) {
+                if (slot->retries >= FILE_UPLOAD_MAX_RETRY_COUNT) {
+                    printf("Chunk %u not acknowledged after %d retries\n", slot->chunk_id, slot->retries);
+                    ok = false;
+                    break;
                 }
-                
-                // 释放主题内存
-                free(fota_complete_topic);
-            } else {
-                LOG_ERROR("Failed to build FOTA complete topic");
+                slot->retries++;
+                // 每个 RTO 内最多退避一次
+                if (now - w->last_backoff_ms >= rto) {
+                    w->window = w->window / 2 < 1.0 ? 1.0 : w->window / 2;
+                    w->last_backoff_ms = now;
+                }
+                printf("Chunk %u timed out (rto %llu ms), retransmitting\n", slot->chunk_id, (unsigned long long)rto);
             }
+            slot->retransmitted = true;
+            upload_send_chunk(w, slot, upload_ctx, encoding, topic, buffer, buffer_size);
+        }
+        if (!ok) {
             break;
-        case FOTA_STATE_FAILED:
-            printf("FOTA: Failed with error %d\n", error);
-            // 发布错误状态
-            publish_device_status(DEVICE_STATUS_ERROR);
-            
-            // 直接发布FOTA失败响应到MQTT
-            LOG_INFO("Publishing FOTA error response directly");
-            // 构建文件下载响应主题：device/{device_id}/file/download/response
-            char *fota_error_topic = build_topic(g_device_id, "device/%s/file/download/response");
-            if (fota_error_topic) {
-                // 构建结构化的错误响应JSON
-                cJSON *root = cJSON_CreateObject();
-                if (root != NULL) {
-                    // 添加file_id字段
-                    cJSON_AddStringToObject(root, "file_id", "unknown");
-                    
-                    // 添加file_name字段
-                    cJSON_AddStringToObject(root, "file_name", "unknown");
-                    
-                    // 添加status字段
-                    cJSON_AddStringToObject(root, "status", "error");
-                    
-                    // 添加data字段
-                    cJSON *data = cJSON_CreateObject();
-                    cJSON_AddStringToObject(data, "message", "FOTA update failed");
-                    cJSON_AddNumberToObject(data, "error_code", error);
-                    cJSON_AddItemToObject(root, "data", data);
-                    
-                    // 添加timestamp字段
-                    cJSON_AddNumberToObject(root, "timestamp", (int)time(NULL));
-                    
-                    // 生成JSON字符串
-                    char *json_str = cJSON_PrintUnformatted(root);
-                    if (json_str != NULL) {
-                        // 准备MQTT消息
-                        mqtt_message_t mqtt_msg = {
-                            .topic = fota_error_topic,  // 消息主题
-                            .payload = json_str,        // 消息内容
-                            .payload_len = strlen(json_str), // 消息长度
-                            .qos = MQTT_QOS_1,           // QoS级别1（至少一次）
-                            .retain = false              // 非保留消息
-                        };
-                        
-                        // 检查MQTT客户端是否有效
-                        if (g_client) {
-                            // 发布消息
-                            int rc = mqtt_client_publish(g_client, &mqtt_msg);
-                            if (rc != MQTT_ERR_SUCCESS) {
-                                LOG_ERROR("Failed to publish FOTA error: %d", rc);
-                            } else {
-                                LOG_INFO("Published FOTA error to %s", fota_error_topic);
-                                LOG_INFO("FOTA error response: %s", json_str);
-                            }
-                        } else {
-                            LOG_ERROR("MQTT client not initialized, cannot publish FOTA error");
-                        }
-                        
-                        // 释放JSON字符串
-                        cJSON_free(json_str);
-                    }
-                    
-                    // 释放JSON对象
-                    cJSON_Delete(root);
-                } else {
-                    LOG_ERROR("Failed to create FOTA error response JSON");
+        }
+
+        // 窗口内补发新分片
+        while (connected && next_chunk < total && w->inflight < (int)w->window) {
+            upload_slot_t *slot = NULL;
+            for (int i = 0; i < UPLOAD_WINDOW_MAX; i++) {
+                if (!w->slots[i].in_use) {
+                    slot = &w->slots[i];
+                    break;
                 }
-                
-                // 释放主题内存
-                free(fota_error_topic);
-            } else {
-                LOG_ERROR("Failed to build FOTA error topic");
             }
+            if (!slot) {
+                break;
+            }
+            memset(slot, 0, sizeof(*slot));
+            slot->in_use = true;
+            slot->chunk_id = next_chunk++;
+            w->inflight++;
+            if (upload_send_chunk(w, slot, upload_ctx, encoding, topic, buffer, buffer_size) != MQTT_ERR_SUCCESS) {
+                break;
+            }
+        }
+
+        if (w->acked >= total) {
             break;
-        default:
-            break;
+        }
+        struct timespec deadline = {
+            .tv_sec = (time_t)(wake_ms / 1000),
+            .tv_nsec = (long)(wake_ms % 1000) * 1000000L
+        };
+        uint32_t acked_before = w->acked;
+        pthread_cond_timedwait(&w->cond, &w->mutex, &deadline);
+        if (w->acked != acked_before) {
+            printf("Acknowledged %u/%u chunks, window %.1f, srtt %llu ms\n",
+                   w->acked, total, w->window, (unsigned long long)w->srtt_ms);
+        }
     }
-}
-
-/**
- * @brief 信号处理函数：用于优雅退出
- */
-static void signal_handler(int sig) {
-    printf("\nReceived signal %d, stopping MQTT client...\n", sig);
-    g_running = false;
+    w->closed = true;
+    bool last = upload_window_unref_locked(w);
+    pthread_mutex_unlock(&w->mutex);
+    if (last) {
+        upload_window_destroy(w);
+    }
+    return ok;
 }
 
 /**
  * @brief 处理文件分片上传
+ * @details start 消息声明支持的分片编码（binary、hex），服务器在 started 响应中
+ *          以 data.encoding 选择。binary 模式每片为 file_upload_binary_header_t
+ *          加原始数据，发布到 file/upload/binary 主题；未声明或超时则退回
+ *          file/upload 主题上的 hex/JSON 分片。两种模式的数据都直接取自文件映射区，
+ *          以 QoS1 窗口发送，见 upload_chunks_windowed。
  */
 static bool handle_file_chunk_upload(const char *device_id, const char *file_path) {
     // 创建上传上下文，减小分片大小以减少JSON解析失败的可能性
@@ -795,9 +1395,12 @@ static bool handle_file_chunk_upload(const char *device_id, const char *file_pat
 
     // 构建文件上传主题
     char *file_topic = build_topic(device_id, "device/%s/file/upload");
-    if (!file_topic) {
+    char *binary_topic = build_topic(device_id, FILE_UPLOAD_BINARY_TOPIC);
+    if (!file_topic || !binary_topic) {
         printf("Failed to build file topic\n");
         file_upload_destroy(upload_ctx);
+        free(file_topic);
+        free(binary_topic);
         return false;
     }
 
@@ -807,16 +1410,21 @@ static bool handle_file_chunk_upload(const char *device_id, const char *file_pat
         printf("Failed to calculate file checksum\n");
         file_upload_destroy(upload_ctx);
         free(file_topic);
+        free(binary_topic);
         return false;
     }
     printf("File SHA256: %s\n", full_checksum);
 
-    // 发送Start消息
+    // 发送Start消息，声明支持的分片编码
+    int neg_slot = upload_negotiation_begin(upload_ctx->file_id);
     char start_payload[1024];
     int start_len = snprintf(start_payload, sizeof(start_payload), 
-             "{\"type\":\"start\",\"file_id\":\"%s\",\"file_name\":\"%s\",\"file_size\":%llu,\"total_chunks\":%u,\"checksum\":\"%s\"}",
-             upload_ctx->file_id, upload_ctx->filename, (unsigned long long)upload_ctx->file_size, upload_ctx->total_chunks, full_checksum);
+             "{\"type\":\"start\",\"file_id\":\"%s\",\"file_name\":\"%s\",\"file_size\":%llu,\"total_chunks\":%u,\"chunk_size\":%u,\"checksum\":\"%s\","
+             "\"encodings\":[\"binary\",\"hex\"],\"bin_id\":%u}",
+             upload_ctx->file_id, upload_ctx->filename, (unsigned long long)upload_ctx->file_size, upload_ctx->total_chunks,
+             upload_ctx->chunk_size, full_checksum, upload_ctx->bin_id);
     
+    upload_encoding_t encoding = UPLOAD_ENCODING_HEX;
     if (start_len > 0) {
         mqtt_message_t start_msg = {
             .topic = file_topic,
@@ -829,102 +1437,46 @@ static bool handle_file_chunk_upload(const char *device_id, const char *file_pat
             printf("Failed to publish start message\n");
         } else {
             printf("Published start message\n");
-            usleep(100000); // Wait 100ms
+            encoding = upload_negotiation_wait(neg_slot, FILE_UPLOAD_OPERATION_TIMEOUT_MS);
+            neg_slot = -1;
         }
     }
-
-    // 分片上传循环
-    uint8_t *chunk_data = NULL;
-    size_t chunk_data_len = 0;
-    uint32_t chunk_id = 0;
-
-    while (file_upload_get_next_chunk(upload_ctx, &chunk_data, &chunk_data_len, &chunk_id)) {
-        // 编码分片数据为十六进制
-        char *hex_data = (char *)malloc(chunk_data_len * 2 + 1);
-        if (!hex_data) {
-            printf("Failed to allocate memory for hex data\n");
-            free(chunk_data);
-            break;
-        }
-        
-        // 将二进制数据转换为十六进制字符串
-        for (size_t i = 0; i < chunk_data_len; i++) {
-            sprintf(hex_data + i * 2, "%02X", chunk_data[i]);
-        }
-
-        // 计算分片校验和
-        char *checksum = calculate_md5(chunk_data, chunk_data_len);
-        if (!checksum) {
-            printf("Failed to calculate checksum\n");
-            free(hex_data);
-            free(chunk_data);
-            break;
-        }
-
-        // 构建分片上传消息，使用服务器端期望的格式
-        char payload[20480] = {0}; // 增加缓冲区大小，确保能容纳hex编码的数据
-        int payload_size = snprintf(payload, sizeof(payload), 
-                 "{\"type\":\"chunk\",\"file_id\":\"%s\",\"chunk_id\":%u,\"data\":\"%s\"}",
-                 upload_ctx->file_id, chunk_id, hex_data);
-        
-        // 确保JSON格式正确
-        if ((size_t)payload_size >= sizeof(payload)) {
-            LOG_ERROR("JSON payload buffer overflow, chunk_id=%u", chunk_id);
-            free(hex_data);
-            free(checksum);
-            free(chunk_data);
-            break;
-        }
-
-        // 发布分片上传消息（带重试）
-        mqtt_message_t mqtt_msg = {
-            .topic = file_topic,
-            .payload = payload,
-            .payload_len = strlen(payload),
-            .qos = MQTT_QOS_1,
-            .retain = false
-        };
-
-        int rc = -1;
-        int retry_count = 0;
-        const int max_retries = 3;
-
-        while (retry_count < max_retries) {
-            rc = mqtt_client_publish(g_client, &mqtt_msg);
-            if (rc == MQTT_ERR_SUCCESS) {
-                break;
-            }
-
-            retry_count++;
-            printf("Failed to publish chunk %u, retry %d/%d: %d\n", chunk_id, retry_count, max_retries, rc);
-            
-            // 短暂延迟后重试
-            usleep(500000); // 500ms
-        }
-
-        if (rc != MQTT_ERR_SUCCESS) {
-            printf("Failed to publish chunk %u after %d retries: %d\n", chunk_id, max_retries, rc);
-            free(checksum);
-            free(hex_data);
-            free(chunk_data);
-            break;
-        }
-
-        printf("Published chunk %u/%u, size: %zu bytes\n", 
-               chunk_id, upload_ctx->total_chunks, chunk_data_len);
-
-        // 释放资源
-        free(hex_data);
-        free(checksum);
-        free(chunk_data);
-        chunk_data = NULL;
-
-        // 短暂延迟，避免消息发送过快
-        usleep(10000); // 10ms
+    upload_negotiation_wait(neg_slot, 0);
+    if (!upload_ctx->map && upload_ctx->total_chunks > 0) {
+        printf("Failed to map %s\n", file_path);
+        free(full_checksum);
+        file_upload_abort(upload_ctx);
+        file_upload_destroy(upload_ctx);
+        free(file_topic);
+        free(binary_topic);
+        return false;
+    }
+    printf("Chunk encoding: %s\n", encoding == UPLOAD_ENCODING_BINARY ? "binary" : "hex");
+
+    // 整个上传复用一个消息缓冲区（mosquitto 发布时会复制负载）
+    size_t json_overhead = 128 + strlen(upload_ctx->file_id);
+    size_t buffer_size = encoding == UPLOAD_ENCODING_BINARY
+                         ? sizeof(file_upload_binary_header_t) + upload_ctx->chunk_size
+                         : json_overhead + (size_t)upload_ctx->chunk_size * 2;
+    uint8_t *buffer = (uint8_t *)malloc(buffer_size);
+    if (!buffer) {
+        printf("Failed to allocate upload buffer\n");
+        free(full_checksum);
+        file_upload_abort(upload_ctx);
+        file_upload_destroy(upload_ctx);
+        free(file_topic);
+        free(binary_topic);
+        return false;
     }
 
+    // 分片上传：QoS1 窗口流水线，只重发未确认的分片
+    bool chunks_ok = upload_chunks_windowed(upload_ctx, encoding,
+                                            encoding == UPLOAD_ENCODING_BINARY ? binary_topic : file_topic,
+                                            buffer, buffer_size);
+    free(buffer);
+
     // 检查上传是否完成
-    if (upload_ctx->current_chunk >= upload_ctx->total_chunks) {
+    if (chunks_ok) {
         // 构建完成传输消息
         char merge_payload[512] = {0};
         snprintf(merge_payload, sizeof(merge_payload), 
@@ -952,6 +1504,7 @@ static bool handle_file_chunk_upload(const char *device_id, const char *file_pat
     file_upload_finish(upload_ctx);
     file_upload_destroy(upload_ctx);
     free(file_topic);
+    free(binary_topic);
 
     return true;
 }
@@ -1157,6 +1710,9 @@ static void on_message_received(const char *topic, const void *payload, size_t p
                 
                 // 处理不同状态的响应
                 if (strcmp(status, "started") == 0) {
+                    // 服务器选择的分片编码，旧服务器不带该字段时为 hex
+                    cJSON *encoding_json = cJSON_GetObjectItem(data_json, "encoding");
+                    upload_negotiation_answer(file_id, cJSON_IsString(encoding_json) ? cJSON_GetStringValue(encoding_json) : NULL);
                     // 验证任务ID
                     cJSON *task_id_json = cJSON_GetObjectItem(data_json, "task_id");
                     if (cJSON_IsNumber(task_id_json)) {
@@ -1208,435 +1764,220 @@ static void on_message_received(const char *topic, const void *payload, size_t p
     
     // 检查是否是命令相关主题
     if (strstr(topic, "/command") != NULL) {
+        // 只读解析一次，之后按字段分发；不修改 mosquitto 持有的负载
+        mqtt_command_t cmd;
+        if (mqtt_command_parse(payload, payload_len, &cmd) != 0) {
+            LOG_ERROR("Malformed command payload (%zu bytes), ignored", payload_len);
+            return;
+        }
+        
         // 检查是否是重复命令
-        if (check_command_duplicate(payload, payload_len)) {
+        if (cmd.has_command_id && check_command_duplicate(cmd.command_id)) {
             return;
         }
+        int command_id = cmd.has_command_id ? (int)cmd.command_id : 0;
         
         // 处理控制命令消息
         message_t msg;
         memset(&msg, 0, sizeof(msg));
         
-        // 提取命令ID
-        int command_id = 0;
-        char *payload_str = (char *)payload;
-        char *cmd_id_start = strstr(payload_str, "\"command_id\":");
-        if (cmd_id_start) {
-            cmd_id_start += 13; // 跳过"command_id":
-            // 跳过空格
-            while (*cmd_id_start == ' ') {
-                cmd_id_start++;
-            }
-            // 提取命令ID
-            char *cmd_id_end = strchr(cmd_id_start, ',');
-            if (!cmd_id_end) {
-                cmd_id_end = strchr(cmd_id_start, '}');
-            }
-            if (cmd_id_end) {
-                *cmd_id_end = '\0'; // 临时截断字符串
-                command_id = atoi(cmd_id_start);
-                // 恢复字符串
-                *cmd_id_end = ',';
-            }
-        }
-        
         // 设置消息基本信息
-        msg.type = MSG_TYPE_RESPONSE;          // 默认消息类型
+        msg.type = MSG_TYPE_DEVICE_CMD;
         msg.seq_num = command_id > 0 ? (uint32_t)command_id : g_seq_num++; // 使用命令ID作为序列号
         msg.timestamp = (uint32_t)time(NULL);  // 时间戳
         
-        // 尝试解析Python MQTT服务器发送的命令格式
-        char *content_start = strstr(payload_str, "\"content\":");
-        
-        if (content_start) {
-            // 找到content字段，提取实际命令内容
-            content_start += 10; // 跳过"content":
-            
-            // 跳过可能的空格
-            while (*content_start == ' ') {
-                content_start++;
-            }
-            
-            // 找到content字段内的匹配大括号，确保只提取content内的内容
-            char *content_end = content_start;
-            int brace_count = 0;
-            bool found_opening = false;
-            
-            while (*content_end != '\0') {
-                if (*content_end == '{') {
-                    brace_count++;
-                    found_opening = true;
-                } else if (*content_end == '}') {
-                    brace_count--;
-                    if (found_opening && brace_count == 0) {
-                        break;
-                    }
-                }
-                content_end++;
-            }
-            
-            if (content_end && *content_end == '}') {
-                content_end++;
-                // 计算内容长度
-                size_t content_len = content_end - content_start;
-                if (content_len > 0 && content_len < sizeof(msg.payload.data)) {
-                    // 复制实际命令内容
-                    memcpy(msg.payload.data, content_start, content_len);
-                    msg.data_len = content_len;
-                    LOG_DEBUG("Extracted command content: %.*s", (int)content_len, (char*)msg.payload.data);
-                }
-            }
-        }
-        
-        // 如果没有提取到content字段，使用原始payload
-        if (msg.data_len == 0) {
-            msg.data_len = payload_len;
-            memcpy(msg.payload.data, payload, payload_len);
-        }
-        
-        // 根据消息内容确定消息类型
-        if (strstr((char*)msg.payload.data, "motor") != NULL || strstr((char*)msg.payload.data, "MOTOR") != NULL) {
-            // 电机控制消息
-            msg.type = MSG_TYPE_MOTOR_CMD;
-        } else if (strstr((char*)msg.payload.data, "status") != NULL || strstr((char*)msg.payload.data, "STATUS") != NULL) {
-            // 检查是否包含action字段，如果包含则不是状态查询命令
-            char *action_start = strstr((char*)msg.payload.data, "\"action\":");
-            if (!action_start) {
-                // 状态查询消息，直接在MQTT客户端处理（只有当"status"是顶级字段且没有"action"字段时）
-                printf("Received status query command\n");
-                // 发布当前设备状态
-                publish_device_status(g_device_status);
-                // 跳过发送到UART，直接响应
-                return;
-            }
+        if (!cmd.has_action && cmd.has_status) {
+            // 状态查询消息，直接在MQTT客户端处理（只有带"status"字段且没有"action"字段时）
+            printf("Received status query command\n");
+            // 发布当前设备状态
+            publish_device_status(g_device_status);
+            // 跳过发送到UART，直接响应
+            return;
         }
         
-        // 其他设备控制消息
-        msg.type = MSG_TYPE_DEVICE_CMD;
-        
-        // 尝试将Python MQTT服务器发送的命令转换为与process_manager相同的格式
-        // 格式：device_type (1字节) + device_id (1字节) + state (1字节)
-        char *cmd_str = (char *)msg.payload.data;
+        // 尝试将服务器发送的命令转换为与process_manager相同的格式
+        // 格式：device_type (1字节) + device_id (1字节) + state (1字节) + cmd_id (1字节)
+        int device_type = -1;
+        uint8_t state = 0;
         
-        // 检查是否包含action字段
-        char *action_start = strstr(cmd_str, "\"action\":");
-        if (action_start) {
-                action_start += 9; // 跳过"action":
+        if (cmd.has_action && cmd.action_is_number) {
+            // 数字类型的action（系统命令）
+            int action_num = cmd.action;
+            
+            if (action_num == 80) {
+                // 文件传输命令
+                LOG_INFO("File transfer command received, action=80, cmd_id=%d", command_id);
                 
-                // 提取action值
-                char *action_value_start = action_start;
-                while (*action_value_start == ' ') {
-                    action_value_start++;
+                char file_name[256] = {0};
+                if (!cmd.file_name.ptr) {
+                    LOG_ERROR("No file_name found in command");
+                } else if (!mqtt_command_copy_string(&cmd.file_name, file_name, sizeof(file_name)) || !file_name[0]) {
+                    LOG_ERROR("Invalid file_name in command");
+                } else {
+                    // 构建完整的文件路径
+                    char file_path[1024] = {0};
+                    snprintf(file_path, sizeof(file_path), UPLOAD_PICTURE_DIR "/%s", file_name);
+                    
+                    LOG_INFO("File path: %s", file_path);
+                    enqueue_file_upload_request(file_path, UPLOAD_PRIORITY_HIGH);
                 }
                 
-                // 检查action是否为数字类型（无引号）
-                if (*action_value_start != '"') {
-                    // 数字类型的action（系统命令）
-                    char *action_value_end = strchr(action_value_start, ',');
-                    if (!action_value_end) {
-                        action_value_end = strchr(action_value_start, '}');
+                // 跳过发送到UART进程，直接返回
+                return;
+            } else if (action_num == 81) {
+                // FOTA Start Command
+                LOG_INFO("FOTA Start command received, action=81, cmd_id=%d", command_id);
+                
+                // Parameters: file_name, file_size, total_chunks
+                char file_name[256] = {0};
+                if (cmd.file_name.ptr && !mqtt_command_copy_string(&cmd.file_name, file_name, sizeof(file_name))) {
+                    file_name[0] = '\0';
+                }
+                uint64_t file_size = cmd.has_file_size ? cmd.file_size : 0;
+                uint32_t total_chunks = cmd.has_total_chunks ? cmd.total_chunks : 0;
+
+                if (file_size > 0 && total_chunks > 0) {
+                    // Create FOTA context
+                    char file_path[512];
+                    snprintf(file_path, sizeof(file_path), "%s/%s", DEFAULT_FOTA_DIR, file_name[0] ? file_name : "update.bin");
+                    
+                    // Check for active FOTA context
+                    if (g_fota_ctx) {
+                        if (strcmp(g_fota_ctx->file_path, file_path) == 0) {
+                            // 同一文件重新开始：保留已收到的分片，fota_start 断点续传
+                            LOG_WARNING("FOTA restarted for %s, keeping received chunks", file_path);
+                        } else {
+                            LOG_WARNING("FOTA context already active, aborting existing one");
+                            fota_abort(g_fota_ctx);
+                            fota_relay_finish_session(g_fota_ctx, false);
+                        }
+                        fota_destroy(g_fota_ctx);
+                        g_fota_ctx = NULL;
                     }
-                    if (action_value_end) {
-                        char original_char = *action_value_end; // 保存原始字符
-                        *action_value_end = '\0'; // 临时截断字符串
-                        int action_num = atoi(action_value_start);
-                        
-                        // 恢复字符串
-                        *action_value_end = original_char;
-                        
-                        // 检查是否为文件传输命令
-                        if (action_num == 80) {
-                            // 文件传输命令
-                            LOG_INFO("File transfer command received, action=80, cmd_id=%d", command_id);
-                            
-                            // 尝试提取文件名，从data字段中查找
-                            char *data_start = strstr(cmd_str, "\"data\":");
-                            if (data_start) {
-                                // 找到data字段，在其中查找file_name
-                                char *file_name_start = strstr(data_start, "\"file_name\":");
-                                if (file_name_start) {
-                                    // 跳过"file_name":""，考虑可能的空格
-                                    file_name_start += 12;
-                                    // 跳过可能的空格
-                                    while (*file_name_start == ' ') {
-                                        file_name_start++;
-                                    }
-                                    
-                                    // 提取文件名（处理带引号和不带引号的情况）
-                                    char *file_name_end = NULL;
-                                    if (*file_name_start == '"') {
-                                        file_name_start++;
-                                        file_name_end = strchr(file_name_start, '"');
-                                    } else {
-                                        file_name_end = strchr(file_name_start, ',');
-                                        if (!file_name_end) {
-                                            file_name_end = strchr(file_name_start, '}');
-                                        }
-                                    }
-                                    
-                                    if (file_name_end) {
-                                        char original_char = *file_name_end;
-                                        *file_name_end = '\0';
-                                        char file_name[256] = {0};
-                                        strncpy(file_name, file_name_start, sizeof(file_name) - 1);
-                                        
-                                        // 构建完整的文件路径
-                                        char file_path[1024] = {0};
-                                        snprintf(file_path, sizeof(file_path), "/appfs/nfs/picture/%s", file_name);
-                                        
-                                        LOG_INFO("File path: %s", file_path);
-                                        enqueue_file_upload_request(file_path);
-                                        LOG_INFO("File upload queued");
-                                        
-                                        // 恢复字符串
-                                        *file_name_end = original_char;
-                                    } else {
-                                        LOG_ERROR("No file_name end found");
-                                    }
-                                } else {
-                                    LOG_ERROR("No file_name found in data field");
-                                }
-                            } else {
-                                LOG_ERROR("No data field found in command");
-                            }
-                            
-                            // 跳过发送到UART进程，直接返回
-                            return;
-                        } else if (action_num == 81) {
-                            // FOTA Start Command
-                            LOG_INFO("FOTA Start command received, action=81, cmd_id=%d", command_id);
-                            
-                            // Check for active FOTA context
-                            if (g_fota_ctx) {
-                                LOG_WARNING("FOTA context already active, aborting existing one");
-                                fota_abort(g_fota_ctx);
-                                fota_destroy(g_fota_ctx);
-                                g_fota_ctx = NULL;
-                            }
-                            
-                            // Extract parameters: file_name, file_size, total_chunks
-                            char file_name[256] = {0};
-                            uint64_t file_size = 0;
-                            uint32_t total_chunks = 0;
-                            
-                            // Extract file_name
-                            char *fn_start = strstr(cmd_str, "\"file_name\":");
-                            if (fn_start) {
-                                fn_start += 12;
-                                while (*fn_start == ' ') fn_start++;
-                                if (*fn_start == '"') {
-                                    fn_start++;
-                                    char *fn_end = strchr(fn_start, '"');
-                                    if (fn_end) {
-                                        size_t len = fn_end - fn_start;
-                                        if (len < sizeof(file_name)) {
-                                            strncpy(file_name, fn_start, len);
-                                            file_name[len] = '\0';
-                                        }
-                                    }
-                                }
-                            }
-                            
-                            // Extract file_size
-                            char *fs_start = strstr(cmd_str, "\"file_size\":");
-                            if (fs_start) {
-                                fs_start += 12;
-                                file_size = (uint64_t)strtoull(fs_start, NULL, 10);
-                            }
-                            
-                            // Extract total_chunks
-                            char *tc_start = strstr(cmd_str, "\"total_chunks\":");
-                            if (tc_start) {
-                                tc_start += 15;
-                                total_chunks = (uint32_t)atoi(tc_start);
-                            }
-
-                            if (file_size > 0 && total_chunks > 0) {
-                                // Create FOTA context
-                                char file_path[512];
-                                snprintf(file_path, sizeof(file_path), "%s/%s", DEFAULT_FOTA_DIR, file_name[0] ? file_name : "update.bin");
-                                
-                                g_fota_ctx = fota_create(file_path, DEFAULT_FOTA_DIR, NULL, NULL);
-                                if (g_fota_ctx) {
-                                    if (fota_start(g_fota_ctx, file_size, total_chunks)) {
-                                        LOG_INFO("FOTA started: %s, size=%llu, chunks=%u", file_path, file_size, total_chunks);
-                                    } else {
-                                        LOG_ERROR("Failed to start FOTA");
-                                        fota_destroy(g_fota_ctx);
-                                        g_fota_ctx = NULL;
-                                    }
-                                } else {
-                                    LOG_ERROR("Failed to create FOTA context");
-                                }
-                            } else {
-                                LOG_ERROR("Invalid FOTA parameters");
-                            }
-                            return;
-
-                        } else if (action_num == 82) {
-                            // FOTA Finish Command
-                            LOG_INFO("FOTA Finish command received, action=82, cmd_id=%d", command_id);
-                            
-                            if (g_fota_ctx) {
-                                // Extract checksum (String)
-                                char checksum[65] = {0};
-                                char *cs_start = strstr(cmd_str, "\"checksum\":");
-                                if (cs_start) {
-                                    cs_start += 11;
-                                    while (*cs_start == ' ' || *cs_start == '"') cs_start++;
-                                    
-                                    // Extract hex string
-                                    char *cs_end = cs_start;
-                                    while ((*cs_end >= '0' && *cs_end <= '9') || 
-                                           (*cs_end >= 'a' && *cs_end <= 'f') || 
-                                           (*cs_end >= 'A' && *cs_end <= 'F')) {
-                                        cs_end++;
-                                    }
-                                    
-                                    size_t len = cs_end - cs_start;
-                                    if (len < sizeof(checksum)) {
-                                        strncpy(checksum, cs_start, len);
-                                        checksum[len] = '\0';
-                                    }
-                                }
-                                
-                                if (fota_finish(g_fota_ctx, checksum)) {
-                                    LOG_INFO("FOTA finished successfully");
-                                } else {
-                                    LOG_ERROR("FOTA finish failed (checksum mismatch?)");
-                                }
-                                fota_destroy(g_fota_ctx);
-                                g_fota_ctx = NULL;
-                            } else {
-                                LOG_WARNING("No active FOTA context to finish");
-                            }
-                            return;
-                        } else if (action_num >= 48 && action_num <= 52) {
-                            // 设备控制命令
-                            uint8_t device_type = action_num - 48;
-                            uint8_t device_id = device_type;
-                            uint8_t state = 0;
-                            
-                            // 尝试提取状态值或亮度值
-                            char *status_start = strstr(cmd_str, "\"status\":");
-                            char *value_start = strstr(cmd_str, "\"value\":");
-                            
-                            if (status_start) {
-                                state = atoi(status_start + 9);
-                            } else if (value_start) {
-                                state = atoi(value_start + 8);
-                            }
-                            
-                            // 构建新的消息格式
-                            uint8_t new_payload[4]; // 包含命令ID
-                            new_payload[0] = 0x50 + device_type;
-                            new_payload[1] = device_id;
-                            new_payload[2] = state;
-                            new_payload[3] = command_id & 0xFF; // 保存命令ID
-                            
-                            // 复制到消息payload
-                            memcpy(msg.payload.data, new_payload, 4);
-                            msg.data_len = 4;
-                            LOG_INFO("Converted device command: cmd_code=0x%02X, device_id=%d, state=%d, cmd_id=%d", new_payload[0], device_id, state, command_id);
+                    
+                    g_fota_ctx = fota_create(file_path, DEFAULT_FOTA_DIR, NULL, NULL);
+                    if (g_fota_ctx) {
+                        // 同一文件重新开始时 fota_relay_begin 会先取消上一次转发
+                        fota_relay_start_session(g_fota_ctx, file_size);
+                        if (fota_start(g_fota_ctx, file_size, total_chunks)) {
+                            LOG_INFO("FOTA started: %s, size=%llu, chunks=%u", file_path,
+                                     (unsigned long long)file_size, total_chunks);
                         } else {
-                            // 其他系统命令
-                            uint8_t new_payload[4]; // 包含命令ID
-                            new_payload[0] = action_num; // 直接使用action作为命令类型
-                            new_payload[1] = 0; // 设备ID
-                            new_payload[2] = 0; // 状态
-                            new_payload[3] = command_id & 0xFF; // 保存命令ID
-                            
-                            // 复制到消息payload
-                            memcpy(msg.payload.data, new_payload, 4);
-                            msg.data_len = 4;
-                            LOG_INFO("Converted system command: command_type=%d, cmd_id=%d", action_num, command_id);
+                            LOG_ERROR("Failed to start FOTA");
+                            fota_relay_finish_session(g_fota_ctx, false);
+                            fota_destroy(g_fota_ctx);
+                            g_fota_ctx = NULL;
                         }
-                        
-                        
+                    } else {
+                        LOG_ERROR("Failed to create FOTA context");
                     }
                 } else {
-                    // 字符串类型的action（设备控制命令）
-                    action_value_start++;
-                    char *action_value_end = strchr(action_value_start, '"');
-                    if (action_value_end) {
-                        *action_value_end = '\0'; // 临时截断字符串
-                        char *action = action_value_start;
-                        
-                        // 根据action映射到对应的设备类型
-                        uint8_t device_type = 0;
-                        uint8_t device_id = 0;
-                        uint8_t state = 0;
-                        
-                        if (strcmp(action, "led") == 0 || strcmp(action, "LED") == 0) {
-                            device_type = 0; // LED
-                            device_id = 0;
-                            // 尝试提取亮度值
-                            char *value_start = strstr(cmd_str, "\"value\":");
-                            if (value_start) {
-                                state = atoi(value_start + 8);
-                            }
-                        } else if (strcmp(action, "fan") == 0 || strcmp(action, "FAN") == 0) {
-                            device_type = 1; // FAN
-                            device_id = 1;
-                            // 尝试提取状态值
-                            char *status_start = strstr(cmd_str, "\"status\":");
-                            if (status_start) {
-                                state = atoi(status_start + 9);
-                            }
-                        } else if (strcmp(action, "heater") == 0 || strcmp(action, "HEATER") == 0) {
-                            device_type = 2; // HEATER
-                            device_id = 2;
-                            // 尝试提取状态值
-                            char *status_start = strstr(cmd_str, "\"status\":");
-                            if (status_start) {
-                                state = atoi(status_start + 9);
-                            }
-                        } else if (strcmp(action, "laser") == 0 || strcmp(action, "LASER") == 0) {
-                            device_type = 3; // LASER
-                            device_id = 3;
-                            // 尝试提取状态值
-                            char *status_start = strstr(cmd_str, "\"status\":");
-                            if (status_start) {
-                                state = atoi(status_start + 9);
-                            }
-                        } else if (strcmp(action, "pwm") == 0 || strcmp(action, "PWM") == 0) {
-                            device_type = 4; // PWM LIGHT
-                            device_id = 4;
-                            // 尝试提取亮度值
-                            char *value_start = strstr(cmd_str, "\"value\":");
-                            if (value_start) {
-                                state = atoi(value_start + 8);
-                            }
-                        }
-                        
-                        // 恢复字符串
-                        *action_value_end = '"';
-                        
-                        // 如果成功映射到设备类型，构建新的消息格式
-                        if (device_type <= 4) {
-                            uint8_t new_payload[4]; // 包含命令ID
-                            // 转换为UART进程期望的命令代码格式 (0x50-0x54)
-                            new_payload[0] = 0x50 + device_type;
-                            new_payload[1] = device_id;
-                            new_payload[2] = state;
-                            new_payload[3] = command_id & 0xFF; // 保存命令ID
-                            
-                            // 复制到消息payload
-                            memcpy(msg.payload.data, new_payload, 4);
-                            msg.data_len = 4;
-                            printf("Converted command to UART format: cmd_code=0x%02X, device_id=%d, state=%d, cmd_id=%d\n", new_payload[0], device_id, state, command_id);
+                    LOG_ERROR("Invalid FOTA parameters");
+                }
+                return;
+
+            } else if (action_num == 82) {
+                // FOTA Finish Command
+                LOG_INFO("FOTA Finish command received, action=82, cmd_id=%d", command_id);
+                
+                if (g_fota_ctx) {
+                    // 校验和为十六进制字符串，截到第一个非十六进制字符
+                    char checksum[65] = {0};
+                    size_t cs_len = 0;
+                    while (cs_len < cmd.checksum.len && cs_len < sizeof(checksum) - 1) {
+                        char c = cmd.checksum.ptr[cs_len];
+                        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
+                            break;
                         }
+                        checksum[cs_len++] = c;
+                    }
+                    checksum[cs_len] = '\0';
+                    
+                    if (fota_get_state(g_fota_ctx) == FOTA_STATE_RECEIVING) {
+                        // 只请求缺失分片，保留上下文继续接收
+                        publish_fota_missing_chunks(g_fota_ctx);
+                        return;
+                    }
+                    if (fota_finish(g_fota_ctx, checksum)) {
+                        LOG_INFO("FOTA finished successfully");
+                        fota_relay_finish_session(g_fota_ctx, true);
+                    } else {
+                        LOG_ERROR("FOTA finish failed (checksum mismatch?)");
+                        fota_relay_finish_session(g_fota_ctx, false);
+                    }
+                    fota_destroy(g_fota_ctx);
+                    g_fota_ctx = NULL;
+                } else {
+                    LOG_WARNING("No active FOTA context to finish");
+                }
+                return;
+            } else if (action_num >= 48 && action_num <= 52) {
+                // 设备控制命令：优先使用状态值，其次亮度值
+                device_type = action_num - 48;
+                state = (uint8_t)(cmd.has_status ? cmd.status : (cmd.has_value ? cmd.value : 0));
+            } else {
+                // 其他系统命令：直接使用action作为命令类型
+                msg.payload.data[0] = (uint8_t)action_num;
+                msg.payload.data[1] = 0; // 设备ID
+                msg.payload.data[2] = 0; // 状态
+                msg.payload.data[3] = command_id & 0xFF; // 保存命令ID
+                msg.data_len = 4;
+                LOG_INFO("Converted system command: command_type=%d, cmd_id=%d", action_num, command_id);
+            }
+        } else if (cmd.has_action) {
+            // 字符串类型的action（设备控制命令）：led/pwm 取亮度值，其它取状态值
+            static const struct {
+                const char *name;
+                bool use_value;
+            } device_actions[] = {
+                { "led", true },        // LED
+                { "fan", false },       // FAN
+                { "heater", false },    // HEATER
+                { "laser", false },     // LASER
+                { "pwm", true },        // PWM LIGHT
+            };
+            for (int i = 0; i < (int)(sizeof(device_actions) / sizeof(device_actions[0])); i++) {
+                if (mqtt_command_str_equals(&cmd.action_name, device_actions[i].name)) {
+                    device_type = i;
+                    if (device_actions[i].use_value) {
+                        state = (uint8_t)(cmd.has_value ? cmd.value : 0);
+                    } else {
+                        state = (uint8_t)(cmd.has_status ? cmd.status : 0);
                     }
+                    break;
                 }
+            }
+            if (device_type < 0) {
+                LOG_WARNING("Unknown device action \"%.*s\", forwarding raw command",
+                            (int)cmd.action_name.len, cmd.action_name.ptr);
+            }
         }
         
-        // 发送消息到UART进程（跳过已处理的FOTA消息）
-        if (msg.type != MSG_TYPE_FOTA_DATA && msg.type != MSG_TYPE_FOTA_START && msg.type != MSG_TYPE_FOTA_END) {
-            if (mq_send_msg(g_mq_mqtt_to_uart, &msg, 0) != 0) {
-                LOG_ERROR("Failed to send message to UART process: %s", strerror(errno));
-            } else {
-                LOG_INFO("Sent control message to UART process, type: %d", msg.type);
+        if (device_type >= 0) {
+            // 转换为UART进程期望的命令代码格式 (0x50-0x54)
+            msg.payload.data[0] = (uint8_t)(0x50 + device_type);
+            msg.payload.data[1] = (uint8_t)device_type; // 设备ID
+            msg.payload.data[2] = state;
+            msg.payload.data[3] = command_id & 0xFF; // 保存命令ID
+            msg.data_len = 4;
+            LOG_INFO("Converted device command: cmd_code=0x%02X, device_id=%d, state=%d, cmd_id=%d",
+                     msg.payload.data[0], device_type, state, command_id);
+        } else if (msg.data_len == 0) {
+            // 无法转换的命令原样转发 content（没有 content 时为整个负载）
+            if (cmd.content_len == 0 || cmd.content_len > sizeof(msg.payload.data)) {
+                LOG_ERROR("Command content too large for UART message (%zu bytes), dropped", cmd.content_len);
+                return;
             }
+            memcpy(msg.payload.data, cmd.content, cmd.content_len);
+            msg.data_len = cmd.content_len;
+            LOG_DEBUG("Forwarding command content: %.*s", (int)cmd.content_len, cmd.content);
+        }
+        
+        // 发送消息到UART进程
+        if (mq_send_msg(g_mq_mqtt_to_uart, &msg, 0) != 0) {
+            LOG_ERROR("Failed to send message to UART process: %s", strerror(errno));
+        } else {
+            LOG_INFO("Sent control message to UART process, type: %d", msg.type);
         }
         return;
     }
@@ -1969,7 +2310,10 @@ static bool init_mqtt_client(void)
         // .client_key_path = NULL,
         .connect_timeout_ms = 5000,     // 连接超时（毫秒）
         .retry_interval_ms = 2000,      // 重连间隔（毫秒）
-        .max_retry_count = -1           // 无限重试
+        .max_retry_count = -1,          // 无限重试
+        // 消息回调移出事件循环线程，FOTA分片写盘时PUBACK与心跳照常处理；
+        // FOTA开始/结束命令与分片在不同主题上，只用一个线程保证三者的先后顺序
+        .dispatch_workers = 1
     };
     
     LOG_INFO("Creating MQTT client with config: host=%s, port=%d, client_id=%s", 
@@ -2017,6 +2361,7 @@ static void handle_sensor_data()
     // 检查消息队列是否有效
     if (g_mq_uart_to_mqtt == -1) {
         LOG_DEBUG("Message queue not initialized, skipping sensor data handling");
+        usleep(100000); // 保持主循环节拍
         return;
     }
     
@@ -2027,71 +2372,43 @@ static void handle_sensor_data()
     int ret = mq_receive_msg(g_mq_uart_to_mqtt, &msg, &priority, 100);
     if (ret == 0) {
         // 成功接收到消息
+        if (msg.type != MSG_TYPE_SENSOR_DATA && msg.type != MSG_TYPE_HEARTBEAT) {
+            // 优先事件（图片处理结果、命令响应、升级通知等）发布前先送出已聚合的样本，保持先后顺序
+            flush_telemetry();
+        }
         switch (msg.type) {
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////            
             case MSG_TYPE_SENSOR_DATA: {
                 // 处理传感器数据
                 LOG_DEBUG("Processing sensor data message");
-                // 构建传感器数据主题：device/{device_id}/data
-                char *sensor_topic = build_topic(g_device_id, "device/%s/data");
-                if (sensor_topic) {
-                    // 构建结构化的传感器数据JSON
-                    cJSON *root = cJSON_CreateObject();
-                    if (root != NULL) {
-                        // 添加device_id字段
-                        cJSON_AddStringToObject(root, "device_id", g_device_id);
-                        
-                        // 添加timestamp字段
-                        cJSON_AddNumberToObject(root, "timestamp", (int)time(NULL));
-                        
-                        // 添加sensor_data字段
-                        if (msg.data_len > 0 && msg.payload.data) {
-                            // 假设传感器数据是字符串，添加为字符串字段
-                            char sensor_data_str[1024] = {0};
-                            strncpy(sensor_data_str, (char *)msg.payload.data, msg.data_len);
-                            sensor_data_str[msg.data_len] = '\0';
-                            cJSON_AddStringToObject(root, "sensor_data", sensor_data_str);
-                        } else {
-                            cJSON_AddStringToObject(root, "sensor_data", "");
-                        }
-                        
-                        // 生成JSON字符串
-                        char *json_str = cJSON_PrintUnformatted(root);
-                        if (json_str != NULL) {
-                            // 准备MQTT消息
-                            mqtt_message_t mqtt_msg = {
-                                .topic = sensor_topic,        // 消息主题
-                                .payload = json_str,          // 消息内容
-                                .payload_len = strlen(json_str),  // 消息长度
-                                .qos = MQTT_QOS_0,            // QoS级别0（最多一次）
-                                .retain = false               // 非保留消息
-                            };
-                            
-                            // 检查MQTT客户端是否有效
-                            if (g_client) {
-                                // 发布消息
-                                int rc = mqtt_client_publish(g_client, &mqtt_msg);
-                                if (rc != MQTT_ERR_SUCCESS) {
-                                    LOG_ERROR("Failed to publish sensor data: %d", rc);
-                                } else {
-                                    LOG_INFO("Published sensor data to %s", sensor_topic);
-                                }
-                            } else {
-                                LOG_ERROR("MQTT client not initialized, cannot publish sensor data");
-                            }
-                            
-                            // 释放JSON字符串内存
-                            cJSON_free(json_str);
-                        }
-                        
-                        // 释放JSON对象内存
-                        cJSON_Delete(root);
-                    }
-                    
-                    // 释放主题内存
-                    free(sensor_topic);
-                } else {
-                    LOG_ERROR("Failed to build sensor topic");
+                if (g_telemetry && msg.data_len == sizeof(sensor_data_msg_t)) {
+                    // 结构化样本进入聚合器，按窗口合并发布
+                    const sensor_data_msg_t *sensor = &msg.payload.sensor;
+                    int32_t values[4] = {
+                        (int32_t)(sensor->temperature * 100.0f + (sensor->temperature < 0 ? -0.5f : 0.5f)),
+                        sensor->humidity,
+                        sensor->light,
+                        sensor->battery
+                    };
+                    telemetry_batch_add(g_telemetry, g_series_sensor, msg.timestamp, values);
+                    break;
+                }
+                // 其他格式按字符串单独发布，先送出已聚合的样本
+                flush_telemetry();
+                // 按序写入线程缓冲区，不建树、不分配内存：device/{device_id}/data
+                {
+                    // 传感器数据按字符串处理，到第一个NUL为止
+                    size_t sensor_len = msg.data_len < sizeof(msg.payload.data) ? msg.data_len : sizeof(msg.payload.data);
+                    sensor_len = strnlen((const char *)msg.payload.data, sensor_len);
+
+                    json_writer_t *w = json_writer_thread();
+                    json_writer_object_begin(w);
+                    json_writer_add_string(w, "device_id", g_device_id);
+                    json_writer_add_int(w, "timestamp", (int64_t)time(NULL));
+                    json_writer_key(w, "sensor_data");
+                    json_writer_string_n(w, (const char *)msg.payload.data, sensor_len);
+                    json_writer_object_end(w);
+                    publish_device_json("device/%s/data", w, MQTT_QOS_0, "sensor data");
                 }
                 break;
             }
@@ -2122,11 +2439,9 @@ static void handle_sensor_data()
                     strncpy(file_path, (char *)msg.payload.data, msg.data_len);
                     file_path[msg.data_len] = '\0';
                     
-                    // 使用分片上传处理文件
+                    // 交给上传队列，不阻塞消息队列处理
                     LOG_INFO("Handling file chunk upload: %s", file_path);
-                    if (!handle_file_chunk_upload(g_device_id, file_path)) {
-                        LOG_ERROR("Failed to handle file chunk upload");
-                    }
+                    enqueue_file_upload_request(file_path, UPLOAD_PRIORITY_NORMAL);
                 } else {
                     LOG_ERROR("Invalid file data message: empty payload");
                 }
@@ -2153,85 +2468,81 @@ static void handle_sensor_data()
                 LOG_INFO("FOTA complete message received from UART, but response already published in FOTA callback");
                 break;
             }
+            case MSG_TYPE_HEARTBEAT: {
+                // 心跳只记录时间戳，随传感器样本一起发布
+                if (g_telemetry) {
+                    telemetry_batch_add(g_telemetry, g_series_heartbeat, msg.timestamp, NULL);
+                }
+                break;
+            }
             case MSG_TYPE_RESPONSE: {
                 // 处理命令响应消息
                 LOG_DEBUG("Processing command response message");
-                // 构建命令响应主题：device/{device_id}/command/response
-                char *command_response_topic = build_topic(g_device_id, "device/%s/command/response");
-                if (command_response_topic) {
-                    // 从UART消息中提取命令执行结果
-                    char result[1024] = {0};
-                    strncpy(result, (char *)msg.payload.data, msg.data_len);
-                    result[msg.data_len] = '\0';
-                    
-                    // 构建结构化的命令响应JSON
-                    cJSON *root = cJSON_CreateObject();
-                    if (root != NULL) {
-                        // 添加device_id字段
-                        cJSON_AddStringToObject(root, "device_id", g_device_id);
-                        
-                        // 添加command_id字段（使用从命令中提取的实际命令ID）
-                        // 注意：这里需要从UART响应中提取实际的命令ID
-                        // 暂时使用msg.seq_num作为command_id
-                        cJSON_AddNumberToObject(root, "command_id", msg.seq_num);
-                        
-                        // 添加result字段
-                        // 确保result是有效的UTF-8字符串
-                        char safe_result[1024] = {0};
-                        for (size_t i = 0; i < msg.data_len && i < sizeof(safe_result) - 1; i++) {
-                            if (msg.payload.data[i] >= 32 && msg.payload.data[i] <= 126) {
-                                safe_result[i] = msg.payload.data[i];
-                            } else if (msg.payload.data[i] == '\n' || msg.payload.data[i] == '\t') {
-                                safe_result[i] = msg.payload.data[i];
-                            } else {
-                                safe_result[i] = '.';
-                            }
-                        }
-                        cJSON_AddStringToObject(root, "result", safe_result);
-                        
-                        // 添加timestamp字段
-                        cJSON_AddNumberToObject(root, "timestamp", (int)time(NULL));
-                        
-                        // 生成JSON字符串
-                        char *json_str = cJSON_PrintUnformatted(root);
-                        if (json_str != NULL) {
-                            // 准备MQTT消息
-                            mqtt_message_t mqtt_msg = {
-                                .topic = command_response_topic, // 消息主题
-                                .payload = json_str,            // 消息内容
-                                .payload_len = strlen(json_str), // 消息长度
-                                .qos = MQTT_QOS_1,               // QoS级别1（至少一次）
-                                .retain = false                  // 非保留消息
-                            };
-                            
-                            // 检查MQTT客户端是否有效
-                            if (g_client) {
-                                // 发布消息
-                                int rc = mqtt_client_publish(g_client, &mqtt_msg);
-                                if (rc != MQTT_ERR_SUCCESS) {
-                                    LOG_ERROR("Failed to publish command response: %d", rc);
-                                } else {
-                                    LOG_INFO("Published command response to %s", command_response_topic);
-                                    LOG_INFO("Command response: %s", json_str);
-                                }
-                            } else {
-                                LOG_ERROR("MQTT client not initialized, cannot publish command response");
-                            }
-                            
-                            // 释放JSON字符串
-                            cJSON_free(json_str);
-                        }
-                        
-                        // 释放JSON对象
-                        cJSON_Delete(root);
-                    } else {
-                        LOG_ERROR("Failed to create command response JSON");
+                // 构建命令响应：device/{device_id}/command/response
+                {
+                    // 确保result是有效的UTF-8字符串：不可打印字节替换为'.'
+                    char safe_result[sizeof(msg.payload.data)];
+                    size_t result_len = msg.data_len < sizeof(safe_result) ? msg.data_len : sizeof(safe_result);
+                    for (size_t i = 0; i < result_len; i++) {
+                        uint8_t c = msg.payload.data[i];
+                        safe_result[i] = ((c >= 32 && c <= 126) || c == '\n' || c == '\t') ? (char)c : '.';
                     }
-                    
-                    // 释放主题内存
-                    free(command_response_topic);
-                } else {
-                    LOG_ERROR("Failed to build command response topic");
+
+                    json_writer_t *w = json_writer_thread();
+                    json_writer_object_begin(w);
+                    json_writer_add_string(w, "device_id", g_device_id);
+                    // 暂时使用msg.seq_num作为command_id，UART响应中尚未携带实际的命令ID
+                    json_writer_add_uint(w, "command_id", msg.seq_num);
+                    json_writer_key(w, "result");
+                    json_writer_string_n(w, safe_result, result_len);
+                    json_writer_add_int(w, "timestamp", (int64_t)time(NULL));
+                    json_writer_object_end(w);
+                    if (publish_device_json("device/%s/command/response", w, MQTT_QOS_1, "command response") >= 0) {
+                        LOG_INFO("Published command response for seq %u", msg.seq_num);
+                    }
+                }
+                break;
+            }
+            case MSG_TYPE_IMAGE_PROCESSED: {
+                // 测量结果：device/{device_id}/measurement，段落按 paragraph_t 布局解析
+                const image_process_result_t *res = &msg.payload.img_result;
+                uint8_t count = res->paragraph_count < IMAGE_RESULT_MAX_PARAGRAPHS ?
+                                res->paragraph_count : IMAGE_RESULT_MAX_PARAGRAPHS;
+                json_writer_t *w = json_writer_thread();
+                json_writer_object_begin(w);
+                json_writer_add_string(w, "device_id", g_device_id);
+                json_writer_add_uint(w, "trace_id", msg.trace_id);
+                json_writer_add_int(w, "success", res->success);
+                json_writer_key(w, "paragraphs");
+                json_writer_array_begin(w);
+                for (uint8_t i = 0; i < count; i++) {
+                    int32_t start_x, end_x, width_px;
+                    float width_mm;
+                    memcpy(&start_x, &res->paragraphs[i][0], sizeof(start_x));
+                    memcpy(&end_x, &res->paragraphs[i][4], sizeof(end_x));
+                    memcpy(&width_px, &res->paragraphs[i][8], sizeof(width_px));
+                    memcpy(&width_mm, &res->paragraphs[i][12], sizeof(width_mm));
+                    json_writer_object_begin(w);
+                    json_writer_add_int(w, "start_x", start_x);
+                    json_writer_add_int(w, "end_x", end_x);
+                    json_writer_add_int(w, "width_px", width_px);
+                    // json_writer 只输出整数，宽度换算为微米
+                    json_writer_add_int(w, "width_um", (int64_t)(width_mm * 1000.0f + (width_mm >= 0 ? 0.5f : -0.5f)));
+                    json_writer_object_end(w);
+                }
+                json_writer_array_end(w);
+                json_writer_add_int(w, "timestamp", (int64_t)msg.timestamp);
+                json_writer_object_end(w);
+                
+                // 只有直接发布的结果才计入跟踪，写入离线缓存的结果发布时间不可知
+                if (publish_device_json("device/%s/measurement", w, MQTT_QOS_1, "measurement") == 0 &&
+                    msg.trace_id != 0) {
+                    pm_trace_record_t trace;
+                    trace.trace_id = msg.trace_id;
+                    trace.reserved = 0;
+                    memcpy(trace.stage_us, res->trace_us, sizeof(trace.stage_us));
+                    trace.stage_us[PM_TRACE_PUBLISHED] = pm_metrics_now_us();
+                    pm_metrics_trace_record(&trace);
                 }
                 break;
             }
@@ -2244,6 +2555,9 @@ static void handle_sensor_data()
         // 消息队列错误处理
         LOG_ERROR("Message queue error: %d, %s", ret, strerror(errno));
         
+        // 错误状态发布前先送出已聚合的样本
+        flush_telemetry();
+        
         // 发布错误状态
         publish_device_status(DEVICE_STATUS_ERROR);
         
@@ -2319,6 +2633,9 @@ int main(int argc, char *argv[])
     signal(SIGINT, signal_handler);   // 处理Ctrl+C信号
     signal(SIGTERM, signal_handler);  // 处理终止信号
     
+    // 进程管理器要求时锁定内存（mlockall 不跨 exec 继承）
+    pm_sched_init_process();
+    
     // 初始化消息队列，用于与UART进程通信
     LOG_INFO("Initializing message queues...");
     if (!init_message_queues()) {
@@ -2327,6 +2644,25 @@ int main(int argc, char *argv[])
         // 不直接返回失败，而是继续执行，让主循环处理错误
     } else {
         LOG_INFO("Message queues initialized successfully");
+        // 附加进程管理器的指标共享内存（独立运行时记录为空操作）
+        if (pm_metrics_attach() != 0) {
+            LOG_DEBUG("Metrics segment not available, metrics disabled");
+        }
+        // 通知进程管理器已就绪（独立运行时什么也不做）
+        process_notify_ready();
+    }
+    
+    // 打开离线缓存，恢复上次断网期间未发出的数据
+    g_spool = mqtt_spool_open(MQTT_SPOOL_DIR, NULL);
+    if (!g_spool) {
+        LOG_WARNING("Failed to open offline spool %s, data will be lost while offline", MQTT_SPOOL_DIR);
+    } else if (!mqtt_spool_empty(g_spool)) {
+        LOG_INFO("Offline spool has pending messages, will replay after connecting");
+    }
+    
+    // 创建 Air8000 固件流式转发通道，失败时按文件方式升级
+    if (fota_relay_create(&g_fota_relay) != 0) {
+        LOG_WARNING("Failed to create FOTA relay channel");
     }
     
     // 初始化MQTT客户端
@@ -2339,12 +2675,6 @@ int main(int argc, char *argv[])
         LOG_INFO("MQTT client initialized successfully");
     }
 
-    LOG_INFO("Starting file upload worker thread...");
-    if (!start_file_upload_thread()) {
-        LOG_ERROR("Failed to start file upload worker thread");
-    } else {
-        LOG_INFO("File upload worker thread started");
-    }
     
     // 连接到MQTT服务器
     LOG_INFO("Attempting to connect to MQTT broker...");
@@ -2366,6 +2696,17 @@ int main(int argc, char *argv[])
     
     // 主循环
     g_running = true;
+
+    // 上传线程依赖 g_running，须在其置位后启动
+    LOG_INFO("Starting file upload workers...");
+    if (!start_file_upload_workers()) {
+        LOG_ERROR("Failed to start file upload workers");
+    } else {
+        LOG_INFO("%d file upload workers started", g_upload_worker_count);
+    }
+    if (!init_telemetry()) {
+        LOG_WARNING("Failed to create telemetry aggregator, sensor data will be published one by one");
+    }
     time_t last_reconnect_attempt = 0;
     const int RECONNECT_INTERVAL = 5; // 5秒
     const int CONNECTION_TIMEOUT = 30; // 30秒连接超时
@@ -2373,8 +2714,6 @@ int main(int argc, char *argv[])
     bool published_initial_status = false; // 标记是否已发布初始状态
     time_t connection_start_time = time(NULL); // 连接开始时间
     bool connection_in_progress = false; // 标记是否有连接正在进行
-    time_t last_scan_time = 0; // 上次扫描时间
-    const int SCAN_INTERVAL = 60; // 60秒扫描一次
     
     LOG_INFO("Initializing main loop variables...");
     int loop_count = 0;
@@ -2620,55 +2959,76 @@ int main(int argc, char *argv[])
         // 处理消息队列中的传感器数据
         handle_sensor_data();
         
-        // 检查并发布设备状态（心跳）
-        check_and_publish_status();
+        // 聚合窗口到期时发布一批遥测样本
+        telemetry_batch_poll(g_telemetry);
         
-        // 定期扫描jpg文件并上传
-        time_t now = time(NULL);
-        if (now - last_scan_time >= SCAN_INTERVAL) {
-            bool upload_busy = false;
-            pthread_mutex_lock(&g_file_upload_mutex);
-            upload_busy = g_file_upload_in_progress || g_file_upload_request_pending;
-            pthread_mutex_unlock(&g_file_upload_mutex);
-
-            if (upload_busy) {
-                LOG_INFO("File upload busy, skipping scan");
-            } else if (g_client && mqtt_client_get_state(g_client) == MQTT_CLIENT_STATE_CONNECTED) {
-                LOG_INFO("Scanning for jpg files in /appfs/nfs/picture...");
-                int uploaded = scan_and_upload_jpg_files(g_device_id, "/appfs/nfs/picture");
-                LOG_INFO("Scan completed, uploaded %d files", uploaded);
+        // 在线时按限速回放离线缓存，实时消息照常直接发布
+        if (g_spool && g_client && mqtt_client_get_state(g_client) == MQTT_CLIENT_STATE_CONNECTED) {
+            size_t replayed = mqtt_spool_drain(g_spool, replay_spooled_message, NULL);
+            if (replayed > 0) {
+                LOG_DEBUG("Replayed %zu spooled messages", replayed);
             }
-            last_scan_time = now;
         }
         
-        // 短暂休眠，降低CPU占用
-        usleep(100000); // 100ms
+        // 检查并发布设备状态（心跳）
+        check_and_publish_status();
+        
+        // 按配置周期发布指标摘要
+        check_and_publish_metrics();
+        
+        // handle_sensor_data 在消息队列上最多等待100ms，即为主循环节拍，不再额外休眠
     }
     
     LOG_INFO("Exiting main loop");
     LOG_INFO("Main loop executed %d times, ran for %d seconds", loop_count, (int)(time(NULL) - program_start_time));
     
+    // 送出剩余的遥测样本
+    if (g_telemetry) {
+        telemetry_batch_stats_t tstats;
+        flush_telemetry();
+        telemetry_batch_get_stats(g_telemetry, &tstats);
+        LOG_INFO("Telemetry: %llu samples in %llu batches, %llu bytes, %llu dropped",
+                 (unsigned long long)tstats.samples, (unsigned long long)tstats.batches,
+                 (unsigned long long)tstats.bytes, (unsigned long long)tstats.dropped);
+    }
+    
     // 设备关闭，发布offline状态
     LOG_INFO("Device shutting down, publishing offline status...");
     publish_device_status(DEVICE_STATUS_OFFLINE);
     
     // 清理资源
     // 断开MQTT连接
-    stop_file_upload_thread();
+    stop_file_upload_workers();
     mqtt_client_disconnect(g_client);
     
     // 销毁MQTT客户端
     mqtt_client_destroy(g_client);
+    telemetry_batch_destroy(g_telemetry);
+    g_telemetry = NULL;
+    if (g_spool) {
+        mqtt_spool_stats_t sstats;
+        mqtt_spool_get_stats(g_spool, &sstats);
+        LOG_INFO("Offline spool: %llu spooled, %llu replayed, %llu segments dropped, %s",
+                 (unsigned long long)sstats.appended, (unsigned long long)sstats.replayed,
+                 (unsigned long long)sstats.dropped_segments, sstats.empty ? "empty" : "pending kept on disk");
+        mqtt_spool_close(g_spool);
+        g_spool = NULL;
+    }
     
     // 清理FOTA上下文
     if (g_fota_ctx) {
         fota_destroy(g_fota_ctx);
         g_fota_ctx = NULL;
     }
+    if (fota_relay_active(&g_fota_relay)) {
+        fota_relay_end(&g_fota_relay, false);
+    }
+    fota_relay_close(&g_fota_relay, true);
     
     // 关闭消息队列
     mq_close_queue(g_mq_uart_to_mqtt);
     mq_close_queue(g_mq_mqtt_to_uart);
+    pm_metrics_detach();
     
     printf("MQTT Client stopped\n");
     
@@ -71,17 +71,54 @@ typedef struct fota_context_t fota_context_t;
  */
 typedef void (*fota_callback_t)(fota_context_t *ctx, fota_state_t state, fota_error_t error, void *user_data);
 
+/**
+ * @brief 连续前缀数据回调函数类型
+ * @details 数据按偏移递增、不重复地交付，每个字节恰好一次；分片已写入文件后才回调。
+ *          续传时上次已收到的前缀在 fota_start 中回读交付
+ */
+typedef void (*fota_data_callback_t)(fota_context_t *ctx, uint64_t offset, const uint8_t *data, size_t len, void *user_data);
+
+/**
+ * @brief 断点续传状态文件后缀，与固件文件同目录
+ * @details 内容为 fota_part_header_t 加已接收分片位图，每收到一个分片更新一位
+ */
+#define FOTA_PART_SUFFIX ".part"
+
+/**
+ * @brief 断点续传状态文件魔数 "FOTP"
+ */
+#define FOTA_PART_MAGIC 0x464F5450
+
+/**
+ * @brief 断点续传状态文件头
+ */
+typedef struct {
+    uint32_t magic;             // FOTA_PART_MAGIC
+    uint32_t version;           // 格式版本，当前为1
+    uint64_t file_size;         // 文件总大小
+    uint32_t total_chunks;      // 总分片数
+    uint32_t chunk_size;        // 分片大小，收到第一个分片前为0
+} fota_part_header_t;
+
 /**
  * @brief FOTA上下文结构
+ * @details 文件在开始时预分配，分片按 chunk_id * chunk_size 偏移写入，
+ *          到达顺序任意；SHA-256 沿连续前缀增量计算，结束时无需重读文件
  */
 typedef struct fota_context_t {
     char file_path[1024];      // FOTA文件保存路径
     char dir_path[1024];        // FOTA文件目录路径
-    FILE *file_handle;          // 文件句柄
+    int fd;                     // 文件描述符，未打开为-1
+    int part_fd;                // 断点续传状态文件描述符，未打开为-1
     uint64_t file_size;         // 文件总大小
     uint64_t received_size;     // 已接收大小
-    uint32_t current_chunk;     // 当前分片编号
+    uint32_t current_chunk;     // 连续接收的分片数（已计入SHA-256的前缀）
     uint32_t total_chunks;      // 总分片数
+    uint32_t received_chunks;   // 已接收分片数
+    uint32_t chunk_size;        // 分片大小，由第一个到达的分片确定
+    uint8_t *bitmap;            // 已接收分片位图
+    void *sha_ctx;              // 增量SHA-256上下文
+    uint8_t *read_buffer;       // 回读乱序分片的缓冲区
     fota_state_t state;         // 当前状态
     fota_error_t error;         // 错误码
     uint8_t progress;           // 进度百分比（0-100）
@@ -89,6 +126,8 @@ typedef struct fota_context_t {
     char checksum[65];          // 文件校验和 (SHA256 string)
     fota_callback_t callback;   // 回调函数
     void *user_data;            // 用户数据
+    fota_data_callback_t data_callback; // 连续前缀数据回调
+    void *data_user_data;       // 连续前缀数据回调的用户数据
 } fota_context_t;
 
 // ==================== API 函数声明 ====================
@@ -105,12 +144,25 @@ fota_context_t *fota_create(const char *file_path, const char *dir_path, fota_ca
 
 /**
  * @brief 销毁FOTA上下文
+ * @details 不删除未完成的文件和断点续传状态，下次 fota_start 可继续接收；
+ *          放弃接收应先调用 fota_abort
  * @param ctx FOTA上下文指针
  */
 void fota_destroy(fota_context_t *ctx);
 
+/**
+ * @brief 注册连续前缀数据回调
+ * @details 需在 fota_start 之前注册，用于边接收边转发；回调中阻塞会减慢分片处理
+ * @param ctx FOTA上下文指针
+ * @param callback 回调函数，NULL 表示取消
+ * @param user_data 用户数据
+ */
+void fota_set_data_callback(fota_context_t *ctx, fota_data_callback_t callback, void *user_data);
+
 /**
  * @brief 开始FOTA接收
+ * @details 同一路径存在大小与分片数一致的断点续传状态时继续上次的接收，
+ *          否则重新创建并预分配文件
  * @param ctx FOTA上下文指针
  * @param total_size 文件总大小
  * @param total_chunks 总分片数
@@ -120,6 +172,8 @@ bool fota_start(fota_context_t *ctx, uint64_t total_size, uint32_t total_chunks)
 
 /**
  * @brief 处理FOTA分片数据
+ * @details 分片可按任意顺序到达，重复分片直接返回true；长度与分片大小不符的分片
+ *          被拒绝但不影响整个接收过程
  * @param ctx FOTA上下文指针
  * @param chunk_id 分片编号
  * @param data 分片数据
@@ -128,8 +182,19 @@ bool fota_start(fota_context_t *ctx, uint64_t total_size, uint32_t total_chunks)
  */
 bool fota_process_chunk(fota_context_t *ctx, uint32_t chunk_id, const uint8_t *data, size_t data_len);
 
+/**
+ * @brief 获取尚未收到的分片编号
+ * @param ctx FOTA上下文指针
+ * @param chunks 输出缓冲区（可为NULL，仅统计数量）
+ * @param max_chunks 输出缓冲区容量
+ * @return 缺失分片总数（可能大于max_chunks）
+ */
+uint32_t fota_get_missing_chunks(fota_context_t *ctx, uint32_t *chunks, uint32_t max_chunks);
+
 /**
  * @brief 结束FOTA接收
+ * @details 仍有缺失分片时返回false且保持接收状态，可用 fota_get_missing_chunks
+ *          获取缺失分片后请求重发；全部收到后一次 fdatasync 并校验 SHA-256
  * @param ctx FOTA上下文指针
  * @param checksum 文件校验和 (SHA256 string)
  * @return 成功返回true，失败返回false
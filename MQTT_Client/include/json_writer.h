@@ -0,0 +1,154 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ==================== 常量定义 ====================
+
+/**
+ * @brief 最大嵌套层数
+ */
+#define JSON_WRITER_MAX_DEPTH 16
+
+/**
+ * @brief 每个线程复用的输出缓冲区大小
+ */
+#define JSON_WRITER_THREAD_BUFFER_SIZE 8192
+
+// ==================== 类型定义 ====================
+
+/**
+ * @brief 流式JSON写入器
+ * @details 直接按顺序写入调用方提供的缓冲区，不建树、不分配内存；逗号由写入器自动插入。
+ *          缓冲区不足时置 overflow，之后的写入全部忽略，json_writer_finish 返回NULL
+ */
+typedef struct {
+    char *buf;                  // 输出缓冲区
+    size_t cap;                 // 缓冲区大小
+    size_t len;                 // 已写入长度（不含结尾NUL）
+    int depth;                  // 当前嵌套层数
+    uint32_t has_items;         // 第 d 位置位表示第 d 层已有元素，下一个元素前需要逗号
+    bool after_key;             // 刚写完键名，下一个值前不加逗号
+    bool overflow;              // 缓冲区不足或嵌套过深
+} json_writer_t;
+
+// ==================== API 函数声明 ====================
+
+/**
+ * @brief 以调用方缓冲区初始化写入器
+ * @param w 写入器
+ * @param buf 输出缓冲区
+ * @param cap 缓冲区大小（含结尾NUL）
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t cap);
+
+/**
+ * @brief 获取本线程的写入器
+ * @details 缓冲区为线程局部存储，每次调用都会重置写入器；
+ *          上一次 json_writer_finish 返回的字符串在同一线程再次调用前有效
+ * @return 已重置的写入器
+ */
+json_writer_t *json_writer_thread(void);
+
+/**
+ * @brief 开始对象
+ * @param w 写入器
+ */
+void json_writer_object_begin(json_writer_t *w);
+
+/**
+ * @brief 结束对象
+ * @param w 写入器
+ */
+void json_writer_object_end(json_writer_t *w);
+
+/**
+ * @brief 开始数组
+ * @param w 写入器
+ */
+void json_writer_array_begin(json_writer_t *w);
+
+/**
+ * @brief 结束数组
+ * @param w 写入器
+ */
+void json_writer_array_end(json_writer_t *w);
+
+/**
+ * @brief 写入对象键名（之后必须紧跟一个值）
+ * @param w 写入器
+ * @param key 键名
+ */
+void json_writer_key(json_writer_t *w, const char *key);
+
+/**
+ * @brief 写入字符串值（按需转义）
+ * @param w 写入器
+ * @param s 字符串，NULL写入空字符串
+ */
+void json_writer_string(json_writer_t *w, const char *s);
+
+/**
+ * @brief 写入指定长度的字符串值（按需转义）
+ * @param w 写入器
+ * @param s 字符串，可含NUL以外的任意字节
+ * @param n 长度
+ */
+void json_writer_string_n(json_writer_t *w, const char *s, size_t n);
+
+/**
+ * @brief 写入有符号整数值
+ * @param w 写入器
+ * @param v 整数
+ */
+void json_writer_int(json_writer_t *w, int64_t v);
+
+/**
+ * @brief 写入无符号整数值
+ * @param w 写入器
+ * @param v 整数
+ */
+void json_writer_uint(json_writer_t *w, uint64_t v);
+
+/**
+ * @brief 写入布尔值
+ * @param w 写入器
+ * @param v 布尔值
+ */
+void json_writer_bool(json_writer_t *w, bool v);
+
+/**
+ * @brief 写入字符串成员
+ * @param w 写入器
+ * @param key 键名
+ * @param s 字符串
+ */
+void json_writer_add_string(json_writer_t *w, const char *key, const char *s);
+
+/**
+ * @brief 写入有符号整数成员
+ * @param w 写入器
+ * @param key 键名
+ * @param v 整数
+ */
+void json_writer_add_int(json_writer_t *w, const char *key, int64_t v);
+
+/**
+ * @brief 写入无符号整数成员
+ * @param w 写入器
+ * @param key 键名
+ * @param v 整数
+ */
+void json_writer_add_uint(json_writer_t *w, const char *key, uint64_t v);
+
+/**
+ * @brief 结束写入
+ * @param w 写入器
+ * @param len 输出参数，JSON长度，可为NULL
+ * @return 以NUL结尾的JSON文本（位于写入器缓冲区中）；溢出或括号未闭合返回NULL
+ */
+const char *json_writer_finish(json_writer_t *w, size_t *len);
+
+#endif // JSON_WRITER_H
@@ -70,6 +70,8 @@ typedef struct {
     int connect_timeout_ms;         /**< 连接超时时间，单位毫秒，默认5000 */
     int retry_interval_ms;          /**< 重连间隔时间，单位毫秒，默认2000 */
     int max_retry_count;            /**< 最大重连次数，默认-1（无限重试） */
+    int dispatch_workers;           /**< 消息回调线程数，默认0（在事件循环线程中回调）；
+                                         同一主题的消息始终在同一线程中按序回调 */
 } mqtt_client_config_t;
 
 /**
@@ -99,6 +101,16 @@ typedef void (*mqtt_message_callback_t)(const char *topic, const void *payload,
  */
 typedef void (*mqtt_state_callback_t)(mqtt_client_state_t state, void *user_data);
 
+/**
+ * @brief 异步发布完成回调函数类型
+ * @param mid 由 mqtt_client_publish_async 返回的消息ID
+ * @param result MQTT_ERR_SUCCESS 表示已完成（QoS1收到PUBACK，QoS0已写出），
+ *               MQTT_ERR_DISCONNECTED 表示连接断开前未完成
+ * @param user_data 用户数据
+ * @note 在MQTT事件循环线程中调用，不应阻塞
+ */
+typedef void (*mqtt_publish_callback_t)(int mid, int result, void *user_data);
+
 /**
  * @brief MQTT客户端句柄（不透明结构体）
  */
@@ -139,6 +151,18 @@ int mqtt_client_disconnect(mqtt_client_t client);
  */
 int mqtt_client_publish(mqtt_client_t client, const mqtt_message_t *message);
 
+/**
+ * @brief 异步发布MQTT消息，完成时回调
+ * @param client MQTT客户端句柄
+ * @param message MQTT消息（负载在返回前已被复制）
+ * @param on_complete 完成回调，可为NULL
+ * @param user_data 回调用户数据
+ * @param mid 输出参数，消息ID，可为NULL
+ * @return 成功返回0，失败返回错误码（失败时不会回调）
+ */
+int mqtt_client_publish_async(mqtt_client_t client, const mqtt_message_t *message,
+                              mqtt_publish_callback_t on_complete, void *user_data, int *mid);
+
 /**
  * @brief 订阅MQTT主题
  * @param client MQTT客户端句柄
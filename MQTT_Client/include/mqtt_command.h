@@ -0,0 +1,75 @@
+#ifndef MQTT_COMMAND_H
+#define MQTT_COMMAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ==================== 类型定义 ====================
+
+/**
+ * @brief 指向负载中的字符串（不含引号，未转义）
+ */
+typedef struct {
+    const char *ptr;            // 起始位置，NULL表示字段不存在
+    size_t len;                 // 长度
+} mqtt_command_str_t;
+
+/**
+ * @brief 解析后的控制命令
+ * @details 只识别服务器下发命令用到的字段，其余字段跳过。命令可以是
+ *          {"command_id":N,"content":{...}}，也可以不带 content 直接给出命令字段；
+ *          file_name、file_size、total_chunks、checksum 既可以在命令中，也可以在其 data 对象中。
+ *          所有字符串都指向原负载，负载在使用期间必须保持有效
+ */
+typedef struct {
+    bool has_command_id;        // 是否带 command_id
+    int64_t command_id;         // 命令ID
+    const char *content;        // content 对象原文（含大括号）；没有 content 时为整个负载
+    size_t content_len;         // content 原文长度
+    bool has_action;            // 是否带 action
+    bool action_is_number;      // action 为数字（系统命令）还是字符串（设备名）
+    int action;                 // 数字 action
+    mqtt_command_str_t action_name; // 字符串 action
+    bool has_status;            // 是否带 status（任意类型）
+    int status;                 // 数字或布尔 status，其他类型为0
+    bool has_value;             // 是否带 value
+    int value;                  // 数字 value
+    mqtt_command_str_t file_name;   // 文件名
+    bool has_file_size;         // 是否带 file_size
+    uint64_t file_size;         // 文件大小
+    bool has_total_chunks;      // 是否带 total_chunks
+    uint32_t total_chunks;      // 总分片数
+    mqtt_command_str_t checksum;    // 校验和
+} mqtt_command_t;
+
+// ==================== API 函数声明 ====================
+
+/**
+ * @brief 解析控制命令
+ * @details 只读扫描负载，不分配内存、不修改负载，也不要求负载以NUL结尾
+ * @param payload 负载
+ * @param len 负载长度
+ * @param cmd 输出参数
+ * @return 成功返回0，不是合法的JSON对象返回-1
+ */
+int mqtt_command_parse(const void *payload, size_t len, mqtt_command_t *cmd);
+
+/**
+ * @brief 把字符串字段解转义后复制到缓冲区
+ * @param s 字符串字段
+ * @param buf 输出缓冲区
+ * @param size 缓冲区大小
+ * @return 字段存在且完整放入缓冲区返回true
+ */
+bool mqtt_command_copy_string(const mqtt_command_str_t *s, char *buf, size_t size);
+
+/**
+ * @brief 字符串字段与给定字符串比较（不区分大小写）
+ * @param s 字符串字段
+ * @param text 比较的字符串
+ * @return 相同返回true
+ */
+bool mqtt_command_str_equals(const mqtt_command_str_t *s, const char *text);
+
+#endif // MQTT_COMMAND_H
@@ -0,0 +1,93 @@
+#ifndef MQTT_DISPATCH_H
+#define MQTT_DISPATCH_H
+
+#include <stddef.h>
+#include "mqtt_client.h"
+
+// ==================== 常量定义 ====================
+
+/**
+ * @brief 消息回调线程数上限
+ */
+#define MQTT_DISPATCH_MAX_WORKERS 8
+
+/**
+ * @brief 每个回调线程的待处理消息上限，满时事件循环线程等待
+ */
+#define MQTT_DISPATCH_QUEUE_MAX 64
+
+/**
+ * @brief 单条消息最多匹配的订阅数
+ */
+#define MQTT_DISPATCH_MAX_MATCHES 16
+
+// ==================== 类型定义 ====================
+
+/**
+ * @brief 订阅分发器句柄（不透明结构体）
+ * @details 订阅按主题层级组织成前缀树，"+"、"#" 为独立的通配节点。树在订阅变化时
+ *          整体重建并以指针替换发布，分发路径只读快照、不加锁；旧快照在所有读者
+ *          离开后释放。回调在读区之外执行，回调中可以订阅或取消订阅。
+ */
+typedef struct mqtt_dispatch mqtt_dispatch_t;
+
+// ==================== API 函数声明 ====================
+
+/**
+ * @brief 创建分发器
+ * @param workers 回调线程数，0表示在调用 mqtt_dispatch_message 的线程中直接回调；
+ *                >0 时按主题哈希分配线程，同一主题的消息严格按到达顺序回调
+ * @return 分发器句柄，失败返回NULL
+ */
+mqtt_dispatch_t *mqtt_dispatch_create(int workers);
+
+/**
+ * @brief 销毁分发器，丢弃尚未回调的消息
+ * @param dispatch 分发器句柄
+ */
+void mqtt_dispatch_destroy(mqtt_dispatch_t *dispatch);
+
+/**
+ * @brief 添加订阅
+ * @param dispatch 分发器句柄
+ * @param filter 主题过滤器，可含 "+"、"#"
+ * @param callback 消息回调
+ * @param user_data 回调用户数据
+ * @return 新增返回1，(filter, callback, user_data) 已存在返回0，失败返回-1
+ */
+int mqtt_dispatch_add(mqtt_dispatch_t *dispatch, const char *filter,
+                      mqtt_message_callback_t callback, void *user_data);
+
+/**
+ * @brief 删除过滤器上的全部订阅
+ * @param dispatch 分发器句柄
+ * @param filter 主题过滤器
+ * @return 删除的订阅数
+ */
+int mqtt_dispatch_remove(mqtt_dispatch_t *dispatch, const char *filter);
+
+/**
+ * @brief 删除一个订阅
+ * @param dispatch 分发器句柄
+ * @param filter 主题过滤器
+ * @param callback 消息回调
+ * @param user_data 回调用户数据
+ * @return 删除返回1，不存在返回0
+ */
+int mqtt_dispatch_remove_one(mqtt_dispatch_t *dispatch, const char *filter,
+                             mqtt_message_callback_t callback, void *user_data);
+
+/**
+ * @brief 分发一条消息
+ * @details 匹配在当前快照上完成；有回调线程时复制主题和负载后入队，
+ *          调用返回后 payload 即可释放
+ * @param dispatch 分发器句柄
+ * @param topic 消息主题
+ * @param payload 消息内容
+ * @param payload_len 消息长度
+ * @return 匹配的订阅数
+ */
+int mqtt_dispatch_message(mqtt_dispatch_t *dispatch, const char *topic,
+                          const void *payload, size_t payload_len);
+
+#endif // MQTT_DISPATCH_H
@@ -25,8 +25,31 @@
  */
 #define FILE_UPLOAD_OPERATION_TIMEOUT_MS 5000
 
+/**
+ * @brief 二进制分片头魔数（"FUB1"，大端）
+ */
+#define FILE_UPLOAD_BINARY_MAGIC 0x46554231
+
+/**
+ * @brief 二进制分片上传主题（相对 device/%s）
+ * @details 服务器在 start 的 started 响应中声明 "encoding":"binary" 后使用，
+ *          否则退回 file/upload 主题上的 hex/JSON 分片
+ */
+#define FILE_UPLOAD_BINARY_TOPIC "device/%s/file/upload/binary"
+
 // ==================== 类型定义 ====================
 
+/**
+ * @brief 二进制分片头，后接 data_len 字节原始数据；所有字段均为大端
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // FILE_UPLOAD_BINARY_MAGIC
+    uint32_t file_id;           // 文件数字标识，start 消息中以 bin_id 下发
+    uint32_t chunk_id;          // 分片编号
+    uint32_t data_len;          // 数据长度
+    uint32_t crc32c;            // 数据的 CRC32C（Castagnoli）
+} file_upload_binary_header_t;
+
 /**
  * @brief 文件上传状态枚举
  */
@@ -56,6 +79,9 @@ typedef struct {
     char file_id[64];          // 文件唯一标识
     char filename[256];        // 文件名
     FILE *file_handle;          // 文件句柄
+    const uint8_t *map;         // 文件只读映射，映射失败时为NULL
+    size_t map_len;             // 映射长度
+    uint32_t bin_id;            // 二进制分片头中的文件数字标识
     uint64_t file_size;         // 文件总大小
     uint64_t uploaded_size;     // 已上传大小
     uint32_t current_chunk;     // 当前分片编号
@@ -100,6 +126,76 @@ bool file_upload_start(file_upload_context_t *ctx);
  */
 bool file_upload_get_next_chunk(file_upload_context_t *ctx, uint8_t **chunk_data, size_t *chunk_data_len, uint32_t *chunk_id);
 
+/**
+ * @brief 获取下一个文件分片的映射区视图（不分配、不拷贝）
+ * @param ctx 上传上下文指针
+ * @param chunk_data 输出参数，指向映射区内的分片数据，file_upload_finish 之前有效
+ * @param chunk_data_len 输出参数，分片数据长度
+ * @param chunk_id 输出参数，分片编号
+ * @return 成功返回true；已无分片或文件未能映射返回false
+ */
+bool file_upload_map_next_chunk(file_upload_context_t *ctx, const uint8_t **chunk_data, size_t *chunk_data_len, uint32_t *chunk_id);
+
+/**
+ * @brief 按编号获取分片的映射区视图，用于重发；不改变上传进度
+ * @param ctx 上传上下文指针
+ * @param chunk_id 分片编号
+ * @param chunk_data 输出参数，指向映射区内的分片数据
+ * @param chunk_data_len 输出参数，分片数据长度
+ * @return 成功返回true；编号越界或文件未能映射返回false
+ */
+bool file_upload_map_chunk(const file_upload_context_t *ctx, uint32_t chunk_id, const uint8_t **chunk_data, size_t *chunk_data_len);
+
+/**
+ * @brief 填充二进制分片头
+ * @param ctx 上传上下文指针
+ * @param header 输出参数，分片头
+ * @param chunk_id 分片编号
+ * @param chunk_data 分片数据
+ * @param chunk_data_len 分片数据长度
+ */
+void file_upload_fill_binary_header(const file_upload_context_t *ctx, file_upload_binary_header_t *header,
+                                    uint32_t chunk_id, const uint8_t *chunk_data, size_t chunk_data_len);
+
+/**
+ * @brief 编码 hex/JSON 格式的分片消息（兼容旧服务器）
+ * @details 格式为 {"type":"chunk","file_id":"...","chunk_id":N,"data":"<大写十六进制>"}
+ * @param ctx 上传上下文指针
+ * @param chunk_id 分片编号
+ * @param chunk_data 分片数据
+ * @param chunk_data_len 分片数据长度
+ * @param out 输出缓冲区，需要约 chunk_data_len * 2 + 64 + strlen(file_id) 字节
+ * @param out_size 输出缓冲区大小
+ * @return 消息长度（不含结尾NUL），缓冲区不足返回0
+ */
+size_t file_upload_encode_hex_chunk(const file_upload_context_t *ctx, uint32_t chunk_id,
+                                    const uint8_t *chunk_data, size_t chunk_data_len,
+                                    char *out, size_t out_size);
+
+/**
+ * @brief 编码二进制格式的分片消息：file_upload_binary_header_t + 原始数据
+ * @param ctx 上传上下文指针
+ * @param chunk_id 分片编号
+ * @param chunk_data 分片数据
+ * @param chunk_data_len 分片数据长度
+ * @param out 输出缓冲区
+ * @param out_size 输出缓冲区大小
+ * @return 消息长度，缓冲区不足返回0
+ */
+size_t file_upload_encode_binary_chunk(const file_upload_context_t *ctx, uint32_t chunk_id,
+                                       const uint8_t *chunk_data, size_t chunk_data_len,
+                                       uint8_t *out, size_t out_size);
+
+/**
+ * @brief 计算 CRC32C（Castagnoli，反射多项式 0x82F63B78）
+ * @details 转调 UART 共享校验和模块的 air8000_crc32c_update
+ * @param crc 初始值，首次调用传0
+ * @param data 数据
+ * @param len 数据长度
+ * @return CRC32C 值
+ */
+uint32_t file_upload_crc32c(uint32_t crc, const uint8_t *data, size_t len);
+
 /**
  * @brief 完成文件分片上传
  * @param ctx 上传上下文指针
@@ -0,0 +1,146 @@
+#ifndef MQTT_SPOOL_H
+#define MQTT_SPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ==================== 常量定义 ====================
+
+/**
+ * @brief 默认段文件大小
+ */
+#define MQTT_SPOOL_DEFAULT_SEGMENT_SIZE (1024 * 1024)
+
+/**
+ * @brief 默认最多保留的段数，超过时丢弃最旧的段
+ */
+#define MQTT_SPOOL_DEFAULT_MAX_SEGMENTS 16
+
+/**
+ * @brief 默认回放速率（条/秒）
+ */
+#define MQTT_SPOOL_DEFAULT_DRAIN_RATE 20
+
+/**
+ * @brief 默认回放突发上限（条）
+ */
+#define MQTT_SPOOL_DEFAULT_DRAIN_BURST 20
+
+/**
+ * @brief 主题最大长度（不含结尾NUL）
+ */
+#define MQTT_SPOOL_TOPIC_MAX 255
+
+// ==================== 类型定义 ====================
+
+/**
+ * @brief 离线缓存配置
+ */
+typedef struct {
+    size_t segment_size;            // 段文件大小，0使用默认值
+    size_t max_segments;            // 最多保留的段数，0使用默认值
+    uint32_t drain_rate;            // 回放速率（条/秒），0使用默认值
+    uint32_t drain_burst;           // 回放突发上限（条），0使用默认值
+} mqtt_spool_config_t;
+
+/**
+ * @brief 回放的消息
+ * @details topic 与 payload 只在回调期间有效
+ */
+typedef struct {
+    const char *topic;              // 主题
+    const void *payload;            // 负载（指向段文件映射）
+    size_t payload_len;             // 负载长度
+    int qos;                        // QoS级别
+    uint64_t seq;                   // 写入序号
+} mqtt_spool_record_t;
+
+/**
+ * @brief 回放回调
+ * @param record 消息
+ * @param user_data 用户数据
+ * @return 已发出返回0；返回非0时停止本轮回放，该消息下次重试
+ */
+typedef int (*mqtt_spool_replay_cb)(const mqtt_spool_record_t *record, void *user_data);
+
+/**
+ * @brief 离线缓存统计
+ */
+typedef struct {
+    uint64_t appended;              // 累计写入条数
+    uint64_t replayed;              // 累计回放条数
+    uint64_t rejected;              // 过大无法写入的条数
+    uint64_t dropped_segments;      // 超出段数上限被丢弃的段数
+    uint64_t corrupt;               // 校验失败跳过的记录数
+    size_t segments;                // 当前段数
+    bool empty;                     // 是否已全部回放
+} mqtt_spool_stats_t;
+
+/**
+ * @brief 离线缓存句柄（不透明结构体）
+ * @details 目录下按序号命名的段文件组成只追加日志，每条记录带 CRC32C 与序号。
+ *          写入可在任意线程进行；回放、mqtt_spool_empty 和 mqtt_spool_get_stats 只能在同一个线程中调用
+ */
+typedef struct mqtt_spool mqtt_spool_t;
+
+// ==================== API 函数声明 ====================
+
+/**
+ * @brief 填充默认配置
+ * @param config 输出参数
+ */
+void mqtt_spool_default_config(mqtt_spool_config_t *config);
+
+/**
+ * @brief 打开离线缓存，恢复上次未回放的记录
+ * @param directory 段文件目录，不存在时创建
+ * @param config 配置，NULL使用默认配置
+ * @return 句柄，失败返回NULL
+ */
+mqtt_spool_t *mqtt_spool_open(const char *directory, const mqtt_spool_config_t *config);
+
+/**
+ * @brief 关闭离线缓存（未回放的记录保留在磁盘上）
+ * @param spool 句柄
+ */
+void mqtt_spool_close(mqtt_spool_t *spool);
+
+/**
+ * @brief 追加一条消息
+ * @details 只做一次负载拷贝到映射的段文件中，不等待落盘；段文件创建时已分配全部磁盘块，
+ *          磁盘空间不足表现为换段失败，不会在写映射时触发 SIGBUS
+ * @param spool 句柄
+ * @param topic 主题
+ * @param payload 负载
+ * @param payload_len 负载长度
+ * @param qos QoS级别
+ * @return 成功返回0，失败（参数非法、记录过大或新段无法分配磁盘空间）返回-1
+ */
+int mqtt_spool_append(mqtt_spool_t *spool, const char *topic, const void *payload, size_t payload_len, int qos);
+
+/**
+ * @brief 按速率限制回放一部分消息，不阻塞（在主循环中周期调用）
+ * @details 回放完全部记录后删除已回放的段文件
+ * @param spool 句柄
+ * @param replay_cb 回放回调
+ * @param user_data 回调用户数据
+ * @return 本次回放的条数
+ */
+size_t mqtt_spool_drain(mqtt_spool_t *spool, mqtt_spool_replay_cb replay_cb, void *user_data);
+
+/**
+ * @brief 是否没有待回放的记录
+ * @param spool 句柄
+ * @return 没有待回放记录返回true
+ */
+bool mqtt_spool_empty(mqtt_spool_t *spool);
+
+/**
+ * @brief 获取统计
+ * @param spool 句柄
+ * @param stats 输出参数
+ */
+void mqtt_spool_get_stats(mqtt_spool_t *spool, mqtt_spool_stats_t *stats);
+
+#endif // MQTT_SPOOL_H
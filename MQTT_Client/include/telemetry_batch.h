@@ -0,0 +1,155 @@
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ==================== 常量定义 ====================
+
+/**
+ * @brief 最多注册的数据序列数
+ */
+#define TELEMETRY_BATCH_MAX_SERIES 8
+
+/**
+ * @brief 每个序列最多的字段数
+ */
+#define TELEMETRY_BATCH_MAX_FIELDS 8
+
+/**
+ * @brief 序列名和字段名最大长度（含结尾NUL）
+ */
+#define TELEMETRY_BATCH_NAME_MAX 32
+
+/**
+ * @brief 默认聚合窗口（毫秒）：窗口内第一个样本到达后最多等待这么久
+ */
+#define TELEMETRY_BATCH_DEFAULT_WINDOW_MS 10000
+
+/**
+ * @brief 默认每批最多样本数
+ */
+#define TELEMETRY_BATCH_DEFAULT_MAX_SAMPLES 64
+
+/**
+ * @brief 默认每批样本部分的编码大小上限（字节）
+ */
+#define TELEMETRY_BATCH_DEFAULT_MAX_BYTES 4096
+
+// ==================== 类型定义 ====================
+
+/**
+ * @brief 批量负载编码格式
+ */
+typedef enum {
+    TELEMETRY_FORMAT_JSON = 0,      // JSON文本
+    TELEMETRY_FORMAT_CBOR           // CBOR（RFC 8949），结构与JSON相同
+} telemetry_format_t;
+
+/**
+ * @brief 聚合器配置
+ * @details 达到样本数上限、编码大小上限或窗口到期时发送一批，三者取先到者
+ */
+typedef struct {
+    uint32_t window_ms;             // 聚合窗口，0使用默认值
+    size_t max_samples;             // 每批最多样本数，0使用默认值
+    size_t max_bytes;               // 每批样本部分编码大小上限，0使用默认值
+    telemetry_format_t format;      // 编码格式
+    bool delta;                     // 同一序列的时间戳和字段值按与上一样本的差值编码
+    const char *device_id;          // 写入负载的设备ID，可为NULL
+} telemetry_batch_config_t;
+
+/**
+ * @brief 发送一批的回调
+ * @param payload 编码后的负载（聚合器内部缓冲区，回调返回后失效；回调中不能再调用聚合器）
+ * @param len 负载长度
+ * @param format 编码格式
+ * @param sample_count 本批样本数
+ * @param user_data 用户数据
+ */
+typedef void (*telemetry_batch_flush_cb)(const void *payload, size_t len, telemetry_format_t format,
+                                         size_t sample_count, void *user_data);
+
+/**
+ * @brief 聚合器统计
+ */
+typedef struct {
+    uint64_t samples;               // 累计样本数
+    uint64_t batches;               // 累计发送批数
+    uint64_t bytes;                 // 累计负载字节数
+    uint64_t dropped;               // 编码失败丢弃的样本数
+} telemetry_batch_stats_t;
+
+/**
+ * @brief 聚合器句柄（不透明结构体）
+ * @details 不加锁，所有调用必须在同一线程
+ */
+typedef struct telemetry_batch telemetry_batch_t;
+
+// ==================== API 函数声明 ====================
+
+/**
+ * @brief 填充默认配置（JSON、差值编码）
+ * @param config 输出参数
+ */
+void telemetry_batch_default_config(telemetry_batch_config_t *config);
+
+/**
+ * @brief 创建聚合器
+ * @param config 配置，NULL使用默认配置
+ * @param flush_cb 发送回调
+ * @param user_data 回调用户数据
+ * @return 聚合器句柄，失败返回NULL
+ */
+telemetry_batch_t *telemetry_batch_create(const telemetry_batch_config_t *config,
+                                          telemetry_batch_flush_cb flush_cb, void *user_data);
+
+/**
+ * @brief 销毁聚合器（未发送的样本直接丢弃，需要时先调用 telemetry_batch_flush）
+ * @param batch 聚合器句柄
+ */
+void telemetry_batch_destroy(telemetry_batch_t *batch);
+
+/**
+ * @brief 注册数据序列
+ * @param batch 聚合器句柄
+ * @param name 序列名
+ * @param fields 字段名数组
+ * @param field_count 字段数，可为0（只记录时间戳的事件）
+ * @return 序列ID，失败返回-1
+ */
+int telemetry_batch_add_series(telemetry_batch_t *batch, const char *name,
+                               const char *const *fields, size_t field_count);
+
+/**
+ * @brief 添加一个样本，达到样本数或大小上限时立即发送
+ * @param batch 聚合器句柄
+ * @param series 序列ID
+ * @param timestamp 样本时间戳（秒）
+ * @param values 字段值，个数等于注册时的字段数
+ * @return 成功返回0，参数错误返回-1
+ */
+int telemetry_batch_add(telemetry_batch_t *batch, int series, uint32_t timestamp, const int32_t *values);
+
+/**
+ * @brief 检查聚合窗口，到期时发送（在主循环中周期调用）
+ * @param batch 聚合器句柄
+ */
+void telemetry_batch_poll(telemetry_batch_t *batch);
+
+/**
+ * @brief 立即发送已聚合的样本（优先事件发布前调用，保持先后顺序）
+ * @param batch 聚合器句柄
+ * @return 发送的样本数
+ */
+size_t telemetry_batch_flush(telemetry_batch_t *batch);
+
+/**
+ * @brief 获取统计
+ * @param batch 聚合器句柄
+ * @param stats 输出参数
+ */
+void telemetry_batch_get_stats(const telemetry_batch_t *batch, telemetry_batch_stats_t *stats);
+
+#endif // TELEMETRY_BATCH_H
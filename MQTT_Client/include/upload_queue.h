@@ -0,0 +1,161 @@
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// ==================== 常量定义 ====================
+
+/**
+ * @brief 上传任务文件路径最大长度
+ */
+#define UPLOAD_QUEUE_PATH_MAX 1024
+
+/**
+ * @brief 默认队列容量（待上传 + 上传中）
+ */
+#define UPLOAD_QUEUE_DEFAULT_CAPACITY 128
+
+/**
+ * @brief 最近完成任务的去重记录数
+ */
+#define UPLOAD_QUEUE_DONE_HISTORY 256
+
+/**
+ * @brief 单个任务最大尝试次数，超过后丢弃
+ */
+#define UPLOAD_QUEUE_MAX_ATTEMPTS 5
+
+// ==================== 类型定义 ====================
+
+/**
+ * @brief 任务优先级，数值越大越先出队；同优先级按入队顺序
+ */
+typedef enum {
+    UPLOAD_PRIORITY_LOW = 0,        // 启动时补传的积压文件
+    UPLOAD_PRIORITY_NORMAL,         // 新写入的图片
+    UPLOAD_PRIORITY_HIGH            // 服务器命令指定的文件
+} upload_priority_t;
+
+/**
+ * @brief 入队结果
+ */
+typedef enum {
+    UPLOAD_QUEUE_OK = 0,            // 已入队
+    UPLOAD_QUEUE_DUPLICATE,         // 同一文件已在队列中或刚上传过
+    UPLOAD_QUEUE_FULL,              // 队列已满且无更低优先级任务可替换
+    UPLOAD_QUEUE_ERR_FILE,          // 文件不存在或不是普通文件
+    UPLOAD_QUEUE_ERR_PARAM          // 参数错误或队列已关闭
+} upload_queue_result_t;
+
+/**
+ * @brief 上传任务
+ * @details 文件以 (dev, ino, mtime, size) 标识：同一 inode 未被改写时视为同一文件，
+ *          不再读取或计算校验和
+ */
+typedef struct {
+    uint64_t id;                            // 入队序号
+    char path[UPLOAD_QUEUE_PATH_MAX];       // 文件路径
+    upload_priority_t priority;             // 优先级
+    dev_t dev;                              // 设备号
+    ino_t ino;                              // inode
+    int64_t mtime_ns;                       // 修改时间（纳秒）
+    int64_t size;                           // 文件大小
+    int attempts;                           // 已尝试次数
+} upload_job_t;
+
+/**
+ * @brief 队列统计
+ */
+typedef struct {
+    size_t pending;                 // 待上传
+    size_t in_flight;               // 上传中
+    uint64_t enqueued;              // 累计入队
+    uint64_t duplicates;            // 累计去重
+    uint64_t completed;             // 累计完成
+    uint64_t failed;                // 累计放弃
+    uint64_t evicted;               // 队列满时被高优先级任务替换
+} upload_queue_stats_t;
+
+/**
+ * @brief 上传队列句柄（不透明结构体）
+ */
+typedef struct upload_queue upload_queue_t;
+
+// ==================== API 函数声明 ====================
+
+/**
+ * @brief 创建上传队列
+ * @param journal_path 持久化日志路径，NULL表示不持久化；已存在时恢复未完成任务
+ * @param capacity 队列容量，0使用默认值
+ * @return 队列句柄，失败返回NULL
+ */
+upload_queue_t *upload_queue_create(const char *journal_path, size_t capacity);
+
+/**
+ * @brief 销毁上传队列（需先停止目录监视和所有工作线程）
+ * @param queue 队列句柄
+ */
+void upload_queue_destroy(upload_queue_t *queue);
+
+/**
+ * @brief 文件入队
+ * @param queue 队列句柄
+ * @param path 文件路径
+ * @param priority 优先级
+ * @param force 为true时忽略"刚上传过"的记录（服务器明确要求重传时使用）
+ * @return 入队结果
+ */
+upload_queue_result_t upload_queue_push(upload_queue_t *queue, const char *path, upload_priority_t priority, bool force);
+
+/**
+ * @brief 取出优先级最高的任务，任务转为上传中
+ * @param queue 队列句柄
+ * @param job 输出参数，任务
+ * @param timeout_ms 等待时间，<0 表示一直等待
+ * @return 取到任务返回true；超时或队列关闭返回false
+ */
+bool upload_queue_pop(upload_queue_t *queue, upload_job_t *job, int timeout_ms);
+
+/**
+ * @brief 结束一个上传中的任务
+ * @details 成功或尝试次数用尽时从日志中删除；否则回到同优先级队尾等待重试
+ * @param queue 队列句柄
+ * @param job upload_queue_pop 取出的任务
+ * @param success 是否上传成功
+ */
+void upload_queue_complete(upload_queue_t *queue, const upload_job_t *job, bool success);
+
+/**
+ * @brief 关闭队列，唤醒所有阻塞在 upload_queue_pop 的线程
+ * @param queue 队列句柄
+ */
+void upload_queue_shutdown(upload_queue_t *queue);
+
+/**
+ * @brief 获取队列统计
+ * @param queue 队列句柄
+ * @param stats 输出参数
+ */
+void upload_queue_get_stats(upload_queue_t *queue, upload_queue_stats_t *stats);
+
+/**
+ * @brief 监视目录，写入完成（IN_CLOSE_WRITE）或移入（IN_MOVED_TO）的文件自动入队
+ * @details 启动时先扫描一次目录，把比最近一次完成上传更新的文件以 LOW 优先级入队，
+ *          补上进程未运行期间写入的文件；之后完全由 inotify 驱动，不再定时扫描
+ * @param queue 队列句柄
+ * @param directory 目录
+ * @param suffix 文件后缀（不区分大小写，如".jpg"），NULL表示全部文件
+ * @return 成功返回0，失败返回-1
+ */
+int upload_queue_watch_dir(upload_queue_t *queue, const char *directory, const char *suffix);
+
+/**
+ * @brief 停止目录监视线程
+ * @param queue 队列句柄
+ */
+void upload_queue_unwatch(upload_queue_t *queue);
+
+#endif // UPLOAD_QUEUE_H
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "fota_file_download.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +9,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
 #include <openssl/evp.h>
 
 // ==================== 内部函数声明 ====================
@@ -35,7 +38,49 @@ static bool try_create_directory(const char *dir_path, int max_retries);
 /**
  * @brief 尝试打开文件（带重试）
  */
-static FILE *try_open_file(const char *file_path, const char *mode, int max_retries);
+static int try_open_fd(const char *file_path, int flags, int max_retries);
+
+/**
+ * @brief 释放文件描述符、位图与SHA-256上下文，不删除文件
+ */
+static void release_resources(fota_context_t *ctx);
+
+/**
+ * @brief 尝试从断点续传状态文件恢复，成功返回true
+ */
+static bool resume_from_part(fota_context_t *ctx, const char *part_path);
+
+/**
+ * @brief 推进连续前缀：后续已到达的乱序分片回读后计入SHA-256
+ */
+static void advance_hash(fota_context_t *ctx);
+
+/**
+ * @brief 按分片长度确定或校验分片大小
+ */
+static bool check_chunk_length(fota_context_t *ctx, uint32_t chunk_id, size_t data_len);
+
+/**
+ * @brief 带重试的定位写
+ */
+static bool pwrite_all(int fd, const void *data, size_t len, off_t offset);
+
+static bool chunk_received(const fota_context_t *ctx, uint32_t chunk_id) {
+    return (ctx->bitmap[chunk_id / 8] >> (chunk_id % 8)) & 1;
+}
+
+static uint64_t chunk_offset(const fota_context_t *ctx, uint32_t chunk_id) {
+    return (uint64_t)chunk_id * ctx->chunk_size;
+}
+
+static size_t chunk_length(const fota_context_t *ctx, uint32_t chunk_id) {
+    return chunk_id + 1 < ctx->total_chunks ? ctx->chunk_size
+                                            : (size_t)(ctx->file_size - chunk_offset(ctx, chunk_id));
+}
+
+static void part_path_of(const fota_context_t *ctx, char *buffer, size_t size) {
+    snprintf(buffer, size, "%s%s", ctx->file_path, FOTA_PART_SUFFIX);
+}
 
 // ==================== API 函数实现 ====================
 
@@ -70,7 +115,8 @@ fota_context_t *fota_create(const char *file_path, const char *dir_path, fota_ca
     // 初始化状态
     ctx->state = FOTA_STATE_IDLE;
     ctx->error = FOTA_ERR_NONE;
-    ctx->file_handle = NULL;
+    ctx->fd = -1;
+    ctx->part_fd = -1;
     ctx->file_size = 0;
     ctx->received_size = 0;
     ctx->current_chunk = 0;
@@ -87,16 +133,21 @@ void fota_destroy(fota_context_t *ctx) {
         return;
     }
 
-    // 关闭文件
-    if (ctx->file_handle) {
-        fclose(ctx->file_handle);
-        ctx->file_handle = NULL;
-    }
+    // 未完成的文件与断点续传状态保留在磁盘上
+    release_resources(ctx);
 
     // 释放内存
     free(ctx);
 }
 
+void fota_set_data_callback(fota_context_t *ctx, fota_data_callback_t callback, void *user_data) {
+    if (!ctx) {
+        return;
+    }
+    ctx->data_callback = callback;
+    ctx->data_user_data = user_data;
+}
+
 bool fota_start(fota_context_t *ctx, uint64_t total_size, uint32_t total_chunks) {
     if (!ctx) {
         return false;
@@ -108,9 +159,8 @@ bool fota_start(fota_context_t *ctx, uint64_t total_size, uint32_t total_chunks)
         return false;
     }
 
-    // 检查磁盘空间
-    if (!fota_check_disk_space(ctx->dir_path, total_size)) {
-        update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_DISK_SPACE);
+    if (total_chunks == 0 || total_size < total_chunks) {
+        update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_OTHER);
         return false;
     }
 
@@ -120,21 +170,74 @@ bool fota_start(fota_context_t *ctx, uint64_t total_size, uint32_t total_chunks)
         return false;
     }
 
-    // 尝试打开文件
-    ctx->file_handle = try_open_file(ctx->file_path, "wb", FOTA_MAX_RETRY_COUNT);
-    if (!ctx->file_handle) {
-        update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
-        return false;
-    }
-
-    // 更新状态
+    size_t bitmap_len = (total_chunks + 7) / 8;
     ctx->file_size = total_size;
     ctx->total_chunks = total_chunks;
     ctx->received_size = 0;
+    ctx->received_chunks = 0;
     ctx->current_chunk = 0;
+    ctx->chunk_size = 0;
     ctx->progress = 0;
     ctx->aborted = false;
-    update_fota_state(ctx, FOTA_STATE_RECEIVING, FOTA_ERR_NONE);
+    ctx->bitmap = (uint8_t *)calloc(1, bitmap_len);
+    ctx->sha_ctx = EVP_MD_CTX_new();
+    if (!ctx->bitmap || !ctx->sha_ctx || EVP_DigestInit_ex((EVP_MD_CTX *)ctx->sha_ctx, EVP_sha256(), NULL) != 1) {
+        release_resources(ctx);
+        update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_NOMEM);
+        return false;
+    }
+
+    char part_path[1100];
+    part_path_of(ctx, part_path, sizeof(part_path));
+    if (!resume_from_part(ctx, part_path)) {
+        // 检查磁盘空间
+        if (!fota_check_disk_space(ctx->dir_path, total_size)) {
+            release_resources(ctx);
+            update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_DISK_SPACE);
+            return false;
+        }
+
+        ctx->fd = try_open_fd(ctx->file_path, O_RDWR | O_CREAT | O_TRUNC, FOTA_MAX_RETRY_COUNT);
+        ctx->part_fd = try_open_fd(part_path, O_RDWR | O_CREAT | O_TRUNC, FOTA_MAX_RETRY_COUNT);
+        if (ctx->fd < 0 || ctx->part_fd < 0) {
+            release_resources(ctx);
+            update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
+            return false;
+        }
+
+        // 预分配整个文件，写入时不再扩展；不支持预分配的文件系统只设置大小
+        if (fallocate(ctx->fd, 0, 0, (off_t)total_size) != 0) {
+            int err = errno;
+            if (err == ENOSPC) {
+                release_resources(ctx);
+                update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_DISK_SPACE);
+                return false;
+            }
+            if (ftruncate(ctx->fd, (off_t)total_size) != 0) {
+                release_resources(ctx);
+                update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
+                return false;
+            }
+        }
+
+        fota_part_header_t header = {
+            .magic = FOTA_PART_MAGIC,
+            .version = 1,
+            .file_size = total_size,
+            .total_chunks = total_chunks,
+            .chunk_size = 0
+        };
+        if (!pwrite_all(ctx->part_fd, &header, sizeof(header), 0) ||
+            !pwrite_all(ctx->part_fd, ctx->bitmap, bitmap_len, sizeof(header))) {
+            release_resources(ctx);
+            update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
+            return false;
+        }
+    }
+
+    // 更新状态
+    update_fota_state(ctx, ctx->received_chunks >= ctx->total_chunks ? FOTA_STATE_COMPLETE : FOTA_STATE_RECEIVING,
+                      FOTA_ERR_NONE);
 
     return true;
 }
@@ -145,74 +248,44 @@ bool fota_process_chunk(fota_context_t *ctx, uint32_t chunk_id, const uint8_t *d
     }
 
     // 检查状态
-    if (ctx->state != FOTA_STATE_RECEIVING) {
+    if (ctx->state != FOTA_STATE_RECEIVING && ctx->state != FOTA_STATE_COMPLETE) {
         return false;
     }
 
-    // 检查分片编号
-    if (chunk_id != ctx->current_chunk) {
-        // 分片乱序，这里可以实现重排序逻辑
-        // 暂时返回失败
-        update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_OTHER);
+    // 检查分片编号与长度，不合法的分片只丢弃该分片
+    if (chunk_id >= ctx->total_chunks || !check_chunk_length(ctx, chunk_id, data_len)) {
         return false;
     }
 
-    // 写入文件（带重试）
-    size_t written = 0;
-    int retry_count = 0;
-    
-    while (retry_count < FOTA_MAX_RETRY_COUNT) {
-        written = fwrite(data, 1, data_len, ctx->file_handle);
-        if (written == data_len) {
-            break;
-        }
-        
-        // 检查错误类型
-        if (errno == EIO || errno == ENOSPC) {
-            // 设备I/O错误或磁盘空间不足
-            retry_count++;
-            // 短暂延迟后重试
-            usleep(100000); // 100ms
-        } else {
-            // 其他错误，直接返回失败
-            update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
-            return false;
-        }
+    // 重发的分片已写入
+    if (chunk_received(ctx, chunk_id)) {
+        return true;
     }
-    
-    if (written != data_len) {
+
+    if (!pwrite_all(ctx->fd, data, data_len, (off_t)chunk_offset(ctx, chunk_id))) {
         update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
         return false;
     }
 
-    // 刷新文件缓冲区（带重试）
-    retry_count = 0;
-    while (retry_count < FOTA_MAX_RETRY_COUNT) {
-        if (fflush(ctx->file_handle) == 0) {
-            break;
-        }
-        
-        // 检查错误类型
-        if (errno == EIO) {
-            // 设备I/O错误
-            retry_count++;
-            // 短暂延迟后重试
-            usleep(100000); // 100ms
-        } else {
-            // 其他错误，直接返回失败
-            update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
-            return false;
-        }
-    }
-    
-    if (retry_count >= FOTA_MAX_RETRY_COUNT) {
-        update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
-        return false;
+    // 位图只改一个字节；不逐片同步，掉电丢失的分片由最终校验发现
+    ctx->bitmap[chunk_id / 8] |= (uint8_t)(1u << (chunk_id % 8));
+    if (!pwrite_all(ctx->part_fd, &ctx->bitmap[chunk_id / 8], 1, (off_t)(sizeof(fota_part_header_t) + chunk_id / 8))) {
+        fprintf(stderr, "FOTA: failed to record chunk %u in %s%s\n", chunk_id, ctx->file_path, FOTA_PART_SUFFIX);
     }
 
     // 更新状态
     ctx->received_size += data_len;
-    ctx->current_chunk++;
+    ctx->received_chunks++;
+
+    // 按序到达时直接计入SHA-256
+    if (chunk_id == ctx->current_chunk) {
+        EVP_DigestUpdate((EVP_MD_CTX *)ctx->sha_ctx, data, data_len);
+        if (ctx->data_callback) {
+            ctx->data_callback(ctx, chunk_offset(ctx, chunk_id), data, data_len, ctx->data_user_data);
+        }
+        ctx->current_chunk++;
+        advance_hash(ctx);
+    }
     
     // 计算进度
     if (ctx->file_size > 0) {
@@ -220,13 +293,31 @@ bool fota_process_chunk(fota_context_t *ctx, uint32_t chunk_id, const uint8_t *d
     }
 
     // 检查是否接收完成
-    if (ctx->current_chunk >= ctx->total_chunks) {
+    if (ctx->received_chunks >= ctx->total_chunks) {
         update_fota_state(ctx, FOTA_STATE_COMPLETE, FOTA_ERR_NONE);
     }
 
     return true;
 }
 
+uint32_t fota_get_missing_chunks(fota_context_t *ctx, uint32_t *chunks, uint32_t max_chunks) {
+    if (!ctx || !ctx->bitmap) {
+        return 0;
+    }
+
+    uint32_t missing = 0;
+    // 连续前缀之前的分片都已收到
+    for (uint32_t i = ctx->current_chunk; i < ctx->total_chunks; i++) {
+        if (!chunk_received(ctx, i)) {
+            if (chunks && missing < max_chunks) {
+                chunks[missing] = i;
+            }
+            missing++;
+        }
+    }
+    return missing;
+}
+
 bool fota_finish(fota_context_t *ctx, const char *checksum) {
     if (!ctx) {
         return false;
@@ -237,30 +328,40 @@ bool fota_finish(fota_context_t *ctx, const char *checksum) {
         return false;
     }
 
-    // 关闭文件
-    if (ctx->file_handle) {
-        if (fclose(ctx->file_handle) != 0) {
-            update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
-            ctx->file_handle = NULL;
-            return false;
-        }
-        ctx->file_handle = NULL;
+    if (!checksum) {
+        return false;
     }
 
-    // 验证文件大小
+    // 全部分片一次落盘
     struct stat file_stat;
-    if (stat(ctx->file_path, &file_stat) != 0) {
+    if (fdatasync(ctx->fd) != 0 || fstat(ctx->fd, &file_stat) != 0 ||
+        (uint64_t)file_stat.st_size != ctx->file_size) {
         update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
         return false;
     }
 
-    if ((uint64_t)file_stat.st_size != ctx->file_size) {
-        update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_FILE);
-        return false;
+    bool checksum_ok;
+    if (ctx->current_chunk >= ctx->total_chunks) {
+        unsigned char hash[EVP_MAX_MD_SIZE];
+        unsigned int hash_len = 0;
+        char calculated_checksum[65] = {0};
+        EVP_DigestFinal_ex((EVP_MD_CTX *)ctx->sha_ctx, hash, &hash_len);
+        for (unsigned int i = 0; i < hash_len && i < 32; i++) {
+            sprintf(calculated_checksum + i * 2, "%02x", hash[i]);
+        }
+        checksum_ok = strcasecmp(calculated_checksum, checksum) == 0;
+    } else {
+        // 回读失败导致前缀未走完，退回整文件校验
+        checksum_ok = verify_file_checksum(ctx->file_path, checksum);
     }
 
+    char part_path[1100];
+    part_path_of(ctx, part_path, sizeof(part_path));
+    release_resources(ctx);
+    unlink(part_path);
+
     // 验证文件校验和
-    if (!verify_file_checksum(ctx->file_path, checksum)) {
+    if (!checksum_ok) {
         update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_CHECKSUM);
         // 删除校验失败的文件
         unlink(ctx->file_path);
@@ -284,13 +385,13 @@ bool fota_abort(fota_context_t *ctx) {
     ctx->aborted = true;
 
     // 关闭文件
-    if (ctx->file_handle) {
-        fclose(ctx->file_handle);
-        ctx->file_handle = NULL;
-    }
+    release_resources(ctx);
 
-    // 删除部分文件
+    // 删除部分文件与断点续传状态
+    char part_path[1100];
+    part_path_of(ctx, part_path, sizeof(part_path));
     unlink(ctx->file_path);
+    unlink(part_path);
 
     // 更新状态
     update_fota_state(ctx, FOTA_STATE_FAILED, FOTA_ERR_OTHER);
@@ -441,21 +542,161 @@ static bool try_create_directory(const char *dir_path, int max_retries) {
     return false;
 }
 
-static FILE *try_open_file(const char *file_path, const char *mode, int max_retries) {
-    FILE *file = NULL;
-    
+static int try_open_fd(const char *file_path, int flags, int max_retries) {
     for (int i = 0; i < max_retries; i++) {
-        file = fopen(file_path, mode);
-        if (file) {
-            return file;
+        int fd = open(file_path, flags | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            return fd;
         }
         
         // 短暂延迟后重试
         usleep(100000); // 100ms
     }
     
-    return NULL;
+    return -1;
+}
+
+static void release_resources(fota_context_t *ctx) {
+    if (ctx->fd >= 0) {
+        close(ctx->fd);
+        ctx->fd = -1;
+    }
+    if (ctx->part_fd >= 0) {
+        close(ctx->part_fd);
+        ctx->part_fd = -1;
+    }
+    EVP_MD_CTX_free((EVP_MD_CTX *)ctx->sha_ctx);
+    ctx->sha_ctx = NULL;
+    free(ctx->bitmap);
+    ctx->bitmap = NULL;
+    free(ctx->read_buffer);
+    ctx->read_buffer = NULL;
+}
+
+static bool resume_from_part(fota_context_t *ctx, const char *part_path) {
+    int part_fd = open(part_path, O_RDWR | O_CLOEXEC);
+    if (part_fd < 0) {
+        return false;
+    }
+
+    fota_part_header_t header;
+    size_t bitmap_len = (ctx->total_chunks + 7) / 8;
+    struct stat file_stat;
+    bool ok = pread(part_fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+              header.magic == FOTA_PART_MAGIC && header.version == 1 &&
+              header.file_size == ctx->file_size && header.total_chunks == ctx->total_chunks &&
+              pread(part_fd, ctx->bitmap, bitmap_len, sizeof(header)) == (ssize_t)bitmap_len &&
+              stat(ctx->file_path, &file_stat) == 0 && (uint64_t)file_stat.st_size == ctx->file_size;
+    if (ok) {
+        ctx->fd = try_open_fd(ctx->file_path, O_RDWR, FOTA_MAX_RETRY_COUNT);
+        ok = ctx->fd >= 0;
+    }
+    if (!ok) {
+        close(part_fd);
+        memset(ctx->bitmap, 0, bitmap_len);
+        return false;
+    }
+
+    ctx->part_fd = part_fd;
+    ctx->chunk_size = header.chunk_size;
+    for (uint32_t i = 0; i < ctx->total_chunks; i++) {
+        if (chunk_received(ctx, i)) {
+            ctx->received_chunks++;
+            ctx->received_size += ctx->chunk_size ? chunk_length(ctx, i) : 0;
+        }
+    }
+    if (ctx->chunk_size == 0) {
+        // 尚未收到任何分片
+        ctx->received_chunks = 0;
+        memset(ctx->bitmap, 0, bitmap_len);
+    }
+    ctx->progress = (uint8_t)((ctx->received_size * 100) / ctx->file_size);
+
+    // 上次已收到的连续前缀一次性回读计入SHA-256
+    advance_hash(ctx);
+    printf("FOTA: resuming %s, %u/%u chunks already received\n",
+           ctx->file_path, ctx->received_chunks, ctx->total_chunks);
+    return true;
+}
+
+static void advance_hash(fota_context_t *ctx) {
+    while (ctx->current_chunk < ctx->total_chunks && chunk_received(ctx, ctx->current_chunk)) {
+        size_t len = chunk_length(ctx, ctx->current_chunk);
+        if (!ctx->read_buffer) {
+            ctx->read_buffer = (uint8_t *)malloc(ctx->chunk_size);
+            if (!ctx->read_buffer) {
+                return;
+            }
+        }
+        if (pread(ctx->fd, ctx->read_buffer, len, (off_t)chunk_offset(ctx, ctx->current_chunk)) != (ssize_t)len) {
+            return;
+        }
+        EVP_DigestUpdate((EVP_MD_CTX *)ctx->sha_ctx, ctx->read_buffer, len);
+        if (ctx->data_callback) {
+            ctx->data_callback(ctx, chunk_offset(ctx, ctx->current_chunk), ctx->read_buffer, len, ctx->data_user_data);
+        }
+        ctx->current_chunk++;
+    }
 }
 
+static bool check_chunk_length(fota_context_t *ctx, uint32_t chunk_id, size_t data_len) {
+    if (ctx->chunk_size == 0) {
+        uint32_t chunk_size;
+        if (ctx->total_chunks == 1) {
+            chunk_size = (uint32_t)ctx->file_size;
+        } else if (chunk_id + 1 < ctx->total_chunks) {
+            chunk_size = (uint32_t)data_len;
+        } else {
+            // 先到的是最后一片：其余分片等长，由剩余大小推出
+            uint64_t rest = ctx->file_size - data_len;
+            if (data_len >= ctx->file_size || rest % (ctx->total_chunks - 1) != 0) {
+                return false;
+            }
+            chunk_size = (uint32_t)(rest / (ctx->total_chunks - 1));
+        }
+
+        // 最后一片必须非空且不长于其他分片
+        uint64_t head = (uint64_t)chunk_size * (ctx->total_chunks - 1);
+        if (chunk_size == 0 || head >= ctx->file_size || ctx->file_size - head > chunk_size) {
+            return false;
+        }
+        ctx->chunk_size = chunk_size;
+
+        fota_part_header_t header = {
+            .magic = FOTA_PART_MAGIC,
+            .version = 1,
+            .file_size = ctx->file_size,
+            .total_chunks = ctx->total_chunks,
+            .chunk_size = chunk_size
+        };
+        if (!pwrite_all(ctx->part_fd, &header, sizeof(header), 0)) {
+            fprintf(stderr, "FOTA: failed to record chunk size for %s\n", ctx->file_path);
+        }
+    }
+    return data_len == chunk_length(ctx, chunk_id);
+}
 
+static bool pwrite_all(int fd, const void *data, size_t len, off_t offset) {
+    const uint8_t *p = (const uint8_t *)data;
+    int retry_count = 0;
 
+    while (len > 0) {
+        ssize_t written = pwrite(fd, p, len, offset);
+        if (written > 0) {
+            p += written;
+            len -= (size_t)written;
+            offset += written;
+            continue;
+        }
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        // 设备I/O错误或磁盘空间不足时短暂延迟后重试
+        if (written < 0 && (errno == EIO || errno == ENOSPC) && ++retry_count < FOTA_MAX_RETRY_COUNT) {
+            usleep(100000); // 100ms
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
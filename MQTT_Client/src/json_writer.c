@@ -0,0 +1,236 @@
+#include "json_writer.h"
+#include <string.h>
+
+// ==================== 线程局部缓冲区 ====================
+
+/**
+ * @brief 本线程复用的输出缓冲区与写入器
+ */
+static __thread char t_buffer[JSON_WRITER_THREAD_BUFFER_SIZE];
+static __thread json_writer_t t_writer;
+
+// ==================== 内部函数 ====================
+
+/**
+ * @brief 追加原始字节（保留一个字节给结尾NUL）
+ */
+static void put_raw(json_writer_t *w, const char *s, size_t n) {
+    if (w->overflow) {
+        return;
+    }
+    if (n >= w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+/**
+ * @brief 追加单个字符
+ */
+static void put_char(json_writer_t *w, char c) {
+    if (w->overflow) {
+        return;
+    }
+    if (w->len + 1 >= w->cap) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+/**
+ * @brief 写入一个值或键名之前：同层已有元素时补逗号
+ */
+static void before_item(json_writer_t *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth > 0) {
+        uint32_t bit = 1u << (w->depth - 1);
+        if (w->has_items & bit) {
+            put_char(w, ',');
+        }
+        w->has_items |= bit;
+    }
+}
+
+/**
+ * @brief 进入一层对象或数组
+ */
+static void open_container(json_writer_t *w, char c) {
+    before_item(w);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    put_char(w, c);
+    w->depth++;
+    w->has_items &= ~(1u << (w->depth - 1));
+}
+
+/**
+ * @brief 离开一层对象或数组
+ */
+static void close_container(json_writer_t *w, char c) {
+    if (w->depth <= 0) {
+        w->overflow = true;
+        return;
+    }
+    w->depth--;
+    put_char(w, c);
+}
+
+/**
+ * @brief 写入带引号、已转义的字符串
+ */
+static void put_quoted(json_writer_t *w, const char *s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+    size_t run = 0;     // 尚未写出的无需转义的连续字节
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            run++;
+            continue;
+        }
+        put_raw(w, s + i - run, run);
+        run = 0;
+        char esc[6] = { '\\', 0, 0, 0, 0, 0 };
+        size_t esc_len = 2;
+        switch (c) {
+            case '"':  esc[1] = '"';  break;
+            case '\\': esc[1] = '\\'; break;
+            case '\n': esc[1] = 'n';  break;
+            case '\r': esc[1] = 'r';  break;
+            case '\t': esc[1] = 't';  break;
+            case '\b': esc[1] = 'b';  break;
+            case '\f': esc[1] = 'f';  break;
+            default:
+                esc[1] = 'u';
+                esc[2] = '0';
+                esc[3] = '0';
+                esc[4] = hex[c >> 4];
+                esc[5] = hex[c & 0x0F];
+                esc_len = 6;
+                break;
+        }
+        put_raw(w, esc, esc_len);
+    }
+    put_raw(w, s + n - run, run);
+    put_char(w, '"');
+}
+
+/**
+ * @brief 写入无符号整数的十进制表示
+ */
+static void put_uint(json_writer_t *w, uint64_t v, bool negative) {
+    char digits[21];
+    size_t pos = sizeof(digits);
+    do {
+        digits[--pos] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    if (negative) {
+        digits[--pos] = '-';
+    }
+    put_raw(w, digits + pos, sizeof(digits) - pos);
+}
+
+// ==================== API 函数实现 ====================
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap) {
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->depth = 0;
+    w->has_items = 0;
+    w->after_key = false;
+    w->overflow = (buf == NULL || cap == 0);
+}
+
+json_writer_t *json_writer_thread(void) {
+    json_writer_init(&t_writer, t_buffer, sizeof(t_buffer));
+    return &t_writer;
+}
+
+void json_writer_object_begin(json_writer_t *w) {
+    open_container(w, '{');
+}
+
+void json_writer_object_end(json_writer_t *w) {
+    close_container(w, '}');
+}
+
+void json_writer_array_begin(json_writer_t *w) {
+    open_container(w, '[');
+}
+
+void json_writer_array_end(json_writer_t *w) {
+    close_container(w, ']');
+}
+
+void json_writer_key(json_writer_t *w, const char *key) {
+    before_item(w);
+    put_quoted(w, key, strlen(key));
+    put_char(w, ':');
+    w->after_key = true;
+}
+
+void json_writer_string(json_writer_t *w, const char *s) {
+    json_writer_string_n(w, s ? s : "", s ? strlen(s) : 0);
+}
+
+void json_writer_string_n(json_writer_t *w, const char *s, size_t n) {
+    before_item(w);
+    put_quoted(w, s, n);
+}
+
+void json_writer_int(json_writer_t *w, int64_t v) {
+    before_item(w);
+    // 取反在无符号域进行，INT64_MIN 也不会溢出
+    put_uint(w, v < 0 ? 0 - (uint64_t)v : (uint64_t)v, v < 0);
+}
+
+void json_writer_uint(json_writer_t *w, uint64_t v) {
+    before_item(w);
+    put_uint(w, v, false);
+}
+
+void json_writer_bool(json_writer_t *w, bool v) {
+    before_item(w);
+    if (v) {
+        put_raw(w, "true", 4);
+    } else {
+        put_raw(w, "false", 5);
+    }
+}
+
+void json_writer_add_string(json_writer_t *w, const char *key, const char *s) {
+    json_writer_key(w, key);
+    json_writer_string(w, s);
+}
+
+void json_writer_add_int(json_writer_t *w, const char *key, int64_t v) {
+    json_writer_key(w, key);
+    json_writer_int(w, v);
+}
+
+void json_writer_add_uint(json_writer_t *w, const char *key, uint64_t v) {
+    json_writer_key(w, key);
+    json_writer_uint(w, v);
+}
+
+const char *json_writer_finish(json_writer_t *w, size_t *len) {
+    if (w->overflow || w->depth != 0 || w->after_key) {
+        return NULL;
+    }
+    w->buf[w->len] = '\0';
+    if (len) {
+        *len = w->len;
+    }
+    return w->buf;
+}
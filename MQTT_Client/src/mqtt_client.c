@@ -23,6 +23,8 @@
  */
 
 #include "mqtt_client.h"
+#include "mqtt_dispatch.h"
+#include "pm_metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -97,14 +99,15 @@ static mqtt_log_level_t g_log_level = MQTT_LOG_LEVEL_INFO;
     } while (0)
 
 /**
- * @brief 消息订阅信息结构体
+ * @brief 等待完成的异步发布
  */
-typedef struct subscription_info {
-    char *topic;                        /**< 订阅的主题 */
-    mqtt_message_callback_t callback;   /**< 消息回调函数 */
-    void *user_data;                    /**< 回调函数用户数据 */
-    struct subscription_info *next;     /**< 指向下一个订阅信息的指针 */
-} subscription_info_t;
+typedef struct pending_publish {
+    int mid;                            /**< 消息ID */
+    mqtt_publish_callback_t callback;   /**< 完成回调 */
+    void *user_data;                    /**< 回调用户数据 */
+    uint64_t start_us;                  /**< 提交时间，用于统计发布延迟 */
+    struct pending_publish *next;       /**< 指向下一个等待项的指针 */
+} pending_publish_t;
 
 /**
  * @brief MQTT客户端实现结构体
@@ -115,13 +118,36 @@ struct mqtt_client_impl {
     mqtt_client_state_t state;         /**< 当前状态 */
     mqtt_state_callback_t state_cb;    /**< 状态变化回调 */
     void *state_cb_user_data;          /**< 状态变化回调用户数据 */
-    subscription_info_t *subscriptions;/**< 订阅信息列表 */
+    mqtt_dispatch_t *dispatch;         /**< 订阅前缀树与消息回调线程，自带同步，不受mutex保护 */
     pthread_mutex_t mutex;             /**< 互斥锁，用于线程安全 */
     int retry_count;                  /**< 当前重连次数 */
     bool auto_reconnect;              /**< 是否自动重连 */
     time_t last_status_print;         /**< 上次打印状态的时间 */
+    pending_publish_t *pending;       /**< 等待完成的异步发布列表 */
+    pthread_mutex_t pending_mutex;    /**< 保护pending，独立于mutex，回调线程只持有此锁 */
 };
 
+/**
+ * @brief 取出所有等待项并以result回调
+ * @details 断开连接时调用，未收到PUBACK的消息由调用方决定是否重发
+ */
+static void fail_pending_publishes(mqtt_client_t client, int result)
+{
+    pthread_mutex_lock(&client->pending_mutex);
+    pending_publish_t *list = client->pending;
+    client->pending = NULL;
+    pthread_mutex_unlock(&client->pending_mutex);
+
+    while (list != NULL) {
+        pending_publish_t *next = list->next;
+        if (list->callback) {
+            list->callback(list->mid, result, list->user_data);
+        }
+        platform_free(list);
+        list = next;
+    }
+}
+
 /**
  * @brief 静态回调函数：连接状态变化
  */
@@ -194,12 +220,52 @@ static void on_disconnect_callback(struct mosquitto *mosq, void *obj, int reason
     
     pthread_mutex_unlock(&client->mutex);
     
+    fail_pending_publishes(client, MQTT_ERR_DISCONNECTED);
+    
     // 调用用户注册的状态回调（在锁外调用，避免死锁）
     if (state_cb) {
         state_cb(current_state, state_cb_user_data);
     }
 }
 
+/**
+ * @brief 静态回调函数：发布完成（QoS1收到PUBACK，QoS0已写出）
+ */
+static void on_publish_callback(struct mosquitto *mosq, void *obj, int mid)
+{
+    (void)mosq;
+    mqtt_client_t client = (mqtt_client_t)obj;
+    if (client == NULL) {
+        return;
+    }
+
+    // 只在查找时持锁，回调在锁外执行
+    pthread_mutex_lock(&client->pending_mutex);
+    pending_publish_t *item = client->pending;
+    pending_publish_t *prev = NULL;
+    while (item != NULL && item->mid != mid) {
+        prev = item;
+        item = item->next;
+    }
+    if (item != NULL) {
+        if (prev == NULL) {
+            client->pending = item->next;
+        } else {
+            prev->next = item->next;
+        }
+    }
+    pthread_mutex_unlock(&client->pending_mutex);
+
+    // 同步发布的消息不在列表中
+    if (item != NULL) {
+        pm_metrics_observe(PM_HIST_MQTT_PUBLISH, pm_metrics_now_us() - item->start_us);
+        if (item->callback) {
+            item->callback(mid, MQTT_ERR_SUCCESS, item->user_data);
+        }
+        platform_free(item);
+    }
+}
+
 /**
  * @brief 静态回调函数：消息接收
  */
@@ -214,22 +280,8 @@ static void on_message_callback(struct mosquitto *mosq, void *obj, const struct
     MQTT_LOG(MQTT_LOG_LEVEL_DEBUG, "Received message on topic %s: %.*s", 
            message->topic, (int)message->payloadlen, (char*)message->payload);
     
-    // 遍历订阅列表，找到匹配的主题并调用对应的回调函数
-    pthread_mutex_lock(&client->mutex);
-    
-    subscription_info_t *sub = client->subscriptions;
-    while (sub != NULL) {
-        // 检查主题是否匹配
-        if (mosquitto_topic_matches_sub(sub->topic, message->topic, false)) {
-            // 调用用户注册的消息回调函数
-            if (sub->callback != NULL) {
-                sub->callback(message->topic, message->payload, message->payloadlen, sub->user_data);
-            }
-        }
-        sub = sub->next;
-    }
-    
-    pthread_mutex_unlock(&client->mutex);
+    // 在订阅快照上匹配，不持有client->mutex，回调中可以订阅、发布或取消订阅
+    mqtt_dispatch_message(client->dispatch, message->topic, message->payload, (size_t)message->payloadlen);
 }
 
 /**
@@ -301,9 +353,17 @@ mqtt_client_t mqtt_client_create(const mqtt_client_config_t *config)
     
     // 初始化互斥锁，用于线程安全操作
     pthread_mutex_init(&client->mutex, NULL);
-    
-    // 初始化订阅列表为空
-    client->subscriptions = NULL;
+    pthread_mutex_init(&client->pending_mutex, NULL);
+    
+    // 创建订阅分发器（dispatch_workers为0时在事件循环线程中直接回调）
+    client->dispatch = mqtt_dispatch_create(client->config.dispatch_workers);
+    if (client->dispatch == NULL) {
+        MQTT_LOG(MQTT_LOG_LEVEL_ERROR, "Failed to create message dispatcher (workers: %d)", client->config.dispatch_workers);
+        pthread_mutex_destroy(&client->pending_mutex);
+        pthread_mutex_destroy(&client->mutex);
+        platform_free(client);
+        return NULL;
+    }
     
     // 设置默认值（如果配置中未指定）
     if (client->config.keep_alive == 0) {
@@ -326,6 +386,7 @@ mqtt_client_t mqtt_client_create(const mqtt_client_config_t *config)
     client->mosq = mosquitto_new(config->client_id, config->clean_session, client);
     if (client->mosq == NULL) {
         MQTT_LOG(MQTT_LOG_LEVEL_ERROR, "Failed to create mosquitto client");
+        mqtt_dispatch_destroy(client->dispatch);
         platform_free(client);
         return NULL;
     }
@@ -334,6 +395,7 @@ mqtt_client_t mqtt_client_create(const mqtt_client_config_t *config)
     mosquitto_connect_callback_set(client->mosq, on_connect_callback);       // 连接回调
     mosquitto_disconnect_callback_set(client->mosq, on_disconnect_callback); // 断开连接回调
     mosquitto_message_callback_set(client->mosq, on_message_callback);       // 消息接收回调
+    mosquitto_publish_callback_set(client->mosq, on_publish_callback);       // 发布完成回调
     
     // 设置用户名和密码（如果配置了）
     if (config->username != NULL && config->password != NULL) {
@@ -341,6 +403,7 @@ mqtt_client_t mqtt_client_create(const mqtt_client_config_t *config)
         if (rc != MOSQ_ERR_SUCCESS) {
             MQTT_LOG(MQTT_LOG_LEVEL_ERROR, "Failed to set username/password: %s", mosquitto_strerror(rc));
             mosquitto_destroy(client->mosq);
+            mqtt_dispatch_destroy(client->dispatch);
             platform_free(client);
             return NULL;
         }
@@ -398,21 +461,15 @@ void mqtt_client_destroy(mqtt_client_t client)
         client->mosq = NULL;
     }
     
-    // 释放订阅列表
-    pthread_mutex_lock(&client->mutex);
-    subscription_info_t *sub = client->subscriptions;
-    while (sub != NULL) {
-        subscription_info_t *next = sub->next;
-        if (sub->topic != NULL) {
-            platform_free(sub->topic);
-        }
-        platform_free(sub);
-        sub = next;
-    }
-    client->subscriptions = NULL;
-    pthread_mutex_unlock(&client->mutex);
+    // 事件循环已停止，释放订阅并停止回调线程
+    mqtt_dispatch_destroy(client->dispatch);
+    client->dispatch = NULL;
+    
+    // 释放未完成的异步发布
+    fail_pending_publishes(client, MQTT_ERR_DISCONNECTED);
     
     // 销毁互斥锁
+    pthread_mutex_destroy(&client->pending_mutex);
     pthread_mutex_destroy(&client->mutex);
     
     // 释放内存
@@ -657,9 +714,76 @@ int mqtt_client_publish(mqtt_client_t client, const mqtt_message_t *message)
     
     if (rc != MOSQ_ERR_SUCCESS) {
         MQTT_LOG(MQTT_LOG_LEVEL_ERROR, "Publish failed: %s", mosquitto_strerror(rc));
+        pm_metrics_add(PM_CNT_MQTT_PUBLISH_ERRORS, 1);
+        return MQTT_ERR_PUBLISH_FAILED;
+    }
+    
+    pm_metrics_add(PM_CNT_MQTT_PUBLISHED, 1);
+    return MQTT_ERR_SUCCESS;
+}
+
+/**
+ * @brief 异步发布MQTT消息
+ * 
+ * 与mqtt_client_publish相同，但返回消息ID，并在消息完成时调用on_complete：
+ * QoS1在收到PUBACK时，QoS0在写入套接字时。连接断开时所有未完成消息以
+ * MQTT_ERR_DISCONNECTED回调，调用方可据此只重发未确认的消息。
+ * 
+ * @param client MQTT客户端句柄
+ * @param message MQTT消息结构体
+ * @param on_complete 完成回调，在事件循环线程中调用
+ * @param user_data 回调用户数据
+ * @param mid 输出参数，消息ID
+ * @return 成功返回MQTT_ERR_SUCCESS(0)，失败返回错误码
+ * 
+ * @note 等待项在pending_mutex下与mosquitto_publish一起登记，PUBACK即使先于
+ *       mosquitto_publish返回到达，回调线程也会等到登记完成后再查找。
+ */
+int mqtt_client_publish_async(mqtt_client_t client, const mqtt_message_t *message,
+                              mqtt_publish_callback_t on_complete, void *user_data, int *mid)
+{
+    if (client == NULL || message == NULL || message->topic == NULL) {
+        return MQTT_ERR_INVALID_PARAM;
+    }
+    
+    pthread_mutex_lock(&client->mutex);
+    if (client->state != MQTT_CLIENT_STATE_CONNECTED) {
+        pthread_mutex_unlock(&client->mutex);
+        return MQTT_ERR_DISCONNECTED;
+    }
+    pthread_mutex_unlock(&client->mutex);
+    
+    pending_publish_t *item = (pending_publish_t *)platform_malloc(sizeof(pending_publish_t));
+    if (item == NULL) {
+        return MQTT_ERR_NO_MEMORY;
+    }
+    item->callback = on_complete;
+    item->user_data = user_data;
+    item->start_us = pm_metrics_now_us();
+    
+    // 登记后立即取出mid：解锁之后回调线程可能随时释放item
+    pthread_mutex_lock(&client->pending_mutex);
+    int rc = mosquitto_publish(client->mosq, &item->mid, message->topic, 
+                              message->payload_len, message->payload, 
+                              message->qos, message->retain);
+    int item_mid = item->mid;
+    if (rc == MOSQ_ERR_SUCCESS) {
+        item->next = client->pending;
+        client->pending = item;
+    }
+    pthread_mutex_unlock(&client->pending_mutex);
+    
+    if (rc != MOSQ_ERR_SUCCESS) {
+        MQTT_LOG(MQTT_LOG_LEVEL_ERROR, "Publish failed: %s", mosquitto_strerror(rc));
+        platform_free(item);
+        pm_metrics_add(PM_CNT_MQTT_PUBLISH_ERRORS, 1);
         return MQTT_ERR_PUBLISH_FAILED;
     }
     
+    pm_metrics_add(PM_CNT_MQTT_PUBLISHED, 1);
+    if (mid != NULL) {
+        *mid = item_mid;
+    }
     return MQTT_ERR_SUCCESS;
 }
 
@@ -682,8 +806,8 @@ int mqtt_client_publish(mqtt_client_t client, const mqtt_message_t *message)
  * 
  * @note 订阅流程：
  * 1. 检查参数和连接状态
- * 2. 创建订阅信息结构体
- * 3. 将订阅信息添加到列表
+ * 2. 将订阅加入订阅前缀树（重复订阅不产生重复回调）
+ * 3. 订阅快照替换后立即对新消息生效
  * 4. 调用mosquitto_subscribe发送订阅请求
  * 5. 处理订阅结果
  * 
@@ -710,39 +834,14 @@ int mqtt_client_subscribe(mqtt_client_t client, const char *topic, mqtt_qos_t qo
         return MQTT_ERR_DISCONNECTED;
     }
     
-    // 创建新的订阅信息结构体
-    subscription_info_t *new_sub = (subscription_info_t *)platform_malloc(sizeof(subscription_info_t));
-    if (new_sub == NULL) {
-        pthread_mutex_unlock(&client->mutex);
-        return MQTT_ERR_NO_MEMORY;
-    }
+    pthread_mutex_unlock(&client->mutex);
     
-    // 复制主题字符串
-    new_sub->topic = platform_strdup(topic);
-    if (new_sub->topic == NULL) {
-        platform_free(new_sub);
-        pthread_mutex_unlock(&client->mutex);
+    // 加入订阅前缀树；相同(topic, callback, user_data)已存在时不重复添加
+    int added = mqtt_dispatch_add(client->dispatch, topic, callback, user_data);
+    if (added < 0) {
         return MQTT_ERR_NO_MEMORY;
     }
     
-    // 设置回调函数和用户数据
-    new_sub->callback = callback;
-    new_sub->user_data = user_data;
-    new_sub->next = NULL;
-    
-    // 将新的订阅信息添加到列表末尾
-    if (client->subscriptions == NULL) {
-        client->subscriptions = new_sub;
-    } else {
-        subscription_info_t *sub = client->subscriptions;
-        while (sub->next != NULL) {
-            sub = sub->next;
-        }
-        sub->next = new_sub;
-    }
-    
-    pthread_mutex_unlock(&client->mutex);
-    
     // 订阅主题
     // 参数说明：
     // 1. mosq: mosquitto客户端句柄
@@ -753,25 +852,10 @@ int mqtt_client_subscribe(mqtt_client_t client, const char *topic, mqtt_qos_t qo
     if (rc != MOSQ_ERR_SUCCESS) {
         MQTT_LOG(MQTT_LOG_LEVEL_ERROR, "Subscribe failed: %s", mosquitto_strerror(rc));
         
-        // 订阅失败，从列表中移除该订阅信息
-        pthread_mutex_lock(&client->mutex);
-        subscription_info_t *sub = client->subscriptions;
-        subscription_info_t *prev = NULL;
-        while (sub != NULL) {
-            if (strcmp(sub->topic, topic) == 0) {
-                if (prev == NULL) {
-                    client->subscriptions = sub->next;
-                } else {
-                    prev->next = sub->next;
-                }
-                platform_free(sub->topic);
-                platform_free(sub);
-                break;
-            }
-            prev = sub;
-            sub = sub->next;
+        // 订阅失败，撤销本次新增的订阅
+        if (added > 0) {
+            mqtt_dispatch_remove_one(client->dispatch, topic, callback, user_data);
         }
-        pthread_mutex_unlock(&client->mutex);
         
         return MQTT_ERR_SUBSCRIBE_FAILED;
     }
@@ -801,27 +885,8 @@ int mqtt_client_unsubscribe(mqtt_client_t client, const char *topic)
         return MQTT_ERR_UNSUBSCRIBE_FAILED;
     }
     
-    // 从订阅列表中移除该主题的订阅信息
-    pthread_mutex_lock(&client->mutex);
-    
-    subscription_info_t *sub = client->subscriptions;
-    subscription_info_t *prev = NULL;
-    while (sub != NULL) {
-        if (strcmp(sub->topic, topic) == 0) {
-            if (prev == NULL) {
-                client->subscriptions = sub->next;
-            } else {
-                prev->next = sub->next;
-            }
-            platform_free(sub->topic);
-            platform_free(sub);
-            break;
-        }
-        prev = sub;
-        sub = sub->next;
-    }
-    
-    pthread_mutex_unlock(&client->mutex);
+    // 移除该主题过滤器上的全部订阅
+    mqtt_dispatch_remove(client->dispatch, topic);
     
     return MQTT_ERR_SUCCESS;
 }
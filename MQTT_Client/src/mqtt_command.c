@@ -0,0 +1,441 @@
+#include "mqtt_command.h"
+#include <string.h>
+#include <strings.h>
+
+// ==================== 常量定义 ====================
+
+/**
+ * @brief 跳过未知字段时允许的最大嵌套层数
+ */
+#define MQTT_COMMAND_MAX_DEPTH 16
+
+// ==================== 内部类型 ====================
+
+/**
+ * @brief 扫描位置
+ */
+typedef struct {
+    const char *p;              // 当前位置
+    const char *end;            // 负载末尾
+} cursor_t;
+
+// ==================== 内部函数 ====================
+
+static bool skip_value(cursor_t *c, int depth);
+
+static void skip_ws(cursor_t *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r')) {
+        c->p++;
+    }
+}
+
+static bool peek(const cursor_t *c, char ch) {
+    return c->p < c->end && *c->p == ch;
+}
+
+static bool key_is(const mqtt_command_str_t *key, const char *name) {
+    size_t n = strlen(name);
+    return key->len == n && memcmp(key->ptr, name, n) == 0;
+}
+
+/**
+ * @brief 扫描字符串，c->p 指向开头的引号；转义序列原样保留
+ */
+static bool scan_string(cursor_t *c, mqtt_command_str_t *out) {
+    if (!peek(c, '"')) {
+        return false;
+    }
+    const char *start = ++c->p;
+    while (c->p < c->end) {
+        char ch = *c->p;
+        if (ch == '"') {
+            out->ptr = start;
+            out->len = (size_t)(c->p - start);
+            c->p++;
+            return true;
+        }
+        if (ch == '\\') {
+            c->p++;
+        }
+        c->p++;
+    }
+    return false;
+}
+
+/**
+ * @brief 匹配字面量 true/false/null
+ */
+static bool scan_literal(cursor_t *c, const char *word) {
+    size_t n = strlen(word);
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, word, n) != 0) {
+        return false;
+    }
+    c->p += n;
+    return true;
+}
+
+/**
+ * @brief 扫描数字，整数部分写入 out（饱和到 int64 范围），小数和指数部分跳过
+ */
+static bool scan_number(cursor_t *c, int64_t *out) {
+    bool negative = false;
+    if (peek(c, '-')) {
+        negative = true;
+        c->p++;
+    }
+    if (c->p >= c->end || *c->p < '0' || *c->p > '9') {
+        return false;
+    }
+    uint64_t v = 0;
+    while (c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+        uint64_t digit = (uint64_t)(*c->p - '0');
+        v = v > (UINT64_MAX - digit) / 10 ? UINT64_MAX : v * 10 + digit;
+        c->p++;
+    }
+    while (c->p < c->end && (*c->p == '.' || *c->p == 'e' || *c->p == 'E' ||
+                             *c->p == '+' || *c->p == '-' || (*c->p >= '0' && *c->p <= '9'))) {
+        c->p++;
+    }
+    if (negative) {
+        *out = v > (uint64_t)INT64_MAX ? INT64_MIN : -(int64_t)v;
+    } else {
+        *out = v > (uint64_t)INT64_MAX ? INT64_MAX : (int64_t)v;
+    }
+    return true;
+}
+
+/**
+ * @brief 读取整数字段：数字、布尔或数字字符串；其他类型跳过并返回 false
+ */
+static bool scan_int_value(cursor_t *c, int64_t *out, bool *ok) {
+    *ok = false;
+    if (c->p >= c->end) {
+        return false;
+    }
+    char ch = *c->p;
+    if (ch == '-' || (ch >= '0' && ch <= '9')) {
+        *ok = scan_number(c, out);
+        return *ok;
+    }
+    if (ch == 't' || ch == 'f') {
+        *ok = scan_literal(c, ch == 't' ? "true" : "false");
+        *out = (ch == 't');
+        return *ok;
+    }
+    if (ch == '"') {
+        mqtt_command_str_t s;
+        if (!scan_string(c, &s)) {
+            return false;
+        }
+        cursor_t inner = { s.ptr, s.ptr + s.len };
+        *ok = scan_number(&inner, out) && inner.p == inner.end;
+        return true;
+    }
+    return skip_value(c, 0);
+}
+
+/**
+ * @brief 读取对象的下一个键，c->p 停在值的开头
+ * @return 1 读到键，0 对象结束，-1 格式错误
+ */
+static int object_next(cursor_t *c, bool *first, mqtt_command_str_t *key) {
+    skip_ws(c);
+    if (peek(c, '}')) {
+        c->p++;
+        return 0;
+    }
+    if (!*first) {
+        if (!peek(c, ',')) {
+            return -1;
+        }
+        c->p++;
+        skip_ws(c);
+    }
+    *first = false;
+    if (!scan_string(c, key)) {
+        return -1;
+    }
+    skip_ws(c);
+    if (!peek(c, ':')) {
+        return -1;
+    }
+    c->p++;
+    skip_ws(c);
+    return 1;
+}
+
+static bool skip_value(cursor_t *c, int depth) {
+    if (depth > MQTT_COMMAND_MAX_DEPTH || c->p >= c->end) {
+        return false;
+    }
+    mqtt_command_str_t s;
+    int64_t n;
+    switch (*c->p) {
+        case '"':
+            return scan_string(c, &s);
+        case 't':
+            return scan_literal(c, "true");
+        case 'f':
+            return scan_literal(c, "false");
+        case 'n':
+            return scan_literal(c, "null");
+        case '{': {
+            c->p++;
+            bool first = true;
+            int r;
+            while ((r = object_next(c, &first, &s)) == 1) {
+                if (!skip_value(c, depth + 1)) {
+                    return false;
+                }
+            }
+            return r == 0;
+        }
+        case '[': {
+            c->p++;
+            skip_ws(c);
+            if (peek(c, ']')) {
+                c->p++;
+                return true;
+            }
+            for (;;) {
+                skip_ws(c);
+                if (!skip_value(c, depth + 1)) {
+                    return false;
+                }
+                skip_ws(c);
+                if (peek(c, ']')) {
+                    c->p++;
+                    return true;
+                }
+                if (!peek(c, ',')) {
+                    return false;
+                }
+                c->p++;
+            }
+        }
+        default:
+            return scan_number(c, &n);
+    }
+}
+
+/**
+ * @brief 解析命令对象的成员（content 或其 data 对象）
+ */
+static bool parse_member(cursor_t *c, const mqtt_command_str_t *key, mqtt_command_t *cmd, int depth) {
+    int64_t n;
+    bool ok;
+
+    if (key_is(key, "action")) {
+        if (peek(c, '"')) {
+            if (!scan_string(c, &cmd->action_name)) {
+                return false;
+            }
+            cmd->has_action = true;
+            cmd->action_is_number = false;
+            return true;
+        }
+        if (!scan_int_value(c, &n, &ok)) {
+            return false;
+        }
+        if (ok) {
+            cmd->has_action = true;
+            cmd->action_is_number = true;
+            cmd->action = (int)n;
+        }
+        return true;
+    }
+    if (key_is(key, "status") || key_is(key, "value")) {
+        bool is_status = key_is(key, "status");
+        if (!scan_int_value(c, &n, &ok)) {
+            return false;
+        }
+        if (is_status) {
+            // 状态查询命令的 status 可以是任意类型，只记录字段存在
+            cmd->has_status = true;
+            cmd->status = ok ? (int)n : 0;
+        } else if (ok) {
+            cmd->has_value = true;
+            cmd->value = (int)n;
+        }
+        return true;
+    }
+    if (key_is(key, "file_size") || key_is(key, "total_chunks")) {
+        bool is_size = key_is(key, "file_size");
+        if (!scan_int_value(c, &n, &ok)) {
+            return false;
+        }
+        if (ok && n >= 0) {
+            if (is_size) {
+                cmd->has_file_size = true;
+                cmd->file_size = (uint64_t)n;
+            } else if (n <= UINT32_MAX) {
+                cmd->has_total_chunks = true;
+                cmd->total_chunks = (uint32_t)n;
+            }
+        }
+        return true;
+    }
+    if ((key_is(key, "file_name") || key_is(key, "checksum")) && peek(c, '"')) {
+        return scan_string(c, key_is(key, "file_name") ? &cmd->file_name : &cmd->checksum);
+    }
+    if (key_is(key, "data") && peek(c, '{') && depth < MQTT_COMMAND_MAX_DEPTH) {
+        c->p++;
+        bool first = true;
+        mqtt_command_str_t sub;
+        int r;
+        while ((r = object_next(c, &first, &sub)) == 1) {
+            if (!parse_member(c, &sub, cmd, depth + 1)) {
+                return false;
+            }
+        }
+        return r == 0;
+    }
+    return skip_value(c, depth);
+}
+
+/**
+ * @brief 解析一个命令对象，c->p 指向 '{'
+ */
+static bool parse_command_object(cursor_t *c, mqtt_command_t *cmd) {
+    c->p++;
+    bool first = true;
+    mqtt_command_str_t key;
+    int r;
+    while ((r = object_next(c, &first, &key)) == 1) {
+        if (!parse_member(c, &key, cmd, 1)) {
+            return false;
+        }
+    }
+    return r == 0;
+}
+
+// ==================== API 函数实现 ====================
+
+int mqtt_command_parse(const void *payload, size_t len, mqtt_command_t *cmd) {
+    if (!payload || !cmd) {
+        return -1;
+    }
+    memset(cmd, 0, sizeof(*cmd));
+
+    cursor_t c = { (const char *)payload, (const char *)payload + len };
+    skip_ws(&c);
+    if (!peek(&c, '{')) {
+        return -1;
+    }
+
+    // 顶层字段先按命令字段解析，出现 content 时改用 content 中的字段
+    mqtt_command_t top;
+    memset(&top, 0, sizeof(top));
+    const char *object_start = c.p;
+    bool has_content = false;
+
+    c.p++;
+    bool first = true;
+    mqtt_command_str_t key;
+    int r;
+    while ((r = object_next(&c, &first, &key)) == 1) {
+        if (key_is(&key, "command_id")) {
+            int64_t n;
+            bool ok;
+            if (!scan_int_value(&c, &n, &ok)) {
+                return -1;
+            }
+            top.has_command_id = ok;
+            top.command_id = n;
+        } else if (key_is(&key, "content") && peek(&c, '{')) {
+            const char *content_start = c.p;
+            memset(cmd, 0, sizeof(*cmd));
+            if (!parse_command_object(&c, cmd)) {
+                return -1;
+            }
+            cmd->content = content_start;
+            cmd->content_len = (size_t)(c.p - content_start);
+            has_content = true;
+        } else if (!parse_member(&c, &key, &top, 1)) {
+            return -1;
+        }
+    }
+    if (r != 0) {
+        return -1;
+    }
+
+    if (!has_content) {
+        *cmd = top;
+        cmd->content = object_start;
+        cmd->content_len = (size_t)(c.p - object_start);
+    }
+    cmd->has_command_id = top.has_command_id;
+    cmd->command_id = top.command_id;
+    return 0;
+}
+
+bool mqtt_command_copy_string(const mqtt_command_str_t *s, char *buf, size_t size) {
+    if (!s || !s->ptr || !buf || size == 0) {
+        return false;
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < s->len; i++) {
+        unsigned char ch = (unsigned char)s->ptr[i];
+        char tmp[3];
+        size_t n = 1;
+        tmp[0] = (char)ch;
+        if (ch == '\\' && i + 1 < s->len) {
+            char e = s->ptr[++i];
+            switch (e) {
+                case 'n': tmp[0] = '\n'; break;
+                case 'r': tmp[0] = '\r'; break;
+                case 't': tmp[0] = '\t'; break;
+                case 'b': tmp[0] = '\b'; break;
+                case 'f': tmp[0] = '\f'; break;
+                case 'u': {
+                    // 只处理基本多文种平面，代理对换成 '?'
+                    unsigned int cp = 0;
+                    size_t k;
+                    for (k = 0; k < 4 && i + 1 < s->len; k++) {
+                        char h = s->ptr[++i];
+                        cp <<= 4;
+                        if (h >= '0' && h <= '9') cp |= (unsigned int)(h - '0');
+                        else if (h >= 'a' && h <= 'f') cp |= (unsigned int)(h - 'a' + 10);
+                        else if (h >= 'A' && h <= 'F') cp |= (unsigned int)(h - 'A' + 10);
+                        else return false;
+                    }
+                    if (k != 4 || cp == 0) {
+                        return false;
+                    }
+                    if (cp < 0x80) {
+                        tmp[0] = (char)cp;
+                    } else if (cp < 0x800) {
+                        tmp[0] = (char)(0xC0 | (cp >> 6));
+                        tmp[1] = (char)(0x80 | (cp & 0x3F));
+                        n = 2;
+                    } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                        tmp[0] = '?';
+                    } else {
+                        tmp[0] = (char)(0xE0 | (cp >> 12));
+                        tmp[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                        tmp[2] = (char)(0x80 | (cp & 0x3F));
+                        n = 3;
+                    }
+                    break;
+                }
+                default: tmp[0] = e; break;     // \" \\ \/
+            }
+        }
+        if (out + n >= size) {
+            return false;
+        }
+        memcpy(buf + out, tmp, n);
+        out += n;
+    }
+    buf[out] = '\0';
+    return true;
+}
+
+bool mqtt_command_str_equals(const mqtt_command_str_t *s, const char *text) {
+    if (!s || !s->ptr || !text) {
+        return false;
+    }
+    size_t n = strlen(text);
+    return s->len == n && strncasecmp(s->ptr, text, n) == 0;
+}
@@ -0,0 +1,689 @@
+/**
+ * @file mqtt_dispatch.c
+ * @brief MQTT订阅分发器实现
+ * 
+ * 把收到的消息按主题过滤器分发给订阅回调，供 mqtt_client.c 的消息回调使用。
+ * 
+ * 主要功能包括：
+ * - 订阅的添加与删除（支持 "+"、"#" 通配符）
+ * - 按主题层级前缀树匹配消息
+ * - 可选的回调线程，按主题哈希分配，保证同一主题的回调顺序
+ * 
+ * 设计架构：
+ * - 写路径：订阅变更在写锁下重建整棵前缀树，以指针替换发布新快照
+ * - 读路径：分发只读快照、不加锁，读者按分代计数，旧快照在读者离开后释放
+ * - 回调在读区之外执行，回调中可以订阅或取消订阅
+ */
+
+#include "mqtt_dispatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+// ==================== 内部类型 ====================
+
+/**
+ * @brief 订阅回调目标
+ */
+typedef struct {
+    mqtt_message_callback_t callback;
+    void *user_data;
+} dispatch_target_t;
+
+/**
+ * @brief 订阅（可变列表，仅在写锁下访问）
+ */
+typedef struct {
+    char *filter;
+    dispatch_target_t target;
+} dispatch_sub_t;
+
+/**
+ * @brief 前缀树节点，发布后只读
+ */
+typedef struct trie_node {
+    char *level;                        // 本层字面值，根节点和通配节点为NULL
+    size_t level_len;
+    struct trie_node **children;        // 字面值子节点
+    size_t child_count;
+    struct trie_node *plus;             // "+" 子节点
+    struct trie_node *hash;             // "#" 子节点
+    dispatch_target_t *targets;         // 在本节点结束的订阅
+    size_t target_count;
+} trie_node_t;
+
+/**
+ * @brief 回调线程中的一条消息，主题、负载与匹配结果在同一块内存中
+ */
+typedef struct dispatch_item {
+    struct dispatch_item *next;
+    const char *topic;
+    const void *payload;
+    size_t payload_len;
+    size_t target_count;
+    dispatch_target_t targets[];
+} dispatch_item_t;
+
+/**
+ * @brief 回调线程及其消息队列
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    dispatch_item_t *head;
+    dispatch_item_t *tail;
+    size_t count;
+    bool stop;
+} dispatch_worker_t;
+
+/**
+ * @brief 订阅分发器
+ */
+struct mqtt_dispatch {
+    pthread_mutex_t write_mutex;        // 串行化订阅变更
+    dispatch_sub_t *subs;
+    size_t sub_count;
+    size_t sub_capacity;
+
+    trie_node_t *root;                  // 当前快照，原子读写
+    unsigned epoch;                     // 读者计数分代
+    unsigned readers[2];
+
+    dispatch_worker_t *workers;
+    int worker_count;
+};
+
+// ==================== 前缀树 ====================
+
+/**
+ * @brief 递归释放前缀树
+ * @param node 子树根节点，可为NULL
+ */
+static void trie_free(trie_node_t *node) {
+    if (node == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < node->child_count; i++) {
+        trie_free(node->children[i]);
+    }
+    trie_free(node->plus);
+    trie_free(node->hash);
+    free(node->children);
+    free(node->targets);
+    free(node->level);
+    free(node);
+}
+
+/**
+ * @brief 查找或创建一层子节点
+ * @param node 父节点
+ * @param level 本层字面值起点（不以 '\0' 结尾）
+ * @param len 本层长度
+ * @return 子节点，内存不足返回NULL
+ */
+static trie_node_t *trie_child(trie_node_t *node, const char *level, size_t len) {
+    if (len == 1 && level[0] == '+') {
+        if (node->plus == NULL) {
+            node->plus = (trie_node_t *)calloc(1, sizeof(trie_node_t));
+        }
+        return node->plus;
+    }
+    if (len == 1 && level[0] == '#') {
+        if (node->hash == NULL) {
+            node->hash = (trie_node_t *)calloc(1, sizeof(trie_node_t));
+        }
+        return node->hash;
+    }
+
+    for (size_t i = 0; i < node->child_count; i++) {
+        trie_node_t *child = node->children[i];
+        if (child->level_len == len && memcmp(child->level, level, len) == 0) {
+            return child;
+        }
+    }
+
+    trie_node_t **children = (trie_node_t **)realloc(node->children, (node->child_count + 1) * sizeof(trie_node_t *));
+    if (children == NULL) {
+        return NULL;
+    }
+    node->children = children;
+    trie_node_t *child = (trie_node_t *)calloc(1, sizeof(trie_node_t));
+    if (child == NULL) {
+        return NULL;
+    }
+    child->level = (char *)malloc(len + 1);
+    if (child->level == NULL) {
+        free(child);
+        return NULL;
+    }
+    memcpy(child->level, level, len);
+    child->level[len] = '\0';
+    child->level_len = len;
+    node->children[node->child_count++] = child;
+    return child;
+}
+
+/**
+ * @brief 把一个订阅插入前缀树
+ * @param root 根节点
+ * @param sub 订阅
+ * @return 成功返回true，内存不足返回false
+ */
+static bool trie_insert(trie_node_t *root, const dispatch_sub_t *sub) {
+    trie_node_t *node = root;
+    const char *level = sub->filter;
+    while (node != NULL) {
+        const char *end = strchr(level, '/');
+        size_t len = end ? (size_t)(end - level) : strlen(level);
+        node = trie_child(node, level, len);
+        if (end == NULL) {
+            break;
+        }
+        level = end + 1;
+    }
+    if (node == NULL) {
+        return false;
+    }
+
+    dispatch_target_t *targets = (dispatch_target_t *)realloc(node->targets, (node->target_count + 1) * sizeof(dispatch_target_t));
+    if (targets == NULL) {
+        return false;
+    }
+    node->targets = targets;
+    node->targets[node->target_count++] = sub->target;
+    return true;
+}
+
+/**
+ * @brief 按订阅列表构建新的前缀树
+ * @param subs 订阅数组
+ * @param count 订阅数量
+ * @return 根节点，内存不足返回NULL
+ */
+static trie_node_t *trie_build(const dispatch_sub_t *subs, size_t count) {
+    trie_node_t *root = (trie_node_t *)calloc(1, sizeof(trie_node_t));
+    if (root == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!trie_insert(root, &subs[i])) {
+            trie_free(root);
+            return NULL;
+        }
+    }
+    return root;
+}
+
+/**
+ * @brief 收集在节点结束的订阅
+ * @param node 节点
+ * @param out 输出数组
+ * @param count 已匹配数，超过 max 的部分只计数不写入
+ * @param max 输出数组容量
+ */
+static void collect_targets(const trie_node_t *node, dispatch_target_t *out, size_t *count, size_t max) {
+    for (size_t i = 0; i < node->target_count; i++) {
+        if (*count < max) {
+            out[*count] = node->targets[i];
+        }
+        (*count)++;
+    }
+}
+
+/**
+ * @brief 匹配一层
+ * @param node 当前节点
+ * @param level 当前层在主题中的起点，NULL表示主题已结束
+ * @param first 是否为第一层："$" 开头的主题不匹配首层通配符
+ * @param out 输出数组
+ * @param count 已匹配数
+ * @param max 输出数组容量
+ */
+static void trie_match(const trie_node_t *node, const char *level, bool first,
+                       dispatch_target_t *out, size_t *count, size_t max) {
+    if (level == NULL) {
+        collect_targets(node, out, count, max);
+        // "a/#" 同时匹配 "a"
+        if (node->hash != NULL) {
+            collect_targets(node->hash, out, count, max);
+        }
+        return;
+    }
+
+    const char *end = strchr(level, '/');
+    size_t len = end ? (size_t)(end - level) : strlen(level);
+    const char *next = end ? end + 1 : NULL;
+    bool wildcards = !(first && level[0] == '$');
+
+    if (wildcards && node->hash != NULL) {
+        collect_targets(node->hash, out, count, max);
+    }
+    for (size_t i = 0; i < node->child_count; i++) {
+        const trie_node_t *child = node->children[i];
+        if (child->level_len == len && memcmp(child->level, level, len) == 0) {
+            trie_match(child, next, false, out, count, max);
+            break;
+        }
+    }
+    if (wildcards && node->plus != NULL) {
+        trie_match(node->plus, next, false, out, count, max);
+    }
+}
+
+// ==================== 快照发布 ====================
+
+/**
+ * @brief 进入读区：计数登记在当前分代，登记后分代未变才有效
+ * @param d 分发器
+ * @return 读者计数槽位，传给 read_unlock
+ */
+static unsigned read_lock(mqtt_dispatch_t *d) {
+    while (1) {
+        unsigned epoch = __atomic_load_n(&d->epoch, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&d->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&d->epoch, __ATOMIC_SEQ_CST) == epoch) {
+            return epoch & 1;
+        }
+        __atomic_sub_fetch(&d->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * @brief 离开读区
+ * @param d 分发器
+ * @param slot read_lock 返回的槽位
+ */
+static void read_unlock(mqtt_dispatch_t *d, unsigned slot) {
+    __atomic_sub_fetch(&d->readers[slot], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 在写锁下发布新快照，等待旧分代读者离开后释放旧树
+ * @param d 分发器
+ * @param root 新快照根节点
+ */
+static void publish_snapshot(mqtt_dispatch_t *d, trie_node_t *root) {
+    trie_node_t *old = __atomic_exchange_n(&d->root, root, __ATOMIC_SEQ_CST);
+    unsigned epoch = __atomic_fetch_add(&d->epoch, 1, __ATOMIC_SEQ_CST);
+    // 读区只做匹配，通常为微秒级
+    while (__atomic_load_n(&d->readers[epoch & 1], __ATOMIC_ACQUIRE) != 0) {
+        sched_yield();
+    }
+    trie_free(old);
+}
+
+/**
+ * @brief 在写锁下按订阅列表重建快照
+ * @param d 分发器
+ * @return 成功返回true，内存不足返回false（保留旧快照）
+ */
+static bool rebuild(mqtt_dispatch_t *d) {
+    trie_node_t *root = trie_build(d->subs, d->sub_count);
+    if (root == NULL) {
+        return false;
+    }
+    publish_snapshot(d, root);
+    return true;
+}
+
+// ==================== 回调线程 ====================
+
+/**
+ * @brief 计算主题哈希，用于选择回调线程
+ * @param topic 主题
+ * @return 哈希值
+ */
+static uint32_t topic_hash(const char *topic) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*topic) {
+        hash ^= (uint8_t)*topic++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief 回调线程主循环：逐条取出消息并调用匹配的回调
+ * @param arg 回调线程 dispatch_worker_t
+ * @return NULL
+ */
+static void *worker_main(void *arg) {
+    dispatch_worker_t *worker = (dispatch_worker_t *)arg;
+
+    pthread_mutex_lock(&worker->mutex);
+    while (1) {
+        while (worker->head == NULL && !worker->stop) {
+            pthread_cond_wait(&worker->not_empty, &worker->mutex);
+        }
+        if (worker->stop) {
+            break;
+        }
+        dispatch_item_t *item = worker->head;
+        worker->head = item->next;
+        if (worker->head == NULL) {
+            worker->tail = NULL;
+        }
+        worker->count--;
+        pthread_cond_signal(&worker->not_full);
+        pthread_mutex_unlock(&worker->mutex);
+
+        for (size_t i = 0; i < item->target_count; i++) {
+            item->targets[i].callback(item->topic, item->payload, item->payload_len, item->targets[i].user_data);
+        }
+        free(item);
+
+        pthread_mutex_lock(&worker->mutex);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+    return NULL;
+}
+
+/**
+ * @brief 把消息加入回调线程队列，队列满时等待
+ * @param worker 回调线程
+ * @param item 消息，所有权转移给回调线程；线程已停止时直接释放
+ */
+static void worker_enqueue(dispatch_worker_t *worker, dispatch_item_t *item) {
+    pthread_mutex_lock(&worker->mutex);
+    // 回调跟不上时让事件循环线程等待，而不是无限堆积
+    while (worker->count >= MQTT_DISPATCH_QUEUE_MAX && !worker->stop) {
+        pthread_cond_wait(&worker->not_full, &worker->mutex);
+    }
+    if (worker->stop) {
+        pthread_mutex_unlock(&worker->mutex);
+        free(item);
+        return;
+    }
+    item->next = NULL;
+    if (worker->tail) {
+        worker->tail->next = item;
+    } else {
+        worker->head = item;
+    }
+    worker->tail = item;
+    worker->count++;
+    pthread_cond_signal(&worker->not_empty);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+/**
+ * @brief 停止并回收回调线程，丢弃尚未回调的消息
+ * @param d 分发器
+ * @param count 已启动的线程数
+ */
+static void workers_stop(mqtt_dispatch_t *d, int count) {
+    for (int i = 0; i < count; i++) {
+        dispatch_worker_t *worker = &d->workers[i];
+        pthread_mutex_lock(&worker->mutex);
+        worker->stop = true;
+        pthread_cond_broadcast(&worker->not_empty);
+        pthread_cond_broadcast(&worker->not_full);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    for (int i = 0; i < count; i++) {
+        dispatch_worker_t *worker = &d->workers[i];
+        pthread_join(worker->thread, NULL);
+        while (worker->head) {
+            dispatch_item_t *next = worker->head->next;
+            free(worker->head);
+            worker->head = next;
+        }
+        pthread_cond_destroy(&worker->not_full);
+        pthread_cond_destroy(&worker->not_empty);
+        pthread_mutex_destroy(&worker->mutex);
+    }
+}
+
+// ==================== API 函数实现 ====================
+
+/**
+ * @brief 创建分发器
+ * @param workers 回调线程数，0表示在调用线程中直接回调
+ * @return 分发器句柄，失败返回NULL
+ */
+mqtt_dispatch_t *mqtt_dispatch_create(int workers) {
+    if (workers < 0 || workers > MQTT_DISPATCH_MAX_WORKERS) {
+        return NULL;
+    }
+
+    mqtt_dispatch_t *d = (mqtt_dispatch_t *)calloc(1, sizeof(mqtt_dispatch_t));
+    if (d == NULL) {
+        return NULL;
+    }
+    d->root = (trie_node_t *)calloc(1, sizeof(trie_node_t));
+    if (d->root == NULL) {
+        free(d);
+        return NULL;
+    }
+    pthread_mutex_init(&d->write_mutex, NULL);
+
+    if (workers > 0) {
+        d->workers = (dispatch_worker_t *)calloc((size_t)workers, sizeof(dispatch_worker_t));
+        if (d->workers == NULL) {
+            mqtt_dispatch_destroy(d);
+            return NULL;
+        }
+        for (int i = 0; i < workers; i++) {
+            dispatch_worker_t *worker = &d->workers[i];
+            pthread_mutex_init(&worker->mutex, NULL);
+            pthread_cond_init(&worker->not_empty, NULL);
+            pthread_cond_init(&worker->not_full, NULL);
+            if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+                pthread_cond_destroy(&worker->not_full);
+                pthread_cond_destroy(&worker->not_empty);
+                pthread_mutex_destroy(&worker->mutex);
+                mqtt_dispatch_destroy(d);
+                return NULL;
+            }
+            d->worker_count++;
+        }
+    }
+    return d;
+}
+
+/**
+ * @brief 销毁分发器，丢弃尚未回调的消息
+ * @param dispatch 分发器句柄，可为NULL
+ */
+void mqtt_dispatch_destroy(mqtt_dispatch_t *dispatch) {
+    if (dispatch == NULL) {
+        return;
+    }
+
+    workers_stop(dispatch, dispatch->worker_count);
+    free(dispatch->workers);
+
+    for (size_t i = 0; i < dispatch->sub_count; i++) {
+        free(dispatch->subs[i].filter);
+    }
+    free(dispatch->subs);
+    trie_free(dispatch->root);
+    pthread_mutex_destroy(&dispatch->write_mutex);
+    free(dispatch);
+}
+
+/**
+ * @brief 添加订阅并重建快照
+ * @param dispatch 分发器句柄
+ * @param filter 主题过滤器
+ * @param callback 消息回调
+ * @param user_data 回调用户数据
+ * @return 新增返回1，已存在返回0，失败返回-1
+ */
+int mqtt_dispatch_add(mqtt_dispatch_t *dispatch, const char *filter,
+                      mqtt_message_callback_t callback, void *user_data) {
+    if (dispatch == NULL || filter == NULL || callback == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&dispatch->write_mutex);
+    // 重连后重复订阅不产生重复回调
+    for (size_t i = 0; i < dispatch->sub_count; i++) {
+        dispatch_sub_t *sub = &dispatch->subs[i];
+        if (sub->target.callback == callback && sub->target.user_data == user_data && strcmp(sub->filter, filter) == 0) {
+            pthread_mutex_unlock(&dispatch->write_mutex);
+            return 0;
+        }
+    }
+
+    if (dispatch->sub_count == dispatch->sub_capacity) {
+        size_t capacity = dispatch->sub_capacity ? dispatch->sub_capacity * 2 : 8;
+        dispatch_sub_t *subs = (dispatch_sub_t *)realloc(dispatch->subs, capacity * sizeof(dispatch_sub_t));
+        if (subs == NULL) {
+            pthread_mutex_unlock(&dispatch->write_mutex);
+            return -1;
+        }
+        dispatch->subs = subs;
+        dispatch->sub_capacity = capacity;
+    }
+    char *copy = strdup(filter);
+    if (copy == NULL) {
+        pthread_mutex_unlock(&dispatch->write_mutex);
+        return -1;
+    }
+    dispatch_sub_t *sub = &dispatch->subs[dispatch->sub_count++];
+    sub->filter = copy;
+    sub->target.callback = callback;
+    sub->target.user_data = user_data;
+
+    if (!rebuild(dispatch)) {
+        free(copy);
+        dispatch->sub_count--;
+        pthread_mutex_unlock(&dispatch->write_mutex);
+        return -1;
+    }
+    pthread_mutex_unlock(&dispatch->write_mutex);
+    return 1;
+}
+
+/**
+ * @brief 删除匹配的订阅并重建快照
+ * @param dispatch 分发器句柄
+ * @param filter 主题过滤器
+ * @param one true 只删除一个 (callback, user_data) 相同的订阅，false 删除过滤器上的全部订阅
+ * @param callback 消息回调（one 为 true 时有效）
+ * @param user_data 回调用户数据（one 为 true 时有效）
+ * @return 删除的订阅数
+ */
+static int remove_matching(mqtt_dispatch_t *dispatch, const char *filter, bool one,
+                           mqtt_message_callback_t callback, void *user_data) {
+    if (dispatch == NULL || filter == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&dispatch->write_mutex);
+    int removed = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < dispatch->sub_count; i++) {
+        dispatch_sub_t *sub = &dispatch->subs[i];
+        bool match = strcmp(sub->filter, filter) == 0 &&
+                     (!one || (sub->target.callback == callback && sub->target.user_data == user_data));
+        if (match && (!one || removed == 0)) {
+            free(sub->filter);
+            removed++;
+        } else {
+            dispatch->subs[kept++] = *sub;
+        }
+    }
+    dispatch->sub_count = kept;
+
+    // 删除时重建失败只会让已删除的订阅多收到消息，下次变更时再重建
+    if (removed > 0) {
+        rebuild(dispatch);
+    }
+    pthread_mutex_unlock(&dispatch->write_mutex);
+    return removed;
+}
+
+/**
+ * @brief 删除过滤器上的全部订阅
+ * @param dispatch 分发器句柄
+ * @param filter 主题过滤器
+ * @return 删除的订阅数
+ */
+int mqtt_dispatch_remove(mqtt_dispatch_t *dispatch, const char *filter) {
+    return remove_matching(dispatch, filter, false, NULL, NULL);
+}
+
+/**
+ * @brief 删除一个订阅
+ * @param dispatch 分发器句柄
+ * @param filter 主题过滤器
+ * @param callback 消息回调
+ * @param user_data 回调用户数据
+ * @return 删除返回1，不存在返回0
+ */
+int mqtt_dispatch_remove_one(mqtt_dispatch_t *dispatch, const char *filter,
+                             mqtt_message_callback_t callback, void *user_data) {
+    return remove_matching(dispatch, filter, true, callback, user_data);
+}
+
+/**
+ * @brief 分发一条消息
+ * @details 在读区内匹配订阅，读区外回调；有回调线程时把主题、负载和匹配结果
+ *          复制到一块内存中交给按主题哈希选中的线程
+ * @param dispatch 分发器句柄
+ * @param topic 消息主题
+ * @param payload 消息负载
+ * @param payload_len 负载长度
+ * @return 匹配的订阅数
+ */
+int mqtt_dispatch_message(mqtt_dispatch_t *dispatch, const char *topic,
+                          const void *payload, size_t payload_len) {
+    if (dispatch == NULL || topic == NULL) {
+        return 0;
+    }
+
+    dispatch_target_t targets[MQTT_DISPATCH_MAX_MATCHES];
+    size_t count = 0;
+    unsigned slot = read_lock(dispatch);
+    const trie_node_t *root = __atomic_load_n(&dispatch->root, __ATOMIC_SEQ_CST);
+    trie_match(root, topic, true, targets, &count, MQTT_DISPATCH_MAX_MATCHES);
+    read_unlock(dispatch, slot);
+
+    if (count > MQTT_DISPATCH_MAX_MATCHES) {
+        fprintf(stderr, "MQTT: %zu subscriptions match %s, only %d are called\n",
+                count, topic, MQTT_DISPATCH_MAX_MATCHES);
+        count = MQTT_DISPATCH_MAX_MATCHES;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    if (dispatch->worker_count == 0) {
+        for (size_t i = 0; i < count; i++) {
+            targets[i].callback(topic, payload, payload_len, targets[i].user_data);
+        }
+        return (int)count;
+    }
+
+    size_t topic_len = strlen(topic) + 1;
+    size_t targets_size = count * sizeof(dispatch_target_t);
+    // 负载后追加 '\0'，与 mosquitto 交给回调的负载一致
+    dispatch_item_t *item = (dispatch_item_t *)malloc(sizeof(dispatch_item_t) + targets_size + topic_len + payload_len + 1);
+    if (item == NULL) {
+        fprintf(stderr, "MQTT: dropping message on %s: out of memory\n", topic);
+        return 0;
+    }
+    char *data = (char *)item->targets + targets_size;
+    memcpy(item->targets, targets, targets_size);
+    memcpy(data, topic, topic_len);
+    if (payload_len > 0) {
+        memcpy(data + topic_len, payload, payload_len);
+    }
+    data[topic_len + payload_len] = '\0';
+    item->topic = data;
+    item->payload = data + topic_len;
+    item->payload_len = payload_len;
+    item->target_count = count;
+
+    worker_enqueue(&dispatch->workers[topic_hash(topic) % (uint32_t)dispatch->worker_count], item);
+    return (int)count;
+}
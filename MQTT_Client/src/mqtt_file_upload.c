@@ -1,17 +1,20 @@
 #include "mqtt_file_upload.h"
+#include "air8000_checksum.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
 
 // ==================== 内部函数声明 ====================
 
 /**
  * @brief 生成唯一文件ID
  */
-static void generate_file_id(char *buffer, size_t buffer_size);
+static void generate_file_id(char *buffer, size_t buffer_size, uint32_t seq);
 
 /**
  * @brief 从文件路径中提取文件名
@@ -23,11 +26,19 @@ static void extract_filename(const char *file_path, char *filename, size_t filen
  */
 static FILE *try_open_file(const char *file_path, const char *mode, int max_retries);
 
+/**
+ * @brief 释放文件映射与文件句柄
+ */
+static void release_file(file_upload_context_t *ctx);
+
+// 上传序号：多个上传并行时保证同一秒内 file_id / bin_id 不重复
+static uint32_t g_upload_seq = 0;
+
 // ==================== 内部函数实现 ====================
 
-static void generate_file_id(char *buffer, size_t buffer_size) {
+static void generate_file_id(char *buffer, size_t buffer_size, uint32_t seq) {
     time_t now = time(NULL);
-    snprintf(buffer, buffer_size, "%lld_%d", (long long)now, rand() % 10000);
+    snprintf(buffer, buffer_size, "%lld_%04u", (long long)now, seq % 10000);
 }
 
 static void extract_filename(const char *file_path, char *filename, size_t filename_size) {
@@ -56,8 +67,24 @@ static FILE *try_open_file(const char *file_path, const char *mode, int max_retr
     return NULL;
 }
 
+static void release_file(file_upload_context_t *ctx) {
+    if (ctx->map) {
+        munmap((void *)ctx->map, ctx->map_len);
+        ctx->map = NULL;
+        ctx->map_len = 0;
+    }
+    if (ctx->file_handle) {
+        fclose(ctx->file_handle);
+        ctx->file_handle = NULL;
+    }
+}
+
 // ==================== API 函数实现 ====================
 
+uint32_t file_upload_crc32c(uint32_t crc, const uint8_t *data, size_t len) {
+    return air8000_crc32c_update(crc, data, len);
+}
+
 file_upload_context_t *file_upload_create(const char *file_path, uint32_t chunk_size) {
     if (!file_path) {
         return NULL;
@@ -78,7 +105,9 @@ file_upload_context_t *file_upload_create(const char *file_path, uint32_t chunk_
     // 初始化上下文
     memset(ctx, 0, sizeof(file_upload_context_t));
     strncpy(ctx->file_path, file_path, sizeof(ctx->file_path) - 1);
-    generate_file_id(ctx->file_id, sizeof(ctx->file_id));
+    uint32_t seq = __atomic_add_fetch(&g_upload_seq, 1, __ATOMIC_RELAXED);
+    generate_file_id(ctx->file_id, sizeof(ctx->file_id), seq);
+    ctx->bin_id = ((uint32_t)time(NULL) << 16) ^ (seq & 0xFFFF);
     extract_filename(file_path, ctx->filename, sizeof(ctx->filename));
     
     ctx->file_size = file_stat.st_size;
@@ -97,11 +126,8 @@ void file_upload_destroy(file_upload_context_t *ctx) {
         return;
     }
 
-    // 关闭文件
-    if (ctx->file_handle) {
-        fclose(ctx->file_handle);
-        ctx->file_handle = NULL;
-    }
+    // 解除映射并关闭文件
+    release_file(ctx);
 
     // 释放内存
     free(ctx);
@@ -120,6 +146,16 @@ bool file_upload_start(file_upload_context_t *ctx) {
         return false;
     }
 
+    // 只读映射整个文件，分片直接从映射区发送；失败时仍可按 fread 方式读取
+    if (ctx->file_size > 0) {
+        void *map = mmap(NULL, (size_t)ctx->file_size, PROT_READ, MAP_PRIVATE, fileno(ctx->file_handle), 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)ctx->file_size, MADV_SEQUENTIAL);
+            ctx->map = (const uint8_t *)map;
+            ctx->map_len = (size_t)ctx->file_size;
+        }
+    }
+
     // 更新状态
     ctx->state = FILE_UPLOAD_STATE_UPLOADING;
     ctx->current_chunk = 0;
@@ -177,16 +213,99 @@ bool file_upload_get_next_chunk(file_upload_context_t *ctx, uint8_t **chunk_data
     return true;
 }
 
+bool file_upload_map_next_chunk(file_upload_context_t *ctx, const uint8_t **chunk_data, size_t *chunk_data_len, uint32_t *chunk_id) {
+    if (!ctx || !chunk_data || !chunk_data_len || !chunk_id) {
+        return false;
+    }
+
+    if (ctx->state != FILE_UPLOAD_STATE_UPLOADING || !ctx->map) {
+        return false;
+    }
+
+    if (ctx->current_chunk >= ctx->total_chunks) {
+        return false;
+    }
+
+    if (!file_upload_map_chunk(ctx, ctx->current_chunk, chunk_data, chunk_data_len)) {
+        return false;
+    }
+    *chunk_id = ctx->current_chunk;
+
+    ctx->current_chunk++;
+    ctx->uploaded_size += *chunk_data_len;
+    ctx->progress = (uint8_t)((ctx->uploaded_size * 100) / ctx->file_size);
+
+    return true;
+}
+
+bool file_upload_map_chunk(const file_upload_context_t *ctx, uint32_t chunk_id, const uint8_t **chunk_data, size_t *chunk_data_len) {
+    if (!ctx || !ctx->map || !chunk_data || !chunk_data_len || chunk_id >= ctx->total_chunks) {
+        return false;
+    }
+
+    uint64_t offset = (uint64_t)chunk_id * ctx->chunk_size;
+    uint64_t remain = ctx->file_size - offset;
+    *chunk_data = ctx->map + offset;
+    *chunk_data_len = remain < ctx->chunk_size ? (size_t)remain : ctx->chunk_size;
+    return true;
+}
+
+void file_upload_fill_binary_header(const file_upload_context_t *ctx, file_upload_binary_header_t *header,
+                                    uint32_t chunk_id, const uint8_t *chunk_data, size_t chunk_data_len) {
+    header->magic = htonl(FILE_UPLOAD_BINARY_MAGIC);
+    header->file_id = htonl(ctx->bin_id);
+    header->chunk_id = htonl(chunk_id);
+    header->data_len = htonl((uint32_t)chunk_data_len);
+    header->crc32c = htonl(file_upload_crc32c(0, chunk_data, chunk_data_len));
+}
+
+size_t file_upload_encode_hex_chunk(const file_upload_context_t *ctx, uint32_t chunk_id,
+                                    const uint8_t *chunk_data, size_t chunk_data_len,
+                                    char *out, size_t out_size) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    if (!ctx || !out || (!chunk_data && chunk_data_len > 0)) {
+        return 0;
+    }
+
+    int prefix_len = snprintf(out, out_size,
+                              "{\"type\":\"chunk\",\"file_id\":\"%s\",\"chunk_id\":%u,\"data\":\"",
+                              ctx->file_id, chunk_id);
+    // 前缀、十六进制数据和结尾的 "} 都要放得下
+    if (prefix_len < 0 || (size_t)prefix_len + chunk_data_len * 2 + 2 > out_size) {
+        return 0;
+    }
+
+    char *p = out + prefix_len;
+    for (size_t i = 0; i < chunk_data_len; i++) {
+        *p++ = hex_digits[chunk_data[i] >> 4];
+        *p++ = hex_digits[chunk_data[i] & 0x0F];
+    }
+    *p++ = '"';
+    *p++ = '}';
+    return (size_t)(p - out);
+}
+
+size_t file_upload_encode_binary_chunk(const file_upload_context_t *ctx, uint32_t chunk_id,
+                                       const uint8_t *chunk_data, size_t chunk_data_len,
+                                       uint8_t *out, size_t out_size) {
+    if (!ctx || !out || (!chunk_data && chunk_data_len > 0) ||
+        sizeof(file_upload_binary_header_t) + chunk_data_len > out_size) {
+        return 0;
+    }
+    file_upload_fill_binary_header(ctx, (file_upload_binary_header_t *)out, chunk_id, chunk_data, chunk_data_len);
+    if (chunk_data_len > 0) {
+        memcpy(out + sizeof(file_upload_binary_header_t), chunk_data, chunk_data_len);
+    }
+    return sizeof(file_upload_binary_header_t) + chunk_data_len;
+}
+
 bool file_upload_finish(file_upload_context_t *ctx) {
     if (!ctx) {
         return false;
     }
 
-    // 关闭文件
-    if (ctx->file_handle) {
-        fclose(ctx->file_handle);
-        ctx->file_handle = NULL;
-    }
+    // 解除映射并关闭文件
+    release_file(ctx);
 
     // 更新状态
     ctx->state = FILE_UPLOAD_STATE_COMPLETE;
@@ -202,11 +321,8 @@ bool file_upload_abort(file_upload_context_t *ctx) {
     // 标记为已取消
     ctx->aborted = true;
 
-    // 关闭文件
-    if (ctx->file_handle) {
-        fclose(ctx->file_handle);
-        ctx->file_handle = NULL;
-    }
+    // 解除映射并关闭文件
+    release_file(ctx);
 
     // 更新状态
     ctx->state = FILE_UPLOAD_STATE_FAILED;
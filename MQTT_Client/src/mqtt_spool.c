@@ -0,0 +1,565 @@
+#define _GNU_SOURCE
+#include "mqtt_spool.h"
+#include "mqtt_file_upload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ==================== 常量定义 ====================
+
+#define SPOOL_RECORD_MAGIC 0x4C4F4F53u     // "SOOL"
+#define SPOOL_CURSOR_MAGIC 0x52435053u     // "SPCR"
+#define SPOOL_SEGMENT_SUFFIX ".seg"
+#define SPOOL_CURSOR_FILE "cursor"
+#define SPOOL_PATH_MAX 512
+
+/**
+ * @brief 段文件大小下限，保证最大的记录（主题 + 数 KB 负载）放得下
+ */
+#define SPOOL_MIN_SEGMENT_SIZE (64 * 1024)
+
+// ==================== 内部类型 ====================
+
+/**
+ * @brief 记录头部，其后紧跟主题和负载，整条记录按8字节对齐
+ * @details magic 最后写入；crc 覆盖 seq 之后的头部字段、主题与负载，断电或崩溃留下的半条记录校验不过
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;
+    uint64_t seq;
+    uint32_t payload_len;
+    uint16_t topic_len;
+    uint8_t qos;
+    uint8_t reserved;
+} spool_record_header_t;
+
+/**
+ * @brief 回放位置，回放后写回 cursor 文件（不 fsync，崩溃最多重放一批）
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t segment;
+    uint64_t offset;
+    uint64_t seq;
+} spool_cursor_t;
+
+struct mqtt_spool {
+    char directory[SPOOL_PATH_MAX];
+    mqtt_spool_config_t config;
+    pthread_mutex_t mutex;
+
+    // 写入端（mutex 保护）
+    uint32_t first_segment;         // 最旧的段；写入端丢弃旧段时上调
+    uint32_t write_segment;
+    uint8_t *write_map;
+    size_t write_offset;
+    uint64_t next_seq;
+
+    // 回放端（只在回放线程中访问）
+    uint32_t read_segment;
+    uint8_t *read_map;
+    uint32_t read_map_segment;
+    size_t read_offset;
+    uint64_t read_seq;              // 下一条记录的序号
+    bool read_resync;               // 段首或丢弃后，以读到的第一条记录的序号为准
+    int cursor_fd;
+    double tokens;
+    uint64_t last_refill_ms;
+
+    mqtt_spool_stats_t stats;
+};
+
+// ==================== 内部函数 ====================
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static size_t record_size(size_t topic_len, size_t payload_len) {
+    return (sizeof(spool_record_header_t) + topic_len + payload_len + 7) & ~(size_t)7;
+}
+
+static uint32_t record_crc(const spool_record_header_t *h) {
+    const uint8_t *p = (const uint8_t *)h;
+    size_t fixed = offsetof(spool_record_header_t, seq);
+    return file_upload_crc32c(0, p + fixed, sizeof(*h) - fixed + h->topic_len + h->payload_len);
+}
+
+static void segment_path(const mqtt_spool_t *s, uint32_t segment, char *path, size_t size) {
+    snprintf(path, size, "%s/%08u" SPOOL_SEGMENT_SUFFIX, s->directory, segment);
+}
+
+/**
+ * @brief 映射段文件，不存在时按段大小创建（新文件全零，即没有记录）
+ * @details 可写映射先用 posix_fallocate 分配整段磁盘块：稀疏文件在磁盘满时写映射页会触发 SIGBUS，
+ *          预先分配则让空间不足在这里以错误返回，由调用方拒绝写入
+ */
+static uint8_t *map_segment(const mqtt_spool_t *s, uint32_t segment, bool create, bool writable) {
+    char path[SPOOL_PATH_MAX + 16];
+    segment_path(s, segment, path, sizeof(path));
+    int fd = open(path, (writable ? O_RDWR : O_RDONLY) | (create ? O_CREAT : 0) | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (!writable && (size_t)st.st_size < s->config.segment_size)) {
+        close(fd);
+        return NULL;
+    }
+    if (writable) {
+        int err = posix_fallocate(fd, 0, (off_t)s->config.segment_size);
+        if (err != 0) {
+            fprintf(stderr, "mqtt_spool: failed to allocate %s: %s\n", path, strerror(err));
+            if (st.st_size == 0) {
+                // 刚创建的段不留下残缺文件
+                unlink(path);
+            }
+            close(fd);
+            return NULL;
+        }
+    }
+    void *map = mmap(NULL, s->config.segment_size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    return map == MAP_FAILED ? NULL : (uint8_t *)map;
+}
+
+static void unmap_segment(const mqtt_spool_t *s, uint8_t *map) {
+    if (map) {
+        munmap(map, s->config.segment_size);
+    }
+}
+
+static void unlink_segment(const mqtt_spool_t *s, uint32_t segment) {
+    char path[SPOOL_PATH_MAX + 16];
+    segment_path(s, segment, path, sizeof(path));
+    unlink(path);
+}
+
+/**
+ * @brief 检查 offset 处是否是一条完整有效的记录
+ * @param expected_seq 期望序号，NULL表示不检查
+ * @return 有效返回记录长度，否则返回0
+ */
+static size_t check_record(const mqtt_spool_t *s, const uint8_t *map, size_t offset, size_t limit,
+                           const uint64_t *expected_seq) {
+    if (limit > s->config.segment_size || offset + sizeof(spool_record_header_t) > limit) {
+        return 0;
+    }
+    const spool_record_header_t *h = (const spool_record_header_t *)(map + offset);
+    if (h->magic != SPOOL_RECORD_MAGIC || h->topic_len == 0 || h->topic_len > MQTT_SPOOL_TOPIC_MAX) {
+        return 0;
+    }
+    size_t size = record_size(h->topic_len, h->payload_len);
+    if (size > limit - offset || (expected_seq && h->seq != *expected_seq)) {
+        return 0;
+    }
+    if (record_crc(h) != h->crc) {
+        return 0;
+    }
+    return size;
+}
+
+static void save_cursor(mqtt_spool_t *s) {
+    if (s->cursor_fd < 0) {
+        return;
+    }
+    spool_cursor_t cursor = { SPOOL_CURSOR_MAGIC, s->read_segment, s->read_offset, s->read_seq };
+    if (pwrite(s->cursor_fd, &cursor, sizeof(cursor), 0) != (ssize_t)sizeof(cursor)) {
+        fprintf(stderr, "mqtt_spool: failed to save cursor: %s\n", strerror(errno));
+    }
+}
+
+/**
+ * @brief 写入端换到新段（调用方持有 mutex）；超过段数上限时丢弃最旧的段
+ */
+static int roll_segment(mqtt_spool_t *s) {
+    uint8_t *map = map_segment(s, s->write_segment + 1, true, true);
+    if (!map) {
+        return -1;
+    }
+    if (s->write_map) {
+        msync(s->write_map, s->write_offset, MS_ASYNC);
+        unmap_segment(s, s->write_map);
+    }
+    s->write_map = map;
+    s->write_segment++;
+    s->write_offset = 0;
+
+    while (s->write_segment - s->first_segment + 1 > s->config.max_segments) {
+        // 回放端可能仍映射着该段，删除文件不影响已有映射，回放端下次会跳过
+        unlink_segment(s, s->first_segment);
+        s->first_segment++;
+        s->stats.dropped_segments++;
+    }
+    return 0;
+}
+
+/**
+ * @brief 回放端结束当前段：解除映射并删除文件
+ */
+static void finish_read_segment(mqtt_spool_t *s) {
+    unmap_segment(s, s->read_map);
+    s->read_map = NULL;
+
+    pthread_mutex_lock(&s->mutex);
+    if (s->read_segment >= s->first_segment && s->read_segment < s->write_segment) {
+        unlink_segment(s, s->read_segment);
+        s->first_segment = s->read_segment + 1;
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    s->read_segment++;
+    s->read_offset = 0;
+    s->read_resync = true;
+}
+
+/**
+ * @brief 扫描目录中的段文件序号范围
+ * @return 找到段文件返回true
+ */
+static bool scan_segments(const char *directory, uint32_t *min_segment, uint32_t *max_segment) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return false;
+    }
+    bool found = false;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned int segment;
+        char suffix[8];
+        if (sscanf(entry->d_name, "%8u%7s", &segment, suffix) != 2 || strcmp(suffix, SPOOL_SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        if (!found || segment < *min_segment) *min_segment = segment;
+        if (!found || segment > *max_segment) *max_segment = segment;
+        found = true;
+    }
+    closedir(dir);
+    return found;
+}
+
+/**
+ * @brief 恢复回放位置和写入位置
+ */
+static int recover(mqtt_spool_t *s) {
+    spool_cursor_t cursor;
+    bool have_cursor = pread(s->cursor_fd, &cursor, sizeof(cursor), 0) == (ssize_t)sizeof(cursor) &&
+                       cursor.magic == SPOOL_CURSOR_MAGIC;
+
+    uint32_t min_segment = 0, max_segment = 0;
+    if (!scan_segments(s->directory, &min_segment, &max_segment)) {
+        // 没有段文件：从新段开始
+        uint32_t segment = have_cursor ? cursor.segment + 1 : 0;
+        s->first_segment = s->read_segment = s->write_segment = segment;
+        s->read_seq = s->next_seq = have_cursor ? cursor.seq : 1;
+        s->read_resync = true;
+        s->write_map = map_segment(s, segment, true, true);
+        return s->write_map ? 0 : -1;
+    }
+
+    if (have_cursor && cursor.segment >= min_segment && cursor.segment <= max_segment &&
+        cursor.offset < s->config.segment_size) {
+        s->read_segment = cursor.segment;
+        s->read_offset = (size_t)cursor.offset;
+        s->read_seq = cursor.seq;
+        s->read_resync = false;
+    } else {
+        s->read_segment = min_segment;
+        s->read_offset = 0;
+        s->read_resync = true;
+    }
+    for (uint32_t seg = min_segment; seg < s->read_segment; seg++) {
+        unlink_segment(s, seg);
+    }
+    s->first_segment = s->read_segment;
+
+    // 写入位置：最新段中最后一条连续有效记录之后
+    s->write_segment = max_segment;
+    s->write_map = map_segment(s, max_segment, false, true);
+    if (!s->write_map) {
+        return -1;
+    }
+    size_t offset = 0;
+    uint64_t seq = 0;
+    bool check_seq = false;
+    if (max_segment == s->read_segment) {
+        offset = s->read_offset;
+        seq = s->read_seq;
+        check_seq = !s->read_resync;
+    }
+    size_t size;
+    while ((size = check_record(s, s->write_map, offset, s->config.segment_size, check_seq ? &seq : NULL)) > 0) {
+        const spool_record_header_t *h = (const spool_record_header_t *)(s->write_map + offset);
+        seq = h->seq + 1;
+        check_seq = true;
+        offset += size;
+    }
+    s->write_offset = offset;
+    s->next_seq = seq ? seq : 1;
+    return 0;
+}
+
+// ==================== API 函数实现 ====================
+
+void mqtt_spool_default_config(mqtt_spool_config_t *config) {
+    if (!config) {
+        return;
+    }
+    config->segment_size = MQTT_SPOOL_DEFAULT_SEGMENT_SIZE;
+    config->max_segments = MQTT_SPOOL_DEFAULT_MAX_SEGMENTS;
+    config->drain_rate = MQTT_SPOOL_DEFAULT_DRAIN_RATE;
+    config->drain_burst = MQTT_SPOOL_DEFAULT_DRAIN_BURST;
+}
+
+mqtt_spool_t *mqtt_spool_open(const char *directory, const mqtt_spool_config_t *config) {
+    if (!directory || strlen(directory) >= SPOOL_PATH_MAX - 32) {
+        return NULL;
+    }
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    mqtt_spool_t *s = (mqtt_spool_t *)calloc(1, sizeof(mqtt_spool_t));
+    if (!s) {
+        return NULL;
+    }
+    strcpy(s->directory, directory);
+    mqtt_spool_default_config(&s->config);
+    if (config) {
+        if (config->segment_size) s->config.segment_size = config->segment_size;
+        if (config->max_segments) s->config.max_segments = config->max_segments;
+        if (config->drain_rate) s->config.drain_rate = config->drain_rate;
+        if (config->drain_burst) s->config.drain_burst = config->drain_burst;
+    }
+    if (s->config.segment_size < SPOOL_MIN_SEGMENT_SIZE) {
+        s->config.segment_size = SPOOL_MIN_SEGMENT_SIZE;
+    }
+    // 段大小按页对齐，便于映射
+    long page = sysconf(_SC_PAGESIZE);
+    if (page > 0) {
+        s->config.segment_size = (s->config.segment_size + (size_t)page - 1) & ~((size_t)page - 1);
+    }
+    pthread_mutex_init(&s->mutex, NULL);
+
+    char path[SPOOL_PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/" SPOOL_CURSOR_FILE, s->directory);
+    s->cursor_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (s->cursor_fd < 0 || recover(s) != 0) {
+        mqtt_spool_close(s);
+        return NULL;
+    }
+    s->tokens = s->config.drain_burst;
+    s->last_refill_ms = now_ms();
+    return s;
+}
+
+void mqtt_spool_close(mqtt_spool_t *spool) {
+    if (!spool) {
+        return;
+    }
+    if (spool->write_map) {
+        msync(spool->write_map, spool->write_offset, MS_ASYNC);
+    }
+    unmap_segment(spool, spool->write_map);
+    unmap_segment(spool, spool->read_map);
+    if (spool->cursor_fd >= 0) {
+        close(spool->cursor_fd);
+    }
+    pthread_mutex_destroy(&spool->mutex);
+    free(spool);
+}
+
+int mqtt_spool_append(mqtt_spool_t *spool, const char *topic, const void *payload, size_t payload_len, int qos) {
+    if (!spool || !topic || (!payload && payload_len > 0)) {
+        return -1;
+    }
+    size_t topic_len = strlen(topic);
+    size_t size = record_size(topic_len, payload_len);
+    if (topic_len == 0 || topic_len > MQTT_SPOOL_TOPIC_MAX || payload_len > UINT32_MAX ||
+        size > spool->config.segment_size) {
+        pthread_mutex_lock(&spool->mutex);
+        spool->stats.rejected++;
+        pthread_mutex_unlock(&spool->mutex);
+        return -1;
+    }
+
+    pthread_mutex_lock(&spool->mutex);
+    if ((spool->write_offset + size > spool->config.segment_size || !spool->write_map) && roll_segment(spool) != 0) {
+        spool->stats.rejected++;
+        pthread_mutex_unlock(&spool->mutex);
+        return -1;
+    }
+
+    uint8_t *p = spool->write_map + spool->write_offset;
+    spool_record_header_t *h = (spool_record_header_t *)p;
+    h->seq = spool->next_seq;
+    h->payload_len = (uint32_t)payload_len;
+    h->topic_len = (uint16_t)topic_len;
+    h->qos = (uint8_t)qos;
+    h->reserved = 0;
+    memcpy(p + sizeof(*h), topic, topic_len);
+    if (payload_len > 0) {
+        memcpy(p + sizeof(*h) + topic_len, payload, payload_len);
+    }
+    h->crc = record_crc(h);
+    __atomic_store_n(&h->magic, SPOOL_RECORD_MAGIC, __ATOMIC_RELEASE);
+
+    spool->write_offset += size;
+    spool->next_seq++;
+    spool->stats.appended++;
+    pthread_mutex_unlock(&spool->mutex);
+    return 0;
+}
+
+size_t mqtt_spool_drain(mqtt_spool_t *spool, mqtt_spool_replay_cb replay_cb, void *user_data) {
+    if (!spool || !replay_cb) {
+        return 0;
+    }
+
+    // 令牌桶限速：回放与实时消息共用链路，不能一次把积压全部推出去
+    uint64_t now = now_ms();
+    spool->tokens += (double)(now - spool->last_refill_ms) * spool->config.drain_rate / 1000.0;
+    if (spool->tokens > spool->config.drain_burst) {
+        spool->tokens = spool->config.drain_burst;
+    }
+    spool->last_refill_ms = now;
+
+    size_t replayed = 0;
+    bool moved = false;
+    while (spool->tokens >= 1.0) {
+        pthread_mutex_lock(&spool->mutex);
+        uint32_t write_segment = spool->write_segment;
+        size_t write_offset = spool->write_offset;
+        uint32_t first_segment = spool->first_segment;
+        pthread_mutex_unlock(&spool->mutex);
+
+        if (spool->read_segment < first_segment) {
+            // 积压超过段数上限，最旧的段已被写入端丢弃
+            unmap_segment(spool, spool->read_map);
+            spool->read_map = NULL;
+            spool->read_segment = first_segment;
+            spool->read_offset = 0;
+            spool->read_resync = true;
+            moved = true;
+        }
+
+        if (spool->read_segment == write_segment && spool->read_offset >= write_offset) {
+            // 已全部回放：写入端换到新段，删除已回放的日志
+            if (write_offset > 0) {
+                pthread_mutex_lock(&spool->mutex);
+                if (spool->write_segment == write_segment && spool->write_offset == write_offset &&
+                    roll_segment(spool) == 0) {
+                    unlink_segment(spool, write_segment);
+                    spool->first_segment = spool->write_segment;
+                    spool->read_segment = spool->write_segment;
+                    spool->read_offset = 0;
+                    spool->read_resync = true;
+                    moved = true;
+                }
+                pthread_mutex_unlock(&spool->mutex);
+                unmap_segment(spool, spool->read_map);
+                spool->read_map = NULL;
+            }
+            break;
+        }
+
+        if (!spool->read_map || spool->read_map_segment != spool->read_segment) {
+            unmap_segment(spool, spool->read_map);
+            spool->read_map = map_segment(spool, spool->read_segment, false, false);
+            spool->read_map_segment = spool->read_segment;
+            if (!spool->read_map) {
+                if (spool->read_segment == write_segment) {
+                    break;
+                }
+                // 段文件丢失：跳到下一段
+                finish_read_segment(spool);
+                moved = true;
+                continue;
+            }
+        }
+
+        size_t limit = spool->read_segment == write_segment ? write_offset : spool->config.segment_size;
+        size_t size = check_record(spool, spool->read_map, spool->read_offset, limit,
+                                   spool->read_resync ? NULL : &spool->read_seq);
+        if (size == 0) {
+            if (spool->read_segment != write_segment) {
+                // 旧段的剩余部分没有记录（或记录损坏，无法重新同步），进入下一段
+                if (spool->read_offset + sizeof(spool_record_header_t) <= spool->config.segment_size &&
+                    ((const spool_record_header_t *)(spool->read_map + spool->read_offset))->magic == SPOOL_RECORD_MAGIC) {
+                    spool->stats.corrupt++;
+                }
+                finish_read_segment(spool);
+                moved = true;
+                continue;
+            }
+            // 当前写入段中已提交的记录校验失败：跳过到写入位置
+            spool->stats.corrupt++;
+            spool->read_offset = write_offset;
+            moved = true;
+            continue;
+        }
+
+        const spool_record_header_t *h = (const spool_record_header_t *)(spool->read_map + spool->read_offset);
+        char topic[MQTT_SPOOL_TOPIC_MAX + 1];
+        memcpy(topic, spool->read_map + spool->read_offset + sizeof(*h), h->topic_len);
+        topic[h->topic_len] = '\0';
+        mqtt_spool_record_t record = {
+            .topic = topic,
+            .payload = spool->read_map + spool->read_offset + sizeof(*h) + h->topic_len,
+            .payload_len = h->payload_len,
+            .qos = h->qos,
+            .seq = h->seq
+        };
+        if (replay_cb(&record, user_data) != 0) {
+            break;
+        }
+
+        spool->read_offset += size;
+        spool->read_seq = h->seq + 1;
+        spool->read_resync = false;
+        spool->tokens -= 1.0;
+        replayed++;
+        moved = true;
+    }
+
+    if (moved) {
+        pthread_mutex_lock(&spool->mutex);
+        spool->stats.replayed += replayed;
+        pthread_mutex_unlock(&spool->mutex);
+        save_cursor(spool);
+    }
+    return replayed;
+}
+
+bool mqtt_spool_empty(mqtt_spool_t *spool) {
+    if (!spool) {
+        return true;
+    }
+    pthread_mutex_lock(&spool->mutex);
+    bool empty = spool->read_segment == spool->write_segment && spool->read_offset >= spool->write_offset;
+    pthread_mutex_unlock(&spool->mutex);
+    return empty;
+}
+
+void mqtt_spool_get_stats(mqtt_spool_t *spool, mqtt_spool_stats_t *stats) {
+    if (!spool || !stats) {
+        return;
+    }
+    pthread_mutex_lock(&spool->mutex);
+    *stats = spool->stats;
+    stats->segments = spool->write_segment - spool->first_segment + 1;
+    stats->empty = spool->read_segment == spool->write_segment && spool->read_offset >= spool->write_offset;
+    pthread_mutex_unlock(&spool->mutex);
+}
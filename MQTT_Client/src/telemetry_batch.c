@@ -0,0 +1,463 @@
+#include "telemetry_batch.h"
+#include "json_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ==================== 常量定义 ====================
+
+/**
+ * @brief 单个数值编码后的最大字节数（JSON "-4294967295," 为12字节，CBOR 最多9字节）
+ * @details 差值在 int64 中计算，int32 字段的差值最多33位
+ */
+#define VALUE_MAX_BYTES 12
+
+/**
+ * @brief 负载固定部分（版本、t0、count 等键）预留字节数
+ */
+#define HEADER_RESERVE 128
+
+/**
+ * @brief 样本部分大小上限的最小值，保证单个样本总能放下
+ */
+#define MIN_MAX_BYTES 256
+
+// ==================== 内部类型 ====================
+
+/**
+ * @brief 数据序列
+ */
+typedef struct {
+    char name[TELEMETRY_BATCH_NAME_MAX];
+    char fields[TELEMETRY_BATCH_MAX_FIELDS][TELEMETRY_BATCH_NAME_MAX];
+    size_t field_count;
+} series_t;
+
+/**
+ * @brief 样本
+ */
+typedef struct {
+    uint8_t series;
+    uint32_t timestamp;
+    int32_t values[TELEMETRY_BATCH_MAX_FIELDS];
+} sample_t;
+
+/**
+ * @brief CBOR 写入器
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+} cbor_writer_t;
+
+/**
+ * @brief 编码器：同一套调用按格式写 JSON 或 CBOR
+ * @details CBOR 使用定长容器，开始对象/数组时必须给出元素个数；JSON 忽略个数
+ */
+typedef struct {
+    telemetry_format_t format;
+    json_writer_t json;
+    cbor_writer_t cbor;
+} encoder_t;
+
+/**
+ * @brief 聚合器
+ */
+struct telemetry_batch {
+    telemetry_batch_config_t config;
+    char device_id[64];
+    telemetry_batch_flush_cb flush_cb;
+    void *user_data;
+
+    series_t series[TELEMETRY_BATCH_MAX_SERIES];
+    size_t series_count;
+    size_t header_bytes;            // 设备ID与序列名、字段名的编码大小估计
+
+    sample_t *samples;
+    size_t sample_count;
+    size_t sample_bytes;            // 已聚合样本的编码大小估计
+    uint64_t window_start_ms;       // 本批第一个样本到达时间
+
+    uint8_t *buf;                   // 编码缓冲区
+    size_t buf_cap;
+
+    telemetry_batch_stats_t stats;
+};
+
+// ==================== 内部函数 ====================
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void cbor_put(cbor_writer_t *c, const void *data, size_t n) {
+    if (c->overflow || n > c->cap - c->len) {
+        c->overflow = true;
+        return;
+    }
+    memcpy(c->buf + c->len, data, n);
+    c->len += n;
+}
+
+/**
+ * @brief 写入 CBOR 头部：主类型 + 参数（大端）
+ */
+static void cbor_head(cbor_writer_t *c, uint8_t major, uint64_t v) {
+    uint8_t h[9];
+    size_t n;
+    if (v < 24) {
+        h[0] = (uint8_t)(major << 5 | v);
+        n = 1;
+    } else {
+        size_t bytes = v <= 0xFF ? 1 : v <= 0xFFFF ? 2 : v <= 0xFFFFFFFFu ? 4 : 8;
+        h[0] = (uint8_t)(major << 5 | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+        for (size_t i = 0; i < bytes; i++) {
+            h[1 + i] = (uint8_t)(v >> (8 * (bytes - 1 - i)));
+        }
+        n = 1 + bytes;
+    }
+    cbor_put(c, h, n);
+}
+
+static void enc_map(encoder_t *e, size_t n) {
+    if (e->format == TELEMETRY_FORMAT_CBOR) {
+        cbor_head(&e->cbor, 5, n);
+    } else {
+        json_writer_object_begin(&e->json);
+    }
+}
+
+static void enc_map_end(encoder_t *e) {
+    if (e->format == TELEMETRY_FORMAT_JSON) {
+        json_writer_object_end(&e->json);
+    }
+}
+
+static void enc_array(encoder_t *e, size_t n) {
+    if (e->format == TELEMETRY_FORMAT_CBOR) {
+        cbor_head(&e->cbor, 4, n);
+    } else {
+        json_writer_array_begin(&e->json);
+    }
+}
+
+static void enc_array_end(encoder_t *e) {
+    if (e->format == TELEMETRY_FORMAT_JSON) {
+        json_writer_array_end(&e->json);
+    }
+}
+
+static void enc_text(encoder_t *e, const char *s) {
+    if (e->format == TELEMETRY_FORMAT_CBOR) {
+        size_t n = strlen(s);
+        cbor_head(&e->cbor, 3, n);
+        cbor_put(&e->cbor, s, n);
+    } else {
+        json_writer_string(&e->json, s);
+    }
+}
+
+static void enc_key(encoder_t *e, const char *key) {
+    if (e->format == TELEMETRY_FORMAT_CBOR) {
+        enc_text(e, key);
+    } else {
+        json_writer_key(&e->json, key);
+    }
+}
+
+static void enc_int(encoder_t *e, int64_t v) {
+    if (e->format == TELEMETRY_FORMAT_CBOR) {
+        // 负数编码为主类型1，参数为 -1-v
+        if (v >= 0) {
+            cbor_head(&e->cbor, 0, (uint64_t)v);
+        } else {
+            cbor_head(&e->cbor, 1, (uint64_t)(-1 - v));
+        }
+    } else {
+        json_writer_int(&e->json, v);
+    }
+}
+
+static void enc_bool(encoder_t *e, bool v) {
+    if (e->format == TELEMETRY_FORMAT_CBOR) {
+        uint8_t b = v ? 0xF5 : 0xF4;
+        cbor_put(&e->cbor, &b, 1);
+    } else {
+        json_writer_bool(&e->json, v);
+    }
+}
+
+/**
+ * @brief 编码当前批次
+ * @details 结构：{"device_id","v":1,"delta","t0","count","series":[{"name","fields","t":[...],"values":[...]}]}；
+ *          t 为相对 t0（差值编码时相对上一样本）的秒数，values 按行展开，
+ *          差值编码时每个序列的第一行为原值，之后为与上一行的差
+ * @return 负载指针，缓冲区不足返回NULL
+ */
+static const void *encode_batch(telemetry_batch_t *b, size_t *len) {
+    encoder_t e;
+    memset(&e, 0, sizeof(e));
+    e.format = b->config.format;
+    if (e.format == TELEMETRY_FORMAT_CBOR) {
+        e.cbor.buf = b->buf;
+        e.cbor.cap = b->buf_cap;
+    } else {
+        json_writer_init(&e.json, (char *)b->buf, b->buf_cap);
+    }
+
+    size_t used[TELEMETRY_BATCH_MAX_SERIES] = {0};
+    size_t used_series = 0;
+    for (size_t i = 0; i < b->sample_count; i++) {
+        if (used[b->samples[i].series]++ == 0) {
+            used_series++;
+        }
+    }
+    uint32_t t0 = b->samples[0].timestamp;
+    bool delta = b->config.delta;
+
+    enc_map(&e, b->device_id[0] ? 6 : 5);
+    if (b->device_id[0]) {
+        enc_key(&e, "device_id");
+        enc_text(&e, b->device_id);
+    }
+    enc_key(&e, "v");
+    enc_int(&e, 1);
+    enc_key(&e, "delta");
+    enc_bool(&e, delta);
+    enc_key(&e, "t0");
+    enc_int(&e, t0);
+    enc_key(&e, "count");
+    enc_int(&e, (int64_t)b->sample_count);
+    enc_key(&e, "series");
+    enc_array(&e, used_series);
+
+    for (size_t s = 0; s < b->series_count; s++) {
+        if (used[s] == 0) {
+            continue;
+        }
+        const series_t *series = &b->series[s];
+        enc_map(&e, 4);
+        enc_key(&e, "name");
+        enc_text(&e, series->name);
+        enc_key(&e, "fields");
+        enc_array(&e, series->field_count);
+        for (size_t f = 0; f < series->field_count; f++) {
+            enc_text(&e, series->fields[f]);
+        }
+        enc_array_end(&e);
+
+        enc_key(&e, "t");
+        enc_array(&e, used[s]);
+        int64_t prev_t = t0;
+        for (size_t i = 0; i < b->sample_count; i++) {
+            if (b->samples[i].series != s) {
+                continue;
+            }
+            int64_t t = b->samples[i].timestamp;
+            enc_int(&e, t - prev_t);
+            if (delta) {
+                prev_t = t;
+            }
+        }
+        enc_array_end(&e);
+
+        enc_key(&e, "values");
+        enc_array(&e, used[s] * series->field_count);
+        const sample_t *prev = NULL;
+        for (size_t i = 0; i < b->sample_count; i++) {
+            const sample_t *sample = &b->samples[i];
+            if (sample->series != s) {
+                continue;
+            }
+            for (size_t f = 0; f < series->field_count; f++) {
+                int64_t v = sample->values[f];
+                enc_int(&e, delta && prev ? v - prev->values[f] : v);
+            }
+            prev = sample;
+        }
+        enc_array_end(&e);
+        enc_map_end(&e);
+    }
+    enc_array_end(&e);
+    enc_map_end(&e);
+
+    if (e.format == TELEMETRY_FORMAT_CBOR) {
+        if (e.cbor.overflow) {
+            return NULL;
+        }
+        *len = e.cbor.len;
+        return e.cbor.buf;
+    }
+    return json_writer_finish(&e.json, len);
+}
+
+// ==================== API 函数实现 ====================
+
+void telemetry_batch_default_config(telemetry_batch_config_t *config) {
+    if (!config) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->window_ms = TELEMETRY_BATCH_DEFAULT_WINDOW_MS;
+    config->max_samples = TELEMETRY_BATCH_DEFAULT_MAX_SAMPLES;
+    config->max_bytes = TELEMETRY_BATCH_DEFAULT_MAX_BYTES;
+    config->format = TELEMETRY_FORMAT_JSON;
+    config->delta = true;
+}
+
+telemetry_batch_t *telemetry_batch_create(const telemetry_batch_config_t *config,
+                                          telemetry_batch_flush_cb flush_cb, void *user_data) {
+    if (!flush_cb) {
+        return NULL;
+    }
+    telemetry_batch_t *b = (telemetry_batch_t *)calloc(1, sizeof(telemetry_batch_t));
+    if (!b) {
+        return NULL;
+    }
+
+    telemetry_batch_default_config(&b->config);
+    if (config) {
+        if (config->window_ms) b->config.window_ms = config->window_ms;
+        if (config->max_samples) b->config.max_samples = config->max_samples;
+        if (config->max_bytes) b->config.max_bytes = config->max_bytes;
+        b->config.format = config->format;
+        b->config.delta = config->delta;
+        if (config->device_id) {
+            strncpy(b->device_id, config->device_id, sizeof(b->device_id) - 1);
+        }
+    }
+    if (b->config.max_bytes < MIN_MAX_BYTES) {
+        b->config.max_bytes = MIN_MAX_BYTES;
+    }
+    b->config.device_id = b->device_id;
+    b->header_bytes = strlen(b->device_id) + 16;
+    b->flush_cb = flush_cb;
+    b->user_data = user_data;
+
+    b->samples = (sample_t *)calloc(b->config.max_samples, sizeof(sample_t));
+    if (!b->samples) {
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+void telemetry_batch_destroy(telemetry_batch_t *batch) {
+    if (!batch) {
+        return;
+    }
+    free(batch->samples);
+    free(batch->buf);
+    free(batch);
+}
+
+int telemetry_batch_add_series(telemetry_batch_t *batch, const char *name,
+                               const char *const *fields, size_t field_count) {
+    if (!batch || !name || !name[0] || strlen(name) >= TELEMETRY_BATCH_NAME_MAX ||
+        field_count > TELEMETRY_BATCH_MAX_FIELDS || (field_count > 0 && !fields) ||
+        batch->series_count >= TELEMETRY_BATCH_MAX_SERIES) {
+        return -1;
+    }
+    series_t *series = &batch->series[batch->series_count];
+    memset(series, 0, sizeof(*series));
+    strcpy(series->name, name);
+    // 每个序列的固定键："name" "fields" "t" "values" 及括号、引号、分隔符
+    size_t bytes = strlen(name) + 40;
+    for (size_t i = 0; i < field_count; i++) {
+        if (!fields[i] || strlen(fields[i]) >= TELEMETRY_BATCH_NAME_MAX) {
+            return -1;
+        }
+        strcpy(series->fields[i], fields[i]);
+        bytes += strlen(fields[i]) + 3;
+    }
+    series->field_count = field_count;
+    batch->header_bytes += bytes;
+    return (int)batch->series_count++;
+}
+
+int telemetry_batch_add(telemetry_batch_t *batch, int series, uint32_t timestamp, const int32_t *values) {
+    if (!batch || series < 0 || (size_t)series >= batch->series_count) {
+        return -1;
+    }
+    const series_t *s = &batch->series[series];
+    if (s->field_count > 0 && !values) {
+        return -1;
+    }
+
+    // 时间戳一个、字段值若干，每个数值最多 VALUE_MAX_BYTES 字节
+    size_t estimate = (1 + s->field_count) * VALUE_MAX_BYTES;
+    if (batch->sample_count > 0 && batch->sample_bytes + estimate > batch->config.max_bytes) {
+        telemetry_batch_flush(batch);
+    }
+
+    sample_t *sample = &batch->samples[batch->sample_count];
+    sample->series = (uint8_t)series;
+    sample->timestamp = timestamp;
+    if (s->field_count > 0) {
+        memcpy(sample->values, values, s->field_count * sizeof(int32_t));
+    }
+    if (batch->sample_count == 0) {
+        batch->window_start_ms = now_ms();
+    }
+    batch->sample_count++;
+    batch->sample_bytes += estimate;
+    batch->stats.samples++;
+
+    if (batch->sample_count >= batch->config.max_samples) {
+        telemetry_batch_flush(batch);
+    }
+    return 0;
+}
+
+void telemetry_batch_poll(telemetry_batch_t *batch) {
+    if (!batch || batch->sample_count == 0) {
+        return;
+    }
+    if (now_ms() - batch->window_start_ms >= batch->config.window_ms) {
+        telemetry_batch_flush(batch);
+    }
+}
+
+size_t telemetry_batch_flush(telemetry_batch_t *batch) {
+    if (!batch || batch->sample_count == 0) {
+        return 0;
+    }
+
+    size_t count = batch->sample_count;
+    size_t need = batch->config.max_bytes + batch->header_bytes + HEADER_RESERVE;
+    if (batch->buf_cap < need) {
+        uint8_t *buf = (uint8_t *)realloc(batch->buf, need);
+        if (buf) {
+            batch->buf = buf;
+            batch->buf_cap = need;
+        }
+    }
+
+    size_t len = 0;
+    const void *payload = batch->buf ? encode_batch(batch, &len) : NULL;
+    if (payload) {
+        batch->stats.batches++;
+        batch->stats.bytes += len;
+    } else {
+        batch->stats.dropped += count;
+    }
+
+    // 负载位于编码缓冲区，回调中不能再调用聚合器
+    batch->sample_count = 0;
+    batch->sample_bytes = 0;
+    if (payload) {
+        batch->flush_cb(payload, len, batch->config.format, count, batch->user_data);
+    }
+    return count;
+}
+
+void telemetry_batch_get_stats(const telemetry_batch_t *batch, telemetry_batch_stats_t *stats) {
+    if (!batch || !stats) {
+        return;
+    }
+    *stats = batch->stats;
+}
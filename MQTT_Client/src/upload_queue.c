@@ -0,0 +1,801 @@
+#define _GNU_SOURCE
+#include "upload_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+// ==================== 内部类型 ====================
+
+/**
+ * @brief 文件标识，改写文件会改变 mtime/size，从而得到新的标识
+ */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    int64_t mtime_ns;
+    int64_t size;
+} file_key_t;
+
+typedef struct {
+    bool used;
+    bool in_flight;
+    upload_job_t job;
+} queue_slot_t;
+
+struct upload_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    queue_slot_t *slots;
+    size_t capacity;
+    size_t count;                               // 已用槽位（待上传 + 上传中）
+    uint64_t next_id;
+    bool shutdown;
+
+    file_key_t done[UPLOAD_QUEUE_DONE_HISTORY]; // 最近完成的文件，环形
+    size_t done_count;
+    size_t done_next;
+    int64_t watermark_ns;                       // 已完成文件的最大 mtime
+    int64_t scan_floor_ns;                      // 目录中 mtime 不超过此值的文件都已入队或完成
+    bool scan_floor_set;
+    uint64_t scan_floor_gen;                    // 下调次数，扫描期间有下调则不上调
+
+    char journal_path[UPLOAD_QUEUE_PATH_MAX];
+    int journal_fd;
+    size_t journal_records;
+
+    upload_queue_stats_t stats;
+
+    // 目录监视
+    pthread_t watch_thread;
+    bool watching;
+    int inotify_fd;
+    int wake_pipe[2];
+    bool rescan_needed;                         // 扫描时队列已满，队列回落后补扫
+    char watch_dir[UPLOAD_QUEUE_PATH_MAX];
+    char suffix[16];
+};
+
+// ==================== 内部函数声明 ====================
+
+/**
+ * @brief 追加一条日志记录
+ */
+static void journal_append(upload_queue_t *q, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief 以当前队列内容重写日志
+ */
+static void journal_compact(upload_queue_t *q);
+
+/**
+ * @brief 启动时回放日志
+ */
+static void journal_replay(upload_queue_t *q);
+
+// ==================== 内部函数实现 ====================
+
+static int64_t stat_mtime_ns(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static file_key_t job_key(const upload_job_t *job) {
+    file_key_t key = { job->dev, job->ino, job->mtime_ns, job->size };
+    return key;
+}
+
+static bool key_equal(const file_key_t *a, const file_key_t *b) {
+    return a->dev == b->dev && a->ino == b->ino && a->mtime_ns == b->mtime_ns && a->size == b->size;
+}
+
+static bool done_contains(const upload_queue_t *q, const file_key_t *key) {
+    for (size_t i = 0; i < q->done_count; i++) {
+        if (key_equal(&q->done[i], key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void done_add(upload_queue_t *q, const file_key_t *key) {
+    q->done[q->done_next] = *key;
+    q->done_next = (q->done_next + 1) % UPLOAD_QUEUE_DONE_HISTORY;
+    if (q->done_count < UPLOAD_QUEUE_DONE_HISTORY) {
+        q->done_count++;
+    }
+    if (key->mtime_ns > q->watermark_ns) {
+        q->watermark_ns = key->mtime_ns;
+    }
+}
+
+static queue_slot_t *find_slot_by_inode(upload_queue_t *q, dev_t dev, ino_t ino, bool in_flight) {
+    for (size_t i = 0; i < q->capacity; i++) {
+        queue_slot_t *slot = &q->slots[i];
+        if (slot->used && slot->in_flight == in_flight && slot->job.dev == dev && slot->job.ino == ino) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static queue_slot_t *find_free_slot(upload_queue_t *q) {
+    for (size_t i = 0; i < q->capacity; i++) {
+        if (!q->slots[i].used) {
+            return &q->slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 被挤出或未能入队的文件需要在补扫时重新发现，下调扫描下限
+ */
+static void lower_scan_floor(upload_queue_t *q, int64_t mtime_ns);
+
+static void free_slot(upload_queue_t *q, queue_slot_t *slot) {
+    slot->used = false;
+    slot->in_flight = false;
+    q->count--;
+}
+
+static void journal_append(upload_queue_t *q, const char *format, ...) {
+    if (q->journal_fd < 0) {
+        return;
+    }
+
+    char line[UPLOAD_QUEUE_PATH_MAX + 128];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len <= 0 || (size_t)len >= sizeof(line)) {
+        return;
+    }
+
+    // O_APPEND 下单次 write 即一条完整记录
+    if (write(q->journal_fd, line, (size_t)len) != len) {
+        fprintf(stderr, "upload_queue: journal write failed: %s\n", strerror(errno));
+        return;
+    }
+    q->journal_records++;
+    if (q->journal_records > 4 * (q->capacity + UPLOAD_QUEUE_DONE_HISTORY)) {
+        journal_compact(q);
+    }
+}
+
+static void journal_write_add(upload_queue_t *q, const upload_job_t *job) {
+    journal_append(q, "+ %d %llu %llu %lld %lld %s\n", (int)job->priority,
+                   (unsigned long long)job->dev, (unsigned long long)job->ino,
+                   (long long)job->mtime_ns, (long long)job->size, job->path);
+}
+
+static void journal_write_remove(upload_queue_t *q, char op, const file_key_t *key) {
+    journal_append(q, "%c %llu %llu %lld %lld\n", op,
+                   (unsigned long long)key->dev, (unsigned long long)key->ino,
+                   (long long)key->mtime_ns, (long long)key->size);
+}
+
+static void lower_scan_floor(upload_queue_t *q, int64_t mtime_ns) {
+    q->scan_floor_gen++;
+    if (mtime_ns - 1 < q->scan_floor_ns) {
+        q->scan_floor_ns = mtime_ns - 1;
+        journal_append(q, "f %lld\n", (long long)q->scan_floor_ns);
+    }
+}
+
+static void journal_compact(upload_queue_t *q) {
+    if (q->journal_path[0] == '\0') {
+        return;
+    }
+
+    char tmp_path[UPLOAD_QUEUE_PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", q->journal_path);
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        fprintf(stderr, "upload_queue: cannot write %s: %s\n", tmp_path, strerror(errno));
+        return;
+    }
+
+    fprintf(file, "f %lld\n", (long long)q->scan_floor_ns);
+    size_t records = 1;
+    // 完成记录按时间顺序写出，回放后环形缓冲与当前一致
+    for (size_t i = 0; i < q->done_count; i++) {
+        size_t index = (q->done_next + UPLOAD_QUEUE_DONE_HISTORY - q->done_count + i) % UPLOAD_QUEUE_DONE_HISTORY;
+        const file_key_t *key = &q->done[index];
+        fprintf(file, "- %llu %llu %lld %lld\n", (unsigned long long)key->dev, (unsigned long long)key->ino,
+                (long long)key->mtime_ns, (long long)key->size);
+        records++;
+    }
+    for (size_t i = 0; i < q->capacity; i++) {
+        const queue_slot_t *slot = &q->slots[i];
+        if (!slot->used) {
+            continue;
+        }
+        const upload_job_t *job = &slot->job;
+        fprintf(file, "+ %d %llu %llu %lld %lld %s\n", (int)job->priority,
+                (unsigned long long)job->dev, (unsigned long long)job->ino,
+                (long long)job->mtime_ns, (long long)job->size, job->path);
+        records++;
+    }
+
+    bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!ok || rename(tmp_path, q->journal_path) != 0) {
+        fprintf(stderr, "upload_queue: compact %s failed: %s\n", q->journal_path, strerror(errno));
+        unlink(tmp_path);
+        return;
+    }
+
+    if (q->journal_fd >= 0) {
+        close(q->journal_fd);
+    }
+    q->journal_fd = open(q->journal_path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    q->journal_records = records;
+}
+
+static void journal_replay(upload_queue_t *q) {
+    FILE *file = fopen(q->journal_path, "r");
+    if (!file) {
+        return;
+    }
+
+    char line[UPLOAD_QUEUE_PATH_MAX + 128];
+    while (fgets(line, sizeof(line), file)) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            // 掉电时最后一条可能不完整
+            continue;
+        }
+        line[len - 1] = '\0';
+
+        unsigned long long dev, ino;
+        long long mtime_ns, size;
+        int priority, offset = 0;
+        if (line[0] == '+' &&
+            sscanf(line, "+ %d %llu %llu %lld %lld %n", &priority, &dev, &ino, &mtime_ns, &size, &offset) == 5 &&
+            offset > 0 && line[offset] != '\0') {
+            // 同一 inode 以最新一条为准
+            queue_slot_t *slot = find_slot_by_inode(q, (dev_t)dev, (ino_t)ino, false);
+            if (!slot) {
+                slot = find_free_slot(q);
+                if (!slot) {
+                    continue;
+                }
+                slot->used = true;
+                q->count++;
+            }
+            upload_job_t *job = &slot->job;
+            memset(job, 0, sizeof(*job));
+            job->id = q->next_id++;
+            strncpy(job->path, line + offset, sizeof(job->path) - 1);
+            job->priority = priority < UPLOAD_PRIORITY_LOW ? UPLOAD_PRIORITY_LOW :
+                            priority > UPLOAD_PRIORITY_HIGH ? UPLOAD_PRIORITY_HIGH : (upload_priority_t)priority;
+            job->dev = (dev_t)dev;
+            job->ino = (ino_t)ino;
+            job->mtime_ns = mtime_ns;
+            job->size = size;
+        } else if ((line[0] == '-' || line[0] == 'x') &&
+                   sscanf(line + 1, " %llu %llu %lld %lld", &dev, &ino, &mtime_ns, &size) == 4) {
+            file_key_t key = { (dev_t)dev, (ino_t)ino, mtime_ns, size };
+            queue_slot_t *slot = find_slot_by_inode(q, key.dev, key.ino, false);
+            if (slot) {
+                file_key_t slot_key = job_key(&slot->job);
+                if (key_equal(&slot_key, &key)) {
+                    free_slot(q, slot);
+                }
+            }
+            if (line[0] == '-') {
+                done_add(q, &key);
+            }
+        } else if (line[0] == 'f' && sscanf(line + 1, " %lld", &mtime_ns) == 1) {
+            q->scan_floor_ns = mtime_ns;
+            q->scan_floor_set = true;
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * @brief 判断文件名后缀
+ */
+static bool name_matches(const upload_queue_t *q, const char *name) {
+    if (name[0] == '.') {
+        return false;
+    }
+    if (q->suffix[0] == '\0') {
+        return true;
+    }
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(q->suffix);
+    return len > suffix_len && strcasecmp(name + len - suffix_len, q->suffix) == 0;
+}
+
+/**
+ * @brief 扫描监视目录，入队比水位线新的文件
+ */
+static void scan_directory(upload_queue_t *q) {
+    DIR *dir = opendir(q->watch_dir);
+    if (!dir) {
+        fprintf(stderr, "upload_queue: cannot open %s: %s\n", q->watch_dir, strerror(errno));
+        return;
+    }
+
+    pthread_mutex_lock(&q->mutex);
+    int64_t floor_ns = q->scan_floor_ns;
+    uint64_t floor_gen = q->scan_floor_gen;
+    q->rescan_needed = false;
+    pthread_mutex_unlock(&q->mutex);
+
+    size_t queued = 0;
+    bool complete = true;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!name_matches(q, entry->d_name)) {
+            continue;
+        }
+        char path[UPLOAD_QUEUE_PATH_MAX];
+        if (snprintf(path, sizeof(path), "%s/%s", q->watch_dir, entry->d_name) >= (int)sizeof(path)) {
+            continue;
+        }
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || stat_mtime_ns(&st) <= floor_ns) {
+            continue;
+        }
+        upload_queue_result_t rc = upload_queue_push(q, path, UPLOAD_PRIORITY_LOW, false);
+        if (rc == UPLOAD_QUEUE_OK) {
+            queued++;
+        } else if (rc == UPLOAD_QUEUE_FULL) {
+            pthread_mutex_lock(&q->mutex);
+            q->rescan_needed = true;
+            pthread_mutex_unlock(&q->mutex);
+            complete = false;
+            break;
+        }
+    }
+    closedir(dir);
+
+    // 完整扫过且期间没有文件被挤出：比已完成文件更旧的都已入队或完成
+    pthread_mutex_lock(&q->mutex);
+    if (complete && floor_gen == q->scan_floor_gen && q->watermark_ns > q->scan_floor_ns) {
+        q->scan_floor_ns = q->watermark_ns;
+        journal_append(q, "f %lld\n", (long long)q->scan_floor_ns);
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    if (queued > 0) {
+        printf("upload_queue: queued %zu backlog files from %s\n", queued, q->watch_dir);
+    }
+}
+
+static void *watch_thread_main(void *arg) {
+    upload_queue_t *q = (upload_queue_t *)arg;
+    // 先建立监视再扫描，扫描期间写入的文件不会遗漏（重复的由去重过滤）
+    scan_directory(q);
+
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        { .fd = q->inotify_fd, .events = POLLIN },
+        { .fd = q->wake_pipe[0], .events = POLLIN }
+    };
+
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char cmd = 0;
+            if (read(q->wake_pipe[0], &cmd, 1) <= 0 || cmd == 'q') {
+                break;
+            }
+            // 'r'：队列已回落，补扫积压
+            scan_directory(q);
+        }
+
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        ssize_t len;
+        while ((len = read(q->inotify_fd, buffer, sizeof(buffer))) > 0) {
+            for (char *p = buffer; p < buffer + len; ) {
+                const struct inotify_event *event = (const struct inotify_event *)p;
+                p += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // 事件丢失，按水位线重扫
+                    scan_directory(q);
+                    continue;
+                }
+                if ((event->mask & IN_ISDIR) || event->len == 0 || !name_matches(q, event->name)) {
+                    continue;
+                }
+                char path[UPLOAD_QUEUE_PATH_MAX];
+                if (snprintf(path, sizeof(path), "%s/%s", q->watch_dir, event->name) >= (int)sizeof(path)) {
+                    continue;
+                }
+                upload_queue_result_t rc = upload_queue_push(q, path, UPLOAD_PRIORITY_NORMAL, false);
+                if (rc == UPLOAD_QUEUE_FULL) {
+                    struct stat st;
+                    pthread_mutex_lock(&q->mutex);
+                    q->rescan_needed = true;
+                    if (stat(path, &st) == 0) {
+                        lower_scan_floor(q, stat_mtime_ns(&st));
+                    }
+                    pthread_mutex_unlock(&q->mutex);
+                    fprintf(stderr, "upload_queue: queue full, %s deferred\n", path);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+// ==================== API 函数实现 ====================
+
+upload_queue_t *upload_queue_create(const char *journal_path, size_t capacity) {
+    upload_queue_t *q = (upload_queue_t *)calloc(1, sizeof(upload_queue_t));
+    if (!q) {
+        return NULL;
+    }
+
+    q->capacity = capacity ? capacity : UPLOAD_QUEUE_DEFAULT_CAPACITY;
+    q->slots = (queue_slot_t *)calloc(q->capacity, sizeof(queue_slot_t));
+    if (!q->slots) {
+        free(q);
+        return NULL;
+    }
+    q->next_id = 1;
+    q->journal_fd = -1;
+    q->inotify_fd = -1;
+    q->wake_pipe[0] = q->wake_pipe[1] = -1;
+
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (journal_path) {
+        strncpy(q->journal_path, journal_path, sizeof(q->journal_path) - 1);
+        journal_replay(q);
+        if (!q->scan_floor_set) {
+            q->scan_floor_ns = q->watermark_ns;
+        }
+        // 回放后立即压缩，同时创建日志文件
+        journal_compact(q);
+        if (q->journal_fd < 0) {
+            fprintf(stderr, "upload_queue: journal %s unavailable, queue is not persistent\n", journal_path);
+        }
+        if (q->count > 0) {
+            printf("upload_queue: restored %zu pending uploads from %s\n", q->count, journal_path);
+        }
+    }
+    q->stats.pending = q->count;
+
+    return q;
+}
+
+void upload_queue_destroy(upload_queue_t *queue) {
+    if (!queue) {
+        return;
+    }
+
+    upload_queue_unwatch(queue);
+    if (queue->journal_fd >= 0) {
+        close(queue->journal_fd);
+    }
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->slots);
+    free(queue);
+}
+
+upload_queue_result_t upload_queue_push(upload_queue_t *queue, const char *path, upload_priority_t priority, bool force) {
+    if (!queue || !path || strlen(path) >= UPLOAD_QUEUE_PATH_MAX) {
+        return UPLOAD_QUEUE_ERR_PARAM;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return UPLOAD_QUEUE_ERR_FILE;
+    }
+    file_key_t key = { st.st_dev, st.st_ino, stat_mtime_ns(&st), (int64_t)st.st_size };
+
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->shutdown) {
+        pthread_mutex_unlock(&queue->mutex);
+        return UPLOAD_QUEUE_ERR_PARAM;
+    }
+
+    // 正在上传同一内容
+    queue_slot_t *active = find_slot_by_inode(queue, key.dev, key.ino, true);
+    if (active) {
+        file_key_t active_key = job_key(&active->job);
+        if (key_equal(&active_key, &key)) {
+            queue->stats.duplicates++;
+            pthread_mutex_unlock(&queue->mutex);
+            return UPLOAD_QUEUE_DUPLICATE;
+        }
+    }
+
+    // 已在等待：相同内容只提升优先级，文件被改写则更新为新内容
+    queue_slot_t *slot = find_slot_by_inode(queue, key.dev, key.ino, false);
+    if (slot) {
+        file_key_t slot_key = job_key(&slot->job);
+        bool same = key_equal(&slot_key, &key);
+        bool raised = priority > slot->job.priority;
+        if (raised) {
+            slot->job.priority = priority;
+        }
+        if (!same) {
+            slot->job.mtime_ns = key.mtime_ns;
+            slot->job.size = key.size;
+            strncpy(slot->job.path, path, sizeof(slot->job.path) - 1);
+        }
+        if (!same || raised) {
+            journal_write_add(queue, &slot->job);
+        }
+        queue->stats.duplicates += same ? 1 : 0;
+        pthread_mutex_unlock(&queue->mutex);
+        return same ? UPLOAD_QUEUE_DUPLICATE : UPLOAD_QUEUE_OK;
+    }
+
+    if (!force && done_contains(queue, &key)) {
+        queue->stats.duplicates++;
+        pthread_mutex_unlock(&queue->mutex);
+        return UPLOAD_QUEUE_DUPLICATE;
+    }
+
+    slot = find_free_slot(queue);
+    if (!slot) {
+        // 队列已满：替换优先级更低的任务中最晚入队的一个
+        queue_slot_t *victim = NULL;
+        for (size_t i = 0; i < queue->capacity; i++) {
+            queue_slot_t *s = &queue->slots[i];
+            if (!s->used || s->in_flight || s->job.priority >= priority) {
+                continue;
+            }
+            if (!victim || s->job.priority < victim->job.priority ||
+                (s->job.priority == victim->job.priority && s->job.id > victim->job.id)) {
+                victim = s;
+            }
+        }
+        if (!victim) {
+            pthread_mutex_unlock(&queue->mutex);
+            return UPLOAD_QUEUE_FULL;
+        }
+        file_key_t victim_key = job_key(&victim->job);
+        fprintf(stderr, "upload_queue: queue full, evicting %s\n", victim->job.path);
+        journal_write_remove(queue, 'x', &victim_key);
+        lower_scan_floor(queue, victim_key.mtime_ns);
+        free_slot(queue, victim);
+        queue->stats.evicted++;
+        queue->rescan_needed = true;
+        slot = victim;
+    }
+
+    slot->used = true;
+    slot->in_flight = false;
+    upload_job_t *job = &slot->job;
+    memset(job, 0, sizeof(*job));
+    job->id = queue->next_id++;
+    strncpy(job->path, path, sizeof(job->path) - 1);
+    job->priority = priority;
+    job->dev = key.dev;
+    job->ino = key.ino;
+    job->mtime_ns = key.mtime_ns;
+    job->size = key.size;
+    queue->count++;
+    queue->stats.enqueued++;
+    journal_write_add(queue, job);
+
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+    return UPLOAD_QUEUE_OK;
+}
+
+bool upload_queue_pop(upload_queue_t *queue, upload_job_t *job, int timeout_ms) {
+    if (!queue || !job) {
+        return false;
+    }
+
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    while (!queue->shutdown) {
+        queue_slot_t *best = NULL;
+        for (size_t i = 0; i < queue->capacity; i++) {
+            queue_slot_t *s = &queue->slots[i];
+            if (!s->used || s->in_flight) {
+                continue;
+            }
+            if (!best || s->job.priority > best->job.priority ||
+                (s->job.priority == best->job.priority && s->job.id < best->job.id)) {
+                best = s;
+            }
+        }
+        if (best) {
+            best->in_flight = true;
+            *job = best->job;
+            pthread_mutex_unlock(&queue->mutex);
+            return true;
+        }
+
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&queue->cond, &queue->mutex);
+        } else if (pthread_cond_timedwait(&queue->cond, &queue->mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return false;
+}
+
+void upload_queue_complete(upload_queue_t *queue, const upload_job_t *job, bool success) {
+    if (!queue || !job) {
+        return;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    queue_slot_t *slot = NULL;
+    for (size_t i = 0; i < queue->capacity; i++) {
+        if (queue->slots[i].used && queue->slots[i].in_flight && queue->slots[i].job.id == job->id) {
+            slot = &queue->slots[i];
+            break;
+        }
+    }
+    if (!slot) {
+        pthread_mutex_unlock(&queue->mutex);
+        return;
+    }
+
+    file_key_t key = job_key(&slot->job);
+    struct stat st;
+    bool exists = stat(slot->job.path, &st) == 0;
+    if (success) {
+        done_add(queue, &key);
+        journal_write_remove(queue, '-', &key);
+        free_slot(queue, slot);
+        queue->stats.completed++;
+    } else if (!exists || ++slot->job.attempts >= UPLOAD_QUEUE_MAX_ATTEMPTS) {
+        fprintf(stderr, "upload_queue: giving up on %s after %d attempts\n", slot->job.path, slot->job.attempts);
+        journal_write_remove(queue, 'x', &key);
+        free_slot(queue, slot);
+        queue->stats.failed++;
+    } else {
+        // 重新排到同优先级队尾
+        slot->in_flight = false;
+        slot->job.id = queue->next_id++;
+        pthread_cond_signal(&queue->cond);
+    }
+
+    bool rescan = queue->rescan_needed && queue->watching && queue->count < queue->capacity / 2;
+    if (rescan) {
+        queue->rescan_needed = false;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (rescan) {
+        char cmd = 'r';
+        if (write(queue->wake_pipe[1], &cmd, 1) != 1) {
+            fprintf(stderr, "upload_queue: wake watcher failed: %s\n", strerror(errno));
+        }
+    }
+}
+
+void upload_queue_shutdown(upload_queue_t *queue) {
+    if (!queue) {
+        return;
+    }
+    pthread_mutex_lock(&queue->mutex);
+    queue->shutdown = true;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void upload_queue_get_stats(upload_queue_t *queue, upload_queue_stats_t *stats) {
+    if (!queue || !stats) {
+        return;
+    }
+    pthread_mutex_lock(&queue->mutex);
+    *stats = queue->stats;
+    stats->pending = 0;
+    stats->in_flight = 0;
+    for (size_t i = 0; i < queue->capacity; i++) {
+        if (queue->slots[i].used) {
+            if (queue->slots[i].in_flight) {
+                stats->in_flight++;
+            } else {
+                stats->pending++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+int upload_queue_watch_dir(upload_queue_t *queue, const char *directory, const char *suffix) {
+    if (!queue || !directory || queue->watching) {
+        return -1;
+    }
+
+    strncpy(queue->watch_dir, directory, sizeof(queue->watch_dir) - 1);
+    queue->suffix[0] = '\0';
+    if (suffix) {
+        strncpy(queue->suffix, suffix, sizeof(queue->suffix) - 1);
+    }
+
+    queue->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (queue->inotify_fd < 0) {
+        fprintf(stderr, "upload_queue: inotify_init1 failed: %s\n", strerror(errno));
+        return -1;
+    }
+    if (inotify_add_watch(queue->inotify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "upload_queue: watch %s failed: %s\n", directory, strerror(errno));
+        close(queue->inotify_fd);
+        queue->inotify_fd = -1;
+        return -1;
+    }
+    if (pipe2(queue->wake_pipe, O_CLOEXEC) != 0) {
+        close(queue->inotify_fd);
+        queue->inotify_fd = -1;
+        return -1;
+    }
+
+    queue->watching = true;
+    if (pthread_create(&queue->watch_thread, NULL, watch_thread_main, queue) != 0) {
+        queue->watching = false;
+        close(queue->inotify_fd);
+        close(queue->wake_pipe[0]);
+        close(queue->wake_pipe[1]);
+        queue->inotify_fd = -1;
+        queue->wake_pipe[0] = queue->wake_pipe[1] = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void upload_queue_unwatch(upload_queue_t *queue) {
+    if (!queue || !queue->watching) {
+        return;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->watching = false;
+    pthread_mutex_unlock(&queue->mutex);
+
+    char cmd = 'q';
+    if (write(queue->wake_pipe[1], &cmd, 1) == 1) {
+        pthread_join(queue->watch_thread, NULL);
+    } else {
+        pthread_cancel(queue->watch_thread);
+        pthread_join(queue->watch_thread, NULL);
+    }
+    close(queue->inotify_fd);
+    close(queue->wake_pipe[0]);
+    close(queue->wake_pipe[1]);
+    queue->inotify_fd = -1;
+    queue->wake_pipe[0] = queue->wake_pipe[1] = -1;
+}
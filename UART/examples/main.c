@@ -6,8 +6,10 @@
 #include "air8000.h"              /* Air8000 主头文件 */
 #include "air8000_file_transfer.h" /* 文件传输功能头文件 */
 #include "air8000_fota.h"          /* FOTA升级功能头文件 */
-// 暂时注释掉图片处理头文件
-// #include "air8000_image_process.h" /* 图片处理头文件 */
+#include "air8000_trace.h"         /* 串口原始数据跟踪 */
+#ifdef AIR8000_IMAGE_PROCESS
+#include "air8000_image_process.h" /* 图片处理头文件（make IMAGE_PROCESS=1） */
+#endif
 #include <stdio.h>           /* 标准输入输出 */
 #include <stdlib.h>          /* 标准库函数 */
 #include <string.h>          /* 字符串处理函数 */
@@ -20,19 +22,43 @@
 #include <signal.h>          /* 信号处理函数 */
 #include <time.h>            /* 时间函数 */
 #include "message_queue.h" /* 消息队列头文件 */
+#include "process_manager.h" /* 就绪通知 */
+#include "pm_metrics.h" /* 共享内存指标 */
+#include "pm_sched.h" /* 调度配置 */
+#include "fota_relay.h"    /* FOTA 流式转发通道 */
 
 #define DEFAULT_DEVICE "/dev/ttyACM2"  /* 默认串口设备路径 */
 #define DEFAULT_TIMEOUT 2000           /* 默认超时时间，单位毫秒 */
+#define FOTA_RELAY_STALL_MS 120000     /* 流式升级等待下一条转发记录的超时，覆盖服务器补发缺失分片的时间 */
+#define TELEMETRY_PERIOD_MS 100        /* 遥测订阅上报周期，单位毫秒 */
+#define TELEMETRY_STALE_MS 1000        /* 遥测快照超过该时间未更新时回退为请求/响应读取 */
 
 /**
  * @brief 全局变量
  */
 static volatile bool running = true;                /* 运行标志 */
+static volatile sig_atomic_t dump_trace = 0;        /* 收到 SIGUSR1 后导出串口跟踪环 */
 static air8000_t *g_ctx = NULL;                     /* Air8000上下文 */
 static int g_mq_uart_to_mqtt = -1;                /* UART到MQTT的消息队列 */
 static int g_mq_mqtt_to_uart = -1;                /* MQTT到UART的消息队列 */
 static uint32_t g_seq_num = 0;                      /* 序列号计数器 */
 
+/**
+ * @brief 流式升级数据源状态
+ */
+typedef struct {
+    fota_relay_t relay;          /* 转发通道（首次流式升级时打开） */
+    uint32_t session;            /* 当前会话号 */
+    uint32_t firmware_size;      /* 固件总大小 */
+    char path[FOTA_RELAY_PATH_MAX]; /* 固件文件路径 */
+    const uint8_t *data;         /* 当前 DATA 记录中尚未交付的数据 */
+    size_t data_len;             /* 尚未交付的长度 */
+    uint32_t offset;             /* 已交付的字节数 */
+    int result;                  /* 0 进行中，1 收到 END，-1 中止 */
+} relay_source_t;
+
+static relay_source_t g_relay_src;                  /* 流式升级数据源 */
+
 
 
 
@@ -197,12 +223,15 @@ float to_deg(float rad) {
 /**
  * @brief 信号处理函数
  * @param sig 收到的信号值
- * @details 处理SIGINT和SIGTERM信号，设置running标志为false，退出程序
+ * @details 处理SIGINT和SIGTERM信号，设置running标志为false，退出程序；
+ *          SIGUSR1 请求导出串口跟踪环
  */
 static void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
         running = false;
         printf("\nReceived signal %d, exiting...\n", sig);
+    } else if (sig == SIGUSR1) {
+        dump_trace = 1;  /* 在主循环中导出，信号处理函数里不做 I/O */
     }
 }
 
@@ -222,6 +251,9 @@ static void init_signal_handlers() {
     /* 处理SIGINT和SIGTERM信号 */
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
+    
+    /* SIGUSR1：导出串口跟踪环 (kill -USR1 <pid>) */
+    sigaction(SIGUSR1, &sa, NULL);
 }
 
 /**
@@ -267,6 +299,31 @@ static void get_fota_file_path(char *buffer, size_t buffer_size) {
     snprintf(buffer, buffer_size, "/appfs/nfs/AIR8000.bin");
 }
 
+/**
+ * @brief 向MQTT进程发送FOTA完成通知
+ * @param ret 升级结果
+ */
+static void send_fota_complete(int ret) {
+    message_t complete_msg;
+    memset(&complete_msg, 0, sizeof(complete_msg));
+    complete_msg.type = MSG_TYPE_FOTA_COMPLETE;
+    complete_msg.seq_num = g_seq_num++;
+    complete_msg.timestamp = (uint32_t)time(NULL);
+    complete_msg.data_len = 4; // 简单的结果代码
+    uint32_t result_code = ret; // 使用升级结果作为代码
+    memcpy(complete_msg.payload.data, &result_code, complete_msg.data_len);
+    
+    if (g_mq_uart_to_mqtt != -1) {
+        if (mq_send_msg(g_mq_uart_to_mqtt, &complete_msg, 0) != 0) {
+            perror("mq_send fota complete");
+        } else {
+            printf("Sent FOTA complete notification\n");
+        }
+    } else {
+        printf("Running in standalone mode, skipping FOTA complete notification\n");
+    }
+}
+
 /**
  * @brief 执行FOTA升级
  */
@@ -305,28 +362,162 @@ static void execute_fota_upgrade() {
     printf("FOTA upgrade started successfully\n");
     
     // 升级完成，发送通知
-    message_t complete_msg;
-    memset(&complete_msg, 0, sizeof(complete_msg));
-    complete_msg.type = MSG_TYPE_FOTA_COMPLETE;
-    complete_msg.seq_num = g_seq_num++;
-    complete_msg.timestamp = (uint32_t)time(NULL);
-    complete_msg.data_len = 4; // 简单的结果代码
-    uint32_t result_code = ret; // 使用升级结果作为代码
-    memcpy(complete_msg.payload.data, &result_code, complete_msg.data_len);
+    send_fota_complete(ret);
     
-    if (g_mq_uart_to_mqtt != -1) {
-        if (mq_send_msg(g_mq_uart_to_mqtt, &complete_msg, 0) != 0) {
-            perror("mq_send fota complete");
-        } else {
-            printf("Sent FOTA complete notification\n");
+    // 销毁FOTA上下文
+    air8000_fota_destroy(fota_ctx);
+    printf("FOTA context destroyed\n");
+}
+
+/**
+ * @brief 流式数据源：读取后续固件数据
+ * @details 丢弃其他会话的残留记录；当前会话的 DATA 必须与已交付的字节数衔接
+ */
+static ssize_t relay_source_read(void *user_data, uint8_t *buf, size_t len) {
+    relay_source_t *src = (relay_source_t *)user_data;
+    
+    while (src->data_len == 0) {
+        if (src->result != 0) {
+            return -1;
+        }
+        fota_relay_record_t rec;
+        const uint8_t *body = NULL;
+        ssize_t n = fota_relay_recv(&src->relay, &rec, &body, FOTA_RELAY_STALL_MS);
+        if (n < 0) {
+            printf("[FOTA] relay %s at offset %u\n", n == -2 ? "stalled" : "read failed", src->offset);
+            src->result = -1;
+            return -1;
+        }
+        if (rec.session != src->session) {
+            continue;
+        }
+        if (rec.type == FOTA_RELAY_DATA) {
+            if (rec.offset != src->offset || (size_t)n != rec.length) {
+                printf("[FOTA] relay gap: got offset %u, expected %u\n", rec.offset, src->offset);
+                src->result = -1;
+                return -1;
+            }
+            src->data = body;
+            src->data_len = (size_t)n;
+        } else if (rec.type == FOTA_RELAY_END || rec.type == FOTA_RELAY_ABORT) {
+            // 数据还没交付完就结束，说明下载侧已放弃本次会话
+            printf("[FOTA] relay session %u %s at offset %u\n", src->session,
+                   rec.type == FOTA_RELAY_END ? "ended early" : "aborted", src->offset);
+            src->result = -1;
+            return -1;
+        }
+    }
+    
+    size_t n = len < src->data_len ? len : src->data_len;
+    memcpy(buf, src->data, n);
+    src->data += n;
+    src->data_len -= n;
+    src->offset += (uint32_t)n;
+    return (ssize_t)n;
+}
+
+/**
+ * @brief 流式数据源：等待下载侧校验结果
+ */
+static bool relay_source_verify(void *user_data) {
+    relay_source_t *src = (relay_source_t *)user_data;
+    
+    while (src->result == 0) {
+        fota_relay_record_t rec;
+        ssize_t n = fota_relay_recv(&src->relay, &rec, NULL, FOTA_RELAY_STALL_MS);
+        if (n < 0) {
+            printf("[FOTA] relay verify %s\n", n == -2 ? "timed out" : "read failed");
+            src->result = -1;
+        } else if (rec.session == src->session) {
+            // 全部数据已交付，此时只应出现 END 或 ABORT
+            src->result = rec.type == FOTA_RELAY_END ? 1 : -1;
+        }
+    }
+    return src->result == 1;
+}
+
+/**
+ * @brief 等待转发会话的 START 记录
+ * @param session MQTT进程通知的会话号
+ * @return 找到返回true；遇到更新的会话时改为跟随该会话
+ */
+static bool relay_source_begin(uint32_t session) {
+    relay_source_t *src = &g_relay_src;
+    
+    if (!src->relay.open && fota_relay_open(&src->relay) != 0) {
+        printf("[FOTA] relay channel not available\n");
+        return false;
+    }
+    
+    // 通知到达时转发通道里可能还有上一次未读完的记录，跳到本会话的 START
+    for (;;) {
+        fota_relay_record_t rec;
+        const uint8_t *body = NULL;
+        ssize_t n = fota_relay_recv(&src->relay, &rec, &body, FOTA_RELAY_STALL_MS);
+        if (n < 0) {
+            printf("[FOTA] relay session %u did not start\n", session);
+            return false;
         }
+        if (rec.type != FOTA_RELAY_START || (int32_t)(rec.session - session) < 0 ||
+            (size_t)n < sizeof(fota_relay_start_t)) {
+            continue;
+        }
+        
+        fota_relay_start_t start;
+        memcpy(&start, body, sizeof(start));
+        start.path[sizeof(start.path) - 1] = '\0';
+        src->session = rec.session;
+        src->firmware_size = start.firmware_size;
+        memcpy(src->path, start.path, sizeof(src->path));
+        src->data = NULL;
+        src->data_len = 0;
+        src->offset = 0;
+        src->result = 0;
+        return true;
+    }
+}
+
+/**
+ * @brief 执行流式FOTA升级
+ * @param session MQTT进程通知的会话号
+ * @return 成功返回0，失败返回错误码
+ * @details 固件一边从MQTT下载一边经转发通道送到串口，下载和烧写同时进行
+ */
+static int execute_fota_relay(uint32_t session) {
+    // 通知会话号不晚于已处理的会话：该会话已在上一次跟随时处理过
+    if (g_relay_src.session != 0 && (int32_t)(session - g_relay_src.session) <= 0) {
+        printf("[FOTA] relay session %u already handled\n", session);
+        return AIR8000_OK;
+    }
+    if (!relay_source_begin(session)) {
+        return AIR8000_ERR_IO;
+    }
+    printf("Starting streamed FOTA upgrade to Air8000, session %u, size %u bytes\n",
+           g_relay_src.session, g_relay_src.firmware_size);
+    
+    air8000_fota_source_t source = {
+        .read = relay_source_read,
+        .verify = relay_source_verify,
+        .user_data = &g_relay_src
+    };
+    air8000_fota_ctx_t *fota_ctx = air8000_fota_create_stream(g_ctx, g_relay_src.firmware_size,
+                                                              g_relay_src.path[0] ? g_relay_src.path : NULL,
+                                                              &source, fota_callback, NULL);
+    if (!fota_ctx) {
+        printf("Failed to create FOTA context\n");
+        return AIR8000_ERR_NOMEM;
+    }
+    
+    int ret = air8000_fota_start(fota_ctx);
+    if (ret != AIR8000_OK) {
+        printf("Streamed FOTA upgrade failed: %d\n", ret);
     } else {
-        printf("Running in standalone mode, skipping FOTA complete notification\n");
+        printf("Streamed FOTA upgrade completed\n");
     }
+    send_fota_complete(ret);
     
-    // 销毁FOTA上下文
     air8000_fota_destroy(fota_ctx);
-    printf("FOTA context destroyed\n");
+    return ret;
 }
 
 /**
@@ -367,21 +558,42 @@ static void send_command_response(uint32_t seq_num, int result, const uint8_t *d
     }
 }
 
+/**
+ * @brief 读取所有传感器数据
+ * @param out 输出传感器数据
+ * @return 成功返回0，失败返回错误码
+ * @details 遥测快照足够新时直接使用，不占用串口往返；否则回退为 air8000_sensor_read_all
+ */
+static int read_all_sensors(air8000_sensor_data_t *out) {
+    air8000_telemetry_t snap;
+    if (air8000_telemetry_read(g_ctx, &snap) == 0 && (snap.mask & AIR8000_TELEMETRY_SENSORS)) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now_ms = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+        if (now_ms - snap.host_time_ms < TELEMETRY_STALE_MS) {
+            *out = snap.sensors;
+            return 0;
+        }
+    }
+    return air8000_sensor_read_all(g_ctx, out, DEFAULT_TIMEOUT);
+}
+
 /**
  * @brief 处理从MQTT接收到的控制指令
  */
 static void handle_mqtt_commands() {
     // 检查消息队列是否已初始化
     if (g_mq_mqtt_to_uart == -1) {
-        // 独立运行模式，不处理MQTT命令
+        // 独立运行模式，不处理MQTT命令，休眠一个主循环节拍
+        usleep(100000);
         return;
     }
     
     message_t msg;
     unsigned int priority;
     
-    // 从消息队列接收数据，超时10ms，确保设备控制命令及时处理
-    int ret = mq_receive_msg(g_mq_mqtt_to_uart, &msg, &priority, 10);
+    // 从消息队列接收数据，最多等待100ms：命令到达即返回处理，同时作为主循环节拍
+    int ret = mq_receive_msg(g_mq_mqtt_to_uart, &msg, &priority, 100);
     if (ret == 0) {
         // 成功接收到消息
         printf("[UART] Received command from MQTT, type: %d, seq: %u\n", msg.type, msg.seq_num);
@@ -508,7 +720,7 @@ static void handle_mqtt_commands() {
                     case 0x41: // 读取所有传感器命令
                         {
                             air8000_sensor_data_t sensor_data;
-                            result = air8000_sensor_read_all(g_ctx, &sensor_data, DEFAULT_TIMEOUT);
+                            result = read_all_sensors(&sensor_data);
                             if (result == 0) {
                                 // 保存传感器数据到响应
                                 memcpy(resp_data, &sensor_data, sizeof(air8000_sensor_data_t));
@@ -632,6 +844,26 @@ static void handle_mqtt_commands() {
                             }
                         }
                         break;
+                    case 0x28: // 多电机联动旋转
+                        {
+                            // 数据：0x28 + count(1字节) + start_delay_ms(2字节) + count × [motor_id(1) + angle(4) + speed(4)]
+                            size_t count = msg.payload.data[1];
+                            if (count == 0 || count > AIR8000_MOTOR_BATCH_MAX || msg.data_len < 4 + count * 9) {
+                                result = -1;
+                                break;
+                            }
+                            uint16_t start_delay;
+                            memcpy(&start_delay, &msg.payload.data[2], sizeof(uint16_t));
+                            air8000_motor_cmd_t cmds[AIR8000_MOTOR_BATCH_MAX];
+                            for (size_t i = 0; i < count; i++) {
+                                const uint8_t *p = &msg.payload.data[4 + i * 9];
+                                cmds[i].motor_id = p[0];
+                                memcpy(&cmds[i].angle, p + 1, sizeof(float));
+                                memcpy(&cmds[i].velocity, p + 5, sizeof(float));
+                            }
+                            result = air8000_motor_rotate_batch(g_ctx, cmds, count, start_delay, DEFAULT_TIMEOUT);
+                        }
+                        break;
                     default:
                         // 电机旋转命令，包含角度和速度
                         if (msg.data_len >= 9) {
@@ -675,9 +907,16 @@ static void handle_mqtt_commands() {
                     break;
                 }
                 case MSG_TYPE_FOTA_START: {
-                    // 开始FOTA升级 - 现在在MQTT Client中处理
-                    printf("[UART] 收到FOTA开始命令，由MQTT Client处理\n");
-                    result = 0;
+                    // 开始FOTA升级 - 固件由MQTT Client接收，携带会话号时经转发通道边下载边升级
+                    if (msg.data_len >= sizeof(uint32_t)) {
+                        uint32_t session;
+                        memcpy(&session, msg.payload.data, sizeof(session));
+                        printf("[UART] 收到FOTA开始命令，流式升级会话 %u\n", session);
+                        result = execute_fota_relay(session);
+                    } else {
+                        printf("[UART] 收到FOTA开始命令，由MQTT Client处理\n");
+                        result = 0;
+                    }
                     send_command_response(msg.seq_num, result, NULL, 0);
                     break;
                 }
@@ -714,7 +953,7 @@ static void handle_mqtt_commands() {
                             case 0x53: // 53. 获取传输状态
                                 printf("[文件传输] 获取传输状态\n");
                                 // 获取传输状态
-                                air8000_file_transfer_state_t state = air8000_file_transfer_get_state();
+                                air8000_file_transfer_state_t state = air8000_file_transfer_get_state(g_ctx);
                                 printf("[文件传输] 当前状态: %d\n", state);
                                 // 发送状态信息
                                 send_command_response(msg.seq_num, result, (uint8_t*)&state, sizeof(state));
@@ -752,7 +991,7 @@ static void handle_mqtt_commands() {
                     // 51. 取消文件传输
                     if (msg.data_len >= 2 && msg.payload.data[0] == 0x51) {
                         printf("[文件传输] 取消文件传输\n");
-                        result = air8000_file_transfer_cancel();
+                        result = air8000_file_transfer_cancel(g_ctx);
                     } else {
                         printf("[文件传输] 文件传输完成\n");
                         result = 0;
@@ -774,7 +1013,7 @@ static void handle_mqtt_commands() {
 static void __attribute__((unused)) read_sensor_data() {
     // 读取所有传感器数据
     air8000_sensor_data_t sensor_data;
-    if (air8000_sensor_read_all(g_ctx, &sensor_data, DEFAULT_TIMEOUT) == 0) {
+    if (read_all_sensors(&sensor_data) == 0) {
         // 参考老版本工程，打印传感器数据
         printf("所有传感器 - 温度: %.2f C, 湿度: %d%%, 光照: %d, 电池: %d%%\n", 
                sensor_data.temperature, sensor_data.humidity, sensor_data.light, sensor_data.battery);
@@ -858,10 +1097,34 @@ int main(int argc, char **argv) {
         return 1;
     }
     printf("[UART] 消息队列初始化成功\n");
+    
+    /* 附加到进程管理器的指标共享内存（独立运行时不记录） */
+    /* 进程管理器要求时锁定内存（mlockall 不跨 exec 继承，由本进程自己做） */
+    pm_sched_init_process();
+
+    if (pm_metrics_attach() == 0) {
+        printf("[UART] 指标共享内存已附加\n");
+    }
+
+    /* 设置 AIR8000_TRACE=1 时在内存中记录串口原始数据，kill -USR1 导出 */
+    const char *trace_env = getenv("AIR8000_TRACE");
+    if (trace_env && strcmp(trace_env, "0") != 0) {
+        if (air8000_trace_enable(0) == 0) {
+            printf("[UART] 串口跟踪已开启，kill -USR1 %d 导出\n", getpid());
+        }
+    }
 
     /* 初始化 Air8000 SDK */
     printf("[UART] 正在初始化 Air8000 (设备: %s)...\n", device);
-    g_ctx = air8000_init(device);  /* 初始化上下文，打开串口 */
+    /* I/O 线程调度配置取配置文件的 [air8000_io] 段，没有时保持默认调度 */
+    pm_sched_profile_t io_sched;
+    air8000_init_options_t init_opts = { .device_path = device, .io_sched = NULL };
+    if (pm_sched_load(NULL, "air8000_io", &io_sched) == 0) {
+        char desc[128];
+        printf("[UART] I/O 线程调度配置: %s\n", pm_sched_describe(&io_sched, desc, sizeof(desc)));
+        init_opts.io_sched = &io_sched;
+    }
+    g_ctx = air8000_init_ex(&init_opts);  /* 初始化上下文，打开串口 */
     if (!g_ctx) {
         /* 初始化失败，打印错误信息并退出 */
         fprintf(stderr, "Air8000 初始化失败 (请检查权限或连接)\n");
@@ -871,54 +1134,58 @@ int main(int argc, char **argv) {
     }
     printf("[UART] Air8000 初始化成功!\n");
     
-    /* 暂时注释掉图片处理模块初始化 */
-    // /* 初始化图片处理模块（包含自动处理） */
-    // if (air8000_image_process_init(g_ctx, g_mq_uart_to_mqtt) != 0) {
-    //     fprintf(stderr, "[UART] 图片处理模块初始化失败\n");
-    //     // 图片处理模块初始化失败不影响主程序运行，继续执行
-    // }
-    
-    /* 初始化文件传输模块 */
-    if (air8000_file_transfer_init(g_ctx) != 0) {
-        fprintf(stderr, "[UART] 文件传输模块初始化失败\n");
-        // 文件传输模块初始化失败不影响主程序运行，继续执行
+    /* 注册文件传输回调函数（文件传输模块由 air8000_init 为该上下文初始化） */
+    air8000_file_transfer_register_callback(g_ctx, file_transfer_callback, NULL);
+    
+    /* 订阅电机/传感器/电源遥测，固件不支持时继续使用轮询 */
+    if (air8000_subscribe_telemetry(g_ctx, AIR8000_TELEMETRY_ALL, TELEMETRY_PERIOD_MS,
+                                    NULL, NULL, DEFAULT_TIMEOUT) == 0) {
+        printf("[UART] 遥测订阅成功，周期 %d ms\n", TELEMETRY_PERIOD_MS);
     } else {
-        printf("[UART] 文件传输模块初始化成功\n");
+        printf("[UART] 遥测订阅失败，传感器数据改为轮询读取\n");
     }
     
-    /* 注册文件传输回调函数 */
-    air8000_file_transfer_register_callback(file_transfer_callback, NULL);
+#ifdef AIR8000_IMAGE_PROCESS
+    /* 初始化图片处理模块（包含自动处理），其回调替换上面仅打印日志的回调 */
+    if (air8000_image_process_init(g_ctx, g_mq_uart_to_mqtt) != 0) {
+        fprintf(stderr, "[UART] 图片处理模块初始化失败\n");
+        // 图片处理模块初始化失败不影响主程序运行，继续执行
+    }
+#endif
     
-
+    /* 串口和消息队列都已就绪，通知进程管理器（独立运行时什么也不做） */
+    process_notify_ready();
     
-    int sensor_read_count = 0;
+    time_t last_sensor_read = 0;
     
     /* 进入自动运行循环 */
     while (running) {
-        // 处理MQTT控制指令
+        // 按需导出串口跟踪环
+        if (dump_trace) {
+            dump_trace = 0;
+            air8000_trace_dump(stdout);
+        }
+        
+        // 处理MQTT控制指令（内部阻塞等待最多100ms，不再额外休眠）
         handle_mqtt_commands();
         
         // 每5秒读取一次传感器数据
-        if (sensor_read_count % 50 == 0) {
+        time_t now = time(NULL);
+        if (now - last_sensor_read >= 5) {
             read_sensor_data();
+            last_sensor_read = now;
         }
-        
-        sensor_read_count++;
-        
-        // 短暂休眠
-        usleep(100000); // 100ms
     }
 
-    /* 暂时注释掉图片处理模块清理 */
-    // /* 清理图片处理模块 */
-    // air8000_image_process_deinit();
-    
-    /* 清理文件传输模块 */
-    air8000_file_transfer_deinit();
-    printf("[UART] 文件传输模块已清理\n");
+#ifdef AIR8000_IMAGE_PROCESS
+    /* 清理图片处理模块 */
+    air8000_image_process_deinit();
+#endif
     
-    /* 程序退出，销毁Air8000上下文，释放资源 */
+    /* 程序退出，销毁Air8000上下文（包括其文件传输模块），释放资源 */
     air8000_deinit(g_ctx);
+    fota_relay_close(&g_relay_src.relay, false);
+    pm_metrics_detach();
     
     /* 关闭消息队列 */
     if (g_mq_uart_to_mqtt != -1) {
@@ -5,8 +5,9 @@
  * 
  * API 设计架构：
  * 1. **上下文管理**：
- *    - 支持多实例模式，每个实例对应一个独立的串口连接
- *    - 支持单例模式，便于全局访问同一设备
+ *    - 支持多实例模式，每个实例对应一个独立的串口连接，文件传输等模块状态归各实例所有
+ *    - 所有实例共用一个 epoll I/O 反应器线程，增加设备不增加线程
+ *    - 保留单例模式，便于只有一个设备的旧代码全局访问
  *    - 提供完整的初始化和销毁机制
  * 2. **错误处理**：
  *    - 统一的错误码体系，便于错误识别和处理
@@ -65,33 +66,77 @@ typedef enum {
 /**
  * @brief 通知回调函数类型定义
  * @details 用于接收设备主动发送的通知消息
- * @param frame 接收到的通知帧
+ * @param frame 接收到的通知帧，frame->data 指向 SDK 接收缓冲区，仅在回调期间有效，
+ *              需要保留时请用 air8000_frame_copy 拷贝，不要对其调用 air8000_frame_cleanup
  * @param user_data 用户自定义数据，在设置回调时传入
  */
 typedef void (*air8000_notify_cb_t)(const air8000_frame_t *frame, void *user_data);
 
+/**
+ * @brief 遥测回调函数类型定义
+ * @details 每解码一帧遥测上报后在 I/O 线程中调用，回调中不要执行阻塞操作
+ * @param snapshot 刚发布的遥测快照，仅在回调期间有效
+ * @param user_data 用户自定义数据，在订阅时传入
+ */
+typedef void (*air8000_telemetry_cb_t)(const air8000_telemetry_t *snapshot, void *user_data);
+
+/**
+ * @brief 同时存在的上下文数上限
+ */
+#define AIR8000_MAX_CONTEXTS 8
+
 /**
  * @brief 初始化 Air8000 上下文
- * @details 创建并初始化一个新的 Air8000 上下文，打开串口并启动 I/O 线程
+ * @details 创建并初始化一个新的 Air8000 上下文，打开串口并注册到 I/O 反应器
+ *          （第一个上下文创建时启动反应器线程）
  * @param device_path 设备路径，如 "/dev/ttyACM2"，NULL 表示使用默认路径
- * @return 成功返回上下文指针，失败返回 NULL
- * @note 每个上下文对应一个独立的串口连接，支持多设备连接
+ * @return 成功返回上下文指针，失败（包括已有 AIR8000_MAX_CONTEXTS 个上下文）返回 NULL
+ * @note 每个上下文对应一个独立的串口连接，支持多设备连接；
+ *       所有上下文的回调都在同一个反应器线程中执行，回调中的耗时操作会延迟所有设备的收发
  */
 air8000_t* air8000_init(const char *device_path);
 
+struct pm_sched_profile;
+
+/**
+ * @brief Air8000 初始化选项
+ */
+typedef struct {
+    const char *device_path;                  ///< 设备路径，NULL 表示使用默认路径
+    const struct pm_sched_profile *io_sched;  ///< I/O 反应器线程的调度配置（见 pm_sched.h），NULL 不修改
+} air8000_init_options_t;
+
+/**
+ * @brief 按选项初始化 Air8000 上下文
+ * @details 与 air8000_init 相同，另外在给出 io_sched 时先调用 air8000_set_io_sched
+ * @param opts 初始化选项，NULL 等同于 air8000_init(NULL)
+ * @return 成功返回上下文指针，失败返回 NULL
+ */
+air8000_t* air8000_init_ex(const air8000_init_options_t *opts);
+
+/**
+ * @brief 设置 I/O 反应器线程的调度配置
+ * @details 所有上下文共用一个反应器线程，配置对所有设备生效。反应器线程在下一轮循环中
+ *          应用到自己身上（CPU 亲和性、SCHED_FIFO 优先级、mlockall），反应器重启后重新应用。
+ *          该线程同时把自己的上下文切换次数计入指标 uart_io_csw_voluntary/involuntary
+ * @param profile 调度配置（内容被拷贝）
+ * @return 成功返回 AIR8000_OK，profile 为 NULL 返回 AIR8000_ERR_PARAM
+ */
+int air8000_set_io_sched(const struct pm_sched_profile *profile);
+
 /**
  * @brief 销毁 Air8000 上下文
- * @details 关闭串口，停止 I/O 线程，释放所有资源
+ * @details 从 I/O 反应器注销并关闭串口，释放所有资源；最后一个上下文销毁时停止反应器线程
  * @param ctx 要销毁的上下文指针
- * @note 必须在不再使用上下文时调用，否则会导致内存泄漏
+ * @note 必须在不再使用上下文时调用，否则会导致内存泄漏；不能在 SDK 回调中调用
  */
 void air8000_deinit(air8000_t *ctx);
 
 /**
  * @brief 获取 Air8000 全局单例实例
- * @details 实现单例模式，确保整个应用中只有一个 Air8000 上下文实例
+ * @details 单设备场景的便捷入口，单例只是众多上下文中的一个，SDK 内部不依赖它
  * @return 成功返回全局单例指针，失败返回 NULL
- * @note 首次调用时会自动初始化，使用默认串口路径
+ * @note 首次调用时会自动初始化，使用默认串口路径；多设备时请直接使用 air8000_init
  */
 air8000_t* air8000_get_instance(void);
 
@@ -109,6 +154,20 @@ air8000_t* air8000_init_instance(const char *device_path);
  */
 void air8000_reset_instance(void);
 
+/**
+ * @brief 获取上下文上挂载的文件传输模块状态（SDK 内部使用）
+ * @param ctx 上下文指针
+ * @return 模块状态指针，未初始化返回 NULL
+ */
+void *air8000_get_file_transfer_data(air8000_t *ctx);
+
+/**
+ * @brief 设置上下文上挂载的文件传输模块状态（SDK 内部使用）
+ * @param ctx 上下文指针
+ * @param data 模块状态指针
+ */
+void air8000_set_file_transfer_data(air8000_t *ctx, void *data);
+
 /**
  * @brief 设置通知回调函数
  * @details 用于接收设备主动发送的通知消息
@@ -129,6 +188,142 @@ void air8000_set_notify_callback(air8000_t *ctx, air8000_notify_cb_t cb, void *u
  */
 int air8000_send_and_wait(air8000_t *ctx, const air8000_frame_t *req, air8000_frame_t *resp, int timeout_ms);
 
+// ==================== 异步流水线 ====================
+
+/**
+ * @brief 默认异步在途窗口大小
+ * @details 同时处于"已提交、未完成"状态的异步请求数上限
+ */
+#define AIR8000_DEFAULT_ASYNC_WINDOW 8
+
+/**
+ * @brief 异步在途窗口上限
+ * @note 序列号只有 8 位，窗口需远小于 256，避免新请求与在途请求序列号冲突
+ */
+#define AIR8000_MAX_ASYNC_WINDOW 64
+
+/**
+ * @brief 异步请求完成回调函数类型定义
+ * @details 在 I/O 线程中调用，回调返回后 req/resp 即被释放，如需保留请自行拷贝
+ * @param ctx 上下文指针
+ * @param result 请求结果：AIR8000_OK 表示收到响应（需再检查 resp->type 是否为 NACK），
+ *               AIR8000_ERR_TIMEOUT/AIR8000_ERR_SHUTDOWN 等表示未收到响应
+ * @param req 原始请求帧
+ * @param resp 响应帧，result 非 AIR8000_OK 时为 NULL
+ * @param user_data 提交请求时传入的用户数据
+ * @warning 回调运行在 I/O 线程，禁止在其中调用 air8000_send_and_wait/air8000_send_async 等会阻塞的接口
+ */
+typedef void (*air8000_async_cb_t)(air8000_t *ctx, int result,
+                                   const air8000_frame_t *req,
+                                   const air8000_frame_t *resp,
+                                   void *user_data);
+
+/**
+ * @brief 异步发送帧
+ * @details 将请求放入发送队列后立即返回，响应或超时时由 I/O 线程调用 cb。
+ *          当在途异步请求数达到窗口上限时阻塞，直到有请求完成
+ * @param ctx 上下文指针
+ * @param req 请求帧指针，内部会深拷贝，调用返回后即可释放
+ * @param cb 完成回调函数，不可为 NULL
+ * @param user_data 回调用户数据
+ * @param timeout_ms 超时时间，单位毫秒
+ * @return 成功提交返回 0，失败返回负数错误码（失败时不会调用 cb）
+ */
+int air8000_send_async(air8000_t *ctx, const air8000_frame_t *req,
+                       air8000_async_cb_t cb, void *user_data, int timeout_ms);
+
+/**
+ * @brief 发送帧，不等待响应
+ * @details 请求入队后立即返回，既不等待响应也不等待异步窗口，因此可以在 SDK 回调（I/O 线程）中调用；
+ *          超时或被设备拒绝时只记录日志。用于确认类的单向命令
+ * @param ctx 上下文指针
+ * @param req 请求帧指针，内部会深拷贝，调用返回后即可释放
+ * @param timeout_ms 超时时间，单位毫秒
+ * @return 成功提交返回 0，失败返回负数错误码
+ */
+int air8000_send_nowait(air8000_t *ctx, const air8000_frame_t *req, int timeout_ms);
+
+/**
+ * @brief 设置异步在途窗口大小
+ * @param ctx 上下文指针
+ * @param window 窗口大小，取值范围 [1, AIR8000_MAX_ASYNC_WINDOW]，超出范围自动截断
+ */
+void air8000_set_async_window(air8000_t *ctx, int window);
+
+/**
+ * @brief 获取异步在途窗口大小
+ * @param ctx 上下文指针
+ * @return 当前窗口大小，ctx 为 NULL 时返回 AIR8000_DEFAULT_ASYNC_WINDOW
+ */
+int air8000_get_async_window(air8000_t *ctx);
+
+/**
+ * @brief 等待所有在途异步请求完成
+ * @param ctx 上下文指针
+ * @param timeout_ms 超时时间，单位毫秒，-1 表示一直等待
+ * @return 全部完成返回 0，超时返回 AIR8000_ERR_TIMEOUT
+ */
+int air8000_async_drain(air8000_t *ctx, int timeout_ms);
+
+/**
+ * @brief 窗口发送的分片构建回调
+ * @details 每次发送（含重传）都会调用一次，需用 air8000_build_request 构建新帧（获取新序列号）；
+ *          frame->data 可由回调自行 malloc 并直接填充，提交时缓冲区转交请求槽位，不再拷贝
+ * @param ctx 上下文指针
+ * @param index 分片索引，从 0 开始
+ * @param frame 输出帧，数据长度不得超过 AIR8000_MAX_FRAME_DATA，由调用方在提交后释放
+ * @param user_data 用户数据
+ * @return 成功返回 0，失败返回负数错误码（终止整个发送）
+ */
+typedef int (*air8000_window_build_cb_t)(air8000_t *ctx, uint32_t index,
+                                         air8000_frame_t *frame, void *user_data);
+
+/**
+ * @brief 窗口发送的进度回调
+ * @param ctx 上下文指针
+ * @param acked 已确认的分片数
+ * @param total 分片总数
+ * @param user_data 用户数据
+ */
+typedef void (*air8000_window_progress_cb_t)(air8000_t *ctx, uint32_t acked,
+                                             uint32_t total, void *user_data);
+
+/**
+ * @brief 窗口发送的单个分片确认回调
+ * @details 在 I/O 线程中调用，只能做置位等轻量操作，不可再发起同步请求
+ * @param ctx 上下文指针
+ * @param index 被确认的分片索引
+ * @param user_data 用户数据
+ */
+typedef void (*air8000_window_block_cb_t)(air8000_t *ctx, uint32_t index, void *user_data);
+
+/**
+ * @brief 窗口发送任务描述
+ */
+typedef struct {
+    uint32_t total;                         ///< 分片总数
+    int max_retry;                          ///< 单个分片最大重传次数（NACK 或超时后重传）
+    int timeout_ms;                         ///< 单个分片响应超时，单位毫秒
+    air8000_window_build_cb_t build;        ///< 分片构建回调，不可为 NULL
+    air8000_window_progress_cb_t progress;  ///< 进度回调，可为 NULL，在调用线程中触发
+    const volatile bool *abort_flag;        ///< 取消标志，可为 NULL，置 true 后停止提交新分片
+    void *user_data;                        ///< 回调用户数据
+    const uint8_t *skip_bitmap;             ///< 已完成分片位图（第 i 位置位表示分片 i 无需发送），可为 NULL，用于断点续传
+    air8000_window_block_cb_t block_acked;  ///< 单个分片确认回调，可为 NULL
+} air8000_window_job_t;
+
+/**
+ * @brief 以流水线方式发送一组分片
+ * @details 保持最多"异步窗口"个分片在途，收到 ACK/RESPONSE 即视为确认；
+ *          收到 NACK 或超时的分片单独重传，不影响其他在途分片；
+ *          skip_bitmap 中已置位的分片直接计入已确认，不再发送
+ * @param ctx 上下文指针
+ * @param job 任务描述
+ * @return 全部分片确认返回 0；取消返回 AIR8000_ERR_SHUTDOWN；
+ *         某个分片重传耗尽返回其最后一次错误（NACK 记为 AIR8000_ERR_PROTOCOL）
+ */
+int air8000_send_windowed(air8000_t *ctx, const air8000_window_job_t *job);
+
 // ==================== 系统命令 ====================
 
 /**
@@ -215,6 +410,27 @@ int air8000_motor_stop(air8000_t *ctx, uint8_t motor_id, int timeout_ms);
  */
 int air8000_motor_rotate(air8000_t *ctx, uint8_t motor_id, float angle, float velocity, int timeout_ms);
 
+/**
+ * @brief 多电机批量绝对位置旋转（一次串口事务）
+ * @param ctx 上下文指针
+ * @param cmds 电机子命令数组
+ * @param count 子命令个数，1 ~ AIR8000_MOTOR_BATCH_MAX
+ * @param start_delay_ms 同步启动延时，单位毫秒：设备收齐整帧后等待该时间，所有电机同时启动；0 表示立即启动
+ * @param timeout_ms 超时时间，单位毫秒
+ * @return 成功返回 0，设备拒绝返回 -1，其他失败返回负数错误码
+ * @note 固件不支持批量命令时自动回退为连续发送的多个单电机旋转帧（不再逐个等待往返），
+ *       此时 start_delay_ms 不生效，相邻电机启动间隔不超过一帧传输时间
+ */
+int air8000_motor_rotate_batch(air8000_t *ctx, const air8000_motor_cmd_t *cmds, size_t count,
+                               uint16_t start_delay_ms, int timeout_ms);
+
+/**
+ * @brief 查询固件是否支持批量旋转命令
+ * @param ctx 上下文指针
+ * @return 1 支持，0 不支持，-1 尚未探测
+ */
+int air8000_motor_batch_supported(air8000_t *ctx);
+
 /**
  * @brief 电机相对位置旋转
  * @param ctx 上下文指针
@@ -355,6 +571,43 @@ int air8000_sensor_read_temp(air8000_t *ctx, uint8_t sensor_id, float *temp, int
  */
 int air8000_sensor_read_all(air8000_t *ctx, air8000_sensor_data_t *data, int timeout_ms);
 
+// ==================== 遥测订阅 ====================
+
+/**
+ * @brief 订阅设备主动上报的遥测数据
+ * @param ctx 上下文指针
+ * @param mask 数据项掩码（AIR8000_TELEMETRY_*）
+ * @param period_ms 上报周期，单位毫秒，不小于 AIR8000_TELEMETRY_MIN_PERIOD_MS
+ * @param cb 每帧上报后的回调，可为NULL（只通过 air8000_telemetry_read 读取）
+ * @param user_data 回调用户数据
+ * @param timeout_ms 超时时间，单位毫秒
+ * @return 成功返回 0，失败返回负数错误码
+ * @details 订阅后设备以 CMD_TELEMETRY_REPORT 通知帧按固定周期推送数据，SDK 解码到双缓冲快照中，
+ *          上报帧不再转发给通知回调；串口重连后 SDK 自动重新下发订阅。
+ *          代替周期调用 air8000_motor_get_all / air8000_sensor_read_all 轮询
+ */
+int air8000_subscribe_telemetry(air8000_t *ctx, uint8_t mask, uint16_t period_ms,
+                                air8000_telemetry_cb_t cb, void *user_data, int timeout_ms);
+
+/**
+ * @brief 取消遥测订阅
+ * @param ctx 上下文指针
+ * @param timeout_ms 超时时间，单位毫秒
+ * @return 成功返回 0，失败返回负数错误码
+ * @details 最后一份快照仍可通过 air8000_telemetry_read 读取
+ */
+int air8000_unsubscribe_telemetry(air8000_t *ctx, int timeout_ms);
+
+/**
+ * @brief 读取最新的遥测快照
+ * @param ctx 上下文指针
+ * @param out 输出快照
+ * @return 成功返回 0，尚未收到任何上报返回 AIR8000_ERR_TIMEOUT
+ * @details 无锁，可在任意线程中调用，不会阻塞 I/O 线程；
+ *          通过比较 out->seq 判断是否有新数据，out->host_time_ms 判断数据是否过期
+ */
+int air8000_telemetry_read(air8000_t *ctx, air8000_telemetry_t *out);
+
 // ==================== 看门狗命令 ====================
 
 /**
@@ -0,0 +1,108 @@
+/**
+ * @file air8000_checksum.h
+ * @brief Air8000 校验和模块头文件
+ * @details 提供 CRC16/MODBUS（帧校验）、CRC32（文件分片校验）和 CRC32C（MQTT 上传/spool 校验）的共享实现
+ *
+ * 实现选择：
+ * 1. **bitwise**：逐位计算，每字节 8 次循环，作为参考实现
+ * 2. **table**：256 项查表，每字节一次查表
+ * 3. **slice8**：8 张表并行查表，每次处理 8 字节（默认）
+ * 4. **armv8-crc**：ARMv8 CRC32/CRC32C 指令（CRC16 无对应指令，需编译器开启 +crc 且运行时 HWCAP 支持）
+ *
+ * 首次调用时（或显式调用 air8000_checksum_init）自动生成查表并选择最快的可用实现，
+ * 之后每次调用只是一次函数指针跳转。
+ */
+
+#ifndef AIR8000_CHECKSUM_H
+#define AIR8000_CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 校验和实现类型
+ */
+typedef enum {
+    AIR8000_CSUM_AUTO = 0,      ///< 自动选择最快的可用实现
+    AIR8000_CSUM_BITWISE,       ///< 逐位计算（参考实现）
+    AIR8000_CSUM_TABLE,         ///< 单表查表
+    AIR8000_CSUM_SLICE8,        ///< slice-by-8 查表
+    AIR8000_CSUM_ARMV8_CRC,     ///< ARMv8 CRC32/CRC32C 指令（CRC16 仍使用 slice-by-8）
+} air8000_csum_impl_t;
+
+/**
+ * @brief 初始化校验和模块
+ * @details 生成查表并自动选择实现，可重复调用；不调用时首次计算会自动初始化
+ */
+void air8000_checksum_init(void);
+
+/**
+ * @brief 强制选择校验和实现
+ * @param impl 实现类型
+ * @return 成功返回0，当前平台不支持返回 -1（保持原实现不变）
+ * @note 主要用于基准测试和对比验证，应在启动阶段调用
+ */
+int air8000_checksum_select(air8000_csum_impl_t impl);
+
+/**
+ * @brief 获取当前 CRC32 实现名称
+ * @return 实现名称字符串，例如 "slice8"
+ */
+const char *air8000_checksum_impl_name(void);
+
+/**
+ * @brief 增量计算 CRC16/MODBUS
+ * @param crc 上一段的 CRC 值，首段传 0xFFFF
+ * @param data 数据指针
+ * @param len 数据长度，单位字节
+ * @return 更新后的 CRC16 值
+ */
+uint16_t air8000_crc16_modbus_update(uint16_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief 增量计算 CRC32（IEEE 802.3，与 zlib crc32 相同）
+ * @param crc 上一段的 CRC32 值，首段传 0
+ * @param data 数据指针
+ * @param len 数据长度，单位字节
+ * @return 更新后的 CRC32 值
+ */
+uint32_t air8000_crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief 计算 CRC32
+ * @param data 数据指针
+ * @param len 数据长度，单位字节
+ * @return CRC32 值
+ */
+uint32_t air8000_crc32(const uint8_t *data, size_t len);
+
+/**
+ * @brief 增量计算 CRC32C（Castagnoli，反射多项式 0x82F63B78）
+ * @param crc 上一段的 CRC32C 值，首段传 0
+ * @param data 数据指针
+ * @param len 数据长度，单位字节
+ * @return 更新后的 CRC32C 值
+ */
+uint32_t air8000_crc32c_update(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief 逐位计算 CRC16/MODBUS（参考实现）
+ * @note 与原 air8000_crc16_modbus 逐位算法相同，用于校验和基准对比
+ */
+uint16_t air8000_crc16_modbus_bitwise(const uint8_t *data, size_t len);
+
+/**
+ * @brief 逐位计算 CRC32（参考实现）
+ * @note 与原 calculate_crc32 逐位算法相同，用于校验和基准对比
+ */
+uint32_t air8000_crc32_bitwise(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIR8000_CHECKSUM_H
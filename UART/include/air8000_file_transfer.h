@@ -32,6 +32,12 @@ extern "C" {
  */
 #define AIR8000_FILE_DEFAULT_TIMEOUT_MS 1000
 
+/**
+ * @brief 分片位图文件后缀
+ * @details 收发两端在文件路径后追加此后缀保存已完成分片位图，用于断点续传；传输完成后自动删除
+ */
+#define AIR8000_FILE_BITMAP_SUFFIX ".ftmap"
+
 // ==================== 事件类型定义 ====================
 
 /**
@@ -42,12 +48,22 @@ typedef enum {
     FILE_TRANSFER_EVENT_NOTIFY_ACKED,    ///< 通知被CV610确认
     FILE_TRANSFER_EVENT_STARTED,         ///< 传输开始
     FILE_TRANSFER_EVENT_DATA_SENT,       ///< 分片发送成功
-    FILE_TRANSFER_EVENT_COMPLETED,       ///< 传输完成
+    FILE_TRANSFER_EVENT_COMPLETED,       ///< 传输完成（接收完成时 data 为接收文件路径 const char *，否则为 NULL）
     FILE_TRANSFER_EVENT_ERROR,           ///< 传输错误
     FILE_TRANSFER_EVENT_CANCELLED,       ///< 传输取消
     FILE_TRANSFER_EVENT_REQUEST_RECEIVED ///< 收到CV610的传输请求
 } air8000_file_transfer_event_t;
 
+/**
+ * @brief 最近一次接收完成的文件的跟踪信息
+ * @details 时间戳为 CLOCK_MONOTONIC 微秒（与 pm_metrics_now_us 相同）
+ */
+typedef struct {
+    uint32_t trace_id;       ///< 跟踪ID（对端未提供时由本机分配）
+    uint64_t captured_us;    ///< 拍摄时间：开始通知到达时间减去对端上报的拍摄时长，未上报时等于开始时间
+    uint64_t transferred_us; ///< 全部分片接收完成的时间
+} air8000_file_trace_t;
+
 // ==================== 回调函数类型定义 ====================
 
 /**
@@ -66,22 +82,27 @@ typedef void (*air8000_file_transfer_cb_t)(air8000_t *ctx,
 
 /**
  * @brief 初始化文件传输上下文
+ * @details 状态挂载在 Air8000 上下文上，每个设备各自独立；air8000_init 已自动调用
  * @param ctx Air8000上下文指针
- * @return 成功返回0，失败返回错误码
+ * @return 成功返回0，已初始化返回 AIR8000_ERR_BUSY，失败返回错误码
  */
 int air8000_file_transfer_init(air8000_t *ctx);
 
 /**
  * @brief 销毁文件传输上下文
+ * @details air8000_deinit 会自动调用，重复调用无副作用
+ * @param ctx Air8000上下文指针
  */
-void air8000_file_transfer_deinit(void);
+void air8000_file_transfer_deinit(air8000_t *ctx);
 
 /**
  * @brief 注册文件传输回调函数
+ * @param ctx Air8000上下文指针
  * @param cb 回调函数，处理文件传输事件
  * @param user_data 用户数据，回调时传递
  */
-void air8000_file_transfer_register_callback(air8000_file_transfer_cb_t cb, 
+void air8000_file_transfer_register_callback(air8000_t *ctx,
+                                             air8000_file_transfer_cb_t cb, 
                                              void *user_data);
 
 /**
@@ -101,7 +122,9 @@ int air8000_file_transfer_notify(air8000_t *ctx,
  * @param filename 文件名
  * @param file_path 文件路径
  * @param block_size 分片大小，0表示使用默认值
- * @return 成功返回0，失败返回错误码
+ * @return 成功返回0，取消返回 AIR8000_ERR_SHUTDOWN，失败返回错误码
+ * @note 传输中断（出错或进程退出）后以相同参数再次调用，只发送对端尚未确认的分片；
+ *       源文件被修改或分片大小变化时重新完整发送
  */
 int air8000_file_transfer_start(air8000_t *ctx, 
                                 const char *filename, 
@@ -110,9 +133,10 @@ int air8000_file_transfer_start(air8000_t *ctx,
 
 /**
  * @brief 取消文件传输
+ * @param ctx Air8000上下文指针
  * @return 成功返回0，失败返回错误码
  */
-int air8000_file_transfer_cancel(void);
+int air8000_file_transfer_cancel(air8000_t *ctx);
 
 /**
  * @brief 处理CV610发送的文件传输请求
@@ -125,9 +149,19 @@ int air8000_file_transfer_handle_request(air8000_t *ctx,
 
 /**
  * @brief 获取当前文件传输状态
+ * @param ctx Air8000上下文指针
  * @return 文件传输状态
  */
-air8000_file_transfer_state_t air8000_file_transfer_get_state(void);
+air8000_file_transfer_state_t air8000_file_transfer_get_state(air8000_t *ctx);
+
+/**
+ * @brief 获取最近一次接收完成的文件的跟踪信息
+ * @details 在 FILE_TRANSFER_EVENT_COMPLETED 回调中调用，取得与该文件对应的跟踪信息
+ * @param ctx Air8000上下文指针
+ * @param trace 输出参数
+ * @return 成功返回0，尚未接收完成过文件返回 AIR8000_ERR_GENERIC
+ */
+int air8000_file_transfer_get_trace(air8000_t *ctx, air8000_file_trace_t *trace);
 
 /**
  * @brief 请求Air8000发送文件
@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <sys/types.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,6 +48,31 @@ typedef void (*air8000_fota_cb_t)(air8000_t *ctx,
                                   void *data, 
                                   void *user_data);
 
+// ==================== 流式固件数据源 ====================
+
+/**
+ * @brief 流式固件数据源
+ * @details 固件边下载边升级时使用：read 按顺序交付固件数据，数据未到时阻塞；
+ *          全部数据发送完成后调用 verify 等待下载侧校验结果，通过后才发送升级完成命令
+ */
+typedef struct {
+    /**
+     * @brief 读取后续固件数据
+     * @param user_data 数据源用户数据
+     * @param buf 输出缓冲区
+     * @param len 最多读取的字节数
+     * @return 读取的字节数（>0）；下载中止或超时返回<=0
+     */
+    ssize_t (*read)(void *user_data, uint8_t *buf, size_t len);
+    /**
+     * @brief 等待下载侧校验结果
+     * @param user_data 数据源用户数据
+     * @return 校验通过返回true
+     */
+    bool (*verify)(void *user_data);
+    void *user_data;                    ///< 数据源用户数据
+} air8000_fota_source_t;
+
 // ==================== FOTA上下文结构体定义 ====================
 
 /**
@@ -67,7 +93,11 @@ typedef struct air8000_fota_ctx {
     char firmware_path[512];           ///< 固件文件路径
     uint8_t progress;                   ///< 进度百分比
     int timeout_fd;                    ///< 超时定时器文件描述符
-    bool aborted;                      ///< 是否已取消
+    volatile bool aborted;             ///< 是否已取消，原子读写，air8000_fota_abort 不加锁置位
+    bool streaming;                    ///< 是否为流式升级
+    air8000_fota_source_t source;      ///< 流式固件数据源
+    uint8_t *stream_buf;               ///< 最近读取的固件数据（环形），供重传使用
+    uint32_t stream_filled;            ///< 已从数据源读取的字节数
 } air8000_fota_ctx_t;
 
 // ==================== API 函数声明 ====================
@@ -82,6 +112,22 @@ typedef struct air8000_fota_ctx {
  */
 air8000_fota_ctx_t *air8000_fota_create(air8000_t *ctx, const char *firmware_path, air8000_fota_cb_t callback, void *user_data);
 
+/**
+ * @brief 创建流式FOTA升级上下文
+ * @details 固件数据从 source 按顺序读取，无需等待整个文件下载完成；最近读取的数据保留在
+ *          内存中供重传，更早的数据重传时从 firmware_path 回读（此时下载侧已写入文件）
+ * @param ctx Air8000上下文指针
+ * @param firmware_size 固件总大小
+ * @param firmware_path 固件文件路径，可为NULL（不支持回读）
+ * @param source 固件数据源
+ * @param callback 回调函数
+ * @param user_data 用户数据
+ * @return 成功返回FOTA上下文指针，失败返回NULL
+ */
+air8000_fota_ctx_t *air8000_fota_create_stream(air8000_t *ctx, uint32_t firmware_size, const char *firmware_path,
+                                               const air8000_fota_source_t *source,
+                                               air8000_fota_cb_t callback, void *user_data);
+
 /**
  * @brief 销毁FOTA升级上下文
  * @param fota_ctx FOTA上下文指针
@@ -99,6 +145,8 @@ int air8000_fota_start(air8000_fota_ctx_t *fota_ctx);
  * @brief 取消FOTA升级
  * @param fota_ctx FOTA上下文指针
  * @return 成功返回0，失败返回错误码
+ * @details 可在其他线程中于 air8000_fota_start 发送期间调用：取消标志不加锁置位，
+ *          窗口发送随即停止，由 air8000_fota_start 通知 Air8000 并结束升级
  */
 int air8000_fota_abort(air8000_fota_ctx_t *fota_ctx);
 
@@ -1,7 +1,7 @@
 /**
  * @file air8000_image_process.h
  * @brief Air8000 图片处理模块
- * @details 接收文件传输完成事件，自动调用image_processor处理图片
+ * @details 接收文件传输完成事件，自动调用 libimageproc 处理图片
  */
 
 #ifndef AIR8000_IMAGE_PROCESS_H
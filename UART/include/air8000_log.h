@@ -11,6 +11,42 @@
 extern "C" {
 #endif
 
+/**
+ * @brief 日志级别
+ * @details 编译期通过 AIR8000_LOG_LEVEL 选择，低于该级别的日志宏展开为空语句，
+ *          参数仍参与类型检查，但不会生成任何代码
+ *
+ * 默认级别：
+ * - 调试构建：AIR8000_LOG_LEVEL_DEBUG（包含串口收发的十六进制打印）
+ * - 定义了 NDEBUG 的发布构建：AIR8000_LOG_LEVEL_INFO
+ * 也可以直接在 CFLAGS 中指定，例如 -DAIR8000_LOG_LEVEL=AIR8000_LOG_LEVEL_WARN
+ */
+#define AIR8000_LOG_LEVEL_NONE  0   ///< 关闭所有日志
+#define AIR8000_LOG_LEVEL_ERROR 1   ///< 仅错误
+#define AIR8000_LOG_LEVEL_WARN  2   ///< 错误和警告
+#define AIR8000_LOG_LEVEL_INFO  3   ///< 普通信息
+#define AIR8000_LOG_LEVEL_DEBUG 4   ///< 调试信息（逐帧收发记录）
+
+#ifndef AIR8000_LOG_LEVEL
+#ifdef NDEBUG
+#define AIR8000_LOG_LEVEL AIR8000_LOG_LEVEL_INFO
+#else
+#define AIR8000_LOG_LEVEL AIR8000_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+/**
+ * @brief 判断某个级别的日志是否编译进来
+ * @details 用于跳过只为日志服务的准备工作（如格式化时间、生成十六进制字符串）
+ */
+#define AIR8000_LOG_ENABLED(level) (AIR8000_LOG_LEVEL >= (level))
+
+/**
+ * @brief 被裁剪掉的日志
+ * @details if (0) 保留格式串检查并避免未使用变量告警，编译器会整体删除
+ */
+#define AIR8000_LOG_NOP(fmt, ...) do { if (0) printf(fmt, ##__VA_ARGS__); } while (0)
+
 /**
  * @brief 日志宏定义
  * @details 提供统一的日志格式，包含标签和日志级别
@@ -20,13 +56,29 @@ extern "C" {
  * @param ... 可变参数
  */
 
+/**
+ * @brief 调试日志
+ * @param tag 日志标签
+ * @param fmt 格式字符串
+ * @param ... 可变参数
+ */
+#if AIR8000_LOG_ENABLED(AIR8000_LOG_LEVEL_DEBUG)
+#define log_debug(tag, fmt, ...) printf("[%s DEBUG] " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define log_debug(tag, fmt, ...) AIR8000_LOG_NOP("%s" fmt, tag, ##__VA_ARGS__)
+#endif
+
 /**
  * @brief 普通信息日志
  * @param tag 日志标签
  * @param fmt 格式字符串
  * @param ... 可变参数
  */
+#if AIR8000_LOG_ENABLED(AIR8000_LOG_LEVEL_INFO)
 #define log_info(tag, fmt, ...) printf("[%s] " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define log_info(tag, fmt, ...) AIR8000_LOG_NOP("%s" fmt, tag, ##__VA_ARGS__)
+#endif
 
 /**
  * @brief 警告日志
@@ -34,7 +86,11 @@ extern "C" {
  * @param fmt 格式字符串
  * @param ... 可变参数
  */
+#if AIR8000_LOG_ENABLED(AIR8000_LOG_LEVEL_WARN)
 #define log_warn(tag, fmt, ...) printf("[%s WARN] " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define log_warn(tag, fmt, ...) AIR8000_LOG_NOP("%s" fmt, tag, ##__VA_ARGS__)
+#endif
 
 /**
  * @brief 错误日志
@@ -42,7 +98,11 @@ extern "C" {
  * @param fmt 格式字符串
  * @param ... 可变参数
  */
+#if AIR8000_LOG_ENABLED(AIR8000_LOG_LEVEL_ERROR)
 #define log_error(tag, fmt, ...) printf("[%s ERROR] " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define log_error(tag, fmt, ...) AIR8000_LOG_NOP("%s" fmt, tag, ##__VA_ARGS__)
+#endif
 
 #ifdef __cplusplus
 }
@@ -76,6 +76,17 @@ extern "C" {
  */
 #define AIR8000_MIN_FRAME   (AIR8000_HEADER_SIZE + AIR8000_CRC_SIZE)
 
+/**
+ * @brief 最大帧大小
+ * @details 与 I/O 线程发送缓冲区一致，数据字段不能超过 AIR8000_MAX_FRAME - AIR8000_MIN_FRAME
+ */
+#define AIR8000_MAX_FRAME   2048
+
+/**
+ * @brief 单帧最大数据长度
+ */
+#define AIR8000_MAX_FRAME_DATA (AIR8000_MAX_FRAME - AIR8000_MIN_FRAME)
+
 // ==================== 枚举定义 ====================
 
 /**
@@ -112,6 +123,8 @@ typedef enum {
     CMD_QUERY_POWER         = 0x0101, ///< 查询电源：获取设备电源状态
     CMD_QUERY_STATUS        = 0x0102, ///< 查询状态：获取设备整体状态
     CMD_QUERY_NETWORK       = 0x0103, ///< 查询网络：获取设备网络状态
+    CMD_TELEMETRY_SUBSCRIBE = 0x0110, ///< 遥测订阅：数据=[mask u8][period_ms u16 大端序]，period_ms=0 取消订阅
+    CMD_TELEMETRY_REPORT    = 0x0111, ///< 遥测上报：设备按订阅周期主动推送的 NOTIFY 帧
 
     // 电机命令 (0x30xx)
     CMD_MOTOR_ROTATE        = 0x3001, ///< 电机旋转：控制电机旋转到指定绝对位置
@@ -122,6 +135,7 @@ typedef enum {
     CMD_MOTOR_GET_POS       = 0x3006, ///< 获取位置：获取电机当前位置
     CMD_MOTOR_SET_VEL       = 0x3007, ///< 设置速度：设置电机速度
     CMD_MOTOR_ROTATE_REL    = 0x3008, ///< 相对旋转：控制电机相对当前位置旋转
+    CMD_MOTOR_ROTATE_BATCH  = 0x3009, ///< 批量旋转：一帧下发多个电机的绝对位置旋转，设备同步启动
     CMD_MOTOR_GET_ALL       = 0x3100, ///< 获取所有电机状态：获取所有电机的当前状态
 
     // 电机参数命令 (0x31xx)
@@ -324,6 +338,72 @@ typedef struct {
     air8000_motor_state_item_t *motors; ///< 电机状态数组指针
 } air8000_all_motor_status_t;
 
+/**
+ * @brief 批量旋转最大电机数
+ */
+#define AIR8000_MOTOR_BATCH_MAX 8
+
+/**
+ * @brief 遥测数据项掩码
+ * @details 用于 CMD_TELEMETRY_SUBSCRIBE 的 mask 字段和上报帧的 mask 字段
+ */
+#define AIR8000_TELEMETRY_MOTORS   0x01 ///< 电机状态（位置、速度、扭矩等，每个电机与 CMD_MOTOR_REFRESH 响应格式相同）
+#define AIR8000_TELEMETRY_SENSORS  0x02 ///< 传感器数据（与 CMD_SENSOR_READ_ALL 响应格式相同）
+#define AIR8000_TELEMETRY_POWER    0x04 ///< 电源电压（与 CMD_QUERY_POWER 响应格式相同）
+#define AIR8000_TELEMETRY_ALL      0x07 ///< 全部数据项
+
+/**
+ * @brief 遥测快照中最多保存的电机数
+ */
+#define AIR8000_TELEMETRY_MAX_MOTORS 4
+
+/**
+ * @brief 遥测上报最小周期，单位毫秒
+ */
+#define AIR8000_TELEMETRY_MIN_PERIOD_MS 10
+
+/**
+ * @brief 遥测上报中的单个电机状态
+ * @details 字段含义与 air8000_parse_motor_refresh 的输出相同
+ */
+typedef struct {
+    uint8_t motor_id;   ///< 电机ID
+    uint8_t temp_mos;   ///< MOS温度，单位摄氏度
+    uint8_t temp_rotor; ///< 转子温度，单位摄氏度
+    uint8_t error;      ///< 错误码
+    bool enabled;       ///< 是否使能
+    float position;     ///< 位置，单位弧度
+    float velocity;     ///< 速度，单位弧度/秒
+    float torque;       ///< 扭矩，单位牛米
+} air8000_motor_telemetry_t;
+
+/**
+ * @brief 遥测快照
+ * @details 定长结构，不含指针，可直接按值拷贝。
+ *          上报帧数据格式：[mask u8][tick_ms u32 大端序]，之后按掩码位从低到高依次为
+ *          电机段 [count u8][count 个 17 字节电机记录]、传感器段 5 字节、电源段 4 字节
+ */
+typedef struct {
+    uint32_t seq;               ///< 快照序号，SDK 每解码一帧加一（0 表示尚未收到）
+    uint32_t device_tick_ms;    ///< 设备采样时刻，单位毫秒（设备启动后计时，用于计算采样间隔）
+    uint64_t host_time_ms;      ///< 收到上报帧的本机单调时钟，单位毫秒
+    uint8_t mask;               ///< 本帧包含的数据项
+    uint8_t motor_count;        ///< motors 中的有效电机数
+    air8000_motor_telemetry_t motors[AIR8000_TELEMETRY_MAX_MOTORS]; ///< 电机状态
+    air8000_sensor_data_t sensors;  ///< 传感器数据（mask 含 AIR8000_TELEMETRY_SENSORS 时有效）
+    air8000_power_adc_t power;      ///< 电源电压（mask 含 AIR8000_TELEMETRY_POWER 时有效）
+} air8000_telemetry_t;
+
+/**
+ * @brief 批量旋转中的单个电机子命令
+ * @details 字段含义与 air8000_build_motor_rotate 的参数相同
+ */
+typedef struct {
+    uint8_t motor_id;   ///< 电机ID
+    float angle;        ///< 目标角度，单位弧度
+    float velocity;     ///< 旋转速度，单位弧度/秒
+} air8000_motor_cmd_t;
+
 /**
  * @brief 看门狗配置结构体
  * @details 存储看门狗的配置参数
@@ -364,7 +444,9 @@ typedef enum {
 
 /**
  * @brief 文件传输信息结构体
- * @details 用于文件传输开始时传递文件信息
+ * @details 用于文件传输开始时传递文件信息；trace_id、capture_age_ms 与 mtime 为扩展字段，
+ *          旧固件发送的数据不含这些字段，接收端按数据长度判断。
+ *          crc32 与 mtime 共同标识文件内容，接收端据此判断能否沿用断点续传位图
  */
 typedef struct {
     char filename[256];     ///< 文件名
@@ -372,6 +454,10 @@ typedef struct {
     uint32_t block_size;    ///< 分片大小，单位字节
     uint32_t crc32;         ///< 文件CRC32校验值
     uint8_t file_type;      ///< 文件类型
+    uint8_t reserved[3];    ///< 保留，填 0
+    uint32_t trace_id;      ///< 端到端跟踪ID，0 表示由 CV610 分配
+    uint32_t capture_age_ms; ///< 发送本通知时距离拍摄的毫秒数，0 表示未知
+    uint32_t mtime;         ///< 源文件修改时间（秒），0 表示未知
 } air8000_file_info_t;
 
 /**
@@ -429,6 +515,19 @@ typedef struct {
  */
 uint16_t air8000_crc16_modbus(const uint8_t *data, size_t len);
 
+/**
+ * @brief 设置接收帧 CRC 校验模式
+ * @param enable true 开启校验，parse 系列函数对 CRC 错误的帧返回 -3；默认关闭
+ * @note 全局设置，建议在 air8000_init 之前调用
+ */
+void air8000_frame_set_crc_verify(bool enable);
+
+/**
+ * @brief 获取接收帧 CRC 校验模式
+ * @return true 表示已开启校验
+ */
+bool air8000_frame_get_crc_verify(void);
+
 /**
  * @brief 初始化帧结构
  * @param frame 要初始化的帧指针
@@ -456,10 +555,99 @@ int air8000_frame_encode(const air8000_frame_t *frame, uint8_t *buffer, size_t m
  * @param buffer 要解析的原始数据指针
  * @param len 原始数据长度
  * @param frame 输出帧指针
- * @return 成功返回解析出的帧长度，失败返回负数
+ * @return 成功返回解析出的帧长度，数据不完整返回 -1，帧头无效返回 -2，
+ *         开启 CRC 校验且校验失败返回 -3
  */
 int air8000_frame_parse(const uint8_t *buffer, size_t len, air8000_frame_t *frame);
 
+/**
+ * @brief 零拷贝解析帧数据
+ * @param buffer 要解析的原始数据指针
+ * @param len 原始数据长度
+ * @param frame 输出帧指针，frame->data 直接指向 buffer 内部，不可调用 air8000_frame_cleanup
+ * @return 成功返回解析出的帧长度，数据不完整返回 -1，帧头无效返回 -2，
+ *         开启 CRC 校验且校验失败返回 -3
+ * @note buffer 内容失效前必须用完 frame，需要长期持有时调用 air8000_frame_copy
+ */
+int air8000_frame_parse_view(const uint8_t *buffer, size_t len, air8000_frame_t *frame);
+
+/**
+ * @brief 查找同步字 0xAA55
+ * @param buffer 数据指针
+ * @param len 数据长度
+ * @return 第一个同步字的偏移；未找到时返回可安全丢弃的字节数
+ *         （末尾单个 0xAA 会保留，等待后续 0x55）
+ */
+size_t air8000_frame_find_sync(const uint8_t *buffer, size_t len);
+
+/**
+ * @brief 深拷贝帧
+ * @param dst 目标帧指针，原有数据会被释放
+ * @param src 源帧指针（可以是零拷贝视图）
+ * @return 成功返回0，内存不足返回 -1（此时 dst->data 为 NULL，其余字段已复制）
+ */
+int air8000_frame_copy(air8000_frame_t *dst, const air8000_frame_t *src);
+
+// ==================== 接收环形缓冲区 ====================
+
+/**
+ * @brief 接收环形缓冲区大小
+ * @note 必须为 2 的幂，同时也是可接收的最大帧长度
+ */
+#define AIR8000_RX_RING_SIZE 4096
+
+/**
+ * @brief 接收环形缓冲区
+ * @details 串口数据直接读入环中，air8000_rx_ring_next_frame 返回指向环内部的帧视图，
+ *          消费后只移动读位置，不做 memmove 压缩；跨越环尾的帧拷贝到 linear 后返回
+ */
+typedef struct {
+    uint8_t buf[AIR8000_RX_RING_SIZE];      ///< 环形存储
+    size_t head;                            ///< 读位置（单调递增，取模得到下标）
+    size_t tail;                            ///< 写位置（单调递增，取模得到下标）
+    size_t need;                            ///< 当前帧头已确认时完整帧所需字节数，0 表示未知
+    uint32_t crc_errors;                    ///< 开启 CRC 校验时丢弃的帧数
+    uint8_t linear[AIR8000_RX_RING_SIZE];   ///< 跨越环尾的帧拼接区
+} air8000_rx_ring_t;
+
+/**
+ * @brief 初始化接收环形缓冲区
+ * @param ring 环形缓冲区指针
+ */
+void air8000_rx_ring_init(air8000_rx_ring_t *ring);
+
+/**
+ * @brief 获取环中未消费的字节数
+ * @param ring 环形缓冲区指针
+ * @return 未消费字节数
+ */
+size_t air8000_rx_ring_used(const air8000_rx_ring_t *ring);
+
+/**
+ * @brief 获取可直接写入的连续空间
+ * @param ring 环形缓冲区指针
+ * @param space 输出可写字节数（环满时为 0）
+ * @return 可写区域起始指针，写入后调用 air8000_rx_ring_commit
+ */
+uint8_t *air8000_rx_ring_write_ptr(air8000_rx_ring_t *ring, size_t *space);
+
+/**
+ * @brief 提交已写入的数据
+ * @param ring 环形缓冲区指针
+ * @param len 写入的字节数，不能超过 air8000_rx_ring_write_ptr 返回的 space
+ */
+void air8000_rx_ring_commit(air8000_rx_ring_t *ring, size_t len);
+
+/**
+ * @brief 从环中取出下一个完整帧（零拷贝）
+ * @param ring 环形缓冲区指针
+ * @param frame 输出帧视图，frame->data 指向环内部，不可调用 air8000_frame_cleanup
+ * @return 成功返回帧长度，数据不足返回 0
+ * @details 同步字之前的无效字节通过 memchr 一次性丢弃；长度超过环大小的帧头视为误同步并跳过
+ * @note 帧视图在下一次调用 air8000_rx_ring_next_frame 或 air8000_rx_ring_commit 前有效
+ */
+int air8000_rx_ring_next_frame(air8000_rx_ring_t *ring, air8000_frame_t *frame);
+
 /**
  * @brief 生成下一个帧序列号
  * @return 下一个序列号，范围0-255，循环递增
@@ -540,6 +728,19 @@ void air8000_build_query_network(air8000_frame_t *frame);
  */
 void air8000_build_motor_rotate(air8000_frame_t *frame, uint8_t motor_id, float angle, float velocity);
 
+/**
+ * @brief 构建电机批量旋转请求帧
+ * @param frame 帧对象指针
+ * @param cmds 电机子命令数组
+ * @param count 子命令个数，1 ~ AIR8000_MOTOR_BATCH_MAX
+ * @param start_delay_ms 同步启动延时，单位毫秒：设备收齐整帧后等待该时间再让所有电机同时启动，0 表示立即启动
+ * @return 成功返回0，参数无效返回 -1
+ * @details 数据格式：[count u8][start_delay_ms u16 大端序][count × (motor_id u8, angle f32, velocity f32)]，
+ *          浮点数为网络字节序，与单电机旋转命令一致
+ */
+int air8000_build_motor_rotate_batch(air8000_frame_t *frame, const air8000_motor_cmd_t *cmds,
+                                     size_t count, uint16_t start_delay_ms);
+
 /**
  * @brief 构建电机使能请求帧
  * @param frame 帧对象指针
@@ -660,6 +861,14 @@ void air8000_build_sensor_read(air8000_frame_t *frame, uint8_t sensor_id);
  */
 void air8000_build_sensor_read_all(air8000_frame_t *frame);
 
+/**
+ * @brief 构建遥测订阅请求帧
+ * @param frame 帧对象指针
+ * @param mask 数据项掩码（AIR8000_TELEMETRY_*）
+ * @param period_ms 上报周期，单位毫秒，0 表示取消订阅
+ */
+void air8000_build_telemetry_subscribe(air8000_frame_t *frame, uint8_t mask, uint16_t period_ms);
+
 /**
  * @brief 构建设备控制请求帧
  * @param frame 帧对象指针
@@ -760,6 +969,16 @@ int air8000_parse_motor_read_reg(const uint8_t *data, size_t len, uint8_t *motor
  */
 int air8000_parse_motor_refresh(const uint8_t *data, size_t len, uint8_t *motor_id, float *pos, float *vel, float *torque, uint8_t *temp_mos, uint8_t *temp_rotor, uint8_t *error, bool *enabled);
 
+/**
+ * @brief 解析遥测上报帧
+ * @param data 上报数据指针
+ * @param len 数据长度，单位字节
+ * @param out 输出遥测快照指针（seq 和 host_time_ms 不修改，由调用者填写）
+ * @return 成功返回0，数据不完整返回负数
+ * @details 不分配内存；电机数超过 AIR8000_TELEMETRY_MAX_MOTORS 时只保存前面的电机，其余跳过
+ */
+int air8000_parse_telemetry(const uint8_t *data, size_t len, air8000_telemetry_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,7 @@ extern "C" {
 typedef struct {
     int fd;                     ///< 串口文件描述符
     char device_path[256];      ///< 设备路径，如 "/dev/ttyACM2"
+    bool drain;                 ///< 发送后是否 tcdrain 等待数据发出（打开串口时不修改）
 } air8000_serial_t;
 
 /**
@@ -61,13 +62,23 @@ int air8000_serial_open(air8000_serial_t *serial, const char *path);
  */
 void air8000_serial_close(air8000_serial_t *serial);
 
+/**
+ * @brief 设置发送后是否等待数据发出
+ * @param serial 串口对象指针
+ * @param drain true：每次发送后 tcdrain，直到数据从硬件发出才返回；
+ *              false：数据写入内核发送缓冲区即返回，大块数据不会阻塞调用线程
+ * @note 该设置在重新打开串口后保持不变
+ */
+void air8000_serial_set_drain(air8000_serial_t *serial, bool drain);
+
 /**
  * @brief 向串口发送数据
- * @details 阻塞发送指定长度的数据到串口
+ * @details 发送指定长度的数据到串口，是否等待数据发出由 air8000_serial_set_drain 决定；
+ *          串口以非阻塞方式打开，内核发送缓冲区不足时只写入一部分
  * @param serial 串口对象指针
  * @param data 要发送的数据缓冲区指针
  * @param len 要发送的数据长度，单位字节
- * @return 成功返回实际发送的字节数，失败返回负数错误码
+ * @return 成功返回实际发送的字节数（可能小于 len），发送缓冲区已满返回 0，失败返回负数错误码
  */
 int air8000_serial_write(air8000_serial_t *serial, const uint8_t *data, size_t len);
 
@@ -0,0 +1,70 @@
+/**
+ * @file air8000_trace.h
+ * @brief 串口原始数据跟踪环头文件
+ * @details 在内存中以二进制形式记录串口收发的原始字节，需要排查问题时再导出，
+ *          替代逐次格式化十六进制字符串打印
+ *
+ * 设计要点：
+ * 1. **固定槽位**：环由 64 字节槽位组成，大块数据拆分到连续多个槽位
+ * 2. **无锁写入**：写入者用原子加法领取槽位序号，每个槽位用序号做 seqlock，
+ *    导出时跳过正在写或已被覆盖的槽位，不会阻塞 I/O 线程
+ * 3. **按需开启**：未调用 air8000_trace_enable 时记录函数只做一次判断即返回
+ */
+
+#ifndef AIR8000_TRACE_H
+#define AIR8000_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 数据方向
+ */
+#define AIR8000_TRACE_TX 0   ///< 发送到 Air8000
+#define AIR8000_TRACE_RX 1   ///< 从 Air8000 接收
+
+/**
+ * @brief 默认槽位数（16384 × 64 字节 = 1MB 内存）
+ */
+#define AIR8000_TRACE_DEFAULT_SLOTS 16384
+
+/**
+ * @brief 开启原始数据跟踪
+ * @param slots 槽位数，向上取整为 2 的幂；传 0 使用 AIR8000_TRACE_DEFAULT_SLOTS
+ * @return 成功返回0，内存不足返回 -1
+ * @note 应在 air8000_init 之前调用；重复调用只会重新开启，不会改变容量
+ */
+int air8000_trace_enable(size_t slots);
+
+/**
+ * @brief 暂停原始数据跟踪
+ * @note 不释放内存，已记录的数据仍可导出
+ */
+void air8000_trace_disable(void);
+
+/**
+ * @brief 记录一段原始数据
+ * @param dir 数据方向，AIR8000_TRACE_TX 或 AIR8000_TRACE_RX
+ * @param data 数据指针
+ * @param len 数据长度
+ */
+void air8000_trace_record(uint8_t dir, const uint8_t *data, size_t len);
+
+/**
+ * @brief 以十六进制文本导出跟踪环中的数据
+ * @param fp 输出文件，例如 stdout
+ * @return 导出的记录条数
+ * @details 按时间顺序输出，同一次收发被拆分的槽位合并为一条记录
+ */
+int air8000_trace_dump(FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIR8000_TRACE_H
@@ -14,7 +14,8 @@
  * 1. **分层设计**：采用了清晰的分层架构，包括高级API层、协议层和串口抽象层
  * 2. **多线程模型**：
  *    - 主线程：处理API调用，创建请求并等待响应
- *    - I/O线程：负责串口通信、自动重连、帧解析和响应处理
+ *    - I/O反应器线程：所有上下文共用一个 epoll 线程，负责串口通信、自动重连、帧解析和响应处理，
+ *      增加设备不会增加线程
  * 3. **异步通信**：使用非阻塞I/O和事件驱动模型，提高系统响应性
  * 4. **线程安全**：通过互斥锁和条件变量确保多线程环境下的安全访问
  * 5. **请求响应模型**：采用基于序列号的请求-响应机制，支持超时处理
@@ -25,6 +26,8 @@
 #include "air8000_file_transfer.h"
 #include "air8000_fota.h"
 #include "air8000_log.h"
+#include "pm_metrics.h"
+#include "pm_sched.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -32,18 +35,14 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <errno.h>
-
-/**
- * @brief 接收缓冲区大小
- * @note 足够大以容纳多个完整帧，避免频繁内存分配
- */
-#define MAX_RX_BUFFER 4096
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 /**
  * @brief 发送缓冲区大小
- * @note 足够大以容纳单个完整帧
+ * @note 容纳协议允许的最大单帧（1KB 文件分片/固件包加上分片头和帧头远小于此）
  */
-#define MAX_TX_BUFFER 1024
+#define MAX_TX_BUFFER AIR8000_MAX_FRAME
 
 /**
  * @brief 自动重连间隔（毫秒）
@@ -52,12 +51,40 @@
 #define RECONNECT_INTERVAL_MS 1000
 
 /**
- * @brief I/O 线程轮询间隔（毫秒）
- * @note 控制 I/O 线程的休眠时间，平衡响应速度和 CPU 占用
+ * @brief I/O 线程最长空闲等待时间（毫秒）
+ * @note 反应器线程阻塞在 epoll_wait(各串口 fd + 共用 eventfd) 上，新请求通过 eventfd 立即唤醒，
+ *       有请求待超时时等待到最近的超时时刻，此值只是没有任何事件时的上限
+ */
+#define IO_THREAD_IDLE_MS 1000
+
+/**
+ * @brief 最大待处理请求数
+ * @note 待处理请求以 8 位 seq 唯一索引，因此不会超过 256 个，发送环和超时堆按此分配
+ */
+#define MAX_PENDING_REQUESTS 256
+
+/**
+ * @brief 请求负载内联存储大小
+ * @details 不超过该长度的请求数据（电机/查询类命令）直接存放在请求槽位中，不再 malloc
+ */
+#define REQUEST_INLINE_DATA 64
+
+/**
+ * @brief 重连后重新下发遥测订阅的超时时间（毫秒）
+ */
+#define TELEMETRY_RESUBSCRIBE_TIMEOUT_MS 1000
+
+/**
+ * @brief 反应器单次 epoll_wait 最多取出的事件数（每个上下文一个串口 fd，外加共用的 eventfd）
  */
-#define IO_THREAD_POLL_MS 10
+#define REACTOR_MAX_EVENTS (AIR8000_MAX_CONTEXTS + 1)
 
-// ==================== 全局单例变量 ====================
+/**
+ * @brief 反应器共用 eventfd 的事件标识
+ */
+#define REACTOR_KEY_WAKE UINT64_MAX
+
+// ==================== 全局变量 ====================
 
 /**
  * @brief Air8000 全局单例实例
@@ -71,6 +98,12 @@ static air8000_t *g_air8000_instance = NULL;
  */
 static pthread_mutex_t g_instance_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * @brief 反应器启动/停止互斥锁
+ * @note 串行化上下文的注册与注销，反应器线程本身不获取该锁
+ */
+static pthread_mutex_t g_reactor_lifecycle = PTHREAD_MUTEX_INITIALIZER;
+
 // ==================== 数据结构定义 ====================
 
 /**
@@ -93,16 +126,28 @@ typedef struct request_s {
     air8000_frame_t *resp_frame;    /**< 响应帧指针，用于回填响应数据 */
     
     // 同步控制
-    pthread_mutex_t mutex;          /**< 保护请求状态的互斥锁 */
-    pthread_cond_t cond;            /**< 用于等待响应的条件变量 */
+    pthread_cond_t cond;            /**< 用于等待响应的条件变量（配合 ctx_mutex 使用，init 时初始化一次） */
+    bool in_use;                    /**< 槽位是否被占用（从提交到结果被取走为止） */
     request_state_t state;          /**< 请求当前状态 */
     int result_code;                /**< 请求结果码 (0=OK, <0=Error) */
     bool sent;                      /**< 请求是否已发送 */
     
     uint64_t timeout_ms;            /**< 请求超时时间（毫秒） */
     uint64_t start_time;            /**< 请求开始时间（毫秒时间戳） */
+    uint64_t sent_us;               /**< 写出串口的时间（单调时钟微秒），用于统计 RTT */
+    
+    // 异步请求
+    air8000_async_cb_t async_cb;    /**< 异步完成回调（NULL 表示同步请求） */
+    void *async_user_data;          /**< 异步回调用户数据 */
+    air8000_frame_t async_resp;     /**< 异步请求的响应帧存储 */
+    
+    // 队列位置
+    bool queued;                    /**< 是否仍在发送环中 */
+    int heap_index;                 /**< 在超时堆中的下标（-1 表示不在堆中） */
     
-    struct request_s *next;         /**< 链表下一个请求 */
+    struct request_s *next;         /**< 完成链表下一个请求 */
+    
+    uint8_t inline_data[REQUEST_INLINE_DATA]; /**< 小负载内联存储 */
 } request_t;
 
 /**
@@ -113,33 +158,98 @@ struct air8000_s {
     air8000_serial_t serial;        /**< 串口对象 */
     char device_path[256];          /**< 设备路径 */
     
-    // 线程相关
-    pthread_t io_thread;            /**< I/O 线程 ID */
-    bool running;                   /**< I/O 线程运行标志 */
+    // 反应器相关
+    int reactor_slot;               /**< 在 I/O 反应器中的槽位 */
+    bool running;                   /**< 上下文运行标志（销毁时置为 false） */
     bool connected;                 /**< 串口连接状态 */
+    uint64_t last_reconnect_time;   /**< 上次尝试重连的时间（仅反应器线程访问） */
+    
+    pthread_mutex_t ctx_mutex;      /**< 上下文互斥锁（保护请求队列和 connected） */
+    int wake_fd;                    /**< 反应器共用的 eventfd，提交请求时唤醒 I/O 线程（不归上下文所有） */
+    
+    // 发送环：按提交顺序排队的未发送请求
+    request_t *tx_ring[MAX_PENDING_REQUESTS];
+    size_t tx_head;                 /**< 发送环读位置 */
+    size_t tx_count;                /**< 发送环中的请求数 */
+    
+    // 部分写出的帧：串口 fd 非阻塞，短写时剩余字节留在这里，写完前不发送后续帧（仅反应器线程写串口）
+    uint8_t tx_partial[MAX_TX_BUFFER]; /**< 正在写出的已编码帧 */
+    size_t tx_partial_len;          /**< 帧总长度，0 表示没有部分写出的帧 */
+    size_t tx_partial_off;          /**< 已写出的字节数 */
+    request_t *tx_partial_req;      /**< 该帧对应的请求（仍在发送环首），中途结束时置 NULL */
+    bool tx_want_out;               /**< 串口 fd 是否已注册 EPOLLOUT */
     
-    pthread_mutex_t ctx_mutex;      /**< 上下文互斥锁（保护 pending_list 和 connected） */
+    // 超时堆：按截止时间排序的最小堆，包含所有待处理请求
+    request_t *timeout_heap[MAX_PENDING_REQUESTS];
+    size_t heap_size;               /**< 超时堆元素个数 */
     
-    request_t *pending_list;        /**< 待处理请求链表（发送队列 + 等待队列） */
     request_t *pending_map[256];    /**< 请求映射表（用于 O(1) 查找，索引为 seq） */
+    request_t req_pool[256];        /**< 请求对象池（索引为 seq，与 pending_map 一一对应） */
+    int requests_in_use;            /**< 已领取未归还的槽位数（销毁时等待归零） */
+    
+    int motor_batch_support;        /**< 固件是否支持批量旋转命令：-1 未知，0 不支持，1 支持 */
+    void *file_transfer;            /**< 文件传输模块状态（由 air8000_file_transfer.c 管理） */
+    
+    // 异步流水线窗口
+    pthread_cond_t window_cond;     /**< 在途异步请求数减少时广播 */
+    int async_window;               /**< 异步请求最大在途数 */
+    int async_inflight;             /**< 当前在途异步请求数 */
     
     // 回调函数
     air8000_notify_cb_t notify_cb;  /**< 通知回调函数 */
     void *notify_user_data;         /**< 回调函数用户数据 */
     
+    // 遥测订阅：快照双缓冲由 I/O 线程写入，读者按代数校验无锁读取
+    air8000_telemetry_t telemetry[2];   /**< 快照双缓冲 */
+    uint32_t telemetry_gen[2];          /**< 各缓冲的写入代数（奇数表示正在写入） */
+    int telemetry_published;            /**< 最新发布的缓冲下标（-1 表示尚未收到上报） */
+    uint32_t telemetry_seq;             /**< 已解码的上报帧数（仅 I/O 线程访问） */
+    uint8_t telemetry_mask;             /**< 当前订阅的数据项（0 表示未订阅，重连后据此重新订阅） */
+    uint16_t telemetry_period_ms;       /**< 当前订阅的上报周期 */
+    air8000_telemetry_cb_t telemetry_cb; /**< 遥测回调函数 */
+    void *telemetry_user_data;          /**< 遥测回调用户数据 */
+    
     // 接收缓冲
-    uint8_t rx_buffer[MAX_RX_BUFFER]; /**< 接收缓冲区 */
-    size_t rx_len;                  /**< 接收缓冲区中有效数据长度 */
+    air8000_rx_ring_t rx_ring;      /**< 接收环形缓冲区（帧以零拷贝视图方式取出） */
 };
 
+/**
+ * @brief I/O 反应器
+ * @details 进程内所有上下文共用一个 epoll 线程：共用一个 eventfd 接收唤醒，每个已连接的串口 fd 注册一次。
+ *          第一个上下文创建时启动，最后一个销毁时停止。
+ *          反应器线程在锁内取出要服务的上下文并记入 busy，随后释放 mutex 再做 I/O 和 SDK 回调，
+ *          回调中可以调用 air8000_set_io_sched、创建或销毁其他上下文；注销上下文时等待它不再是 busy，
+ *          即可确保其不再被访问；epoll 事件以 (槽位, 代数) 标识上下文，槽位被释放后迟到的事件会被丢弃
+ */
+typedef struct {
+    pthread_mutex_t mutex;          /**< 保护槽位表和 busy */
+    pthread_cond_t idle_cond;       /**< busy 清除时广播 */
+    pthread_t thread;               /**< 反应器线程 */
+    int epoll_fd;                   /**< epoll 实例 */
+    int wake_fd;                    /**< 所有上下文共用的 eventfd */
+    bool running;                   /**< 反应器线程运行标志 */
+    int refs;                       /**< 已注册的上下文数 */
+    air8000_t *slots[AIR8000_MAX_CONTEXTS]; /**< 上下文槽位 */
+    air8000_t *busy;                /**< 反应器线程正在服务（不持锁）的上下文，NULL 表示没有 */
+    uint32_t gens[AIR8000_MAX_CONTEXTS];    /**< 槽位代数，每次释放加一 */
+    pm_sched_profile_t io_sched;    /**< 反应器线程的调度配置 */
+    uint32_t io_sched_gen;          /**< 调度配置版本，每次设置加一，0 表示未设置 */
+} reactor_t;
+
 // ==================== 辅助函数声明 ====================
 
 /**
- * @brief I/O 线程函数
- * @param arg 上下文指针
- * @return NULL
+ * @brief I/O 反应器实例
  */
-static void *io_thread_func(void *arg);
+static reactor_t g_reactor = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .idle_cond = PTHREAD_COND_INITIALIZER,
+    .epoll_fd = -1,
+    .wake_fd = -1
+};
+
+static int reactor_attach(air8000_t *ctx);
+static void reactor_detach(air8000_t *ctx);
 
 /**
  * @brief 获取当前时间戳（毫秒）
@@ -147,6 +257,13 @@ static void *io_thread_func(void *arg);
  */
 static uint64_t get_time_ms();
 
+static void finish_request_locked(air8000_t *ctx, request_t *r, request_state_t state,
+                                  int result, request_t **done_list);
+static void dispatch_async_done(air8000_t *ctx, request_t *done_list);
+static void wake_io_thread(air8000_t *ctx);
+static void request_pool_init(air8000_t *ctx);
+static void request_pool_destroy(air8000_t *ctx);
+
 // static void cleanup_request(request_t *req);
 
 // ==================== 初始化与销毁 ====================
@@ -161,7 +278,7 @@ static uint64_t get_time_ms();
  * 3. 设置设备路径（支持默认路径）
  * 4. 初始化互斥锁
  * 5. 尝试打开串口（非阻塞，允许后台重连）
- * 6. 启动 I/O 线程
+ * 6. 注册到 I/O 反应器（第一个上下文时启动反应器线程）
  */
 air8000_t* air8000_init(const char *device_path) {
     air8000_t *ctx = (air8000_t *)malloc(sizeof(air8000_t));
@@ -175,6 +292,17 @@ air8000_t* air8000_init(const char *device_path) {
     
     // 初始化上下文互斥锁
     pthread_mutex_init(&ctx->ctx_mutex, NULL);
+    pthread_cond_init(&ctx->window_cond, NULL);
+    request_pool_init(ctx);
+    ctx->async_window = AIR8000_DEFAULT_ASYNC_WINDOW;
+    ctx->motor_batch_support = -1;
+    ctx->telemetry_published = -1;
+    air8000_rx_ring_init(&ctx->rx_ring);
+    ctx->reactor_slot = -1;
+    ctx->wake_fd = -1;
+    
+    // I/O 线程只把数据写入内核缓冲区，不等待 tcdrain，避免大块数据阻塞收发
+    air8000_serial_set_drain(&ctx->serial, false);
     
     // 初始尝试打开串口 (不强制成功，允许后台重连)
     if (air8000_serial_open(&ctx->serial, path) == 0) {
@@ -187,11 +315,13 @@ air8000_t* air8000_init(const char *device_path) {
         ctx->serial.fd = -1;
     }
     
-    // 启动 I/O 线程
+    // 注册到 I/O 反应器
     ctx->running = true;
-    if (pthread_create(&ctx->io_thread, NULL, io_thread_func, ctx) != 0) {
-        perror("pthread_create");
+    ctx->last_reconnect_time = get_time_ms();
+    if (reactor_attach(ctx) != 0) {
         air8000_serial_close(&ctx->serial);
+        request_pool_destroy(ctx);
+        pthread_cond_destroy(&ctx->window_cond);
         pthread_mutex_destroy(&ctx->ctx_mutex);
         free(ctx);
         return NULL;
@@ -205,46 +335,94 @@ air8000_t* air8000_init(const char *device_path) {
     return ctx;
 }
 
+/**
+ * @brief 按选项初始化 Air8000 上下文
+ * @param opts 初始化选项，NULL 等同于 air8000_init(NULL)
+ * @return 成功返回上下文指针，失败返回 NULL
+ */
+air8000_t* air8000_init_ex(const air8000_init_options_t *opts) {
+    if (!opts) {
+        return air8000_init(NULL);
+    }
+    if (opts->io_sched) {
+        air8000_set_io_sched(opts->io_sched);
+    }
+    return air8000_init(opts->device_path);
+}
+
+/**
+ * @brief 设置 I/O 反应器线程的调度配置
+ * @param profile 调度配置（内容被拷贝）
+ * @return 成功返回 AIR8000_OK，profile 为 NULL 返回 AIR8000_ERR_PARAM
+ */
+int air8000_set_io_sched(const struct pm_sched_profile *profile) {
+    if (!profile) {
+        return AIR8000_ERR_PARAM;
+    }
+    reactor_t *r = &g_reactor;
+    pthread_mutex_lock(&r->mutex);
+    r->io_sched = *profile;
+    r->io_sched_gen++;
+    if (r->io_sched_gen == 0) {
+        r->io_sched_gen = 1;
+    }
+    // 反应器未运行时由启动后的第一轮循环应用；持锁写入，reactor_stop 关闭 wake_fd 前必先在锁内清除 running
+    if (r->running) {
+        uint64_t one = 1;
+        ssize_t n = write(r->wake_fd, &one, sizeof(one));
+        (void)n;
+    }
+    pthread_mutex_unlock(&r->mutex);
+    return AIR8000_OK;
+}
+
 /**
  * @brief 销毁 Air8000 上下文
  * @param ctx 上下文指针
  * @details 该函数完成以下工作：
- * 1. 停止 I/O 线程
+ * 1. 从 I/O 反应器注销（最后一个上下文时停止反应器线程），此后反应器不再访问该上下文
  * 2. 关闭串口
  * 3. 清理所有待处理请求（唤醒等待线程并设置错误状态）
- * 4. 销毁互斥锁
- * 5. 释放上下文内存
+ * 4. 销毁文件传输模块（等待正在发送文件的线程退出）
+ * 5. 销毁互斥锁
+ * 6. 释放上下文内存
  */
 void air8000_deinit(air8000_t *ctx) {
     if (ctx) {
-        // 停止 I/O 线程
+        // 拒绝新请求，然后从反应器注销
+        pthread_mutex_lock(&ctx->ctx_mutex);
         ctx->running = false;
-        pthread_join(ctx->io_thread, NULL);
-        
-        // 销毁文件传输模块
-        air8000_file_transfer_deinit();
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        reactor_detach(ctx);
         
         // FOTA升级模块现在按需销毁，不需要在这里调用
         
         // 清理串口资源
         air8000_serial_close(&ctx->serial);
         
-        // 清理所有待处理请求
+        // 清理所有待处理请求（同步请求唤醒等待者，异步请求回调 SHUTDOWN）
+        request_t *done_list = NULL;
         pthread_mutex_lock(&ctx->ctx_mutex);
-        request_t *curr = ctx->pending_list;
-        while (curr) {
-            request_t *next = curr->next;
-            // 唤醒等待者并设置错误状态
-            pthread_mutex_lock(&curr->mutex);
-            curr->state = REQ_STATE_ERROR;
-            curr->result_code = AIR8000_ERR_SHUTDOWN; // 系统正在关闭
-            pthread_cond_signal(&curr->cond);
-            pthread_mutex_unlock(&curr->mutex);
-            curr = next;
+        while (ctx->heap_size > 0) {
+            finish_request_locked(ctx, ctx->timeout_heap[0], REQ_STATE_ERROR, AIR8000_ERR_SHUTDOWN, &done_list);
         }
+        pthread_cond_broadcast(&ctx->window_cond); // 唤醒等待窗口的提交者
         pthread_mutex_unlock(&ctx->ctx_mutex);
+        dispatch_async_done(ctx, done_list);
         
-        // 销毁互斥锁
+        // 销毁文件传输模块：在途分片已失败，等待中的发送线程可以退出
+        air8000_file_transfer_deinit(ctx);
+        
+        // 等待被唤醒的同步调用者归还请求槽位（槽位位于上下文内部）
+        pthread_mutex_lock(&ctx->ctx_mutex);
+        while (ctx->requests_in_use > 0) {
+            pthread_cond_wait(&ctx->window_cond, &ctx->ctx_mutex);
+        }
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        
+        // 销毁互斥锁（eventfd 归反应器所有）
+        request_pool_destroy(ctx);
+        pthread_cond_destroy(&ctx->window_cond);
         pthread_mutex_destroy(&ctx->ctx_mutex);
         // 释放上下文内存
         free(ctx);
@@ -267,6 +445,26 @@ void air8000_set_notify_callback(air8000_t *ctx, air8000_notify_cb_t cb, void *u
     }
 }
 
+/**
+ * @brief 获取上下文上挂载的文件传输模块状态
+ * @param ctx 上下文指针
+ * @return 模块状态指针，未初始化返回 NULL
+ */
+void *air8000_get_file_transfer_data(air8000_t *ctx) {
+    return ctx ? ctx->file_transfer : NULL;
+}
+
+/**
+ * @brief 设置上下文上挂载的文件传输模块状态
+ * @param ctx 上下文指针
+ * @param data 模块状态指针
+ */
+void air8000_set_file_transfer_data(air8000_t *ctx, void *data) {
+    if (ctx) {
+        ctx->file_transfer = data;
+    }
+}
+
 /**
  * @brief 获取当前时间戳（毫秒）
  * @return 当前时间戳
@@ -281,423 +479,1554 @@ static uint64_t get_time_ms() {
 // ==================== 请求处理逻辑 ====================
 
 /**
- * @brief 创建请求对象
- * @param req 请求帧指针
+ * @brief 初始化请求对象池
+ * @param ctx 上下文指针
+ * @details 每个槽位的条件变量只在这里初始化一次，之后的请求直接复用
+ */
+static void request_pool_init(air8000_t *ctx) {
+    for (int i = 0; i < 256; i++) {
+        pthread_cond_init(&ctx->req_pool[i].cond, NULL);
+        ctx->req_pool[i].heap_index = -1;
+    }
+}
+
+/**
+ * @brief 销毁请求对象池
+ * @param ctx 上下文指针
+ */
+static void request_pool_destroy(air8000_t *ctx) {
+    for (int i = 0; i < 256; i++) {
+        pthread_cond_destroy(&ctx->req_pool[i].cond);
+    }
+}
+
+/**
+ * @brief 从对象池领取请求槽位（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param req 请求帧指针，req->seq 决定使用的槽位
  * @param resp 响应帧指针（用于回填响应数据，可为NULL）
  * @param timeout_ms 请求超时时间（毫秒）
- * @return 成功返回请求对象指针，失败返回NULL
+ * @param take_data 为 true 时接管 req->data（须为 malloc 分配），成功返回后由槽位负责释放
+ * @param out 输出请求对象指针
+ * @return 成功返回0，序列号对应槽位仍被占用返回 AIR8000_ERR_BUSY，内存不足返回 AIR8000_ERR_NOMEM
  * @details 该函数完成以下工作：
- * 1. 分配请求对象内存
- * 2. 深拷贝请求帧数据
- * 3. 初始化请求状态和同步原语
- * 4. 设置超时时间和开始时间
+ * 1. 按 seq 定位槽位并检查占用
+ * 2. 拷贝请求帧数据（不超过 REQUEST_INLINE_DATA 时存放在槽位内，否则 malloc；接管时直接使用原缓冲区）
+ * 3. 重置请求状态并设置超时时间和开始时间
  */
-static request_t* create_request(const air8000_frame_t *req, air8000_frame_t *resp, int timeout_ms) {
-    request_t *r = (request_t *)malloc(sizeof(request_t));
-    if (!r) return NULL;
-    
-    memset(r, 0, sizeof(request_t));
+static int acquire_request_locked(air8000_t *ctx, const air8000_frame_t *req, air8000_frame_t *resp,
+                                  int timeout_ms, bool take_data, request_t **out) {
+    request_t *r = &ctx->req_pool[req->seq];
+    if (r->in_use) {
+        return AIR8000_ERR_BUSY;
+    }
     
-    // 深拷贝请求数据
+    // 拷贝请求数据
     r->req_frame = *req;
-    r->req_frame.data = NULL; // 先初始化为NULL，避免后续free错误
+    r->req_frame.data = NULL;
     if (req->data_len > 0 && req->data) {
-        r->req_frame.data = malloc(req->data_len);
-        if (r->req_frame.data) {
-            memcpy(r->req_frame.data, req->data, req->data_len);
+        if (req->data_len <= REQUEST_INLINE_DATA) {
+            r->req_frame.data = r->inline_data;
+        } else if (take_data) {
+            r->req_frame.data = req->data;
         } else {
-            free(r);
-            return NULL;
+            r->req_frame.data = (uint8_t *)malloc(req->data_len);
+            if (!r->req_frame.data) {
+                return AIR8000_ERR_NOMEM;
+            }
+        }
+        if (r->req_frame.data != req->data) {
+            memcpy(r->req_frame.data, req->data, req->data_len);
+            if (take_data) {
+                free(req->data);
+            }
         }
     } else if (req->data_len > 0) {
         // 修复：当data_len > 0但data为NULL时，将data_len设为0，避免创建请求失败
         r->req_frame.data_len = 0;
     }
     
+    r->in_use = true;
+    ctx->requests_in_use++;
     r->resp_frame = resp;
     r->timeout_ms = timeout_ms;
     r->start_time = get_time_ms();
     r->state = REQ_STATE_PENDING;
+    r->result_code = AIR8000_OK;
     r->sent = false;
+    r->queued = false;
+    r->heap_index = -1;
+    r->async_cb = NULL;
+    r->async_user_data = NULL;
+    r->next = NULL;
+    
+    *out = r;
+    return AIR8000_OK;
+}
+
+/**
+ * @brief 归还请求槽位（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param r 请求对象指针
+ * @details 释放超出内联存储的请求数据和异步响应数据，槽位可再次被同一 seq 使用
+ */
+static void release_request_locked(air8000_t *ctx, request_t *r) {
+    if (r->req_frame.data && r->req_frame.data != r->inline_data) {
+        free(r->req_frame.data);
+    }
+    r->req_frame.data = NULL;
+    
+    if (r->async_cb) {
+        air8000_frame_cleanup(&r->async_resp);
+    }
+    r->in_use = false;
+    
+    // 销毁上下文时等待所有同步等待者归还槽位
+    if (--ctx->requests_in_use == 0 && !ctx->running) {
+        pthread_cond_broadcast(&ctx->window_cond);
+    }
+}
+
+/**
+ * @brief 唤醒 I/O 线程
+ * @param ctx 上下文指针
+ * @details 向反应器共用的 eventfd 写入计数，使阻塞在 epoll_wait 上的反应器线程立即返回
+ */
+static void wake_io_thread(air8000_t *ctx) {
+    uint64_t one = 1;
+    ssize_t n = write(ctx->wake_fd, &one, sizeof(one));
+    (void)n; // 计数器已满时写入失败也无妨，I/O 线程必然会被唤醒
+}
+
+/**
+ * @brief 上下文串口 fd 的 epoll 事件标识
+ */
+static inline uint64_t reactor_key(int slot) {
+    return ((uint64_t)g_reactor.gens[slot] << 8) | (uint64_t)slot;
+}
+
+/**
+ * @brief 把已打开的串口 fd 注册到反应器（调用者需持有 ctx_mutex）
+ */
+static void watch_serial_locked(air8000_t *ctx) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = reactor_key(ctx->reactor_slot);
+    if (epoll_ctl(g_reactor.epoll_fd, EPOLL_CTL_ADD, ctx->serial.fd, &ev) != 0) {
+        log_error("air8000", "epoll_ctl ADD %s failed: %s", ctx->device_path, strerror(errno));
+    }
+}
+
+/**
+ * @brief 开启或关闭串口 fd 的可写通知（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param want 是否需要 EPOLLOUT：有部分写出的帧时开启，写完后关闭
+ */
+static void watch_serial_out_locked(air8000_t *ctx, bool want) {
+    if (ctx->tx_want_out == want || ctx->serial.fd < 0) {
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = want ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u64 = reactor_key(ctx->reactor_slot);
+    if (epoll_ctl(g_reactor.epoll_fd, EPOLL_CTL_MOD, ctx->serial.fd, &ev) != 0) {
+        log_error("air8000", "epoll_ctl MOD %s failed: %s", ctx->device_path, strerror(errno));
+        return;
+    }
+    ctx->tx_want_out = want;
+}
+
+/**
+ * @brief 标记断开并关闭串口（调用者需持有 ctx_mutex）
+ * @details 先从 epoll 中移除再关闭，避免 fd 号被复用时收到旧 fd 的事件；
+ *          部分写出的帧随连接作废，其请求仍在发送环首，重连后整帧重发
+ */
+static void disconnect_serial_locked(air8000_t *ctx) {
+    ctx->connected = false;
+    if (ctx->serial.fd >= 0) {
+        epoll_ctl(g_reactor.epoll_fd, EPOLL_CTL_DEL, ctx->serial.fd, NULL);
+    }
+    air8000_serial_close(&ctx->serial);
+    ctx->tx_partial_len = 0;
+    ctx->tx_partial_off = 0;
+    ctx->tx_partial_req = NULL;
+    ctx->tx_want_out = false;
+}
+
+/**
+ * @brief 请求的超时截止时间（毫秒时间戳）
+ */
+static inline uint64_t request_deadline(const request_t *r) {
+    return r->start_time + r->timeout_ms;
+}
+
+/**
+ * @brief 交换超时堆中的两个元素并更新下标
+ */
+static void heap_swap(air8000_t *ctx, size_t a, size_t b) {
+    request_t *tmp = ctx->timeout_heap[a];
+    ctx->timeout_heap[a] = ctx->timeout_heap[b];
+    ctx->timeout_heap[b] = tmp;
+    ctx->timeout_heap[a]->heap_index = (int)a;
+    ctx->timeout_heap[b]->heap_index = (int)b;
+}
+
+/**
+ * @brief 超时堆上浮
+ */
+static void heap_sift_up(air8000_t *ctx, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (request_deadline(ctx->timeout_heap[parent]) <= request_deadline(ctx->timeout_heap[i])) {
+            break;
+        }
+        heap_swap(ctx, i, parent);
+        i = parent;
+    }
+}
+
+/**
+ * @brief 超时堆下沉
+ */
+static void heap_sift_down(air8000_t *ctx, size_t i) {
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t smallest = i;
+        if (left < ctx->heap_size &&
+            request_deadline(ctx->timeout_heap[left]) < request_deadline(ctx->timeout_heap[smallest])) {
+            smallest = left;
+        }
+        if (right < ctx->heap_size &&
+            request_deadline(ctx->timeout_heap[right]) < request_deadline(ctx->timeout_heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        heap_swap(ctx, i, smallest);
+        i = smallest;
+    }
+}
+
+/**
+ * @brief 从超时堆中移除请求（调用者需持有 ctx_mutex）
+ * @details O(log n)，请求自身记录堆下标，无需遍历
+ */
+static void heap_remove_locked(air8000_t *ctx, request_t *r) {
+    if (r->heap_index < 0) {
+        return;
+    }
+    size_t i = (size_t)r->heap_index;
+    size_t last = --ctx->heap_size;
+    if (i != last) {
+        heap_swap(ctx, i, last);
+        heap_sift_down(ctx, i);
+        heap_sift_up(ctx, i);
+    }
+    r->heap_index = -1;
+}
+
+/**
+ * @brief 从发送环中移除尚未发送的请求（调用者需持有 ctx_mutex）
+ * @details 只在未发送就超时/关闭时发生（如串口断开期间），按顺序压缩发送环；
+ *          请求的帧已部分写出时剩余字节照常写完，保持串口上的帧边界
+ */
+static void tx_ring_remove_locked(air8000_t *ctx, request_t *r) {
+    if (ctx->tx_partial_req == r) {
+        ctx->tx_partial_req = NULL;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < ctx->tx_count; i++) {
+        request_t *q = ctx->tx_ring[(ctx->tx_head + i) % MAX_PENDING_REQUESTS];
+        if (q != r) {
+            ctx->tx_ring[(ctx->tx_head + kept) % MAX_PENDING_REQUESTS] = q;
+            kept++;
+        }
+    }
+    ctx->tx_count = kept;
+    r->queued = false;
+}
+
+/**
+ * @brief 将请求加入发送环、超时堆和映射表（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param r 请求对象指针
+ * @details 序列号冲突已在 acquire_request_locked 中检查（槽位与 seq 一一对应）；发送环保证 I/O 线程按提交顺序发送，流水线分片不会被倒序发出
+ */
+static void enqueue_request_locked(air8000_t *ctx, request_t *r) {
+    ctx->tx_ring[(ctx->tx_head + ctx->tx_count) % MAX_PENDING_REQUESTS] = r;
+    ctx->tx_count++;
+    r->queued = true;
+    
+    r->heap_index = (int)ctx->heap_size;
+    ctx->timeout_heap[ctx->heap_size++] = r;
+    heap_sift_up(ctx, (size_t)r->heap_index);
+    
+    ctx->pending_map[r->req_frame.seq] = r; // 添加到映射表（用于O(1)查找）
+    
+    wake_io_thread(ctx);
+}
+
+/**
+ * @brief 结束请求（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param r 请求对象指针
+ * @param state 最终状态
+ * @param result 结果码
+ * @param done_list 异步请求完成链表，释放 ctx_mutex 后交给 dispatch_async_done 处理
+ * @details 请求从所有索引中移除后：同步请求设置状态并唤醒等待线程，由等待线程归还槽位；
+ *          异步请求挂到 done_list，避免持锁调用用户回调
+ */
+static void finish_request_locked(air8000_t *ctx, request_t *r, request_state_t state,
+                                  int result, request_t **done_list) {
+    // 从映射表、超时堆和发送环中移除
+    if (ctx->pending_map[r->req_frame.seq] == r) {
+        ctx->pending_map[r->req_frame.seq] = NULL;
+    }
+    heap_remove_locked(ctx, r);
+    if (r->queued) {
+        tx_ring_remove_locked(ctx, r);
+    }
+    
+    if (r->async_cb) {
+        r->state = state;
+        r->result_code = result;
+        r->next = *done_list;
+        *done_list = r;
+        
+        // 释放窗口
+        ctx->async_inflight--;
+        pthread_cond_broadcast(&ctx->window_cond);
+        return;
+    }
+    
+    r->state = state;
+    r->result_code = result;
+    pthread_cond_signal(&r->cond);
+}
+
+/**
+ * @brief 调用已完成异步请求的回调并归还请求槽位
+ * @param ctx 上下文指针
+ * @param done_list 完成链表（不可持有 ctx_mutex 调用）
+ */
+static void dispatch_async_done(air8000_t *ctx, request_t *done_list) {
+    while (done_list) {
+        request_t *next = done_list->next;
+        const air8000_frame_t *resp = (done_list->state == REQ_STATE_COMPLETED) ? &done_list->async_resp : NULL;
+        done_list->async_cb(ctx, done_list->result_code, &done_list->req_frame, resp, done_list->async_user_data);
+        
+        pthread_mutex_lock(&ctx->ctx_mutex);
+        release_request_locked(ctx, done_list);
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        done_list = next;
+    }
+}
+
+/**
+ * @brief 发送请求并等待响应
+ * @param ctx 上下文指针
+ * @param req 请求帧指针
+ * @param resp 响应帧指针（用于回填响应数据，可为NULL）
+ * @param timeout_ms 请求超时时间（毫秒）
+ * @return 成功返回0，失败返回错误码
+ * @details 该函数完成以下工作：
+ * 1. 参数校验
+ * 2. 从对象池领取 seq 对应的请求槽位（同时检查序列号冲突）
+ * 3. 将请求加入待处理队列和映射表
+ * 4. 等待请求完成（阻塞直到收到响应或超时）
+ * 5. 归还请求槽位并返回结果
+ * 热路径上不涉及 malloc 和同步原语初始化，只有条件变量等待
+ */
+int air8000_send_and_wait(air8000_t *ctx, const air8000_frame_t *req, air8000_frame_t *resp, int timeout_ms) {
+    if (!ctx || !req) return AIR8000_ERR_PARAM;
+    
+    // 领取请求槽位并加入队列和映射表（同时检查序列号冲突）
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    if (!ctx->running) {
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        return AIR8000_ERR_SHUTDOWN;
+    }
+    request_t *r = NULL;
+    int ret = acquire_request_locked(ctx, req, resp, timeout_ms, false, &r);
+    if (ret != AIR8000_OK) {
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        return ret;
+    }
+    enqueue_request_locked(ctx, r);
+    
+    // 等待结果
+    while (r->state == REQ_STATE_PENDING) {
+        pthread_cond_wait(&r->cond, &ctx->ctx_mutex);
+    }
+    int result = r->result_code;
+    
+    // I/O 线程在唤醒前已将请求从所有队列中移除，这里直接归还槽位
+    release_request_locked(ctx, r);
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    return result;
+}
+
+/**
+ * @brief 一次提交多个请求并等待全部完成
+ * @param ctx 上下文指针
+ * @param reqs 请求帧数组
+ * @param resps 响应帧数组（与 reqs 一一对应，不可为NULL）
+ * @param count 请求个数
+ * @param timeout_ms 每个请求的超时时间（毫秒）
+ * @return 全部收到响应返回0，否则返回第一个失败请求的错误码
+ * @details 所有请求在同一次持锁中进入发送环，I/O 线程会把它们连续写出，
+ *          帧与帧之间没有往返等待；适合需要几乎同时生效的一组命令
+ */
+static int send_burst_and_wait(air8000_t *ctx, const air8000_frame_t *reqs, air8000_frame_t *resps,
+                               size_t count, int timeout_ms) {
+    request_t *slots[AIR8000_MOTOR_BATCH_MAX];
+    if (count == 0 || count > AIR8000_MOTOR_BATCH_MAX) return AIR8000_ERR_PARAM;
+    
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    if (!ctx->running) {
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        return AIR8000_ERR_SHUTDOWN;
+    }
+    
+    // 先领取全部槽位，任何一个失败都不提交
+    size_t acquired = 0;
+    int ret = AIR8000_OK;
+    while (acquired < count) {
+        ret = acquire_request_locked(ctx, &reqs[acquired], &resps[acquired], timeout_ms, false, &slots[acquired]);
+        if (ret != AIR8000_OK) {
+            break;
+        }
+        acquired++;
+    }
+    if (ret != AIR8000_OK) {
+        while (acquired > 0) {
+            release_request_locked(ctx, slots[--acquired]);
+        }
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        return ret;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        enqueue_request_locked(ctx, slots[i]);
+    }
+    
+    // 依次等待，返回第一个错误
+    int result = AIR8000_OK;
+    for (size_t i = 0; i < count; i++) {
+        while (slots[i]->state == REQ_STATE_PENDING) {
+            pthread_cond_wait(&slots[i]->cond, &ctx->ctx_mutex);
+        }
+        if (result == AIR8000_OK) {
+            result = slots[i]->result_code;
+        }
+        release_request_locked(ctx, slots[i]);
+    }
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    return result;
+}
+
+/**
+ * @brief 等待异步窗口并提交请求
+ * @param ctx 上下文指针
+ * @param req 请求帧指针
+ * @param cb 完成回调函数
+ * @param user_data 回调用户数据
+ * @param timeout_ms 请求超时时间（毫秒）
+ * @param take_data 为 true 时成功提交后 req->data 归请求槽位所有（见 acquire_request_locked）
+ * @return 成功提交返回0，失败返回错误码
+ */
+static int submit_async(air8000_t *ctx, const air8000_frame_t *req, air8000_async_cb_t cb,
+                        void *user_data, int timeout_ms, bool take_data) {
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    
+    // 等待窗口
+    while (ctx->running && ctx->async_inflight >= ctx->async_window) {
+        pthread_cond_wait(&ctx->window_cond, &ctx->ctx_mutex);
+    }
+    if (!ctx->running) {
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        return AIR8000_ERR_SHUTDOWN;
+    }
+    
+    // 领取请求槽位；超时从真正进入队列时开始计算，不包含等待窗口的时间
+    request_t *r = NULL;
+    int ret = acquire_request_locked(ctx, req, NULL, timeout_ms, take_data, &r);
+    if (ret != AIR8000_OK) {
+        // 序列号冲突或内存不足
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        return ret;
+    }
+    r->async_cb = cb;
+    r->async_user_data = user_data;
+    air8000_frame_init(&r->async_resp);
+    r->resp_frame = &r->async_resp;
+    enqueue_request_locked(ctx, r);
+    ctx->async_inflight++;
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    
+    return AIR8000_OK;
+}
+
+/**
+ * @brief 异步发送帧
+ * @param ctx 上下文指针
+ * @param req 请求帧指针
+ * @param cb 完成回调函数
+ * @param user_data 回调用户数据
+ * @param timeout_ms 请求超时时间（毫秒）
+ * @return 成功提交返回0，失败返回错误码
+ * @details 与 air8000_send_and_wait 共用发送环/超时堆/pending_map，区别在于：
+ * 1. 不等待响应，提交后立即返回
+ * 2. 在途异步请求数达到窗口上限时阻塞等待
+ * 3. 请求槽位在完成回调返回后归还
+ */
+int air8000_send_async(air8000_t *ctx, const air8000_frame_t *req,
+                       air8000_async_cb_t cb, void *user_data, int timeout_ms) {
+    if (!ctx || !req || !cb) return AIR8000_ERR_PARAM;
+    return submit_async(ctx, req, cb, user_data, timeout_ms, false);
+}
+
+/**
+ * @brief 不等待结果的请求完成回调，失败时只记录日志
+ */
+static void nowait_done(air8000_t *ctx, int result, const air8000_frame_t *req,
+                        const air8000_frame_t *resp, void *user_data) {
+    (void)ctx;
+    (void)user_data;
+    if (result != AIR8000_OK) {
+        log_warn("air8000", "CMD 0x%04X (seq %u) not answered: %d", req->cmd, req->seq, result);
+    } else if (resp && resp->type == FRAME_TYPE_NACK) {
+        log_warn("air8000", "CMD 0x%04X (seq %u) rejected by device", req->cmd, req->seq);
+    }
+}
+
+/**
+ * @brief 提交请求且不等待任何结果（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param req 请求帧指针
+ * @param timeout_ms 请求超时时间（毫秒）
+ * @param cb 完成回调（在 I/O 线程中调用）
+ * @return 成功提交返回0，失败返回错误码
+ * @details 不等待异步窗口，可在 I/O 线程中使用；在途计数照常增减，只是可能短暂超过窗口
+ */
+static int submit_nowait_locked(air8000_t *ctx, const air8000_frame_t *req, int timeout_ms,
+                                air8000_async_cb_t cb) {
+    if (!ctx->running) {
+        return AIR8000_ERR_SHUTDOWN;
+    }
+    request_t *r = NULL;
+    int ret = acquire_request_locked(ctx, req, NULL, timeout_ms, false, &r);
+    if (ret != AIR8000_OK) {
+        return ret;
+    }
+    r->async_cb = cb;
+    r->async_user_data = NULL;
+    air8000_frame_init(&r->async_resp);
+    r->resp_frame = &r->async_resp;
+    enqueue_request_locked(ctx, r);
+    ctx->async_inflight++;
+    return AIR8000_OK;
+}
+
+/**
+ * @brief 发送请求，不等待响应
+ * @param ctx 上下文指针
+ * @param req 请求帧指针
+ * @param timeout_ms 请求超时时间（毫秒）
+ * @return 成功提交返回0，失败返回错误码
+ */
+int air8000_send_nowait(air8000_t *ctx, const air8000_frame_t *req, int timeout_ms) {
+    if (!ctx || !req) return AIR8000_ERR_PARAM;
+    
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    int ret = submit_nowait_locked(ctx, req, timeout_ms, nowait_done);
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    return ret;
+}
+
+/**
+ * @brief 设置异步在途窗口大小
+ * @param ctx 上下文指针
+ * @param window 窗口大小
+ */
+void air8000_set_async_window(air8000_t *ctx, int window) {
+    if (!ctx) return;
+    
+    if (window < 1) window = 1;
+    if (window > AIR8000_MAX_ASYNC_WINDOW) window = AIR8000_MAX_ASYNC_WINDOW;
+    
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    ctx->async_window = window;
+    pthread_cond_broadcast(&ctx->window_cond); // 窗口变大时唤醒等待的提交者
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+}
+
+/**
+ * @brief 获取异步在途窗口大小
+ * @param ctx 上下文指针
+ * @return 当前窗口大小
+ */
+int air8000_get_async_window(air8000_t *ctx) {
+    if (!ctx) return AIR8000_DEFAULT_ASYNC_WINDOW;
+    
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    int window = ctx->async_window;
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    return window;
+}
+
+/**
+ * @brief 等待所有在途异步请求完成
+ * @param ctx 上下文指针
+ * @param timeout_ms 超时时间（毫秒），-1 表示一直等待
+ * @return 全部完成返回0，超时返回 AIR8000_ERR_TIMEOUT
+ */
+int air8000_async_drain(air8000_t *ctx, int timeout_ms) {
+    if (!ctx) return AIR8000_ERR_PARAM;
+    
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout_ms > 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    
+    int ret = AIR8000_OK;
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    while (ctx->async_inflight > 0) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&ctx->window_cond, &ctx->ctx_mutex);
+        } else if (pthread_cond_timedwait(&ctx->window_cond, &ctx->ctx_mutex, &deadline) == ETIMEDOUT) {
+            ret = AIR8000_ERR_TIMEOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    return ret;
+}
+
+// ==================== 窗口发送 ====================
+
+/**
+ * @brief 窗口发送运行状态
+ * @details 提交线程与 I/O 线程（完成回调）之间共享，由 mutex 保护
+ */
+typedef struct {
+    air8000_t *ctx;                 /**< 上下文指针 */
+    const air8000_window_job_t *job;/**< 任务描述 */
+    pthread_mutex_t mutex;          /**< 保护以下字段 */
+    pthread_cond_t cond;            /**< 有分片完成时通知提交线程 */
+    uint8_t *retries;               /**< 每个分片已重传次数 */
+    uint32_t *retx_queue;           /**< 待重传分片索引队列 */
+    uint32_t retx_head;             /**< 重传队列读位置 */
+    uint32_t retx_count;            /**< 重传队列长度 */
+    uint32_t next_index;            /**< 下一个首次发送的分片 */
+    uint32_t acked;                 /**< 已确认分片数 */
+    int inflight;                   /**< 本任务在途分片数 */
+    int error;                      /**< 首个不可恢复错误（0 表示无） */
+} window_run_t;
+
+/**
+ * @brief 分片完成回调携带的数据
+ */
+typedef struct {
+    window_run_t *run;              /**< 所属任务 */
+    uint32_t index;                 /**< 分片索引 */
+} window_ref_t;
+
+/**
+ * @brief 分片索引入队（调用者需持有 run->mutex）
+ * @note 每个分片同一时刻只会在途或在队列中，队列容量取 total 即可
+ */
+static void window_push_locked(window_run_t *run, uint32_t index) {
+    run->retx_queue[(run->retx_head + run->retx_count) % run->job->total] = index;
+    run->retx_count++;
+}
+
+/**
+ * @brief 将失败分片放入重传队列，重传次数耗尽时记录错误（调用者需持有 run->mutex）
+ * @param run 任务运行状态
+ * @param index 分片索引
+ * @param err 本次失败的错误码
+ */
+static void window_requeue_locked(window_run_t *run, uint32_t index, int err) {
+    if (run->retries[index] >= run->job->max_retry) {
+        if (run->error == 0) {
+            run->error = err;
+        }
+        log_error("air8000", "Block %u failed after %d retries: %d", index, run->retries[index], err);
+        return;
+    }
+    run->retries[index]++;
+    window_push_locked(run, index);
+    log_warn("air8000", "Block %u retransmit %d/%d: %d", index, run->retries[index], run->job->max_retry, err);
+}
+
+/**
+ * @brief 分片异步完成回调（I/O 线程）
+ */
+static void window_block_done(air8000_t *ctx, int result, const air8000_frame_t *req,
+                              const air8000_frame_t *resp, void *user_data) {
+    (void)req;
+    window_ref_t *ref = (window_ref_t *)user_data;
+    window_run_t *run = ref->run;
+    
+    bool ok = (result == AIR8000_OK && resp &&
+               (resp->type == FRAME_TYPE_ACK || resp->type == FRAME_TYPE_RESPONSE));
+    if (ok && run->job->block_acked) {
+        run->job->block_acked(ctx, ref->index, run->job->user_data);
+    }
+    
+    pthread_mutex_lock(&run->mutex);
+    if (ok) {
+        run->acked++;
+    } else {
+        // NACK 或超时：只重传这一个分片
+        window_requeue_locked(run, ref->index, result == AIR8000_OK ? AIR8000_ERR_PROTOCOL : result);
+    }
+    run->inflight--;
+    pthread_cond_signal(&run->cond);
+    pthread_mutex_unlock(&run->mutex);
+}
+
+/**
+ * @brief 判断分片是否已在位图中标记完成
+ * @details 位图可能同时被 block_acked 回调在 I/O 线程中置位，按字节原子读取
+ */
+static bool window_skipped(const air8000_window_job_t *job, uint32_t index) {
+    if (!job->skip_bitmap) {
+        return false;
+    }
+    uint8_t byte = __atomic_load_n(&job->skip_bitmap[index >> 3], __ATOMIC_RELAXED);
+    return (byte >> (index & 7)) & 1;
+}
+
+/**
+ * @brief 以流水线方式发送一组分片
+ * @param ctx 上下文指针
+ * @param job 任务描述
+ * @return 成功返回0，失败返回错误码
+ * @details 提交线程循环执行：
+ * 1. 优先取重传队列中的分片，否则取下一个未发送分片
+ * 2. 调用 build 构建新帧（新序列号）并通过 air8000_send_async 提交，窗口满时阻塞
+ * 3. 完成回调在 I/O 线程中统计确认数或将失败分片放回重传队列
+ * 4. 所有分片确认、出现不可恢复错误或被取消时退出，并等待本任务在途分片全部结束
+ */
+int air8000_send_windowed(air8000_t *ctx, const air8000_window_job_t *job) {
+    if (!ctx || !job || !job->build) return AIR8000_ERR_PARAM;
+    if (job->total == 0) return AIR8000_OK;
+    
+    window_run_t run;
+    memset(&run, 0, sizeof(run));
+    run.ctx = ctx;
+    run.job = job;
+    run.retries = (uint8_t *)calloc(job->total, sizeof(uint8_t));
+    run.retx_queue = (uint32_t *)calloc(job->total, sizeof(uint32_t));
+    window_ref_t *refs = (window_ref_t *)calloc(job->total, sizeof(window_ref_t));
+    if (!run.retries || !run.retx_queue || !refs) {
+        free(run.retries);
+        free(run.retx_queue);
+        free(refs);
+        return AIR8000_ERR_NOMEM;
+    }
+    for (uint32_t i = 0; i < job->total; i++) {
+        refs[i].run = &run;
+        refs[i].index = i;
+        if (window_skipped(job, i)) {
+            run.acked++;
+        }
+    }
+    pthread_mutex_init(&run.mutex, NULL);
+    pthread_cond_init(&run.cond, NULL);
+    
+    uint32_t reported = 0;
+    pthread_mutex_lock(&run.mutex);
+    while (1) {
+        // 上报进度（不持有 run.mutex 调用回调）
+        if (job->progress && run.acked != reported) {
+            reported = run.acked;
+            pthread_mutex_unlock(&run.mutex);
+            job->progress(ctx, reported, job->total, job->user_data);
+            pthread_mutex_lock(&run.mutex);
+        }
+        
+        if (run.error != 0 || run.acked >= job->total) {
+            break;
+        }
+        if (job->abort_flag && *job->abort_flag) {
+            run.error = AIR8000_ERR_SHUTDOWN;
+            break;
+        }
+        
+        // 选择下一个要发送的分片
+        uint32_t index;
+        if (run.retx_count > 0) {
+            index = run.retx_queue[run.retx_head];
+            run.retx_head = (run.retx_head + 1) % job->total;
+            run.retx_count--;
+        } else if (run.next_index < job->total) {
+            index = run.next_index++;
+            if (window_skipped(job, index)) {
+                continue;
+            }
+        } else {
+            // 全部已提交，等待在途分片完成或出现重传
+            pthread_cond_wait(&run.cond, &run.mutex);
+            continue;
+        }
+        run.inflight++;
+        pthread_mutex_unlock(&run.mutex);
+        
+        // 构建并提交（不持有 run.mutex，避免窗口满时阻塞完成回调）
+        air8000_frame_t frame;
+        air8000_frame_init(&frame);
+        int ret = job->build(ctx, index, &frame, job->user_data);
+        if (ret == AIR8000_OK) {
+            // 分片缓冲区直接交给请求槽位，不再拷贝一次
+            ret = submit_async(ctx, &frame, window_block_done, &refs[index], job->timeout_ms, true);
+            if (ret == AIR8000_OK) {
+                frame.data = NULL;
+            }
+        }
+        air8000_frame_cleanup(&frame);
+        
+        pthread_mutex_lock(&run.mutex);
+        if (ret != AIR8000_OK) {
+            run.inflight--;
+            if (ret == AIR8000_ERR_BUSY) {
+                // 序列号冲突，换一个序列号重新提交（不计入重传次数）
+                window_push_locked(&run, index);
+            } else if (run.error == 0) {
+                run.error = ret;
+            }
+        }
+    }
+    
+    // 等待本任务所有在途分片结束，之后 refs 才能释放
+    while (run.inflight > 0) {
+        pthread_cond_wait(&run.cond, &run.mutex);
+    }
+    int result = run.error;
+    uint32_t acked = run.acked;
+    pthread_mutex_unlock(&run.mutex);
+    
+    if (job->progress && acked != reported) {
+        job->progress(ctx, acked, job->total, job->user_data);
+    }
+    
+    pthread_cond_destroy(&run.cond);
+    pthread_mutex_destroy(&run.mutex);
+    free(run.retries);
+    free(run.retx_queue);
+    free(refs);
+    return result;
+}
+
+// ==================== I/O 线程 ====================
+
+/**
+ * @brief 处理已到期的请求（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param now 当前时间戳（毫秒）
+ * @param done_list 异步完成链表
+ * @details 只检查超时堆顶，每个到期请求 O(log n)，未到期时 O(1) 返回
+ */
+static void expire_requests_locked(air8000_t *ctx, uint64_t now, request_t **done_list) {
+    while (ctx->heap_size > 0) {
+        request_t *top = ctx->timeout_heap[0];
+        if (now - top->start_time <= top->timeout_ms) {
+            break;
+        }
+        finish_request_locked(ctx, top, REQ_STATE_TIMEOUT, AIR8000_ERR_TIMEOUT, done_list);
+        pm_metrics_add(PM_CNT_UART_TIMEOUTS, 1);
+    }
+}
+
+/**
+ * @brief 计算 poll 等待时间（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param now 当前时间戳（毫秒）
+ * @param max_ms 等待上限（毫秒）
+ * @return 距最近一个请求超时的毫秒数，不超过 max_ms
+ */
+static int next_wait_ms_locked(air8000_t *ctx, uint64_t now, int max_ms) {
+    if (ctx->heap_size == 0) {
+        return max_ms;
+    }
+    uint64_t deadline = request_deadline(ctx->timeout_heap[0]) + 1; // 超时判定为严格大于
+    if (deadline <= now) {
+        return 0;
+    }
+    uint64_t wait = deadline - now;
+    return wait < (uint64_t)max_ms ? (int)wait : max_ms;
+}
+
+/**
+ * @brief 请求的帧已全部写出，移出发送环（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param curr 发送环首的请求
+ */
+static void tx_ring_pop_sent_locked(air8000_t *ctx, request_t *curr) {
+    curr->sent = true;
+    curr->sent_us = pm_metrics_now_us();
+    ctx->tx_head = (ctx->tx_head + 1) % MAX_PENDING_REQUESTS;
+    ctx->tx_count--;
+    curr->queued = false;
+}
+
+/**
+ * @brief 从上次的偏移继续写出部分写出的帧（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @return 整帧写完返回 true；串口暂时写不下（已注册 EPOLLOUT）或写入失败（已断开）返回 false
+ */
+static bool flush_tx_partial_locked(air8000_t *ctx) {
+    while (ctx->tx_partial_off < ctx->tx_partial_len) {
+        int written = air8000_serial_write(&ctx->serial, ctx->tx_partial + ctx->tx_partial_off,
+                                           ctx->tx_partial_len - ctx->tx_partial_off);
+        if (written < 0) {
+            log_error("air8000", "Serial write failed, disconnecting...");
+            disconnect_serial_locked(ctx);
+            return false;
+        }
+        if (written == 0) {
+            // 内核发送缓冲区已满：等串口可写时由反应器再次服务本上下文
+            watch_serial_out_locked(ctx, true);
+            return false;
+        }
+        ctx->tx_partial_off += (size_t)written;
+    }
+    
+    request_t *curr = ctx->tx_partial_req;
+    ctx->tx_partial_len = 0;
+    ctx->tx_partial_off = 0;
+    ctx->tx_partial_req = NULL;
+    watch_serial_out_locked(ctx, false);
+    if (curr) {
+        tx_ring_pop_sent_locked(ctx, curr);
+    }
+    return true;
+}
+
+/**
+ * @brief 发送发送环中的请求（调用者需持有 ctx_mutex）
+ * @param ctx 上下文指针
+ * @param tx_buf 编码缓冲区
+ * @param tx_buf_size 编码缓冲区大小
+ * @details 串口 fd 非阻塞：一帧没有写完时剩余字节转存到上下文，请求留在环首，
+ *          注册 EPOLLOUT 后返回，可写时从断点继续，整帧写完才出环，反应器线程不会被一个串口卡住。
+ *          写串口失败时请求留在环首，标记断开，重连后按原顺序继续发送
+ */
+static void flush_tx_ring_locked(air8000_t *ctx, uint8_t *tx_buf, size_t tx_buf_size) {
+    uint64_t sent_frames = 0;
+    while (ctx->connected) {
+        if (ctx->tx_partial_len > 0) {
+            bool had_req = ctx->tx_partial_req != NULL;
+            if (!flush_tx_partial_locked(ctx)) {
+                break;
+            }
+            if (had_req) {
+                sent_frames++;
+            }
+            continue;
+        }
+        if (ctx->tx_count == 0) {
+            break;
+        }
+        request_t *curr = ctx->tx_ring[ctx->tx_head];
+        
+        int encoded_len = air8000_frame_encode(&curr->req_frame, tx_buf, tx_buf_size);
+        if (encoded_len <= 0) {
+            // 无法编码的请求留在超时堆中等待超时
+            log_error("air8000", "Frame encode failed - len=%d", encoded_len);
+            ctx->tx_head = (ctx->tx_head + 1) % MAX_PENDING_REQUESTS;
+            ctx->tx_count--;
+            curr->queued = false;
+            continue;
+        }
+        
+        int written = air8000_serial_write(&ctx->serial, tx_buf, encoded_len);
+        if (written < 0) {
+            // 发送失败，可能是断开连接，标记连接状态为断开
+            log_error("air8000", "Serial write failed, disconnecting...");
+            disconnect_serial_locked(ctx);
+            break; // 下一次迭代会处理重连
+        }
+        if (written < encoded_len) {
+            // 短写：剩余字节转存，下一轮循环从断点继续（写不下时注册 EPOLLOUT 退出）
+            memcpy(ctx->tx_partial, tx_buf, (size_t)encoded_len);
+            ctx->tx_partial_len = (size_t)encoded_len;
+            ctx->tx_partial_off = (size_t)written;
+            ctx->tx_partial_req = curr;
+            continue;
+        }
+        tx_ring_pop_sent_locked(ctx, curr);
+        sent_frames++;
+        // 打印发送数据
+        log_debug("air8000", "Sent CMD: 0x%04X, Len: %d", curr->req_frame.cmd, encoded_len);
+    }
+    if (sent_frames > 0) {
+        pm_metrics_add(PM_CNT_UART_TX_FRAMES, sent_frames);
+    }
+}
+
+/**
+ * @brief 解码遥测上报帧并发布快照（仅在 I/O 线程中调用）
+ * @param ctx 上下文指针
+ * @param frame 上报帧（接收环视图）
+ * @details 写入未发布的缓冲：先把代数置为奇数，解码完成后置回偶数，再切换发布下标。
+ *          读者在拷贝前后比较代数，不一致时重读，因此 I/O 线程从不等待读者
+ */
+static void publish_telemetry(air8000_t *ctx, const air8000_frame_t *frame) {
+    int cur = __atomic_load_n(&ctx->telemetry_published, __ATOMIC_RELAXED);
+    int idx = (cur == 0) ? 1 : 0;
+    air8000_telemetry_t *snap = &ctx->telemetry[idx];
+    uint32_t gen = ctx->telemetry_gen[idx];
+    
+    __atomic_store_n(&ctx->telemetry_gen[idx], gen + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    
+    int ret = (frame->data && frame->data_len > 0) ?
+              air8000_parse_telemetry(frame->data, frame->data_len, snap) : -1;
+    if (ret == 0) {
+        snap->seq = ++ctx->telemetry_seq;
+        snap->host_time_ms = get_time_ms();
+    }
+    __atomic_store_n(&ctx->telemetry_gen[idx], gen + 2, __ATOMIC_RELEASE);
+    
+    if (ret != 0) {
+        log_warn("air8000", "Malformed telemetry report (len %u), dropped", frame->data_len);
+        return;
+    }
+    __atomic_store_n(&ctx->telemetry_published, idx, __ATOMIC_RELEASE);
+    
+    // 复制回调信息到局部变量，避免持有锁调用回调
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    air8000_telemetry_cb_t cb = ctx->telemetry_cb;
+    void *ud = ctx->telemetry_user_data;
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    
+    // 只有 I/O 线程写缓冲，回调期间快照不会被改写
+    if (cb) {
+        cb(snap, ud);
+    }
+}
+
+/**
+ * @brief 重新订阅请求的完成回调
+ */
+static void telemetry_resubscribe_done(air8000_t *ctx, int result, const air8000_frame_t *req,
+                                       const air8000_frame_t *resp, void *user_data) {
+    (void)ctx;
+    (void)req;
+    (void)user_data;
+    if (result != AIR8000_OK || !resp ||
+        (resp->type != FRAME_TYPE_ACK && resp->type != FRAME_TYPE_RESPONSE)) {
+        log_warn("air8000", "Telemetry re-subscribe failed (%d)", result);
+    }
+}
+
+/**
+ * @brief 重连后重新下发遥测订阅（调用者需持有 ctx_mutex，在 I/O 线程中调用）
+ * @param ctx 上下文指针
+ * @details 设备重启后订阅丢失；这里不能同步等待，以不等待窗口的异步请求入队
+ */
+static void resubscribe_telemetry_locked(air8000_t *ctx) {
+    uint8_t data[3];
+    data[0] = ctx->telemetry_mask;
+    data[1] = (uint8_t)(ctx->telemetry_period_ms >> 8);
+    data[2] = (uint8_t)(ctx->telemetry_period_ms & 0xFF);
     
-    // 初始化同步原语
-    pthread_mutex_init(&r->mutex, NULL);
-    pthread_cond_init(&r->cond, NULL);
+    air8000_frame_t req;
+    air8000_frame_init(&req);
+    req.type = FRAME_TYPE_REQUEST;
+    req.seq = air8000_next_seq();
+    req.cmd = CMD_TELEMETRY_SUBSCRIBE;
+    req.data = data;
+    req.data_len = sizeof(data);
     
-    return r;
+    int ret = submit_nowait_locked(ctx, &req, TELEMETRY_RESUBSCRIBE_TIMEOUT_MS, telemetry_resubscribe_done);
+    if (ret != AIR8000_OK) {
+        log_warn("air8000", "Telemetry re-subscribe not queued (%d)", ret);
+    }
 }
 
 /**
- * @brief 销毁请求对象
- * @param req 请求对象指针
- * @details 该函数完成以下工作：
- * 1. 销毁互斥锁和条件变量
- * 2. 释放请求帧数据内存
- * 3. 释放请求对象内存
- */
-static void destroy_request(request_t *req) {
-    if (req) {
-        // 销毁同步原语
-        pthread_mutex_destroy(&req->mutex);
-        pthread_cond_destroy(&req->cond);
+ * @brief 解析接收缓冲区中的完整帧并分发
+ * @param ctx 上下文指针
+ * @param done_list 异步完成链表
+ */
+static void process_rx_frames(air8000_t *ctx, request_t **done_list) {
+    uint32_t crc_errors = ctx->rx_ring.crc_errors;
+    uint64_t rx_frames = 0;
+    for (;;) {
+        // frame 是指向接收环的视图，不可 cleanup；需要持有数据的消费者自行拷贝
+        air8000_frame_t frame;
+        int frame_len = air8000_rx_ring_next_frame(&ctx->rx_ring, &frame);
         
-        // 释放请求帧数据
-        if (req->req_frame.data) {
-            free(req->req_frame.data);
+        if (frame_len > 0) {
+            rx_frames++;
+            // 收到完整帧
+            if (frame.type == FRAME_TYPE_NOTIFY && frame.cmd == CMD_TELEMETRY_REPORT) {
+                // 遥测上报直接解码到快照，不转发给通知回调
+                publish_telemetry(ctx, &frame);
+            } else if (frame.type == FRAME_TYPE_NOTIFY) {
+                // 复制回调信息到局部变量，避免持有锁调用回调
+                air8000_notify_cb_t cb = NULL;
+                void *ud = NULL;
+
+                pthread_mutex_lock(&ctx->ctx_mutex);
+                cb = ctx->notify_cb;
+                ud = ctx->notify_user_data;
+                pthread_mutex_unlock(&ctx->ctx_mutex);
+
+                if (cb) {
+                    cb(&frame, ud);
+                }
+            } else {
+                // 检查是否是文件传输或FOTA相关请求
+                if (frame.type == FRAME_TYPE_REQUEST) {
+                    // 处理文件传输请求：处理函数按结构体访问数据，拷贝一份保证对齐
+                    air8000_frame_t owned;
+                    air8000_frame_init(&owned);
+                    if (air8000_frame_copy(&owned, &frame) == 0) {
+                        air8000_file_transfer_handle_request(ctx, &owned);
+                    }
+                    air8000_frame_cleanup(&owned);
+                    // FOTA升级请求现在由应用层处理，不需要在这里调用
+                } else {
+                    // 打印接收数据
+                    log_debug("air8000", "Received CMD: 0x%04X, Len: %d", frame.cmd, frame_len);
+                    
+                    // 翻译后的数据打印
+                    if (frame.data_len > 0 && frame.data) {
+                        switch (frame.cmd) {
+                            case CMD_SYS_VERSION:
+                                {
+                                    air8000_version_t ver;
+                                    if (air8000_parse_version(frame.data, frame.data_len, &ver) == 0) {
+                                        printf("[PARSED] Version: V%d.%d.%d (%s)\n", ver.major, ver.minor, ver.patch, ver.build);
+                                    }
+                                }
+                                break;
+                            case CMD_SENSOR_READ_TEMP:
+                                {
+                                    float temp;
+                                    if (air8000_parse_motor_float_resp(frame.data, frame.data_len, NULL, &temp) == 0) {
+                                        printf("[PARSED] Temperature: %.2f C\n", temp);
+                                    }
+                                }
+                                break;
+                            case CMD_SENSOR_READ_ALL:
+                                {
+                                    air8000_sensor_data_t sensor_data;
+                                    if (air8000_parse_sensor_data(frame.data, frame.data_len, &sensor_data) == 0) {
+                                        printf("[PARSED] All Sensors - Temp: %.2f C, Humidity: %d%%, Light: %d, Battery: %d%%\n", 
+                                               sensor_data.temperature, sensor_data.humidity, sensor_data.light, sensor_data.battery);
+                                    }
+                                }
+                                break;
+                            case CMD_QUERY_POWER:
+                                {
+                                    air8000_power_adc_t power;
+                                    if (air8000_parse_power_adc(frame.data, frame.data_len, &power) == 0) {
+                                        printf("[PARSED] Power - 12V: %.2f V, Battery: %.2f V\n", 
+                                               power.v12_mv / 1000.0, power.vbat_mv / 1000.0);
+                                    }
+                                }
+                                break;
+                            case CMD_QUERY_NETWORK:
+                                {
+                                    air8000_network_status_t net;
+                                    if (air8000_parse_network_status(frame.data, frame.data_len, &net) == 0) {
+                                        printf("[PARSED] Network - CSQ: %d, RSSI: %d, RSRP: %d, Status: %d\n", 
+                                               net.csq, net.rssi, net.rsrp, net.status);
+                                    }
+                                }
+                                break;
+                            default:
+                                // 其他命令暂不打印详细解析
+                                break;
+                        }
+                    }
+                    
+                    // 查找匹配的请求 (Fix 10: O(1) lookup)
+                    pthread_mutex_lock(&ctx->ctx_mutex);
+                    request_t *req = ctx->pending_map[frame.seq];
+
+                    if (req && req->state == REQ_STATE_PENDING && req->req_frame.cmd == frame.cmd) {
+                 // 匹配成功
+                 if (req->resp_frame) {
+                     // 唯一一次拷贝：从接收环视图深拷贝到调用者的响应帧
+                     req->resp_frame->data = NULL;
+                     air8000_frame_copy(req->resp_frame, &frame);
+                 }
+
+                 if (req->sent) {
+                     pm_metrics_observe_cmd(frame.cmd, pm_metrics_now_us() - req->sent_us);
+                 }
+                 finish_request_locked(ctx, req, REQ_STATE_COMPLETED, AIR8000_OK, done_list);
+            }
+                    pthread_mutex_unlock(&ctx->ctx_mutex);
+                }
+            }
+        } else {
+            break; // 不完整（无效字节已在环内通过 memchr 跳过）
         }
-        
-        // 释放请求对象内存
-        free(req);
+    }
+
+    if (rx_frames > 0) {
+        pm_metrics_add(PM_CNT_UART_RX_FRAMES, rx_frames);
+    }
+    if (ctx->rx_ring.crc_errors != crc_errors) {
+        pm_metrics_add(PM_CNT_UART_CRC_ERRORS, ctx->rx_ring.crc_errors - crc_errors);
+        log_warn("air8000", "Dropped %u frame(s) with CRC error (total %u)",
+                 ctx->rx_ring.crc_errors - crc_errors, ctx->rx_ring.crc_errors);
     }
 }
 
+// ==================== I/O 反应器 ====================
+
 /**
- * @brief 发送请求并等待响应
+ * @brief 服务一个上下文：重连、发送、超时检查（在反应器线程中调用）
  * @param ctx 上下文指针
- * @param req 请求帧指针
- * @param resp 响应帧指针（用于回填响应数据，可为NULL）
- * @param timeout_ms 请求超时时间（毫秒）
- * @return 成功返回0，失败返回错误码
- * @details 该函数完成以下工作：
- * 1. 参数校验
- * 2. 检查序列号冲突
- * 3. 创建请求对象
- * 4. 将请求加入待处理队列和映射表
- * 5. 等待请求完成（阻塞直到收到响应或超时）
- * 6. 从队列中移除请求
- * 7. 销毁请求对象并返回结果
+ * @param tx_buf 编码缓冲区
+ * @param tx_buf_size 编码缓冲区大小
+ * @return 该上下文下一次需要被服务的等待时间（毫秒）
+ * @details 反应器每轮 epoll_wait 之前对所有上下文调用一次：
+ * 1. 未连接时按 RECONNECT_INTERVAL_MS 尝试重连，成功后注册串口 fd 并恢复遥测订阅
+ * 2. 按提交顺序发送发送环中的请求
+ * 3. 处理到期的请求，在锁外调用异步完成回调
  */
-int air8000_send_and_wait(air8000_t *ctx, const air8000_frame_t *req, air8000_frame_t *resp, int timeout_ms) {
-    if (!ctx || !req) return AIR8000_ERR_PARAM;
+static int context_service(air8000_t *ctx, uint8_t *tx_buf, size_t tx_buf_size) {
+    uint64_t now = get_time_ms();
+    request_t *done_list = NULL;
     
-    // 检查序列号冲突 (Fix 7)
-    pthread_mutex_lock(&ctx->ctx_mutex);
-    request_t *p = ctx->pending_list;
-    while (p) {
-        if (p->req_frame.seq == req->seq) {
+    // 1. 自动重连逻辑
+    if (!ctx->connected && now - ctx->last_reconnect_time > RECONNECT_INTERVAL_MS) {
+        ctx->last_reconnect_time = now;
+        if (air8000_serial_open(&ctx->serial, ctx->device_path) == 0) {
+            pthread_mutex_lock(&ctx->ctx_mutex);
+            ctx->connected = true;
+            watch_serial_locked(ctx);
+            if (ctx->telemetry_mask) {
+                resubscribe_telemetry_locked(ctx);
+            }
             pthread_mutex_unlock(&ctx->ctx_mutex);
-            return AIR8000_ERR_BUSY; // 序列号冲突
+            log_info("air8000", "Reconnected to %s", ctx->device_path);
+            pm_metrics_add(PM_CNT_UART_RECONNECTS, 1);
         }
-        p = p->next;
     }
-    pthread_mutex_unlock(&ctx->ctx_mutex);
-
-    // 创建请求对象
-    request_t *r = create_request(req, resp, timeout_ms);
-    if (!r) return AIR8000_ERR_NOMEM;
     
-    // 加入队列和映射表
+    // 2. 发送逻辑；3. 超时检查
     pthread_mutex_lock(&ctx->ctx_mutex);
-    r->next = ctx->pending_list;
-    ctx->pending_list = r;
-    ctx->pending_map[req->seq] = r; // 添加到映射表（用于O(1)查找）
+    flush_tx_ring_locked(ctx, tx_buf, tx_buf_size);
+    now = get_time_ms();
+    expire_requests_locked(ctx, now, &done_list);
+    int wait_ms = next_wait_ms_locked(ctx, now, IO_THREAD_IDLE_MS);
+    if (!ctx->connected) {
+        // 未连接时按重连间隔醒来
+        uint64_t since = now - ctx->last_reconnect_time;
+        int reconnect_ms = since >= RECONNECT_INTERVAL_MS ? 1 : (int)(RECONNECT_INTERVAL_MS - since) + 1;
+        if (reconnect_ms < wait_ms) {
+            wait_ms = reconnect_ms;
+        }
+    }
     pthread_mutex_unlock(&ctx->ctx_mutex);
     
-    // 等待结果
-    pthread_mutex_lock(&r->mutex);
-    while (r->state == REQ_STATE_PENDING) {
-        pthread_cond_wait(&r->cond, &r->mutex);
+    dispatch_async_done(ctx, done_list);
+    return wait_ms;
+}
+
+/**
+ * @brief 处理上下文串口上的 epoll 事件（在反应器线程中调用）
+ * @param ctx 上下文指针
+ * @param events epoll 事件位
+ * @details 读取数据并解析完整帧，读取出错或挂断时断开，由下一轮服务负责重连；
+ *          只有 EPOLLOUT 时不读取，部分写出的帧由下一轮 context_service 继续发送
+ */
+static void context_on_serial(air8000_t *ctx, uint32_t events) {
+    request_t *done_list = NULL;
+    if (!ctx->connected || !(events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        return;
     }
-    int result = r->result_code;
-    pthread_mutex_unlock(&r->mutex);
     
-    // 从队列中移除 (注意：必须在持有 ctx_mutex 下操作链表)
-    pthread_mutex_lock(&ctx->ctx_mutex);
-    request_t **curr = &ctx->pending_list;
-    while (*curr) {
-        if (*curr == r) {
-            *curr = r->next; // 摘除请求
-            break;
-        }
-        curr = &(*curr)->next;
+    size_t space;
+    uint8_t *wptr = air8000_rx_ring_write_ptr(&ctx->rx_ring, &space);
+    if (space == 0) {
+        // 缓冲区已满仍无法解析出完整帧，丢弃以免卡死
+        log_warn("air8000", "RX ring full without a complete frame, dropping %zu bytes",
+                 air8000_rx_ring_used(&ctx->rx_ring));
+        air8000_rx_ring_init(&ctx->rx_ring);
+        wptr = air8000_rx_ring_write_ptr(&ctx->rx_ring, &space);
     }
-    pthread_mutex_unlock(&ctx->ctx_mutex);
+    int read_len = air8000_serial_read(&ctx->serial, wptr, space, 0);
     
-    // 销毁请求对象
-    destroy_request(r);
-    return result;
+    if (read_len < 0 || (read_len == 0 && !(events & EPOLLIN))) {
+        // 读取错误或挂断 (断开连接)
+        log_error("air8000", "Serial read error on %s, disconnecting...", ctx->device_path);
+        pthread_mutex_lock(&ctx->ctx_mutex);
+        disconnect_serial_locked(ctx);
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+    } else if (read_len > 0) {
+        air8000_rx_ring_commit(&ctx->rx_ring, (size_t)read_len);
+        process_rx_frames(ctx, &done_list);
+    }
+    
+    // 响应完成的异步请求在锁外回调
+    dispatch_async_done(ctx, done_list);
 }
 
-// ==================== I/O 线程 ====================
+/**
+ * @brief 开始服务一个上下文并释放反应器锁（调用者需持有 r->mutex）
+ * @param r 反应器
+ * @param ctx 要服务的上下文
+ */
+static void reactor_enter_locked(reactor_t *r, air8000_t *ctx) {
+    r->busy = ctx;
+    pthread_mutex_unlock(&r->mutex);
+}
+
+/**
+ * @brief 结束服务上下文并重新取得反应器锁，唤醒等待注销的线程
+ * @param r 反应器
+ */
+static void reactor_leave(reactor_t *r) {
+    pthread_mutex_lock(&r->mutex);
+    r->busy = NULL;
+    pthread_cond_broadcast(&r->idle_cond);
+}
 
 /**
- * @brief I/O 线程函数
- * @param arg 上下文指针
+ * @brief I/O 反应器线程函数
+ * @param arg 未使用
  * @return NULL
- * @details 该函数是 SDK 的核心运行线程，完成以下工作：
- * 1. 自动重连管理（当串口断开时定期尝试重新连接）
- * 2. 请求发送（遍历待处理队列，发送未发送的请求）
- * 3. 数据接收（从串口读取数据并缓存）
- * 4. 帧解析（从接收缓冲区解析完整帧）
- * 5. 响应处理（匹配响应与请求，唤醒等待线程）
- * 6. 请求超时检查（定期检查请求是否超时）
- * 
- * 线程运行在一个无限循环中，直到 ctx->running 被设置为 false
+ * @details 所有上下文共用的事件循环：
+ * 1. 依次服务每个上下文（重连、发送、超时），取最短的等待时间
+ * 2. epoll_wait 等待任一串口可读、新请求（共用 eventfd）或最近的超时
+ * 3. 按事件标识找到上下文处理接收；槽位已释放或代数不符的事件直接丢弃
+ * 反应器 mutex 只在查槽位表时持有：上下文的 I/O、文件写入和 SDK 回调都在锁外进行，
+ * 由 busy 标记保证期间上下文不会被注销
  */
-static void *io_thread_func(void *arg) {
-    air8000_t *ctx = (air8000_t *)arg;
-    uint64_t last_reconnect_time = 0;
+static void *reactor_thread_func(void *arg) {
+    (void)arg;
+    reactor_t *r = &g_reactor;
     uint8_t tx_buf[MAX_TX_BUFFER];
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    uint32_t sched_gen = 0;
     
-    while (ctx->running) {
-        uint64_t now = get_time_ms();
-        
-        // 1. 自动重连逻辑
-        if (!ctx->connected) {
-            if (now - last_reconnect_time > RECONNECT_INTERVAL_MS) {
-                last_reconnect_time = now;
-                // 尝试重连
-                if (air8000_serial_open(&ctx->serial, ctx->device_path) == 0) {
-                    pthread_mutex_lock(&ctx->ctx_mutex);
-                    ctx->connected = true;
-                    pthread_mutex_unlock(&ctx->ctx_mutex);
-                    log_info("air8000", "Reconnected to %s", ctx->device_path);
-                }
-            }
-            
-            // 未连接时，检查所有 Pending 请求是否超时
-            pthread_mutex_lock(&ctx->ctx_mutex);
-            request_t *curr = ctx->pending_list;
-            // 修复：重新获取当前时间，避免使用旧的now值导致误判
-            uint64_t current_time = get_time_ms();
-            while (curr) {
-                if (curr->state == REQ_STATE_PENDING && (current_time - curr->start_time > curr->timeout_ms)) {
-                    // 从映射表中移除
-                    ctx->pending_map[curr->req_frame.seq] = NULL;
-                    
-                    pthread_mutex_lock(&curr->mutex);
-                    curr->state = REQ_STATE_TIMEOUT;
-                    curr->result_code = AIR8000_ERR_TIMEOUT; // Timeout
-                    pthread_cond_signal(&curr->cond);
-                    pthread_mutex_unlock(&curr->mutex);
+    pthread_mutex_lock(&r->mutex);
+    while (r->running) {
+        int wait_ms = IO_THREAD_IDLE_MS;
+        for (int i = 0; i < AIR8000_MAX_CONTEXTS; i++) {
+            air8000_t *ctx = r->slots[i];
+            if (ctx) {
+                reactor_enter_locked(r, ctx);
+                int w = context_service(ctx, tx_buf, sizeof(tx_buf));
+                reactor_leave(r);
+                if (w < wait_ms) {
+                    wait_ms = w;
                 }
-                curr = curr->next;
             }
-            pthread_mutex_unlock(&ctx->ctx_mutex);
-            
-            usleep(100000); // 100ms sleep
-            continue;
         }
+        pm_sched_profile_t sched;
+        bool apply_sched = r->io_sched_gen != sched_gen;
+        if (apply_sched) {
+            sched = r->io_sched;
+            sched_gen = r->io_sched_gen;
+        }
+        pthread_mutex_unlock(&r->mutex);
         
-        // 2. 发送逻辑 (遍历链表，找到未发送的请求)
-        pthread_mutex_lock(&ctx->ctx_mutex);
-        request_t *curr = ctx->pending_list;
-        if (curr) {
-            while (curr) {
-                if (curr->state == REQ_STATE_PENDING && !curr->sent) {
-                    // 尝试发送
-                    int encoded_len = air8000_frame_encode(&curr->req_frame, tx_buf, sizeof(tx_buf));
-                    if (encoded_len > 0) {
-                        int written = air8000_serial_write(&ctx->serial, tx_buf, encoded_len);
-                        if (written > 0) {
-                            curr->sent = true;
-                            // 打印发送数据
-                            log_info("air8000", "Sent CMD: 0x%04X, Len: %d", curr->req_frame.cmd, encoded_len);
-                        } else {
-                            // 发送失败，可能是断开连接，标记连接状态为断开
-                            log_error("air8000", "Serial write failed, disconnecting...");
-                            ctx->connected = false;
-                            air8000_serial_close(&ctx->serial);
-                            break; // 跳出当前循环，下一次迭代会处理重连
-                        }
-                    } else {
-                        log_error("air8000", "Frame encode failed - len=%d", encoded_len);
-                    }
-                }
-                curr = curr->next;
+        // 调度配置只能由线程自己应用（mlockall 可能耗时，不持锁）
+        if (apply_sched) {
+            char desc[128];
+            if (pm_sched_apply_thread(&sched) == 0) {
+                log_info("air8000", "I/O thread scheduling: %s", pm_sched_describe(&sched, desc, sizeof(desc)));
+            } else {
+                log_warn("air8000", "I/O thread scheduling partly applied: %s", pm_sched_describe(&sched, desc, sizeof(desc)));
             }
         }
-        pthread_mutex_unlock(&ctx->ctx_mutex);
         
-        // 3. 接收逻辑
-        int read_len = air8000_serial_read(&ctx->serial, 
-                                          &ctx->rx_buffer[ctx->rx_len], 
-                                          MAX_RX_BUFFER - ctx->rx_len, 
-                                          IO_THREAD_POLL_MS);
-                                          
-        if (read_len < 0) {
-            // 读取错误 (断开连接)
-            log_error("air8000", "Serial read error, disconnecting...");
-            pthread_mutex_lock(&ctx->ctx_mutex);
-            ctx->connected = false;
-            air8000_serial_close(&ctx->serial);
-            pthread_mutex_unlock(&ctx->ctx_mutex);
-            // 错误后不继续处理
-        } else if (read_len > 0) {
-            ctx->rx_len += read_len;
-            
-            // 解析帧
-            while (ctx->rx_len > 0) {
-                air8000_frame_t frame;
-                air8000_frame_init(&frame); // 必须初始化，否则 frame.data 是随机值，导致 air8000_frame_parse 中 free 崩溃
-                
-                int frame_len = air8000_frame_parse(ctx->rx_buffer, ctx->rx_len, &frame);
-                
-                if (frame_len > 0) {
-                    // 收到完整帧
-                    if (frame.type == FRAME_TYPE_NOTIFY) {
-                        // 复制回调信息到局部变量，避免持有锁调用回调
-                        air8000_notify_cb_t cb = NULL;
-                        void *ud = NULL;
-
-                        pthread_mutex_lock(&ctx->ctx_mutex);
-                        cb = ctx->notify_cb;
-                        ud = ctx->notify_user_data;
-                        pthread_mutex_unlock(&ctx->ctx_mutex);
-
-                        if (cb) {
-                            cb(&frame, ud);
-                        }
-                        // 释放NOTIFY帧的数据
-                        air8000_frame_cleanup(&frame);
-                    } else {
-                        // 检查是否是文件传输或FOTA相关请求
-                        if (frame.type == FRAME_TYPE_REQUEST) {
-                            // 处理文件传输请求
-                            air8000_file_transfer_handle_request(ctx, &frame);
-                            // FOTA升级请求现在由应用层处理，不需要在这里调用
-                        } else {
-                            // 打印接收数据
-                            log_info("air8000", "Received CMD: 0x%04X, Len: %d", frame.cmd, frame_len);
-                            
-                            // 翻译后的数据打印
-                            if (frame.data_len > 0 && frame.data) {
-                                switch (frame.cmd) {
-                                    case CMD_SYS_VERSION:
-                                        {
-                                            air8000_version_t ver;
-                                            if (air8000_parse_version(frame.data, frame.data_len, &ver) == 0) {
-                                                printf("[PARSED] Version: V%d.%d.%d (%s)\n", ver.major, ver.minor, ver.patch, ver.build);
-                                            }
-                                        }
-                                        break;
-                                    case CMD_SENSOR_READ_TEMP:
-                                        {
-                                            float temp;
-                                            if (air8000_parse_motor_float_resp(frame.data, frame.data_len, NULL, &temp) == 0) {
-                                                printf("[PARSED] Temperature: %.2f C\n", temp);
-                                            }
-                                        }
-                                        break;
-                                    case CMD_SENSOR_READ_ALL:
-                                        {
-                                            air8000_sensor_data_t sensor_data;
-                                            if (air8000_parse_sensor_data(frame.data, frame.data_len, &sensor_data) == 0) {
-                                                printf("[PARSED] All Sensors - Temp: %.2f C, Humidity: %d%%, Light: %d, Battery: %d%%\n", 
-                                                       sensor_data.temperature, sensor_data.humidity, sensor_data.light, sensor_data.battery);
-                                            }
-                                        }
-                                        break;
-                                    case CMD_QUERY_POWER:
-                                        {
-                                            air8000_power_adc_t power;
-                                            if (air8000_parse_power_adc(frame.data, frame.data_len, &power) == 0) {
-                                                printf("[PARSED] Power - 12V: %.2f V, Battery: %.2f V\n", 
-                                                       power.v12_mv / 1000.0, power.vbat_mv / 1000.0);
-                                            }
-                                        }
-                                        break;
-                                    case CMD_QUERY_NETWORK:
-                                        {
-                                            air8000_network_status_t net;
-                                            if (air8000_parse_network_status(frame.data, frame.data_len, &net) == 0) {
-                                                printf("[PARSED] Network - CSQ: %d, RSSI: %d, RSRP: %d, Status: %d\n", 
-                                                       net.csq, net.rssi, net.rsrp, net.status);
-                                            }
-                                        }
-                                        break;
-                                    default:
-                                        // 其他命令暂不打印详细解析
-                                        break;
-                                }
-                            }
-                            
-                            // 查找匹配的请求 (Fix 10: O(1) lookup)
-                            request_t *req = ctx->pending_map[frame.seq];
-
-                            if (req && req->state == REQ_STATE_PENDING && req->req_frame.cmd == frame.cmd) {
-                         // 匹配成功
-                         if (req->resp_frame) {
-                             // 手动复制响应帧字段，避免浅拷贝导致的双重释放
-                             req->resp_frame->version = frame.version;
-                             req->resp_frame->type = frame.type;
-                             req->resp_frame->seq = frame.seq;
-                             req->resp_frame->cmd = frame.cmd;
-                             req->resp_frame->data_len = frame.data_len;
-                               
-                             // 深拷贝数据
-                             if (frame.data_len > 0 && frame.data) {
-                                 req->resp_frame->data = malloc(frame.data_len);
-                                 if (req->resp_frame->data) {
-                                     memcpy(req->resp_frame->data, frame.data, frame.data_len);
-                                 } else {
-                                     // 修复：内存分配失败时，保持data_len不变，只将data设为NULL
-                                     req->resp_frame->data = NULL;
-                                 }
-                             } else {
-                                 req->resp_frame->data = NULL;
-                             }
-                         }
-
-                         // 从映射表中移除
-                         ctx->pending_map[frame.seq] = NULL;
-
-                         pthread_mutex_lock(&req->mutex);
-                         req->state = REQ_STATE_COMPLETED;
-                         req->result_code = AIR8000_OK;
-                         pthread_cond_signal(&req->cond);
-                         pthread_mutex_unlock(&req->mutex);
-                    }
-                        }
-                        // 释放非NOTIFY帧的数据
-                        air8000_frame_cleanup(&frame);
-                    }
-                    
-                    // 移除缓冲区数据
-                    memmove(ctx->rx_buffer, &ctx->rx_buffer[frame_len], ctx->rx_len - frame_len);
-                    ctx->rx_len -= frame_len;
-                    
-                } else if (frame_len == -2) {
-                    // 无效头
-                    memmove(ctx->rx_buffer, &ctx->rx_buffer[1], ctx->rx_len - 1);
-                    ctx->rx_len--;
-                } else {
-                    break; // 不完整
-                }
-            }
-        } else if (read_len < 0) {
-            // 读取错误 (断开连接)
-            printf("Air8000: Serial read error, disconnecting...\n");
-            pthread_mutex_lock(&ctx->ctx_mutex);
-            ctx->connected = false;
-            air8000_serial_close(&ctx->serial);
-            pthread_mutex_unlock(&ctx->ctx_mutex);
+        int n = epoll_wait(r->epoll_fd, events, REACTOR_MAX_EVENTS, wait_ms);
+        if (n < 0 && errno != EINTR) {
+            log_error("air8000", "epoll_wait failed: %s", strerror(errno));
         }
+        pm_sched_sample(PM_CNT_UART_IO_CSW_VOLUNTARY, PM_CNT_UART_IO_CSW_INVOLUNTARY);
         
-        // 4. 超时检查
-        pthread_mutex_lock(&ctx->ctx_mutex);
-        curr = ctx->pending_list;
-        // 修复：重新获取当前时间，保持与未连接状态下的检查逻辑一致
-        uint64_t current_time = get_time_ms();
-        while (curr) {
-            if (curr->state == REQ_STATE_PENDING && (current_time - curr->start_time > curr->timeout_ms)) {
-                // 从映射表中移除
-                ctx->pending_map[curr->req_frame.seq] = NULL;
-                
-                pthread_mutex_lock(&curr->mutex);
-                curr->state = REQ_STATE_TIMEOUT;
-                curr->result_code = AIR8000_ERR_TIMEOUT; // Timeout
-                pthread_cond_signal(&curr->cond);
-                pthread_mutex_unlock(&curr->mutex);
+        pthread_mutex_lock(&r->mutex);
+        for (int i = 0; i < n; i++) {
+            uint64_t key = events[i].data.u64;
+            if (key == REACTOR_KEY_WAKE) {
+                uint64_t count;
+                ssize_t len = read(r->wake_fd, &count, sizeof(count));
+                (void)len; // 非阻塞 fd，计数为 0 时返回 EAGAIN
+                continue;
+            }
+            int slot = (int)(key & 0xFF);
+            air8000_t *ctx = (slot < AIR8000_MAX_CONTEXTS) ? r->slots[slot] : NULL;
+            if (ctx && reactor_key(slot) == key) {
+                reactor_enter_locked(r, ctx);
+                context_on_serial(ctx, events[i].events);
+                reactor_leave(r);
             }
-            curr = curr->next;
         }
-        pthread_mutex_unlock(&ctx->ctx_mutex);
     }
+    pthread_mutex_unlock(&r->mutex);
     
     return NULL;
 }
 
+/**
+ * @brief 启动反应器（调用者需持有 g_reactor_lifecycle，且没有已注册的上下文）
+ * @return 成功返回0，失败返回 AIR8000_ERR_IO
+ */
+static int reactor_start(void) {
+    reactor_t *r = &g_reactor;
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epoll_fd < 0) {
+        log_error("air8000", "epoll_create1 failed: %s", strerror(errno));
+        return AIR8000_ERR_IO;
+    }
+    r->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_KEY_WAKE;
+    if (r->wake_fd < 0 || epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->wake_fd, &ev) != 0) {
+        log_error("air8000", "reactor eventfd setup failed: %s", strerror(errno));
+        goto fail;
+    }
+    
+    r->running = true;
+    if (pthread_create(&r->thread, NULL, reactor_thread_func, NULL) != 0) {
+        log_error("air8000", "pthread_create for reactor failed");
+        r->running = false;
+        goto fail;
+    }
+    return AIR8000_OK;
+    
+fail:
+    if (r->wake_fd >= 0) {
+        close(r->wake_fd);
+        r->wake_fd = -1;
+    }
+    close(r->epoll_fd);
+    r->epoll_fd = -1;
+    return AIR8000_ERR_IO;
+}
+
+/**
+ * @brief 停止反应器（调用者需持有 g_reactor_lifecycle，且所有上下文均已注销）
+ */
+static void reactor_stop(void) {
+    reactor_t *r = &g_reactor;
+    pthread_mutex_lock(&r->mutex);
+    r->running = false;
+    pthread_mutex_unlock(&r->mutex);
+    
+    uint64_t one = 1;
+    ssize_t n = write(r->wake_fd, &one, sizeof(one));
+    (void)n;
+    pthread_join(r->thread, NULL);
+    
+    close(r->wake_fd);
+    close(r->epoll_fd);
+    r->wake_fd = -1;
+    r->epoll_fd = -1;
+}
+
+/**
+ * @brief 把上下文注册到反应器
+ * @param ctx 上下文指针（串口可能已打开）
+ * @return 成功返回0，上下文数已达 AIR8000_MAX_CONTEXTS 返回 AIR8000_ERR_BUSY，启动反应器失败返回 AIR8000_ERR_IO
+ */
+static int reactor_attach(air8000_t *ctx) {
+    reactor_t *r = &g_reactor;
+    pthread_mutex_lock(&g_reactor_lifecycle);
+    if (r->refs == 0) {
+        int ret = reactor_start();
+        if (ret != AIR8000_OK) {
+            pthread_mutex_unlock(&g_reactor_lifecycle);
+            return ret;
+        }
+    }
+    
+    pthread_mutex_lock(&r->mutex);
+    int slot = -1;
+    for (int i = 0; i < AIR8000_MAX_CONTEXTS; i++) {
+        if (!r->slots[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        pthread_mutex_unlock(&r->mutex);
+        log_error("air8000", "Too many Air8000 contexts (max %d), %s not attached",
+                  AIR8000_MAX_CONTEXTS, ctx->device_path);
+        pthread_mutex_unlock(&g_reactor_lifecycle);
+        return AIR8000_ERR_BUSY;
+    }
+    
+    ctx->reactor_slot = slot;
+    ctx->wake_fd = r->wake_fd;
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    if (ctx->connected) {
+        watch_serial_locked(ctx);
+    }
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    r->slots[slot] = ctx;
+    r->refs++;
+    pthread_mutex_unlock(&r->mutex);
+    
+    wake_io_thread(ctx);
+    pthread_mutex_unlock(&g_reactor_lifecycle);
+    return AIR8000_OK;
+}
+
+/**
+ * @brief 从反应器注销上下文
+ * @param ctx 上下文指针
+ * @details 返回后反应器线程不会再访问该上下文；最后一个上下文注销时停止反应器线程。
+ *          不能在该上下文自己的 SDK 回调中调用（会等待自身）
+ */
+static void reactor_detach(air8000_t *ctx) {
+    reactor_t *r = &g_reactor;
+    
+    // 先摘下槽位：等反应器线程放手该上下文时不持有 g_reactor_lifecycle，
+    // 该上下文的回调中注册新上下文不会与这里互相等待
+    pthread_mutex_lock(&r->mutex);
+    while (r->busy == ctx) {
+        pthread_cond_wait(&r->idle_cond, &r->mutex);
+    }
+    int slot = ctx->reactor_slot;
+    r->slots[slot] = NULL;
+    r->gens[slot]++;
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    if (ctx->connected && ctx->serial.fd >= 0) {
+        epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, ctx->serial.fd, NULL);
+    }
+    ctx->wake_fd = -1; // 反应器停止后 eventfd 会被关闭
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    ctx->reactor_slot = -1;
+    pthread_mutex_unlock(&r->mutex);
+    
+    pthread_mutex_lock(&g_reactor_lifecycle);
+    pthread_mutex_lock(&r->mutex);
+    bool last = (--r->refs == 0);
+    pthread_mutex_unlock(&r->mutex);
+    if (last) {
+        reactor_stop();
+    }
+    pthread_mutex_unlock(&g_reactor_lifecycle);
+}
+
 // ==================== 辅助函数 ====================
 
 /**
@@ -973,6 +2302,88 @@ int air8000_motor_rotate(air8000_t *ctx, uint8_t motor_id, float angle, float ve
     return ret;
 }
 
+/**
+ * @brief 多电机批量绝对旋转
+ * @param ctx 上下文指针
+ * @param cmds 电机子命令数组
+ * @param count 子命令个数 (1 ~ AIR8000_MOTOR_BATCH_MAX)
+ * @param start_delay_ms 同步启动延时（毫秒），0 表示收到后立即启动
+ * @param timeout_ms 超时时间（毫秒）
+ * @return 成功返回0，设备拒绝返回 -1，其他失败返回错误码
+ * @details 优先使用 CMD_MOTOR_ROTATE_BATCH 一帧下发所有电机，设备收齐后同步启动；
+ *          首次调用时若设备以 ERROR_UNKNOWN_CMD 拒绝，记住固件不支持，之后直接回退为
+ *          连续提交多个 CMD_MOTOR_ROTATE：各帧在同一次发送中背靠背写出，
+ *          相邻电机的启动间隔不超过一帧的传输时间（9 字节负载 115200 波特率下约 1.7ms）
+ */
+int air8000_motor_rotate_batch(air8000_t *ctx, const air8000_motor_cmd_t *cmds, size_t count,
+                               uint16_t start_delay_ms, int timeout_ms) {
+    if (!ctx || !cmds || count == 0 || count > AIR8000_MOTOR_BATCH_MAX) return AIR8000_ERR_PARAM;
+    
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    int support = ctx->motor_batch_support;
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    
+    if (support != 0) {
+        air8000_frame_t req, resp;
+        air8000_frame_init(&resp);
+        air8000_build_motor_rotate_batch(&req, cmds, count, start_delay_ms);
+        int ret = air8000_send_and_wait(ctx, &req, &resp, timeout_ms);
+        air8000_frame_cleanup(&req);
+        if (ret != AIR8000_OK) {
+            return ret;
+        }
+        
+        bool unknown_cmd = (resp.type == FRAME_TYPE_NACK && resp.data_len >= 1 &&
+                            resp.data && resp.data[0] == ERROR_UNKNOWN_CMD);
+        bool success = (resp.type == FRAME_TYPE_ACK || resp.type == FRAME_TYPE_RESPONSE);
+        air8000_frame_cleanup(&resp);
+        
+        pthread_mutex_lock(&ctx->ctx_mutex);
+        ctx->motor_batch_support = unknown_cmd ? 0 : 1;
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        
+        if (!unknown_cmd) {
+            return success ? 0 : -1;
+        }
+        log_info("air8000", "Firmware does not support batch rotate, falling back to pipelined commands");
+    }
+    
+    // 回退：每个电机一帧，连续写出
+    air8000_frame_t reqs[AIR8000_MOTOR_BATCH_MAX];
+    air8000_frame_t resps[AIR8000_MOTOR_BATCH_MAX];
+    for (size_t i = 0; i < count; i++) {
+        air8000_build_motor_rotate(&reqs[i], cmds[i].motor_id, cmds[i].angle, cmds[i].velocity);
+        air8000_frame_init(&resps[i]);
+    }
+    
+    int ret = send_burst_and_wait(ctx, reqs, resps, count, timeout_ms);
+    bool success = true;
+    for (size_t i = 0; i < count; i++) {
+        if (ret == AIR8000_OK && resps[i].type != FRAME_TYPE_ACK && resps[i].type != FRAME_TYPE_RESPONSE) {
+            success = false;
+        }
+        air8000_frame_cleanup(&reqs[i]);
+        air8000_frame_cleanup(&resps[i]);
+    }
+    if (ret != AIR8000_OK) {
+        return ret;
+    }
+    return success ? 0 : -1;
+}
+
+/**
+ * @brief 查询固件是否支持批量旋转命令
+ * @param ctx 上下文指针
+ * @return 1 支持，0 不支持，-1 尚未探测（第一次 air8000_motor_rotate_batch 调用后确定）
+ */
+int air8000_motor_batch_supported(air8000_t *ctx) {
+    if (!ctx) return -1;
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    int support = ctx->motor_batch_support;
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    return support;
+}
+
 /**
  * @brief 电机相对旋转
  * @param ctx 上下文指针
@@ -1386,6 +2797,122 @@ int air8000_sensor_read_all(air8000_t *ctx, air8000_sensor_data_t *data, int tim
     return ret;
 }
 
+// ==================== 遥测订阅 ====================
+
+/**
+ * @brief 下发遥测订阅命令
+ * @param ctx 上下文指针
+ * @param mask 数据项掩码，0 表示取消订阅
+ * @param period_ms 上报周期，单位毫秒
+ * @param timeout_ms 超时时间（毫秒）
+ * @return 成功返回0，失败返回错误码
+ */
+static int send_telemetry_subscribe(air8000_t *ctx, uint8_t mask, uint16_t period_ms, int timeout_ms) {
+    uint8_t data[3];
+    data[0] = mask;
+    data[1] = (uint8_t)(period_ms >> 8);
+    data[2] = (uint8_t)(period_ms & 0xFF);
+    
+    air8000_frame_t req, resp;
+    air8000_frame_init(&req);
+    req.type = FRAME_TYPE_REQUEST;
+    req.seq = air8000_next_seq();
+    req.cmd = CMD_TELEMETRY_SUBSCRIBE;
+    req.data = data;
+    req.data_len = sizeof(data);
+    
+    int ret = air8000_send_and_wait(ctx, &req, &resp, timeout_ms);
+    if (ret == 0) {
+        if (resp.type != FRAME_TYPE_ACK && resp.type != FRAME_TYPE_RESPONSE) {
+            ret = -1;
+        }
+        air8000_frame_cleanup(&resp);
+    }
+    return ret;
+}
+
+/**
+ * @brief 订阅设备主动上报的遥测数据
+ * @param ctx 上下文指针
+ * @param mask 数据项掩码
+ * @param period_ms 上报周期，单位毫秒
+ * @param cb 遥测回调，可为NULL
+ * @param user_data 回调用户数据
+ * @param timeout_ms 超时时间（毫秒）
+ * @return 成功返回0，失败返回错误码
+ * @details 先安装回调再下发命令，保证不漏掉第一帧上报；订阅成功后记录参数用于重连后重新订阅
+ */
+int air8000_subscribe_telemetry(air8000_t *ctx, uint8_t mask, uint16_t period_ms,
+                                air8000_telemetry_cb_t cb, void *user_data, int timeout_ms) {
+    if (!ctx || mask == 0 || (mask & ~AIR8000_TELEMETRY_ALL) ||
+        period_ms < AIR8000_TELEMETRY_MIN_PERIOD_MS) {
+        return AIR8000_ERR_PARAM;
+    }
+    
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    ctx->telemetry_cb = cb;
+    ctx->telemetry_user_data = user_data;
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    
+    int ret = send_telemetry_subscribe(ctx, mask, period_ms, timeout_ms);
+    if (ret == 0) {
+        pthread_mutex_lock(&ctx->ctx_mutex);
+        ctx->telemetry_mask = mask;
+        ctx->telemetry_period_ms = period_ms;
+        pthread_mutex_unlock(&ctx->ctx_mutex);
+        log_info("air8000", "Telemetry subscribed: mask 0x%02X, period %u ms", mask, period_ms);
+    }
+    return ret;
+}
+
+/**
+ * @brief 取消遥测订阅
+ * @param ctx 上下文指针
+ * @param timeout_ms 超时时间（毫秒）
+ * @return 成功返回0，失败返回错误码
+ * @details 无论设备是否应答，本地先清除订阅参数和回调，重连后不再重新订阅
+ */
+int air8000_unsubscribe_telemetry(air8000_t *ctx, int timeout_ms) {
+    if (!ctx) return AIR8000_ERR_PARAM;
+    
+    pthread_mutex_lock(&ctx->ctx_mutex);
+    ctx->telemetry_mask = 0;
+    ctx->telemetry_period_ms = 0;
+    ctx->telemetry_cb = NULL;
+    ctx->telemetry_user_data = NULL;
+    pthread_mutex_unlock(&ctx->ctx_mutex);
+    
+    return send_telemetry_subscribe(ctx, 0, 0, timeout_ms);
+}
+
+/**
+ * @brief 读取最新的遥测快照
+ * @param ctx 上下文指针
+ * @param out 输出快照
+ * @return 成功返回0，尚未收到上报返回 AIR8000_ERR_TIMEOUT
+ * @details 拷贝前后读取缓冲代数，期间被 I/O 线程改写（代数变化或为奇数）时重读；
+ *          上报周期远大于一次拷贝的时间，实际几乎不会重试
+ */
+int air8000_telemetry_read(air8000_t *ctx, air8000_telemetry_t *out) {
+    if (!ctx || !out) return AIR8000_ERR_PARAM;
+    
+    for (;;) {
+        int idx = __atomic_load_n(&ctx->telemetry_published, __ATOMIC_ACQUIRE);
+        if (idx < 0) {
+            return AIR8000_ERR_TIMEOUT;
+        }
+        uint32_t gen = __atomic_load_n(&ctx->telemetry_gen[idx], __ATOMIC_ACQUIRE);
+        if (gen & 1) {
+            continue;
+        }
+        memcpy(out, &ctx->telemetry[idx], sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&ctx->telemetry_gen[idx], __ATOMIC_RELAXED) == gen) {
+            return AIR8000_OK;
+        }
+    }
+}
+
 // ==================== 看门狗命令 ====================
 
 /**
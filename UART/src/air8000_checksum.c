@@ -0,0 +1,365 @@
+/**
+ * @file air8000_checksum.c
+ * @brief Air8000 校验和模块实现
+ * @details CRC16/MODBUS、CRC32 与 CRC32C 的 bitwise / table / slice-by-8 实现以及
+ *          ARMv8 CRC32/CRC32C 指令实现，启动时一次性生成查表并选择实现
+ *
+ * slice-by-8 原理（反射型 CRC）：
+ * - T[0] 为标准单字节表，T[k][b] = (T[k-1][b] >> 8) ^ T[0][T[k-1][b] & 0xFF]
+ * - 先把 CRC 寄存器异或进前 2 字节（CRC16）或前 4 字节（CRC32/CRC32C），
+ *   然后 8 个字节各查一张表并异或，相当于一次推进 8 个字节
+ * - 按字节下标取数据，不依赖对齐和主机字节序
+ */
+
+#include "air8000_checksum.h"
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__ARM_FEATURE_CRC32) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define AIR8000_HAVE_ARMV8_CRC 1
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#endif
+
+// ==================== 内部变量 ====================
+
+/**
+ * @brief CRC16/MODBUS 反射多项式
+ */
+#define CRC16_MODBUS_POLY 0xA001
+
+/**
+ * @brief CRC32 (IEEE 802.3) 反射多项式
+ */
+#define CRC32_POLY 0xEDB88320U
+
+/**
+ * @brief CRC32C (Castagnoli) 反射多项式
+ */
+#define CRC32C_POLY 0x82F63B78U
+
+/**
+ * @brief CRC16 slice-by-8 查表，crc16_table[0] 即单字节表
+ */
+static uint16_t crc16_table[8][256];
+
+/**
+ * @brief CRC32 slice-by-8 查表，crc32_table[0] 即单字节表
+ */
+static uint32_t crc32_table[8][256];
+
+/**
+ * @brief CRC32C slice-by-8 查表，crc32c_table[0] 即单字节表
+ */
+static uint32_t crc32c_table[8][256];
+
+/**
+ * @brief 一次性初始化控制
+ */
+static pthread_once_t g_checksum_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief CRC 实现函数类型
+ * @details CRC32/CRC32C 实现操作的是取反后的寄存器值，由 *_update 负责取反
+ */
+typedef uint16_t (*crc16_fn_t)(uint16_t crc, const uint8_t *data, size_t len);
+typedef uint32_t (*crc32_fn_t)(uint32_t crc, const uint8_t *data, size_t len);
+
+static uint16_t crc16_first_call(uint16_t crc, const uint8_t *data, size_t len);
+static uint32_t crc32_first_call(uint32_t crc, const uint8_t *data, size_t len);
+static uint32_t crc32c_first_call(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief 当前选中的实现，首次调用时完成初始化后替换
+ */
+static crc16_fn_t g_crc16_fn = crc16_first_call;
+static crc32_fn_t g_crc32_fn = crc32_first_call;
+static crc32_fn_t g_crc32c_fn = crc32c_first_call;
+static const char *g_impl_name = "uninitialized";
+
+// ==================== 各实现 ====================
+
+static uint16_t crc16_bitwise(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i];
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 0x0001) ? (crc >> 1) ^ CRC16_MODBUS_POLY : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t crc16_table1(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ crc16_table[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint16_t crc16_slice8(uint16_t crc, const uint8_t *data, size_t len) {
+    while (len >= 8) {
+        crc = crc16_table[7][(crc ^ data[0]) & 0xFF] ^
+              crc16_table[6][((crc >> 8) ^ data[1]) & 0xFF] ^
+              crc16_table[5][data[2]] ^
+              crc16_table[4][data[3]] ^
+              crc16_table[3][data[4]] ^
+              crc16_table[2][data[5]] ^
+              crc16_table[1][data[6]] ^
+              crc16_table[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+    return crc16_table1(crc, data, len);
+}
+
+static uint32_t crc32_bitwise(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32_POLY : 0);
+        }
+    }
+    return crc;
+}
+
+static uint32_t crc32_table1(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ crc32_table[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len >= 8) {
+        crc = crc32_table[7][(crc ^ data[0]) & 0xFF] ^
+              crc32_table[6][((crc >> 8) ^ data[1]) & 0xFF] ^
+              crc32_table[5][((crc >> 16) ^ data[2]) & 0xFF] ^
+              crc32_table[4][((crc >> 24) ^ data[3]) & 0xFF] ^
+              crc32_table[3][data[4]] ^
+              crc32_table[2][data[5]] ^
+              crc32_table[1][data[6]] ^
+              crc32_table[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+    return crc32_table1(crc, data, len);
+}
+
+static uint32_t crc32c_bitwise(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+    }
+    return crc;
+}
+
+static uint32_t crc32c_table1(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint32_t crc32c_slice8(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len >= 8) {
+        crc = crc32c_table[7][(crc ^ data[0]) & 0xFF] ^
+              crc32c_table[6][((crc >> 8) ^ data[1]) & 0xFF] ^
+              crc32c_table[5][((crc >> 16) ^ data[2]) & 0xFF] ^
+              crc32c_table[4][((crc >> 24) ^ data[3]) & 0xFF] ^
+              crc32c_table[3][data[4]] ^
+              crc32c_table[2][data[5]] ^
+              crc32c_table[1][data[6]] ^
+              crc32c_table[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+    return crc32c_table1(crc, data, len);
+}
+
+#ifdef AIR8000_HAVE_ARMV8_CRC
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len > 0 && ((uintptr_t)data & 3)) {
+        crc = __crc32b(crc, *data++);
+        len--;
+    }
+    while (len >= 4) {
+        uint32_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32w(crc, word);
+        data += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        crc = __crc32b(crc, *data++);
+        len--;
+    }
+    return crc;
+}
+
+static uint32_t crc32c_armv8(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len > 0 && ((uintptr_t)data & 3)) {
+        crc = __crc32cb(crc, *data++);
+        len--;
+    }
+    while (len >= 4) {
+        uint32_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32cw(crc, word);
+        data += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        crc = __crc32cb(crc, *data++);
+        len--;
+    }
+    return crc;
+}
+
+/**
+ * @brief 运行时检测 CPU 是否支持 CRC32 指令（同时覆盖 CRC32C 指令）
+ */
+static int cpu_has_crc32(void) {
+#if defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & (1UL << 7)) != 0;   /* HWCAP_CRC32 */
+#else
+    return (getauxval(AT_HWCAP2) & (1UL << 4)) != 0;  /* HWCAP2_CRC32 */
+#endif
+}
+#endif
+
+// ==================== 初始化与选择 ====================
+
+/**
+ * @brief 生成 slice-by-8 查表
+ */
+static void build_tables(void) {
+    for (int i = 0; i < 256; i++) {
+        uint16_t c16 = (uint16_t)i;
+        uint32_t c32 = (uint32_t)i;
+        uint32_t c32c = (uint32_t)i;
+        for (int j = 0; j < 8; j++) {
+            c16 = (c16 & 1) ? (c16 >> 1) ^ CRC16_MODBUS_POLY : c16 >> 1;
+            c32 = (c32 & 1) ? (c32 >> 1) ^ CRC32_POLY : c32 >> 1;
+            c32c = (c32c & 1) ? (c32c >> 1) ^ CRC32C_POLY : c32c >> 1;
+        }
+        crc16_table[0][i] = c16;
+        crc32_table[0][i] = c32;
+        crc32c_table[0][i] = c32c;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            uint16_t p16 = crc16_table[k - 1][i];
+            uint32_t p32 = crc32_table[k - 1][i];
+            uint32_t p32c = crc32c_table[k - 1][i];
+            crc16_table[k][i] = (p16 >> 8) ^ crc16_table[0][p16 & 0xFF];
+            crc32_table[k][i] = (p32 >> 8) ^ crc32_table[0][p32 & 0xFF];
+            crc32c_table[k][i] = (p32c >> 8) ^ crc32c_table[0][p32c & 0xFF];
+        }
+    }
+}
+
+/**
+ * @brief 切换实现
+ * @return 成功返回0，不支持返回 -1
+ */
+static int apply_impl(air8000_csum_impl_t impl) {
+    switch (impl) {
+        case AIR8000_CSUM_BITWISE:
+            g_crc16_fn = crc16_bitwise;
+            g_crc32_fn = crc32_bitwise;
+            g_crc32c_fn = crc32c_bitwise;
+            g_impl_name = "bitwise";
+            return 0;
+        case AIR8000_CSUM_TABLE:
+            g_crc16_fn = crc16_table1;
+            g_crc32_fn = crc32_table1;
+            g_crc32c_fn = crc32c_table1;
+            g_impl_name = "table";
+            return 0;
+        case AIR8000_CSUM_SLICE8:
+            g_crc16_fn = crc16_slice8;
+            g_crc32_fn = crc32_slice8;
+            g_crc32c_fn = crc32c_slice8;
+            g_impl_name = "slice8";
+            return 0;
+        case AIR8000_CSUM_ARMV8_CRC:
+#ifdef AIR8000_HAVE_ARMV8_CRC
+            if (cpu_has_crc32()) {
+                g_crc16_fn = crc16_slice8;  /* CRC16/MODBUS 没有对应硬件指令 */
+                g_crc32_fn = crc32_armv8;
+                g_crc32c_fn = crc32c_armv8;
+                g_impl_name = "armv8-crc";
+                return 0;
+            }
+#endif
+            return -1;
+        case AIR8000_CSUM_AUTO:
+        default:
+            if (apply_impl(AIR8000_CSUM_ARMV8_CRC) == 0) {
+                return 0;
+            }
+            return apply_impl(AIR8000_CSUM_SLICE8);
+    }
+}
+
+static void checksum_init_once(void) {
+    build_tables();
+    apply_impl(AIR8000_CSUM_AUTO);
+}
+
+static uint16_t crc16_first_call(uint16_t crc, const uint8_t *data, size_t len) {
+    pthread_once(&g_checksum_once, checksum_init_once);
+    return g_crc16_fn(crc, data, len);
+}
+
+static uint32_t crc32_first_call(uint32_t crc, const uint8_t *data, size_t len) {
+    pthread_once(&g_checksum_once, checksum_init_once);
+    return g_crc32_fn(crc, data, len);
+}
+
+static uint32_t crc32c_first_call(uint32_t crc, const uint8_t *data, size_t len) {
+    pthread_once(&g_checksum_once, checksum_init_once);
+    return g_crc32c_fn(crc, data, len);
+}
+
+// ==================== 对外接口 ====================
+
+void air8000_checksum_init(void) {
+    pthread_once(&g_checksum_once, checksum_init_once);
+}
+
+int air8000_checksum_select(air8000_csum_impl_t impl) {
+    pthread_once(&g_checksum_once, checksum_init_once);
+    return apply_impl(impl);
+}
+
+const char *air8000_checksum_impl_name(void) {
+    pthread_once(&g_checksum_once, checksum_init_once);
+    return g_impl_name;
+}
+
+uint16_t air8000_crc16_modbus_update(uint16_t crc, const uint8_t *data, size_t len) {
+    return g_crc16_fn(crc, data, len);
+}
+
+uint32_t air8000_crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+    return g_crc32_fn(crc ^ 0xFFFFFFFFU, data, len) ^ 0xFFFFFFFFU;
+}
+
+uint32_t air8000_crc32(const uint8_t *data, size_t len) {
+    return air8000_crc32_update(0, data, len);
+}
+
+uint32_t air8000_crc32c_update(uint32_t crc, const uint8_t *data, size_t len) {
+    return g_crc32c_fn(crc ^ 0xFFFFFFFFU, data, len) ^ 0xFFFFFFFFU;
+}
+
+uint16_t air8000_crc16_modbus_bitwise(const uint8_t *data, size_t len) {
+    return crc16_bitwise(0xFFFF, data, len);
+}
+
+uint32_t air8000_crc32_bitwise(const uint8_t *data, size_t len) {
+    return crc32_bitwise(0xFFFFFFFFU, data, len) ^ 0xFFFFFFFFU;
+}
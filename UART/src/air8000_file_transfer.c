@@ -2,19 +2,36 @@
  * @file air8000_file_transfer.c
  * @brief Air8000 文件传输功能核心实现
  * @details 基于 FOTA 功能实现的文件传输功能，使用 FOTA 命令进行文件传输
+ *
+ * 断点续传：
+ * - 发送端 mmap 源文件，分片直接从映射区组帧，窗口内保持多个分片在途
+ * - 收发两端各维护一个落盘的分片位图（文件路径 + AIR8000_FILE_BITMAP_SUFFIX），
+ *   位图文件以 MAP_SHARED 映射，置位即写入页缓存，进程崩溃也不会丢失
+ * - 位图头部记录文件身份（文件大小、分片大小、修改时间、整个文件的 CRC32），
+ *   开始帧携带发送端的修改时间和 CRC32；重新发起同一文件的传输时头部一致才跳过已确认分片，
+ *   同名同大小的另一个文件会丢弃旧位图重新接收
+ * - 接收端按分片索引 pwrite 到目标偏移，乱序和重复分片都可以直接接受；
+ *   通过 CRC 校验的分片总是写入，不依赖位图判断是否已写过
  */
 
 #include "air8000_file_transfer.h"
 #include "air8000_log.h"
+#include "air8000_checksum.h"
+#include "pm_metrics.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <arpa/inet.h>
 
-// 实现 htobe64 函数，用于将 64 位主机字节序转换为大端字节序
+// 实现 htobe64 函数，用于将 64 位主机字节序转换为大端字节序（glibc 已以宏形式提供时直接使用）
+#ifndef htobe64
 static uint64_t htobe64(uint64_t host64) {
     union {
         uint64_t u64;
@@ -33,6 +50,7 @@ static uint64_t htobe64(uint64_t host64) {
 
     return be.u64;
 }
+#endif
 
 // ==================== 常量定义 ====================
 
@@ -51,17 +69,39 @@ static uint64_t htobe64(uint64_t host64) {
  */
 #define MAX_RETRY_COUNT      3
 
+/**
+ * @brief 文件分片在途窗口大小
+ * @details 同时等待确认的分片数，窗口内分片连续发送，不再逐片等待往返
+ */
+#define FILE_TRANSFER_WINDOW 8
+
+/**
+ * @brief 最大分片大小
+ * @details 分片头加分片数据必须能放进单帧数据字段
+ */
+#define MAX_BLOCK_SIZE       (AIR8000_MAX_FRAME_DATA - sizeof(air8000_file_block_t))
+
+/**
+ * @brief 分片位图文件魔数 "FTBM"
+ */
+#define FILE_BITMAP_MAGIC    0x4654424DU
+
 // ==================== 内部函数声明 ====================
 
 /**
- * @brief 计算CRC32校验和
+ * @brief 构建文件分片请求帧（窗口发送回调）
+ */
+static int build_file_block(air8000_t *ctx, uint32_t block_index, air8000_frame_t *frame, void *user_data);
+
+/**
+ * @brief 文件分片确认进度回调（窗口发送回调）
  */
-static uint32_t calculate_crc32(const uint8_t *data, size_t len);
+static void on_file_blocks_acked(air8000_t *ctx, uint32_t acked, uint32_t total, void *user_data);
 
 /**
- * @brief 发送文件分片
+ * @brief 单个文件分片确认回调，记录到发送位图（窗口发送回调）
  */
-static int send_file_block(air8000_t *ctx, FILE *file, uint32_t block_index, uint32_t block_size);
+static void on_file_block_acked(air8000_t *ctx, uint32_t block_index, void *user_data);
 
 /**
  * @brief 处理Air8000发送的文件传输开始命令
@@ -74,19 +114,14 @@ static int handle_file_transfer_start(air8000_t *ctx, const air8000_frame_t *req
 static int handle_file_transfer_data(air8000_t *ctx, const air8000_frame_t *req_frame);
 
 /**
- * @brief 发送文件传输确认
+ * @brief 发送文件传输确认（不等待响应，可在 I/O 线程中调用）
  */
 static int send_file_transfer_ack(air8000_t *ctx, uint32_t block_index, bool success);
 
 /**
  * @brief 发送文件传输完成通知
  */
-static int send_file_transfer_complete(air8000_t *ctx, bool success);
-
-/**
- * @brief 清理接收文件资源
- */
-static void cleanup_recv_file(void);
+static int send_file_transfer_complete(air8000_t *ctx, bool success, bool wait);
 
 // ==================== 内部数据结构定义 ====================
 
@@ -98,6 +133,33 @@ typedef enum {
     FILE_TRANSFER_DIR_AIR8000_TO_CV610  ///< Air8000向CV610传输
 } file_transfer_direction_t;
 
+/**
+ * @brief 分片位图文件头
+ * @details 头部之后紧跟 (total_blocks + 7) / 8 字节的位图
+ */
+typedef struct {
+    uint32_t magic;                   ///< FILE_BITMAP_MAGIC
+    uint32_t block_size;              ///< 分片大小
+    uint64_t file_size;               ///< 文件大小
+    int64_t mtime;                    ///< 源文件修改时间
+    uint32_t total_blocks;            ///< 总分片数
+    uint32_t crc32;                   ///< 整个文件的 CRC32
+} file_bitmap_hdr_t;
+
+/**
+ * @brief 分片位图
+ * @details 优先映射到位图文件；文件无法创建时退化为内存位图，只是不能跨进程续传
+ */
+typedef struct {
+    uint8_t *map;                     ///< 映射基址（内存位图时为 calloc 地址）
+    size_t map_len;                   ///< 映射长度
+    uint8_t *bits;                    ///< 位图起始地址，NULL 表示未打开
+    uint32_t total;                   ///< 总分片数
+    uint32_t done;                    ///< 已置位分片数
+    bool persistent;                  ///< 是否映射到文件
+    char path[520];                   ///< 位图文件路径
+} file_bitmap_t;
+
 /**
  * @brief 文件传输上下文结构体
  * @details 支持双向文件传输的上下文结构
@@ -114,138 +176,338 @@ typedef struct {
     uint32_t current_block;           ///< 当前分片索引
     uint32_t total_blocks;            ///< 总分片数
     uint32_t block_size;              ///< 分片大小
-    FILE *recv_file;                  ///< 接收文件指针（用于Air8000→CV610）
+    int recv_fd;                      ///< 接收文件描述符（用于Air8000→CV610），-1 表示未打开
     char recv_file_path[512];         ///< 接收文件路径
-    FILE *send_file;                  ///< 发送文件指针（用于CV610→Air8000）
+    file_bitmap_t recv_bitmap;        ///< 已接收分片位图
+    const uint8_t *send_map;          ///< 发送文件映射（用于CV610→Air8000）
+    size_t send_map_len;              ///< 发送文件映射长度
     char send_file_path[512];         ///< 发送文件路径
+    file_bitmap_t send_bitmap;        ///< 已确认分片位图
     uint32_t sent_blocks;             ///< 已发送的块数
+    bool sending;                     ///< 发送线程是否正在传输（此时资源由发送线程释放）
+    pthread_cond_t idle_cond;         ///< 发送线程结束传输时广播，销毁模块时等待
+    volatile bool cancel_requested;   ///< 取消标志，传给窗口发送
+    bool closing;                     ///< 模块正在销毁：中止发送但保留位图以便续传
+    air8000_file_trace_t recv_trace;  ///< 当前接收文件的跟踪信息
+    air8000_file_trace_t done_trace;  ///< 最近一次接收完成的文件的跟踪信息
+    bool has_done_trace;              ///< done_trace 是否有效
 } file_transfer_ctx_t;
 
-// ==================== 全局变量 ====================
+/**
+ * @brief 取得 Air8000 上下文上挂载的文件传输状态
+ * @param ctx Air8000上下文指针
+ * @return 文件传输状态，未初始化返回 NULL
+ */
+static inline file_transfer_ctx_t *ft_of(air8000_t *ctx) {
+    return (file_transfer_ctx_t *)air8000_get_file_transfer_data(ctx);
+}
 
 /**
- * @brief 文件传输上下文指针
+ * @brief 清理接收文件资源
  */
-static file_transfer_ctx_t *g_file_transfer_ctx = NULL;
+static void cleanup_recv_file(file_transfer_ctx_t *ft, bool discard);
 
 // ==================== 内部函数实现 ====================
 
 /**
- * @brief 计算CRC32校验和
+ * @brief 打开分片位图
+ * @param bm 位图对象
+ * @param path 位图文件路径
+ * @param file_size 文件大小
+ * @param block_size 分片大小
+ * @param mtime 源文件修改时间
+ * @param crc32 整个文件的 CRC32
+ * @return 已完成的分片数，失败返回负数错误码
+ * @details 位图文件存在且头部（含文件身份 mtime + crc32）一致时沿用其中的记录，否则清空重建；
+ *          文件无法创建或映射时退化为内存位图
  */
-static uint32_t calculate_crc32(const uint8_t *data, size_t len) {
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (int j = 0; j < 8; j++) {
-            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+static int bitmap_open(file_bitmap_t *bm, const char *path, uint64_t file_size,
+                       uint32_t block_size, int64_t mtime, uint32_t crc32) {
+    memset(bm, 0, sizeof(*bm));
+    bm->total = (uint32_t)((file_size + block_size - 1) / block_size);
+    bm->map_len = sizeof(file_bitmap_hdr_t) + (bm->total + 7) / 8;
+    snprintf(bm->path, sizeof(bm->path), "%s", path);
+    
+    file_bitmap_hdr_t want = {
+        .magic = FILE_BITMAP_MAGIC,
+        .block_size = block_size,
+        .file_size = file_size,
+        .mtime = mtime,
+        .total_blocks = bm->total,
+        .crc32 = crc32
+    };
+    
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd >= 0) {
+        file_bitmap_hdr_t old;
+        bool reuse = (pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+                      memcmp(&old, &want, sizeof(want)) == 0);
+        if (!reuse && ftruncate(fd, 0) != 0) {
+            close(fd);
+            fd = -1;
+        } else if (ftruncate(fd, (off_t)bm->map_len) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) {
+            void *map = mmap(NULL, bm->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (map != MAP_FAILED) {
+                bm->map = (uint8_t *)map;
+                bm->persistent = true;
+                if (!reuse) {
+                    memcpy(bm->map, &want, sizeof(want));
+                }
+            }
         }
     }
-    return crc ^ 0xFFFFFFFF;
+    
+    if (!bm->map) {
+        log_warn("file_transfer", "无法映射位图文件 %s: %s，不支持断点续传", path, strerror(errno));
+        bm->map = (uint8_t *)calloc(1, bm->map_len);
+        if (!bm->map) {
+            return AIR8000_ERR_NOMEM;
+        }
+        memcpy(bm->map, &want, sizeof(want));
+    }
+    bm->bits = bm->map + sizeof(file_bitmap_hdr_t);
+    
+    for (uint32_t i = 0; i < bm->total; i++) {
+        if ((bm->bits[i >> 3] >> (i & 7)) & 1) {
+            bm->done++;
+        }
+    }
+    return (int)bm->done;
+}
+
+/**
+ * @brief 标记分片已完成
+ * @return 本次新置位返回 true，之前已置位返回 false
+ * @note 可在 I/O 线程中并发调用
+ */
+static bool bitmap_set(file_bitmap_t *bm, uint32_t index) {
+    uint8_t mask = (uint8_t)(1U << (index & 7));
+    uint8_t old = __atomic_fetch_or(&bm->bits[index >> 3], mask, __ATOMIC_RELAXED);
+    if (old & mask) {
+        return false;
+    }
+    __atomic_fetch_add(&bm->done, 1, __ATOMIC_RELAXED);
+    return true;
 }
 
 /**
- * @brief 发送文件分片
+ * @brief 关闭分片位图
+ * @param bm 位图对象
+ * @param remove 是否删除位图文件（传输完成或主动取消时删除）
  */
-static int send_file_block(air8000_t *ctx, FILE *file, uint32_t block_index, uint32_t block_size) {
-    if (!ctx || !file) {
+static void bitmap_close(file_bitmap_t *bm, bool remove) {
+    if (!bm->bits) {
+        return;
+    }
+    if (bm->persistent) {
+        msync(bm->map, bm->map_len, MS_SYNC);
+        munmap(bm->map, bm->map_len);
+        if (remove) {
+            unlink(bm->path);
+        }
+    } else {
+        free(bm->map);
+    }
+    memset(bm, 0, sizeof(*bm));
+}
+
+/**
+ * @brief 完整写入指定偏移，处理短写和信号中断
+ */
+static int pwrite_all(int fd, const uint8_t *data, size_t len, off_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 构建文件分片请求帧
+ * @details 由 air8000_send_windowed 在提交线程中调用，重传时会以相同索引再次调用；
+ *          分片数据从源文件映射区拷入帧数据缓冲区一次，提交时该缓冲区直接交给请求槽位
+ */
+static int build_file_block(air8000_t *ctx, uint32_t block_index, air8000_frame_t *frame, void *user_data) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    (void)user_data;
+    if (!ft || !ft->send_map) {
         return AIR8000_ERR_PARAM;
     }
+    const uint8_t *map = ft->send_map;
+    uint32_t block_size = ft->block_size;
     
-    // 计算当前块的偏移量
-    size_t offset = block_index * block_size;
-    
-    // 定位到文件偏移量
-    if (fseek(file, offset, SEEK_SET) != 0) {
+    // 计算当前块的偏移量和长度
+    uint64_t offset = (uint64_t)block_index * block_size;
+    if (offset >= ft->file_size) {
         return AIR8000_ERR_IO;
     }
-    
-    // 读取块数据
-    uint8_t data[block_size];
-    size_t read_len = fread(data, 1, block_size, file);
-    if (read_len == 0) {
-        return AIR8000_ERR_IO;
+    uint64_t remain = ft->file_size - offset;
+    uint32_t read_len = remain < block_size ? (uint32_t)remain : block_size;
+    size_t total_len = sizeof(air8000_file_block_t) + read_len;
+    if (total_len > AIR8000_MAX_FRAME_DATA) {
+        return AIR8000_ERR_PARAM;
     }
     
-    // 计算CRC32
-    uint32_t crc32 = calculate_crc32(data, read_len);
-    
-    // 构建块数据
-    uint8_t block_data[sizeof(uint32_t) * 3 + block_size];
-    uint32_t *p_block_index = (uint32_t *)block_data;
-    uint32_t *p_data_len = (uint32_t *)(block_data + sizeof(uint32_t));
-    uint32_t *p_crc32 = (uint32_t *)(block_data + sizeof(uint32_t) * 2);
-    uint8_t *p_data = block_data + sizeof(uint32_t) * 3;
-    
-    *p_block_index = htonl(block_index);
-    *p_data_len = htonl(read_len);
-    *p_crc32 = htonl(crc32);
-    memcpy(p_data, data, read_len);
+    // 构建请求（每次调用获取新序列号），数据区直接分配后填充
+    air8000_build_request(frame, CMD_FILE_TRANSFER_DATA, NULL, 0);
+    air8000_file_block_t *block = (air8000_file_block_t *)malloc(total_len);
+    if (!block) {
+        return AIR8000_ERR_NOMEM;
+    }
     
-    // 构建请求帧
-    air8000_frame_t frame;
-    air8000_frame_init(&frame);
+    // 先拷贝再对拷贝计算 CRC，映射区只读一遍
+    memcpy(block->data, map + offset, read_len);
+    block->block_index = htonl(block_index);
+    block->data_len = htonl(read_len);
+    block->crc32 = htonl(air8000_crc32(block->data, read_len));
     
-    // 构建请求
-    air8000_build_request(&frame, CMD_FILE_TRANSFER_DATA, block_data, sizeof(uint32_t) * 3 + read_len);
+    frame->data = (uint8_t *)block;
+    frame->data_len = (uint16_t)total_len;
     
-    // 发送请求
-    int ret = air8000_send_and_wait(ctx, &frame, NULL, RESPONSE_TIMEOUT_MS);
+    return AIR8000_OK;
+}
+
+/**
+ * @brief 文件分片确认进度回调
+ */
+static void on_file_blocks_acked(air8000_t *ctx, uint32_t acked, uint32_t total, void *user_data) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    (void)user_data;
+    ft->current_block = acked;
+    ft->sent_blocks = acked;
     
-    // 清理帧
-    air8000_frame_cleanup(&frame);
+    // 计算进度
+    uint8_t progress = (uint8_t)(((uint64_t)acked * 100) / total);
     
-    return ret;
+    // 触发数据发送事件
+    if (ft->callback) {
+        ft->callback(ctx, FILE_TRANSFER_EVENT_DATA_SENT, &progress, ft->user_data);
+    }
+}
+
+/**
+ * @brief 单个文件分片确认回调
+ * @details 在 I/O 线程中调用，只在位图中置位
+ */
+static void on_file_block_acked(air8000_t *ctx, uint32_t block_index, void *user_data) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    (void)user_data;
+    bitmap_set(&ft->send_bitmap, block_index);
 }
 
 /**
  * @brief 处理Air8000发送的文件传输开始命令
+ * @details 同一文件（位图头部一致，包括开始帧中的修改时间和 CRC32）重新开始时保留已接收的分片，
+ *          只需补齐缺失部分；对端未提供文件身份时无法确认是同一文件，总是重新接收
  */
 static int handle_file_transfer_start(air8000_t *ctx, const air8000_frame_t *req_frame) {
-    if (!ctx || !req_frame || !g_file_transfer_ctx) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (!ctx || !req_frame || !ft) {
         return AIR8000_ERR_PARAM;
     }
     
-    // 解析文件信息
-    if (req_frame->data_len < sizeof(air8000_file_info_t)) {
+    // 解析文件信息（跟踪字段为扩展字段，旧固件不发送）
+    if (req_frame->data_len < offsetof(air8000_file_info_t, reserved)) {
         return AIR8000_ERR_PARAM;
     }
     
     air8000_file_info_t *file_info = (air8000_file_info_t *)req_frame->data;
+    if (file_info->block_size == 0) {
+        return AIR8000_ERR_PARAM;
+    }
+    
+    // 开始通知到达的时间换算出拍摄时间；对端未提供跟踪ID时本机分配
+    uint64_t start_us = pm_metrics_now_us();
+    air8000_file_trace_t trace = { 0, start_us, 0 };
+    if (req_frame->data_len >= offsetof(air8000_file_info_t, capture_age_ms) + sizeof(uint32_t)) {
+        trace.trace_id = file_info->trace_id;
+        uint64_t age_us = (uint64_t)file_info->capture_age_ms * 1000;
+        trace.captured_us = age_us < start_us ? start_us - age_us : start_us;
+    }
+    if (trace.trace_id == 0) {
+        trace.trace_id = pm_metrics_trace_id();
+    }
+    
+    // 文件身份：旧固件不发送修改时间，CRC32 也可能为 0
+    uint32_t mtime = 0;
+    if (req_frame->data_len >= offsetof(air8000_file_info_t, mtime) + sizeof(uint32_t)) {
+        mtime = file_info->mtime;
+    }
+    bool has_identity = file_info->crc32 != 0 || mtime != 0;
     
     // 构建接收文件路径
     char recv_path[512] = {0};
-    snprintf(recv_path, sizeof(recv_path), "/tmp/%s", file_info->filename);
+    char bitmap_path[520] = {0};
+    snprintf(recv_path, sizeof(recv_path), "/tmp/%.*s",
+             (int)sizeof(file_info->filename), file_info->filename);
+    snprintf(bitmap_path, sizeof(bitmap_path), "%s%s", recv_path, AIR8000_FILE_BITMAP_SUFFIX);
+    
+    // 更新上下文
+    pthread_mutex_lock(&ft->mutex);
     
-    // 打开接收文件
-    FILE *recv_file = fopen(recv_path, "wb");
-    if (!recv_file) {
+    // 关闭之前的接收文件，保留其位图以便之后续传
+    cleanup_recv_file(ft, false);
+    
+    // 打开接收文件（不截断，续传时保留已写入的分片）
+    int recv_fd = open(recv_path, O_RDWR | O_CREAT, 0644);
+    if (recv_fd < 0) {
         log_error("file_transfer", "Failed to open receive file: %s", recv_path);
+        pthread_mutex_unlock(&ft->mutex);
         return AIR8000_ERR_IO;
     }
     
-    // 更新上下文
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
-    
-    // 清理之前的资源
-    cleanup_recv_file();
+    // 无法确认是同一文件时不沿用旧位图，否则另一个同名同大小文件的分片会被当作已接收
+    if (!has_identity && unlink(bitmap_path) == 0) {
+        log_warn("file_transfer", "No file identity for %s, discarding previous progress", recv_path);
+    }
+    int done = bitmap_open(&ft->recv_bitmap, bitmap_path, file_info->file_size,
+                           file_info->block_size, (int64_t)mtime, file_info->crc32);
+    if (done < 0) {
+        close(recv_fd);
+        pthread_mutex_unlock(&ft->mutex);
+        return done;
+    }
+    if (done == 0) {
+        // 新传输：丢弃旧内容并预分配到目标大小
+        if (ftruncate(recv_fd, 0) != 0 || ftruncate(recv_fd, (off_t)file_info->file_size) != 0) {
+            log_warn("file_transfer", "Failed to resize receive file: %s", strerror(errno));
+        }
+    } else {
+        log_info("file_transfer", "Resuming %s: %d/%u blocks already received",
+                 recv_path, done, ft->recv_bitmap.total);
+    }
     
     // 更新文件信息
-    strncpy(g_file_transfer_ctx->filename, file_info->filename, sizeof(g_file_transfer_ctx->filename) - 1);
-    g_file_transfer_ctx->file_size = file_info->file_size;
-    g_file_transfer_ctx->block_size = file_info->block_size;
-    g_file_transfer_ctx->total_blocks = (file_info->file_size + file_info->block_size - 1) / file_info->block_size;
-    g_file_transfer_ctx->current_block = 0;
-    g_file_transfer_ctx->direction = FILE_TRANSFER_DIR_AIR8000_TO_CV610;
-    g_file_transfer_ctx->state = FILE_TRANSFER_STARTED;
-    g_file_transfer_ctx->recv_file = recv_file;
-    strncpy(g_file_transfer_ctx->recv_file_path, recv_path, sizeof(g_file_transfer_ctx->recv_file_path) - 1);
-    
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    snprintf(ft->filename, sizeof(ft->filename), "%.*s",
+             (int)sizeof(file_info->filename), file_info->filename);
+    ft->file_size = file_info->file_size;
+    ft->block_size = file_info->block_size;
+    ft->total_blocks = ft->recv_bitmap.total;
+    ft->current_block = (uint32_t)done;
+    ft->direction = FILE_TRANSFER_DIR_AIR8000_TO_CV610;
+    ft->state = FILE_TRANSFER_STARTED;
+    ft->recv_fd = recv_fd;
+    memcpy(ft->recv_file_path, recv_path, sizeof(ft->recv_file_path));
+    ft->recv_trace = trace;
+    
+    pthread_mutex_unlock(&ft->mutex);
     
     // 触发开始事件
-    if (g_file_transfer_ctx->callback) {
-        g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_STARTED, file_info, g_file_transfer_ctx->user_data);
+    if (ft->callback) {
+        ft->callback(ctx, FILE_TRANSFER_EVENT_STARTED, file_info, ft->user_data);
     }
     
     // 发送确认
@@ -254,71 +516,103 @@ static int handle_file_transfer_start(air8000_t *ctx, const air8000_frame_t *req
 
 /**
  * @brief 处理Air8000发送的文件分片数据
+ * @details 按分片索引 pwrite 到对应偏移，分片可以乱序到达；
+ *          通过 CRC 校验的分片总是写入（重复分片重写相同内容），位图只用于统计进度；
+ *          接收完成、文件已关闭之后才到达的重传分片直接再次确认；
+ *          只有索引越界、长度不符或 CRC 错误的分片才会 NACK
  */
 static int handle_file_transfer_data(air8000_t *ctx, const air8000_frame_t *req_frame) {
-    if (!ctx || !req_frame || !g_file_transfer_ctx || !g_file_transfer_ctx->recv_file) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (!ctx || !req_frame || !ft) {
         return AIR8000_ERR_PARAM;
     }
     
-    // 解析分片数据
+    // 解析分片数据（字段为网络字节序）
     if (req_frame->data_len < sizeof(air8000_file_block_t)) {
         return AIR8000_ERR_PARAM;
     }
     
-    air8000_file_block_t *block = (air8000_file_block_t *)req_frame->data;
-    
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
-    
-    // 检查分片索引
-    if (block->block_index != g_file_transfer_ctx->current_block) {
-        log_error("file_transfer", "Block index mismatch: expected %u, got %u", 
-                 g_file_transfer_ctx->current_block, block->block_index);
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-        return send_file_transfer_ack(ctx, block->block_index, false);
+    const air8000_file_block_t *block = (const air8000_file_block_t *)req_frame->data;
+    uint32_t block_index = ntohl(block->block_index);
+    uint32_t data_len = ntohl(block->data_len);
+    uint32_t crc32 = ntohl(block->crc32);
+    
+    pthread_mutex_lock(&ft->mutex);
+    
+    if (ft->recv_fd < 0) {
+        // 最后一个分片的 ACK 丢失时对端会在完成后重传，仍需确认，否则对端判定传输失败
+        bool dup = ft->direction == FILE_TRANSFER_DIR_AIR8000_TO_CV610 &&
+                   ft->state == FILE_TRANSFER_COMPLETED &&
+                   block_index < ft->total_blocks;
+        pthread_mutex_unlock(&ft->mutex);
+        if (dup) {
+            return send_file_transfer_ack(ctx, block_index, true);
+        }
+        return AIR8000_ERR_PARAM;
     }
     
-    // 写入分片数据
-    size_t written = fwrite(block->data, 1, block->data_len, g_file_transfer_ctx->recv_file);
-    if (written != block->data_len) {
-        log_error("file_transfer", "Failed to write block data: expected %u, wrote %zu", 
-                 block->data_len, written);
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-        return send_file_transfer_ack(ctx, block->block_index, false);
+    // 检查分片索引和长度
+    uint64_t offset = (uint64_t)block_index * ft->block_size;
+    bool ok = true;
+    if (block_index >= ft->total_blocks ||
+        data_len > ft->block_size ||
+        sizeof(air8000_file_block_t) + data_len > req_frame->data_len ||
+        offset + data_len > ft->file_size) {
+        log_error("file_transfer", "Invalid block %u (len %u) of %u blocks",
+                 block_index, data_len, ft->total_blocks);
+        ok = false;
+    } else if (air8000_crc32(block->data, data_len) != crc32) {
+        log_error("file_transfer", "Block %u CRC32 mismatch", block_index);
+        ok = false;
+    } else if (pwrite_all(ft->recv_fd, block->data, data_len, (off_t)offset) != 0) {
+        // 写入分片数据
+        log_error("file_transfer", "Failed to write block %u: %s", block_index, strerror(errno));
+        ok = false;
+    } else {
+        bitmap_set(&ft->recv_bitmap, block_index);
     }
     
-    // 更新当前分片索引
-    g_file_transfer_ctx->current_block++;
-    g_file_transfer_ctx->state = FILE_TRANSFER_TRANSMITTING;
+    // 更新已接收分片数
+    uint32_t received = ft->recv_bitmap.done;
+    ft->current_block = received;
+    ft->state = FILE_TRANSFER_TRANSMITTING;
     
     // 计算进度
-    uint8_t progress = (g_file_transfer_ctx->current_block * 100) / g_file_transfer_ctx->total_blocks;
+    uint8_t progress = (uint8_t)(((uint64_t)received * 100) / ft->total_blocks);
+    
+    // 检查是否传输完成：数据落盘后再删除位图
+    bool completed = ok && received >= ft->total_blocks;
+    char done_path[sizeof(ft->recv_file_path)] = {0};
+    if (completed) {
+        memcpy(done_path, ft->recv_file_path, sizeof(done_path) - 1);
+        fdatasync(ft->recv_fd);
+        close(ft->recv_fd);
+        ft->recv_fd = -1;
+        bitmap_close(&ft->recv_bitmap, true);
+        ft->state = FILE_TRANSFER_COMPLETED;
+        ft->done_trace = ft->recv_trace;
+        ft->done_trace.transferred_us = pm_metrics_now_us();
+        ft->has_done_trace = true;
+    }
     
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_unlock(&ft->mutex);
     
     // 触发数据发送事件
-    if (g_file_transfer_ctx->callback) {
-        g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_DATA_SENT, &progress, g_file_transfer_ctx->user_data);
+    if (ok && ft->callback) {
+        ft->callback(ctx, FILE_TRANSFER_EVENT_DATA_SENT, &progress, ft->user_data);
     }
     
     // 发送确认
-    int ret = send_file_transfer_ack(ctx, block->block_index, true);
+    int ret = send_file_transfer_ack(ctx, block_index, ok);
     
-    // 检查是否传输完成
-    if (g_file_transfer_ctx->current_block >= g_file_transfer_ctx->total_blocks) {
-        // 关闭接收文件
-        fclose(g_file_transfer_ctx->recv_file);
-        g_file_transfer_ctx->recv_file = NULL;
-        
-        // 更新状态
-        g_file_transfer_ctx->state = FILE_TRANSFER_COMPLETED;
-        
+    if (completed) {
         // 触发完成事件
-        if (g_file_transfer_ctx->callback) {
-            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_COMPLETED, NULL, g_file_transfer_ctx->user_data);
+        if (ft->callback) {
+            ft->callback(ctx, FILE_TRANSFER_EVENT_COMPLETED, done_path, ft->user_data);
         }
         
         // 发送完成通知
-        send_file_transfer_complete(ctx, true);
+        send_file_transfer_complete(ctx, true, false);
     }
     
     return ret;
@@ -326,6 +620,7 @@ static int handle_file_transfer_data(air8000_t *ctx, const air8000_frame_t *req_
 
 /**
  * @brief 发送文件传输确认
+ * @details 由 I/O 线程处理设备请求时调用，不能同步等待响应（响应也要由 I/O 线程处理），只提交即返回
  */
 static int send_file_transfer_ack(air8000_t *ctx, uint32_t block_index, bool success) {
     if (!ctx) {
@@ -345,7 +640,7 @@ static int send_file_transfer_ack(air8000_t *ctx, uint32_t block_index, bool suc
     air8000_build_request(&frame, CMD_FILE_TRANSFER_ACK, ack_data, sizeof(ack_data));
     
     // 发送请求
-    int ret = air8000_send_and_wait(ctx, &frame, NULL, RESPONSE_TIMEOUT_MS);
+    int ret = air8000_send_nowait(ctx, &frame, RESPONSE_TIMEOUT_MS);
     
     // 清理帧
     air8000_frame_cleanup(&frame);
@@ -355,8 +650,9 @@ static int send_file_transfer_ack(air8000_t *ctx, uint32_t block_index, bool suc
 
 /**
  * @brief 发送文件传输完成通知
+ * @param wait 是否等待响应；在 I/O 线程中调用时必须为 false
  */
-static int send_file_transfer_complete(air8000_t *ctx, bool success) {
+static int send_file_transfer_complete(air8000_t *ctx, bool success, bool wait) {
     if (!ctx) {
         return AIR8000_ERR_PARAM;
     }
@@ -372,7 +668,8 @@ static int send_file_transfer_complete(air8000_t *ctx, bool success) {
     air8000_build_request(&frame, CMD_FILE_TRANSFER_COMPLETE, complete_data, sizeof(complete_data));
     
     // 发送请求
-    int ret = air8000_send_and_wait(ctx, &frame, NULL, RESPONSE_TIMEOUT_MS);
+    int ret = wait ? air8000_send_and_wait(ctx, &frame, NULL, RESPONSE_TIMEOUT_MS)
+                   : air8000_send_nowait(ctx, &frame, RESPONSE_TIMEOUT_MS);
     
     // 清理帧
     air8000_frame_cleanup(&frame);
@@ -382,29 +679,38 @@ static int send_file_transfer_complete(air8000_t *ctx, bool success) {
 
 /**
  * @brief 清理接收文件资源
+ * @param discard 是否丢弃已接收的内容；为 false 时保留文件和位图，下次可继续接收
  */
-static void cleanup_recv_file(void) {
-    if (g_file_transfer_ctx->recv_file) {
-        fclose(g_file_transfer_ctx->recv_file);
-        g_file_transfer_ctx->recv_file = NULL;
+static void cleanup_recv_file(file_transfer_ctx_t *ft, bool discard) {
+    if (ft->recv_fd >= 0) {
+        close(ft->recv_fd);
+        ft->recv_fd = -1;
     }
     
-    if (strlen(g_file_transfer_ctx->recv_file_path) > 0) {
-        unlink(g_file_transfer_ctx->recv_file_path);
-        g_file_transfer_ctx->recv_file_path[0] = '\0';
+    bool incomplete = ft->recv_bitmap.bits != NULL;
+    bitmap_close(&ft->recv_bitmap, discard);
+    
+    if (strlen(ft->recv_file_path) > 0) {
+        if (discard && incomplete) {
+            unlink(ft->recv_file_path);
+        }
+        ft->recv_file_path[0] = '\0';
     }
 }
 
 /**
  * @brief 清理发送文件资源
+ * @param remove_bitmap 是否删除发送位图（传输完成或取消时删除，出错时保留以便续传）
  */
-static void cleanup_send_file(void) {
-    if (g_file_transfer_ctx->send_file) {
-        fclose(g_file_transfer_ctx->send_file);
-        g_file_transfer_ctx->send_file = NULL;
+static void cleanup_send_file(file_transfer_ctx_t *ft, bool remove_bitmap) {
+    if (ft->send_map) {
+        munmap((void *)ft->send_map, ft->send_map_len);
+        ft->send_map = NULL;
+        ft->send_map_len = 0;
     }
     
-    g_file_transfer_ctx->send_file_path[0] = '\0';
+    bitmap_close(&ft->send_bitmap, remove_bitmap);
+    ft->send_file_path[0] = '\0';
 }
 
 // ==================== API 函数实现 ====================
@@ -420,64 +726,85 @@ int air8000_file_transfer_init(air8000_t *ctx) {
     }
     
     // 检查是否已经初始化
-    if (g_file_transfer_ctx) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (ft) {
         return AIR8000_ERR_BUSY;
     }
     
     // 分配文件传输上下文
-    g_file_transfer_ctx = (file_transfer_ctx_t *)malloc(sizeof(file_transfer_ctx_t));
-    if (!g_file_transfer_ctx) {
+    ft = (file_transfer_ctx_t *)malloc(sizeof(file_transfer_ctx_t));
+    if (!ft) {
         return AIR8000_ERR_NOMEM;
     }
     
     // 初始化上下文
-    memset(g_file_transfer_ctx, 0, sizeof(file_transfer_ctx_t));
-    g_file_transfer_ctx->air8000_ctx = ctx;
-    g_file_transfer_ctx->state = FILE_TRANSFER_IDLE;
-    pthread_mutex_init(&g_file_transfer_ctx->mutex, NULL);
+    memset(ft, 0, sizeof(file_transfer_ctx_t));
+    ft->air8000_ctx = ctx;
+    ft->state = FILE_TRANSFER_IDLE;
+    ft->recv_fd = -1;
+    pthread_mutex_init(&ft->mutex, NULL);
+    pthread_cond_init(&ft->idle_cond, NULL);
+    air8000_set_file_transfer_data(ctx, ft);
     
     return AIR8000_OK;
 }
 
 /**
  * @brief 释放文件传输模块资源
+ * @param ctx AIR8000上下文指针
+ * @details 正在发送时先取消并等待发送线程退出 air8000_file_transfer_start，
+ *          因此不能在文件传输回调中调用
  */
-void air8000_file_transfer_deinit(void) {
-    if (!g_file_transfer_ctx) {
+void air8000_file_transfer_deinit(air8000_t *ctx) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (!ft) {
         return;
     }
     
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_lock(&ft->mutex);
     
-    // 清理接收文件资源
-    cleanup_recv_file();
+    // 等待发送线程结束，之后它不再访问 ft
+    if (ft->sending) {
+        ft->closing = true;
+        ft->cancel_requested = true;
+        while (ft->sending) {
+            pthread_cond_wait(&ft->idle_cond, &ft->mutex);
+        }
+    }
+    air8000_set_file_transfer_data(ctx, NULL);
+    
+    // 清理接收文件资源（未完成的传输保留位图，重启后可续传）
+    cleanup_recv_file(ft, false);
     
     // 清理发送文件资源
-    cleanup_send_file();
+    cleanup_send_file(ft, false);
     
     // 销毁互斥锁
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-    pthread_mutex_destroy(&g_file_transfer_ctx->mutex);
+    pthread_mutex_unlock(&ft->mutex);
+    pthread_cond_destroy(&ft->idle_cond);
+    pthread_mutex_destroy(&ft->mutex);
     
     // 释放内存
-    free(g_file_transfer_ctx);
-    g_file_transfer_ctx = NULL;
+    free(ft);
     
     log_info("file_transfer", "文件传输模块已销毁");
 }
 
 /**
  * @brief 注册文件传输回调函数
+ * @param ctx AIR8000上下文指针
  * @param cb 回调函数指针
  * @param user_data 用户数据指针
  */
-void air8000_file_transfer_register_callback(air8000_file_transfer_cb_t cb, 
+void air8000_file_transfer_register_callback(air8000_t *ctx,
+                                             air8000_file_transfer_cb_t cb, 
                                              void *user_data) {
-    if (g_file_transfer_ctx) {
-        pthread_mutex_lock(&g_file_transfer_ctx->mutex);
-        g_file_transfer_ctx->callback = cb;
-        g_file_transfer_ctx->user_data = user_data;
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (ft) {
+        pthread_mutex_lock(&ft->mutex);
+        ft->callback = cb;
+        ft->user_data = user_data;
+        pthread_mutex_unlock(&ft->mutex);
     }
 }
 
@@ -491,35 +818,36 @@ void air8000_file_transfer_register_callback(air8000_file_transfer_cb_t cb,
 int air8000_file_transfer_notify(air8000_t *ctx, 
                                  const char *filename, 
                                  uint64_t file_size) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
     if (!ctx || !filename) {
         return AIR8000_ERR_PARAM;
     }
     
-    if (!g_file_transfer_ctx) {
+    if (!ft) {
         return AIR8000_ERR_GENERIC;
     }
     
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_lock(&ft->mutex);
     
     // 检查当前状态
-    if (g_file_transfer_ctx->state != FILE_TRANSFER_IDLE) {
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    if (ft->state != FILE_TRANSFER_IDLE) {
+        pthread_mutex_unlock(&ft->mutex);
         return AIR8000_ERR_BUSY;
     }
     
     // 更新文件信息
-    strncpy(g_file_transfer_ctx->filename, filename, sizeof(g_file_transfer_ctx->filename) - 1);
-    g_file_transfer_ctx->file_size = file_size;
+    snprintf(ft->filename, sizeof(ft->filename), "%s", filename);
+    ft->file_size = file_size;
     
     // 更新状态
-    g_file_transfer_ctx->state = FILE_TRANSFER_NOTIFIED;
+    ft->state = FILE_TRANSFER_NOTIFIED;
     
     // 触发通知事件
-    if (g_file_transfer_ctx->callback) {
-        g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_NOTIFY_ACKED, NULL, g_file_transfer_ctx->user_data);
+    if (ft->callback) {
+        ft->callback(ctx, FILE_TRANSFER_EVENT_NOTIFY_ACKED, NULL, ft->user_data);
     }
     
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_unlock(&ft->mutex);
     
     return AIR8000_OK;
 }
@@ -531,209 +859,257 @@ int air8000_file_transfer_notify(air8000_t *ctx,
  * @param file_path 文件路径
  * @param block_size 分片大小（0表示默认）
  * @return 成功返回0，失败返回错误码
+ * @details 源文件以只读方式 mmap，分片按窗口流水线发送；已确认分片记录在
+ *          file_path + AIR8000_FILE_BITMAP_SUFFIX 位图中，传输出错时保留该位图，
+ *          再次对同一文件（大小、分片大小、修改时间、内容 CRC32 不变）调用时只发送未确认的分片。
+ *          传输期间不持有模块互斥锁，可随时调用 air8000_file_transfer_cancel
  */
 int air8000_file_transfer_start(air8000_t *ctx, 
                                 const char *filename, 
                                 const char *file_path, 
                                 uint32_t block_size) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
     if (!ctx || !filename || !file_path) {
         return AIR8000_ERR_PARAM;
     }
     
-    if (!g_file_transfer_ctx) {
+    if (!ft) {
         return AIR8000_ERR_GENERIC;
     }
     
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
-    
-    // 检查当前状态
-    if (g_file_transfer_ctx->state != FILE_TRANSFER_IDLE && 
-        g_file_transfer_ctx->state != FILE_TRANSFER_NOTIFIED) {
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-        return AIR8000_ERR_BUSY;
+    // 设置默认分片大小；分片加分片头必须能放进单帧
+    if (block_size == 0) {
+        block_size = DEFAULT_PACKET_SIZE;
+    }
+    if (block_size > MAX_BLOCK_SIZE) {
+        log_error("file_transfer", "Block size %u exceeds %zu", block_size, (size_t)MAX_BLOCK_SIZE);
+        return AIR8000_ERR_PARAM;
     }
     
-    // 清理之前的资源
-    cleanup_send_file();
-    
-    // 打开要发送的文件
-    FILE *send_file = fopen(file_path, "rb");
-    if (!send_file) {
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    // 打开并映射要发送的文件（不持有互斥锁，整个文件的 CRC32 要读一遍文件）
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
         return AIR8000_ERR_IO;
     }
     
     // 获取文件大小
     struct stat file_stat;
-    if (stat(file_path, &file_stat) != 0) {
-        fclose(send_file);
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
         return AIR8000_ERR_IO;
     }
     uint64_t file_size = file_stat.st_size;
     
-    // 设置默认分片大小
-    if (block_size == 0) {
-        block_size = DEFAULT_PACKET_SIZE;
+    void *map = mmap(NULL, (size_t)file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_error("file_transfer", "mmap %s failed: %s", file_path, strerror(errno));
+        return AIR8000_ERR_IO;
     }
+    madvise(map, (size_t)file_size, MADV_SEQUENTIAL);
     
-    // 计算总分片数
-    uint32_t total_blocks = (file_size + block_size - 1) / block_size;
+    // 文件身份：修改时间 + 整个文件的 CRC32，写入位图头部并随开始帧发送给对端
+    uint32_t file_crc32 = air8000_crc32((const uint8_t *)map, (size_t)file_size);
+    uint32_t file_mtime = (uint32_t)file_stat.st_mtime;
     
-    // 更新上下文
-    strncpy(g_file_transfer_ctx->filename, filename, sizeof(g_file_transfer_ctx->filename) - 1);
-    strncpy(g_file_transfer_ctx->send_file_path, file_path, sizeof(g_file_transfer_ctx->send_file_path) - 1);
-    g_file_transfer_ctx->file_size = file_size;
-    g_file_transfer_ctx->block_size = block_size;
-    g_file_transfer_ctx->total_blocks = total_blocks;
-    g_file_transfer_ctx->current_block = 0;
-    g_file_transfer_ctx->sent_blocks = 0;
-    g_file_transfer_ctx->direction = FILE_TRANSFER_DIR_CV610_TO_AIR8000;
-    g_file_transfer_ctx->state = FILE_TRANSFER_STARTED;
-    g_file_transfer_ctx->send_file = send_file;
-    
-    // 构建文件信息数据
-    size_t filename_len = strlen(filename);
-    size_t file_info_len = sizeof(uint32_t) + filename_len + sizeof(uint64_t) + sizeof(uint32_t) * 2;
-    uint8_t *file_info_data = (uint8_t *)malloc(file_info_len);
-    if (!file_info_data) {
-        cleanup_send_file();
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-        return AIR8000_ERR_NOMEM;
+    pthread_mutex_lock(&ft->mutex);
+    
+    // 检查当前状态：正在传输时拒绝，出错或取消后允许重新开始（续传）
+    if (ft->sending ||
+        ft->state == FILE_TRANSFER_STARTED ||
+        ft->state == FILE_TRANSFER_TRANSMITTING) {
+        pthread_mutex_unlock(&ft->mutex);
+        munmap(map, (size_t)file_size);
+        return AIR8000_ERR_BUSY;
     }
     
-    // 填充文件信息数据
-    uint32_t *p_filename_len = (uint32_t *)file_info_data;
-    uint8_t *p_filename = file_info_data + sizeof(uint32_t);
-    uint64_t *p_file_size = (uint64_t *)(p_filename + filename_len);
-    uint32_t *p_block_size = (uint32_t *)(p_file_size + 1);
-    uint32_t *p_crc32 = (uint32_t *)(p_block_size + 1);
+    // 清理之前的资源
+    cleanup_send_file(ft, false);
     
-    *p_filename_len = htonl(filename_len);
-    memcpy(p_filename, filename, filename_len);
-    *p_file_size = htobe64(file_size);
-    *p_block_size = htonl(block_size);
-    *p_crc32 = htonl(0); // 简化处理，实际应计算整个文件的CRC32
+    // 更新上下文
+    snprintf(ft->filename, sizeof(ft->filename), "%s", filename);
+    snprintf(ft->send_file_path, sizeof(ft->send_file_path), "%s", file_path);
+    ft->send_map = (const uint8_t *)map;
+    ft->send_map_len = (size_t)file_size;
+    
+    // 打开位图，恢复上次中断时已确认的分片
+    char bitmap_path[520];
+    snprintf(bitmap_path, sizeof(bitmap_path), "%s%s", file_path, AIR8000_FILE_BITMAP_SUFFIX);
+    int done = bitmap_open(&ft->send_bitmap, bitmap_path, file_size, block_size,
+                           (int64_t)file_stat.st_mtime, file_crc32);
+    if (done < 0) {
+        cleanup_send_file(ft, false);
+        pthread_mutex_unlock(&ft->mutex);
+        return done;
+    }
+    if (done > 0) {
+        log_info("file_transfer", "Resuming %s: %d/%u blocks already acknowledged",
+                 file_path, done, ft->send_bitmap.total);
+    }
     
-    // 构建请求帧
-    air8000_frame_t frame;
-    air8000_frame_init(&frame);
-    air8000_build_request(&frame, CMD_FILE_TRANSFER_START, file_info_data, file_info_len);
+    ft->file_size = file_size;
+    ft->block_size = block_size;
+    ft->total_blocks = ft->send_bitmap.total;
+    ft->current_block = (uint32_t)done;
+    ft->sent_blocks = (uint32_t)done;
+    ft->direction = FILE_TRANSFER_DIR_CV610_TO_AIR8000;
+    ft->state = FILE_TRANSFER_STARTED;
+    ft->sending = true;
+    ft->cancel_requested = false;
     
-    // 发送文件传输开始命令
-    int ret = air8000_send_and_wait(ctx, &frame, NULL, RESPONSE_TIMEOUT_MS);
+    // 传输期间不持有互斥锁，避免阻塞 I/O 线程中的请求处理和取消操作
+    pthread_mutex_unlock(&ft->mutex);
     
-    // 清理帧和内存
-    air8000_frame_cleanup(&frame);
-    free(file_info_data);
-    
-    if (ret != AIR8000_OK) {
-        log_error("file_transfer", "发送文件传输开始命令失败: %d", ret);
-        cleanup_send_file();
-        g_file_transfer_ctx->state = FILE_TRANSFER_ERROR;
+    // 构建文件信息数据：文件名长度、文件名、文件大小、分片大小、CRC32、修改时间
+    size_t filename_len = strlen(filename);
+    size_t file_info_len = sizeof(uint32_t) + filename_len + sizeof(uint64_t) + sizeof(uint32_t) * 3;
+    uint8_t *file_info_data = (uint8_t *)malloc(file_info_len);
+    int ret = AIR8000_ERR_NOMEM;
+    if (file_info_data) {
+        // 填充文件信息数据
+        uint32_t *p_filename_len = (uint32_t *)file_info_data;
+        uint8_t *p_filename = file_info_data + sizeof(uint32_t);
+        uint64_t *p_file_size = (uint64_t *)(p_filename + filename_len);
+        uint32_t *p_block_size = (uint32_t *)(p_file_size + 1);
+        uint32_t *p_crc32 = (uint32_t *)(p_block_size + 1);
+        uint32_t *p_mtime = p_crc32 + 1;
         
-        if (g_file_transfer_ctx->callback) {
-            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_ERROR, &ret, g_file_transfer_ctx->user_data);
-        }
+        *p_filename_len = htonl(filename_len);
+        memcpy(p_filename, filename, filename_len);
+        *p_file_size = htobe64(file_size);
+        *p_block_size = htonl(block_size);
+        *p_crc32 = htonl(file_crc32);
+        *p_mtime = htonl(file_mtime);
         
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-        return ret;
-    }
-    
-    // 触发开始事件
-    if (g_file_transfer_ctx->callback) {
-        g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_STARTED, NULL, g_file_transfer_ctx->user_data);
+        // 构建请求帧
+        air8000_frame_t frame;
+        air8000_frame_init(&frame);
+        air8000_build_request(&frame, CMD_FILE_TRANSFER_START, file_info_data, file_info_len);
+        
+        // 发送文件传输开始命令
+        ret = air8000_send_and_wait(ctx, &frame, NULL, RESPONSE_TIMEOUT_MS);
+        
+        // 清理帧和内存
+        air8000_frame_cleanup(&frame);
+        free(file_info_data);
     }
     
-    // 开始发送文件分片
-    g_file_transfer_ctx->state = FILE_TRANSFER_TRANSMITTING;
-    
-    while (g_file_transfer_ctx->current_block < g_file_transfer_ctx->total_blocks) {
-        // 发送文件分片
-        ret = send_file_block(ctx, g_file_transfer_ctx->send_file, 
-                             g_file_transfer_ctx->current_block, 
-                             g_file_transfer_ctx->block_size);
-        
-        if (ret != AIR8000_OK) {
-            log_error("file_transfer", "发送文件分片失败: %d", ret);
-            cleanup_send_file();
-            g_file_transfer_ctx->state = FILE_TRANSFER_ERROR;
-            
-            if (g_file_transfer_ctx->callback) {
-                g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_ERROR, &ret, g_file_transfer_ctx->user_data);
-            }
-            
-            pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-            return ret;
+    if (ret == AIR8000_OK) {
+        // 触发开始事件
+        if (ft->callback) {
+            ft->callback(ctx, FILE_TRANSFER_EVENT_STARTED, NULL, ft->user_data);
         }
         
-        // 更新状态
-        g_file_transfer_ctx->current_block++;
-        g_file_transfer_ctx->sent_blocks++;
+        // 开始发送文件分片：保持 FILE_TRANSFER_WINDOW 个分片在途，NACK/超时的分片单独重传
+        pthread_mutex_lock(&ft->mutex);
+        if (!ft->cancel_requested) {
+            ft->state = FILE_TRANSFER_TRANSMITTING;
+        }
+        pthread_mutex_unlock(&ft->mutex);
         
-        // 计算进度
-        uint8_t progress = (g_file_transfer_ctx->sent_blocks * 100) / g_file_transfer_ctx->total_blocks;
+        // 窗口是整个上下文共用的设置，传输结束后恢复调用者原来的值
+        int saved_window = air8000_get_async_window(ctx);
+        air8000_set_async_window(ctx, FILE_TRANSFER_WINDOW);
         
-        // 触发数据发送事件
-        if (g_file_transfer_ctx->callback) {
-            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_DATA_SENT, &progress, g_file_transfer_ctx->user_data);
+        air8000_window_job_t job = {
+            .total = ft->total_blocks,
+            .max_retry = MAX_RETRY_COUNT,
+            .timeout_ms = RESPONSE_TIMEOUT_MS,
+            .build = build_file_block,
+            .progress = on_file_blocks_acked,
+            .abort_flag = &ft->cancel_requested,
+            .user_data = NULL,
+            .skip_bitmap = ft->send_bitmap.bits,
+            .block_acked = on_file_block_acked
+        };
+        ret = air8000_send_windowed(ctx, &job);
+        air8000_set_async_window(ctx, saved_window);
+        if (ret != AIR8000_OK) {
+            log_error("file_transfer", "发送文件分片失败: %d, 已确认 %u/%u", ret,
+                      ft->send_bitmap.done, ft->total_blocks);
+        } else {
+            // 发送传输完成通知
+            ret = send_file_transfer_complete(ctx, true, true);
         }
-        
-        // 短暂延迟，避免发送过快
-        usleep(10000); // 10ms
+    } else {
+        log_error("file_transfer", "发送文件传输开始命令失败: %d", ret);
     }
     
-    // 发送传输完成通知
-    ret = send_file_transfer_complete(ctx, true);
+    pthread_mutex_lock(&ft->mutex);
+    bool cancelled = ft->cancel_requested;
+    bool all_acked = ft->send_bitmap.done >= ft->total_blocks;
+    
+    // 完成或取消时删除位图；出错或模块销毁时保留，下次调用从断点继续
+    cleanup_send_file(ft, (cancelled && !ft->closing) || all_acked);
+    
+    air8000_file_transfer_event_t event;
+    if (cancelled) {
+        ft->state = FILE_TRANSFER_CANCELLED;
+        event = FILE_TRANSFER_EVENT_CANCELLED;
+        ret = AIR8000_ERR_SHUTDOWN;
+    } else if (all_acked) {
+        ft->state = FILE_TRANSFER_COMPLETED;
+        event = FILE_TRANSFER_EVENT_COMPLETED;
+    } else {
+        ft->state = FILE_TRANSFER_ERROR;
+        event = FILE_TRANSFER_EVENT_ERROR;
+    }
     
-    // 清理资源
-    cleanup_send_file();
-    g_file_transfer_ctx->state = FILE_TRANSFER_COMPLETED;
+    // 清除 sending 并广播后 ft 可能被 air8000_file_transfer_deinit 释放，回调参数先取出
+    air8000_file_transfer_cb_t callback = ft->callback;
+    void *user_data = ft->user_data;
+    ft->sending = false;
+    pthread_cond_broadcast(&ft->idle_cond);
+    pthread_mutex_unlock(&ft->mutex);
     
-    // 触发完成事件
-    if (g_file_transfer_ctx->callback) {
-        g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_COMPLETED, NULL, g_file_transfer_ctx->user_data);
+    // 触发完成/错误事件（取消事件已由 air8000_file_transfer_cancel 触发，模块销毁时不回调）
+    if (event != FILE_TRANSFER_EVENT_CANCELLED && callback) {
+        callback(ctx, event, event == FILE_TRANSFER_EVENT_ERROR ? &ret : NULL, user_data);
     }
     
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
-    
     return ret;
 }
 
 /**
  * @brief 取消文件传输
+ * @param ctx AIR8000上下文指针
  * @return 成功返回0，失败返回错误码
  */
-int air8000_file_transfer_cancel(void) {
-    if (!g_file_transfer_ctx) {
+int air8000_file_transfer_cancel(air8000_t *ctx) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (!ft) {
         return AIR8000_ERR_GENERIC;
     }
     
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_lock(&ft->mutex);
     
     // 检查当前状态
-    if (g_file_transfer_ctx->state == FILE_TRANSFER_IDLE || 
-        g_file_transfer_ctx->state == FILE_TRANSFER_COMPLETED || 
-        g_file_transfer_ctx->state == FILE_TRANSFER_ERROR) {
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    if (ft->state == FILE_TRANSFER_IDLE || 
+        ft->state == FILE_TRANSFER_COMPLETED || 
+        ft->state == FILE_TRANSFER_ERROR) {
+        pthread_mutex_unlock(&ft->mutex);
         return AIR8000_OK;
     }
     
-    // 清理资源
-    cleanup_send_file();
-    cleanup_recv_file();
+    // 清理资源：发送线程正在使用映射区时只置取消标志，由发送线程退出时释放
+    if (ft->sending) {
+        ft->cancel_requested = true;
+    } else {
+        cleanup_send_file(ft, true);
+    }
+    cleanup_recv_file(ft, true);
     
     // 更新状态
-    g_file_transfer_ctx->state = FILE_TRANSFER_CANCELLED;
+    ft->state = FILE_TRANSFER_CANCELLED;
     
     // 触发取消事件
-    if (g_file_transfer_ctx->callback) {
-        g_file_transfer_ctx->callback(g_file_transfer_ctx->air8000_ctx, 
+    if (ft->callback) {
+        ft->callback(ft->air8000_ctx, 
                                      FILE_TRANSFER_EVENT_CANCELLED, NULL, 
-                                     g_file_transfer_ctx->user_data);
+                                     ft->user_data);
     }
     
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_unlock(&ft->mutex);
     
     return AIR8000_OK;
 }
@@ -745,66 +1121,98 @@ int air8000_file_transfer_cancel(void) {
  * @return 成功返回0，失败返回错误码
  */
 int air8000_file_transfer_handle_request(air8000_t *ctx, const air8000_frame_t *req_frame) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
     if (!ctx || !req_frame) {
         return AIR8000_ERR_PARAM;
     }
     
-    if (!g_file_transfer_ctx) {
+    if (!ft) {
         return AIR8000_ERR_GENERIC;
     }
     
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
+    // 开始和分片处理函数内部自行加锁
+    if (req_frame->cmd == CMD_FILE_TRANSFER_START) {
+        // 处理Air8000发送的文件传输开始命令（Air8000→CV610方向）
+        handle_file_transfer_start(ctx, req_frame);
+        return AIR8000_OK;
+    } else if (req_frame->cmd == CMD_FILE_TRANSFER_DATA) {
+        // 处理Air8000发送的文件分片数据（Air8000→CV610方向）
+        handle_file_transfer_data(ctx, req_frame);
+        return AIR8000_OK;
+    }
+    
+    pthread_mutex_lock(&ft->mutex);
     
     if (req_frame->cmd == CMD_FILE_TRANSFER_REQUEST) {
         // 处理文件传输请求（CV610请求Air8000发送文件）
         if (req_frame->data_len > 0 && req_frame->data) {
             // 触发请求接收事件
-            if (g_file_transfer_ctx->callback) {
-                g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_REQUEST_RECEIVED, 
-                                           (void *)req_frame->data, g_file_transfer_ctx->user_data);
+            if (ft->callback) {
+                ft->callback(ctx, FILE_TRANSFER_EVENT_REQUEST_RECEIVED, 
+                                           (void *)req_frame->data, ft->user_data);
             }
         }
-    } else if (req_frame->cmd == CMD_FILE_TRANSFER_START) {
-        // 处理Air8000发送的文件传输开始命令（Air8000→CV610方向）
-        handle_file_transfer_start(ctx, req_frame);
-    } else if (req_frame->cmd == CMD_FILE_TRANSFER_DATA) {
-        // 处理Air8000发送的文件分片数据（Air8000→CV610方向）
-        handle_file_transfer_data(ctx, req_frame);
     } else if (req_frame->cmd == CMD_FILE_TRANSFER_ERROR) {
         // 处理Air8000发送的传输错误通知
-        if (g_file_transfer_ctx->callback) {
-            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_ERROR, NULL, g_file_transfer_ctx->user_data);
+        if (ft->callback) {
+            ft->callback(ctx, FILE_TRANSFER_EVENT_ERROR, NULL, ft->user_data);
         }
     } else if (req_frame->cmd == CMD_FILE_TRANSFER_CANCEL) {
         // 处理Air8000发送的取消传输通知
-        if (g_file_transfer_ctx->callback) {
-            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_CANCELLED, NULL, g_file_transfer_ctx->user_data);
+        if (ft->callback) {
+            ft->callback(ctx, FILE_TRANSFER_EVENT_CANCELLED, NULL, ft->user_data);
         }
     }
     
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_unlock(&ft->mutex);
     
     return AIR8000_OK;
 }
 
 /**
  * @brief 获取文件传输状态
+ * @param ctx AIR8000上下文指针
  * @return 文件传输状态
  */
-air8000_file_transfer_state_t air8000_file_transfer_get_state(void) {
-    if (!g_file_transfer_ctx) {
+air8000_file_transfer_state_t air8000_file_transfer_get_state(air8000_t *ctx) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (!ft) {
         return FILE_TRANSFER_IDLE;
     }
     
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_lock(&ft->mutex);
     
-    air8000_file_transfer_state_t state = g_file_transfer_ctx->state;
+    air8000_file_transfer_state_t state = ft->state;
     
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_unlock(&ft->mutex);
     
     return state;
 }
 
+/**
+ * @brief 获取最近一次接收完成的文件的跟踪信息
+ * @param ctx Air8000上下文指针
+ * @param trace 输出参数
+ * @return 成功返回0，失败返回错误码
+ */
+int air8000_file_transfer_get_trace(air8000_t *ctx, air8000_file_trace_t *trace) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
+    if (!ctx || !trace) {
+        return AIR8000_ERR_PARAM;
+    }
+    if (!ft) {
+        return AIR8000_ERR_GENERIC;
+    }
+    
+    pthread_mutex_lock(&ft->mutex);
+    int ret = ft->has_done_trace ? AIR8000_OK : AIR8000_ERR_GENERIC;
+    if (ft->has_done_trace) {
+        *trace = ft->done_trace;
+    }
+    pthread_mutex_unlock(&ft->mutex);
+    return ret;
+}
+
 /**
  * @brief 请求Air8000发送文件
  * @param ctx Air8000上下文指针
@@ -815,29 +1223,30 @@ air8000_file_transfer_state_t air8000_file_transfer_get_state(void) {
 int air8000_file_transfer_request(air8000_t *ctx, 
                                  const char *filename, 
                                  const char *save_path) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
     if (!ctx || !filename || !save_path) {
         return AIR8000_ERR_PARAM;
     }
     
-    if (!g_file_transfer_ctx) {
+    if (!ft) {
         return AIR8000_ERR_GENERIC;
     }
     
-    pthread_mutex_lock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_lock(&ft->mutex);
     
     // 检查当前状态
-    if (g_file_transfer_ctx->state != FILE_TRANSFER_IDLE) {
-        pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    if (ft->state != FILE_TRANSFER_IDLE) {
+        pthread_mutex_unlock(&ft->mutex);
         return AIR8000_ERR_BUSY;
     }
     
     // 更新文件信息
-    strncpy(g_file_transfer_ctx->filename, filename, sizeof(g_file_transfer_ctx->filename) - 1);
-    strncpy(g_file_transfer_ctx->recv_file_path, save_path, sizeof(g_file_transfer_ctx->recv_file_path) - 1);
-    g_file_transfer_ctx->direction = FILE_TRANSFER_DIR_AIR8000_TO_CV610;
-    g_file_transfer_ctx->state = FILE_TRANSFER_NOTIFIED;
+    snprintf(ft->filename, sizeof(ft->filename), "%s", filename);
+    snprintf(ft->recv_file_path, sizeof(ft->recv_file_path), "%s", save_path);
+    ft->direction = FILE_TRANSFER_DIR_AIR8000_TO_CV610;
+    ft->state = FILE_TRANSFER_NOTIFIED;
     
-    pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+    pthread_mutex_unlock(&ft->mutex);
     
     // 构建请求帧
     air8000_frame_t frame;
@@ -866,11 +1275,12 @@ int air8000_file_transfer_request(air8000_t *ctx,
  */
 int air8000_file_transfer_handle_response(air8000_t *ctx, 
                                          const air8000_frame_t *resp_frame) {
+    file_transfer_ctx_t *ft = ft_of(ctx);
     if (!ctx || !resp_frame) {
         return AIR8000_ERR_PARAM;
     }
     
-    if (!g_file_transfer_ctx) {
+    if (!ft) {
         return AIR8000_ERR_GENERIC;
     }
     
@@ -882,17 +1292,17 @@ int air8000_file_transfer_handle_response(air8000_t *ctx,
             return handle_file_transfer_data(ctx, resp_frame);
         case CMD_FILE_TRANSFER_ERROR:
             // 处理错误响应
-            if (g_file_transfer_ctx->callback) {
-                g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_ERROR, NULL, g_file_transfer_ctx->user_data);
+            if (ft->callback) {
+                ft->callback(ctx, FILE_TRANSFER_EVENT_ERROR, NULL, ft->user_data);
             }
-            g_file_transfer_ctx->state = FILE_TRANSFER_ERROR;
+            ft->state = FILE_TRANSFER_ERROR;
             break;
         case CMD_FILE_TRANSFER_CANCEL:
             // 处理取消响应
-            if (g_file_transfer_ctx->callback) {
-                g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_CANCELLED, NULL, g_file_transfer_ctx->user_data);
+            if (ft->callback) {
+                ft->callback(ctx, FILE_TRANSFER_EVENT_CANCELLED, NULL, ft->user_data);
             }
-            g_file_transfer_ctx->state = FILE_TRANSFER_CANCELLED;
+            ft->state = FILE_TRANSFER_CANCELLED;
             break;
         case CMD_FILE_TRANSFER_STATUS:
             // 处理文件传输状态通知
@@ -904,48 +1314,48 @@ int air8000_file_transfer_handle_response(air8000_t *ctx,
                 log_info("file_transfer", "收到状态通知: status=%d, error=%d, progress=%d%%", 
                         status, error_code, progress);
                 
-                pthread_mutex_lock(&g_file_transfer_ctx->mutex);
+                pthread_mutex_lock(&ft->mutex);
                 
                 // 更新状态
                 switch (status) {
                     case 0: // IDLE
-                        g_file_transfer_ctx->state = FILE_TRANSFER_IDLE;
+                        ft->state = FILE_TRANSFER_IDLE;
                         break;
                     case 2: // STARTED
-                        g_file_transfer_ctx->state = FILE_TRANSFER_STARTED;
-                        if (g_file_transfer_ctx->callback) {
-                            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_STARTED, NULL, g_file_transfer_ctx->user_data);
+                        ft->state = FILE_TRANSFER_STARTED;
+                        if (ft->callback) {
+                            ft->callback(ctx, FILE_TRANSFER_EVENT_STARTED, NULL, ft->user_data);
                         }
                         break;
                     case 3: // TRANSMITTING
-                        g_file_transfer_ctx->state = FILE_TRANSFER_TRANSMITTING;
-                        if (g_file_transfer_ctx->callback) {
-                            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_DATA_SENT, &progress, g_file_transfer_ctx->user_data);
+                        ft->state = FILE_TRANSFER_TRANSMITTING;
+                        if (ft->callback) {
+                            ft->callback(ctx, FILE_TRANSFER_EVENT_DATA_SENT, &progress, ft->user_data);
                         }
                         break;
                     case 4: // COMPLETED
-                        g_file_transfer_ctx->state = FILE_TRANSFER_COMPLETED;
-                        if (g_file_transfer_ctx->callback) {
-                            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_COMPLETED, NULL, g_file_transfer_ctx->user_data);
+                        ft->state = FILE_TRANSFER_COMPLETED;
+                        if (ft->callback) {
+                            ft->callback(ctx, FILE_TRANSFER_EVENT_COMPLETED, NULL, ft->user_data);
                         }
                         break;
                     case 5: // ERROR
-                        g_file_transfer_ctx->state = FILE_TRANSFER_ERROR;
-                        if (g_file_transfer_ctx->callback) {
-                            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_ERROR, &error_code, g_file_transfer_ctx->user_data);
+                        ft->state = FILE_TRANSFER_ERROR;
+                        if (ft->callback) {
+                            ft->callback(ctx, FILE_TRANSFER_EVENT_ERROR, &error_code, ft->user_data);
                         }
                         break;
                     case 6: // CANCELLED
-                        g_file_transfer_ctx->state = FILE_TRANSFER_CANCELLED;
-                        if (g_file_transfer_ctx->callback) {
-                            g_file_transfer_ctx->callback(ctx, FILE_TRANSFER_EVENT_CANCELLED, NULL, g_file_transfer_ctx->user_data);
+                        ft->state = FILE_TRANSFER_CANCELLED;
+                        if (ft->callback) {
+                            ft->callback(ctx, FILE_TRANSFER_EVENT_CANCELLED, NULL, ft->user_data);
                         }
                         break;
                     default:
                         break;
                 }
                 
-                pthread_mutex_unlock(&g_file_transfer_ctx->mutex);
+                pthread_mutex_unlock(&ft->mutex);
             }
             break;
         default:
@@ -38,6 +38,18 @@
  */
 #define MAX_RETRY_COUNT      3
 
+/**
+ * @brief 固件数据包在途窗口大小
+ * @details 同时等待确认的数据包数，Air8000 按包序号写入，可乱序确认
+ */
+#define FOTA_WINDOW_SIZE     8
+
+/**
+ * @brief 流式升级保留的最近固件数据大小
+ * @details 必须为 2 的幂且远大于在途窗口，重传的数据包通常仍在其中，无需回读文件
+ */
+#define FOTA_STREAM_RETAIN_SIZE (64 * 1024)
+
 // ==================== 内部函数声明 ====================
 
 /**
@@ -48,12 +60,33 @@
 static int send_ota_start(air8000_fota_ctx_t *fota_ctx);
 
 /**
- * @brief 发送固件数据包
+ * @brief 以流水线方式发送全部固件数据包
  * @param fota_ctx FOTA升级上下文
  * @return 成功返回0，失败返回错误码
  */
 static int send_ota_data(air8000_fota_ctx_t *fota_ctx);
 
+/**
+ * @brief 读取固件数据
+ * @details 文件模式直接回读文件；流式模式按需从数据源读取，已不在保留区的数据回读文件
+ * @param fota_ctx FOTA升级上下文
+ * @param offset 固件偏移
+ * @param buf 输出缓冲区
+ * @param len 读取长度
+ * @return 成功返回0，失败返回错误码
+ */
+static int read_firmware(air8000_fota_ctx_t *fota_ctx, uint32_t offset, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief 构建指定序号的固件数据包（窗口发送回调）
+ */
+static int build_ota_packet(air8000_t *ctx, uint32_t index, air8000_frame_t *frame, void *user_data);
+
+/**
+ * @brief 固件数据包确认进度回调（窗口发送回调）
+ */
+static void on_ota_packets_acked(air8000_t *ctx, uint32_t acked, uint32_t total, void *user_data);
+
 /**
  * @brief 发送升级完成命令
  * @param fota_ctx FOTA升级上下文
@@ -139,6 +172,51 @@ air8000_fota_ctx_t *air8000_fota_create(air8000_t *ctx, const char *firmware_pat
     return fota_ctx;
 }
 
+air8000_fota_ctx_t *air8000_fota_create_stream(air8000_t *ctx, uint32_t firmware_size, const char *firmware_path,
+                                               const air8000_fota_source_t *source,
+                                               air8000_fota_cb_t callback, void *user_data) {
+    if (!ctx || !source || !source->read || firmware_size == 0) {
+        log_error("fota", "无效的参数");
+        return NULL;
+    }
+
+    // 分配FOTA升级上下文
+    air8000_fota_ctx_t *fota_ctx = (air8000_fota_ctx_t *)calloc(1, sizeof(air8000_fota_ctx_t));
+    if (!fota_ctx) {
+        log_error("fota", "分配FOTA上下文失败");
+        return NULL;
+    }
+    fota_ctx->stream_buf = (uint8_t *)malloc(FOTA_STREAM_RETAIN_SIZE);
+    if (!fota_ctx->stream_buf) {
+        log_error("fota", "分配流式缓冲区失败");
+        free(fota_ctx);
+        return NULL;
+    }
+
+    // 初始化上下文，文件只在重传较早的数据包时才打开
+    fota_ctx->air8000_ctx = ctx;
+    fota_ctx->status = FOTA_STATUS_IDLE;
+    fota_ctx->firmware_size = firmware_size;
+    fota_ctx->callback = callback;
+    fota_ctx->user_data = user_data;
+    if (firmware_path) {
+        strncpy(fota_ctx->firmware_path, firmware_path, sizeof(fota_ctx->firmware_path) - 1);
+    }
+    fota_ctx->streaming = true;
+    fota_ctx->source = *source;
+
+    // 初始化互斥锁
+    if (pthread_mutex_init(&fota_ctx->mutex, NULL) != 0) {
+        log_error("fota", "初始化互斥锁失败");
+        free(fota_ctx->stream_buf);
+        free(fota_ctx);
+        return NULL;
+    }
+
+    log_info("fota", "流式FOTA上下文创建成功，固件大小: %u字节", fota_ctx->firmware_size);
+    return fota_ctx;
+}
+
 void air8000_fota_destroy(air8000_fota_ctx_t *fota_ctx) {
     if (!fota_ctx) {
         return;
@@ -156,6 +234,8 @@ void air8000_fota_destroy(air8000_fota_ctx_t *fota_ctx) {
         fclose(fota_ctx->firmware_file);
         fota_ctx->firmware_file = NULL;
     }
+    free(fota_ctx->stream_buf);
+    fota_ctx->stream_buf = NULL;
 
     // 销毁互斥锁
     pthread_mutex_unlock(&fota_ctx->mutex);
@@ -197,34 +277,41 @@ int air8000_fota_start(air8000_fota_ctx_t *fota_ctx) {
         return ret;
     }
 
-    // 发送固件数据
-    while (fota_ctx->sent_size < fota_ctx->firmware_size && !fota_ctx->aborted) {
-        ret = send_ota_data(fota_ctx);
-        if (ret != AIR8000_OK) {
-            log_error("fota", "发送固件数据失败: %d", ret);
-            update_fota_status(fota_ctx, FOTA_STATUS_FAILED, FOTA_ERROR_WRITE_FAILED, fota_ctx->progress);
-            trigger_fota_event(fota_ctx, FOTA_EVENT_ERROR, &fota_ctx->error);
-            pthread_mutex_unlock(&fota_ctx->mutex);
-            return ret;
-        }
-
-        // 更新进度
-        uint8_t new_progress = (uint8_t)((fota_ctx->sent_size * 100) / fota_ctx->firmware_size);
-        if (new_progress != fota_ctx->progress) {
-            update_fota_status(fota_ctx, FOTA_STATUS_RECEIVING, FOTA_ERROR_NONE, new_progress);
-            trigger_fota_event(fota_ctx, FOTA_EVENT_STATUS_UPDATED, &fota_ctx->progress);
+    // 发送固件数据（进度在 on_ota_packets_acked 中更新）
+    ret = send_ota_data(fota_ctx);
+    if (ret != AIR8000_OK && !__atomic_load_n(&fota_ctx->aborted, __ATOMIC_ACQUIRE)) {
+        log_error("fota", "发送固件数据失败: %d", ret);
+        if (fota_ctx->streaming) {
+            // 下载侧中止或停止转发，Air8000 已收到的部分作废
+            send_ota_abort(fota_ctx);
         }
+        update_fota_status(fota_ctx, FOTA_STATUS_FAILED, FOTA_ERROR_WRITE_FAILED, fota_ctx->progress);
+        trigger_fota_event(fota_ctx, FOTA_EVENT_ERROR, &fota_ctx->error);
+        pthread_mutex_unlock(&fota_ctx->mutex);
+        return ret;
     }
 
-    // 检查是否被取消
-    if (fota_ctx->aborted) {
+    // 检查是否被取消：取消发生在发送期间时由这里通知 Air8000 作废已收到的数据
+    if (__atomic_load_n(&fota_ctx->aborted, __ATOMIC_ACQUIRE)) {
         log_info("fota", "FOTA升级已被取消");
+        send_ota_abort(fota_ctx);
         update_fota_status(fota_ctx, FOTA_STATUS_FAILED, FOTA_ERROR_ABORTED, fota_ctx->progress);
         trigger_fota_event(fota_ctx, FOTA_EVENT_ABORTED, NULL);
         pthread_mutex_unlock(&fota_ctx->mutex);
         return AIR8000_OK;
     }
 
+    // 流式升级：数据已全部发出，等下载侧校验通过后才让 Air8000 切换固件
+    if (fota_ctx->streaming && fota_ctx->source.verify &&
+        !fota_ctx->source.verify(fota_ctx->source.user_data)) {
+        log_error("fota", "下载侧校验失败，取消升级");
+        send_ota_abort(fota_ctx);
+        update_fota_status(fota_ctx, FOTA_STATUS_FAILED, FOTA_ERROR_VERIFY_FAILED, fota_ctx->progress);
+        trigger_fota_event(fota_ctx, FOTA_EVENT_ERROR, &fota_ctx->error);
+        pthread_mutex_unlock(&fota_ctx->mutex);
+        return AIR8000_ERR_PROTOCOL;
+    }
+
     // 发送升级完成命令
     ret = send_ota_finish(fota_ctx);
     if (ret != AIR8000_OK) {
@@ -248,18 +335,25 @@ int air8000_fota_abort(air8000_fota_ctx_t *fota_ctx) {
         return AIR8000_ERR_PARAM;
     }
 
+    // 检查当前状态（不加锁：air8000_fota_start 在整个发送期间持有互斥锁）
+    air8000_fota_status_t status = __atomic_load_n(&fota_ctx->status, __ATOMIC_ACQUIRE);
+    if (status == FOTA_STATUS_IDLE || status == FOTA_STATUS_SUCCESS || status == FOTA_STATUS_FAILED) {
+        log_warn("fota", "FOTA未在运行中，当前状态: %d", status);
+        return AIR8000_OK;
+    }
+
+    // 不加锁置位取消标志，窗口发送在提交下一个数据包前检查并停止
+    __atomic_store_n(&fota_ctx->aborted, true, __ATOMIC_RELEASE);
+
     pthread_mutex_lock(&fota_ctx->mutex);
 
-    // 检查当前状态
-    if (fota_ctx->status == FOTA_STATUS_IDLE || fota_ctx->status == FOTA_STATUS_SUCCESS || fota_ctx->status == FOTA_STATUS_FAILED) {
-        log_warn("fota", "FOTA未在运行中，当前状态: %d", fota_ctx->status);
+    // 发送期间取消时 air8000_fota_start 已通知 Air8000 并结束升级
+    status = fota_ctx->status;
+    if (status == FOTA_STATUS_SUCCESS || status == FOTA_STATUS_FAILED) {
         pthread_mutex_unlock(&fota_ctx->mutex);
         return AIR8000_OK;
     }
 
-    // 标记为已取消
-    fota_ctx->aborted = true;
-
     // 发送取消升级命令
     int ret = send_ota_abort(fota_ctx);
     if (ret != AIR8000_OK) {
@@ -313,7 +407,7 @@ int air8000_fota_handle_response(air8000_fota_ctx_t *fota_ctx, const air8000_fra
             if (status_info->status == FOTA_STATUS_FAILED) {
                 log_error("fota", "Air8000 FOTA升级失败，错误码: %d", status_info->error);
                 trigger_fota_event(fota_ctx, FOTA_EVENT_ERROR, &status_info->error);
-                fota_ctx->aborted = true;
+                __atomic_store_n(&fota_ctx->aborted, true, __ATOMIC_RELEASE);
             }
         }
     }
@@ -360,12 +454,43 @@ static int send_ota_start(air8000_fota_ctx_t *fota_ctx) {
 }
 
 static int send_ota_data(air8000_fota_ctx_t *fota_ctx) {
-    if (!fota_ctx || !fota_ctx->firmware_file) {
+    if (!fota_ctx || (!fota_ctx->firmware_file && !fota_ctx->streaming)) {
+        return AIR8000_ERR_PARAM;
+    }
+
+    uint32_t total_packets = (fota_ctx->firmware_size + DEFAULT_PACKET_SIZE - 1) / DEFAULT_PACKET_SIZE;
+    if (total_packets > 0x10000) {
+        // 包序号只有 16 位
+        log_error("fota", "固件过大: %u字节", fota_ctx->firmware_size);
         return AIR8000_ERR_PARAM;
     }
 
-    // 计算剩余数据大小
-    uint32_t remaining_size = fota_ctx->firmware_size - fota_ctx->sent_size;
+    // 保持 FOTA_WINDOW_SIZE 个数据包在途，NACK/超时的数据包单独重传；
+    // 窗口是整个上下文共用的设置，发送结束后恢复调用者原来的值
+    int saved_window = air8000_get_async_window(fota_ctx->air8000_ctx);
+    air8000_set_async_window(fota_ctx->air8000_ctx, FOTA_WINDOW_SIZE);
+
+    air8000_window_job_t job = {
+        .total = total_packets,
+        .max_retry = MAX_RETRY_COUNT,
+        .timeout_ms = RESPONSE_TIMEOUT_MS,
+        .build = build_ota_packet,
+        .progress = on_ota_packets_acked,
+        .abort_flag = &fota_ctx->aborted,
+        .user_data = fota_ctx
+    };
+    int ret = air8000_send_windowed(fota_ctx->air8000_ctx, &job);
+    air8000_set_async_window(fota_ctx->air8000_ctx, saved_window);
+    return ret;
+}
+
+static int build_ota_packet(air8000_t *ctx, uint32_t index, air8000_frame_t *frame, void *user_data) {
+    (void)ctx;
+    air8000_fota_ctx_t *fota_ctx = (air8000_fota_ctx_t *)user_data;
+
+    // 计算本包偏移和大小
+    uint32_t offset = index * DEFAULT_PACKET_SIZE;
+    uint32_t remaining_size = fota_ctx->firmware_size - offset;
     uint32_t packet_size = remaining_size < DEFAULT_PACKET_SIZE ? remaining_size : DEFAULT_PACKET_SIZE;
     
     // 分配数据包内存
@@ -376,55 +501,92 @@ static int send_ota_data(air8000_fota_ctx_t *fota_ctx) {
     }
     
     // 设置序号（大端序）
-    uint16_t seq_be = htons(fota_ctx->current_seq);
+    uint16_t seq_be = htons((uint16_t)index);
     memcpy(packet_data, &seq_be, 2);
     
-    // 读取固件数据
-    size_t read_len = fread(packet_data + 2, 1, packet_size, fota_ctx->firmware_file);
-    if (read_len != packet_size) {
-        log_error("fota", "读取固件数据失败: %d, 期望: %u, 实际: %zu", 
-                  errno, packet_size, read_len);
+    // 读取固件数据（重传时以相同偏移再次读取）
+    int ret = read_firmware(fota_ctx, offset, packet_data + 2, packet_size);
+    if (ret != AIR8000_OK) {
         free(packet_data);
-        return AIR8000_ERR_IO;
+        return ret;
     }
     
-    // 构建数据包命令
-    air8000_frame_t frame;
-    air8000_frame_init(&frame);
-    air8000_build_request(&frame, CMD_OTA_UART_DATA, packet_data, 2 + read_len);
-    
-    // 发送请求，带重试机制
-    int ret = AIR8000_OK;
-    int retry_count = 0;
+    // 构建数据包命令（每次调用获取新帧序列号）
+    air8000_build_request(frame, CMD_OTA_UART_DATA, packet_data, 2 + packet_size);
+    free(packet_data);
     
-    while (retry_count < MAX_RETRY_COUNT) {
-        ret = air8000_send_and_wait(fota_ctx->air8000_ctx, &frame, NULL, RESPONSE_TIMEOUT_MS);
-        if (ret == AIR8000_OK) {
-            break;
+    return frame->data ? AIR8000_OK : AIR8000_ERR_NOMEM;
+}
+
+static int read_firmware(air8000_fota_ctx_t *fota_ctx, uint32_t offset, uint8_t *buf, uint32_t len) {
+    if (fota_ctx->streaming) {
+        // 按需读取到本包末尾，数据未到时在数据源中等待
+        while (fota_ctx->stream_filled < offset + len) {
+            uint32_t pos = fota_ctx->stream_filled & (FOTA_STREAM_RETAIN_SIZE - 1);
+            uint32_t want = offset + len - fota_ctx->stream_filled;
+            if (want > FOTA_STREAM_RETAIN_SIZE - pos) {
+                want = FOTA_STREAM_RETAIN_SIZE - pos;
+            }
+            ssize_t n = fota_ctx->source.read(fota_ctx->source.user_data, fota_ctx->stream_buf + pos, want);
+            if (n <= 0) {
+                log_error("fota", "固件数据源中断，已读取: %u字节", fota_ctx->stream_filled);
+                return AIR8000_ERR_IO;
+            }
+            fota_ctx->stream_filled += (uint32_t)n;
+        }
+
+        // 仍在保留区内（绝大多数情况，包括窗口内的重传）
+        if (fota_ctx->stream_filled - offset <= FOTA_STREAM_RETAIN_SIZE) {
+            uint32_t pos = offset & (FOTA_STREAM_RETAIN_SIZE - 1);
+            uint32_t first = FOTA_STREAM_RETAIN_SIZE - pos < len ? FOTA_STREAM_RETAIN_SIZE - pos : len;
+            memcpy(buf, fota_ctx->stream_buf + pos, first);
+            memcpy(buf + first, fota_ctx->stream_buf, len - first);
+            return AIR8000_OK;
+        }
+
+        // 长时间重传的数据包已被覆盖，下载侧写入文件后才转发，回读文件即可
+        if (!fota_ctx->firmware_file) {
+            if (!fota_ctx->firmware_path[0]) {
+                return AIR8000_ERR_IO;
+            }
+            fota_ctx->firmware_file = fopen(fota_ctx->firmware_path, "rb");
+            if (!fota_ctx->firmware_file) {
+                log_error("fota", "无法打开固件文件: %s", fota_ctx->firmware_path);
+                return AIR8000_ERR_IO;
+            }
         }
-        
-        retry_count++;
-        log_warn("fota", "发送数据包失败，重试 %d/%d: %d", 
-                 retry_count, MAX_RETRY_COUNT, ret);
-        
-        // 短暂延迟后重试
-        usleep(100000); // 100ms
     }
-    
-    // 清理资源
-    air8000_frame_cleanup(&frame);
-    free(packet_data);
-    
-    if (ret == AIR8000_OK) {
-        // 更新状态
-        fota_ctx->sent_size += read_len;
-        fota_ctx->current_seq++;
-        
-        // 触发数据发送事件
-        trigger_fota_event(fota_ctx, FOTA_EVENT_DATA_SENT, &fota_ctx->sent_size);
+
+    if (fseek(fota_ctx->firmware_file, offset, SEEK_SET) != 0) {
+        return AIR8000_ERR_IO;
     }
+    size_t read_len = fread(buf, 1, len, fota_ctx->firmware_file);
+    if (read_len != len) {
+        log_error("fota", "读取固件数据失败: %d, 期望: %u, 实际: %zu", 
+                  errno, len, read_len);
+        return AIR8000_ERR_IO;
+    }
+    return AIR8000_OK;
+}
+
+static void on_ota_packets_acked(air8000_t *ctx, uint32_t acked, uint32_t total, void *user_data) {
+    (void)ctx;
+    air8000_fota_ctx_t *fota_ctx = (air8000_fota_ctx_t *)user_data;
+
+    // 更新状态（确认可能乱序，这里按已确认包数统计）
+    uint64_t sent = (uint64_t)acked * DEFAULT_PACKET_SIZE;
+    fota_ctx->sent_size = sent > fota_ctx->firmware_size ? fota_ctx->firmware_size : (uint32_t)sent;
+    fota_ctx->current_seq = (uint16_t)acked;
     
-    return ret;
+    // 触发数据发送事件
+    trigger_fota_event(fota_ctx, FOTA_EVENT_DATA_SENT, &fota_ctx->sent_size);
+
+    // 更新进度
+    uint8_t new_progress = (uint8_t)(((uint64_t)acked * 100) / total);
+    if (new_progress != fota_ctx->progress) {
+        update_fota_status(fota_ctx, FOTA_STATUS_RECEIVING, FOTA_ERROR_NONE, new_progress);
+        trigger_fota_event(fota_ctx, FOTA_EVENT_STATUS_UPDATED, &fota_ctx->progress);
+    }
 }
 
 static int send_ota_finish(air8000_fota_ctx_t *fota_ctx) {
@@ -470,7 +632,7 @@ static void update_fota_status(air8000_fota_ctx_t *fota_ctx, air8000_fota_status
         return;
     }
     
-    fota_ctx->status = status;
+    __atomic_store_n(&fota_ctx->status, status, __ATOMIC_RELEASE);
     fota_ctx->error = error;
     fota_ctx->progress = progress;
     
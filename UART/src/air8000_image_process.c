@@ -1,13 +1,14 @@
 /**
  * @file air8000_image_process.c
  * @brief Air8000 图片处理模块实现
- * @details 接收文件传输完成事件，自动调用image_processor处理图片
+ * @details 接收文件传输完成事件，自动调用 libimageproc 处理图片
  */
 
 #include "air8000_image_process.h"
 #include "air8000_file_transfer.h"
-#include "image_processor.h"
+#include "imageproc.h"
 #include "message_queue.h"
+#include "pm_metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +27,7 @@ typedef struct {
     air8000_t *air8000_ctx;  /* Air8000上下文 */
     int mq_fd;             /* 消息队列描述符 */
     uint32_t seq_num;        /* 序列号 */
+    imageproc_t *imageproc;  /* libimageproc 上下文（测量结果与标定缓存） */
 } image_process_context_t;
 
 static image_process_context_t *g_proc_ctx = NULL;
@@ -61,25 +63,60 @@ static bool is_image_file(const char *filename) {
     return false;
 }
 
+/**
+ * @brief 填写跟踪ID与各阶段时间戳并发送结果消息
+ * @param msg 已填好结果的消息
+ * @param trace_id 跟踪ID
+ * @param trace_us 各阶段时间戳，发送前在这里补上 PM_TRACE_QUEUED
+ * @return 成功返回0，失败返回-1
+ */
+static int send_traced_result(message_t *msg, uint32_t trace_id, uint64_t trace_us[PM_TRACE_STAGE_COUNT]) {
+    msg->trace_id = trace_id;
+    trace_us[PM_TRACE_QUEUED] = pm_metrics_now_us();
+    memcpy(msg->payload.img_result.trace_us, trace_us, sizeof(msg->payload.img_result.trace_us));
+    return mq_send_msg(g_proc_ctx->mq_fd, msg, 0);
+}
+
 /**
  * @brief 处理接收到的图片文件
+ * @param ctx Air8000上下文，用于取得文件的跟踪信息
+ * @param input_path 接收文件的完整路径
  */
-static void process_image_file(const char *filename) {
-    if (!g_proc_ctx || !is_image_file(filename)) {
+static void process_image_file(air8000_t *ctx, const char *input_path) {
+    if (!g_proc_ctx || !input_path || !is_image_file(input_path)) {
         return;
     }
     
-    printf("[图片处理] 开始处理文件: %s\n", filename);
+    printf("[图片处理] 开始处理文件: %s\n", input_path);
+    
+    /* 拍摄与传输阶段由文件传输模块记录，未取得时从这里开始跟踪 */
+    uint64_t trace_us[PM_TRACE_STAGE_COUNT] = { 0 };
+    uint32_t trace_id;
+    air8000_file_trace_t ft_trace;
+    if (air8000_file_transfer_get_trace(ctx, &ft_trace) == 0) {
+        trace_id = ft_trace.trace_id;
+        trace_us[PM_TRACE_CAPTURED] = ft_trace.captured_us;
+        trace_us[PM_TRACE_TRANSFERRED] = ft_trace.transferred_us;
+    } else {
+        trace_id = pm_metrics_trace_id();
+        trace_us[PM_TRACE_CAPTURED] = pm_metrics_now_us();
+    }
     
     /* 确保输出目录存在 */
     ensure_dir_exists(PROCESSED_FILE_DIR);
     
-    /* 构建完整路径 */
-    char input_path[512];
-    snprintf(input_path, sizeof(input_path), "%s/%s", RECEIVED_FILE_DIR, filename);
-    
-    /* 调用图像处理算法 */
-    int result = image_processor_process_image(input_path, PROCESSED_FILE_DIR, 0);
+    /* 调用图像处理算法，解码与测量的分界由 libimageproc 的耗时换算 */
+    uint64_t process_start_us = pm_metrics_now_us();
+    int result = imageproc_process_file(g_proc_ctx->imageproc, input_path, PROCESSED_FILE_DIR);
+    uint64_t process_end_us = pm_metrics_now_us();
+    imageproc_timing_t timing;
+    if (imageproc_get_timing(g_proc_ctx->imageproc, &timing) == 0 &&
+        process_start_us + timing.decode_us <= process_end_us) {
+        trace_us[PM_TRACE_DECODED] = process_start_us + timing.decode_us;
+    } else {
+        trace_us[PM_TRACE_DECODED] = process_start_us;
+    }
+    trace_us[PM_TRACE_MEASURED] = process_end_us;
     
     if (result == 0) {
         printf("[图片处理] 处理完成\n");
@@ -95,11 +132,13 @@ static void process_image_file(const char *filename) {
             
             image_process_result_t *result_info = (image_process_result_t *)&msg.payload.data;
             result_info->success = 1;
-            result_info->paragraph_count = image_processor_get_paragraph_count();
+            int count = imageproc_get_paragraph_count(g_proc_ctx->imageproc);
+            result_info->paragraph_count = (uint8_t)(count > IMAGE_RESULT_MAX_PARAGRAPHS ?
+                                                     IMAGE_RESULT_MAX_PARAGRAPHS : count);
             
-            for (int i = 0; i < result_info->paragraph_count && i < 10; i++) {
+            for (int i = 0; i < result_info->paragraph_count; i++) {
                 paragraph_t para;
-                if (image_processor_get_paragraph(i, &para) == 0) {
+                if (imageproc_get_paragraph(g_proc_ctx->imageproc, i, &para) == 0) {
                     // 使用memcpy复制结构体内容到数组
                     memcpy(result_info->paragraphs[i], &para, sizeof(paragraph_t));
                 }
@@ -107,8 +146,8 @@ static void process_image_file(const char *filename) {
             
             msg.data_len = sizeof(image_process_result_t);
             
-            if (mq_send_msg(g_proc_ctx->mq_fd, &msg, 0) == 0) {
-                printf("[图片处理] 处理结果已发送到MQTT\n");
+            if (send_traced_result(&msg, trace_id, trace_us) == 0) {
+                printf("[图片处理] 处理结果已发送到MQTT（trace %08x）\n", trace_id);
             } else {
                 perror("[图片处理] 发送处理结果失败");
             }
@@ -132,7 +171,7 @@ static void process_image_file(const char *filename) {
             result_info->paragraph_count = 0;
             msg.data_len = sizeof(image_process_result_t);
             
-            if (mq_send_msg(g_proc_ctx->mq_fd, &msg, 0) == 0) {
+            if (send_traced_result(&msg, trace_id, trace_us) == 0) {
                 printf("[图片处理] 处理失败通知已发送到MQTT\n");
             } else {
                 perror("[图片处理] 发送处理失败通知失败");
@@ -147,13 +186,12 @@ static void process_image_file(const char *filename) {
  * @brief 文件传输回调函数
  */
 static void file_transfer_callback(air8000_t *ctx, air8000_file_transfer_event_t event, void *data, void *user_data) {
-    (void)ctx;
     (void)user_data;
     
     switch (event) {
         case FILE_TRANSFER_EVENT_COMPLETED:
-            /* 文件传输完成，处理图片 */
-            process_image_file((const char *)data);
+            /* 文件接收完成，data 为接收文件路径（发送完成时为 NULL） */
+            process_image_file(ctx, (const char *)data);
             break;
         default:
             break;
@@ -182,6 +220,15 @@ int air8000_image_process_init(air8000_t *ctx, int mq_fd) {
     g_proc_ctx->mq_fd = mq_fd;
     g_proc_ctx->seq_num = 0;
     
+    /* 默认选项：不使用标定、整帧处理、不输出调试中间图 */
+    g_proc_ctx->imageproc = imageproc_create(NULL);
+    if (!g_proc_ctx->imageproc) {
+        printf("[图片处理] 创建图像处理上下文失败\n");
+        free(g_proc_ctx);
+        g_proc_ctx = NULL;
+        return -1;
+    }
+    
     /* 确保目录存在 */
     if (ensure_dir_exists(RECEIVED_FILE_DIR) != 0) {
         printf("[图片处理] 警告：无法创建接收目录，将使用当前目录\n");
@@ -191,9 +238,9 @@ int air8000_image_process_init(air8000_t *ctx, int mq_fd) {
     }
     
     /* 注册文件传输回调，监听传输完成事件 */
-    air8000_file_transfer_register_callback(file_transfer_callback, NULL);
+    air8000_file_transfer_register_callback(ctx, file_transfer_callback, NULL);
     
-    printf("[图片处理] 模块初始化完成\n");
+    printf("[图片处理] 模块初始化完成，内核: %s\n", imageproc_backend_name());
     return 0;
 }
 
@@ -202,6 +249,7 @@ int air8000_image_process_init(air8000_t *ctx, int mq_fd) {
  */
 void air8000_image_process_deinit(void) {
     if (g_proc_ctx) {
+        imageproc_destroy(g_proc_ctx->imageproc);
         free(g_proc_ctx);
         g_proc_ctx = NULL;
     }
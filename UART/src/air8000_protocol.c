@@ -24,6 +24,7 @@
  */
 
 #include "air8000_protocol.h"    /* 协议头文件，包含常量定义和函数声明 */
+#include "air8000_checksum.h"    /* 校验和模块，提供查表 CRC 实现 */
 #include <string.h>             /* 字符串处理函数，如 memcpy、memset */
 #include <stdlib.h>             /* 动态内存分配函数，如 malloc、free */
 #include <stdio.h>              /* 标准输入输出，如 snprintf */
@@ -36,6 +37,12 @@
  */
 static uint8_t g_seq_counter = 0;
 
+/**
+ * @brief 接收帧 CRC 校验开关
+ * @details 默认关闭，保持原有行为；开启后 parse 系列函数会丢弃 CRC 错误的帧
+ */
+static volatile bool g_crc_verify = false;
+
 // ==================== 基础函数实现 ====================
 
 /**
@@ -44,7 +51,8 @@ static uint8_t g_seq_counter = 0;
  * @details 使用内部静态变量 g_seq_counter 实现，每次调用自动递增并返回当前值
  */
 uint8_t air8000_next_seq(void) {
-    return g_seq_counter++;
+    /* 多个线程可能同时发起请求，原子递增避免取到重复的序列号 */
+    return __atomic_fetch_add(&g_seq_counter, 1, __ATOMIC_RELAXED);
 }
 
 /**
@@ -55,25 +63,24 @@ uint8_t air8000_next_seq(void) {
  * @details 采用 MODBUS 标准的 CRC-16 算法，初始值为 0xFFFF，多项式为 0xA001
  */
 uint16_t air8000_crc16_modbus(const uint8_t *data, size_t len) {
-    uint16_t crc = 0xFFFF;       /* 初始 CRC 值 */
-    
-    /* 遍历每个字节 */
-    for (size_t i = 0; i < len; i++) {
-        crc ^= (uint16_t)data[i]; /* 与当前字节异或 */
-        
-        /* 处理每个比特位 */
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x0001) {
-                /* 最低位为 1，右移后与多项式异或 */
-                crc = (crc >> 1) ^ 0xA001;
-            } else {
-                /* 最低位为 0，仅右移 */
-                crc >>= 1;
-            }
-        }
-    }
-    
-    return crc;                  /* 返回计算结果 */
+    /* 查表实现由 air8000_checksum 模块在启动时选择 */
+    return air8000_crc16_modbus_update(0xFFFF, data, len);
+}
+
+/**
+ * @brief 设置接收帧 CRC 校验模式
+ * @param enable true 开启校验
+ */
+void air8000_frame_set_crc_verify(bool enable) {
+    g_crc_verify = enable;
+}
+
+/**
+ * @brief 获取接收帧 CRC 校验模式
+ * @return true 表示已开启校验
+ */
+bool air8000_frame_get_crc_verify(void) {
+    return g_crc_verify;
 }
 
 /**
@@ -147,26 +154,19 @@ int air8000_frame_encode(const air8000_frame_t *frame, uint8_t *buffer, size_t m
 }
 
 /**
- * @brief 解析帧数据
+ * @brief 零拷贝解析帧数据
  * @param buffer 要解析的原始数据指针
  * @param len 原始数据长度
  * @param frame 输出帧指针
  * @return 成功返回解析出的帧长度，失败返回负数
- * @details 从原始数据中解析出完整的帧，包括帧头、数据和 CRC 校验
+ * @details 只解析帧头字段，frame->data 直接指向 buffer 中的数据段
  */
-int air8000_frame_parse(const uint8_t *buffer, size_t len, air8000_frame_t *frame) {
+int air8000_frame_parse_view(const uint8_t *buffer, size_t len, air8000_frame_t *frame) {
     /* 检查参数有效性 */
     if (!frame) {
         return -1;  /* 帧指针为NULL，返回错误 */
     }
 
-    /* 清理帧中可能存在的旧数据 */
-    if (frame->data) {
-        free(frame->data);
-        frame->data = NULL;
-        frame->data_len = 0;
-    }
-
     /* 检查数据长度是否至少包含最小帧大小 */
     if (len < AIR8000_MIN_FRAME) {
         return -1;  /* 数据不完整，返回 -1 */
@@ -186,8 +186,14 @@ int air8000_frame_parse(const uint8_t *buffer, size_t len, air8000_frame_t *fram
         return -1;  /* 数据不完整，返回 -1 */
     }
 
-    // 注意：此处我们不强制验证 CRC，因为 Air8000 设备通常不验证 CRC，但为了健壮性，上层可以选择验证
-    // 这里只做字段解析
+    /* CRC 校验默认关闭（Air8000 设备通常不验证 CRC），可通过 air8000_frame_set_crc_verify 开启 */
+    if (g_crc_verify) {
+        uint16_t crc = air8000_crc16_modbus(&buffer[2], (AIR8000_HEADER_SIZE - 2) + data_len);
+        uint16_t recv_crc = ((uint16_t)buffer[total_len - 2] << 8) | buffer[total_len - 1];
+        if (crc != recv_crc) {
+            return -3;  /* CRC 校验失败，返回 -3 */
+        }
+    }
     
     /* 填充帧字段 */
     frame->version = buffer[2];
@@ -195,22 +201,224 @@ int air8000_frame_parse(const uint8_t *buffer, size_t len, air8000_frame_t *fram
     frame->seq = buffer[4];
     frame->cmd = ((uint16_t)buffer[5] << 8) | buffer[6];
     frame->data_len = data_len;
-    
+    frame->data = data_len > 0 ? (uint8_t *)&buffer[AIR8000_HEADER_SIZE] : NULL;
+
+    return (int)total_len;  /* 返回解析出的帧长度 */
+}
+
+/**
+ * @brief 解析帧数据
+ * @param buffer 要解析的原始数据指针
+ * @param len 原始数据长度
+ * @param frame 输出帧指针
+ * @return 成功返回解析出的帧长度，失败返回负数
+ * @details 从原始数据中解析出完整的帧，包括帧头、数据和 CRC 校验，数据段拷贝到新分配的内存
+ */
+int air8000_frame_parse(const uint8_t *buffer, size_t len, air8000_frame_t *frame) {
+    /* 检查参数有效性 */
+    if (!frame) {
+        return -1;  /* 帧指针为NULL，返回错误 */
+    }
+
+    /* 清理帧中可能存在的旧数据 */
+    if (frame->data) {
+        free(frame->data);
+        frame->data = NULL;
+        frame->data_len = 0;
+    }
+
+    air8000_frame_t view;
+    int total_len = air8000_frame_parse_view(buffer, len, &view);
+    if (total_len < 0) {
+        return total_len;
+    }
+
     /* 动态分配内存并复制数据，避免零拷贝导致的内存释放错误 */
-    if (data_len > 0) {
-        frame->data = (uint8_t *)malloc(data_len);
-        if (frame->data) {
-            memcpy(frame->data, &buffer[AIR8000_HEADER_SIZE], data_len);
-        } else {
-            // 修复：内存分配失败时，将data_len设为0，避免后续访问无效内存
-            frame->data = NULL;
-            frame->data_len = 0;
+    air8000_frame_copy(frame, &view);
+
+    return total_len;  /* 返回解析出的帧长度 */
+}
+
+/**
+ * @brief 查找同步字 0xAA55
+ * @param buffer 数据指针
+ * @param len 数据长度
+ * @return 第一个同步字的偏移，未找到时返回可丢弃的字节数
+ * @details 用 memchr 跳到下一个 0xAA，而不是逐字节移动缓冲区
+ */
+size_t air8000_frame_find_sync(const uint8_t *buffer, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        const uint8_t *p = (const uint8_t *)memchr(buffer + off, AIR8000_SYNC1, len - off);
+        if (!p) {
+            return len;  /* 没有候选同步字，全部丢弃 */
+        }
+        off = (size_t)(p - buffer);
+        if (off + 1 >= len || buffer[off + 1] == AIR8000_SYNC2) {
+            return off;  /* 找到同步字，或末尾 0xAA 需等待下一个字节 */
+        }
+        off++;
+    }
+    return len;
+}
+
+/**
+ * @brief 深拷贝帧
+ * @param dst 目标帧指针
+ * @param src 源帧指针
+ * @return 成功返回0，内存不足返回 -1
+ */
+int air8000_frame_copy(air8000_frame_t *dst, const air8000_frame_t *src) {
+    if (dst->data) {
+        free(dst->data);
+    }
+    
+    dst->version = src->version;
+    dst->type = src->type;
+    dst->seq = src->seq;
+    dst->cmd = src->cmd;
+    dst->data_len = src->data_len;
+    dst->data = NULL;
+    
+    if (src->data_len > 0 && src->data) {
+        dst->data = (uint8_t *)malloc(src->data_len);
+        if (!dst->data) {
+            // 内存分配失败时，将data_len设为0，避免后续访问无效内存
+            dst->data_len = 0;
+            return -1;
         }
+        memcpy(dst->data, src->data, src->data_len);
+    }
+    return 0;
+}
+
+// ==================== 接收环形缓冲区 ====================
+
+/**
+ * @brief 环形缓冲区下标掩码
+ */
+#define RX_RING_MASK (AIR8000_RX_RING_SIZE - 1)
+
+/**
+ * @brief 从环中拷贝数据（处理回绕），不移动读位置
+ */
+static void rx_ring_peek(const air8000_rx_ring_t *ring, size_t pos, uint8_t *out, size_t len) {
+    size_t off = pos & RX_RING_MASK;
+    size_t first = AIR8000_RX_RING_SIZE - off;
+    if (first >= len) {
+        memcpy(out, &ring->buf[off], len);
     } else {
-        frame->data = NULL;
+        memcpy(out, &ring->buf[off], first);
+        memcpy(out + first, ring->buf, len - first);
     }
+}
 
-    return (int)total_len;  /* 返回解析出的帧长度 */
+void air8000_rx_ring_init(air8000_rx_ring_t *ring) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->need = 0;
+    ring->crc_errors = 0;
+}
+
+size_t air8000_rx_ring_used(const air8000_rx_ring_t *ring) {
+    return ring->tail - ring->head;
+}
+
+uint8_t *air8000_rx_ring_write_ptr(air8000_rx_ring_t *ring, size_t *space) {
+    size_t used = ring->tail - ring->head;
+    if (used == 0) {
+        /* 环为空时回到起点，让后续读取尽量连续，减少跨环尾的帧 */
+        ring->head = 0;
+        ring->tail = 0;
+    }
+    size_t off = ring->tail & RX_RING_MASK;
+    size_t free_total = AIR8000_RX_RING_SIZE - used;
+    size_t contig = AIR8000_RX_RING_SIZE - off;
+    *space = contig < free_total ? contig : free_total;
+    return &ring->buf[off];
+}
+
+void air8000_rx_ring_commit(air8000_rx_ring_t *ring, size_t len) {
+    ring->tail += len;
+}
+
+/**
+ * @brief 从环中取出下一个完整帧
+ * @param ring 环形缓冲区指针
+ * @param frame 输出帧视图
+ * @return 成功返回帧长度，数据不足返回 0
+ * @details 处理流程：
+ * 1. memchr 查找 0xAA，丢弃之前的无效字节（每段连续区域一次调用）
+ * 2. 校验 0x55，不匹配则跳过该字节继续查找
+ * 3. 读取帧头得到长度，数据不足时返回 0 等待更多数据
+ * 4. 帧在环内连续时直接返回指向环的视图，否则拷贝到 linear
+ */
+int air8000_rx_ring_next_frame(air8000_rx_ring_t *ring, air8000_frame_t *frame) {
+    for (;;) {
+        size_t used = ring->tail - ring->head;
+        if (used == 0 || used < ring->need) {
+            return 0;  /* 帧头已解析过，数据仍不足，不必重复查找 */
+        }
+        
+        /* 1. 在连续区域内查找 0xAA */
+        size_t off = ring->head & RX_RING_MASK;
+        size_t contig = AIR8000_RX_RING_SIZE - off;
+        if (contig > used) {
+            contig = used;
+        }
+        const uint8_t *p = (const uint8_t *)memchr(&ring->buf[off], AIR8000_SYNC1, contig);
+        if (!p) {
+            ring->head += contig;  /* 整段都是无效数据 */
+            continue;
+        }
+        ring->head += (size_t)(p - &ring->buf[off]);
+        used = ring->tail - ring->head;
+        
+        /* 2. 校验第二个同步字节 */
+        if (used < 2) {
+            return 0;
+        }
+        if (ring->buf[(ring->head + 1) & RX_RING_MASK] != AIR8000_SYNC2) {
+            ring->head++;
+            continue;
+        }
+        
+        /* 3. 读取帧头 */
+        if (used < AIR8000_MIN_FRAME) {
+            return 0;
+        }
+        uint8_t hdr[AIR8000_HEADER_SIZE];
+        rx_ring_peek(ring, ring->head, hdr, sizeof(hdr));
+        uint16_t data_len = ((uint16_t)hdr[7] << 8) | hdr[8];
+        size_t total_len = AIR8000_HEADER_SIZE + data_len + AIR8000_CRC_SIZE;
+        if (total_len > AIR8000_RX_RING_SIZE) {
+            ring->head++;  /* 长度不可能放进环，视为误同步 */
+            continue;
+        }
+        if (used < total_len) {
+            ring->need = total_len;
+            return 0;
+        }
+        ring->need = 0;
+        
+        /* 4. 返回视图 */
+        const uint8_t *start;
+        off = ring->head & RX_RING_MASK;
+        if (off + total_len <= AIR8000_RX_RING_SIZE) {
+            start = &ring->buf[off];
+        } else {
+            rx_ring_peek(ring, ring->head, ring->linear, total_len);
+            start = ring->linear;
+        }
+        int ret = air8000_frame_parse_view(start, total_len, frame);
+        if (ret == -3) {
+            ring->crc_errors++;
+            ring->head++;  /* CRC 错误可能是误同步，从下一个字节重新查找 */
+            continue;
+        }
+        ring->head += total_len;
+        return ret;
+    }
 }
 
 /**
@@ -375,6 +583,40 @@ void air8000_build_motor_rotate(air8000_frame_t *frame, uint8_t motor_id, float
     air8000_build_request(frame, CMD_MOTOR_ROTATE, buf, 9);
 }
 
+/**
+ * @brief 构建电机批量旋转请求帧
+ * @param frame 帧对象指针
+ * @param cmds 电机子命令数组
+ * @param count 子命令个数
+ * @param start_delay_ms 同步启动延时，单位毫秒
+ * @return 成功返回0，参数无效返回 -1
+ * @details 每个子命令的编码与 air8000_build_motor_rotate 相同，前面加上个数和同步启动延时
+ */
+int air8000_build_motor_rotate_batch(air8000_frame_t *frame, const air8000_motor_cmd_t *cmds,
+                                     size_t count, uint16_t start_delay_ms) {
+    if (!frame || !cmds || count == 0 || count > AIR8000_MOTOR_BATCH_MAX) {
+        return -1;
+    }
+    
+    uint8_t buf[3 + 9 * AIR8000_MOTOR_BATCH_MAX];   /* 命令数据缓冲区 */
+    buf[0] = (uint8_t)count;                        /* 子命令个数 */
+    buf[1] = (start_delay_ms >> 8) & 0xFF;          /* 同步启动延时高字节 */
+    buf[2] = start_delay_ms & 0xFF;                 /* 同步启动延时低字节 */
+    
+    uint8_t *p = &buf[3];
+    for (size_t i = 0; i < count; i++) {
+        uint32_t angle_be = air8000_htonf(cmds[i].angle);     /* 角度转换为网络字节序 */
+        uint32_t vel_be = air8000_htonf(cmds[i].velocity);    /* 速度转换为网络字节序 */
+        p[0] = cmds[i].motor_id;
+        memcpy(&p[1], &angle_be, 4);
+        memcpy(&p[5], &vel_be, 4);
+        p += 9;
+    }
+    
+    air8000_build_request(frame, CMD_MOTOR_ROTATE_BATCH, buf, 3 + 9 * count);
+    return 0;
+}
+
 /**
  * @brief 构建电机使能请求帧
  * @param frame 帧对象指针
@@ -568,6 +810,21 @@ void air8000_build_sensor_read_all(air8000_frame_t *frame) {
     air8000_build_request(frame, CMD_SENSOR_READ_ALL, NULL, 0);
 }
 
+/**
+ * @brief 构建遥测订阅请求帧
+ * @param frame 帧对象指针
+ * @param mask 数据项掩码
+ * @param period_ms 上报周期，单位毫秒，0 表示取消订阅
+ * @details 构建一个让设备按固定周期主动上报遥测数据的请求帧
+ */
+void air8000_build_telemetry_subscribe(air8000_frame_t *frame, uint8_t mask, uint16_t period_ms) {
+    uint8_t buf[3];                          /* 命令数据缓冲区 */
+    buf[0] = mask;                           /* 数据项掩码 */
+    buf[1] = (uint8_t)(period_ms >> 8);      /* 上报周期，大端序 */
+    buf[2] = (uint8_t)(period_ms & 0xFF);
+    air8000_build_request(frame, CMD_TELEMETRY_SUBSCRIBE, buf, 3);
+}
+
 /**
  * @brief 构建设备控制请求帧
  * @param frame 帧对象指针
@@ -844,3 +1101,51 @@ int air8000_parse_motor_refresh(const uint8_t *data, size_t len, uint8_t *motor_
     
     return 0;
 }
+
+/**
+ * @brief 解析遥测上报帧
+ * @param data 上报数据指针
+ * @param len 数据长度，单位字节
+ * @param out 输出遥测快照指针
+ * @return 成功返回 0，失败返回 -1
+ * @details 各数据段复用对应查询命令的响应格式，直接解码到定长快照中，不分配内存
+ */
+int air8000_parse_telemetry(const uint8_t *data, size_t len, air8000_telemetry_t *out) {
+    if (len < 5 || !out) return -1;  /* 数据长度不足或输出指针无效，返回失败 */
+    
+    /* 解析掩码和设备采样时刻 */
+    out->mask = data[0];
+    out->device_tick_ms = ((uint32_t)data[1] << 24) | ((uint32_t)data[2] << 16) |
+                          ((uint32_t)data[3] << 8) | data[4];
+    out->motor_count = 0;
+    size_t offset = 5;
+    
+    /* 解析电机段：每个电机 17 字节，格式与刷新电机状态响应相同 */
+    if (out->mask & AIR8000_TELEMETRY_MOTORS) {
+        if (offset + 1 > len) return -1;
+        size_t count = data[offset++];
+        if (offset + count * 17 > len) return -1;
+        for (size_t i = 0; i < count; i++, offset += 17) {
+            if (out->motor_count >= AIR8000_TELEMETRY_MAX_MOTORS) {
+                continue;                /* 超出快照容量的电机跳过 */
+            }
+            air8000_motor_telemetry_t *m = &out->motors[out->motor_count++];
+            air8000_parse_motor_refresh(&data[offset], 17, &m->motor_id, &m->position, &m->velocity,
+                                        &m->torque, &m->temp_mos, &m->temp_rotor, &m->error, &m->enabled);
+        }
+    }
+    
+    /* 解析传感器段 */
+    if (out->mask & AIR8000_TELEMETRY_SENSORS) {
+        if (air8000_parse_sensor_data(&data[offset], len - offset, &out->sensors) != 0) return -1;
+        offset += 5;
+    }
+    
+    /* 解析电源段 */
+    if (out->mask & AIR8000_TELEMETRY_POWER) {
+        if (air8000_parse_power_adc(&data[offset], len - offset, &out->power) != 0) return -1;
+        offset += 4;
+    }
+    
+    return 0;
+}
@@ -8,10 +8,11 @@
  * 2. **模块化设计**：将串口操作封装为独立模块，与上层协议解耦
  * 3. **异步通信支持**：提供超时机制，支持异步通信模式
  * 4. **配置灵活性**：支持不同波特率、数据位、停止位和校验方式的配置
- * 5. **调试友好**：提供数据发送和接收的日志输出
+ * 5. **调试友好**：调试构建打印收发的十六进制数据，原始数据可记录到跟踪环按需导出
  * 
  * 实现特点：
  * - 使用 poll 机制实现非阻塞读取和超时控制
+ * - 串口 fd 保持非阻塞，写入只写内核缓冲区能容纳的部分，不会卡住 I/O 线程
  * - 支持原始模式通信，适合二进制数据传输
  * - 实现了硬件流控禁用，适合简单通信场景
  * - 支持 DTR 线控制，适应不同硬件需求
@@ -20,6 +21,7 @@
 
 #include "air8000_serial.h"    /* 串口抽象层头文件 */
 #include "air8000_log.h"        /* 统一日志头文件 */
+#include "air8000_trace.h"      /* 原始数据跟踪环 */
 #include <stdio.h>             /* 标准输入输出 */
 #include <stdlib.h>            /* 标准库函数 */
 #include <string.h>            /* 字符串处理函数 */
@@ -52,19 +54,16 @@ int air8000_serial_open(air8000_serial_t *serial, const char *path) {
 
     /* 保存设备路径 */
     strncpy(serial->device_path, path, sizeof(serial->device_path) - 1);
-    serial->fd = -1;           /* 初始化为无效文件描述符 */
+    serial->fd = -1;           /* 初始化为无效文件描述符（drain 设置保持不变，重连后沿用） */
 
-    /* 打开串口：读写模式，不作为控制终端，非阻塞模式(避免打开时阻塞) */
-    serial->fd = open(path, O_RDWR | O_NOCTTY | O_NDELAY);
+    /* 打开串口：读写模式，不作为控制终端，非阻塞模式 */
+    serial->fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
     if (serial->fd < 0) {
         perror("open serial"); /* 打印错误信息 */
         serial->fd = -1;
         return -1;            /* 打开失败，返回 -1 */
     }
 
-    /* 清除 O_NDELAY 标志，使其恢复为阻塞模式 (我们通过 poll 控制超时) */
-    fcntl(serial->fd, F_SETFL, 0);
-
     struct termios tty;        /* 终端属性结构体 */
     /* 获取当前终端属性 */
     if (tcgetattr(serial->fd, &tty) != 0) {
@@ -132,48 +131,93 @@ void air8000_serial_close(air8000_serial_t *serial) {
     }
 }
 
+/**
+ * @brief 格式化当前时间，用于日志
+ * @param time_str 输出缓冲区，至少 20 字节
+ * @param size 缓冲区大小
+ */
+static void format_time(char *time_str, size_t size) {
+    time_t now = time(NULL);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(time_str, size, "%Y-%m-%d %H:%M:%S", &tm_info);
+}
+
+#if AIR8000_LOG_ENABLED(AIR8000_LOG_LEVEL_DEBUG)
+/**
+ * @brief 以十六进制打印收发数据（调试用）
+ * @param what 描述，如 "Sending" / "Received"
+ * @param data 数据指针
+ * @param len 数据长度
+ * @details 查表直接写入缓冲区，线性时间；发布构建中整个函数不参与编译
+ */
+static void log_hex_dump(const char *what, const uint8_t *data, size_t len) {
+    static const char hex[] = "0123456789ABCDEF";
+    char time_str[20];
+    format_time(time_str, sizeof(time_str));
+
+    log_debug("serial", "[%s] %s %zu bytes:", time_str, what, len);
+
+    char hex_buf[3 * len + 1];
+    char *p = hex_buf;
+    for (size_t i = 0; i < len; i++) {
+        *p++ = hex[data[i] >> 4];
+        *p++ = hex[data[i] & 0x0F];
+        *p++ = ' ';
+    }
+    *p = '\0';
+    log_debug("serial", "[%s] HEX: %s", time_str, hex_buf);
+}
+#else
+#define log_hex_dump(what, data, len) ((void)0)
+#endif
+
+/**
+ * @brief 设置发送后是否等待数据发出
+ * @param serial 串口对象指针
+ * @param drain true：每次发送后 tcdrain 等待硬件发送完成；false：写入内核缓冲区即返回
+ */
+void air8000_serial_set_drain(air8000_serial_t *serial, bool drain) {
+    if (serial) {
+        serial->drain = drain;
+    }
+}
+
 /**
  * @brief 向串口发送数据
  * @param serial 串口对象指针
  * @param data 要发送的数据指针
  * @param len 数据长度，单位字节
- * @return 成功返回实际发送的字节数，失败返回 -1
- * @details 向串口发送指定长度的数据，支持调试输出
+ * @return 成功返回实际发送的字节数（可能小于 len），内核发送缓冲区已满时返回 0，失败返回 -1
+ * @details 串口 fd 为非阻塞，只写入内核缓冲区能容纳的部分，调用者负责从返回的偏移继续发送；
+ *          原始数据记录到跟踪环，十六进制打印仅在调试日志级别编译
  */
 int air8000_serial_write(air8000_serial_t *serial, const uint8_t *data, size_t len) {
     /* 参数有效性检查 */
     if (!serial || serial->fd < 0) return -1;
 
-    /* 获取当前时间，用于日志 */
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-    char time_str[20];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-
     /* 打印发送的数据（调试用） */
-    log_info("serial", "[%s] Sending %zu bytes:", time_str, len);
-    
-    /* 打印十六进制数据 */
-    char hex_buf[3 * len + 1];
-    hex_buf[0] = '\0';
-    for (size_t i = 0; i < len; i++) {
-        char byte[4];
-        sprintf(byte, "%02X ", data[i]);
-        strcat(hex_buf, byte);
-    }
-    log_info("serial", "[%s] HEX: %s", time_str, hex_buf);
+    log_hex_dump("Sending", data, len);
     
     /* 发送数据 */
     ssize_t written = write(serial->fd, data, len);
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;             /* 发送缓冲区已满，等待可写后再发 */
+    }
     if (written < 0) {
+        char time_str[20];
+        format_time(time_str, sizeof(time_str));
         log_error("serial", "[%s] Write failed: %s", time_str, strerror(errno));
         return -1;            /* 发送失败，返回 -1 */
     }
+    air8000_trace_record(AIR8000_TRACE_TX, data, (size_t)written);
 
-    /* 确保数据已发送到硬件，等待输出缓冲区清空 */
-    tcdrain(serial->fd);
+    /* 等待模式下确保数据已发送到硬件；否则交给内核缓冲区，不阻塞 I/O 线程 */
+    if (serial->drain) {
+        tcdrain(serial->fd);
+    }
 
-    log_info("serial", "[%s] Successfully sent %zd bytes", time_str, written);
+    log_debug("serial", "Successfully sent %zd bytes", written);
     return (int)written;       /* 成功发送，返回实际发送的字节数 */
 }
 
@@ -197,12 +241,8 @@ int air8000_serial_read(air8000_serial_t *serial, uint8_t *buffer, size_t len, i
     /* 调用 poll 等待数据，超时时间为 timeout_ms */
     int ret = poll(&pfd, 1, timeout_ms);
     if (ret < 0) {
-        /* 获取当前时间，用于日志 */
-        time_t now = time(NULL);
-        struct tm *tm_info = localtime(&now);
         char time_str[20];
-        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-        
+        format_time(time_str, sizeof(time_str));
         log_error("serial", "[%s] Poll failed: %s", time_str, strerror(errno));
         return -1;            /* poll 失败，返回 -1 */
     } else if (ret == 0) {
@@ -214,37 +254,16 @@ int air8000_serial_read(air8000_serial_t *serial, uint8_t *buffer, size_t len, i
         /* 读取数据 */
         ssize_t n = read(serial->fd, buffer, len);
         if (n < 0) {
-            /* 获取当前时间，用于日志 */
-            time_t now = time(NULL);
-            struct tm *tm_info = localtime(&now);
             char time_str[20];
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-            
+            format_time(time_str, sizeof(time_str));
             log_error("serial", "[%s] Read failed: %s", time_str, strerror(errno));
             return -1;        /* 读取失败，返回 -1 */
         }
         
-        /* 打印接收的数据（调试用） */
         if (n > 0) {
-            /* 获取当前时间，用于日志 */
-            time_t now = time(NULL);
-            struct tm *tm_info = localtime(&now);
-            char time_str[20];
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-            
-            log_info("serial", "[%s] Received %zd bytes:", time_str, n);
-            
-            /* 打印十六进制数据 */
-            char hex_buf[3 * n + 1];
-            hex_buf[0] = '\0';
-            for (size_t i = 0; i < (size_t)n; i++) {
-                char byte[4];
-                sprintf(byte, "%02X ", buffer[i]);
-                strcat(hex_buf, byte);
-            }
-            log_info("serial", "[%s] HEX: %s", time_str, hex_buf);
-            
-            fflush(stdout);   /* 立即刷新输出缓冲区 */
+            air8000_trace_record(AIR8000_TRACE_RX, buffer, (size_t)n);
+            /* 打印接收的数据（调试用） */
+            log_hex_dump("Received", buffer, (size_t)n);
         }
 
         return (int)n;         /* 成功读取，返回实际读取的字节数 */
@@ -0,0 +1,160 @@
+/**
+ * @file air8000_trace.c
+ * @brief 串口原始数据跟踪环实现
+ * @details 固定 64 字节槽位的无锁环：
+ * - 写入者通过原子加法领取连续的槽位序号，不需要互斥锁
+ * - 每个槽位的 seq 字段充当 seqlock：写入前清零，写完后以 release 语义写入序号+1
+ * - 导出时 seq 与期望序号不符（正在写入或已被后来的数据覆盖）的槽位直接跳过
+ */
+
+#include "air8000_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ==================== 内部定义 ====================
+
+/**
+ * @brief 每个槽位可存放的数据字节数
+ */
+#define TRACE_SLOT_DATA 48
+
+/**
+ * @brief 槽位标志：一次收发的第一个槽位
+ */
+#define TRACE_FLAG_FIRST 0x01
+
+/**
+ * @brief 跟踪槽位（64 字节）
+ */
+typedef struct {
+    uint32_t seq;                   ///< 0 表示写入中，否则为槽位序号 + 1
+    uint8_t dir;                    ///< 数据方向
+    uint8_t len;                    ///< 本槽位数据长度
+    uint8_t flags;                  ///< 槽位标志
+    uint8_t reserved;               ///< 保留
+    uint64_t ts_us;                 ///< 记录时间（CLOCK_MONOTONIC，微秒）
+    uint8_t data[TRACE_SLOT_DATA];  ///< 原始数据
+} trace_slot_t;
+
+static trace_slot_t *g_slots = NULL;   ///< 槽位数组
+static uint32_t g_slot_mask = 0;       ///< 槽位数 - 1
+static uint32_t g_ticket = 0;          ///< 下一个待领取的槽位序号
+static int g_enabled = 0;              ///< 是否正在记录
+
+/**
+ * @brief 获取单调时钟（微秒）
+ */
+static uint64_t trace_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// ==================== 对外接口 ====================
+
+int air8000_trace_enable(size_t slots) {
+    if (!g_slots) {
+        if (slots == 0) {
+            slots = AIR8000_TRACE_DEFAULT_SLOTS;
+        }
+        size_t n = 1;
+        while (n < slots) {
+            n <<= 1;
+        }
+        g_slots = (trace_slot_t *)calloc(n, sizeof(trace_slot_t));
+        if (!g_slots) {
+            return -1;
+        }
+        g_slot_mask = (uint32_t)(n - 1);
+    }
+    __atomic_store_n(&g_enabled, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void air8000_trace_disable(void) {
+    __atomic_store_n(&g_enabled, 0, __ATOMIC_RELEASE);
+}
+
+void air8000_trace_record(uint8_t dir, const uint8_t *data, size_t len) {
+    if (!__atomic_load_n(&g_enabled, __ATOMIC_ACQUIRE) || !data || len == 0) {
+        return;
+    }
+
+    uint32_t count = (uint32_t)((len + TRACE_SLOT_DATA - 1) / TRACE_SLOT_DATA);
+    uint32_t first = __atomic_fetch_add(&g_ticket, count, __ATOMIC_RELAXED);
+    uint64_t ts = trace_now_us();
+
+    for (uint32_t i = 0; i < count; i++) {
+        trace_slot_t *slot = &g_slots[(first + i) & g_slot_mask];
+        size_t chunk = len > TRACE_SLOT_DATA ? TRACE_SLOT_DATA : len;
+
+        __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->dir = dir;
+        slot->len = (uint8_t)chunk;
+        slot->flags = i == 0 ? TRACE_FLAG_FIRST : 0;
+        slot->ts_us = ts;
+        memcpy(slot->data, data, chunk);
+        __atomic_store_n(&slot->seq, first + i + 1, __ATOMIC_RELEASE);
+
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+int air8000_trace_dump(FILE *fp) {
+    static const char hex[] = "0123456789ABCDEF";
+    if (!g_slots || !fp) {
+        return 0;
+    }
+
+    uint32_t end = __atomic_load_n(&g_ticket, __ATOMIC_ACQUIRE);
+    uint32_t slots = g_slot_mask + 1;
+    uint32_t begin = end > slots ? end - slots : 0;
+    int records = 0;
+    int open = 0;        /* 当前是否有未换行的记录 */
+    uint32_t prev = 0;   /* 上一个有效槽位序号 */
+
+    for (uint32_t t = begin; t != end; t++) {
+        const trace_slot_t *slot = &g_slots[t & g_slot_mask];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != t + 1) {
+            continue;  /* 正在写入或已被覆盖 */
+        }
+        trace_slot_t copy;
+        memcpy(&copy, slot, sizeof(copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+            continue;  /* 拷贝期间被覆盖 */
+        }
+
+        if (copy.flags & TRACE_FLAG_FIRST) {
+            if (open) {
+                fputc('\n', fp);
+            }
+            fprintf(fp, "[%llu.%06llu] %s:", (unsigned long long)(copy.ts_us / 1000000ULL),
+                    (unsigned long long)(copy.ts_us % 1000000ULL),
+                    copy.dir == AIR8000_TRACE_TX ? "TX" : "RX");
+            open = 1;
+            records++;
+        } else if (!open || prev != t - 1) {
+            continue;  /* 记录开头或中间槽位已丢失，丢弃残段 */
+        }
+        prev = t;
+
+        char line[TRACE_SLOT_DATA * 3];
+        size_t pos = 0;
+        for (size_t i = 0; i < copy.len; i++) {
+            line[pos++] = ' ';
+            line[pos++] = hex[copy.data[i] >> 4];
+            line[pos++] = hex[copy.data[i] & 0x0F];
+        }
+        fwrite(line, 1, pos, fp);
+    }
+    if (open) {
+        fputc('\n', fp);
+    }
+    fflush(fp);
+    return records;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file bench_chunk_encode.c
+ * @brief MQTT 文件分片编码吞吐量基准测试
+ * @details 把一个临时文件按分片上传的方式逐片映射并编码，对比两种格式：
+ *          - hex：file_upload_encode_hex_chunk，兼容旧服务器的 JSON + 十六进制
+ *          - binary：file_upload_encode_binary_chunk，分片头（含 CRC32C）+ 原始数据
+ *          输出源数据吞吐量（MB/s）和编码后相对原始数据的膨胀比
+ *
+ * 用法：./bench_chunk_encode [分片大小] [文件 MB 数] [重复次数]
+ */
+
+#include "mqtt_file_upload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief 获取当前时间（秒）
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 生成指定大小的临时文件
+ * @param path 输出参数，mkstemp 模板
+ * @param size 文件大小
+ * @return 成功返回0
+ */
+static int make_temp_file(char *path, size_t size) {
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    uint8_t block[4096];
+    uint32_t x = 0x12345678;
+    for (size_t written = 0; written < size; ) {
+        for (size_t i = 0; i < sizeof(block); i++) {
+            x = x * 1103515245 + 12345;
+            block[i] = (uint8_t)(x >> 16);
+        }
+        size_t n = size - written < sizeof(block) ? size - written : sizeof(block);
+        if (write(fd, block, n) != (ssize_t)n) {
+            perror("write");
+            close(fd);
+            return -1;
+        }
+        written += n;
+    }
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t chunk_size = argc > 1 ? (uint32_t)atoi(argv[1]) : 16 * 1024;
+    size_t file_mb = argc > 2 ? (size_t)atoi(argv[2]) : 8;
+    int repeat = argc > 3 ? atoi(argv[3]) : 8;
+    if (chunk_size == 0 || file_mb == 0 || repeat <= 0) {
+        fprintf(stderr, "用法: %s [分片大小] [文件 MB 数] [重复次数]\n", argv[0]);
+        return 1;
+    }
+
+    char path[] = "/tmp/bench_chunk_XXXXXX";
+    if (make_temp_file(path, file_mb * 1024 * 1024) != 0) {
+        return 1;
+    }
+    // file_upload_start 负责打开并映射文件，之后分片直接从映射区编码
+    file_upload_context_t *ctx = file_upload_create(path, chunk_size);
+    if (ctx == NULL || !file_upload_start(ctx)) {
+        fprintf(stderr, "failed to start upload of %s\n", path);
+        file_upload_destroy(ctx);
+        unlink(path);
+        return 1;
+    }
+
+    // 与上传流程相同的缓冲区大小：hex 编码需要两倍数据量加 JSON 前缀
+    size_t buffer_size = (size_t)chunk_size * 2 + 256;
+    uint8_t *buffer = (uint8_t *)malloc(buffer_size);
+    if (buffer == NULL) {
+        file_upload_destroy(ctx);
+        unlink(path);
+        return 1;
+    }
+
+    printf("chunk encode: %u byte chunks, %zu MB file, %u chunks x %d\n",
+           chunk_size, file_mb, ctx->total_chunks, repeat);
+
+    int ret = 0;
+    for (int format = 0; format < 2 && ret == 0; format++) {
+        uint64_t in_bytes = 0;
+        uint64_t out_bytes = 0;
+        double start = now_sec();
+        for (int r = 0; r < repeat && ret == 0; r++) {
+            for (uint32_t chunk = 0; chunk < ctx->total_chunks; chunk++) {
+                const uint8_t *data = NULL;
+                size_t len = 0;
+                if (!file_upload_map_chunk(ctx, chunk, &data, &len)) {
+                    fprintf(stderr, "chunk %u not mapped\n", chunk);
+                    ret = 1;
+                    break;
+                }
+                size_t n = format == 0
+                    ? file_upload_encode_hex_chunk(ctx, chunk, data, len, (char *)buffer, buffer_size)
+                    : file_upload_encode_binary_chunk(ctx, chunk, data, len, buffer, buffer_size);
+                if (n == 0) {
+                    fprintf(stderr, "chunk %u: buffer too small\n", chunk);
+                    ret = 1;
+                    break;
+                }
+                in_bytes += len;
+                out_bytes += n;
+            }
+        }
+        double elapsed = now_sec() - start;
+        if (ret != 0) {
+            break;
+        }
+        printf("  %-8s %8.1f MB/s  %5.2fx on the wire\n", format == 0 ? "hex" : "binary",
+               in_bytes / (1024.0 * 1024.0) / elapsed, (double)out_bytes / (double)in_bytes);
+    }
+
+    free(buffer);
+    file_upload_destroy(ctx);
+    unlink(path);
+    return ret;
+}
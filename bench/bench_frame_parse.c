@@ -0,0 +1,231 @@
+/**
+ * @file bench_frame_parse.c
+ * @brief 帧解析吞吐量基准测试
+ * @details 构造混合长度的帧流（夹杂少量无效字节），按串口读取大小分块喂入，对比：
+ *          - legacy：线性缓冲区 + air8000_frame_parse（每帧 malloc/memcpy）+ memmove 压缩，
+ *            遇到无效帧头逐字节移动（与原 I/O 线程一致）
+ *          - ring：air8000_rx_ring_t + air8000_rx_ring_next_frame 零拷贝视图，memchr 重同步
+ *          另外测量 air8000_frame_encode 编码同样帧序列的吞吐量
+ *
+ * 用法：./bench_frame_parse [帧数] [分块大小]
+ */
+
+#include "air8000_protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief 旧实现的接收缓冲区大小（与原 MAX_RX_BUFFER 相同）
+ */
+#define LEGACY_RX_BUFFER 4096
+
+/**
+ * @brief 测试重复轮数
+ */
+#define BENCH_ROUNDS 20
+
+/**
+ * @brief 获取当前时间（秒）
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 构造测试帧流
+ * @param frame_count 帧数
+ * @param out_len 输出流长度
+ * @return 帧流缓冲区，调用者释放
+ */
+static uint8_t *build_stream(int frame_count, size_t *out_len) {
+    /* 典型负载：ACK、电机状态、传感器数据、1KB 文件分片 */
+    static const uint16_t sizes[] = {0, 8, 64, 1036};
+    size_t cap = (size_t)frame_count * (AIR8000_MIN_FRAME + 1036 + 8);
+    uint8_t *stream = (uint8_t *)malloc(cap);
+    uint8_t payload[1036];
+    size_t len = 0;
+
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 7);
+    }
+    srand(1);
+
+    for (int i = 0; i < frame_count; i++) {
+        /* 每 16 帧插入几个无效字节，模拟线路噪声 */
+        if (i % 16 == 0) {
+            int junk = 3 + rand() % 5;
+            for (int j = 0; j < junk; j++) {
+                stream[len++] = (uint8_t)(0x10 + j);
+            }
+        }
+
+        air8000_frame_t frame;
+        air8000_frame_init(&frame);
+        frame.type = FRAME_TYPE_RESPONSE;
+        frame.seq = (uint8_t)i;
+        frame.cmd = CMD_FILE_TRANSFER_DATA;
+        frame.data_len = sizes[i % 4];
+        frame.data = frame.data_len ? payload : NULL;
+        len += air8000_frame_encode(&frame, stream + len, cap - len);
+    }
+
+    *out_len = len;
+    return stream;
+}
+
+/**
+ * @brief 编码与 build_stream 相同的帧序列（不含噪声字节）
+ * @param out 输出缓冲区
+ * @param cap 缓冲区大小
+ * @param frame_count 帧数
+ * @return 编码的总字节数
+ */
+static size_t run_encode(uint8_t *out, size_t cap, int frame_count) {
+    static const uint16_t sizes[] = {0, 8, 64, 1036};
+    static uint8_t payload[1036];
+    size_t len = 0;
+
+    for (int i = 0; i < frame_count; i++) {
+        air8000_frame_t frame;
+        air8000_frame_init(&frame);
+        frame.type = FRAME_TYPE_RESPONSE;
+        frame.seq = (uint8_t)i;
+        frame.cmd = CMD_FILE_TRANSFER_DATA;
+        frame.data_len = sizes[i % 4];
+        frame.data = frame.data_len ? payload : NULL;
+        int n = air8000_frame_encode(&frame, out + len, cap - len);
+        if (n > 0) {
+            len += (size_t)n;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief 旧实现：线性缓冲区 + malloc 解析 + memmove
+ * @return 解析出的帧数
+ */
+static long run_legacy(const uint8_t *stream, size_t len, size_t chunk) {
+    static uint8_t rx_buffer[LEGACY_RX_BUFFER];
+    size_t rx_len = 0;
+    long frames = 0;
+    volatile uint8_t sink = 0;
+
+    for (size_t pos = 0; pos < len; ) {
+        size_t n = len - pos;
+        if (n > chunk) n = chunk;
+        if (n > LEGACY_RX_BUFFER - rx_len) n = LEGACY_RX_BUFFER - rx_len;
+        memcpy(&rx_buffer[rx_len], stream + pos, n);
+        rx_len += n;
+        pos += n;
+
+        while (rx_len > 0) {
+            air8000_frame_t frame;
+            air8000_frame_init(&frame);
+            int frame_len = air8000_frame_parse(rx_buffer, rx_len, &frame);
+            if (frame_len > 0) {
+                frames++;
+                if (frame.data_len) sink ^= frame.data[frame.data_len - 1];
+                air8000_frame_cleanup(&frame);
+                memmove(rx_buffer, &rx_buffer[frame_len], rx_len - frame_len);
+                rx_len -= frame_len;
+            } else if (frame_len == -2) {
+                memmove(rx_buffer, &rx_buffer[1], rx_len - 1);
+                rx_len--;
+            } else {
+                break;
+            }
+        }
+    }
+    (void)sink;
+    return frames;
+}
+
+/**
+ * @brief 新实现：环形缓冲区 + 零拷贝视图
+ * @return 解析出的帧数
+ */
+static long run_ring(air8000_rx_ring_t *ring, const uint8_t *stream, size_t len, size_t chunk) {
+    long frames = 0;
+    volatile uint8_t sink = 0;
+
+    air8000_rx_ring_init(ring);
+    for (size_t pos = 0; pos < len; ) {
+        size_t space;
+        uint8_t *wptr = air8000_rx_ring_write_ptr(ring, &space);
+        size_t n = len - pos;
+        if (n > chunk) n = chunk;
+        if (n > space) n = space;
+        memcpy(wptr, stream + pos, n);
+        air8000_rx_ring_commit(ring, n);
+        pos += n;
+
+        air8000_frame_t frame;
+        while (air8000_rx_ring_next_frame(ring, &frame) > 0) {
+            frames++;
+            if (frame.data_len) sink ^= frame.data[frame.data_len - 1];
+        }
+    }
+    (void)sink;
+    return frames;
+}
+
+int main(int argc, char *argv[]) {
+    int frame_count = argc > 1 ? atoi(argv[1]) : 20000;
+    size_t chunk = argc > 2 ? (size_t)atoi(argv[2]) : 256;
+    if (frame_count <= 0 || chunk == 0) {
+        fprintf(stderr, "用法: %s [帧数] [分块大小]\n", argv[0]);
+        return 1;
+    }
+
+    size_t len;
+    uint8_t *stream = build_stream(frame_count, &len);
+    air8000_rx_ring_t *ring = (air8000_rx_ring_t *)malloc(sizeof(air8000_rx_ring_t));
+
+    printf("frame parse: %d frames, %zu bytes, chunk %zu, %d rounds\n",
+           frame_count, len, chunk, BENCH_ROUNDS);
+
+    long legacy_frames = 0, ring_frames = 0;
+    double t0 = now_sec();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        legacy_frames = run_legacy(stream, len, chunk);
+    }
+    double t_legacy = now_sec() - t0;
+
+    t0 = now_sec();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        ring_frames = run_ring(ring, stream, len, chunk);
+    }
+    double t_ring = now_sec() - t0;
+
+    double mb = (double)len * BENCH_ROUNDS / (1024.0 * 1024.0);
+    printf("  %-8s %8ld frames  %9.1f MB/s  %10.0f frames/s\n", "legacy",
+           legacy_frames, mb / t_legacy, legacy_frames * BENCH_ROUNDS / t_legacy);
+    printf("  %-8s %8ld frames  %9.1f MB/s  %10.0f frames/s\n", "ring",
+           ring_frames, mb / t_ring, ring_frames * BENCH_ROUNDS / t_ring);
+    printf("  speedup  %.2fx\n", t_legacy / t_ring);
+
+    uint8_t *encoded = (uint8_t *)malloc(len);
+    size_t encoded_len = 0;
+    t0 = now_sec();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        encoded_len = run_encode(encoded, len, frame_count);
+    }
+    double t_encode = now_sec() - t0;
+    printf("  %-8s %8d frames  %9.1f MB/s  %10.0f frames/s\n", "encode", frame_count,
+           (double)encoded_len * BENCH_ROUNDS / (1024.0 * 1024.0) / t_encode,
+           (double)frame_count * BENCH_ROUNDS / t_encode);
+    free(encoded);
+
+    free(ring);
+    free(stream);
+    if (legacy_frames != frame_count || ring_frames != frame_count) {
+        fprintf(stderr, "frame count mismatch: expected %d\n", frame_count);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file bench_image.c
+ * @brief 图像测量流水线基准测试
+ * @details 对一个目录下的抓拍图片（jpg/jpeg/png/bmp）逐张调用 imageproc_process_file，
+ *          按 imageproc_get_timing 分别统计解码和测量耗时，对比两种测量配置：
+ *          - full：整帧处理、单条测量线（默认选项）
+ *          - band：条带模式，三条测量线、条带半高 16 行
+ *          输出各阶段 avg/p50/p99 耗时和每秒处理的图片数
+ *
+ * 用法：./bench_image <图片目录> [每张重复次数]
+ * @note 需要先在 ../Image_Process 下执行 make lib，并用 make bench_image 构建
+ */
+
+#include "imageproc.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/**
+ * @brief 语料目录中最多读取的图片数
+ */
+#define BENCH_MAX_IMAGES 1024
+
+/**
+ * @brief 获取当前时间（秒）
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief qsort 比较函数
+ */
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * @brief 打印一个阶段的耗时统计
+ * @param name 阶段名称
+ * @param us 耗时样本（微秒，会被排序）
+ * @param n 样本数
+ */
+static void print_stage(const char *name, uint32_t *us, int n) {
+    qsort(us, (size_t)n, sizeof(us[0]), compare_u32);
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += us[i];
+    }
+    printf("    %-8s avg %8.2f ms  p50 %8.2f ms  p99 %8.2f ms\n", name,
+           sum / 1000.0 / n, us[n / 2] / 1000.0, us[(int)(n * 0.99)] / 1000.0);
+}
+
+/**
+ * @brief 判断文件名是否为支持的图片格式
+ */
+static int is_image(const char *name) {
+    const char *ext = strrchr(name, '.');
+    return ext != NULL && (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0 ||
+                           strcasecmp(ext, ".png") == 0 || strcasecmp(ext, ".bmp") == 0);
+}
+
+/**
+ * @brief qsort 比较函数（路径按字典序，保证每次运行顺序一致）
+ */
+static int compare_path(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief 用一种配置处理整个语料
+ * @param name 配置名称
+ * @param opts 上下文选项
+ * @param paths 图片路径
+ * @param count 图片数
+ * @param repeat 每张重复次数
+ * @return 成功返回0
+ */
+static int bench_config(const char *name, const imageproc_options_t *opts,
+                        char **paths, int count, int repeat) {
+    imageproc_t *ctx = imageproc_create(opts);
+    if (ctx == NULL) {
+        fprintf(stderr, "%s: imageproc_create failed\n", name);
+        return -1;
+    }
+
+    int total = count * repeat;
+    uint32_t *decode = (uint32_t *)malloc((size_t)total * sizeof(uint32_t));
+    uint32_t *measure = (uint32_t *)malloc((size_t)total * sizeof(uint32_t));
+    int n = 0;
+    int failed = 0;
+    long paragraphs = 0;
+    double start = now_sec();
+    for (int r = 0; r < repeat; r++) {
+        for (int i = 0; i < count; i++) {
+            if (imageproc_process_file(ctx, paths[i], NULL) != 0) {
+                failed++;
+                continue;
+            }
+            imageproc_timing_t timing;
+            imageproc_get_timing(ctx, &timing);
+            decode[n] = timing.decode_us;
+            measure[n] = timing.measure_us;
+            paragraphs += imageproc_get_paragraph_count(ctx);
+            n++;
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    printf("  %s: %d images, %d failed, %.1f paragraphs/image, %.1f images/s\n", name, n, failed,
+           n > 0 ? (double)paragraphs / n : 0.0, n / elapsed);
+    if (n > 0) {
+        print_stage("decode", decode, n);
+        print_stage("measure", measure, n);
+    }
+
+    free(decode);
+    free(measure);
+    imageproc_destroy(ctx);
+    return n > 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "用法: %s <图片目录> [每张重复次数]\n", argv[0]);
+        return 1;
+    }
+    int repeat = argc > 2 ? atoi(argv[2]) : 3;
+    if (repeat <= 0) {
+        repeat = 1;
+    }
+
+    DIR *dir = opendir(argv[1]);
+    if (dir == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    char *paths[BENCH_MAX_IMAGES];
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < BENCH_MAX_IMAGES) {
+        if (!is_image(entry->d_name)) {
+            continue;
+        }
+        size_t len = strlen(argv[1]) + strlen(entry->d_name) + 2;
+        paths[count] = (char *)malloc(len);
+        snprintf(paths[count], len, "%s/%s", argv[1], entry->d_name);
+        count++;
+    }
+    closedir(dir);
+    if (count == 0) {
+        fprintf(stderr, "no images in %s\n", argv[1]);
+        return 1;
+    }
+    qsort(paths, (size_t)count, sizeof(paths[0]), compare_path);
+
+    printf("image pipeline: %d images x %d, kernel %s\n", count, repeat, imageproc_backend_name());
+
+    imageproc_options_t full;
+    imageproc_default_options(&full);
+
+    imageproc_options_t band;
+    imageproc_default_options(&band);
+    band.measure.band_half_height = 16;
+    band.measure.line_count = 3;
+    band.measure.line_pos[0] = 0.25f;
+    band.measure.line_pos[1] = 0.50f;
+    band.measure.line_pos[2] = 0.75f;
+
+    int ret = 0;
+    ret |= bench_config("full", &full, paths, count, repeat);
+    ret |= bench_config("band", &band, paths, count, repeat);
+
+    for (int i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,283 @@
+/**
+ * @file bench_ipc.c
+ * @brief 进程间通信往返延迟基准测试
+ * @details fork 出回显进程，测量一条消息发出到收到回显的往返时间：
+ *          - sysv / shm-ring：mq_send_msg + mq_receive_msg，分别测小消息和满负载消息，
+ *            以及带超时接收（各子进程实际使用的方式，System V 队列此时按 5ms 间隔轮询）
+ *          - shm-seg：共享内存池段队列（申请段 + 写入 + shm_seg_push，对端 shm_seg_pop 读完释放后回一条确认消息）
+ *          输出每种方式的 avg/p50/p99 往返时间和消息速率
+ *
+ * 用法：./bench_ipc [往返次数] [段大小]
+ * @note 使用正式的消息队列和共享内存键值，不要在进程管理器运行时执行
+ */
+
+#include "message_queue.h"
+#include "shared_memory.h"
+#include "pm_metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+
+/**
+ * @brief 通知回显进程退出的序列号
+ */
+#define BENCH_STOP_SEQ 0xFFFFFFFFU
+
+/**
+ * @brief 带超时接收测试的最大往返次数（System V 队列每次约 5ms）
+ */
+#define BENCH_TIMED_ROUNDS 200
+
+/**
+ * @brief 获取当前时间（纳秒）
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief qsort 比较函数
+ */
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * @brief 打印往返时间统计
+ * @param name 测试名称
+ * @param rtt 往返时间（纳秒，会被排序）
+ * @param n 样本数
+ * @param total_ns 总耗时
+ */
+static void print_rtt(const char *name, uint64_t *rtt, int n, uint64_t total_ns) {
+    qsort(rtt, (size_t)n, sizeof(rtt[0]), compare_u64);
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += rtt[i];
+    }
+    printf("  %-22s avg %7.1f us  p50 %7.1f us  p99 %7.1f us  %9.0f round trips/s\n", name,
+           sum / 1000.0 / n, rtt[n / 2] / 1000.0, rtt[(int)(n * 0.99)] / 1000.0,
+           n * 1e9 / (double)total_ns);
+}
+
+/**
+ * @brief 回显进程：从 MQTT→UART 队列收消息，原样发回 UART→MQTT 队列
+ */
+static void echo_loop(int rx, int tx) {
+    message_t msg;
+    for (;;) {
+        if (mq_receive_msg(rx, &msg, NULL, -1) != 0) {
+            continue;
+        }
+        if (msg.seq_num == BENCH_STOP_SEQ) {
+            break;
+        }
+        mq_send_msg(tx, &msg, 0);
+    }
+}
+
+/**
+ * @brief 段消费进程：从池内队列取段，读完整段数据后释放，并在 UART→MQTT 队列回一条确认
+ * @details 长度为0的段表示测试结束
+ */
+static void segment_loop(shm_handle_t *shm, int tx) {
+    message_t ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.type = MSG_TYPE_FILE_ACK;
+    volatile uint8_t sink = 0;
+    for (;;) {
+        uint32_t seg;
+        if (shm_seg_pop(shm, -1, &seg) != 0) {
+            continue;
+        }
+        size_t len = shm_seg_len(shm, seg);
+        const uint8_t *data = shm_seg_data(shm, seg, NULL);
+        if (data != NULL) {
+            for (size_t i = 0; i < len; i += 64) {
+                sink ^= data[i];
+            }
+        }
+        shm_seg_release(shm, seg);
+        if (len == 0) {
+            break;
+        }
+        mq_send_msg(tx, &ack, 0);
+        ack.seq_num++;
+    }
+    (void)sink;
+}
+
+/**
+ * @brief 一种传输方式的往返测试
+ * @param transport 传输方式
+ * @param name 测试名称
+ * @param rounds 往返次数
+ * @return 成功返回0
+ */
+static int bench_transport(mq_transport_t transport, const char *name, int rounds) {
+    mq_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.transport = transport;
+    int to_uart = mq_create(MSG_QUEUE_MQTT_TO_UART, &config);
+    int to_mqtt = mq_create(MSG_QUEUE_UART_TO_MQTT, &config);
+    if (to_uart == -1 || to_mqtt == -1) {
+        fprintf(stderr, "%s: failed to create queues\n", name);
+        return -1;
+    }
+
+    // 清掉上次运行残留的 System V 消息
+    message_t msg;
+    while (mq_receive_msg(to_uart, &msg, NULL, 0) == 0) {
+    }
+    while (mq_receive_msg(to_mqtt, &msg, NULL, 0) == 0) {
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        echo_loop(to_uart, to_mqtt);
+        _exit(0);
+    }
+
+    // 阻塞接收分别测小消息和满负载消息，最后一项用带超时接收测小消息
+    static const size_t sizes[] = { 16, sizeof(((message_t *)0)->payload.data), 16 };
+    static const int timeouts[] = { -1, -1, 1000 };
+    uint64_t *rtt = (uint64_t *)malloc((size_t)rounds * sizeof(uint64_t));
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = timeouts[s] == -1 || rounds < BENCH_TIMED_ROUNDS ? rounds : BENCH_TIMED_ROUNDS;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = MSG_TYPE_SENSOR_DATA;
+        msg.data_len = sizes[s];
+        memset(msg.payload.data, 0x5A, msg.data_len);
+
+        uint64_t start = now_ns();
+        for (int i = 0; i < n; i++) {
+            uint64_t t0 = now_ns();
+            msg.seq_num = (uint32_t)i;
+            mq_send_msg(to_uart, &msg, 0);
+            message_t echo;
+            while (mq_receive_msg(to_mqtt, &echo, NULL, timeouts[s]) != 0) {
+            }
+            rtt[i] = now_ns() - t0;
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "%s/%zuB%s", name, sizes[s], timeouts[s] == -1 ? "" : "/timed");
+        print_rtt(label, rtt, n, now_ns() - start);
+    }
+
+    msg.seq_num = BENCH_STOP_SEQ;
+    mq_send_msg(to_uart, &msg, 0);
+    waitpid(child, NULL, 0);
+    free(rtt);
+
+    mq_close_queue(to_uart);
+    mq_close_queue(to_mqtt);
+    mq_delete_queue(MSG_QUEUE_MQTT_TO_UART);
+    mq_delete_queue(MSG_QUEUE_UART_TO_MQTT);
+    return 0;
+}
+
+/**
+ * @brief 共享内存池段队列往返测试
+ * @param rounds 往返次数
+ * @param seg_size 每个段写入的数据量
+ * @return 成功返回0
+ */
+static int bench_segments(int rounds, size_t seg_size) {
+    shm_handle_t shm;
+    if (shm_create(&shm) != 0) {
+        fprintf(stderr, "shm-seg: failed to create pool\n");
+        return -1;
+    }
+    mq_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.transport = MQ_TRANSPORT_SHM_RING;
+    int to_mqtt = mq_create(MSG_QUEUE_UART_TO_MQTT, &config);
+    if (to_mqtt == -1) {
+        fprintf(stderr, "shm-seg: failed to create queue\n");
+        shm_destroy(&shm);
+        return -1;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        shm_handle_t peer;
+        if (shm_open_existing(&peer) != 0) {
+            _exit(1);
+        }
+        segment_loop(&peer, to_mqtt);
+        shm_close(&peer);
+        _exit(0);
+    }
+
+    uint64_t *rtt = (uint64_t *)malloc((size_t)rounds * sizeof(uint64_t));
+    int done = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < rounds; i++) {
+        uint64_t t0 = now_ns();
+        uint32_t seg;
+        if (shm_seg_alloc(&shm, seg_size, 1000, &seg) != 0) {
+            fprintf(stderr, "shm-seg: alloc of %zu bytes failed\n", seg_size);
+            break;
+        }
+        size_t cap = 0;
+        uint8_t *data = shm_seg_data(&shm, seg, &cap);
+        memset(data, (int)(i & 0xFF), seg_size);
+        shm_seg_set_len(&shm, seg, seg_size);
+        shm_seg_push(&shm, seg);
+        message_t echo;
+        while (mq_receive_msg(to_mqtt, &echo, NULL, -1) != 0) {
+        }
+        rtt[i] = now_ns() - t0;
+        done++;
+    }
+    if (done > 0) {
+        uint64_t total = now_ns() - start;
+        char label[32];
+        snprintf(label, sizeof(label), "shm-seg/%zuKB", seg_size / 1024);
+        print_rtt(label, rtt, done, total);
+        printf("  %-22s %.1f MB/s\n", "", (double)seg_size * done / (1024.0 * 1024.0) / (total / 1e9));
+    }
+
+    // 空段通知消费进程退出
+    uint32_t stop;
+    if (shm_seg_alloc(&shm, 1, 1000, &stop) == 0) {
+        shm_seg_push(&shm, stop);
+    }
+    waitpid(child, NULL, 0);
+    free(rtt);
+
+    mq_close_queue(to_mqtt);
+    mq_delete_queue(MSG_QUEUE_UART_TO_MQTT);
+    shm_destroy(&shm);
+    return done == rounds ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    size_t seg_size = argc > 2 ? (size_t)atoi(argv[2]) : 64 * 1024;
+    if (rounds <= 0 || seg_size == 0) {
+        fprintf(stderr, "用法: %s [往返次数] [段大小]\n", argv[0]);
+        return 1;
+    }
+
+    // 进程管理器运行时会创建指标共享内存，此时不能占用正式的队列
+    if (shmget(PM_METRICS_KEY, 0, 0) != -1) {
+        fprintf(stderr, "process manager appears to be running, stop it before running %s\n", argv[0]);
+        return 1;
+    }
+
+    printf("ipc round trip: %d rounds\n", rounds);
+    int ret = 0;
+    ret |= bench_transport(MQ_TRANSPORT_SYSV, "sysv", rounds);
+    ret |= bench_transport(MQ_TRANSPORT_SHM_RING, "shm-ring", rounds);
+    ret |= bench_segments(rounds, seg_size);
+    return ret ? 1 : 0;
+}
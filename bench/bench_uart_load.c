@@ -0,0 +1,235 @@
+/**
+ * @file bench_uart_load.c
+ * @brief 串口异步/流水线路径负载测试
+ * @details 启动 fake_air8000（伪终端模拟设备），用完整的 UART SDK 连接其从端，测量：
+ *          - sync：air8000_ping 逐条同步请求
+ *          - async/wN：air8000_send_async 流水线提交，窗口 N 分别为 1/4/16/64
+ *          每种方式按小请求和 1KB 负载请求各测一次，输出请求速率和 avg/p50/p99 往返时间。
+ *          fake_air8000 的参数原样透传，可用 -t 重放录制的串口跟踪、-b 模拟真实波特率
+ *
+ * 用法：./bench_uart_load [请求数] [fake_air8000 参数...]
+ */
+
+#include "air8000.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * @brief 单个请求超时（毫秒）
+ */
+#define BENCH_TIMEOUT_MS 2000
+
+/**
+ * @brief 请求往返记录，回调在 I/O 线程中写入
+ */
+typedef struct {
+    uint64_t *start_ns;    // 提交时间
+    uint64_t *rtt_ns;      // 往返时间
+    int failed;            // 失败请求数（只在 I/O 线程中修改）
+} bench_run_t;
+
+/**
+ * @brief 获取当前时间（纳秒）
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief qsort 比较函数
+ */
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * @brief 打印往返时间统计
+ * @param name 测试名称
+ * @param rtt 往返时间（纳秒，会被排序）
+ * @param n 样本数
+ * @param failed 失败请求数
+ * @param total_ns 总耗时
+ */
+static void print_rtt(const char *name, uint64_t *rtt, int n, int failed, uint64_t total_ns) {
+    qsort(rtt, (size_t)n, sizeof(rtt[0]), compare_u64);
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += rtt[i];
+    }
+    printf("  %-16s %8.0f req/s  avg %8.1f us  p50 %8.1f us  p99 %8.1f us  %d failed\n", name,
+           n * 1e9 / (double)total_ns, sum / 1000.0 / n, rtt[n / 2] / 1000.0,
+           rtt[(int)(n * 0.99)] / 1000.0, failed);
+}
+
+/**
+ * @brief 异步请求完成回调
+ */
+static void on_complete(air8000_t *ctx, int result, const air8000_frame_t *req,
+                        const air8000_frame_t *resp, void *user_data) {
+    (void)ctx;
+    (void)req;
+    bench_run_t *run = (bench_run_t *)((void **)user_data)[0];
+    int index = (int)(intptr_t)((void **)user_data)[1];
+    free(user_data);
+    if (result != AIR8000_OK || resp == NULL || resp->type == FRAME_TYPE_NACK) {
+        run->failed++;
+        run->rtt_ns[index] = 0;
+        return;
+    }
+    run->rtt_ns[index] = now_ns() - run->start_ns[index];
+}
+
+/**
+ * @brief 同步逐条请求
+ * @return 成功返回0
+ */
+static int bench_sync(air8000_t *ctx, int count, bench_run_t *run) {
+    int n = 0;
+    run->failed = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; i++) {
+        uint64_t t0 = now_ns();
+        if (air8000_ping(ctx, BENCH_TIMEOUT_MS) != 0) {
+            run->failed++;
+            continue;
+        }
+        run->rtt_ns[n++] = now_ns() - t0;
+    }
+    if (n == 0) {
+        return -1;
+    }
+    print_rtt("sync/ping", run->rtt_ns, n, run->failed, now_ns() - start);
+    return 0;
+}
+
+/**
+ * @brief 异步流水线请求
+ * @param payload 请求负载，可为NULL
+ * @param payload_len 负载长度
+ * @return 成功返回0
+ */
+static int bench_async(air8000_t *ctx, int count, int window, const uint8_t *payload,
+                       size_t payload_len, bench_run_t *run) {
+    air8000_set_async_window(ctx, window);
+    memset(run->rtt_ns, 0, (size_t)count * sizeof(uint64_t));
+    run->failed = 0;
+    int submitted = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; i++) {
+        air8000_frame_t req;
+        air8000_build_request(&req, CMD_SYS_PING, payload, payload_len);
+        void **user = (void **)malloc(2 * sizeof(void *));
+        user[0] = run;
+        user[1] = (void *)(intptr_t)i;
+        run->start_ns[i] = now_ns();
+        int ret = air8000_send_async(ctx, &req, on_complete, user, BENCH_TIMEOUT_MS);
+        air8000_frame_cleanup(&req);
+        if (ret != 0) {
+            free(user);
+            break;
+        }
+        submitted++;
+    }
+    air8000_async_drain(ctx, BENCH_TIMEOUT_MS * 2);
+    uint64_t total = now_ns() - start;
+
+    // 只统计成功的请求
+    int n = 0;
+    for (int i = 0; i < submitted; i++) {
+        if (run->rtt_ns[i] != 0) {
+            run->rtt_ns[n++] = run->rtt_ns[i];
+        }
+    }
+    if (n == 0) {
+        return -1;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "async/w%d%s", window, payload_len ? "/1KB" : "");
+    print_rtt(label, run->rtt_ns, n, run->failed + (count - submitted), total);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int count = argc > 1 ? atoi(argv[1]) : 5000;
+    if (count <= 0) {
+        fprintf(stderr, "用法: %s [请求数] [fake_air8000 参数...]\n", argv[0]);
+        return 1;
+    }
+
+    // 启动模拟设备，第一行输出为伪终端从端路径
+    int pipefd[2];
+    if (pipe(pipefd) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t fake_pid = fork();
+    if (fake_pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        // 请求数之后的参数原样传给 fake_air8000
+        char **fake_argv = (char **)calloc((size_t)argc + 1, sizeof(char *));
+        fake_argv[0] = "./fake_air8000";
+        for (int i = 2; i < argc; i++) {
+            fake_argv[i - 1] = argv[i];
+        }
+        execv(fake_argv[0], fake_argv);
+        perror("./fake_air8000");
+        _exit(127);
+    }
+    close(pipefd[1]);
+    FILE *fake = fdopen(pipefd[0], "r");
+    char pty[256];
+    if (fake_pid < 0 || fake == NULL || fgets(pty, sizeof(pty), fake) == NULL) {
+        fprintf(stderr, "failed to start fake_air8000\n");
+        if (fake_pid > 0) {
+            kill(fake_pid, SIGTERM);
+            waitpid(fake_pid, NULL, 0);
+        }
+        return 1;
+    }
+    pty[strcspn(pty, "\n")] = '\0';
+
+    air8000_t *ctx = air8000_init(pty);
+    if (ctx == NULL) {
+        fprintf(stderr, "air8000_init(%s) failed\n", pty);
+        kill(fake_pid, SIGTERM);
+        waitpid(fake_pid, NULL, 0);
+        return 1;
+    }
+
+    bench_run_t run;
+    run.start_ns = (uint64_t *)calloc((size_t)count, sizeof(uint64_t));
+    run.rtt_ns = (uint64_t *)calloc((size_t)count, sizeof(uint64_t));
+    uint8_t payload[1024];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)i;
+    }
+
+    printf("uart load: %d requests via %s\n", count, pty);
+    int ret = bench_sync(ctx, count, &run);
+    static const int windows[] = { 1, 4, 16, 64 };
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        ret |= bench_async(ctx, count, windows[w], NULL, 0, &run);
+        ret |= bench_async(ctx, count, windows[w], payload, sizeof(payload), &run);
+    }
+
+    air8000_deinit(ctx);
+    free(run.start_ns);
+    free(run.rtt_ns);
+
+    // 通知模拟设备退出并打印它的统计
+    kill(fake_pid, SIGTERM);
+    waitpid(fake_pid, NULL, 0);
+    fclose(fake);
+    return ret ? 1 : 0;
+}
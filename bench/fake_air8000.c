@@ -0,0 +1,394 @@
+/**
+ * @file fake_air8000.c
+ * @brief 基于伪终端的模拟 Air8000 设备
+ * @details 打开一对伪终端，把从端路径打印到标准输出，之后在主端上扮演 Air8000：
+ *          - 解析上位机发来的请求帧，按相同序列号回复响应
+ *          - 指定 -t 时从 air8000_trace_dump 导出的跟踪文件中取出设备发出的帧，
+ *            按命令码建立响应表，同一命令的多条响应轮流使用；表中没有的命令回复空响应
+ *          - 指定 -n 时按跟踪文件中的时间间隔循环重放设备主动上报的通知帧
+ *          - 指定 -b 时按波特率限速写出，-d 为每条响应额外增加的处理延迟
+ *          收到 SIGINT/SIGTERM 时在标准错误输出收发统计后退出
+ *
+ * 用法：./fake_air8000 [-t 跟踪文件] [-d 响应延迟us] [-b 波特率] [-n]
+ * @note 跟踪文件格式为 air8000_trace_dump 的输出，每行 "[秒.微秒] TX|RX: AA 55 ..."
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include "air8000_protocol.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief 响应表最多记录的命令数
+ */
+#define FAKE_MAX_CMDS 64
+
+/**
+ * @brief 每个命令最多记录的响应条数
+ */
+#define FAKE_MAX_RESPONSES 16
+
+/**
+ * @brief 最多记录的通知帧数
+ */
+#define FAKE_MAX_NOTIFIES 256
+
+/**
+ * @brief 接收缓冲区大小，至少能放下一个最大帧
+ */
+#define FAKE_RX_BUFFER (AIR8000_MIN_FRAME + 65535 + 4096)
+
+/**
+ * @brief 同一命令的录制响应
+ */
+typedef struct {
+    uint16_t cmd;                                  // 命令码
+    int count;                                     // 录制条数
+    int next;                                      // 下一次使用的下标
+    air8000_frame_t frames[FAKE_MAX_RESPONSES];    // 录制的响应帧（深拷贝）
+} fake_response_t;
+
+/**
+ * @brief 录制的通知帧
+ */
+typedef struct {
+    uint64_t offset_us;                            // 相对第一条通知的时间
+    air8000_frame_t frame;                         // 通知帧（深拷贝）
+} fake_notify_t;
+
+static fake_response_t g_responses[FAKE_MAX_CMDS];
+static int g_response_cmds = 0;
+static fake_notify_t g_notifies[FAKE_MAX_NOTIFIES];
+static int g_notify_count = 0;
+static volatile sig_atomic_t g_stop = 0;
+
+/**
+ * @brief 获取当前时间（微秒）
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief 信号处理函数
+ */
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+/**
+ * @brief 查找命令的响应表项
+ * @param cmd 命令码
+ * @param create 不存在时是否创建
+ * @return 表项指针，不存在（或表已满）返回NULL
+ */
+static fake_response_t *find_response(uint16_t cmd, int create) {
+    for (int i = 0; i < g_response_cmds; i++) {
+        if (g_responses[i].cmd == cmd) {
+            return &g_responses[i];
+        }
+    }
+    if (!create || g_response_cmds >= FAKE_MAX_CMDS) {
+        return NULL;
+    }
+    fake_response_t *r = &g_responses[g_response_cmds++];
+    r->cmd = cmd;
+    return r;
+}
+
+/**
+ * @brief 从跟踪文件录制设备发出的帧
+ * @param path 跟踪文件路径
+ * @return 成功返回录制的帧数，失败返回-1
+ * @details 跟踪记录按读写操作划分，一帧可能跨多条 RX 记录，
+ *          因此把所有 RX 字节拼成一条流后再按帧解析，帧的时间取其起始字节所在记录的时间
+ */
+static int load_trace(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    size_t cap = 1 << 20;
+    size_t len = 0;
+    uint8_t *stream = (uint8_t *)malloc(cap);
+    // 每个字节对应的记录时间，用于还原通知帧的间隔
+    uint64_t *stamps = (uint64_t *)malloc(cap * sizeof(uint64_t));
+    char line[8192];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        unsigned long long sec = 0, usec = 0;
+        char dir[4] = {0};
+        int consumed = 0;
+        if (sscanf(line, "[%llu.%llu] %2s:%n", &sec, &usec, dir, &consumed) != 3 || strcmp(dir, "RX") != 0) {
+            continue;
+        }
+        uint64_t ts = (uint64_t)sec * 1000000ULL + usec;
+        const char *p = line + consumed;
+        unsigned int byte;
+        int n;
+        while (sscanf(p, " %2x%n", &byte, &n) == 1) {
+            if (len == cap) {
+                cap *= 2;
+                stream = (uint8_t *)realloc(stream, cap);
+                stamps = (uint64_t *)realloc(stamps, cap * sizeof(uint64_t));
+            }
+            stamps[len] = ts;
+            stream[len++] = (uint8_t)byte;
+            p += n;
+        }
+    }
+    fclose(fp);
+
+    int frames = 0;
+    uint64_t first_notify_us = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        pos += air8000_frame_find_sync(stream + pos, len - pos);
+        air8000_frame_t view;
+        int ret = air8000_frame_parse_view(stream + pos, len - pos, &view);
+        if (ret == -1) {
+            break;  // 文件末尾的残帧
+        }
+        if (ret < 0) {
+            pos++;
+            continue;
+        }
+
+        if (view.type == FRAME_TYPE_NOTIFY) {
+            if (g_notify_count < FAKE_MAX_NOTIFIES) {
+                if (g_notify_count == 0) {
+                    first_notify_us = stamps[pos];
+                }
+                fake_notify_t *n = &g_notifies[g_notify_count++];
+                n->offset_us = stamps[pos] - first_notify_us;
+                air8000_frame_copy(&n->frame, &view);
+                frames++;
+            }
+        } else {
+            fake_response_t *r = find_response(view.cmd, 1);
+            if (r != NULL && r->count < FAKE_MAX_RESPONSES) {
+                air8000_frame_copy(&r->frames[r->count++], &view);
+                frames++;
+            }
+        }
+        pos += (size_t)ret;
+    }
+
+    free(stream);
+    free(stamps);
+    return frames;
+}
+
+/**
+ * @brief 写出一帧，按波特率限速
+ * @param fd 伪终端主端
+ * @param frame 帧
+ * @param baud 波特率，0 表示不限速
+ * @return 成功返回写出的字节数，失败返回-1
+ */
+static int write_frame(int fd, const air8000_frame_t *frame, int baud) {
+    static uint8_t buffer[AIR8000_MIN_FRAME + 65535];
+    int len = air8000_frame_encode(frame, buffer, sizeof(buffer));
+    if (len < 0) {
+        return -1;
+    }
+    for (int off = 0; off < len; ) {
+        ssize_t n = write(fd, buffer + off, (size_t)(len - off));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return -1;
+        }
+        off += (int)n;
+    }
+    if (baud > 0) {
+        // 8N1 每字节 10 位
+        usleep((useconds_t)((uint64_t)len * 10 * 1000000ULL / (uint64_t)baud));
+    }
+    return len;
+}
+
+/**
+ * @brief 回复一个请求
+ * @param fd 伪终端主端
+ * @param req 请求帧
+ * @param baud 波特率
+ * @return 写出的字节数，失败返回-1
+ */
+static int reply(int fd, const air8000_frame_t *req, int baud) {
+    air8000_frame_t resp;
+    fake_response_t *r = find_response(req->cmd, 0);
+    if (r != NULL && r->count > 0) {
+        resp = r->frames[r->next];
+        r->next = (r->next + 1) % r->count;
+    } else {
+        air8000_frame_init(&resp);
+        resp.type = FRAME_TYPE_RESPONSE;
+        resp.cmd = req->cmd;
+    }
+    resp.seq = req->seq;
+    return write_frame(fd, &resp, baud);
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_path = NULL;
+    int delay_us = 0;
+    int baud = 0;
+    int replay_notify = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:d:b:n")) != -1) {
+        switch (opt) {
+        case 't': trace_path = optarg; break;
+        case 'd': delay_us = atoi(optarg); break;
+        case 'b': baud = atoi(optarg); break;
+        case 'n': replay_notify = 1; break;
+        default:
+            fprintf(stderr, "用法: %s [-t 跟踪文件] [-d 响应延迟us] [-b 波特率] [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (trace_path != NULL) {
+        int frames = load_trace(trace_path);
+        if (frames < 0) {
+            return 1;
+        }
+        fprintf(stderr, "fake_air8000: %d frames from %s (%d commands, %d notifies)\n",
+                frames, trace_path, g_response_cmds, g_notify_count);
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    const char *slave_path = ptsname(master);
+    // 自己保持一个从端打开，上位机关闭重连期间主端不会读到 EIO
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror(slave_path);
+        return 1;
+    }
+    struct termios tty;
+    tcgetattr(slave, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(slave, TCSANOW, &tty);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    printf("%s\n", slave_path);
+    fflush(stdout);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    uint8_t *rx = (uint8_t *)malloc(FAKE_RX_BUFFER);
+    size_t rx_len = 0;
+    uint64_t requests = 0;
+    uint64_t bad_bytes = 0;
+    uint64_t tx_bytes = 0;
+    uint64_t notifies = 0;
+    uint64_t notify_base = now_us();
+    int notify_next = 0;
+
+    while (!g_stop) {
+        int timeout_ms = -1;
+        if (replay_notify && g_notify_count > 0) {
+            uint64_t due = notify_base + g_notifies[notify_next].offset_us;
+            uint64_t now = now_us();
+            timeout_ms = due > now ? (int)((due - now + 999) / 1000) : 0;
+        }
+
+        struct pollfd pfd = { .fd = master, .events = POLLIN };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        // 到期的通知帧，一轮放完后从头循环
+        while (replay_notify && g_notify_count > 0 &&
+               now_us() >= notify_base + g_notifies[notify_next].offset_us) {
+            int n = write_frame(master, &g_notifies[notify_next].frame, baud);
+            if (n > 0) {
+                tx_bytes += (uint64_t)n;
+                notifies++;
+            }
+            if (++notify_next == g_notify_count) {
+                notify_next = 0;
+                notify_base = now_us();
+            }
+        }
+
+        if (ready <= 0 || !(pfd.revents & POLLIN)) {
+            continue;
+        }
+        ssize_t n = read(master, rx + rx_len, FAKE_RX_BUFFER - rx_len);
+        if (n <= 0) {
+            continue;
+        }
+        rx_len += (size_t)n;
+
+        size_t pos = 0;
+        while (pos < rx_len) {
+            size_t skip = air8000_frame_find_sync(rx + pos, rx_len - pos);
+            bad_bytes += skip;
+            pos += skip;
+            air8000_frame_t req;
+            int ret = air8000_frame_parse_view(rx + pos, rx_len - pos, &req);
+            if (ret == -1) {
+                break;  // 等待剩余数据
+            }
+            if (ret < 0) {
+                bad_bytes++;
+                pos++;
+                continue;
+            }
+            pos += (size_t)ret;
+            if (req.type != FRAME_TYPE_REQUEST) {
+                continue;  // 上位机的 ACK 等不需要回复
+            }
+            requests++;
+            if (delay_us > 0) {
+                usleep((useconds_t)delay_us);
+            }
+            int written = reply(master, &req, baud);
+            if (written > 0) {
+                tx_bytes += (uint64_t)written;
+            }
+        }
+        memmove(rx, rx + pos, rx_len - pos);
+        rx_len -= pos;
+    }
+
+    fprintf(stderr, "fake_air8000: %llu requests, %llu notifies, %llu bytes sent, %llu bad bytes\n",
+            (unsigned long long)requests, (unsigned long long)notifies,
+            (unsigned long long)tx_bytes, (unsigned long long)bad_bytes);
+    free(rx);
+    close(slave);
+    close(master);
+    return 0;
+}
@@ -1,8 +1,42 @@
+/**
+ * @file camera_capture_hi3516.c
+ * @brief 抓拍程序：单次抓拍 / 常驻抓拍服务
+ * @date 2026-10-14
+ *
+ * 合并原 camera_capture_hi3516_v1 ~ v4，差异改为命令行参数：
+ * - v1：--raw-bits 12 --offline --settle 5000
+ * - v2：--offline
+ * - v3：--offline --settle 4000
+ * - v4：默认参数（10 位 RAW、VI/VPSS 在线、收敛等待 3 秒）
+ *
+ * 每次从头初始化 VB、VI、ISP、VENC 并等待 AE/AWB 收敛需要 3 秒以上。
+ * 使用 -d 以常驻服务方式运行时，管线只初始化一次并保持运行，
+ * 抓拍请求通过 Unix 套接字到达，只需重新启动 JPEG 通道接收一帧并编码，
+ * 耗时约一到两个帧周期。
+ *
+ * 套接字协议（每个连接一个请求）：
+ * - 请求：`SNAP\n`
+ * - 成功：`OK <长度>\n` + JPEG 数据
+ * - 失败：`ERR <原因>\n`
+ *
+ * 不带 -d 运行时先尝试向常驻服务请求抓拍，服务不存在时再在本进程内完成一次抓拍。
+ *
+ * @note 常驻服务独占传感器管线，不能与 webrtc、camera_measure_hi3516 同时运行
+ */
+
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "ot_common.h"
 #include "ot_defines.h"
@@ -19,68 +53,135 @@
 #define DEFAULT_WIDTH 3840
 #define DEFAULT_HEIGHT 2160
 #define DEFAULT_PIPE_ID 0
+#define DEFAULT_RAW_BITS 10
+#define DEFAULT_SETTLE_MS 3000
+#define DEFAULT_SOCKET_PATH "/tmp/camera_capture.sock"
+#define SNAP_TIMEOUT_MS 2000           // 单次抓拍等待编码结果的超时
+#define SNAP_MAX_PACKS 8               // JPEG 单帧的最大包数
+#define CLIENT_IO_TIMEOUT_MS 5000      // 套接字读写超时
+#define REQUEST_MAX_LEN 32
 
 // 使用IMX415传感器
 sample_sns_type g_sns_type = IMX415_MIPI_8M_25FPS_10BIT;
 
+/**
+ * @brief 抓拍管线配置
+ */
+typedef struct {
+    int width;              ///< JPEG 宽度
+    int height;             ///< JPEG 高度
+    int raw_bits;           ///< RAW 位宽（10 或 12）
+    int offline;            ///< 1 表示 VI/VPSS 离线模式，0 表示在线模式
+    int settle_ms;          ///< 启动后等待 AE/AWB 收敛的时间（毫秒）
+} capture_cfg_t;
+
+/**
+ * @brief 抓拍管线运行状态
+ */
+typedef struct {
+    sample_vi_cfg vi_cfg;   ///< VI 配置（停止 VI 时使用）
+    ot_vi_pipe vi_pipe;     ///< VI 管道
+    ot_vi_chn vi_chn;       ///< VI 通道
+    ot_venc_chn venc_chn;   ///< JPEG 编码通道
+    int venc_created;       ///< JPEG 通道是否已创建
+    int venc_bound;         ///< VI → VENC 是否已绑定
+} capture_pipeline_t;
+
+/**
+ * @brief JPEG 缓冲区（常驻服务中复用，只在变大时重新分配）
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} jpeg_buf_t;
+
+static volatile sig_atomic_t g_running = 1;
+
 static struct option long_options[] = {
     {"output", required_argument, 0, 'o'},
     {"width", required_argument, 0, 'w'},
     {"height", required_argument, 0, 'h'},
-    {"help", no_argument, 0, 'h'},
+    {"raw-bits", required_argument, 0, 'b'},
+    {"offline", no_argument, 0, 'O'},
+    {"settle", required_argument, 0, 't'},
+    {"daemon", no_argument, 0, 'd'},
+    {"socket", required_argument, 0, 's'},
+    {"local", no_argument, 0, 'l'},
+    {"help", no_argument, 0, '?'},
     {0, 0, 0, 0}
 };
 
 static void print_usage(const char *prog_name) {
     printf("Usage: %s [options]\n", prog_name);
     printf("Options:\n");
-    printf("  -o, --output <file>    Output file name (default: %s)\n", DEFAULT_OUTPUT_FILE);
+    printf("  -o, --output <file>     Output file name (default: %s)\n", DEFAULT_OUTPUT_FILE);
     printf("  -w, --width <width>     Image width (default: %d)\n", DEFAULT_WIDTH);
     printf("  -h, --height <height>   Image height (default: %d)\n", DEFAULT_HEIGHT);
+    printf("  -b, --raw-bits <10|12>  Sensor RAW bit depth (default: %d)\n", DEFAULT_RAW_BITS);
+    printf("  -O, --offline           Use VI offline / VPSS offline mode (default: online)\n");
+    printf("  -t, --settle <ms>       AE/AWB settle time after start (default: %d)\n", DEFAULT_SETTLE_MS);
+    printf("  -d, --daemon            Keep the pipeline running and serve snapshots\n");
+    printf("  -s, --socket <path>     Snapshot socket path (default: %s)\n", DEFAULT_SOCKET_PATH);
+    printf("  -l, --local             Do not ask a running daemon, always capture in-process\n");
     printf("  -?, --help              Show this help message\n");
 }
 
-int main(int argc, char *argv[]) {
-    char *output_file = DEFAULT_OUTPUT_FILE;
-    int width = DEFAULT_WIDTH;
-    int height = DEFAULT_HEIGHT;
-    int opt;
-    int option_index = 0;
-    
-    // 解析命令行参数
-    while ((opt = getopt_long(argc, argv, "o:w:h:", long_options, &option_index)) != -1) {
-        switch (opt) {
-            case 'o':
-                output_file = optarg;
-                break;
-            case 'w':
-                width = atoi(optarg);
-                break;
-            case 'h':
-                height = atoi(optarg);
-                break;
-            case '?':
-                print_usage(argv[0]);
-                return 0;
-            default:
-                print_usage(argv[0]);
-                return -1;
-        }
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/**
+ * @brief 获取单调时钟（毫秒）
+ */
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+ * @brief 停止抓拍管线并释放所有 MPP 资源
+ *
+ * @param p 管线状态
+ */
+static void pipeline_stop(capture_pipeline_t *p) {
+    if (p->venc_bound) {
+        sample_comm_vi_un_bind_venc(p->vi_pipe, p->vi_chn, p->venc_chn);
+        p->venc_bound = 0;
     }
-    
-    printf("Camera capture program starting...\n");
-    printf("Output file: %s\n", output_file);
-    printf("Resolution: %dx%d\n", width, height);
-    printf("Using sensor: %d\n", g_sns_type);
-    
-    // 1. 系统初始化 - 参考官方快速启动示例
-    printf("Initializing VB...\n");
-    
-    // 定义 VB 参数，参考官方例程，为8MP传感器提供足够的缓冲区
+    if (p->venc_created) {
+        ss_mpi_venc_stop_chn(p->venc_chn);
+        ss_mpi_venc_destroy_chn(p->venc_chn);
+        p->venc_created = 0;
+    }
+    // 停止VI - 这会自动处理ISP停止、传感器注销等所有相关资源释放
+    sample_comm_vi_stop_vi(&p->vi_cfg);
+    sample_comm_sys_exit();
+}
+
+/**
+ * @brief 初始化并启动抓拍管线：VB → VI/ISP → VENC(JPEG)，等待 AE/AWB 收敛
+ *
+ * @param cfg 配置
+ * @param p 输出管线状态
+ * @return int 成功返回0，失败返回-1
+ */
+static int pipeline_start(const capture_cfg_t *cfg, capture_pipeline_t *p) {
+    ot_pixel_format raw_format = cfg->raw_bits == 12 ? OT_PIXEL_FORMAT_RGB_BAYER_12BPP
+                                                     : OT_PIXEL_FORMAT_RGB_BAYER_10BPP;
+    memset(p, 0, sizeof(*p));
+    p->vi_pipe = DEFAULT_PIPE_ID;
+    p->vi_chn = 0;
+    p->venc_chn = 0;
+
+    // 1. 系统初始化
+    printf("Initializing system with VB supplement...\n");
     sample_vb_param vb_param = {
         // raw, yuv, vpss chn1
         .vb_size = {{DEFAULT_WIDTH, DEFAULT_HEIGHT}, {DEFAULT_WIDTH, DEFAULT_HEIGHT}, {720, 480}},
-        .pixel_format = {OT_PIXEL_FORMAT_RGB_BAYER_12BPP, OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420,
+        .pixel_format = {raw_format, OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420,
             OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420},
         .compress_mode = {OT_COMPRESS_MODE_LINE, OT_COMPRESS_MODE_NONE,
             OT_COMPRESS_MODE_NONE},
@@ -88,164 +189,505 @@ int main(int argc, char *argv[]) {
             OT_VIDEO_FORMAT_LINEAR},
         .blk_num = {6, 10, 3} // 增加缓冲区数量以支持8MP传感器
     };
-    
     ot_vb_cfg vb_cfg;
     td_u32 supplement_config = OT_VB_SUPPLEMENT_BNR_MOT_MASK | OT_VB_SUPPLEMENT_MOTION_DATA_MASK;
-    
-    // 获取默认 VB 配置
     sample_comm_sys_get_default_vb_cfg(&vb_param, &vb_cfg);
-    
-    // 使用官方例程的初始化方法
-    printf("Initializing system with VB supplement...\n");
     if (sample_comm_sys_init_with_vb_supplement(&vb_cfg, supplement_config) != TD_SUCCESS) {
         printf("Failed to initialize system with VB supplement\n");
         return -1;
     }
-    
-    printf("System initialized successfully\n");
-    
-    // 2. 设置 VI 和 VPSS 模式
-    if (sample_comm_vi_set_vi_vpss_mode(OT_VI_OFFLINE_VPSS_OFFLINE, OT_VI_AIISP_MODE_DEFAULT) != TD_SUCCESS) {
+
+    // 2. 设置 VI 和 VPSS 模式（在线模式下 4K 传感器时钟配置正确，无竖线和紫边）
+    ot_vi_vpss_mode_type mode = cfg->offline ? OT_VI_OFFLINE_VPSS_OFFLINE : OT_VI_ONLINE_VPSS_ONLINE;
+    if (sample_comm_vi_set_vi_vpss_mode(mode, OT_VI_AIISP_MODE_DEFAULT) != TD_SUCCESS) {
         printf("Failed to set VI VPSS mode\n");
         sample_comm_sys_exit();
         return -1;
     }
-    
-    printf("VI VPSS mode set successfully\n");
-
-    // 3. 获取默认的VI配置 - 这会正确设置所有必要的参数，包括ISP相关配置
-    sample_vi_cfg vi_cfg;
-    sample_comm_vi_get_default_vi_cfg(g_sns_type, &vi_cfg);
-    
-    // 添加VI配置详细日志
-    printf("VI configuration details:\n");
-    printf("Pipe num: %d\n", vi_cfg.bind_pipe.pipe_num);
-    for (int i = 0; i < vi_cfg.bind_pipe.pipe_num; i++) {
-        printf("Pipe %d:\n", vi_cfg.bind_pipe.pipe_id[i]);
-        printf("  Pixel format: %d\n", vi_cfg.pipe_info[i].pipe_attr.pixel_format);
-        printf("  ISP bypass: %d\n", vi_cfg.pipe_info[i].pipe_attr.isp_bypass);
-        printf("  Width: %d, Height: %d\n", vi_cfg.pipe_info[i].pipe_attr.size.width, vi_cfg.pipe_info[i].pipe_attr.size.height);
-        printf("  Compress mode: %d\n", vi_cfg.pipe_info[i].pipe_attr.compress_mode);
-        printf("  Chn num: %d\n", vi_cfg.pipe_info[i].chn_num);
-        for (int j = 0; j < vi_cfg.pipe_info[i].chn_num; j++) {
-            printf("  Chn %d: VI chn %d, Pixel format: %d\n", 
-                j, vi_cfg.pipe_info[i].chn_info[j].vi_chn, 
-                vi_cfg.pipe_info[i].chn_info[j].chn_attr.pixel_format);
-        }
-    }
-    printf("MIPI info: MIPI dev %d\n", vi_cfg.mipi_info.mipi_dev);
-    printf("Sensor info: SNS type %d, Bus ID %d\n", vi_cfg.sns_info.sns_type, vi_cfg.sns_info.bus_id);
-    
-    // 统一VI管道配置，解决边缘偏紫色问题
-    printf("Unifying VI pipe configurations...\n");
-    for (int i = 0; i < vi_cfg.bind_pipe.pipe_num; i++) {
-        // 确保所有管道使用相同的像素格式
-        vi_cfg.pipe_info[i].pipe_attr.pixel_format = OT_PIXEL_FORMAT_RGB_BAYER_10BPP;
-        // 确保所有管道不绕过ISP
-        vi_cfg.pipe_info[i].pipe_attr.isp_bypass = TD_FALSE;
-        // 确保所有管道使用相同的压缩模式
-        vi_cfg.pipe_info[i].pipe_attr.compress_mode = OT_COMPRESS_MODE_LINE;
-        
-        // 统一通道配置
-        for (int j = 0; j < vi_cfg.pipe_info[i].chn_num; j++) {
-            // 确保所有通道使用相同的像素格式
-            vi_cfg.pipe_info[i].chn_info[j].chn_attr.pixel_format = OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420;
-            // 确保所有通道使用相同的压缩模式
-            vi_cfg.pipe_info[i].chn_info[j].chn_attr.compress_mode = OT_COMPRESS_MODE_NONE;
-        }
-    }
-    printf("VI pipe configurations unified\n");
-    
-    // 检查并调整MIPI相关配置
-    printf("Checking and adjusting MIPI configurations...\n");
-    // 确保MIPI设备正确设置
-    vi_cfg.mipi_info.mipi_dev = 0; // 使用默认的MIPI设备0
-    // 确保MIPI通道划分模式正确
-    vi_cfg.mipi_info.divide_mode = LANE_DIVIDE_MODE_0;
-    // MIPI配置已由默认值设置，保持不变
-    printf("MIPI configurations adjusted\n");
-    
-    // 4. 启动VI和ISP - 使用SDK提供的高级封装函数，它会正确处理所有初始化步骤
-    // 包括传感器初始化、MIPI RX启动、ISP注册和初始化等
+
+    // 3. 获取默认的VI配置并统一管道、通道格式
+    sample_comm_vi_get_default_vi_cfg(g_sns_type, &p->vi_cfg);
+    for (int i = 0; i < p->vi_cfg.bind_pipe.pipe_num; i++) {
+        p->vi_cfg.pipe_info[i].pipe_attr.pixel_format = raw_format;
+        p->vi_cfg.pipe_info[i].pipe_attr.isp_bypass = TD_FALSE;
+        p->vi_cfg.pipe_info[i].pipe_attr.compress_mode = OT_COMPRESS_MODE_LINE;
+        for (int j = 0; j < p->vi_cfg.pipe_info[i].chn_num; j++) {
+            p->vi_cfg.pipe_info[i].chn_info[j].chn_attr.pixel_format = OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420;
+            p->vi_cfg.pipe_info[i].chn_info[j].chn_attr.compress_mode = OT_COMPRESS_MODE_NONE;
+        }
+    }
+    p->vi_cfg.mipi_info.mipi_dev = 0;
+    p->vi_cfg.mipi_info.divide_mode = LANE_DIVIDE_MODE_0;
+
+    // 4. 启动VI和ISP（传感器初始化、MIPI RX、ISP 注册等由 SDK 封装完成）
     printf("Initializing sensor and starting VI...\n");
-    if (sample_comm_vi_start_vi(&vi_cfg) != TD_SUCCESS) {
+    if (sample_comm_vi_start_vi(&p->vi_cfg) != TD_SUCCESS) {
         printf("Failed to start VI\n");
         sample_comm_sys_exit();
         return -1;
     }
-    
-    printf("VI started successfully\n");
-    
-    // 6. 捕获图像
-    
-    // 调整ISP处理参数，解决边缘偏紫色问题
-    printf("Adjusting ISP parameters...\n");
-    // 确保ISP使用统一的处理参数
-    // 这里我们依赖ISP的默认配置，它会自动处理整个图像
-    // ISP启动后会自动运行AE和AWB算法，覆盖整个图像
-    printf("ISP parameters adjusted\n");
-    
-    // 5. 绑定VI到VENC，使VENC能够接收图像数据
-    ot_vi_pipe vi_pipe = 0; // 使用默认的pipe 0
-    ot_vi_chn vi_chn = 0;   // 使用默认的chn 0
-    ot_venc_chn venc_chn = 0;
-    
-    // 启动拍照模式 - 使用photo模式替代snap模式
-    ot_size snap_size = {width, height};
-    if (sample_comm_venc_photo_start(venc_chn, &snap_size, TD_FALSE) != TD_SUCCESS) {
+
+    // 5. 创建JPEG通道并绑定VI → VENC；通道平时不接收图像，抓拍时才启动
+    ot_size snap_size = {cfg->width, cfg->height};
+    if (sample_comm_venc_photo_start(p->venc_chn, &snap_size, TD_FALSE) != TD_SUCCESS) {
         printf("Failed to start photo\n");
-        goto cleanup;
+        pipeline_stop(p);
+        return -1;
     }
-    
-    // 绑定VI到VENC，使VENC能够接收图像数据
-    printf("Binding VI to VENC...\n");
-    if (sample_comm_vi_bind_venc(vi_pipe, vi_chn, venc_chn) != TD_SUCCESS) {
+    p->venc_created = 1;
+    ss_mpi_venc_stop_chn(p->venc_chn);
+
+    if (sample_comm_vi_bind_venc(p->vi_pipe, p->vi_chn, p->venc_chn) != TD_SUCCESS) {
         printf("Failed to bind VI to VENC\n");
-        goto cleanup;
-    }
-    printf("VI bound to VENC successfully\n");
-    
-    // 等待VI稳定输出图像数据
-    printf("Waiting for VI to stabilize...\n");
-    usleep(1000000); // 延迟1秒，让VI有足够的时间输出图像
-    
-    // 增加ISP收敛时间，解决边缘偏紫色问题
-    printf("Waiting for ISP AWB to converge...\n");
-    usleep(2000000); // 增加2秒延迟，让ISP的AWB算法完全收敛
-    
-    // 处理拍照
-    if (sample_comm_venc_snap_process(venc_chn, 1, TD_TRUE, TD_FALSE) != TD_SUCCESS) {
-        printf("Failed to process photo\n");
-        goto cleanup;
-    }
-    
-    // 停止拍照
-    if (ss_mpi_venc_stop_chn(venc_chn) != TD_SUCCESS) {
-        printf("Failed to stop venc chn\n");
-        goto cleanup;
-    }
-    if (ss_mpi_venc_destroy_chn(venc_chn) != TD_SUCCESS) {
-        printf("Failed to destroy venc chn\n");
-        goto cleanup;
-    }
-    
-    // 重命名文件
-    if (rename("snap_0.jpg", output_file) != 0) {
+        pipeline_stop(p);
+        return -1;
+    }
+    p->venc_bound = 1;
+
+    // 6. 等待VI稳定输出以及ISP AE/AWB收敛（常驻服务只在启动时等待一次）
+    printf("Waiting %d ms for AE/AWB to converge...\n", cfg->settle_ms);
+    usleep((useconds_t)cfg->settle_ms * 1000);
+    printf("Capture pipeline ready\n");
+    return 0;
+}
+
+/**
+ * @brief 抓拍一帧 JPEG 到内存
+ *
+ * 启动 JPEG 通道接收 1 帧，等待编码完成后拷贝码流并停止通道。
+ *
+ * @param p 管线状态
+ * @param out 输出缓冲区
+ * @return int 成功返回0，失败返回-1
+ */
+static int pipeline_snap(capture_pipeline_t *p, jpeg_buf_t *out) {
+    ot_venc_start_param start_param = {
+        .recv_pic_num = 1
+    };
+    td_s32 ret = ss_mpi_venc_start_chn(p->venc_chn, &start_param);
+    if (ret != TD_SUCCESS) {
+        printf("ss_mpi_venc_start_chn failed: 0x%x\n", ret);
+        return -1;
+    }
+
+    int result = -1;
+    td_s32 fd = ss_mpi_venc_get_fd(p->venc_chn);
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(fd, &read_fds);
+    struct timeval timeout = {SNAP_TIMEOUT_MS / 1000, (SNAP_TIMEOUT_MS % 1000) * 1000};
+    if (select(fd + 1, &read_fds, NULL, NULL, &timeout) <= 0) {
+        printf("Snapshot timed out\n");
+        goto stop;
+    }
+
+    ot_venc_chn_status status;
+    if (ss_mpi_venc_query_status(p->venc_chn, &status) != TD_SUCCESS || status.cur_packs == 0 ||
+        status.cur_packs > SNAP_MAX_PACKS) {
+        printf("Unexpected VENC status\n");
+        goto stop;
+    }
+
+    ot_venc_pack packs[SNAP_MAX_PACKS];
+    ot_venc_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.pack = packs;
+    stream.pack_cnt = status.cur_packs;
+    ret = ss_mpi_venc_get_stream(p->venc_chn, &stream, SNAP_TIMEOUT_MS);
+    if (ret != TD_SUCCESS) {
+        printf("ss_mpi_venc_get_stream failed: 0x%x\n", ret);
+        goto stop;
+    }
+
+    size_t total = 0;
+    for (td_u32 i = 0; i < stream.pack_cnt; i++) {
+        total += stream.pack[i].len - stream.pack[i].offset;
+    }
+    if (total > out->cap) {
+        uint8_t *data = (uint8_t *)realloc(out->data, total);
+        if (!data) {
+            printf("Out of memory for %zu byte JPEG\n", total);
+            ss_mpi_venc_release_stream(p->venc_chn, &stream);
+            goto stop;
+        }
+        out->data = data;
+        out->cap = total;
+    }
+    out->len = 0;
+    for (td_u32 i = 0; i < stream.pack_cnt; i++) {
+        size_t len = stream.pack[i].len - stream.pack[i].offset;
+        memcpy(out->data + out->len, stream.pack[i].addr + stream.pack[i].offset, len);
+        out->len += len;
+    }
+    ss_mpi_venc_release_stream(p->venc_chn, &stream);
+    result = 0;
+
+stop:
+    ss_mpi_venc_stop_chn(p->venc_chn);
+    return result;
+}
+
+/**
+ * @brief 写入文件（先写临时文件再重命名，读取方不会看到半个 JPEG）
+ *
+ * @param path 文件路径
+ * @param data 数据
+ * @param len 长度
+ * @return int 成功返回0，失败返回-1
+ */
+static int write_file(const char *path, const uint8_t *data, size_t len) {
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        printf("Failed to open %s: %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+    size_t written = fwrite(data, 1, len, fp);
+    if (fclose(fp) != 0 || written != len) {
+        printf("Failed to write %s\n", tmp_path);
+        unlink(tmp_path);
+        return -1;
+    }
+    if (rename(tmp_path, path) != 0) {
         printf("Failed to rename file\n");
-        goto cleanup;
-    }
-    
-    printf("Image captured successfully: %s\n", output_file);
-    
-cleanup:
-    // 解绑VI到VENC
-    sample_comm_vi_un_bind_venc(vi_pipe, vi_chn, venc_chn);
-    
-    // 停止VI - 这会自动处理ISP停止、传感器注销等所有相关资源释放
-    sample_comm_vi_stop_vi(&vi_cfg);
-    
-    // 系统退出
-    sample_comm_sys_exit();
-    
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 带超时写完全部数据
+ *
+ * @param fd 套接字
+ * @param data 数据
+ * @param len 长度
+ * @return int 成功返回0，失败返回-1
+ */
+static int send_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0) {
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        if (poll(&pfd, 1, CLIENT_IO_TIMEOUT_MS) <= 0) {
+            return -1;
+        }
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 带超时读满指定长度
+ *
+ * @param fd 套接字
+ * @param data 缓冲区
+ * @param len 长度
+ * @return int 成功返回0，失败或对端关闭返回-1
+ */
+static int recv_all(int fd, void *data, size_t len) {
+    uint8_t *p = (uint8_t *)data;
+    while (len > 0) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, CLIENT_IO_TIMEOUT_MS) <= 0) {
+            return -1;
+        }
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 读取一行（不含换行符）
+ *
+ * @param fd 套接字
+ * @param line 缓冲区
+ * @param size 缓冲区大小
+ * @return int 成功返回0，超长、超时或对端关闭返回-1
+ */
+static int recv_line(int fd, char *line, size_t size) {
+    size_t n = 0;
+    while (n + 1 < size) {
+        char c;
+        if (recv_all(fd, &c, 1) != 0) {
+            return -1;
+        }
+        if (c == '\n') {
+            line[n] = '\0';
+            return 0;
+        }
+        line[n++] = c;
+    }
+    return -1;
+}
+
+/**
+ * @brief 处理一个抓拍请求连接
+ *
+ * @param p 管线状态
+ * @param client_fd 客户端套接字
+ * @param jpeg 复用的 JPEG 缓冲区
+ */
+static void serve_client(capture_pipeline_t *p, int client_fd, jpeg_buf_t *jpeg) {
+    char request[REQUEST_MAX_LEN];
+    char header[64];
+    if (recv_line(client_fd, request, sizeof(request)) != 0) {
+        return;
+    }
+    if (strcmp(request, "SNAP") != 0) {
+        snprintf(header, sizeof(header), "ERR unknown request\n");
+        send_all(client_fd, header, strlen(header));
+        return;
+    }
+
+    double start = monotonic_ms();
+    if (pipeline_snap(p, jpeg) != 0) {
+        snprintf(header, sizeof(header), "ERR capture failed\n");
+        send_all(client_fd, header, strlen(header));
+        return;
+    }
+    double elapsed = monotonic_ms() - start;
+
+    snprintf(header, sizeof(header), "OK %zu\n", jpeg->len);
+    if (send_all(client_fd, header, strlen(header)) != 0 ||
+        send_all(client_fd, jpeg->data, jpeg->len) != 0) {
+        printf("Failed to send snapshot to client\n");
+        return;
+    }
+    printf("Snapshot served: %zu bytes, %.1f ms\n", jpeg->len, elapsed);
+}
+
+/**
+ * @brief 创建监听套接字
+ *
+ * @param path 套接字路径
+ * @return int 监听描述符，失败返回-1
+ */
+static int listen_socket(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Socket path too long: %s\n", path);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        printf("socket failed: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        printf("Failed to listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 常驻服务主循环
+ *
+ * @param p 管线状态
+ * @param socket_path 套接字路径
+ * @return int 正常退出返回0，失败返回-1
+ */
+static int run_daemon(capture_pipeline_t *p, const char *socket_path) {
+    int listen_fd = listen_socket(socket_path);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    printf("Snapshot daemon listening on %s\n", socket_path);
+
+    jpeg_buf_t jpeg = {NULL, 0, 0};
+    while (g_running) {
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        int ret = poll(&pfd, 1, 1000);
+        if (ret <= 0) {
+            continue;
+        }
+        int client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            continue;
+        }
+        // 请求串行处理：JPEG 通道同一时刻只能服务一次抓拍
+        serve_client(p, client_fd, &jpeg);
+        close(client_fd);
+    }
+
+    free(jpeg.data);
+    close(listen_fd);
+    unlink(socket_path);
+    return 0;
+}
+
+/**
+ * @brief 向常驻服务请求抓拍
+ *
+ * @param socket_path 套接字路径
+ * @param output_file 输出文件
+ * @return int 成功返回0，服务不存在返回1，请求失败返回-1
+ */
+static int request_snapshot(const char *socket_path, const char *output_file) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    int result = -1;
+    char header[64];
+    uint8_t *data = NULL;
+    if (send_all(fd, "SNAP\n", 5) != 0 || recv_line(fd, header, sizeof(header)) != 0) {
+        printf("Snapshot daemon did not respond\n");
+        goto out;
+    }
+    size_t len = 0;
+    if (sscanf(header, "OK %zu", &len) != 1 || len == 0) {
+        printf("Snapshot daemon: %s\n", header);
+        goto out;
+    }
+    data = (uint8_t *)malloc(len);
+    if (!data || recv_all(fd, data, len) != 0) {
+        printf("Failed to receive snapshot\n");
+        goto out;
+    }
+    result = write_file(output_file, data, len);
+
+out:
+    free(data);
+    close(fd);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    char *output_file = DEFAULT_OUTPUT_FILE;
+    const char *socket_path = DEFAULT_SOCKET_PATH;
+    int daemon_mode = 0;
+    int local_only = 0;
+    int opt;
+    int option_index = 0;
+    capture_cfg_t cfg = {
+        .width = DEFAULT_WIDTH,
+        .height = DEFAULT_HEIGHT,
+        .raw_bits = DEFAULT_RAW_BITS,
+        .offline = 0,
+        .settle_ms = DEFAULT_SETTLE_MS
+    };
+
+    // 解析命令行参数
+    while ((opt = getopt_long(argc, argv, "o:w:h:b:Ot:ds:l", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'w':
+                cfg.width = atoi(optarg);
+                break;
+            case 'h':
+                cfg.height = atoi(optarg);
+                break;
+            case 'b':
+                cfg.raw_bits = atoi(optarg);
+                break;
+            case 'O':
+                cfg.offline = 1;
+                break;
+            case 't':
+                cfg.settle_ms = atoi(optarg);
+                break;
+            case 'd':
+                daemon_mode = 1;
+                break;
+            case 's':
+                socket_path = optarg;
+                break;
+            case 'l':
+                local_only = 1;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+    if (cfg.width <= 0 || cfg.height <= 0 || cfg.settle_ms < 0 ||
+        (cfg.raw_bits != 10 && cfg.raw_bits != 12)) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    // 单次抓拍优先交给常驻服务，省去管线初始化和收敛等待
+    if (!daemon_mode && !local_only) {
+        double start = monotonic_ms();
+        int ret = request_snapshot(socket_path, output_file);
+        if (ret == 0) {
+            printf("Image captured by daemon: %s (%.1f ms)\n", output_file, monotonic_ms() - start);
+            return 0;
+        }
+        if (ret < 0) {
+            return -1;
+        }
+    }
+
+    printf("Camera capture program starting (%s)...\n", daemon_mode ? "daemon" : "one-shot");
+    printf("Resolution: %dx%d, RAW %d bit, VI/VPSS %s\n", cfg.width, cfg.height, cfg.raw_bits,
+           cfg.offline ? "offline" : "online");
+    printf("Using sensor: %d\n", g_sns_type);
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    capture_pipeline_t pipeline;
+    if (pipeline_start(&cfg, &pipeline) != 0) {
+        return -1;
+    }
+
+    int ret = 0;
+    if (daemon_mode) {
+        ret = run_daemon(&pipeline, socket_path);
+    } else {
+        jpeg_buf_t jpeg = {NULL, 0, 0};
+        ret = pipeline_snap(&pipeline, &jpeg);
+        if (ret == 0) {
+            ret = write_file(output_file, jpeg.data, jpeg.len);
+        }
+        if (ret == 0) {
+            printf("Image captured successfully: %s\n", output_file);
+        }
+        free(jpeg.data);
+    }
+
+    pipeline_stop(&pipeline);
+    return ret;
+}
@@ -0,0 +1,313 @@
+/**
+ * @file camera_measure_hi3516.c
+ * @brief 常驻测量服务：VI → VPSS 低分辨率通道 → libimageproc → 消息队列
+ * @date 2026-10-14
+ *
+ * 与 camera_capture_hi3516 使用同一套传感器配置，但不再经过
+ * VENC JPEG 编码 → 文件传输 → imread 解码，而是由 VPSS 直接输出测量分辨率的
+ * YUV420SP 帧，测量结果以 MSG_TYPE_IMAGE_PROCESSED 消息发送到
+ * MSG_QUEUE_UART_TO_MQTT 队列。
+ *
+ * @note 本程序独占传感器管线（VI 管道 0、VPSS 组 0），不能与 webrtc 同时运行
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <fcntl.h>
+
+#include "ot_common.h"
+#include "ot_defines.h"
+#include "ot_type.h"
+#include "sample_comm.h"
+#include "ss_mpi_sys.h"
+#include "ss_mpi_vi.h"
+#include "ss_mpi_isp.h"
+#include "ss_mpi_vb.h"
+#include "ss_mpi_vpss.h"
+#include "ss_mpi_sys_bind.h"
+
+#include "message_queue.h"
+#include "vpss_measure.h"
+
+#define SENSOR_WIDTH 3840
+#define SENSOR_HEIGHT 2160
+#define SENSOR_FPS 25
+#define DEFAULT_MEASURE_FPS 5
+#define DEFAULT_PIPE_ID 0
+#define MEASURE_VPSS_GRP 0
+#define MEASURE_VPSS_CHN 3
+#define STATS_INTERVAL_S 10
+
+// 使用IMX415传感器
+sample_sns_type g_sns_type = IMX415_MIPI_8M_25FPS_10BIT;
+
+static volatile sig_atomic_t g_running = 1;
+
+static struct option long_options[] = {
+    {"width", required_argument, 0, 'w'},
+    {"height", required_argument, 0, 'h'},
+    {"fps", required_argument, 0, 'f'},
+    {"interval", required_argument, 0, 'i'},
+    {"band", required_argument, 0, 'b'},
+    {"no-queue", no_argument, 0, 'n'},
+    {"help", no_argument, 0, '?'},
+    {0, 0, 0, 0}
+};
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [options]\n", prog_name);
+    printf("Options:\n");
+    printf("  -w, --width <width>      Measure channel width (default: %d)\n", VPSS_MEASURE_DEFAULT_WIDTH);
+    printf("  -h, --height <height>    Measure channel height (default: %d)\n", VPSS_MEASURE_DEFAULT_HEIGHT);
+    printf("  -f, --fps <fps>          Measure frame rate (default: %d)\n", DEFAULT_MEASURE_FPS);
+    printf("  -i, --interval <ms>      Report interval when result unchanged (default: 1000)\n");
+    printf("  -b, --band <rows>        Band half height around measure lines, 0 = full frame (default: 0)\n");
+    printf("  -n, --no-queue           Do not send results to %s\n", MSG_QUEUE_UART_TO_MQTT);
+    printf("  -?, --help               Show this help message\n");
+}
+
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/**
+ * @brief 创建并启动测量用 VPSS 组
+ *
+ * @param width 测量通道宽度
+ * @param height 测量通道高度
+ * @param fps 测量帧率
+ * @return td_s32 成功返回 TD_SUCCESS
+ */
+static td_s32 start_vpss(td_u32 width, td_u32 height, td_s32 fps) {
+    ot_vpss_grp_attr grp_attr = {
+        .ie_en = TD_FALSE,
+        .dci_en = TD_FALSE,
+        .buf_share_en = TD_FALSE,
+        .mcf_en = TD_FALSE,
+        .max_width = SENSOR_WIDTH,
+        .max_height = SENSOR_HEIGHT,
+        .max_dei_width = SENSOR_WIDTH,
+        .max_dei_height = SENSOR_HEIGHT,
+        .dynamic_range = OT_DYNAMIC_RANGE_SDR8,
+        .pixel_format = OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420,
+        .dei_mode = OT_VPSS_DEI_MODE_OFF,
+        .buf_share_chn = OT_VPSS_INVALID_CHN,
+        .frame_rate = {
+            .src_frame_rate = -1,
+            .dst_frame_rate = -1
+        }
+    };
+
+    td_s32 ret = ss_mpi_vpss_create_grp(MEASURE_VPSS_GRP, &grp_attr);
+    if (ret != TD_SUCCESS) {
+        printf("ss_mpi_vpss_create_grp failed: 0x%x\n", ret);
+        return ret;
+    }
+
+    ret = vpss_measure_enable_chn(MEASURE_VPSS_GRP, MEASURE_VPSS_CHN, width, height, SENSOR_FPS, fps);
+    if (ret != TD_SUCCESS) {
+        ss_mpi_vpss_destroy_grp(MEASURE_VPSS_GRP);
+        return ret;
+    }
+
+    ret = ss_mpi_vpss_start_grp(MEASURE_VPSS_GRP);
+    if (ret != TD_SUCCESS) {
+        printf("ss_mpi_vpss_start_grp failed: 0x%x\n", ret);
+        ss_mpi_vpss_disable_chn(MEASURE_VPSS_GRP, MEASURE_VPSS_CHN);
+        ss_mpi_vpss_destroy_grp(MEASURE_VPSS_GRP);
+        return ret;
+    }
+    return TD_SUCCESS;
+}
+
+/**
+ * @brief 停止并销毁测量用 VPSS 组
+ */
+static void stop_vpss(void) {
+    ss_mpi_vpss_stop_grp(MEASURE_VPSS_GRP);
+    ss_mpi_vpss_disable_chn(MEASURE_VPSS_GRP, MEASURE_VPSS_CHN);
+    ss_mpi_vpss_destroy_grp(MEASURE_VPSS_GRP);
+}
+
+/**
+ * @brief 绑定或解绑 VI → VPSS
+ *
+ * @param bind TD_TRUE 绑定，TD_FALSE 解绑
+ * @return td_s32 成功返回 TD_SUCCESS
+ */
+static td_s32 bind_vi_vpss(td_bool bind) {
+    ot_mpp_chn src_chn = {.mod_id = OT_ID_VI, .dev_id = DEFAULT_PIPE_ID, .chn_id = 0};
+    ot_mpp_chn dst_chn = {.mod_id = OT_ID_VPSS, .dev_id = MEASURE_VPSS_GRP, .chn_id = 0};
+    return bind ? ss_mpi_sys_bind(&src_chn, &dst_chn) : ss_mpi_sys_unbind(&src_chn, &dst_chn);
+}
+
+int main(int argc, char *argv[]) {
+    int width = VPSS_MEASURE_DEFAULT_WIDTH;
+    int height = VPSS_MEASURE_DEFAULT_HEIGHT;
+    int fps = DEFAULT_MEASURE_FPS;
+    int use_queue = 1;
+    int opt;
+    int option_index = 0;
+    int ret = 0;
+
+    vpss_measure_config_t cfg;
+    vpss_measure_default_config(&cfg);
+    cfg.grp = MEASURE_VPSS_GRP;
+    cfg.chn = MEASURE_VPSS_CHN;
+
+    // 解析命令行参数
+    while ((opt = getopt_long(argc, argv, "w:h:f:i:b:n", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'w':
+                width = atoi(optarg);
+                break;
+            case 'h':
+                height = atoi(optarg);
+                break;
+            case 'f':
+                fps = atoi(optarg);
+                break;
+            case 'i':
+                cfg.report_interval_ms = atoi(optarg);
+                break;
+            case 'b':
+                cfg.proc.measure.band_half_height = atoi(optarg);
+                break;
+            case 'n':
+                use_queue = 0;
+                break;
+            case '?':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+    if (width <= 0 || height <= 0 || fps <= 0 || fps > SENSOR_FPS) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    printf("Camera measure service starting...\n");
+    printf("Measure channel: %dx%d @ %d fps\n", width, height, fps);
+    printf("Using sensor: %d\n", g_sns_type);
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    // 1. 系统初始化
+    // raw, yuv（VI 输出 / VPSS 输入）, 测量通道
+    sample_vb_param vb_param = {
+        .vb_size = {{SENSOR_WIDTH, SENSOR_HEIGHT}, {SENSOR_WIDTH, SENSOR_HEIGHT}, {width, height}},
+        .pixel_format = {OT_PIXEL_FORMAT_RGB_BAYER_10BPP, OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420,
+            OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420},
+        .compress_mode = {OT_COMPRESS_MODE_LINE, OT_COMPRESS_MODE_NONE,
+            OT_COMPRESS_MODE_NONE},
+        .video_format = {OT_VIDEO_FORMAT_LINEAR, OT_VIDEO_FORMAT_LINEAR,
+            OT_VIDEO_FORMAT_LINEAR},
+        // 测量通道：队列深度 2 + VPSS 正在写入 + 测量线程持有
+        .blk_num = {6, 6, 4}
+    };
+
+    ot_vb_cfg vb_cfg;
+    td_u32 supplement_config = OT_VB_SUPPLEMENT_BNR_MOT_MASK | OT_VB_SUPPLEMENT_MOTION_DATA_MASK;
+    sample_comm_sys_get_default_vb_cfg(&vb_param, &vb_cfg);
+    if (sample_comm_sys_init_with_vb_supplement(&vb_cfg, supplement_config) != TD_SUCCESS) {
+        printf("Failed to initialize system with VB supplement\n");
+        return -1;
+    }
+
+    // 2. 设置 VI 和 VPSS 模式
+    if (sample_comm_vi_set_vi_vpss_mode(OT_VI_ONLINE_VPSS_ONLINE, OT_VI_AIISP_MODE_DEFAULT) != TD_SUCCESS) {
+        printf("Failed to set VI VPSS mode\n");
+        sample_comm_sys_exit();
+        return -1;
+    }
+
+    // 3. VI 配置与 camera_capture_hi3516 默认参数相同
+    sample_vi_cfg vi_cfg;
+    sample_comm_vi_get_default_vi_cfg(g_sns_type, &vi_cfg);
+    for (int i = 0; i < vi_cfg.bind_pipe.pipe_num; i++) {
+        vi_cfg.pipe_info[i].pipe_attr.pixel_format = OT_PIXEL_FORMAT_RGB_BAYER_10BPP;
+        vi_cfg.pipe_info[i].pipe_attr.isp_bypass = TD_FALSE;
+        vi_cfg.pipe_info[i].pipe_attr.compress_mode = OT_COMPRESS_MODE_LINE;
+        for (int j = 0; j < vi_cfg.pipe_info[i].chn_num; j++) {
+            vi_cfg.pipe_info[i].chn_info[j].chn_attr.pixel_format = OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420;
+            vi_cfg.pipe_info[i].chn_info[j].chn_attr.compress_mode = OT_COMPRESS_MODE_NONE;
+        }
+    }
+    vi_cfg.mipi_info.mipi_dev = 0;
+    vi_cfg.mipi_info.divide_mode = LANE_DIVIDE_MODE_0;
+
+    // 4. 启动 VI 和 ISP
+    printf("Initializing sensor and starting VI...\n");
+    if (sample_comm_vi_start_vi(&vi_cfg) != TD_SUCCESS) {
+        printf("Failed to start VI\n");
+        sample_comm_sys_exit();
+        return -1;
+    }
+
+    // 5. 启动 VPSS 并绑定 VI → VPSS，缩放由 VPSS 完成
+    if (start_vpss((td_u32)width, (td_u32)height, fps) != TD_SUCCESS) {
+        printf("Failed to start VPSS\n");
+        ret = -1;
+        goto stop_vi;
+    }
+    if (bind_vi_vpss(TD_TRUE) != TD_SUCCESS) {
+        printf("Failed to bind VI to VPSS\n");
+        ret = -1;
+        goto stop_vpss;
+    }
+
+    // 6. 打开结果队列（由 process_manager 创建），失败时只在本地统计
+    if (use_queue) {
+        cfg.mq_fd = mq_open_existing(MSG_QUEUE_UART_TO_MQTT, O_WRONLY);
+        if (cfg.mq_fd == -1) {
+            printf("Message queue %s not available, results will not be sent\n", MSG_QUEUE_UART_TO_MQTT);
+        }
+    }
+
+    // 7. 启动测量线程
+    vpss_measure_t *measure = vpss_measure_start(&cfg);
+    if (!measure) {
+        printf("Failed to start measure thread\n");
+        ret = -1;
+        goto unbind;
+    }
+
+    printf("Camera measure service running, press Ctrl+C to stop\n");
+    int ticks = 0;
+    while (g_running) {
+        sleep(1);
+        if (++ticks % STATS_INTERVAL_S != 0) {
+            continue;
+        }
+        vpss_measure_stats_t stats;
+        vpss_measure_get_stats(measure, &stats);
+        printf("frames %llu, measured %llu, reports %llu, errors %llu, last %.2f ms, avg %.2f ms\n",
+               (unsigned long long)stats.frames, (unsigned long long)stats.measured,
+               (unsigned long long)stats.reports, (unsigned long long)stats.errors,
+               stats.last_ms, stats.avg_ms);
+    }
+
+    printf("Stopping camera measure service...\n");
+    vpss_measure_stop(measure);
+
+unbind:
+    if (cfg.mq_fd != -1) {
+        mq_close_queue(cfg.mq_fd);
+    }
+    bind_vi_vpss(TD_FALSE);
+stop_vpss:
+    stop_vpss();
+stop_vi:
+    sample_comm_vi_stop_vi(&vi_cfg);
+    sample_comm_sys_exit();
+    return ret;
+}
@@ -0,0 +1,350 @@
+/**
+ * @file vpss_measure.c
+ * @brief VPSS 通道直取测量模块实现
+ * @date 2026-10-14
+ */
+
+#include "vpss_measure.h"
+#include "message_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ot_common_video.h"
+#include "ss_mpi_sys.h"
+#include "ss_mpi_vpss.h"
+
+#define VPSS_MEASURE_MAP_CACHE 8     // 映射缓存项数（不小于通道深度 + VB 池块数即可全部命中）
+#define VPSS_MEASURE_ERROR_SLEEP_US 10000  // 取帧出错后的等待时间（微秒）
+
+// 结果消息按 paragraph_t 原样拷贝段落
+typedef char vpss_measure_paragraph_size_check[(sizeof(paragraph_t) <= IMAGE_RESULT_PARAGRAPH_SIZE) ? 1 : -1];
+typedef char vpss_measure_payload_size_check[(sizeof(image_process_result_t) <= sizeof(((message_t *)0)->payload.data)) ? 1 : -1];
+
+/**
+ * @brief 物理地址映射缓存项
+ */
+typedef struct {
+    td_phys_addr_t phys;   ///< VB 块 Y 平面物理地址
+    td_void *virt;         ///< 用户态映射
+    td_u32 size;           ///< 映射大小
+} map_entry_t;
+
+/**
+ * @brief 测量模块
+ */
+struct vpss_measure {
+    vpss_measure_config_t cfg;      ///< 配置
+    imageproc_t *proc;              ///< libimageproc 上下文
+    pthread_t thread;               ///< 测量线程
+    volatile int stop;              ///< 停止请求
+    map_entry_t maps[VPSS_MEASURE_MAP_CACHE]; ///< 映射缓存
+    int map_next;                   ///< 缓存满时下一个替换位置
+    pthread_mutex_t stats_lock;     ///< 保护 stats
+    vpss_measure_stats_t stats;     ///< 统计
+    image_process_result_t last;    ///< 上次上报的结果
+    int has_last;                   ///< last 是否有效
+    double last_report_ms;          ///< 上次上报时间
+    uint32_t seq_num;               ///< 消息序列号
+};
+
+/**
+ * @brief 获取单调时钟（毫秒）
+ */
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void vpss_measure_default_config(vpss_measure_config_t *cfg) {
+    if (!cfg) {
+        return;
+    }
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->grp = 0;
+    cfg->chn = 3;
+    cfg->mq_fd = -1;
+    cfg->report_interval_ms = 1000;
+    cfg->get_timeout_ms = 200;
+    imageproc_default_options(&cfg->proc);
+}
+
+td_s32 vpss_measure_enable_chn(ot_vpss_grp grp, ot_vpss_chn chn, td_u32 width, td_u32 height,
+                               td_s32 src_fps, td_s32 dst_fps) {
+    ot_vpss_chn_attr chn_attr;
+    memset(&chn_attr, 0, sizeof(chn_attr));
+    chn_attr.mirror_en = TD_FALSE;
+    chn_attr.flip_en = TD_FALSE;
+    chn_attr.border_en = TD_FALSE;
+    chn_attr.width = width;
+    chn_attr.height = height;
+    chn_attr.depth = 2;
+    chn_attr.chn_mode = OT_VPSS_CHN_MODE_USER;
+    chn_attr.video_format = OT_VIDEO_FORMAT_LINEAR;
+    chn_attr.dynamic_range = OT_DYNAMIC_RANGE_SDR8;
+    chn_attr.pixel_format = OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420;
+    chn_attr.compress_mode = OT_COMPRESS_MODE_NONE;
+    chn_attr.frame_rate.src_frame_rate = src_fps;
+    chn_attr.frame_rate.dst_frame_rate = dst_fps;
+
+    td_s32 ret = ss_mpi_vpss_set_chn_attr(grp, chn, &chn_attr);
+    if (ret != TD_SUCCESS) {
+        printf("[measure] ss_mpi_vpss_set_chn_attr(%d, %d) failed: 0x%x\n", grp, chn, ret);
+        return ret;
+    }
+    ret = ss_mpi_vpss_enable_chn(grp, chn);
+    if (ret != TD_SUCCESS) {
+        printf("[measure] ss_mpi_vpss_enable_chn(%d, %d) failed: 0x%x\n", grp, chn, ret);
+        return ret;
+    }
+    printf("[measure] VPSS grp %d chn %d: %ux%u @ %d/%d fps\n", grp, chn, width, height, dst_fps, src_fps);
+    return TD_SUCCESS;
+}
+
+/**
+ * @brief 查找或建立 VB 块的用户态映射
+ *
+ * @param m 模块指针
+ * @param phys 物理地址
+ * @param size 映射大小
+ * @return td_void* 虚拟地址，映射失败返回 NULL
+ */
+static td_void *map_lookup(vpss_measure_t *m, td_phys_addr_t phys, td_u32 size) {
+    for (int i = 0; i < VPSS_MEASURE_MAP_CACHE; i++) {
+        if (m->maps[i].virt && m->maps[i].phys == phys && m->maps[i].size >= size) {
+            return m->maps[i].virt;
+        }
+    }
+
+    // 未命中：优先使用空闲项，否则轮流替换
+    int slot = -1;
+    for (int i = 0; i < VPSS_MEASURE_MAP_CACHE; i++) {
+        if (!m->maps[i].virt) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        slot = m->map_next;
+        m->map_next = (m->map_next + 1) % VPSS_MEASURE_MAP_CACHE;
+        ss_mpi_sys_munmap(m->maps[slot].virt, m->maps[slot].size);
+        m->maps[slot].virt = TD_NULL;
+    }
+
+    td_void *virt = ss_mpi_sys_mmap(phys, size);
+    if (!virt) {
+        printf("[measure] ss_mpi_sys_mmap(0x%llx, %u) failed\n", (unsigned long long)phys, size);
+        return TD_NULL;
+    }
+    m->maps[slot].phys = phys;
+    m->maps[slot].virt = virt;
+    m->maps[slot].size = size;
+    return virt;
+}
+
+/**
+ * @brief 释放所有映射
+ *
+ * @param m 模块指针
+ */
+static void map_clear(vpss_measure_t *m) {
+    for (int i = 0; i < VPSS_MEASURE_MAP_CACHE; i++) {
+        if (m->maps[i].virt) {
+            ss_mpi_sys_munmap(m->maps[i].virt, m->maps[i].size);
+        }
+    }
+    memset(m->maps, 0, sizeof(m->maps));
+    m->map_next = 0;
+}
+
+/**
+ * @brief 测量一帧
+ *
+ * @param m 模块指针
+ * @param frame VPSS 输出帧
+ * @return int 成功返回0，失败返回-1
+ */
+static int measure_frame(vpss_measure_t *m, const ot_video_frame_info *frame) {
+    const ot_video_frame *vf = &frame->video_frame;
+    if (vf->pixel_format != OT_PIXEL_FORMAT_YVU_SEMIPLANAR_420 &&
+        vf->pixel_format != OT_PIXEL_FORMAT_YUV_SEMIPLANAR_420 &&
+        vf->pixel_format != OT_PIXEL_FORMAT_YUV_400) {
+        printf("[measure] unsupported pixel format %d\n", vf->pixel_format);
+        return -1;
+    }
+
+    // 只映射 Y 平面
+    td_u32 size = vf->stride[0] * vf->height;
+    td_void *virt = map_lookup(m, vf->phys_addr[0], size);
+    if (!virt) {
+        return -1;
+    }
+
+    imageproc_frame_t in;
+    in.phys_addr = vf->phys_addr[0];
+    in.virt_addr = (const uint8_t *)virt;
+    in.width = (int)vf->width;
+    in.height = (int)vf->height;
+    in.stride = (int)vf->stride[0];
+    in.format = IMAGE_PIXEL_NV12;
+    return imageproc_measure_frame(m->proc, &in);
+}
+
+/**
+ * @brief 按需上报测量结果
+ *
+ * @param m 模块指针
+ * @param success 本帧是否测量成功
+ * @param captured_us 取到帧的时间（pm_metrics_now_us）
+ * @param measured_us 测量完成的时间
+ */
+static void report_result(vpss_measure_t *m, int success, uint64_t captured_us, uint64_t measured_us) {
+    image_process_result_t result;
+    memset(&result, 0, sizeof(result));
+    result.success = (uint8_t)(success ? 1 : 0);
+    if (success) {
+        int count = imageproc_get_paragraph_count(m->proc);
+        if (count > IMAGE_RESULT_MAX_PARAGRAPHS) {
+            count = IMAGE_RESULT_MAX_PARAGRAPHS;
+        }
+        for (int i = 0; i < count; i++) {
+            paragraph_t para;
+            if (imageproc_get_paragraph(m->proc, i, &para) == 0) {
+                memcpy(result.paragraphs[i], &para, sizeof(para));
+            }
+        }
+        result.paragraph_count = (uint8_t)count;
+    }
+
+    // 结果不变时按间隔上报，避免每帧占用消息队列
+    double now = monotonic_ms();
+    int changed = !m->has_last || memcmp(&result, &m->last, sizeof(result)) != 0;
+    if (!changed && now - m->last_report_ms < m->cfg.report_interval_ms) {
+        return;
+    }
+    m->last = result;
+    m->has_last = 1;
+    m->last_report_ms = now;
+
+    if (m->cfg.mq_fd == -1) {
+        return;
+    }
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_TYPE_IMAGE_PROCESSED;
+    msg.seq_num = m->seq_num++;
+    msg.timestamp = (uint32_t)time(NULL);
+    memcpy(&msg.payload.img_result, &result, sizeof(result));
+    msg.data_len = sizeof(result);
+    // 直接测量 VPSS 帧，没有传输和解码阶段
+    msg.trace_id = pm_metrics_trace_id();
+    msg.payload.img_result.trace_us[PM_TRACE_CAPTURED] = captured_us;
+    msg.payload.img_result.trace_us[PM_TRACE_MEASURED] = measured_us;
+    msg.payload.img_result.trace_us[PM_TRACE_QUEUED] = pm_metrics_now_us();
+    if (mq_send_msg(m->cfg.mq_fd, &msg, 0) == 0) {
+        pthread_mutex_lock(&m->stats_lock);
+        m->stats.reports++;
+        pthread_mutex_unlock(&m->stats_lock);
+    } else {
+        printf("[measure] failed to send result\n");
+    }
+}
+
+/**
+ * @brief 测量线程
+ *
+ * @param arg 模块指针
+ * @return void* NULL
+ */
+static void *measure_thread(void *arg) {
+    vpss_measure_t *m = (vpss_measure_t *)arg;
+    while (!m->stop) {
+        ot_video_frame_info frame;
+        td_s32 ret = ss_mpi_vpss_get_chn_frame(m->cfg.grp, m->cfg.chn, &frame, m->cfg.get_timeout_ms);
+        if (ret == OT_ERR_VPSS_BUF_EMPTY) {
+            continue;
+        }
+        if (ret != TD_SUCCESS) {
+            pthread_mutex_lock(&m->stats_lock);
+            m->stats.errors++;
+            pthread_mutex_unlock(&m->stats_lock);
+            usleep(VPSS_MEASURE_ERROR_SLEEP_US);
+            continue;
+        }
+
+        uint64_t captured_us = pm_metrics_now_us();
+        double start = monotonic_ms();
+        int status = measure_frame(m, &frame);
+        double elapsed = monotonic_ms() - start;
+        uint64_t measured_us = pm_metrics_now_us();
+        // 测量结束即归还 VB 块，段落结果已保存在上下文中
+        ss_mpi_vpss_release_chn_frame(m->cfg.grp, m->cfg.chn, &frame);
+
+        pthread_mutex_lock(&m->stats_lock);
+        m->stats.frames++;
+        if (status == 0) {
+            m->stats.measured++;
+            m->stats.last_ms = elapsed;
+            m->stats.avg_ms += (elapsed - m->stats.avg_ms) / (double)m->stats.measured;
+        } else {
+            m->stats.errors++;
+        }
+        pthread_mutex_unlock(&m->stats_lock);
+
+        report_result(m, status == 0, captured_us, measured_us);
+    }
+    return NULL;
+}
+
+vpss_measure_t *vpss_measure_start(const vpss_measure_config_t *cfg) {
+    if (!cfg) {
+        return NULL;
+    }
+    vpss_measure_t *m = (vpss_measure_t *)calloc(1, sizeof(vpss_measure_t));
+    if (!m) {
+        return NULL;
+    }
+    m->cfg = *cfg;
+    m->proc = imageproc_create(&m->cfg.proc);
+    if (!m->proc) {
+        free(m);
+        return NULL;
+    }
+    pthread_mutex_init(&m->stats_lock, NULL);
+    if (pthread_create(&m->thread, NULL, measure_thread, m) != 0) {
+        printf("[measure] failed to create measure thread\n");
+        pthread_mutex_destroy(&m->stats_lock);
+        imageproc_destroy(m->proc);
+        free(m);
+        return NULL;
+    }
+    printf("[measure] started on VPSS grp %d chn %d, kernel %s\n",
+           cfg->grp, cfg->chn, imageproc_backend_name());
+    return m;
+}
+
+void vpss_measure_stop(vpss_measure_t *m) {
+    if (!m) {
+        return;
+    }
+    m->stop = 1;
+    pthread_join(m->thread, NULL);
+    map_clear(m);
+    imageproc_destroy(m->proc);
+    pthread_mutex_destroy(&m->stats_lock);
+    free(m);
+}
+
+void vpss_measure_get_stats(vpss_measure_t *m, vpss_measure_stats_t *stats) {
+    if (!m || !stats) {
+        return;
+    }
+    pthread_mutex_lock(&m->stats_lock);
+    *stats = m->stats;
+    pthread_mutex_unlock(&m->stats_lock);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file vpss_measure.h
+ * @brief VPSS 通道直取测量模块
+ * @date 2026-10-14
+ *
+ * 从一个专用的低分辨率 VPSS 通道取帧，不经过 JPEG 编码、文件传输和 imread 解码：
+ * 1. **零拷贝**：ss_mpi_vpss_get_chn_frame 取到的 VB 块直接交给 libimageproc，
+ *    ive 内核按物理地址读取 Y 平面，其他内核读取 ss_mpi_sys_mmap 映射
+ * 2. **映射缓存**：VB 块在池中循环使用，物理地址到虚拟地址的映射按块缓存，
+ *    稳定运行后每帧不再调用 mmap/munmap
+ * 3. **结果上报**：测量结果变化时，或距上次上报超过 report_interval_ms 时，
+ *    以 MSG_TYPE_IMAGE_PROCESSED 消息发送到进程间消息队列
+ */
+
+#ifndef VPSS_MEASURE_H
+#define VPSS_MEASURE_H
+
+#include <stdint.h>
+
+#include "ot_type.h"
+#include "ot_common_vpss.h"
+#include "imageproc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 测量通道默认分辨率（libimageproc 不缩放的最大尺寸）
+ */
+#define VPSS_MEASURE_DEFAULT_WIDTH 640
+#define VPSS_MEASURE_DEFAULT_HEIGHT 480
+
+/**
+ * @brief 测量模块配置
+ */
+typedef struct {
+    ot_vpss_grp grp;              ///< VPSS 组号
+    ot_vpss_chn chn;              ///< 测量通道号（需先用 vpss_measure_enable_chn 使能）
+    int mq_fd;                    ///< 结果消息队列描述符，-1 表示不发送
+    int report_interval_ms;       ///< 结果不变时的最长上报间隔（毫秒），0 表示每帧上报
+    int get_timeout_ms;           ///< 取帧超时（毫秒），也是停止请求的响应时间
+    imageproc_options_t proc;     ///< libimageproc 选项（测量条带、标定等）
+} vpss_measure_config_t;
+
+/**
+ * @brief 测量统计
+ */
+typedef struct {
+    uint64_t frames;              ///< 取到的帧数
+    uint64_t measured;            ///< 测量成功的帧数
+    uint64_t reports;             ///< 已发送的结果消息数
+    uint64_t errors;              ///< 取帧、映射或测量失败次数
+    double last_ms;               ///< 最近一帧测量耗时（毫秒）
+    double avg_ms;                ///< 平均测量耗时（毫秒）
+} vpss_measure_stats_t;
+
+/**
+ * @brief 测量模块（不透明类型）
+ */
+typedef struct vpss_measure vpss_measure_t;
+
+/**
+ * @brief 填充默认配置
+ *
+ * 组 0 通道 3、不发送结果、结果不变时每秒上报一次、取帧超时 200 ms，
+ * libimageproc 使用默认选项。
+ *
+ * @param cfg 配置指针
+ */
+void vpss_measure_default_config(vpss_measure_config_t *cfg);
+
+/**
+ * @brief 使能测量用 VPSS 通道
+ *
+ * 通道输出 YUV420SP，队列深度 2（用户态取帧要求深度大于 0），
+ * 由 VPSS 硬件完成缩放和降帧率。需在 VPSS 组启动前调用。
+ *
+ * @param grp VPSS 组号
+ * @param chn VPSS 通道号
+ * @param width 输出宽度
+ * @param height 输出高度
+ * @param src_fps 组输入帧率
+ * @param dst_fps 测量帧率
+ * @return td_s32 成功返回 TD_SUCCESS，失败返回 MPI 错误码
+ */
+td_s32 vpss_measure_enable_chn(ot_vpss_grp grp, ot_vpss_chn chn, td_u32 width, td_u32 height,
+                               td_s32 src_fps, td_s32 dst_fps);
+
+/**
+ * @brief 启动测量线程
+ *
+ * @param cfg 配置（内容被拷贝）
+ * @return vpss_measure_t* 模块指针，失败返回 NULL
+ */
+vpss_measure_t *vpss_measure_start(const vpss_measure_config_t *cfg);
+
+/**
+ * @brief 停止测量线程并释放资源
+ *
+ * @param m 模块指针
+ */
+void vpss_measure_stop(vpss_measure_t *m);
+
+/**
+ * @brief 获取测量统计
+ *
+ * @param m 模块指针
+ * @param stats 输出统计
+ */
+void vpss_measure_get_stats(vpss_measure_t *m, vpss_measure_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VPSS_MEASURE_H
@@ -0,0 +1,166 @@
+/**
+ * @file fota_relay.h
+ * @brief FOTA 固件流式转发通道头文件
+ * @version 1.0
+ * @date 2026-10-14
+ *
+ * MQTT 客户端边下载边把固件按顺序写入一个专用的共享内存环形队列，UART 进程边读边
+ * 通过串口发给 Air8000，下载和烧写重叠进行：
+ * 1. **记录**：fota_relay_record_t 头部 + 数据，数据按文件偏移严格递增；
+ *    一次会话依次为 START、若干 DATA、END（校验通过）或 ABORT
+ * 2. **背压**：环满时生产者阻塞等待 UART 侧消费，串口慢于网络时 MQTT 接收随之放缓；
+ *    等待超过 FOTA_RELAY_WRITE_TIMEOUT_MS 视为 UART 侧不在线，本次会话停止转发，
+ *    固件仍完整保存在文件中，由 UART 侧按文件方式升级
+ * 3. **会话号**：每次开始下载递增，UART 侧丢弃不属于当前会话的残留记录
+ */
+
+#ifndef FOTA_RELAY_H
+#define FOTA_RELAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "shm_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 转发通道 System V IPC 键值 "FRLY"
+ */
+#define FOTA_RELAY_KEY 0x46524C59
+
+/**
+ * @brief 转发通道数据区大小（字节）
+ */
+#define FOTA_RELAY_CAPACITY (256 * 1024)
+
+/**
+ * @brief 单条 DATA 记录最大数据长度，更长的数据由 fota_relay_send 拆分
+ */
+#define FOTA_RELAY_MAX_DATA (16 * 1024)
+
+/**
+ * @brief 生产者等待空间的超时（毫秒）
+ */
+#define FOTA_RELAY_WRITE_TIMEOUT_MS 30000
+
+/**
+ * @brief START 记录携带的文件路径最大长度
+ */
+#define FOTA_RELAY_PATH_MAX 256
+
+/**
+ * @brief 记录类型
+ */
+typedef enum {
+    FOTA_RELAY_START = 1,          // 会话开始，正文为 fota_relay_start_t
+    FOTA_RELAY_DATA,               // 固件数据
+    FOTA_RELAY_END,                // 全部数据已发送且校验通过
+    FOTA_RELAY_ABORT               // 会话取消或校验失败
+} fota_relay_type_t;
+
+/**
+ * @brief 记录头部
+ */
+typedef struct {
+    uint32_t type;                 // fota_relay_type_t
+    uint32_t session;              // 会话号
+    uint32_t offset;               // DATA：数据在固件中的偏移
+    uint32_t length;               // DATA：数据长度
+} fota_relay_record_t;
+
+/**
+ * @brief START 记录正文
+ */
+typedef struct {
+    uint32_t firmware_size;        // 固件总大小
+    char path[FOTA_RELAY_PATH_MAX];// 固件文件路径，重传已不在内存中的数据时回读
+} fota_relay_start_t;
+
+/**
+ * @brief 转发通道句柄
+ */
+typedef struct {
+    shm_ring_t ring;               // 环形队列
+    bool open;                     // 是否已创建或打开
+    uint32_t session;              // 生产者：当前会话号
+    uint32_t sent;                 // 生产者：当前会话已转发的字节数
+    bool detached;                 // 生产者：当前会话已因超时停止转发
+    uint8_t *rx_buf;               // 消费者：记录接收缓冲区
+} fota_relay_t;
+
+/**
+ * @brief 创建转发通道（生产者，MQTT 客户端启动时调用）
+ * @param relay 句柄指针
+ * @return 成功返回0，失败返回-1
+ */
+int fota_relay_create(fota_relay_t *relay);
+
+/**
+ * @brief 打开转发通道（消费者）
+ * @param relay 句柄指针
+ * @return 成功返回0，通道不存在返回-1
+ */
+int fota_relay_open(fota_relay_t *relay);
+
+/**
+ * @brief 关闭转发通道
+ * @param relay 句柄指针
+ * @param unlink 是否同时删除共享内存（仅创建方）
+ */
+void fota_relay_close(fota_relay_t *relay, bool unlink);
+
+/**
+ * @brief 开始一次转发会话
+ * @param relay 句柄指针
+ * @param firmware_size 固件总大小
+ * @param path 固件文件路径
+ * @return 成功返回新会话号，失败返回0
+ */
+uint32_t fota_relay_begin(fota_relay_t *relay, uint32_t firmware_size, const char *path);
+
+/**
+ * @brief 转发一段固件数据
+ * @details 必须按偏移递增、不留空洞地调用；环满时阻塞等待（背压）
+ * @param relay 句柄指针
+ * @param offset 数据偏移，应等于已转发的字节数
+ * @param data 数据
+ * @param len 数据长度
+ * @return 成功返回0；会话已停止转发或偏移不连续返回-1
+ */
+int fota_relay_send(fota_relay_t *relay, uint32_t offset, const void *data, size_t len);
+
+/**
+ * @brief 结束转发会话
+ * @param relay 句柄指针
+ * @param success true 写入 END（校验通过），false 写入 ABORT
+ * @return 结束记录已写入返回0；会话已停止转发返回-1
+ */
+int fota_relay_end(fota_relay_t *relay, bool success);
+
+/**
+ * @brief 当前会话是否仍在转发
+ * @param relay 句柄指针
+ * @return 已开始且未超时返回true
+ */
+bool fota_relay_active(const fota_relay_t *relay);
+
+/**
+ * @brief 读取一条记录（消费者）
+ * @param relay 句柄指针
+ * @param record 输出参数，记录头部
+ * @param body 输出参数，指向句柄内部缓冲区中的正文，下次调用前有效
+ * @param timeout_ms 超时时间（毫秒），-1 表示无限等待
+ * @return 成功返回正文长度（>=0），超时返回-2，失败返回-1
+ */
+ssize_t fota_relay_recv(fota_relay_t *relay, fota_relay_record_t *record,
+                        const uint8_t **body, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOTA_RELAY_H */
@@ -15,6 +15,7 @@
 #include <fcntl.h>
 #include <sys/msg.h>
 #include <sys/ipc.h>
+#include "pm_metrics.h"
 
 
 #ifdef __cplusplus
@@ -37,6 +38,22 @@ extern "C" {
  */
 #define MSG_QUEUE_MAX_MSG_SIZE 512
 
+/**
+ * @brief 选择传输方式的环境变量名
+ * @details 取值 "shm" 使用共享内存环形队列，"sysv" 或未设置使用 System V 消息队列；
+ *          只影响创建方（mq_create），打开方自动跟随创建方的选择
+ */
+#define MSG_QUEUE_TRANSPORT_ENV "AIR8000_MQ_TRANSPORT"
+
+/**
+ * @brief 消息队列传输方式
+ */
+typedef enum {
+    MQ_TRANSPORT_AUTO = 0,         // 由 MSG_QUEUE_TRANSPORT_ENV 环境变量决定，默认 System V
+    MQ_TRANSPORT_SYSV,             // System V 消息队列
+    MQ_TRANSPORT_SHM_RING          // 共享内存环形队列（futex 唤醒）
+} mq_transport_t;
+
 /**
  * @brief 消息类型枚举
  */
@@ -60,15 +77,39 @@ typedef enum {
     MSG_TYPE_IMAGE_PROCESSED       // 图片处理完成通知
 } msg_type_t;
 
+/**
+ * @brief 图片处理结果最多携带的段落数
+ */
+#define IMAGE_RESULT_MAX_PARAGRAPHS 10
+
+/**
+ * @brief 每个段落占用的字节数（按 libimageproc 的 paragraph_t 原样拷贝）
+ */
+#define IMAGE_RESULT_PARAGRAPH_SIZE 16
+
 /**
  * @brief 图片处理结果结构体
+ * @details 整个结构体必须放得进 payload.data，mq_send_msg 会拒绝更长的 data_len；
+ *          trace_us 记录本次结果经过的各阶段时间戳，MQTT 发布后填入 PM_TRACE_PUBLISHED 并写入跟踪环
  */
 typedef struct {
     uint8_t success;
     uint8_t paragraph_count;
-    uint8_t paragraphs[10][64];;
+    uint8_t paragraphs[IMAGE_RESULT_MAX_PARAGRAPHS][IMAGE_RESULT_PARAGRAPH_SIZE];
+    uint64_t trace_us[PM_TRACE_STAGE_COUNT];      // 各阶段时间戳（pm_metrics_now_us），0表示不适用
 } image_process_result_t;
 
+/**
+ * @brief 传感器数据消息
+ * @details 与 UART 侧 air8000_sensor_data_t 布局相同，MSG_TYPE_SENSOR_DATA 按原样拷贝该结构体
+ */
+typedef struct {
+    float temperature;         // 温度，单位摄氏度
+    uint8_t humidity;          // 湿度，范围0-100%
+    uint8_t light;             // 光照强度，范围0-255
+    uint8_t battery;           // 电池电量，范围0-100%
+} sensor_data_msg_t;
+
 /**
  * @brief 文件传输元数据结构体
  */
@@ -89,11 +130,13 @@ typedef struct {
     msg_type_t type;          // 消息类型
     uint32_t seq_num;         // 序列号
     uint32_t timestamp;       // 时间戳
+    uint32_t trace_id;        // 端到端跟踪ID，0表示未跟踪
     size_t data_len;          // 数据长度
     union {
         uint8_t data[256];                // 消息数据
         file_transfer_metadata_t file_meta; // 文件传输元数据
         image_process_result_t img_result; // 图片处理结果
+        sensor_data_msg_t sensor;         // 传感器数据
     } payload;                // 消息负载，支持多种类型
 } message_t;
 
@@ -107,6 +150,7 @@ typedef struct {
     int flags;                // 打开标志
     mode_t mode;              // 权限模式
     int msg_perm;             // System V IPC 权限
+    mq_transport_t transport; // 传输方式
 } mq_config_t;
 
 /**
@@ -123,6 +167,7 @@ typedef struct {
  * @param name 消息队列名称
  * @param config 消息队列配置指针，NULL表示使用默认配置
  * @return 成功返回消息队列ID，失败返回-1
+ * @note 共享内存环形队列返回小于 -1 的进程内句柄，调用方仍只需与 -1 比较判断失败
  */
 int mq_create(const char *name, const mq_config_t *config);
 
@@ -131,6 +176,7 @@ int mq_create(const char *name, const mq_config_t *config);
  * @param name 消息队列名称
  * @param flags 打开标志
  * @return 成功返回消息队列ID，失败返回-1
+ * @note 同名共享内存环形队列存在时优先使用，否则打开 System V 消息队列
  */
 int mq_open_existing(const char *name, int flags);
 
@@ -164,6 +210,8 @@ int mq_send_msg(int mq_fd, const message_t *msg, unsigned int priority);
  * @param priority 输出参数，用于返回消息优先级
  * @param timeout_ms 超时时间（毫秒），-1表示无限等待
  * @return 成功返回0，失败返回-1，超时返回1
+ * @note 共享内存环形队列在 futex 上阻塞等待；System V 消息队列不支持超时，以 5ms 间隔重试；
+ *       共享内存环形队列只拷贝 payload 中 data_len 字节，且不传递优先级（返回 0）
  */
 int mq_receive_msg(int mq_fd, message_t *msg, unsigned int *priority, int timeout_ms);
 
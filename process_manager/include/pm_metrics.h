@@ -0,0 +1,304 @@
+/**
+ * @file pm_metrics.h
+ * @brief 跨进程指标模块头文件
+ * @version 1.0
+ * @date 2026-10-14
+ *
+ * 设计要点：
+ * 1. **共享内存**：进程管理器创建一块 System V 共享内存，UART、MQTT 子进程附加后直接在里面计数，
+ *    `process_manager stats` 只读地附加并汇总，不经过任何被观测进程
+ * 2. **每线程槽位**：每个线程第一次记录时占用一个槽位，之后只写自己的槽位（relaxed 原子加），
+ *    没有锁、没有缓存行争用；线程退出时释放槽位（属主线程已不存在的槽位也会被回收），
+ *    由新线程接管，累计值不清零
+ * 3. **直方图**：延迟按微秒以 2 的幂分桶，读取方从桶计数估算分位数
+ * 4. **未附加时为空操作**：没有调用 pm_metrics_attach 的进程（例如独立运行的测试程序）记录函数直接返回
+ * 5. **端到端跟踪**：测量结果沿途记录各阶段的单调时钟时间戳，发布后整条记录写入共享内存中的跟踪环，
+ *    `process_manager trace` 从环中统计各阶段耗时的分位数
+ */
+
+#ifndef PM_METRICS_H
+#define PM_METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 指标共享内存的 System V IPC 键值
+ */
+#define PM_METRICS_KEY 0x56781250
+
+/**
+ * @brief 最大线程槽位数
+ */
+#define PM_METRICS_MAX_SLOTS 16
+
+/**
+ * @brief 按命令码统计 RTT 的最大命令数
+ */
+#define PM_METRICS_MAX_CMDS 32
+
+/**
+ * @brief 直方图桶数：桶0为0us，桶i（i>=1）为 [2^(i-1), 2^i) us，最后一桶包含更大的值
+ */
+#define PM_METRICS_HIST_BUCKETS 24
+
+/**
+ * @brief 跟踪环容量（条），保留最近完成的跟踪记录
+ */
+#define PM_METRICS_TRACE_RING 256
+
+/**
+ * @brief 计数器
+ */
+typedef enum {
+    PM_CNT_UART_RX_FRAMES = 0,    // 收到的串口帧
+    PM_CNT_UART_TX_FRAMES,        // 发出的串口帧
+    PM_CNT_UART_CRC_ERRORS,       // CRC 校验失败丢弃的帧
+    PM_CNT_UART_TIMEOUTS,         // 请求超时
+    PM_CNT_UART_RECONNECTS,       // 串口重连
+    PM_CNT_IPC_SENT,              // 发送的进程间消息
+    PM_CNT_IPC_RECEIVED,          // 收到的进程间消息
+    PM_CNT_IPC_ERRORS,            // 进程间消息收发失败
+    PM_CNT_MQTT_PUBLISHED,        // 成功提交的 MQTT 发布
+    PM_CNT_MQTT_PUBLISH_ERRORS,   // 失败的 MQTT 发布
+    PM_CNT_MQTT_UPLOAD_BYTES,     // 文件上传发出的分片字节数（含重传）
+    PM_CNT_MQTT_UPLOAD_CHUNKS,    // 文件上传已确认的分片数
+    PM_CNT_UART_IO_CSW_VOLUNTARY,   // 串口 I/O 线程主动让出 CPU 的次数（等待事件）
+    PM_CNT_UART_IO_CSW_INVOLUNTARY, // 串口 I/O 线程被抢占的次数，调度配置是否生效看这一项
+    PM_CNT_COUNT
+} pm_counter_t;
+
+/**
+ * @brief 延迟直方图
+ */
+typedef enum {
+    PM_HIST_UART_RTT = 0,         // 串口请求往返时间（写出到收到响应）
+    PM_HIST_MQTT_PUBLISH,         // MQTT 异步发布延迟（提交到 PUBACK）
+    PM_HIST_COUNT
+} pm_hist_t;
+
+/**
+ * @brief 端到端跟踪阶段（测量结果从拍摄到发布）
+ * @details 时间戳均为 pm_metrics_now_us（CLOCK_MONOTONIC 全系统共享），0 表示该阶段不适用，
+ *          例如 VPSS 直接测量没有传输和解码阶段
+ */
+typedef enum {
+    PM_TRACE_CAPTURED = 0,        // 拍摄（Air8000 上报的拍摄时间换算到本机时钟）
+    PM_TRACE_TRANSFERRED,         // 文件接收完成
+    PM_TRACE_DECODED,             // 图像解码完成
+    PM_TRACE_MEASURED,            // 测量完成
+    PM_TRACE_QUEUED,              // 结果写入进程间消息队列
+    PM_TRACE_PUBLISHED,           // 结果已由 MQTT 发布
+    PM_TRACE_STAGE_COUNT
+} pm_trace_stage_t;
+
+/**
+ * @brief 跟踪记录
+ */
+typedef struct {
+    uint32_t trace_id;                            // 跟踪ID
+    uint32_t reserved;                            // 保留
+    uint64_t stage_us[PM_TRACE_STAGE_COUNT];      // 各阶段时间戳（微秒）
+} pm_trace_record_t;
+
+/**
+ * @brief 直方图数据
+ */
+typedef struct {
+    uint64_t count;                               // 样本数
+    uint64_t sum_us;                              // 样本总和（微秒）
+    uint64_t max_us;                              // 最大值（微秒）
+    uint64_t buckets[PM_METRICS_HIST_BUCKETS];    // 各桶样本数
+} pm_hist_data_t;
+
+/**
+ * @brief 线程槽位（位于共享内存中）
+ */
+typedef struct {
+    uint64_t owner;                               // 属主：高32位进程ID，低32位线程ID，0表示空闲
+    uint64_t counters[PM_CNT_COUNT];              // 计数器
+    pm_hist_data_t hists[PM_HIST_COUNT];          // 延迟直方图
+    pm_hist_data_t cmd_rtt[PM_METRICS_MAX_CMDS];  // 按命令码的 RTT，下标对应 cmd_ids
+} __attribute__((aligned(64))) pm_metrics_slot_t;
+
+/**
+ * @brief 指标共享内存布局
+ */
+typedef struct {
+    uint32_t magic;                               // 初始化完成标志
+    uint32_t slot_size;                           // sizeof(pm_metrics_slot_t)，用于识别布局不一致
+    uint64_t created_ms;                          // 创建时间（CLOCK_REALTIME，毫秒）
+    uint32_t cmd_ids[PM_METRICS_MAX_CMDS];        // 命令码登记表，值为 cmd+1，0表示空
+    uint32_t next_trace_id;                       // 下一个跟踪ID
+    uint32_t reserved;                            // 保留
+    uint64_t trace_head;                          // 跟踪环已写入的总条数
+    uint64_t trace_seq[PM_METRICS_TRACE_RING];    // 各条目的序号锁：奇数表示正在写，偶数为 2*(写入序号+1)
+    pm_trace_record_t traces[PM_METRICS_TRACE_RING];
+    pm_metrics_slot_t slots[PM_METRICS_MAX_SLOTS];
+} pm_metrics_shm_t;
+
+/**
+ * @brief 所有槽位汇总后的快照
+ */
+typedef struct {
+    uint64_t created_ms;                          // 共享内存创建时间
+    uint64_t taken_ms;                            // 快照时间（CLOCK_REALTIME，毫秒）
+    uint32_t slots_used;                          // 当前被线程占用的槽位数
+    uint64_t counters[PM_CNT_COUNT];
+    pm_hist_data_t hists[PM_HIST_COUNT];
+    uint32_t cmd_count;                           // 有效命令数
+    uint16_t cmds[PM_METRICS_MAX_CMDS];           // 命令码
+    pm_hist_data_t cmd_rtt[PM_METRICS_MAX_CMDS];  // 对应 RTT
+} pm_metrics_snapshot_t;
+
+// ==================== 生命周期 ====================
+
+/**
+ * @brief 创建并初始化指标共享内存（进程管理器调用，已存在时重建）
+ * @return 成功返回0，失败返回-1
+ */
+int pm_metrics_create(void);
+
+/**
+ * @brief 附加到已存在的指标共享内存（子进程和统计命令调用）
+ * @return 成功返回0，不存在或布局不一致返回-1（之后的记录为空操作）
+ */
+int pm_metrics_attach(void);
+
+/**
+ * @brief 解除映射
+ */
+void pm_metrics_detach(void);
+
+/**
+ * @brief 解除映射并删除指标共享内存（进程管理器退出时调用）
+ */
+void pm_metrics_destroy(void);
+
+/**
+ * @brief 是否已附加
+ * @return 已附加返回true
+ */
+bool pm_metrics_attached(void);
+
+// ==================== 记录（热路径） ====================
+
+/**
+ * @brief 计数器加 n
+ * @param counter 计数器
+ * @param n 增量
+ */
+void pm_metrics_add(pm_counter_t counter, uint64_t n);
+
+/**
+ * @brief 记录一个延迟样本
+ * @param hist 直方图
+ * @param us 延迟（微秒）
+ */
+void pm_metrics_observe(pm_hist_t hist, uint64_t us);
+
+/**
+ * @brief 记录一个串口请求的 RTT（同时计入 PM_HIST_UART_RTT）
+ * @param cmd 命令码，登记表已满时只计入总直方图
+ * @param us 往返时间（微秒）
+ */
+void pm_metrics_observe_cmd(uint16_t cmd, uint64_t us);
+
+/**
+ * @brief 单调时钟微秒数，用于计算延迟
+ * @return 微秒时间戳
+ */
+uint64_t pm_metrics_now_us(void);
+
+// ==================== 跟踪 ====================
+
+/**
+ * @brief 分配一个跟踪ID
+ * @return 非0的跟踪ID；未附加时从进程内计数器分配（高位为进程ID，避免与其他进程重复）
+ */
+uint32_t pm_metrics_trace_id(void);
+
+/**
+ * @brief 把一条已完成的跟踪记录写入跟踪环
+ * @param record 跟踪记录，trace_id 为0时忽略
+ */
+void pm_metrics_trace_record(const pm_trace_record_t *record);
+
+/**
+ * @brief 读取跟踪环中的记录
+ * @param out 输出数组
+ * @param max 数组容量
+ * @param since 只返回写入序号不小于 since 的记录，传0读取全部
+ * @param next 输出参数，下次调用传入的 since，可为NULL
+ * @return 读到的条数，未附加返回0
+ * @details 跳过正在写或读取期间被覆盖的条目
+ */
+size_t pm_metrics_trace_read(pm_trace_record_t *out, size_t max, uint64_t since, uint64_t *next);
+
+/**
+ * @brief 跟踪阶段名称
+ * @param stage 阶段
+ * @return 名称字符串
+ */
+const char *pm_metrics_stage_name(pm_trace_stage_t stage);
+
+/**
+ * @brief 打印各阶段耗时统计
+ * @param out 输出流
+ * @param records 跟踪记录
+ * @param count 记录条数
+ * @details 每个阶段的耗时为该阶段时间戳减去前一个有效阶段的时间戳，另外打印拍摄到发布的总耗时；
+ *          分位数由样本排序精确计算
+ */
+void pm_metrics_trace_print(FILE *out, const pm_trace_record_t *records, size_t count);
+
+// ==================== 读取 ====================
+
+/**
+ * @brief 汇总所有槽位
+ * @param snap 输出参数
+ * @return 成功返回0，未附加返回-1
+ */
+int pm_metrics_snapshot(pm_metrics_snapshot_t *snap);
+
+/**
+ * @brief 从直方图估算分位数
+ * @param hist 直方图
+ * @param q 分位（0~1）
+ * @return 分位数所在桶的上界（微秒），没有样本返回0
+ */
+uint64_t pm_metrics_percentile(const pm_hist_data_t *hist, double q);
+
+/**
+ * @brief 计数器名称
+ * @param counter 计数器
+ * @return 名称字符串
+ */
+const char *pm_metrics_counter_name(pm_counter_t counter);
+
+/**
+ * @brief 直方图名称
+ * @param hist 直方图
+ * @return 名称字符串
+ */
+const char *pm_metrics_hist_name(pm_hist_t hist);
+
+/**
+ * @brief 打印快照
+ * @param out 输出流
+ * @param snap 当前快照
+ * @param prev 上一次快照，非NULL时同时打印两次之间的速率
+ */
+void pm_metrics_print(FILE *out, const pm_metrics_snapshot_t *snap, const pm_metrics_snapshot_t *prev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PM_METRICS_H */
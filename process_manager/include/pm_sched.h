@@ -0,0 +1,138 @@
+/**
+ * @file pm_sched.h
+ * @brief 线程放置与实时调度配置
+ * @version 1.0
+ * @date 2026-10-15
+ *
+ * 设计要点：
+ * 1. **配置文件**：按段落（[名称]）描述 CPU 亲和性、调度策略、优先级、nice 和内存锁定，
+ *    进程管理器按进程名取段落作用于整个子进程，Air8000 SDK 取 [air8000_io] 作用于 I/O 反应器线程
+ * 2. **有界实时优先级**：SCHED_FIFO 优先级限制在 [1, PM_SCHED_FIFO_MAX_PRIORITY]，
+ *    低于内核线程化中断（50），串口中断仍能抢占 I/O 线程；内核 RT 限流保持默认
+ * 3. **内存锁定**：mlockall 不跨 exec 继承，进程管理器通过 PM_SCHED_MLOCK_ENV 环境变量
+ *    让子进程在 pm_sched_init_process 中自行锁定
+ * 4. **上下文切换计数**：线程周期调用 pm_sched_sample，把 getrusage(RUSAGE_THREAD) 的
+ *    主动/被动切换增量计入指标共享内存
+ *
+ * 配置文件示例：
+ * @code
+ * [air8000_uart]          # 进程管理器：UART 子进程
+ * cpus = 1
+ * mlock = 1
+ *
+ * [air8000_io]            # Air8000 SDK：串口 I/O 反应器线程
+ * cpus = 1
+ * policy = fifo
+ * priority = 40
+ *
+ * [air8000_mqtt]          # 进程管理器：MQTT 子进程（mosquitto 网络线程、上传线程随之继承）
+ * cpus = 0
+ * nice = 5
+ * @endcode
+ */
+
+#ifndef PM_SCHED_H
+#define PM_SCHED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "pm_metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 配置文件路径的环境变量名
+ */
+#define PM_SCHED_CONFIG_ENV "PM_SCHED_CONFIG"
+
+/**
+ * @brief 默认配置文件路径
+ */
+#define PM_SCHED_DEFAULT_CONFIG "/etc/air8000/sched.conf"
+
+/**
+ * @brief 要求子进程锁定内存的环境变量名（值为 "1"）
+ */
+#define PM_SCHED_MLOCK_ENV "PM_SCHED_MLOCK"
+
+/**
+ * @brief SCHED_FIFO 优先级上限
+ */
+#define PM_SCHED_FIFO_MAX_PRIORITY 49
+
+/**
+ * @brief pm_sched_sample 的最短采样间隔（毫秒）
+ */
+#define PM_SCHED_SAMPLE_MS 1000
+
+/**
+ * @brief 调度策略
+ */
+typedef enum {
+    PM_SCHED_POLICY_DEFAULT = 0,  // 不修改
+    PM_SCHED_POLICY_OTHER,        // SCHED_OTHER（可配合 nice）
+    PM_SCHED_POLICY_FIFO          // SCHED_FIFO
+} pm_sched_policy_t;
+
+/**
+ * @brief 调度配置，全零表示不做任何修改
+ */
+typedef struct pm_sched_profile {
+    uint32_t cpu_mask;            // 允许运行的 CPU 位掩码，0 表示不限制
+    pm_sched_policy_t policy;     // 调度策略
+    int priority;                 // SCHED_FIFO 优先级，超出范围时截断
+    int nice;                     // SCHED_OTHER 的 nice 值，0 表示不修改
+    bool mlock;                   // 锁定进程内存，避免缺页带来的延迟
+} pm_sched_profile_t;
+
+/**
+ * @brief 从配置文件读取一个段落
+ * @param path 配置文件路径，NULL 时依次使用 PM_SCHED_CONFIG_ENV 和 PM_SCHED_DEFAULT_CONFIG
+ * @param section 段落名
+ * @param profile 输出参数，没有找到时清零
+ * @return 找到段落返回0，文件或段落不存在返回1，格式错误返回-1（错误行会打印）
+ */
+int pm_sched_load(const char *path, const char *section, pm_sched_profile_t *profile);
+
+/**
+ * @brief 把配置应用到调用线程
+ * @details 在 fork 之后、exec 之前调用时作用于整个子进程（亲和性、策略和 nice 跨 exec 继承）；
+ *          mlock 直接调用 mlockall。缺少权限（CAP_SYS_NICE、RLIMIT_RTPRIO、RLIMIT_MEMLOCK）
+ *          的项打印警告后跳过，其余项照常应用
+ * @param profile 调度配置，NULL 时什么也不做
+ * @return 全部应用成功返回0，有失败项返回-1
+ */
+int pm_sched_apply_thread(const pm_sched_profile_t *profile);
+
+/**
+ * @brief 子进程启动时应用进程管理器要求的进程级设置（目前只有内存锁定）
+ * @return 成功或无需设置返回0，失败返回-1
+ */
+int pm_sched_init_process(void);
+
+/**
+ * @brief 采样调用线程的上下文切换次数并计入指标
+ * @details 距上次采样不足 PM_SCHED_SAMPLE_MS 时直接返回，可放在线程主循环中每轮调用
+ * @param voluntary 主动切换（阻塞等待）计数器
+ * @param involuntary 被动切换（被抢占）计数器
+ */
+void pm_sched_sample(pm_counter_t voluntary, pm_counter_t involuntary);
+
+/**
+ * @brief 把配置格式化为一行说明，用于日志
+ * @param profile 调度配置
+ * @param buf 输出缓冲区
+ * @param size 缓冲区大小
+ * @return buf
+ */
+const char *pm_sched_describe(const pm_sched_profile_t *profile, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PM_SCHED_H */
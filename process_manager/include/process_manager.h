@@ -14,10 +14,30 @@
 #include <unistd.h>
 #include <sys/types.h>
 
+#include "shared_memory.h"
+#include "pm_sched.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief 就绪通知管道的环境变量名
+ * @details 配置了 notify_ready 的进程启动时，该变量给出管道写端的文件描述符，
+ *          子进程初始化完成后调用 process_notify_ready 写入 "READY=1"
+ */
+#define PROCESS_NOTIFY_FD_ENV "PM_NOTIFY_FD"
+
+/**
+ * @brief 监管器最多管理的进程数
+ */
+#define PROCESS_SUPERVISOR_MAX 8
+
+/**
+ * @brief 崩溃预算最多记录的崩溃次数
+ */
+#define PROCESS_CRASH_HISTORY 16
+
 /**
  * @brief 进程状态枚举
  */
@@ -26,7 +46,9 @@ typedef enum {
     PROC_STATE_RUNNING,       // 运行中
     PROC_STATE_STOPPED,       // 已停止
     PROC_STATE_EXITED,        // 已退出
-    PROC_STATE_ERROR          // 错误状态
+    PROC_STATE_ERROR,         // 错误状态
+    PROC_STATE_BACKOFF,       // 已退出，等待退避延迟后重启
+    PROC_STATE_FAILED         // 崩溃次数超出预算，不再重启
 } process_state_t;
 
 /**
@@ -49,6 +71,25 @@ typedef struct {
     char cmd[256];             // 命令行
     char args[512];            // 命令参数
     void *private_data;        // 私有数据指针
+    int pidfd;                 // 进程的 pidfd，内核不支持时为-1
+    int notify_fd;             // 就绪通知管道读端，未启用时为-1
+    bool notify_ready;         // 是否等待子进程的就绪通知
+    bool ready;                // 是否已就绪（未启用就绪通知时启动即就绪）
+    bool stop_requested;       // 是否由 process_stop 主动停止（不自动重启）
+    bool auto_restart;         // 是否自动重启
+    int restart_delay;         // 首次重启延迟（毫秒），之后每次连续崩溃翻倍
+    int max_restart_delay;     // 重启延迟上限（毫秒）
+    int stable_time;           // 运行超过该时间（毫秒）视为稳定，退避延迟复位
+    int crash_budget;          // crash_window 内允许的最大崩溃次数
+    int crash_window;          // 崩溃预算统计窗口（毫秒）
+    int ready_timeout;         // 等待就绪通知的超时（毫秒），超时视为崩溃
+    int backoff_level;         // 当前退避级数（连续崩溃次数）
+    uint32_t restart_count;    // 累计重启次数
+    uint64_t start_time;       // 最近一次启动时间（单调时钟，毫秒）
+    uint64_t next_restart_time; // 计划重启时间（单调时钟，毫秒）
+    uint64_t crash_times[PROCESS_CRASH_HISTORY]; // 最近的崩溃时间（环形记录）
+    uint32_t crash_head;       // crash_times 下一个写入位置
+    pm_sched_profile_t sched;  // 子进程的调度配置
 } process_t;
 
 /**
@@ -60,10 +101,25 @@ typedef struct {
     const char *cmd;           // 可执行文件路径
     const char *args;          // 命令参数
     bool auto_restart;         // 是否自动重启
-    int restart_delay;         // 重启延迟（毫秒）
+    int restart_delay;         // 首次重启延迟（毫秒），0使用默认值1000
     void *private_data;        // 私有数据
+    int max_restart_delay;     // 重启延迟上限（毫秒），0使用默认值60000
+    int stable_time;           // 运行超过该时间视为稳定（毫秒），0使用默认值30000
+    int crash_budget;          // 统计窗口内允许的崩溃次数，0使用默认值5
+    int crash_window;          // 崩溃预算统计窗口（毫秒），0使用默认值300000
+    bool notify_ready;         // 是否等待子进程调用 process_notify_ready
+    int ready_timeout;         // 等待就绪的超时（毫秒），0使用默认值30000
+    pm_sched_profile_t sched;  // 调度配置（CPU 亲和性、策略、nice、内存锁定），全零不修改
 } process_config_t;
 
+/**
+ * @brief 进程监管器（不透明结构体）
+ * @details 用一个 epoll 监听所有子进程的 pidfd 和就绪通知管道，内核不支持 pidfd 时
+ *          退回到 signalfd(SIGCHLD)。子进程退出后按指数退避重启，退避延迟和崩溃预算
+ *          都用定时计算而不是睡眠，不会阻塞调用方的主循环。不加锁，所有调用必须在同一线程
+ */
+typedef struct process_supervisor process_supervisor_t;
+
 /**
  * @brief 创建进程
  * @param config 进程配置指针
@@ -80,6 +136,7 @@ int process_start(process_t *process);
 
 /**
  * @brief 停止进程
+ * @details 处于退避等待的进程取消计划中的重启，此后监管器不再启动它
  * @param process 进程结构体指针
  * @param timeout_ms 超时时间（毫秒）
  * @return 成功返回0，失败返回-1
@@ -127,6 +184,7 @@ int process_wait(process_t *process, int timeout_ms);
  * @param process 进程结构体指针
  * @param delay_ms 延迟时间（毫秒）
  * @return 成功返回0，失败返回-1
+ * @note 在调用线程中睡眠 delay_ms；常驻子进程请交给进程监管器按退避策略重启
  */
 int process_restart(process_t *process, int delay_ms);
 
@@ -137,6 +195,75 @@ int process_restart(process_t *process, int delay_ms);
  */
 pid_t process_get_pid(const process_t *process);
 
+/**
+ * @brief 子进程通知监管器已就绪
+ * @details 不是由监管器启动（没有 PROCESS_NOTIFY_FD_ENV 环境变量）时什么也不做
+ * @return 成功或无需通知返回0，失败返回-1
+ */
+int process_notify_ready(void);
+
+// ==================== 进程监管器 ====================
+
+/**
+ * @brief 创建进程监管器
+ * @return 成功返回监管器指针，失败返回NULL
+ */
+process_supervisor_t* process_supervisor_create(void);
+
+/**
+ * @brief 销毁进程监管器
+ * @details 只停止监听，不停止进程；之后请用 process_stop/process_destroy 清理进程
+ * @param sup 监管器指针
+ */
+void process_supervisor_destroy(process_supervisor_t *sup);
+
+/**
+ * @brief 把进程交给监管器
+ * @param sup 监管器指针
+ * @param process 进程结构体指针
+ * @param depends_on 依赖的进程，该进程就绪后才启动 process；NULL表示无依赖
+ * @return 成功返回0，失败返回-1
+ */
+int process_supervisor_add(process_supervisor_t *sup, process_t *process, process_t *depends_on);
+
+/**
+ * @brief 启动所有依赖已满足的进程，其余进程在依赖就绪后由 process_supervisor_dispatch 启动
+ * @param sup 监管器指针
+ * @return 成功返回0，有进程启动失败返回-1（失败的进程按退避策略重试）
+ */
+int process_supervisor_start(process_supervisor_t *sup);
+
+/**
+ * @brief 设置子进程共用的共享内存池
+ * @details 设置后子进程退出时，它从池内队列取出还没释放的段会重新排回队列头部，
+ *          由重启后的进程接着处理；它申请后还没提交的段释放回池（见 shm_seg_reclaim）
+ * @param sup 监管器指针
+ * @param shm 共享内存句柄，NULL表示不处理
+ */
+void process_supervisor_set_shm(process_supervisor_t *sup, shm_handle_t *shm);
+
+/**
+ * @brief 获取监管器的事件描述符，可放进调用方的 poll/epoll
+ * @param sup 监管器指针
+ * @return 文件描述符，可读时调用 process_supervisor_dispatch
+ */
+int process_supervisor_get_fd(const process_supervisor_t *sup);
+
+/**
+ * @brief 距下一次定时动作（退避重启、就绪超时）的时间
+ * @param sup 监管器指针
+ * @return 毫秒数，没有待处理的定时动作返回-1
+ */
+int process_supervisor_next_timeout(const process_supervisor_t *sup);
+
+/**
+ * @brief 等待并处理子进程事件：回收退出的进程、安排退避重启、处理就绪通知和到期的定时动作
+ * @param sup 监管器指针
+ * @param timeout_ms 最长等待时间（毫秒），0不等待，-1一直等到下一个事件或定时动作
+ * @return 成功返回0，失败返回-1
+ */
+int process_supervisor_dispatch(process_supervisor_t *sup, int timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,8 +1,16 @@
 /**
  * @file shared_memory.h
  * @brief 共享内存模块头文件
- * @version 1.0
+ * @version 1.1
  * @date 2026-01-22
+ *
+ * 共享内存是一个跨进程的分级缓冲池（slab）：
+ * 1. **多级段**：按配置划分若干尺寸等级，每级若干个段，申请时取能容纳数据的最小一级
+ * 2. **引用计数**：段可以通过句柄在进程间传递（例如放进消息队列消息），
+ *    每个持有者 release 一次，计数归零时段回到空闲链表
+ * 3. **FIFO**：push 进池内队列的段按 seq_num 先进先出被 pop
+ * 4. **阻塞等待**：控制块中的互斥锁和条件变量设置为进程间共享，
+ *    申请和读取都可以带超时阻塞；互斥锁为 robust 类型，持锁进程崩溃后可恢复
  */
 
 #ifndef SHARED_MEMORY_H
@@ -11,6 +19,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -25,53 +34,95 @@ extern "C" {
 #define SHARED_MEM_NAME "/air8000_shared_memory"
 
 /**
- * @brief 共享内存大小定义
+ * @brief 最大尺寸等级数
  */
-#define SHARED_MEM_SIZE (16 * 1024)  // 扩展到16KB
+#define SHARED_MEM_MAX_CLASSES 4
 
 /**
- * @brief 共享内存段数量
+ * @brief 最大段数（所有等级合计）
  */
-#define SHARED_MEM_SEGMENTS 4
+#define SHARED_MEM_MAX_SEGMENTS 128
 
 /**
- * @brief 单个共享内存段大小
+ * @brief 无效段句柄
  */
-#define SHARED_MEM_SEG_SIZE (SHARED_MEM_SIZE / SHARED_MEM_SEGMENTS)
+#define SHARED_MEM_SEG_INVALID 0xFFFFFFFFU
 
 /**
  * @brief 共享内存段状态枚举
  */
 typedef enum {
     SHARED_MEM_SEG_FREE = 0,      // 段空闲
-    SHARED_MEM_SEG_USED = 1,      // 段已使用
-    SHARED_MEM_SEG_LOCKED = 2     // 段被锁定
+    SHARED_MEM_SEG_USED = 1,      // 段已提交到池内队列，等待读取
+    SHARED_MEM_SEG_LOCKED = 2     // 段已被持有（写入中或已被读取方取出）
 } shared_mem_seg_state_t;
 
 /**
- * @brief 共享内存段结构体
+ * @brief 尺寸等级配置
+ */
+typedef struct {
+    uint32_t seg_size;            // 段大小（字节）
+    uint32_t seg_count;           // 段数量
+} shared_mem_class_cfg_t;
+
+/**
+ * @brief 共享内存池配置结构体
+ */
+typedef struct {
+    uint32_t class_count;                                // 有效等级数
+    shared_mem_class_cfg_t classes[SHARED_MEM_MAX_CLASSES]; // 各等级配置，按 seg_size 升序
+} shared_mem_config_t;
+
+/**
+ * @brief 共享内存段描述符
+ * @details 数据区以相对共享内存起始地址的偏移记录，各进程映射地址不同也可直接使用
  */
 typedef struct {
     shared_mem_seg_state_t state;  // 段状态
-    uint32_t owner_pid;           // 所有者进程ID
+    uint32_t owner_pid;           // 最近一次申请或取出该段的进程ID
     uint32_t data_len;            // 段内数据长度
-    uint32_t seq_num;             // 数据序列号
-    uint8_t data[SHARED_MEM_SEG_SIZE];  // 段数据缓冲区
+    uint32_t seq_num;             // 数据序列号（push 时分配，决定 FIFO 顺序）
+    uint32_t refcount;            // 引用计数
+    uint16_t class_idx;           // 所属尺寸等级
+    uint16_t generation;          // 段每次被申请时递增，用于识别过期句柄
+    uint32_t next;                // 空闲链表或 FIFO 队列中的下一个段
+    uint32_t capacity;            // 段容量（字节）
+    uint64_t data_offset;         // 数据区偏移
 } shared_mem_segment_t;
 
+/**
+ * @brief 尺寸等级运行状态
+ */
+typedef struct {
+    uint32_t seg_size;            // 段大小
+    uint32_t seg_count;           // 段数量
+    uint32_t free_head;           // 空闲链表头
+    uint32_t free_count;          // 空闲段数
+} shared_mem_class_t;
+
 /**
  * @brief 共享内存控制块
  */
 typedef struct {
-    pthread_mutex_t mutex;                // 互斥锁，用于同步访问
-    pthread_cond_t cond;                  // 条件变量，用于通知数据更新
+    pthread_mutex_t mutex;                // 互斥锁，进程间共享
+    pthread_cond_t cond;                  // 条件变量，有段提交到队列时通知
+    pthread_cond_t free_cond;             // 条件变量，有段被释放时通知
+    uint32_t magic;                       // 初始化完成标志
+    uint32_t class_count;                 // 有效等级数
     uint32_t total_segments;              // 总段数
     uint32_t free_segments;               // 空闲段数
-    shared_mem_segment_t segments[SHARED_MEM_SEGMENTS];  // 共享内存段数组
+    uint32_t next_seq;                    // 下一个序列号
+    uint32_t queue_head;                  // FIFO 队列头
+    uint32_t queue_tail;                  // FIFO 队列尾
+    uint32_t queue_len;                   // FIFO 队列长度
+    uint64_t total_size;                  // 共享内存总大小
+    shared_mem_class_t classes[SHARED_MEM_MAX_CLASSES];   // 尺寸等级
+    shared_mem_segment_t segments[SHARED_MEM_MAX_SEGMENTS]; // 段描述符数组
 } shared_mem_ctrl_t;
 
 /**
  * @brief 共享内存数据结构
+ * @details 控制块之后依次为各等级段的数据区
  */
 typedef struct {
     shared_mem_ctrl_t ctrl;      // 共享内存控制块
@@ -86,12 +137,25 @@ typedef struct {
 } shm_handle_t;
 
 /**
- * @brief 创建并初始化共享内存
+ * @brief 默认池配置：4KB × 32（消息、传感器数据）、64KB × 16（固件分片）、1MB × 4（图片）
+ */
+extern const shared_mem_config_t SHARED_MEM_DEFAULT_CONFIG;
+
+/**
+ * @brief 创建并初始化共享内存（使用默认配置）
  * @param handle 共享内存句柄指针
  * @return 成功返回0，失败返回-1
  */
 int shm_create(shm_handle_t *handle);
 
+/**
+ * @brief 按指定配置创建并初始化共享内存
+ * @param handle 共享内存句柄指针
+ * @param config 池配置，NULL 表示默认配置
+ * @return 成功返回0，失败返回-1
+ */
+int shm_create_pool(shm_handle_t *handle, const shared_mem_config_t *config);
+
 /**
  * @brief 打开已存在的共享内存
  * @param handle 共享内存句柄指针
@@ -99,18 +163,105 @@ int shm_create(shm_handle_t *handle);
  */
 int shm_open_existing(shm_handle_t *handle);
 
+/**
+ * @brief 解除映射但不删除共享内存（打开方使用）
+ * @param handle 共享内存句柄指针
+ */
+void shm_close(shm_handle_t *handle);
+
 /**
  * @brief 关闭并销毁共享内存
  * @param handle 共享内存句柄指针
  */
 void shm_destroy(shm_handle_t *handle);
 
+/**
+ * @brief 申请一个段
+ * @param handle 共享内存句柄指针
+ * @param size 需要的容量（字节）
+ * @param timeout_ms 没有空闲段时的等待时间（毫秒），-1表示无限等待，0表示不等待
+ * @param seg 输出段句柄，引用计数为1
+ * @return 成功返回0，超时返回1，大小超过最大等级或参数错误返回-1
+ */
+int shm_seg_alloc(shm_handle_t *handle, size_t size, int timeout_ms, uint32_t *seg);
+
+/**
+ * @brief 获取段数据区指针
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @param capacity 输出段容量，可为NULL
+ * @return 数据区指针，句柄无效返回NULL
+ */
+uint8_t *shm_seg_data(shm_handle_t *handle, uint32_t seg, size_t *capacity);
+
+/**
+ * @brief 设置段内数据长度
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @param len 数据长度
+ * @return 成功返回0，失败返回-1
+ */
+int shm_seg_set_len(shm_handle_t *handle, uint32_t seg, size_t len);
+
+/**
+ * @brief 获取段内数据长度
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @return 数据长度，句柄无效返回0
+ */
+size_t shm_seg_len(shm_handle_t *handle, uint32_t seg);
+
+/**
+ * @brief 增加段引用（例如把段句柄同时交给多个接收方）
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @return 成功返回0，失败返回-1
+ */
+int shm_seg_ref(shm_handle_t *handle, uint32_t seg);
+
+/**
+ * @brief 释放段引用，计数归零时段回到空闲链表
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @return 成功返回0，失败返回-1
+ */
+int shm_seg_release(shm_handle_t *handle, uint32_t seg);
+
+/**
+ * @brief 把段提交到池内 FIFO 队列
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄，调用方的引用转交给队列
+ * @return 成功返回0，失败返回-1
+ */
+int shm_seg_push(shm_handle_t *handle, uint32_t seg);
+
+/**
+ * @brief 从池内 FIFO 队列取出最早提交的段
+ * @param handle 共享内存句柄指针
+ * @param timeout_ms 超时时间（毫秒），-1表示无限等待，0表示不等待
+ * @param seg 输出段句柄，调用方持有一个引用，用完需 shm_seg_release
+ * @return 成功返回0，超时返回1，失败返回-1
+ */
+int shm_seg_pop(shm_handle_t *handle, int timeout_ms, uint32_t *seg);
+
+/**
+ * @brief 回收已退出进程持有的段
+ * @param handle 共享内存句柄指针
+ * @param pid 已退出的进程ID
+ * @return 重新排队和释放的段数之和，失败返回-1
+ * @details 按属主进程匹配：该进程从 FIFO 队列取出、只剩它一个引用的段按原来的顺序放回队列头部，
+ *          重启后的进程会重新取出（同一段可能被处理两次）；申请后还没提交的段丢弃它的引用，
+ *          计数归零时回到空闲链表
+ */
+int shm_seg_reclaim(shm_handle_t *handle, pid_t pid);
+
 /**
  * @brief 写入数据到共享内存
  * @param handle 共享内存句柄指针
  * @param data 要写入的数据指针
  * @param len 数据长度
  * @return 成功返回0，失败返回-1
+ * @note 等价于 alloc（不等待）+ 拷贝 + push
  */
 int shm_write(shm_handle_t *handle, const uint8_t *data, size_t len);
 
@@ -121,20 +272,21 @@ int shm_write(shm_handle_t *handle, const uint8_t *data, size_t len);
  * @param len 缓冲区长度
  * @param timeout_ms 超时时间（毫秒），-1表示无限等待
  * @return 成功返回实际读取的数据长度，失败返回-1，超时返回0
+ * @note 等价于 pop + 拷贝 + release
  */
 ssize_t shm_read(shm_handle_t *handle, uint8_t *data, size_t len, int timeout_ms);
 
 /**
  * @brief 获取共享内存当前数据长度
  * @param handle 共享内存句柄指针
- * @return 数据长度
+ * @return 队列中最早一段的数据长度
  */
 size_t shm_get_data_len(shm_handle_t *handle);
 
 /**
  * @brief 检查共享内存数据是否就绪
  * @param handle 共享内存句柄指针
- * @return 就绪返回true，否则返回false
+ * @return 队列非空返回true，否则返回false
  */
 bool shm_is_ready(shm_handle_t *handle);
 
@@ -0,0 +1,136 @@
+/**
+ * @file shm_ring.h
+ * @brief 共享内存环形队列头文件
+ * @version 1.0
+ * @date 2026-10-14
+ *
+ * 设计要点：
+ * 1. **单生产者/单消费者**：head 只由生产者推进，tail 只由消费者推进，收发路径无需互斥锁；
+ *    同一方向上偶尔存在多个发送者或接收者（例如进程管理器控制台），各自一侧用一个
+ *    进程共享的健壮互斥锁串行化，无竞争时只有一次原子操作；持锁进程崩溃时下一个加锁者恢复本侧状态
+ * 2. **变长记录**：每条记录为 4 字节长度 + 数据，按 8 字节对齐；写到末尾放不下时写入填充记录回绕
+ * 3. **futex 唤醒**：接收方在 data_seq 上做带超时的 FUTEX_WAIT，发送方只在有等待者时才唤醒，
+ *    不再轮询
+ */
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 默认环形缓冲区数据区大小（字节，必须为 2 的幂）
+ */
+#define SHM_RING_DEFAULT_CAPACITY (64 * 1024)
+
+/**
+ * @brief 环形缓冲区头部（位于共享内存起始处）
+ * @details 生产者和消费者使用的字段分别从新的缓存行开始，避免伪共享
+ */
+typedef struct {
+    uint32_t magic;               // 魔数，标识环已初始化
+    uint32_t capacity;            // 数据区大小（字节）
+    uint32_t creator_pid;         // 创建者进程ID
+    uint32_t count;               // 当前记录数（仅用于统计）
+
+    uint32_t head __attribute__((aligned(64))); // 写位置（单调递增，取模定位）
+    uint32_t space_seq;           // 消费者释放空间后递增，生产者在此等待
+    uint32_t prod_waiters;        // 等待空间的生产者数
+    pthread_mutex_t prod_lock;    // 生产者侧锁（进程共享、健壮）
+
+    uint32_t tail __attribute__((aligned(64))); // 读位置（单调递增，取模定位）
+    uint32_t data_seq;            // 生产者发布记录后递增，消费者在此等待
+    uint32_t cons_waiters;        // 等待数据的消费者数
+    pthread_mutex_t cons_lock;    // 消费者侧锁（进程共享、健壮）
+
+    uint8_t data[] __attribute__((aligned(64))); // 数据区
+} shm_ring_hdr_t;
+
+/**
+ * @brief 环形缓冲区句柄
+ */
+typedef struct {
+    int shm_id;                   // 共享内存ID
+    shm_ring_hdr_t *hdr;          // 共享内存映射指针
+} shm_ring_t;
+
+/**
+ * @brief 创建环形缓冲区（已存在时重新初始化）
+ * @param ring 句柄指针
+ * @param key System V IPC 键值
+ * @param capacity 数据区大小，0 表示使用默认值，非 2 的幂时向上取整
+ * @return 成功返回0，失败返回-1
+ */
+int shm_ring_create(shm_ring_t *ring, key_t key, size_t capacity);
+
+/**
+ * @brief 打开已存在且已初始化的环形缓冲区
+ * @param ring 句柄指针
+ * @param key System V IPC 键值
+ * @return 成功返回0，不存在或未初始化返回-1
+ */
+int shm_ring_open(shm_ring_t *ring, key_t key);
+
+/**
+ * @brief 解除映射
+ * @param ring 句柄指针
+ */
+void shm_ring_close(shm_ring_t *ring);
+
+/**
+ * @brief 删除环形缓冲区对应的共享内存
+ * @param key System V IPC 键值
+ * @return 成功返回0，不存在或失败返回-1
+ */
+int shm_ring_unlink(key_t key);
+
+/**
+ * @brief 写入一条记录，空间不足时阻塞等待
+ * @param ring 句柄指针
+ * @param hdr 记录头部数据
+ * @param hdr_len 头部长度
+ * @param body 记录正文数据，可为 NULL
+ * @param body_len 正文长度
+ * @return 成功返回0，记录超过容量返回-1
+ * @details 头部和正文依次拷入同一条记录，调用方不需要先拼接
+ */
+int shm_ring_write(shm_ring_t *ring, const void *hdr, size_t hdr_len,
+                   const void *body, size_t body_len);
+
+/**
+ * @brief 写入一条记录，空间不足时最多等待 timeout_ms
+ * @param ring 句柄指针
+ * @param hdr 记录头部数据
+ * @param hdr_len 头部长度
+ * @param body 记录正文数据，可为 NULL
+ * @param body_len 正文长度
+ * @param timeout_ms 超时时间（毫秒），-1 表示无限等待，0 表示不等待
+ * @return 成功返回0，超时返回1，记录超过容量返回-1
+ * @details 用于消费者可能不在线的场合，生产者不会因此永久阻塞
+ */
+int shm_ring_write_timeout(shm_ring_t *ring, const void *hdr, size_t hdr_len,
+                           const void *body, size_t body_len, int timeout_ms);
+
+/**
+ * @brief 读取一条记录
+ * @param ring 句柄指针
+ * @param buf 接收缓冲区
+ * @param buf_len 缓冲区长度
+ * @param timeout_ms 超时时间（毫秒），-1 表示无限等待，0 表示不等待
+ * @return 成功返回记录长度（超出 buf_len 的部分被截断），超时返回0，失败返回-1
+ */
+ssize_t shm_ring_read(shm_ring_t *ring, void *buf, size_t buf_len, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHM_RING_H */
@@ -0,0 +1,221 @@
+/**
+ * @file fota_relay.c
+ * @brief FOTA 固件流式转发通道实现
+ * @version 1.0
+ * @date 2026-10-14
+ */
+
+#include "fota_relay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief 写入一条记录，超时后当前会话停止转发
+ * @param relay 句柄指针
+ * @param record 记录头部
+ * @param body 正文，可为 NULL
+ * @param body_len 正文长度
+ * @return 成功返回0，失败返回-1
+ */
+static int relay_write(fota_relay_t *relay, const fota_relay_record_t *record,
+                       const void *body, size_t body_len) {
+    int ret = shm_ring_write_timeout(&relay->ring, record, sizeof(*record), body, body_len,
+                                     FOTA_RELAY_WRITE_TIMEOUT_MS);
+    if (ret != 0) {
+        fprintf(stderr, "fota_relay: session %u %s, stop relaying\n", relay->session,
+                ret > 0 ? "consumer not draining" : "record too large");
+        relay->detached = true;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 创建转发通道（生产者）
+ * @details 初始为 detached，fota_relay_begin 之前不会写入任何记录
+ * @param relay 句柄指针
+ * @return 成功返回0，失败返回-1
+ */
+int fota_relay_create(fota_relay_t *relay) {
+    if (relay == NULL) {
+        return -1;
+    }
+    memset(relay, 0, sizeof(*relay));
+    if (shm_ring_create(&relay->ring, FOTA_RELAY_KEY, FOTA_RELAY_CAPACITY) != 0) {
+        return -1;
+    }
+    relay->open = true;
+    // 以启动时间作为会话号起点，UART 侧不会把上次运行残留的记录当成新会话
+    relay->session = (uint32_t)time(NULL);
+    relay->detached = true;
+    return 0;
+}
+
+/**
+ * @brief 打开转发通道（消费者），并分配一条最大记录大小的接收缓冲区
+ * @param relay 句柄指针
+ * @return 成功返回0，内存不足或通道不存在返回-1
+ */
+int fota_relay_open(fota_relay_t *relay) {
+    if (relay == NULL) {
+        return -1;
+    }
+    memset(relay, 0, sizeof(*relay));
+    relay->rx_buf = (uint8_t *)malloc(sizeof(fota_relay_record_t) + FOTA_RELAY_MAX_DATA);
+    if (relay->rx_buf == NULL) {
+        return -1;
+    }
+    if (shm_ring_open(&relay->ring, FOTA_RELAY_KEY) != 0) {
+        free(relay->rx_buf);
+        relay->rx_buf = NULL;
+        return -1;
+    }
+    relay->open = true;
+    return 0;
+}
+
+/**
+ * @brief 关闭转发通道并释放接收缓冲区
+ * @param relay 句柄指针
+ * @param unlink 是否同时删除共享内存（仅创建方）
+ */
+void fota_relay_close(fota_relay_t *relay, bool unlink) {
+    if (relay == NULL || !relay->open) {
+        return;
+    }
+    shm_ring_close(&relay->ring);
+    if (unlink) {
+        shm_ring_unlink(FOTA_RELAY_KEY);
+    }
+    free(relay->rx_buf);
+    relay->rx_buf = NULL;
+    relay->open = false;
+}
+
+/**
+ * @brief 开始一次转发会话，写入 START 记录
+ * @details 上一个会话仍在转发时先写 ABORT 结束它
+ * @param relay 句柄指针
+ * @param firmware_size 固件总大小
+ * @param path 固件文件路径，可为 NULL
+ * @return 成功返回新会话号，START 写入失败返回0
+ */
+uint32_t fota_relay_begin(fota_relay_t *relay, uint32_t firmware_size, const char *path) {
+    if (relay == NULL || !relay->open) {
+        return 0;
+    }
+
+    // 上一个会话未正常结束时先通知 UART 侧放弃
+    if (!relay->detached) {
+        fota_relay_end(relay, false);
+    }
+
+    relay->session++;
+    if (relay->session == 0) {
+        relay->session = 1;
+    }
+    relay->sent = 0;
+    relay->detached = false;
+
+    fota_relay_start_t start;
+    memset(&start, 0, sizeof(start));
+    start.firmware_size = firmware_size;
+    if (path != NULL) {
+        strncpy(start.path, path, sizeof(start.path) - 1);
+    }
+    fota_relay_record_t record = { FOTA_RELAY_START, relay->session, 0, 0 };
+    if (relay_write(relay, &record, &start, sizeof(start)) != 0) {
+        return 0;
+    }
+    return relay->session;
+}
+
+/**
+ * @brief 转发一段固件数据，超过 FOTA_RELAY_MAX_DATA 时拆成多条 DATA 记录
+ * @param relay 句柄指针
+ * @param offset 数据偏移，必须等于已转发的字节数
+ * @param data 数据
+ * @param len 数据长度
+ * @return 成功返回0；会话已停止转发、偏移不连续或写入超时返回-1
+ */
+int fota_relay_send(fota_relay_t *relay, uint32_t offset, const void *data, size_t len) {
+    if (relay == NULL || !fota_relay_active(relay)) {
+        return -1;
+    }
+    if (offset != relay->sent) {
+        // 数据必须连续，出现空洞说明调用方逻辑错误，本会话放弃转发
+        fprintf(stderr, "fota_relay: session %u offset %u, expected %u\n", relay->session, offset, relay->sent);
+        relay->detached = true;
+        return -1;
+    }
+
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0) {
+        size_t n = len < FOTA_RELAY_MAX_DATA ? len : FOTA_RELAY_MAX_DATA;
+        fota_relay_record_t record = { FOTA_RELAY_DATA, relay->session, relay->sent, (uint32_t)n };
+        if (relay_write(relay, &record, p, n) != 0) {
+            return -1;
+        }
+        relay->sent += (uint32_t)n;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 结束转发会话，无论写入是否成功本会话都不再转发
+ * @param relay 句柄指针
+ * @param success true 写入 END，false 写入 ABORT
+ * @return 结束记录已写入返回0，失败返回-1
+ */
+int fota_relay_end(fota_relay_t *relay, bool success) {
+    if (relay == NULL || !fota_relay_active(relay)) {
+        return -1;
+    }
+    fota_relay_record_t record = { success ? FOTA_RELAY_END : FOTA_RELAY_ABORT, relay->session, relay->sent, 0 };
+    int ret = relay_write(relay, &record, NULL, 0);
+    relay->detached = true;
+    return ret;
+}
+
+/**
+ * @brief 当前会话是否仍在转发
+ * @param relay 句柄指针
+ * @return 已开始且未停止转发返回true
+ */
+bool fota_relay_active(const fota_relay_t *relay) {
+    return relay != NULL && relay->open && !relay->detached;
+}
+
+/**
+ * @brief 读取一条记录（消费者）
+ * @param relay 句柄指针
+ * @param record 输出参数，记录头部
+ * @param body 输出参数，指向 rx_buf 中的正文，下次调用前有效，可为 NULL
+ * @param timeout_ms 超时时间（毫秒），-1 表示无限等待
+ * @return 成功返回正文长度（>=0），超时返回-2，记录不完整或失败返回-1
+ */
+ssize_t fota_relay_recv(fota_relay_t *relay, fota_relay_record_t *record,
+                        const uint8_t **body, int timeout_ms) {
+    if (relay == NULL || !relay->open || relay->rx_buf == NULL || record == NULL) {
+        return -1;
+    }
+
+    size_t buf_len = sizeof(fota_relay_record_t) + FOTA_RELAY_MAX_DATA;
+    ssize_t n = shm_ring_read(&relay->ring, relay->rx_buf, buf_len, timeout_ms);
+    if (n == 0) {
+        return -2;
+    }
+    if (n < (ssize_t)sizeof(fota_relay_record_t) || (size_t)n > buf_len) {
+        return -1;
+    }
+
+    memcpy(record, relay->rx_buf, sizeof(*record));
+    if (body != NULL) {
+        *body = relay->rx_buf + sizeof(*record);
+    }
+    return n - (ssize_t)sizeof(*record);
+}
@@ -12,11 +12,13 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <time.h>
 
 #include "process_manager.h"
 #include "shared_memory.h"
 #include "message_queue.h"
+#include "pm_metrics.h"
 
 /**
  * @brief 全局变量，用于控制主循环
@@ -40,6 +42,11 @@ static int g_mq_mqtt_to_uart = -1;
 static process_t *g_uart_process = NULL;
 static process_t *g_mqtt_process = NULL;
 
+/**
+ * @brief 进程监管器
+ */
+static process_supervisor_t *g_supervisor = NULL;
+
 /**
  * @brief 序列号计数器
  */
@@ -114,6 +121,7 @@ void print_menu() {
     printf("║    22. 电机使能           23. 电机禁用                   ║\n");
     printf("║    24. 电机旋转           25. 电机急停                   ║\n");
     printf("║    26. 获取位置           27. 获取所有状态               ║\n");
+    printf("║    28. 多轴联动                                          ║\n");
     printf("╠══════════════════════════════════════════════════════════╣\n");
     printf("║  [设备控制]                                              ║\n");
     printf("║    30. LED 控制           31. 风扇控制                   ║\n");
@@ -148,17 +156,15 @@ static void send_motor_command(uint8_t motor_id, float angle, float speed) {
     msg.timestamp = (uint32_t)time(NULL);
     
     // 构建电机控制数据：motor_id(1字节) + angle(4字节float) + speed(4字节float)
-    if (msg.data_len >= 9) {
-        msg.payload.data[0] = motor_id;
-        memcpy(&msg.payload.data[1], &angle, sizeof(float));
-        memcpy(&msg.payload.data[5], &speed, sizeof(float));
-        msg.data_len = 9;
-        
-        if (mq_send_msg(g_mq_mqtt_to_uart, &msg, 0) != 0) {
-            perror("mq_send motor command");
-        } else {
-            printf("电机控制命令已发送\n");
-        }
+    msg.payload.data[0] = motor_id;
+    memcpy(&msg.payload.data[1], &angle, sizeof(float));
+    memcpy(&msg.payload.data[5], &speed, sizeof(float));
+    msg.data_len = 9;
+    
+    if (mq_send_msg(g_mq_mqtt_to_uart, &msg, 0) != 0) {
+        perror("mq_send motor command");
+    } else {
+        printf("电机控制命令已发送\n");
     }
 }
 
@@ -546,6 +552,50 @@ static void handle_menu_selection(int choice) {
             }
             break;
         }
+        case 28: {
+            // 多轴联动：所有电机在同一时刻启动
+            printf("请输入电机数量 (1-8): ");
+            read_input(buffer, sizeof(buffer));
+            int count = atoi(buffer);
+            if (count < 1 || count > 8) {
+                printf("电机数量无效\n");
+                break;
+            }
+            printf("请输入同步启动延时 (毫秒): ");
+            read_input(buffer, sizeof(buffer));
+            uint16_t delay = (uint16_t)atoi(buffer);
+            
+            memset(&msg, 0, sizeof(msg));
+            msg.type = MSG_TYPE_MOTOR_CMD;
+            msg.seq_num = g_seq_num++;
+            msg.timestamp = (uint32_t)time(NULL);
+            // 数据：0x28 + count(1字节) + delay(2字节) + count × [id(1字节) + angle(4字节float) + speed(4字节float)]
+            msg.payload.data[0] = 0x28;
+            msg.payload.data[1] = (uint8_t)count;
+            memcpy(&msg.payload.data[2], &delay, sizeof(uint16_t));
+            for (int i = 0; i < count; i++) {
+                uint8_t *p = &msg.payload.data[4 + i * 9];
+                printf("[%d] 电机 ID: ", i + 1);
+                read_input(buffer, sizeof(buffer));
+                p[0] = (uint8_t)atoi(buffer);
+                printf("[%d] 角度 (度): ", i + 1);
+                read_input(buffer, sizeof(buffer));
+                float ang = to_rad(atof(buffer));
+                printf("[%d] 速度 (度/秒): ", i + 1);
+                read_input(buffer, sizeof(buffer));
+                float spd = to_rad(atof(buffer));
+                memcpy(p + 1, &ang, sizeof(float));
+                memcpy(p + 5, &spd, sizeof(float));
+            }
+            msg.data_len = 4 + count * 9;
+            
+            if (mq_send_msg(g_mq_mqtt_to_uart, &msg, 0) != 0) {
+                perror("mq_send motor batch command");
+            } else {
+                printf("多轴联动命令已发送，等待响应...\n");
+            }
+            break;
+        }
         case 30: {
             // LED 控制
             printf("LED 状态 (0=关, 1=开, 2=闪烁): ");
@@ -814,6 +864,11 @@ static int init_shared_memory() {
         return -1;
     }
     
+    // 创建指标共享内存，失败时只是没有统计，不影响运行
+    if (pm_metrics_create() != 0) {
+        fprintf(stderr, "Failed to create metrics segment, statistics disabled\n");
+    }
+    
     printf("Shared memory initialized successfully\n");
     return 0;
 }
@@ -845,6 +900,18 @@ static int init_message_queues() {
     return 0;
 }
 
+/**
+ * @brief 读取子进程的调度配置
+ * @param name 进程名，即配置文件中的段落名
+ * @param profile 输出参数，没有配置时清零（保持默认调度）
+ */
+static void load_sched_profile(const char *name, pm_sched_profile_t *profile) {
+    if (pm_sched_load(NULL, name, profile) == 0) {
+        char desc[128];
+        printf("Scheduling profile for %s: %s\n", name, pm_sched_describe(profile, desc, sizeof(desc)));
+    }
+}
+
 /**
  * @brief 创建并启动UART进程
  * @return 成功返回0，失败返回-1
@@ -860,8 +927,11 @@ static int create_uart_process() {
         .args = NULL,
         .auto_restart = true,
         .restart_delay = 1000,
-        .private_data = NULL
+        .private_data = NULL,
+        .notify_ready = true,          // 打开串口和消息队列后通知就绪
+        .ready_timeout = 15000
     };
+    load_sched_profile(uart_config.name, &uart_config.sched);
     
     // 创建UART进程
     g_uart_process = process_create(&uart_config);
@@ -870,15 +940,14 @@ static int create_uart_process() {
         return -1;
     }
     
-    // 启动UART进程
-    if (process_start(g_uart_process) == -1) {
-        fprintf(stderr, "Failed to start UART process\n");
+    // 交给监管器，由 process_supervisor_start 启动
+    if (process_supervisor_add(g_supervisor, g_uart_process, NULL) == -1) {
+        fprintf(stderr, "Failed to supervise UART process\n");
         process_destroy(g_uart_process);
         g_uart_process = NULL;
         return -1;
     }
     
-    printf("UART process started successfully, PID: %d\n", process_get_pid(g_uart_process));
     return 0;
 }
 
@@ -897,8 +966,10 @@ static int create_mqtt_process() {
         .args = NULL,
         .auto_restart = true,
         .restart_delay = 1000,
-        .private_data = NULL
+        .private_data = NULL,
+        .notify_ready = true           // 打开消息队列后通知就绪
     };
+    load_sched_profile(mqtt_config.name, &mqtt_config.sched);
     
     // 创建MQTT进程
     g_mqtt_process = process_create(&mqtt_config);
@@ -907,55 +978,30 @@ static int create_mqtt_process() {
         return -1;
     }
     
-    // 启动MQTT进程
-    if (process_start(g_mqtt_process) == -1) {
-        fprintf(stderr, "Failed to start MQTT process\n");
+    // MQTT 下发的命令要由 UART 进程执行，等 UART 就绪后再启动
+    if (process_supervisor_add(g_supervisor, g_mqtt_process, g_uart_process) == -1) {
+        fprintf(stderr, "Failed to supervise MQTT process\n");
         process_destroy(g_mqtt_process);
         g_mqtt_process = NULL;
         return -1;
     }
     
-    printf("MQTT process started successfully, PID: %d\n", process_get_pid(g_mqtt_process));
     return 0;
 }
 
 /**
- * @brief 监控进程状态
+ * @brief 初始化进程监管器
+ * @return 成功返回0，失败返回-1
  */
-static void monitor_processes() {
-    if (g_uart_process != NULL) {
-        process_state_t prev_state = process_get_state(g_uart_process);
-        process_update_state(g_uart_process);
-        process_state_t curr_state = process_get_state(g_uart_process);
-        
-        // 如果状态发生变化，打印日志
-        if (prev_state != curr_state) {
-            printf("UART process state changed: %d -> %d\n", prev_state, curr_state);
-        }
-        
-        if (!process_is_running(g_uart_process)) {
-            printf("UART process is not running, PID: %d, exit code: %d, restarting...\n", 
-                   process_get_pid(g_uart_process), g_uart_process->exit_code);
-            process_restart(g_uart_process, 1000);
-        }
-    }
-    
-    if (g_mqtt_process != NULL) {
-        process_state_t prev_state = process_get_state(g_mqtt_process);
-        process_update_state(g_mqtt_process);
-        process_state_t curr_state = process_get_state(g_mqtt_process);
-        
-        // 如果状态发生变化，打印日志
-        if (prev_state != curr_state) {
-            printf("MQTT process state changed: %d -> %d\n", prev_state, curr_state);
-        }
-        
-        if (!process_is_running(g_mqtt_process)) {
-            printf("MQTT process is not running, PID: %d, exit code: %d, restarting...\n", 
-                   process_get_pid(g_mqtt_process), g_mqtt_process->exit_code);
-            process_restart(g_mqtt_process, 1000);
-        }
+static int init_supervisor() {
+    g_supervisor = process_supervisor_create();
+    if (g_supervisor == NULL) {
+        fprintf(stderr, "Failed to create process supervisor\n");
+        return -1;
     }
+    // 子进程崩溃时把它取出未处理的共享内存段交给重启后的进程
+    process_supervisor_set_shm(g_supervisor, &g_shm_handle);
+    return 0;
 }
 
 /**
@@ -964,15 +1010,11 @@ static void monitor_processes() {
 static void cleanup() {
     printf("Cleaning up resources...\n");
     
-    // 停止UART进程
-    if (g_uart_process != NULL) {
-        printf("Stopping UART process...\n");
-        process_stop(g_uart_process, 5000);
-        process_destroy(g_uart_process);
-        g_uart_process = NULL;
-    }
+    // 先停止监管，避免停止中的进程被重启
+    process_supervisor_destroy(g_supervisor);
+    g_supervisor = NULL;
     
-    // 停止MQTT进程
+    // 停止MQTT进程（依赖UART，先停）
     if (g_mqtt_process != NULL) {
         printf("Stopping MQTT process...\n");
         process_stop(g_mqtt_process, 5000);
@@ -980,6 +1022,14 @@ static void cleanup() {
         g_mqtt_process = NULL;
     }
     
+    // 停止UART进程
+    if (g_uart_process != NULL) {
+        printf("Stopping UART process...\n");
+        process_stop(g_uart_process, 5000);
+        process_destroy(g_uart_process);
+        g_uart_process = NULL;
+    }
+    
     // 关闭消息队列
     if (g_mq_uart_to_mqtt != -1) {
         mq_close_queue(g_mq_uart_to_mqtt);
@@ -995,16 +1045,112 @@ static void cleanup() {
     
     // 销毁共享内存
     shm_destroy(&g_shm_handle);
+    pm_metrics_destroy();
     
     printf("Cleanup completed\n");
 }
 
+/**
+ * @brief 打印一个消息队列的当前深度
+ * @param label 显示名称
+ * @param name 消息队列名称
+ */
+static void print_queue_depth(const char *label, const char *name) {
+    int mq = mq_open_existing(name, O_RDONLY);
+    struct msqid_ds attr;
+    if (mq != -1 && mq_get_attr(mq, &attr) == 0) {
+        printf("  %-20s %lu\n", label, (unsigned long)attr.msg_qnum);
+    } else {
+        printf("  %-20s n/a\n", label);
+    }
+    if (mq != -1) {
+        mq_close_queue(mq);
+    }
+}
+
+/**
+ * @brief stats 子命令：只读汇总指标共享内存并打印
+ * @param interval_s 大于0时每隔 interval_s 秒打印一次（含速率），否则只打印一次
+ * @return 进程退出码
+ * @details 只读取共享内存和队列属性，不向任何被观测进程发消息
+ */
+static int run_stats(int interval_s) {
+    if (pm_metrics_attach() != 0) {
+        fprintf(stderr, "Metrics segment not found (is the process manager running?)\n");
+        return EXIT_FAILURE;
+    }
+    
+    pm_metrics_snapshot_t snaps[2];
+    int cur = 0;
+    bool have_prev = false;
+    do {
+        pm_metrics_snapshot(&snaps[cur]);
+        pm_metrics_print(stdout, &snaps[cur], have_prev ? &snaps[cur ^ 1] : NULL);
+        printf("ipc queue depth:\n");
+        print_queue_depth("uart_to_mqtt", MSG_QUEUE_UART_TO_MQTT);
+        print_queue_depth("mqtt_to_uart", MSG_QUEUE_MQTT_TO_UART);
+        fflush(stdout);
+        
+        have_prev = true;
+        cur ^= 1;
+        if (interval_s > 0) {
+            sleep((unsigned int)interval_s);
+            printf("\n");
+        }
+    } while (interval_s > 0 && running);
+    
+    pm_metrics_detach();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief trace 子命令：统计跟踪环中测量结果各阶段的耗时
+ * @param interval_s 大于0时每隔 interval_s 秒统计一次这段时间内完成的跟踪，否则统计环中全部记录
+ * @return 进程退出码
+ */
+static int run_trace(int interval_s) {
+    if (pm_metrics_attach() != 0) {
+        fprintf(stderr, "Metrics segment not found (is the process manager running?)\n");
+        return EXIT_FAILURE;
+    }
+    
+    static pm_trace_record_t records[PM_METRICS_TRACE_RING];
+    uint64_t since = 0;
+    if (interval_s > 0) {
+        // 只统计之后完成的跟踪
+        pm_metrics_trace_read(records, 0, 0, &since);
+    }
+    do {
+        if (interval_s > 0) {
+            sleep((unsigned int)interval_s);
+        }
+        size_t count = pm_metrics_trace_read(records, PM_METRICS_TRACE_RING, since, &since);
+        pm_metrics_trace_print(stdout, records, count);
+        fflush(stdout);
+        if (interval_s > 0) {
+            printf("\n");
+        }
+    } while (interval_s > 0 && running);
+    
+    pm_metrics_detach();
+    return EXIT_SUCCESS;
+}
+
 /**
  * @brief 主函数
+ * @details `process_manager stats [间隔秒数]` 只打印运行中实例的统计，
+ *          `process_manager trace [间隔秒数]` 打印测量结果各阶段耗时，都不启动子进程
  */
 int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
+    if (argc >= 2 && strcmp(argv[1], "stats") == 0) {
+        init_signal_handlers();
+        return run_stats(argc >= 3 ? atoi(argv[2]) : 0);
+    }
+    if (argc >= 2 && strcmp(argv[1], "trace") == 0) {
+        init_signal_handlers();
+        return run_trace(argc >= 3 ? atoi(argv[2]) : 0);
+    }
+    
     printf("Air8000 Process Manager v1.0\n");
     printf("================================\n");
     
@@ -1023,38 +1169,63 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
-    // 创建并启动UART进程
+    // 初始化进程监管器
+    if (init_supervisor() != 0) {
+        cleanup();
+        return EXIT_FAILURE;
+    }
+    
+    // 创建UART进程
     if (create_uart_process() != 0) {
         cleanup();
         return EXIT_FAILURE;
     }
     
-    // 创建并启动MQTT进程
+    // 创建MQTT进程
     if (create_mqtt_process() != 0) {
         cleanup();
         return EXIT_FAILURE;
     }
     
+    // 启动UART进程，MQTT进程在UART就绪后由监管器启动
+    if (process_supervisor_start(g_supervisor) != 0) {
+        fprintf(stderr, "Failed to start processes, retrying with backoff\n");
+    }
+    
     printf("\nAll processes started successfully!\n");
     printf("Press Ctrl+C to exit...\n\n");
     
     char buffer[64];                    /* 用于存储用户输入 */
     int choice;                        /* 用户选择的命令选项 */
     
-    // 主循环
+    print_menu();                      /* 打印命令菜单 */
+    
+    // 主循环：同时等待用户输入和子进程事件，子进程退出、就绪和退避重启由监管器处理
     while (running) {
-        // 监控进程状态
-        monitor_processes();
+        struct pollfd fds[2];
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = process_supervisor_get_fd(g_supervisor);
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
         
-        // 显示菜单并处理用户输入
-        print_menu();                  /* 打印命令菜单 */
-        read_input(buffer, sizeof(buffer));  /* 读取用户输入 */
-        if (sscanf(buffer, "%d", &choice) == 1) {
-            handle_menu_selection(choice);  /* 处理用户选择 */
+        // 最多等待到下一次定时动作，也不超过100ms，以便及时收取响应消息
+        int timeout = process_supervisor_next_timeout(g_supervisor);
+        if (timeout < 0 || timeout > 100) {
+            timeout = 100;
         }
+        poll(fds, 2, timeout);
+        process_supervisor_dispatch(g_supervisor, 0);
         
-        // 短暂休眠
-        usleep(1000); // 1ms，避免CPU占用过高
+        // 有输入时处理用户选择
+        if (fds[0].revents & POLLIN) {
+            read_input(buffer, sizeof(buffer));  /* 读取用户输入 */
+            if (sscanf(buffer, "%d", &choice) == 1) {
+                handle_menu_selection(choice);  /* 处理用户选择 */
+            }
+            print_menu();              /* 打印命令菜单 */
+        }
         
         // 接收并处理响应消息
         message_t resp_msg;
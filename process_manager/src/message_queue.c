@@ -6,6 +6,8 @@
  */
 
 #include "message_queue.h"
+#include "shm_ring.h"
+#include "pm_metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,6 +16,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <stddef.h>
 
 /**
  * @brief 从消息队列名称生成System V IPC键值
@@ -40,6 +43,75 @@ static key_t mq_name_to_key(const char *name) {
  */
 #define SYSV_MSG_SIZE sizeof(sysv_msgbuf_t)
 
+/**
+ * @brief 消息头部长度（payload 之前的字段）
+ */
+#define MSG_HEADER_SIZE offsetof(message_t, payload)
+
+/**
+ * @brief 每个进程可同时打开的共享内存环形队列数
+ */
+#define MQ_RING_MAX 4
+
+/**
+ * @brief 环形队列句柄与队列ID的映射：ID = -2 - 槽位，避开 -1（失败）和 System V 的非负ID
+ */
+#define MQ_RING_ID(slot) (-2 - (slot))
+#define MQ_RING_SLOT(id) (-2 - (id))
+
+/**
+ * @brief 本进程打开的环形队列
+ */
+static shm_ring_t g_rings[MQ_RING_MAX];
+static int g_ring_used[MQ_RING_MAX];
+
+/**
+ * @brief 根据队列ID查找环形队列
+ * @param mq_fd 队列ID
+ * @return 环形队列句柄，System V 队列返回NULL
+ */
+static shm_ring_t *mq_ring_from_id(int mq_fd) {
+    if (mq_fd > -2) {
+        return NULL;
+    }
+    int slot = MQ_RING_SLOT(mq_fd);
+    if (slot >= MQ_RING_MAX || !__atomic_load_n(&g_ring_used[slot], __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &g_rings[slot];
+}
+
+/**
+ * @brief 占用一个环形队列槽位
+ * @return 槽位索引，已满返回-1
+ */
+static int mq_ring_alloc_slot(void) {
+    for (int i = 0; i < MQ_RING_MAX; i++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&g_ring_used[i], &expected, 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 解析传输方式
+ * @param config 消息队列配置指针，可为NULL
+ * @return 实际使用的传输方式
+ */
+static mq_transport_t mq_resolve_transport(const mq_config_t *config) {
+    if (config != NULL && config->transport != MQ_TRANSPORT_AUTO) {
+        return config->transport;
+    }
+    const char *env = getenv(MSG_QUEUE_TRANSPORT_ENV);
+    if (env != NULL && strcmp(env, "shm") == 0) {
+        return MQ_TRANSPORT_SHM_RING;
+    }
+    return MQ_TRANSPORT_SYSV;
+}
+
 /**
  * @brief 创建消息队列
  * @param name 消息队列名称
@@ -57,6 +129,22 @@ int mq_create(const char *name, const mq_config_t *config) {
         return -1;
     }
 
+    if (mq_resolve_transport(config) == MQ_TRANSPORT_SHM_RING) {
+        // 共享内存环形队列：重新初始化，丢弃上次运行残留的记录
+        int slot = mq_ring_alloc_slot();
+        if (slot == -1) {
+            return -1;
+        }
+        if (shm_ring_create(&g_rings[slot], key, SHM_RING_DEFAULT_CAPACITY) != 0) {
+            __atomic_store_n(&g_ring_used[slot], 0, __ATOMIC_RELEASE);
+            return -1;
+        }
+        return MQ_RING_ID(slot);
+    }
+
+    // 删除上次以环形队列方式运行留下的共享内存，避免打开方误用
+    shm_ring_unlink(key);
+
     int msg_flags = IPC_CREAT | IPC_EXCL | 0666;
 
     // 使用默认配置或用户提供的配置
@@ -103,6 +191,15 @@ int mq_open_existing(const char *name, int flags) {
         return -1;
     }
 
+    // 创建方使用了环形队列时优先打开
+    int slot = mq_ring_alloc_slot();
+    if (slot != -1) {
+        if (shm_ring_open(&g_rings[slot], key) == 0) {
+            return MQ_RING_ID(slot);
+        }
+        __atomic_store_n(&g_ring_used[slot], 0, __ATOMIC_RELEASE);
+    }
+
     // 打开已存在的消息队列
     int msg_id = msgget(key, 0666);
     if (msg_id == -1) {
@@ -124,6 +221,13 @@ int mq_close_queue(int mq_fd) {
         return -1;
     }
 
+    shm_ring_t *ring = mq_ring_from_id(mq_fd);
+    if (ring != NULL) {
+        shm_ring_close(ring);
+        __atomic_store_n(&g_ring_used[MQ_RING_SLOT(mq_fd)], 0, __ATOMIC_RELEASE);
+        return 0;
+    }
+
     // System V消息队列不需要显式关闭，直接返回成功
     return 0;
 }
@@ -144,9 +248,15 @@ int mq_delete_queue(const char *name) {
         return -1;
     }
 
+    // 两种传输方式的对象都尝试删除
+    int ring_removed = (shm_ring_unlink(key) == 0);
+
     // 获取消息队列ID
     int msg_id = msgget(key, 0);
     if (msg_id == -1) {
+        if (ring_removed) {
+            return 0;
+        }
         perror("msgget");
         return -1;
     }
@@ -177,6 +287,24 @@ int mq_send_msg(int mq_fd, const message_t *msg, unsigned int priority) {
         return -1;
     }
 
+    shm_ring_t *ring = mq_ring_from_id(mq_fd);
+    if (ring != NULL) {
+        // 环形队列：只拷贝头部和有效数据，直接写入共享内存
+        (void)priority;
+        message_t head;
+        memcpy(&head, msg, MSG_HEADER_SIZE);
+        if (head.timestamp == 0) {
+            head.timestamp = (uint32_t)time(NULL);
+        }
+        if (shm_ring_write(ring, &head, MSG_HEADER_SIZE, msg->payload.data, msg->data_len) != 0) {
+            fprintf(stderr, "mq_send_msg: ring write failed\n");
+            pm_metrics_add(PM_CNT_IPC_ERRORS, 1);
+            return -1;
+        }
+        pm_metrics_add(PM_CNT_IPC_SENT, 1);
+        return 0;
+    }
+
     // 创建System V消息缓冲区
     sysv_msgbuf_t msg_buf;
     memset(&msg_buf, 0, sizeof(msg_buf));
@@ -196,9 +324,11 @@ int mq_send_msg(int mq_fd, const message_t *msg, unsigned int priority) {
     // 发送消息
     if (msgsnd(mq_fd, &msg_buf, SYSV_MSG_SIZE - sizeof(long), 0) == -1) {
         perror("msgsnd");
+        pm_metrics_add(PM_CNT_IPC_ERRORS, 1);
         return -1;
     }
 
+    pm_metrics_add(PM_CNT_IPC_SENT, 1);
     return 0;
 }
 
@@ -215,6 +345,24 @@ int mq_receive_msg(int mq_fd, message_t *msg, unsigned int *priority, int timeou
         return -1;
     }
 
+    shm_ring_t *ring = mq_ring_from_id(mq_fd);
+    if (ring != NULL) {
+        // 环形队列：直接读入调用方缓冲区，超时时间内在 futex 上阻塞
+        ssize_t n = shm_ring_read(ring, msg, sizeof(message_t), timeout_ms);
+        if (n == 0) {
+            return 1;
+        }
+        if (n < (ssize_t)MSG_HEADER_SIZE) {
+            pm_metrics_add(PM_CNT_IPC_ERRORS, 1);
+            return -1;
+        }
+        if (priority != NULL) {
+            *priority = 0;
+        }
+        pm_metrics_add(PM_CNT_IPC_RECEIVED, 1);
+        return 0;
+    }
+
     ssize_t bytes_read;
     sysv_msgbuf_t msg_buf;
     memset(&msg_buf, 0, sizeof(msg_buf));
@@ -223,20 +371,31 @@ int mq_receive_msg(int mq_fd, message_t *msg, unsigned int *priority, int timeou
         // 无限等待
         bytes_read = msgrcv(mq_fd, &msg_buf, SYSV_MSG_SIZE - sizeof(long), 1, 0);
     } else {
-        // 非阻塞尝试接收，没有消息则返回超时
-        bytes_read = msgrcv(mq_fd, &msg_buf, SYSV_MSG_SIZE - sizeof(long), 1, IPC_NOWAIT);
-        if (bytes_read == -1) {
-            if (errno == ENOMSG) {
+        // msgrcv 不支持超时：非阻塞尝试接收，没有消息时按短间隔重试直到超时
+        int waited_ms = 0;
+        for (;;) {
+            bytes_read = msgrcv(mq_fd, &msg_buf, SYSV_MSG_SIZE - sizeof(long), 1, IPC_NOWAIT);
+            if (bytes_read != -1) {
+                break;
+            }
+            if (errno != ENOMSG) {
+                perror("msgrcv");
+                pm_metrics_add(PM_CNT_IPC_ERRORS, 1);
+                return -1;
+            }
+            if (waited_ms >= timeout_ms) {
                 // 没有消息，返回超时
                 return 1;
             }
-            perror("msgrcv");
-            return -1;
+            int step = timeout_ms - waited_ms < 5 ? timeout_ms - waited_ms : 5;
+            usleep(step * 1000);
+            waited_ms += step;
         }
     }
 
     if (bytes_read == -1) {
         perror("msgrcv");
+        pm_metrics_add(PM_CNT_IPC_ERRORS, 1);
         return -1;
     }
 
@@ -248,6 +407,7 @@ int mq_receive_msg(int mq_fd, message_t *msg, unsigned int *priority, int timeou
         *priority = msg_buf.priority;
     }
 
+    pm_metrics_add(PM_CNT_IPC_RECEIVED, 1);
     return 0;
 }
 
@@ -262,6 +422,15 @@ int mq_get_attr(int mq_fd, struct msqid_ds *attr) {
         return -1;
     }
 
+    shm_ring_t *ring = mq_ring_from_id(mq_fd);
+    if (ring != NULL) {
+        // 环形队列只提供消息数和容量
+        memset(attr, 0, sizeof(*attr));
+        attr->msg_qnum = __atomic_load_n(&ring->hdr->count, __ATOMIC_RELAXED);
+        attr->msg_qbytes = ring->hdr->capacity;
+        return 0;
+    }
+
     if (msgctl(mq_fd, IPC_STAT, attr) == -1) {
         perror("msgctl");
         return -1;
@@ -282,6 +451,11 @@ int mq_set_attr(int mq_fd, const struct msqid_ds *new_attr, struct msqid_ds *old
         return -1;
     }
 
+    // 环形队列权限在创建时固定，不支持修改
+    if (mq_ring_from_id(mq_fd) != NULL) {
+        return -1;
+    }
+
     // 获取当前属性
     struct msqid_ds curr_attr;
     if (msgctl(mq_fd, IPC_STAT, &curr_attr) == -1) {
@@ -0,0 +1,735 @@
+/**
+ * @file pm_metrics.c
+ * @brief 跨进程指标模块实现
+ * @version 1.0
+ * @date 2026-10-14
+ */
+
+#include "pm_metrics.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/syscall.h>
+
+/** 共享内存初始化完成标志 */
+#define PM_METRICS_MAGIC 0x504D4D32U  /* "PMM2" */
+
+/** 所有槽位都被占用时共用的溢出槽位（此时写入仍是原子加，只是会有争用） */
+#define OVERFLOW_SLOT (PM_METRICS_MAX_SLOTS - 1)
+
+/** 当前进程映射的指标共享内存，未附加时为NULL */
+static pm_metrics_shm_t *g_metrics = NULL;
+
+/** 创建方保存的共享内存ID，用于删除 */
+static int g_metrics_shm_id = -1;
+
+/** 本线程占用的槽位，以及占用时对应的映射（重新附加后需要重新占用） */
+static __thread pm_metrics_slot_t *t_slot = NULL;
+static __thread pm_metrics_shm_t *t_slot_owner = NULL;
+
+/** 线程退出时释放槽位用的线程键 */
+static pthread_key_t g_slot_key;
+static pthread_once_t g_slot_key_once = PTHREAD_ONCE_INIT;
+
+static const char *const COUNTER_NAMES[PM_CNT_COUNT] = {
+    "uart_rx_frames",
+    "uart_tx_frames",
+    "uart_crc_errors",
+    "uart_timeouts",
+    "uart_reconnects",
+    "ipc_sent",
+    "ipc_received",
+    "ipc_errors",
+    "mqtt_published",
+    "mqtt_publish_errors",
+    "mqtt_upload_bytes",
+    "mqtt_upload_chunks",
+    "uart_io_csw_voluntary",
+    "uart_io_csw_involuntary",
+};
+
+static const char *const HIST_NAMES[PM_HIST_COUNT] = {
+    "uart_rtt",
+    "mqtt_publish",
+};
+
+static const char *const STAGE_NAMES[PM_TRACE_STAGE_COUNT] = {
+    "captured",
+    "transferred",
+    "decoded",
+    "measured",
+    "queued",
+    "published",
+};
+
+/**
+ * @brief 获取 CLOCK_REALTIME 毫秒数
+ * @return 毫秒时间戳
+ */
+static uint64_t realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 单调时钟微秒数
+ * @return 微秒时间戳
+ */
+uint64_t pm_metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 映射共享内存并检查布局
+ * @param shm_id 共享内存ID
+ * @return 成功返回映射指针，失败返回NULL
+ */
+static pm_metrics_shm_t *map_segment(int shm_id) {
+    void *p = shmat(shm_id, NULL, 0);
+    if (p == (void *)-1) {
+        return NULL;
+    }
+    return (pm_metrics_shm_t *)p;
+}
+
+/**
+ * @brief 创建并初始化指标共享内存
+ * @return 成功返回0，失败返回-1
+ */
+int pm_metrics_create(void) {
+    if (g_metrics != NULL) {
+        return 0;
+    }
+
+    // 上次运行遗留的共享内存布局可能不同，先删除再创建
+    int old_id = shmget(PM_METRICS_KEY, 0, 0666);
+    if (old_id != -1) {
+        shmctl(old_id, IPC_RMID, NULL);
+    }
+
+    int shm_id = shmget(PM_METRICS_KEY, sizeof(pm_metrics_shm_t), IPC_CREAT | IPC_EXCL | 0666);
+    if (shm_id == -1) {
+        perror("shmget metrics");
+        return -1;
+    }
+
+    pm_metrics_shm_t *m = map_segment(shm_id);
+    if (m == NULL) {
+        perror("shmat metrics");
+        shmctl(shm_id, IPC_RMID, NULL);
+        return -1;
+    }
+
+    // shmget 已清零，只需填写头部
+    m->slot_size = sizeof(pm_metrics_slot_t);
+    m->created_ms = realtime_ms();
+    __atomic_store_n(&m->magic, PM_METRICS_MAGIC, __ATOMIC_RELEASE);
+
+    g_metrics_shm_id = shm_id;
+    __atomic_store_n(&g_metrics, m, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief 附加到已存在的指标共享内存
+ * @return 成功返回0，失败返回-1
+ */
+int pm_metrics_attach(void) {
+    if (g_metrics != NULL) {
+        return 0;
+    }
+
+    int shm_id = shmget(PM_METRICS_KEY, 0, 0666);
+    if (shm_id == -1) {
+        return -1;
+    }
+
+    pm_metrics_shm_t *m = map_segment(shm_id);
+    if (m == NULL) {
+        return -1;
+    }
+    if (__atomic_load_n(&m->magic, __ATOMIC_ACQUIRE) != PM_METRICS_MAGIC ||
+        m->slot_size != sizeof(pm_metrics_slot_t)) {
+        // 创建方未完成初始化，或与本程序编译时的布局不同
+        shmdt(m);
+        return -1;
+    }
+
+    __atomic_store_n(&g_metrics, m, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief 解除映射
+ */
+void pm_metrics_detach(void) {
+    pm_metrics_shm_t *m = __atomic_exchange_n(&g_metrics, NULL, __ATOMIC_ACQ_REL);
+    if (m != NULL) {
+        shmdt(m);
+    }
+}
+
+/**
+ * @brief 解除映射并删除指标共享内存
+ */
+void pm_metrics_destroy(void) {
+    pm_metrics_detach();
+    if (g_metrics_shm_id != -1) {
+        shmctl(g_metrics_shm_id, IPC_RMID, NULL);
+        g_metrics_shm_id = -1;
+    }
+}
+
+/**
+ * @brief 是否已附加
+ * @return 已附加返回true
+ */
+bool pm_metrics_attached(void) {
+    return __atomic_load_n(&g_metrics, __ATOMIC_ACQUIRE) != NULL;
+}
+
+/**
+ * @brief 组合槽位属主标识
+ * @param pid 进程ID
+ * @param tid 线程ID
+ * @return 属主标识
+ */
+static inline uint64_t make_owner(uint32_t pid, uint32_t tid) {
+    return ((uint64_t)pid << 32) | tid;
+}
+
+/**
+ * @brief 槽位属主线程是否已不存在
+ * @param owner 属主标识
+ * @return /proc/<pid>/task/<tid> 不存在返回true，无法判断时按仍存在处理
+ */
+static bool owner_gone(uint64_t owner) {
+    char path[48];
+    snprintf(path, sizeof(path), "/proc/%u/task/%u", (unsigned)(owner >> 32), (unsigned)(owner & 0xFFFFFFFFU));
+    return access(path, F_OK) != 0 && errno == ENOENT;
+}
+
+/**
+ * @brief 线程退出时释放本线程占用的槽位（累计值保留给下一个属主）
+ * @param arg 槽位指针
+ */
+static void release_slot(void *arg) {
+    pm_metrics_slot_t *s = (pm_metrics_slot_t *)arg;
+    pm_metrics_shm_t *m = __atomic_load_n(&g_metrics, __ATOMIC_ACQUIRE);
+    // 已解除映射或重新附加过时槽位指针不再有效
+    if (m == NULL || m != t_slot_owner || s == &m->slots[OVERFLOW_SLOT]) {
+        return;
+    }
+    uint64_t self = make_owner((uint32_t)getpid(), (uint32_t)syscall(SYS_gettid));
+    __atomic_compare_exchange_n(&s->owner, &self, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 创建释放槽位用的线程键
+ */
+static void create_slot_key(void) {
+    pthread_key_create(&g_slot_key, release_slot);
+}
+
+/**
+ * @brief 为当前线程占用一个槽位
+ * @param m 指标共享内存
+ * @return 槽位指针
+ * @details 槽位按线程ID占用：本线程已占用的槽位（重新附加时）直接沿用，其次找空闲槽位，
+ *          再接管属主线程已不存在的槽位（保留累计值），都没有时使用溢出槽位
+ */
+static pm_metrics_slot_t *claim_slot(pm_metrics_shm_t *m) {
+    uint64_t self = make_owner((uint32_t)getpid(), (uint32_t)syscall(SYS_gettid));
+
+    for (int i = 0; i < OVERFLOW_SLOT; i++) {
+        if (__atomic_load_n(&m->slots[i].owner, __ATOMIC_RELAXED) == self) {
+            return &m->slots[i];
+        }
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < OVERFLOW_SLOT; i++) {
+            pm_metrics_slot_t *s = &m->slots[i];
+            uint64_t owner = __atomic_load_n(&s->owner, __ATOMIC_RELAXED);
+            if (pass == 0 ? owner != 0 : (owner == 0 || !owner_gone(owner))) {
+                continue;
+            }
+            if (__atomic_compare_exchange_n(&s->owner, &owner, self, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                return s;
+            }
+        }
+    }
+
+    pm_metrics_slot_t *s = &m->slots[OVERFLOW_SLOT];
+    uint64_t none = 0;
+    __atomic_compare_exchange_n(&s->owner, &none, self, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    return s;
+}
+
+/**
+ * @brief 获取当前线程的槽位
+ * @return 槽位指针，未附加返回NULL
+ */
+static inline pm_metrics_slot_t *thread_slot(void) {
+    pm_metrics_shm_t *m = __atomic_load_n(&g_metrics, __ATOMIC_ACQUIRE);
+    if (m == NULL) {
+        return NULL;
+    }
+    if (t_slot_owner != m) {
+        t_slot = claim_slot(m);
+        t_slot_owner = m;
+        pthread_once(&g_slot_key_once, create_slot_key);
+        pthread_setspecific(g_slot_key, t_slot);
+    }
+    return t_slot;
+}
+
+/**
+ * @brief 直方图桶下标
+ * @param us 微秒
+ * @return 桶下标
+ */
+static inline int bucket_of(uint64_t us) {
+    if (us == 0) {
+        return 0;
+    }
+    int b = 64 - __builtin_clzll(us);
+    return b < PM_METRICS_HIST_BUCKETS ? b : PM_METRICS_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief 向直方图记录一个样本
+ * @param h 直方图
+ * @param us 微秒
+ */
+static inline void hist_record(pm_hist_data_t *h, uint64_t us) {
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_us, us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[bucket_of(us)], 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+    while (us > max &&
+           !__atomic_compare_exchange_n(&h->max_us, &max, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief 计数器加 n
+ * @param counter 计数器
+ * @param n 增量
+ */
+void pm_metrics_add(pm_counter_t counter, uint64_t n) {
+    if ((unsigned)counter >= PM_CNT_COUNT) {
+        return;
+    }
+    pm_metrics_slot_t *s = thread_slot();
+    if (s != NULL) {
+        __atomic_fetch_add(&s->counters[counter], n, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 记录一个延迟样本
+ * @param hist 直方图
+ * @param us 延迟（微秒）
+ */
+void pm_metrics_observe(pm_hist_t hist, uint64_t us) {
+    if ((unsigned)hist >= PM_HIST_COUNT) {
+        return;
+    }
+    pm_metrics_slot_t *s = thread_slot();
+    if (s != NULL) {
+        hist_record(&s->hists[hist], us);
+    }
+}
+
+/**
+ * @brief 查找或登记命令码
+ * @param m 指标共享内存
+ * @param cmd 命令码
+ * @return 下标，登记表已满返回-1
+ */
+static int cmd_index(pm_metrics_shm_t *m, uint16_t cmd) {
+    uint32_t key = (uint32_t)cmd + 1;
+    for (int i = 0; i < PM_METRICS_MAX_CMDS; i++) {
+        uint32_t cur = __atomic_load_n(&m->cmd_ids[i], __ATOMIC_ACQUIRE);
+        if (cur == key) {
+            return i;
+        }
+        if (cur == 0) {
+            if (__atomic_compare_exchange_n(&m->cmd_ids[i], &cur, key, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return i;
+            }
+            // 被别的线程抢先登记，重新比较这一项
+            if (cur == key) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 记录一个串口请求的 RTT
+ * @param cmd 命令码
+ * @param us 往返时间（微秒）
+ */
+void pm_metrics_observe_cmd(uint16_t cmd, uint64_t us) {
+    pm_metrics_slot_t *s = thread_slot();
+    if (s == NULL) {
+        return;
+    }
+    hist_record(&s->hists[PM_HIST_UART_RTT], us);
+    int idx = cmd_index(t_slot_owner, cmd);
+    if (idx >= 0) {
+        hist_record(&s->cmd_rtt[idx], us);
+    }
+}
+
+/**
+ * @brief 分配一个跟踪ID
+ * @return 非0的跟踪ID
+ */
+uint32_t pm_metrics_trace_id(void) {
+    static uint32_t local_next = 0;
+
+    pm_metrics_shm_t *m = __atomic_load_n(&g_metrics, __ATOMIC_ACQUIRE);
+    uint32_t id;
+    do {
+        if (m != NULL) {
+            id = __atomic_add_fetch(&m->next_trace_id, 1, __ATOMIC_RELAXED);
+        } else {
+            id = ((uint32_t)getpid() << 16) ^ __atomic_add_fetch(&local_next, 1, __ATOMIC_RELAXED);
+        }
+    } while (id == 0);
+    return id;
+}
+
+/**
+ * @brief 把一条已完成的跟踪记录写入跟踪环
+ * @param record 跟踪记录
+ * @details 写入者用原子加法领取序号，条目用序号做 seqlock，读取方不会阻塞写入者
+ */
+void pm_metrics_trace_record(const pm_trace_record_t *record) {
+    pm_metrics_shm_t *m = __atomic_load_n(&g_metrics, __ATOMIC_ACQUIRE);
+    if (m == NULL || record == NULL || record->trace_id == 0) {
+        return;
+    }
+
+    uint64_t n = __atomic_fetch_add(&m->trace_head, 1, __ATOMIC_RELAXED);
+    size_t idx = (size_t)(n % PM_METRICS_TRACE_RING);
+    pm_trace_record_t *dst = &m->traces[idx];
+
+    __atomic_store_n(&m->trace_seq[idx], 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&dst->trace_id, record->trace_id, __ATOMIC_RELAXED);
+    for (int i = 0; i < PM_TRACE_STAGE_COUNT; i++) {
+        __atomic_store_n(&dst->stage_us[i], record->stage_us[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&m->trace_seq[idx], 2 * n + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 读取跟踪环中的记录
+ * @param out 输出数组
+ * @param max 数组容量
+ * @param since 起始写入序号
+ * @param next 输出参数，下次调用传入的 since
+ * @return 读到的条数
+ */
+size_t pm_metrics_trace_read(pm_trace_record_t *out, size_t max, uint64_t since, uint64_t *next) {
+    pm_metrics_shm_t *m = __atomic_load_n(&g_metrics, __ATOMIC_ACQUIRE);
+    if (m == NULL || out == NULL) {
+        return 0;
+    }
+
+    uint64_t head = __atomic_load_n(&m->trace_head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > PM_METRICS_TRACE_RING ? head - PM_METRICS_TRACE_RING : 0;
+    if (since > first) {
+        first = since;
+    }
+
+    size_t count = 0;
+    for (uint64_t n = first; n < head && count < max; n++) {
+        size_t idx = (size_t)(n % PM_METRICS_TRACE_RING);
+        uint64_t seq = __atomic_load_n(&m->trace_seq[idx], __ATOMIC_ACQUIRE);
+        if (seq != 2 * n + 2) {
+            continue;
+        }
+        pm_trace_record_t rec;
+        rec.trace_id = __atomic_load_n(&m->traces[idx].trace_id, __ATOMIC_RELAXED);
+        rec.reserved = 0;
+        for (int i = 0; i < PM_TRACE_STAGE_COUNT; i++) {
+            rec.stage_us[i] = __atomic_load_n(&m->traces[idx].stage_us[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&m->trace_seq[idx], __ATOMIC_RELAXED) != seq) {
+            continue;
+        }
+        out[count++] = rec;
+    }
+    if (next != NULL) {
+        *next = head;
+    }
+    return count;
+}
+
+/**
+ * @brief 跟踪阶段名称
+ * @param stage 阶段
+ * @return 名称字符串
+ */
+const char *pm_metrics_stage_name(pm_trace_stage_t stage) {
+    return (unsigned)stage < PM_TRACE_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+/**
+ * @brief qsort 比较函数
+ */
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * @brief 打印一行耗时统计
+ * @param out 输出流
+ * @param name 名称
+ * @param samples 样本（会被排序）
+ * @param n 样本数
+ */
+static void print_samples(FILE *out, const char *name, uint64_t *samples, size_t n) {
+    if (n == 0) {
+        fprintf(out, "  %-20s n=0\n", name);
+        return;
+    }
+    qsort(samples, n, sizeof(samples[0]), compare_u64);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    size_t p50 = (size_t)(0.50 * (double)(n - 1) + 0.5);
+    size_t p99 = (size_t)(0.99 * (double)(n - 1) + 0.5);
+    fprintf(out, "  %-20s n=%-10zu avg=%-8llu p50=%-8llu p99=%-8llu max=%llu us\n", name, n,
+            (unsigned long long)(sum / n), (unsigned long long)samples[p50],
+            (unsigned long long)samples[p99], (unsigned long long)samples[n - 1]);
+}
+
+/**
+ * @brief 打印各阶段耗时统计
+ * @param out 输出流
+ * @param records 跟踪记录
+ * @param count 记录条数
+ */
+void pm_metrics_trace_print(FILE *out, const pm_trace_record_t *records, size_t count) {
+    if (out == NULL || records == NULL) {
+        return;
+    }
+    uint64_t *samples = (uint64_t *)malloc((count ? count : 1) * sizeof(uint64_t));
+    if (samples == NULL) {
+        return;
+    }
+
+    fprintf(out, "%zu trace(s), stage time since previous stage:\n", count);
+    for (int stage = 1; stage < PM_TRACE_STAGE_COUNT; stage++) {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            const uint64_t *t = records[i].stage_us;
+            if (t[stage] == 0) {
+                continue;
+            }
+            // 前一个有效阶段（跳过不适用的阶段）
+            int prev = stage - 1;
+            while (prev >= 0 && t[prev] == 0) {
+                prev--;
+            }
+            if (prev >= 0 && t[stage] >= t[prev]) {
+                samples[n++] = t[stage] - t[prev];
+            }
+        }
+        print_samples(out, STAGE_NAMES[stage], samples, n);
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t *t = records[i].stage_us;
+        if (t[PM_TRACE_CAPTURED] != 0 && t[PM_TRACE_PUBLISHED] >= t[PM_TRACE_CAPTURED]) {
+            samples[n++] = t[PM_TRACE_PUBLISHED] - t[PM_TRACE_CAPTURED];
+        }
+    }
+    print_samples(out, "end_to_end", samples, n);
+    free(samples);
+}
+
+/**
+ * @brief 把直方图累加到汇总结果
+ * @param dst 汇总结果
+ * @param src 槽位中的直方图
+ */
+static void hist_accumulate(pm_hist_data_t *dst, const pm_hist_data_t *src) {
+    dst->count += __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+    dst->sum_us += __atomic_load_n(&src->sum_us, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&src->max_us, __ATOMIC_RELAXED);
+    if (max > dst->max_us) {
+        dst->max_us = max;
+    }
+    for (int b = 0; b < PM_METRICS_HIST_BUCKETS; b++) {
+        dst->buckets[b] += __atomic_load_n(&src->buckets[b], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 汇总所有槽位
+ * @param snap 输出参数
+ * @return 成功返回0，未附加返回-1
+ * @details 只做 relaxed 读取，不写共享内存；各计数器之间不保证同一时刻的一致性
+ */
+int pm_metrics_snapshot(pm_metrics_snapshot_t *snap) {
+    pm_metrics_shm_t *m = __atomic_load_n(&g_metrics, __ATOMIC_ACQUIRE);
+    if (m == NULL || snap == NULL) {
+        return -1;
+    }
+
+    memset(snap, 0, sizeof(*snap));
+    snap->created_ms = m->created_ms;
+    snap->taken_ms = realtime_ms();
+
+    for (int i = 0; i < PM_METRICS_MAX_CMDS; i++) {
+        uint32_t key = __atomic_load_n(&m->cmd_ids[i], __ATOMIC_ACQUIRE);
+        if (key == 0) {
+            break;
+        }
+        snap->cmds[i] = (uint16_t)(key - 1);
+        snap->cmd_count = (uint32_t)i + 1;
+    }
+
+    for (int i = 0; i < PM_METRICS_MAX_SLOTS; i++) {
+        const pm_metrics_slot_t *s = &m->slots[i];
+        // 已释放的槽位仍保留退出线程的累计值，同样要汇总
+        if (__atomic_load_n(&s->owner, __ATOMIC_ACQUIRE) != 0) {
+            snap->slots_used++;
+        }
+        for (int c = 0; c < PM_CNT_COUNT; c++) {
+            snap->counters[c] += __atomic_load_n(&s->counters[c], __ATOMIC_RELAXED);
+        }
+        for (int h = 0; h < PM_HIST_COUNT; h++) {
+            hist_accumulate(&snap->hists[h], &s->hists[h]);
+        }
+        for (uint32_t k = 0; k < snap->cmd_count; k++) {
+            hist_accumulate(&snap->cmd_rtt[k], &s->cmd_rtt[k]);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 从直方图估算分位数
+ * @param hist 直方图
+ * @param q 分位（0~1）
+ * @return 分位数所在桶的上界（微秒），没有样本返回0
+ */
+uint64_t pm_metrics_percentile(const pm_hist_data_t *hist, double q) {
+    if (hist == NULL || hist->count == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(q * (double)hist->count);
+    if (target >= hist->count) {
+        target = hist->count - 1;
+    }
+
+    uint64_t seen = 0;
+    for (int b = 0; b < PM_METRICS_HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (seen > target) {
+            // 桶上界不超过实际最大值
+            uint64_t upper = b == 0 ? 0 : (1ULL << b) - 1;
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
+
+/**
+ * @brief 计数器名称
+ * @param counter 计数器
+ * @return 名称字符串
+ */
+const char *pm_metrics_counter_name(pm_counter_t counter) {
+    return (unsigned)counter < PM_CNT_COUNT ? COUNTER_NAMES[counter] : "unknown";
+}
+
+/**
+ * @brief 直方图名称
+ * @param hist 直方图
+ * @return 名称字符串
+ */
+const char *pm_metrics_hist_name(pm_hist_t hist) {
+    return (unsigned)hist < PM_HIST_COUNT ? HIST_NAMES[hist] : "unknown";
+}
+
+/**
+ * @brief 打印一行直方图
+ * @param out 输出流
+ * @param name 名称
+ * @param h 直方图
+ */
+static void print_hist(FILE *out, const char *name, const pm_hist_data_t *h) {
+    fprintf(out, "  %-20s n=%-10llu avg=%-8llu p50=%-8llu p99=%-8llu max=%llu us\n", name,
+            (unsigned long long)h->count,
+            (unsigned long long)(h->count ? h->sum_us / h->count : 0),
+            (unsigned long long)pm_metrics_percentile(h, 0.50),
+            (unsigned long long)pm_metrics_percentile(h, 0.99),
+            (unsigned long long)h->max_us);
+}
+
+/**
+ * @brief 打印快照
+ * @param out 输出流
+ * @param snap 当前快照
+ * @param prev 上一次快照，可为NULL
+ */
+void pm_metrics_print(FILE *out, const pm_metrics_snapshot_t *snap, const pm_metrics_snapshot_t *prev) {
+    if (out == NULL || snap == NULL) {
+        return;
+    }
+
+    double interval = 0.0;
+    if (prev != NULL && snap->taken_ms > prev->taken_ms) {
+        interval = (double)(snap->taken_ms - prev->taken_ms) / 1000.0;
+    }
+
+    fprintf(out, "uptime %llu s, %u thread slot(s)\n",
+            (unsigned long long)((snap->taken_ms - snap->created_ms) / 1000), snap->slots_used);
+    fprintf(out, "counters:\n");
+    for (int c = 0; c < PM_CNT_COUNT; c++) {
+        if (interval > 0.0) {
+            fprintf(out, "  %-20s %-12llu %.1f/s\n", COUNTER_NAMES[c],
+                    (unsigned long long)snap->counters[c],
+                    (double)(snap->counters[c] - prev->counters[c]) / interval);
+        } else {
+            fprintf(out, "  %-20s %llu\n", COUNTER_NAMES[c], (unsigned long long)snap->counters[c]);
+        }
+    }
+    fprintf(out, "latency:\n");
+    for (int h = 0; h < PM_HIST_COUNT; h++) {
+        print_hist(out, HIST_NAMES[h], &snap->hists[h]);
+    }
+    if (snap->cmd_count > 0) {
+        fprintf(out, "uart rtt by cmd:\n");
+        for (uint32_t k = 0; k < snap->cmd_count; k++) {
+            char name[16];
+            snprintf(name, sizeof(name), "0x%04X", snap->cmds[k]);
+            print_hist(out, name, &snap->cmd_rtt[k]);
+        }
+    }
+}
@@ -0,0 +1,357 @@
+/**
+ * @file pm_sched.c
+ * @brief 线程放置与实时调度配置实现
+ * @version 1.0
+ * @date 2026-10-15
+ */
+
+#define _GNU_SOURCE
+#include "pm_sched.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+/** 本线程下次采样时间和上次采样时的累计切换次数 */
+static __thread uint64_t t_next_sample_us = 0;
+static __thread uint64_t t_last_nvcsw = 0;
+static __thread uint64_t t_last_nivcsw = 0;
+
+/**
+ * @brief 去掉首尾空白
+ * @param s 字符串（原地修改）
+ * @return 去掉前导空白后的起始位置
+ */
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+/**
+ * @brief 解析整数
+ * @param value 字符串
+ * @param out 输出参数
+ * @return 成功返回0，失败返回-1
+ */
+static int parse_int(const char *value, int *out) {
+    char *end = NULL;
+    errno = 0;
+    long v = strtol(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || v < -1000000 || v > 1000000) {
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+/**
+ * @brief 解析 CPU 列表，如 "1" 或 "0,2-3"
+ * @param value 字符串
+ * @param mask 输出的位掩码
+ * @return 成功返回0，失败返回-1
+ */
+static int parse_cpus(const char *value, uint32_t *mask) {
+    uint32_t m = 0;
+    const char *p = value;
+    while (*p) {
+        char *end = NULL;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= 32) {
+            return -1;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= 32) {
+                return -1;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            m |= 1U << cpu;
+        }
+        while (*p == ',' || isspace((unsigned char)*p)) {
+            p++;
+        }
+    }
+    if (m == 0) {
+        return -1;
+    }
+    *mask = m;
+    return 0;
+}
+
+/**
+ * @brief 解析一个键值
+ * @param profile 调度配置
+ * @param key 键
+ * @param value 值
+ * @return 成功返回0，未知的键或无效的值返回-1
+ */
+static int parse_key(pm_sched_profile_t *profile, const char *key, const char *value) {
+    if (strcmp(key, "cpus") == 0) {
+        return parse_cpus(value, &profile->cpu_mask);
+    }
+    if (strcmp(key, "policy") == 0) {
+        if (strcmp(value, "fifo") == 0) {
+            profile->policy = PM_SCHED_POLICY_FIFO;
+        } else if (strcmp(value, "other") == 0) {
+            profile->policy = PM_SCHED_POLICY_OTHER;
+        } else if (strcmp(value, "default") == 0) {
+            profile->policy = PM_SCHED_POLICY_DEFAULT;
+        } else {
+            return -1;
+        }
+        return 0;
+    }
+    if (strcmp(key, "priority") == 0) {
+        return parse_int(value, &profile->priority);
+    }
+    if (strcmp(key, "nice") == 0) {
+        int nice_value;
+        if (parse_int(value, &nice_value) != 0 || nice_value < -20 || nice_value > 19) {
+            return -1;
+        }
+        profile->nice = nice_value;
+        return 0;
+    }
+    if (strcmp(key, "mlock") == 0) {
+        if (strcmp(value, "1") == 0 || strcmp(value, "yes") == 0 || strcmp(value, "true") == 0) {
+            profile->mlock = true;
+        } else if (strcmp(value, "0") == 0 || strcmp(value, "no") == 0 || strcmp(value, "false") == 0) {
+            profile->mlock = false;
+        } else {
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief 从配置文件读取一个段落
+ * @param path 配置文件路径，NULL 时依次使用 PM_SCHED_CONFIG_ENV 和 PM_SCHED_DEFAULT_CONFIG
+ * @param section 段落名
+ * @param profile 输出参数，没有找到时清零
+ * @return 找到段落返回0，文件或段落不存在返回1，格式错误返回-1
+ */
+int pm_sched_load(const char *path, const char *section, pm_sched_profile_t *profile) {
+    if (section == NULL || profile == NULL) {
+        return -1;
+    }
+    memset(profile, 0, sizeof(*profile));
+    if (path == NULL) {
+        path = getenv(PM_SCHED_CONFIG_ENV);
+        if (path == NULL || path[0] == '\0') {
+            path = PM_SCHED_DEFAULT_CONFIG;
+        }
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return 1;
+    }
+
+    char line[256];
+    int line_no = 0;
+    bool in_section = false;
+    bool found = false;
+    int ret = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char *s = trim(line);
+        if (s[0] == '\0') {
+            continue;
+        }
+        if (s[0] == '[') {
+            char *end = strchr(s, ']');
+            if (end == NULL) {
+                ret = -1;
+                break;
+            }
+            *end = '\0';
+            in_section = strcmp(trim(s + 1), section) == 0;
+            found = found || in_section;
+            continue;
+        }
+        if (!in_section) {
+            continue;
+        }
+        char *eq = strchr(s, '=');
+        if (eq == NULL) {
+            ret = -1;
+            break;
+        }
+        *eq = '\0';
+        if (parse_key(profile, trim(s), trim(eq + 1)) != 0) {
+            ret = -1;
+            break;
+        }
+    }
+    fclose(fp);
+
+    if (ret != 0) {
+        fprintf(stderr, "[pm_sched] %s:%d: invalid line\n", path, line_no);
+        memset(profile, 0, sizeof(*profile));
+        return -1;
+    }
+    return found ? 0 : 1;
+}
+
+/**
+ * @brief 锁定进程内存
+ * @return 成功返回0，失败返回-1
+ */
+static int lock_memory(void) {
+    int flags = MCL_CURRENT | MCL_FUTURE;
+#ifdef MCL_ONFAULT
+    // 只锁定访问过的页：每个线程默认 8MB 的栈不会被整块调入内存，内核不支持时退回普通锁定
+    if (mlockall(flags | MCL_ONFAULT) == 0) {
+        return 0;
+    }
+#endif
+    if (mlockall(flags) == 0) {
+        return 0;
+    }
+    fprintf(stderr, "[pm_sched] mlockall failed: %s\n", strerror(errno));
+    return -1;
+}
+
+/**
+ * @brief 把配置应用到调用线程
+ * @param profile 调度配置，NULL 时什么也不做
+ * @return 全部应用成功返回0，有失败项返回-1
+ */
+int pm_sched_apply_thread(const pm_sched_profile_t *profile) {
+    if (profile == NULL) {
+        return 0;
+    }
+    int ret = 0;
+
+    if (profile->cpu_mask != 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 32; cpu++) {
+            if (profile->cpu_mask & (1U << cpu)) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            fprintf(stderr, "[pm_sched] CPU affinity 0x%x failed: %s\n", profile->cpu_mask, strerror(err));
+            ret = -1;
+        }
+    }
+
+    if (profile->policy == PM_SCHED_POLICY_FIFO) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = profile->priority;
+        if (param.sched_priority < 1) {
+            param.sched_priority = 1;
+        } else if (param.sched_priority > PM_SCHED_FIFO_MAX_PRIORITY) {
+            param.sched_priority = PM_SCHED_FIFO_MAX_PRIORITY;
+        }
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            fprintf(stderr, "[pm_sched] SCHED_FIFO %d failed: %s\n", param.sched_priority, strerror(err));
+            ret = -1;
+        }
+    } else if (profile->policy == PM_SCHED_POLICY_OTHER) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        int err = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+        if (err != 0) {
+            fprintf(stderr, "[pm_sched] SCHED_OTHER failed: %s\n", strerror(err));
+            ret = -1;
+        }
+    }
+
+    // Linux 上 nice 是线程属性，以线程ID设置；SCHED_FIFO 线程不看 nice
+    if (profile->nice != 0 && profile->policy != PM_SCHED_POLICY_FIFO &&
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), profile->nice) != 0) {
+        fprintf(stderr, "[pm_sched] nice %d failed: %s\n", profile->nice, strerror(errno));
+        ret = -1;
+    }
+
+    if (profile->mlock && lock_memory() != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+/**
+ * @brief 子进程启动时应用进程管理器要求的进程级设置
+ * @return 成功或无需设置返回0，失败返回-1
+ */
+int pm_sched_init_process(void) {
+    const char *env = getenv(PM_SCHED_MLOCK_ENV);
+    if (env == NULL || strcmp(env, "1") != 0) {
+        return 0;
+    }
+    // 只作用于本进程，不传给它再启动的程序
+    unsetenv(PM_SCHED_MLOCK_ENV);
+    return lock_memory();
+}
+
+/**
+ * @brief 采样调用线程的上下文切换次数并计入指标
+ * @param voluntary 主动切换计数器
+ * @param involuntary 被动切换计数器
+ */
+void pm_sched_sample(pm_counter_t voluntary, pm_counter_t involuntary) {
+    uint64_t now_us = pm_metrics_now_us();
+    if (now_us < t_next_sample_us) {
+        return;
+    }
+    t_next_sample_us = now_us + (uint64_t)PM_SCHED_SAMPLE_MS * 1000;
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) != 0) {
+        return;
+    }
+    uint64_t nvcsw = (uint64_t)ru.ru_nvcsw;
+    uint64_t nivcsw = (uint64_t)ru.ru_nivcsw;
+    // 第一次采样计入线程启动以来的全部切换
+    pm_metrics_add(voluntary, nvcsw - t_last_nvcsw);
+    pm_metrics_add(involuntary, nivcsw - t_last_nivcsw);
+    t_last_nvcsw = nvcsw;
+    t_last_nivcsw = nivcsw;
+}
+
+/**
+ * @brief 把配置格式化为一行说明
+ * @param profile 调度配置
+ * @param buf 输出缓冲区
+ * @param size 缓冲区大小
+ * @return buf
+ */
+const char *pm_sched_describe(const pm_sched_profile_t *profile, char *buf, size_t size) {
+    const char *policy = "default";
+    if (profile->policy == PM_SCHED_POLICY_FIFO) {
+        policy = "fifo";
+    } else if (profile->policy == PM_SCHED_POLICY_OTHER) {
+        policy = "other";
+    }
+    snprintf(buf, size, "cpus=0x%x policy=%s priority=%d nice=%d mlock=%d",
+             profile->cpu_mask, policy, profile->priority, profile->nice, profile->mlock ? 1 : 0);
+    return buf;
+}
@@ -5,17 +5,93 @@
  * @date 2026-01-22
  */
 
+#define _GNU_SOURCE
 #include "process_manager.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
 #include <signal.h>
 #include <errno.h>
 #include <time.h>
 
+/* 旧版本内核头文件没有 pidfd_open 的系统调用号，各架构统一为 434 */
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#define DEFAULT_RESTART_DELAY_MS     1000
+#define DEFAULT_MAX_RESTART_DELAY_MS 60000
+#define DEFAULT_STABLE_TIME_MS       30000
+#define DEFAULT_CRASH_BUDGET         5
+#define DEFAULT_CRASH_WINDOW_MS      300000
+#define DEFAULT_READY_TIMEOUT_MS     30000
+
+/** 退避级数上限，避免移位溢出 */
+#define MAX_BACKOFF_LEVEL 16
+
+/** 没有 pidfd 也没有 signalfd 可用的进程，按该间隔轮询回收 */
+#define SWEEP_INTERVAL_MS 1000
+
+/**
+ * @brief 获取单调时钟毫秒数
+ * @return 毫秒时间戳
+ */
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 打开进程的 pidfd
+ * @param pid 进程ID
+ * @return 文件描述符，内核不支持或失败返回-1
+ */
+static int pidfd_open_compat(pid_t pid) {
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+}
+
+/**
+ * @brief 关闭进程的 pidfd 和就绪通知管道
+ * @param process 进程结构体指针
+ */
+static void process_close_fds(process_t *process) {
+    if (process->pidfd >= 0) {
+        close(process->pidfd);
+        process->pidfd = -1;
+    }
+    if (process->notify_fd >= 0) {
+        close(process->notify_fd);
+        process->notify_fd = -1;
+    }
+}
+
+/**
+ * @brief 把 waitpid 的状态转换为退出码
+ * @param status waitpid 返回的状态
+ * @return 正常退出返回退出码，被信号终止返回信号值的相反数
+ */
+static int status_to_exit_code(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return -WTERMSIG(status);
+    }
+    return -2;
+}
+
 /**
  * @brief 创建进程
  * @param config 进程配置指针
@@ -63,6 +139,25 @@ process_t* process_create(const process_config_t *config) {
     
     // 设置私有数据
     process->private_data = config->private_data;
+
+    // 重启策略，未配置的项使用默认值
+    process->pidfd = -1;
+    process->notify_fd = -1;
+    process->auto_restart = config->auto_restart;
+    process->restart_delay = config->restart_delay > 0 ? config->restart_delay : DEFAULT_RESTART_DELAY_MS;
+    process->max_restart_delay = config->max_restart_delay > 0 ? config->max_restart_delay : DEFAULT_MAX_RESTART_DELAY_MS;
+    if (process->max_restart_delay < process->restart_delay) {
+        process->max_restart_delay = process->restart_delay;
+    }
+    process->stable_time = config->stable_time > 0 ? config->stable_time : DEFAULT_STABLE_TIME_MS;
+    process->crash_budget = config->crash_budget > 0 ? config->crash_budget : DEFAULT_CRASH_BUDGET;
+    if (process->crash_budget >= PROCESS_CRASH_HISTORY) {
+        process->crash_budget = PROCESS_CRASH_HISTORY - 1;
+    }
+    process->crash_window = config->crash_window > 0 ? config->crash_window : DEFAULT_CRASH_WINDOW_MS;
+    process->notify_ready = config->notify_ready;
+    process->ready_timeout = config->ready_timeout > 0 ? config->ready_timeout : DEFAULT_READY_TIMEOUT_MS;
+    process->sched = config->sched;
     
     return process;
 }
@@ -82,16 +177,54 @@ int process_start(process_t *process) {
         return 0;
     }
 
+    // 就绪通知管道：读端留在父进程，写端只让子进程继承
+    int notify_pipe[2] = {-1, -1};
+    if (process->notify_ready && pipe2(notify_pipe, O_CLOEXEC) == -1) {
+        perror("pipe2");
+        process->state = PROC_STATE_ERROR;
+        return -1;
+    }
+
     // 调用fork创建子进程
     pid_t pid = fork();
     if (pid == -1) {
         perror("fork");
+        if (notify_pipe[0] >= 0) {
+            close(notify_pipe[0]);
+            close(notify_pipe[1]);
+        }
         process->state = PROC_STATE_ERROR;
         return -1;
     }
 
     if (pid == 0) {
         // 子进程
+
+        // 监管器可能屏蔽了 SIGCHLD（signalfd），屏蔽字会跨 exec 继承，这里恢复
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+        if (notify_pipe[1] >= 0) {
+            char fd_str[16];
+            close(notify_pipe[0]);
+            fcntl(notify_pipe[1], F_SETFD, 0);
+            snprintf(fd_str, sizeof(fd_str), "%d", notify_pipe[1]);
+            setenv(PROCESS_NOTIFY_FD_ENV, fd_str, 1);
+        } else {
+            unsetenv(PROCESS_NOTIFY_FD_ENV);
+        }
+
+        // 亲和性、策略和 nice 跨 exec 继承，子进程内所有线程随之继承；内存锁定不继承，交给子进程自己做
+        pm_sched_profile_t sched = process->sched;
+        if (sched.mlock) {
+            setenv(PM_SCHED_MLOCK_ENV, "1", 1);
+            sched.mlock = false;
+        } else {
+            unsetenv(PM_SCHED_MLOCK_ENV);
+        }
+        pm_sched_apply_thread(&sched);
         
         // 将标准输出和标准错误重定向到父进程的终端
         // 这样子进程的输出就能在父进程的终端中看到
@@ -125,8 +258,18 @@ int process_start(process_t *process) {
         exit(EXIT_FAILURE);
     } else {
         // 父进程
+        process_close_fds(process);
+        if (notify_pipe[1] >= 0) {
+            close(notify_pipe[1]);
+            fcntl(notify_pipe[0], F_SETFL, O_NONBLOCK);
+            process->notify_fd = notify_pipe[0];
+        }
+        process->pidfd = pidfd_open_compat(pid);
         process->pid = pid;
         process->state = PROC_STATE_RUNNING;
+        process->ready = !process->notify_ready;
+        process->stop_requested = false;
+        process->start_time = monotonic_ms();
         return 0;
     }
 }
@@ -136,9 +279,22 @@ int process_start(process_t *process) {
  * @param process 进程结构体指针
  * @param timeout_ms 超时时间（毫秒）
  * @return 成功返回0，失败返回-1
+ * @details 处于退避等待（PROC_STATE_BACKOFF）的进程直接取消重启并返回0
  */
 int process_stop(process_t *process, int timeout_ms) {
-    if (process == NULL || process->pid == -1) {
+    if (process == NULL) {
+        return -1;
+    }
+
+    // 退避等待中的进程已经退出，只需取消计划中的重启
+    if (process->state == PROC_STATE_BACKOFF) {
+        process->stop_requested = true;
+        process->next_restart_time = 0;
+        process->state = PROC_STATE_EXITED;
+        return 0;
+    }
+
+    if (process->pid == -1) {
         return -1;
     }
 
@@ -146,6 +302,9 @@ int process_stop(process_t *process, int timeout_ms) {
         return 0;
     }
 
+    // 主动停止的进程不再被监管器重启
+    process->stop_requested = true;
+
     // 发送SIGTERM信号
     if (kill(process->pid, SIGTERM) == -1) {
         perror("kill");
@@ -173,6 +332,7 @@ int process_stop(process_t *process, int timeout_ms) {
     
     process->exit_code = exit_code;
     process->state = PROC_STATE_EXITED;
+    process_close_fds(process);
     
     return 0;
 }
@@ -191,6 +351,7 @@ int process_destroy(process_t *process) {
     if (process->state == PROC_STATE_RUNNING) {
         process_stop(process, 5000);
     }
+    process_close_fds(process);
 
     // 释放内存
     free(process);
@@ -282,6 +443,14 @@ int process_wait(process_t *process, int timeout_ms) {
     if (timeout_ms == -1) {
         // 无限等待
         result = waitpid(process->pid, &status, 0);
+    } else if (process->pidfd >= 0) {
+        // 有 pidfd 时在其上等待，进程一退出就返回
+        result = waitpid(process->pid, &status, WNOHANG);
+        if (result == 0) {
+            struct pollfd pfd = { .fd = process->pidfd, .events = POLLIN, .revents = 0 };
+            poll(&pfd, 1, timeout_ms);
+            result = waitpid(process->pid, &status, WNOHANG);
+        }
     } else {
         // 超时等待
         struct timespec ts;
@@ -307,13 +476,7 @@ int process_wait(process_t *process, int timeout_ms) {
     }
     
     // 进程已退出，获取退出码
-    if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-        return -WTERMSIG(status);
-    } else {
-        return -2;
-    }
+    return status_to_exit_code(status);
 }
 
 /**
@@ -358,3 +521,504 @@ pid_t process_get_pid(const process_t *process) {
 
     return process->pid;
 }
+
+/**
+ * @brief 子进程通知监管器已就绪
+ * @return 成功或无需通知返回0，失败返回-1
+ */
+int process_notify_ready(void) {
+    const char *env = getenv(PROCESS_NOTIFY_FD_ENV);
+    if (env == NULL || env[0] == '\0') {
+        return 0;
+    }
+
+    char *end = NULL;
+    long fd = strtol(env, &end, 10);
+    unsetenv(PROCESS_NOTIFY_FD_ENV);
+    if (end == env || *end != '\0' || fd < 0) {
+        return -1;
+    }
+
+    static const char msg[] = "READY=1\n";
+    ssize_t n;
+    do {
+        n = write((int)fd, msg, sizeof(msg) - 1);
+    } while (n == -1 && errno == EINTR);
+    close((int)fd);
+    return n == (ssize_t)(sizeof(msg) - 1) ? 0 : -1;
+}
+
+// ==================== 进程监管器 ====================
+
+/** epoll 事件键：低位区分事件源，其余位为进程下标 */
+#define SUP_KEY_PIDFD  0
+#define SUP_KEY_NOTIFY 1
+#define SUP_KEY(idx, kind) (((uint64_t)(idx) << 1) | (kind))
+#define SUP_KEY_SIGNAL UINT64_MAX
+
+/**
+ * @brief 监管的进程
+ */
+typedef struct {
+    process_t *process;        // 进程
+    process_t *depends_on;     // 依赖的进程，就绪后才启动
+    bool enabled;              // 是否已由 process_supervisor_start 启用
+} sup_entry_t;
+
+/**
+ * @brief 进程监管器
+ */
+struct process_supervisor {
+    int epoll_fd;              // epoll 描述符
+    int signal_fd;             // SIGCHLD 的 signalfd，内核支持 pidfd 时为-1
+    sigset_t old_mask;         // 创建 signalfd 前的信号屏蔽字
+    shm_handle_t *shm;         // 子进程共用的共享内存池，可为NULL
+    size_t count;              // 进程数
+    sup_entry_t entries[PROCESS_SUPERVISOR_MAX];
+};
+
+/**
+ * @brief 把进程的 pidfd 和就绪通知管道加入 epoll
+ * @param sup 监管器指针
+ * @param idx 进程下标
+ */
+static void sup_watch(process_supervisor_t *sup, size_t idx) {
+    process_t *p = sup->entries[idx].process;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if (p->pidfd >= 0) {
+        ev.data.u64 = SUP_KEY(idx, SUP_KEY_PIDFD);
+        epoll_ctl(sup->epoll_fd, EPOLL_CTL_ADD, p->pidfd, &ev);
+    }
+    if (p->notify_fd >= 0) {
+        ev.data.u64 = SUP_KEY(idx, SUP_KEY_NOTIFY);
+        epoll_ctl(sup->epoll_fd, EPOLL_CTL_ADD, p->notify_fd, &ev);
+    }
+}
+
+/**
+ * @brief 把进程的描述符移出 epoll 并关闭
+ * @param sup 监管器指针
+ * @param p 进程
+ */
+static void sup_unwatch(process_supervisor_t *sup, process_t *p) {
+    if (p->pidfd >= 0) {
+        epoll_ctl(sup->epoll_fd, EPOLL_CTL_DEL, p->pidfd, NULL);
+    }
+    if (p->notify_fd >= 0) {
+        epoll_ctl(sup->epoll_fd, EPOLL_CTL_DEL, p->notify_fd, NULL);
+    }
+    process_close_fds(p);
+}
+
+/**
+ * @brief 记录一次崩溃并检查崩溃预算
+ * @param p 进程
+ * @param now 当前时间
+ * @return 超出预算返回true
+ */
+static bool sup_record_crash(process_t *p, uint64_t now) {
+    p->crash_times[p->crash_head] = now;
+    p->crash_head = (p->crash_head + 1) % PROCESS_CRASH_HISTORY;
+
+    int crashes = 0;
+    for (int i = 0; i < PROCESS_CRASH_HISTORY; i++) {
+        if (p->crash_times[i] != 0 && now - p->crash_times[i] <= (uint64_t)p->crash_window) {
+            crashes++;
+        }
+    }
+    return crashes > p->crash_budget;
+}
+
+/**
+ * @brief 启动一个进程并开始监听
+ * @param sup 监管器指针
+ * @param idx 进程下标
+ * @param now 当前时间
+ * @return 成功返回0，失败返回-1（已按退避策略安排重试）
+ */
+static int sup_start_entry(process_supervisor_t *sup, size_t idx, uint64_t now);
+
+/**
+ * @brief 处理进程退出：按退避策略安排重启或放弃
+ * @param sup 监管器指针
+ * @param idx 进程下标
+ * @param exit_code 退出码
+ * @param now 当前时间
+ */
+static void sup_handle_exit(process_supervisor_t *sup, size_t idx, int exit_code, uint64_t now) {
+    process_t *p = sup->entries[idx].process;
+    pid_t old_pid = p->pid;
+
+    sup_unwatch(sup, p);
+    p->exit_code = exit_code;
+    p->pid = -1;
+    p->ready = false;
+
+    // 它从共享内存队列取出还没处理完的段交给重启后的进程，其余段释放
+    if (sup->shm != NULL && old_pid > 0) {
+        int n = shm_seg_reclaim(sup->shm, old_pid);
+        if (n > 0) {
+            printf("Process %s: reclaimed %d shared memory segment(s)\n", p->name, n);
+        }
+    }
+
+    if (p->stop_requested || !p->auto_restart) {
+        p->state = PROC_STATE_EXITED;
+        printf("Process %s (PID %d) exited, exit code: %d\n", p->name, old_pid, exit_code);
+        return;
+    }
+
+    // 运行够久视为稳定，退避延迟从头开始
+    if (now - p->start_time >= (uint64_t)p->stable_time) {
+        p->backoff_level = 0;
+    }
+
+    if (sup_record_crash(p, now)) {
+        p->state = PROC_STATE_FAILED;
+        printf("Process %s (PID %d) exited, exit code: %d; more than %d crashes within %d ms, giving up\n",
+               p->name, old_pid, exit_code, p->crash_budget, p->crash_window);
+        return;
+    }
+
+    uint64_t delay = (uint64_t)p->restart_delay << p->backoff_level;
+    if (delay > (uint64_t)p->max_restart_delay) {
+        delay = (uint64_t)p->max_restart_delay;
+    }
+    if (p->backoff_level < MAX_BACKOFF_LEVEL) {
+        p->backoff_level++;
+    }
+    p->next_restart_time = now + delay;
+    p->state = PROC_STATE_BACKOFF;
+    printf("Process %s (PID %d) exited, exit code: %d, restarting in %llu ms\n",
+           p->name, old_pid, exit_code, (unsigned long long)delay);
+}
+
+static int sup_start_entry(process_supervisor_t *sup, size_t idx, uint64_t now) {
+    process_t *p = sup->entries[idx].process;
+
+    if (process_start(p) != 0) {
+        fprintf(stderr, "Failed to start process %s\n", p->name);
+        p->start_time = now;
+        sup_handle_exit(sup, idx, -2, now);
+        return -1;
+    }
+    sup_watch(sup, idx);
+    printf("Process %s started, PID: %d%s\n", p->name, p->pid,
+           p->notify_ready ? ", waiting for readiness" : "");
+    return 0;
+}
+
+/**
+ * @brief 非阻塞回收一个进程
+ * @param sup 监管器指针
+ * @param idx 进程下标
+ * @param now 当前时间
+ */
+static void sup_reap(process_supervisor_t *sup, size_t idx, uint64_t now) {
+    process_t *p = sup->entries[idx].process;
+    if (p->pid <= 0 || p->state != PROC_STATE_RUNNING) {
+        return;
+    }
+
+    int status;
+    pid_t r = waitpid(p->pid, &status, WNOHANG);
+    if (r == p->pid) {
+        sup_handle_exit(sup, idx, status_to_exit_code(status), now);
+    } else if (r == -1 && errno == ECHILD) {
+        // 已被别处回收（例如 process_wait），退出码未知
+        sup_handle_exit(sup, idx, -2, now);
+    }
+}
+
+/**
+ * @brief 读取就绪通知
+ * @param sup 监管器指针
+ * @param idx 进程下标
+ */
+static void sup_read_notify(process_supervisor_t *sup, size_t idx) {
+    process_t *p = sup->entries[idx].process;
+    char buf[128];
+    ssize_t n = read(p->notify_fd, buf, sizeof(buf) - 1);
+    if (n > 0) {
+        buf[n] = '\0';
+        if (!p->ready && strstr(buf, "READY=1") != NULL) {
+            p->ready = true;
+            printf("Process %s (PID %d) is ready\n", p->name, p->pid);
+        }
+        return;
+    }
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    // 写端已关闭：子进程不会再通知
+    epoll_ctl(sup->epoll_fd, EPOLL_CTL_DEL, p->notify_fd, NULL);
+    close(p->notify_fd);
+    p->notify_fd = -1;
+}
+
+/**
+ * @brief 处理到期的定时动作并启动依赖已满足的进程
+ * @param sup 监管器指针
+ * @param now 当前时间
+ */
+static void sup_run_timers(process_supervisor_t *sup, uint64_t now) {
+    for (size_t i = 0; i < sup->count; i++) {
+        sup_entry_t *e = &sup->entries[i];
+        process_t *p = e->process;
+
+        switch (p->state) {
+            case PROC_STATE_RUNNING:
+                // 就绪超时检查在轮询收尸之前，三种退出检测方式下都生效
+                if (!p->ready && p->notify_ready &&
+                    now - p->start_time >= (uint64_t)p->ready_timeout) {
+                    printf("Process %s (PID %d) not ready after %d ms, killing\n",
+                           p->name, p->pid, p->ready_timeout);
+                    kill(p->pid, SIGKILL);
+                    // 之后由 pidfd/SIGCHLD 事件或下面的轮询按崩溃处理；重置计时避免重复触发
+                    p->start_time = now;
+                }
+                // 没有 pidfd 也没有 signalfd 时靠轮询发现退出
+                if (p->pidfd < 0 && sup->signal_fd < 0) {
+                    sup_reap(sup, i, now);
+                }
+                break;
+            case PROC_STATE_BACKOFF:
+                if (now >= p->next_restart_time) {
+                    p->restart_count++;
+                    sup_start_entry(sup, i, now);
+                }
+                break;
+            case PROC_STATE_CREATED:
+                if (e->enabled && (e->depends_on == NULL || e->depends_on->ready)) {
+                    sup_start_entry(sup, i, now);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * @brief 创建进程监管器
+ * @return 成功返回监管器指针，失败返回NULL
+ */
+process_supervisor_t* process_supervisor_create(void) {
+    process_supervisor_t *sup = (process_supervisor_t *)calloc(1, sizeof(process_supervisor_t));
+    if (sup == NULL) {
+        return NULL;
+    }
+    sup->signal_fd = -1;
+
+    sup->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (sup->epoll_fd == -1) {
+        perror("epoll_create1");
+        free(sup);
+        return NULL;
+    }
+
+    // 探测内核是否支持 pidfd，不支持时改用 signalfd 接收 SIGCHLD
+    int probe = pidfd_open_compat(getpid());
+    if (probe >= 0) {
+        close(probe);
+        return sup;
+    }
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &sup->old_mask);
+    sup->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sup->signal_fd == -1) {
+        // 两者都不可用时退回到定时轮询
+        perror("signalfd");
+        sigprocmask(SIG_SETMASK, &sup->old_mask, NULL);
+        return sup;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = SUP_KEY_SIGNAL;
+    epoll_ctl(sup->epoll_fd, EPOLL_CTL_ADD, sup->signal_fd, &ev);
+    return sup;
+}
+
+/**
+ * @brief 销毁进程监管器
+ * @param sup 监管器指针
+ */
+void process_supervisor_destroy(process_supervisor_t *sup) {
+    if (sup == NULL) {
+        return;
+    }
+
+    // 进程的 pidfd 留给 process_stop 等待退出使用，只关闭 epoll
+    close(sup->epoll_fd);
+    if (sup->signal_fd >= 0) {
+        close(sup->signal_fd);
+        sigprocmask(SIG_SETMASK, &sup->old_mask, NULL);
+    }
+    free(sup);
+}
+
+/**
+ * @brief 把进程交给监管器
+ * @param sup 监管器指针
+ * @param process 进程结构体指针
+ * @param depends_on 依赖的进程，NULL表示无依赖
+ * @return 成功返回0，失败返回-1
+ */
+int process_supervisor_add(process_supervisor_t *sup, process_t *process, process_t *depends_on) {
+    if (sup == NULL || process == NULL || depends_on == process || sup->count >= PROCESS_SUPERVISOR_MAX) {
+        return -1;
+    }
+
+    size_t idx = sup->count++;
+    sup->entries[idx].process = process;
+    sup->entries[idx].depends_on = depends_on;
+    sup->entries[idx].enabled = false;
+
+    // 已在运行的进程直接开始监听
+    if (process->state == PROC_STATE_RUNNING) {
+        sup->entries[idx].enabled = true;
+        sup_watch(sup, idx);
+    }
+    return 0;
+}
+
+/**
+ * @brief 设置子进程共用的共享内存池
+ * @param sup 监管器指针
+ * @param shm 共享内存句柄，NULL表示不处理
+ */
+void process_supervisor_set_shm(process_supervisor_t *sup, shm_handle_t *shm) {
+    if (sup != NULL) {
+        sup->shm = shm;
+    }
+}
+
+/**
+ * @brief 启动所有依赖已满足的进程
+ * @param sup 监管器指针
+ * @return 成功返回0，有进程启动失败返回-1
+ */
+int process_supervisor_start(process_supervisor_t *sup) {
+    if (sup == NULL) {
+        return -1;
+    }
+
+    uint64_t now = monotonic_ms();
+    int ret = 0;
+    for (size_t i = 0; i < sup->count; i++) {
+        sup_entry_t *e = &sup->entries[i];
+        e->enabled = true;
+        if (e->process->state == PROC_STATE_CREATED &&
+            (e->depends_on == NULL || e->depends_on->ready)) {
+            if (sup_start_entry(sup, i, now) != 0) {
+                ret = -1;
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief 获取监管器的事件描述符
+ * @param sup 监管器指针
+ * @return 文件描述符
+ */
+int process_supervisor_get_fd(const process_supervisor_t *sup) {
+    return sup != NULL ? sup->epoll_fd : -1;
+}
+
+/**
+ * @brief 距下一次定时动作的时间
+ * @param sup 监管器指针
+ * @return 毫秒数，没有待处理的定时动作返回-1
+ */
+int process_supervisor_next_timeout(const process_supervisor_t *sup) {
+    if (sup == NULL) {
+        return -1;
+    }
+
+    uint64_t now = monotonic_ms();
+    int64_t best = -1;
+    for (size_t i = 0; i < sup->count; i++) {
+        const process_t *p = sup->entries[i].process;
+        int64_t t = -1;
+        if (p->state == PROC_STATE_BACKOFF) {
+            t = p->next_restart_time > now ? (int64_t)(p->next_restart_time - now) : 0;
+        } else if (p->state == PROC_STATE_RUNNING) {
+            if (p->pidfd < 0 && sup->signal_fd < 0) {
+                t = SWEEP_INTERVAL_MS;
+            } else if (p->notify_ready && !p->ready) {
+                uint64_t deadline = p->start_time + (uint64_t)p->ready_timeout;
+                t = deadline > now ? (int64_t)(deadline - now) : 0;
+            }
+        }
+        if (t >= 0 && (best < 0 || t < best)) {
+            best = t;
+        }
+    }
+    return best > INT32_MAX ? INT32_MAX : (int)best;
+}
+
+/**
+ * @brief 等待并处理子进程事件
+ * @param sup 监管器指针
+ * @param timeout_ms 最长等待时间（毫秒），0不等待，-1一直等到下一个事件或定时动作
+ * @return 成功返回0，失败返回-1
+ */
+int process_supervisor_dispatch(process_supervisor_t *sup, int timeout_ms) {
+    if (sup == NULL) {
+        return -1;
+    }
+
+    int wait_ms = process_supervisor_next_timeout(sup);
+    if (wait_ms < 0 || (timeout_ms >= 0 && timeout_ms < wait_ms)) {
+        wait_ms = timeout_ms;
+    }
+
+    struct epoll_event events[PROCESS_SUPERVISOR_MAX * 2 + 1];
+    int n = epoll_wait(sup->epoll_fd, events, sizeof(events) / sizeof(events[0]), wait_ms);
+    if (n == -1) {
+        if (errno != EINTR) {
+            perror("epoll_wait");
+            return -1;
+        }
+        n = 0;
+    }
+
+    uint64_t now = monotonic_ms();
+    for (int i = 0; i < n; i++) {
+        uint64_t key = events[i].data.u64;
+        if (key == SUP_KEY_SIGNAL) {
+            // 多个 SIGCHLD 可能合并成一个，逐个回收
+            struct signalfd_siginfo si;
+            while (read(sup->signal_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+            }
+            for (size_t j = 0; j < sup->count; j++) {
+                sup_reap(sup, j, now);
+            }
+            continue;
+        }
+
+        size_t idx = (size_t)(key >> 1);
+        if (idx >= sup->count) {
+            continue;
+        }
+        if ((key & 1) == SUP_KEY_NOTIFY) {
+            if (sup->entries[idx].process->notify_fd >= 0) {
+                sup_read_notify(sup, idx);
+            }
+        } else {
+            sup_reap(sup, idx, now);
+        }
+    }
+
+    sup_run_timers(sup, now);
+    return 0;
+}
@@ -1,8 +1,12 @@
 /**
  * @file shared_memory.c
  * @brief 共享内存模块实现
- * @version 1.0
+ * @version 1.1
  * @date 2026-01-22
+ *
+ * 内存布局：[shared_mem_t 控制块][等级0 的段数据]...[等级N 的段数据]，
+ * 每个段数据区按 64 字节对齐。所有修改控制块的操作都在进程间互斥锁内完成，
+ * 段数据本身只由持有引用的一方读写，不需要加锁。
  */
 
 #include "shared_memory.h"
@@ -11,6 +15,38 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+
+/**
+ * @brief 控制块初始化完成标志
+ */
+#define SHARED_MEM_MAGIC 0x53484D50U  /* "SHMP" */
+
+/**
+ * @brief 段数据对齐
+ */
+#define SHARED_MEM_ALIGN 64
+
+/**
+ * @brief 链表结束标记
+ */
+#define SHARED_MEM_NIL 0xFFFFFFFFU
+
+/**
+ * @brief 段句柄编码：高 16 位为 generation，低 16 位为段索引
+ */
+#define SEG_HANDLE(idx, gen) (((uint32_t)(gen) << 16) | ((uint32_t)(idx) & 0xFFFFU))
+#define SEG_INDEX(h) ((h) & 0xFFFFU)
+#define SEG_GEN(h) ((uint16_t)((h) >> 16))
+
+const shared_mem_config_t SHARED_MEM_DEFAULT_CONFIG = {
+    .class_count = 3,
+    .classes = {
+        { 4 * 1024, 32 },
+        { 64 * 1024, 16 },
+        { 1024 * 1024, 4 },
+    },
+};
 
 /**
  * @brief 从共享内存名称生成System V IPC键值
@@ -21,20 +57,219 @@ static key_t shm_name_to_key(const char *name) {
     if (name == NULL) {
         return -1;
     }
-    
+
     // 使用固定键值，避免依赖ftok()函数
     return 0x56781234; // 固定键值
 }
 
 /**
- * @brief 创建并初始化共享内存
+ * @brief 加锁，持锁进程异常退出时恢复锁的一致性
+ * @param ctrl 共享内存控制块指针
+ */
+static void pool_lock(shared_mem_ctrl_t *ctrl) {
+    int ret = pthread_mutex_lock(&ctrl->mutex);
+    if (ret == EOWNERDEAD) {
+        // 上一个持锁者在临界区内退出；控制块的每次修改都很短，直接标记为一致继续使用
+        fprintf(stderr, "shared memory: previous lock owner died, recovering\n");
+        pthread_mutex_consistent(&ctrl->mutex);
+    }
+}
+
+/**
+ * @brief 解锁
+ * @param ctrl 共享内存控制块指针
+ */
+static void pool_unlock(shared_mem_ctrl_t *ctrl) {
+    pthread_mutex_unlock(&ctrl->mutex);
+}
+
+/**
+ * @brief 计算超时截止时间（CLOCK_MONOTONIC）
+ * @param ts 输出截止时间
+ * @param timeout_ms 超时时间（毫秒）
+ */
+static void deadline_after(struct timespec *ts, int timeout_ms) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief 在条件变量上等待（已持锁）
+ * @param ctrl 共享内存控制块指针
+ * @param cond 条件变量
+ * @param deadline 截止时间，NULL 表示无限等待
+ * @return 被唤醒返回0，超时返回ETIMEDOUT
+ */
+static int pool_wait(shared_mem_ctrl_t *ctrl, pthread_cond_t *cond, const struct timespec *deadline) {
+    int ret = deadline ? pthread_cond_timedwait(cond, &ctrl->mutex, deadline)
+                       : pthread_cond_wait(cond, &ctrl->mutex);
+    if (ret == EOWNERDEAD) {
+        pthread_mutex_consistent(&ctrl->mutex);
+        ret = 0;
+    }
+    return ret;
+}
+
+/**
+ * @brief 根据句柄查找段描述符（已持锁）
+ * @param ctrl 共享内存控制块指针
+ * @param seg 段句柄
+ * @return 段描述符，句柄无效或段已释放返回NULL
+ */
+static shared_mem_segment_t *seg_lookup(shared_mem_ctrl_t *ctrl, uint32_t seg) {
+    uint32_t idx = SEG_INDEX(seg);
+    if (seg == SHARED_MEM_SEG_INVALID || idx >= ctrl->total_segments) {
+        return NULL;
+    }
+    shared_mem_segment_t *s = &ctrl->segments[idx];
+    if (s->state == SHARED_MEM_SEG_FREE || s->generation != SEG_GEN(seg)) {
+        return NULL;
+    }
+    return s;
+}
+
+/**
+ * @brief 把段放回所属等级的空闲链表（已持锁）
+ * @param ctrl 共享内存控制块指针
+ * @param idx 段索引
+ */
+static void seg_free_locked(shared_mem_ctrl_t *ctrl, uint32_t idx) {
+    shared_mem_segment_t *s = &ctrl->segments[idx];
+    shared_mem_class_t *cls = &ctrl->classes[s->class_idx];
+
+    s->state = SHARED_MEM_SEG_FREE;
+    s->owner_pid = 0;
+    s->data_len = 0;
+    s->refcount = 0;
+    s->next = cls->free_head;
+    cls->free_head = idx;
+    cls->free_count++;
+    ctrl->free_segments++;
+    pthread_cond_broadcast(&ctrl->free_cond);
+}
+
+/**
+ * @brief 初始化控制块
+ * @param shm 共享内存指针
+ * @param config 池配置
+ * @param total_size 共享内存总大小
+ * @return 成功返回0，失败返回-1
+ */
+static int pool_init(shared_mem_t *shm, const shared_mem_config_t *config, size_t total_size) {
+    shared_mem_ctrl_t *ctrl = &shm->ctrl;
+    memset(ctrl, 0, sizeof(*ctrl));
+
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    int ret = pthread_mutex_init(&ctrl->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+    if (ret != 0) {
+        fprintf(stderr, "pthread_mutex_init: %s\n", strerror(ret));
+        return -1;
+    }
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ctrl->cond, &cattr);
+    pthread_cond_init(&ctrl->free_cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    ctrl->class_count = config->class_count;
+    ctrl->queue_head = SHARED_MEM_NIL;
+    ctrl->queue_tail = SHARED_MEM_NIL;
+    ctrl->next_seq = 1;
+    ctrl->total_size = total_size;
+
+    uint64_t offset = (sizeof(shared_mem_t) + SHARED_MEM_ALIGN - 1) & ~(uint64_t)(SHARED_MEM_ALIGN - 1);
+    uint32_t idx = 0;
+    for (uint32_t c = 0; c < config->class_count; c++) {
+        shared_mem_class_t *cls = &ctrl->classes[c];
+        cls->seg_size = config->classes[c].seg_size;
+        cls->seg_count = config->classes[c].seg_count;
+        cls->free_head = SHARED_MEM_NIL;
+        for (uint32_t i = 0; i < cls->seg_count; i++, idx++) {
+            shared_mem_segment_t *s = &ctrl->segments[idx];
+            s->class_idx = (uint16_t)c;
+            s->capacity = cls->seg_size;
+            s->data_offset = offset;
+            offset += (cls->seg_size + SHARED_MEM_ALIGN - 1) & ~(uint32_t)(SHARED_MEM_ALIGN - 1);
+        }
+    }
+    ctrl->total_segments = idx;
+
+    // 倒序放入空闲链表，使低地址的段先被使用
+    for (uint32_t i = idx; i-- > 0;) {
+        seg_free_locked(ctrl, i);
+    }
+
+    __atomic_store_n(&ctrl->magic, SHARED_MEM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief 校验池配置并计算共享内存总大小
+ * @param config 池配置
+ * @return 总大小，配置无效返回0
+ */
+static size_t pool_total_size(const shared_mem_config_t *config) {
+    if (config->class_count == 0 || config->class_count > SHARED_MEM_MAX_CLASSES) {
+        return 0;
+    }
+    size_t size = (sizeof(shared_mem_t) + SHARED_MEM_ALIGN - 1) & ~(size_t)(SHARED_MEM_ALIGN - 1);
+    uint32_t segments = 0;
+    uint32_t prev_size = 0;
+    for (uint32_t c = 0; c < config->class_count; c++) {
+        const shared_mem_class_cfg_t *cls = &config->classes[c];
+        if (cls->seg_size <= prev_size || cls->seg_count == 0) {
+            return 0;
+        }
+        prev_size = cls->seg_size;
+        segments += cls->seg_count;
+        size += (size_t)((cls->seg_size + SHARED_MEM_ALIGN - 1) & ~(uint32_t)(SHARED_MEM_ALIGN - 1)) * cls->seg_count;
+    }
+    if (segments > SHARED_MEM_MAX_SEGMENTS) {
+        return 0;
+    }
+    return size;
+}
+
+/**
+ * @brief 创建并初始化共享内存（使用默认配置）
  * @param handle 共享内存句柄指针
  * @return 成功返回0，失败返回-1
  */
 int shm_create(shm_handle_t *handle) {
+    return shm_create_pool(handle, NULL);
+}
+
+/**
+ * @brief 按指定配置创建并初始化共享内存
+ * @param handle 共享内存句柄指针
+ * @param config 池配置，NULL 表示默认配置
+ * @return 成功返回0，失败返回-1
+ */
+int shm_create_pool(shm_handle_t *handle, const shared_mem_config_t *config) {
     if (handle == NULL) {
         return -1;
     }
+    if (config == NULL) {
+        config = &SHARED_MEM_DEFAULT_CONFIG;
+    }
+
+    size_t total_size = pool_total_size(config);
+    if (total_size == 0) {
+        fprintf(stderr, "shm_create: invalid pool config\n");
+        return -1;
+    }
 
     key_t key = shm_name_to_key(SHARED_MEM_NAME);
     if (key == -1) {
@@ -42,20 +277,23 @@ int shm_create(shm_handle_t *handle) {
         return -1;
     }
 
-    int shm_id = shmget(key, sizeof(shared_mem_t), IPC_CREAT | IPC_EXCL | 0666);
+    // 上次运行遗留的共享内存大小可能不同，先删除再创建
+    int old_id = shmget(key, 0, 0666);
+    if (old_id != -1) {
+        shmctl(old_id, IPC_RMID, NULL);
+    }
+
+    int shm_id = shmget(key, total_size, IPC_CREAT | IPC_EXCL | 0666);
     if (shm_id == -1) {
-        // 如果共享内存已存在，尝试打开
-        shm_id = shmget(key, sizeof(shared_mem_t), IPC_CREAT | 0666);
-        if (shm_id == -1) {
-            perror("shmget");
-            return -1;
-        }
+        perror("shmget");
+        return -1;
     }
 
     // 映射共享内存
     handle->shm_ptr = (shared_mem_t *)shmat(shm_id, NULL, 0);
     if (handle->shm_ptr == (void *)-1) {
         perror("shmat");
+        handle->shm_ptr = NULL;
         shmctl(shm_id, IPC_RMID, NULL);
         return -1;
     }
@@ -63,20 +301,10 @@ int shm_create(shm_handle_t *handle) {
     // 设置共享内存ID
     handle->shm_fd = shm_id;
 
-    // 初始化共享内存
-    memset(handle->shm_ptr, 0, sizeof(shared_mem_t));
-
-    // 初始化共享内存控制块
-    handle->shm_ptr->ctrl.total_segments = SHARED_MEM_SEGMENTS;
-    handle->shm_ptr->ctrl.free_segments = SHARED_MEM_SEGMENTS;
-    
-    // 初始化所有共享内存段
-    for (int i = 0; i < SHARED_MEM_SEGMENTS; i++) {
-        handle->shm_ptr->ctrl.segments[i].state = SHARED_MEM_SEG_FREE;
-        handle->shm_ptr->ctrl.segments[i].owner_pid = 0;
-        handle->shm_ptr->ctrl.segments[i].data_len = 0;
-        handle->shm_ptr->ctrl.segments[i].seq_num = 0;
-        memset(handle->shm_ptr->ctrl.segments[i].data, 0, SHARED_MEM_SEG_SIZE);
+    // 初始化共享内存控制块（段数据区由 shmget 清零，不需要再 memset）
+    if (pool_init(handle->shm_ptr, config, total_size) != 0) {
+        shm_destroy(handle);
+        return -1;
     }
 
     return 0;
@@ -98,8 +326,8 @@ int shm_open_existing(shm_handle_t *handle) {
         return -1;
     }
 
-    // 获取已存在的共享内存ID
-    int shm_id = shmget(key, sizeof(shared_mem_t), 0666);
+    // 获取已存在的共享内存ID（大小由创建方决定）
+    int shm_id = shmget(key, 0, 0666);
     if (shm_id == -1) {
         perror("shmget");
         return -1;
@@ -109,6 +337,15 @@ int shm_open_existing(shm_handle_t *handle) {
     handle->shm_ptr = (shared_mem_t *)shmat(shm_id, NULL, 0);
     if (handle->shm_ptr == (void *)-1) {
         perror("shmat");
+        handle->shm_ptr = NULL;
+        return -1;
+    }
+
+    // 创建方尚未完成初始化
+    if (__atomic_load_n(&handle->shm_ptr->ctrl.magic, __ATOMIC_ACQUIRE) != SHARED_MEM_MAGIC) {
+        fprintf(stderr, "shm_open_existing: pool not initialized\n");
+        shmdt(handle->shm_ptr);
+        handle->shm_ptr = NULL;
         return -1;
     }
 
@@ -118,6 +355,24 @@ int shm_open_existing(shm_handle_t *handle) {
     return 0;
 }
 
+/**
+ * @brief 解除映射但不删除共享内存（打开方使用）
+ * @param handle 共享内存句柄指针
+ */
+void shm_close(shm_handle_t *handle) {
+    if (handle == NULL) {
+        return;
+    }
+
+    if (handle->shm_ptr != NULL && handle->shm_ptr != (void *)-1) {
+        if (shmdt(handle->shm_ptr) == -1) {
+            perror("shmdt");
+        }
+    }
+    handle->shm_ptr = NULL;
+    handle->shm_fd = -1;
+}
+
 /**
  * @brief 关闭并销毁共享内存
  * @param handle 共享内存句柄指针
@@ -145,55 +400,349 @@ void shm_destroy(shm_handle_t *handle) {
 }
 
 /**
- * @brief 查找空闲的共享内存段
- * @param ctrl 共享内存控制块指针
- * @return 找到返回段索引，未找到返回-1
+ * @brief 申请一个段
+ * @param handle 共享内存句柄指针
+ * @param size 需要的容量（字节）
+ * @param timeout_ms 没有空闲段时的等待时间（毫秒），-1表示无限等待，0表示不等待
+ * @param seg 输出段句柄，引用计数为1
+ * @return 成功返回0，超时返回1，大小超过最大等级或参数错误返回-1
+ * @details 优先使用能容纳 size 的最小等级；该等级已用完时借用更大的等级，
+ *          所有可用等级都用完才等待
  */
-static int find_free_segment(shared_mem_ctrl_t *ctrl) {
-    for (uint32_t i = 0; i < ctrl->total_segments; i++) {
-        if (ctrl->segments[i].state == SHARED_MEM_SEG_FREE) {
-            return i;
+int shm_seg_alloc(shm_handle_t *handle, size_t size, int timeout_ms, uint32_t *seg) {
+    if (handle == NULL || handle->shm_ptr == NULL || seg == NULL) {
+        return -1;
+    }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+
+    uint32_t first = 0;
+    while (first < ctrl->class_count && ctrl->classes[first].seg_size < size) {
+        first++;
+    }
+    if (first == ctrl->class_count) {
+        return -1;
+    }
+
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        deadline_after(&deadline, timeout_ms);
+    }
+
+    pool_lock(ctrl);
+    for (;;) {
+        for (uint32_t c = first; c < ctrl->class_count; c++) {
+            shared_mem_class_t *cls = &ctrl->classes[c];
+            if (cls->free_head == SHARED_MEM_NIL) {
+                continue;
+            }
+            uint32_t idx = cls->free_head;
+            shared_mem_segment_t *s = &ctrl->segments[idx];
+            cls->free_head = s->next;
+            cls->free_count--;
+            ctrl->free_segments--;
+
+            s->next = SHARED_MEM_NIL;
+            s->state = SHARED_MEM_SEG_LOCKED;
+            s->owner_pid = (uint32_t)getpid();
+            s->refcount = 1;
+            s->data_len = 0;
+            s->seq_num = 0;
+            s->generation++;
+            *seg = SEG_HANDLE(idx, s->generation);
+            pool_unlock(ctrl);
+            return 0;
+        }
+
+        if (timeout_ms == 0 ||
+            pool_wait(ctrl, &ctrl->free_cond, timeout_ms > 0 ? &deadline : NULL) == ETIMEDOUT) {
+            pool_unlock(ctrl);
+            return 1;
         }
     }
-    return -1;
 }
 
 /**
- * @brief 写入数据到共享内存
+ * @brief 获取段数据区指针
  * @param handle 共享内存句柄指针
- * @param data 要写入的数据指针
+ * @param seg 段句柄
+ * @param capacity 输出段容量，可为NULL
+ * @return 数据区指针，句柄无效返回NULL
+ */
+uint8_t *shm_seg_data(shm_handle_t *handle, uint32_t seg, size_t *capacity) {
+    if (handle == NULL || handle->shm_ptr == NULL) {
+        return NULL;
+    }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+
+    pool_lock(ctrl);
+    shared_mem_segment_t *s = seg_lookup(ctrl, seg);
+    uint8_t *ptr = NULL;
+    if (s != NULL) {
+        ptr = (uint8_t *)handle->shm_ptr + s->data_offset;
+        if (capacity != NULL) {
+            *capacity = s->capacity;
+        }
+    }
+    pool_unlock(ctrl);
+    return ptr;
+}
+
+/**
+ * @brief 设置段内数据长度
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
  * @param len 数据长度
  * @return 成功返回0，失败返回-1
  */
-int shm_write(shm_handle_t *handle, const uint8_t *data, size_t len) {
-    if (handle == NULL || handle->shm_ptr == NULL || data == NULL) {
+int shm_seg_set_len(shm_handle_t *handle, uint32_t seg, size_t len) {
+    if (handle == NULL || handle->shm_ptr == NULL) {
+        return -1;
+    }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+
+    pool_lock(ctrl);
+    shared_mem_segment_t *s = seg_lookup(ctrl, seg);
+    int ret = -1;
+    if (s != NULL && len <= s->capacity) {
+        s->data_len = (uint32_t)len;
+        ret = 0;
+    }
+    pool_unlock(ctrl);
+    return ret;
+}
+
+/**
+ * @brief 获取段内数据长度
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @return 数据长度，句柄无效返回0
+ */
+size_t shm_seg_len(shm_handle_t *handle, uint32_t seg) {
+    if (handle == NULL || handle->shm_ptr == NULL) {
+        return 0;
+    }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+
+    pool_lock(ctrl);
+    shared_mem_segment_t *s = seg_lookup(ctrl, seg);
+    size_t len = s != NULL ? s->data_len : 0;
+    pool_unlock(ctrl);
+    return len;
+}
+
+/**
+ * @brief 增加段引用
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @return 成功返回0，失败返回-1
+ */
+int shm_seg_ref(shm_handle_t *handle, uint32_t seg) {
+    if (handle == NULL || handle->shm_ptr == NULL) {
+        return -1;
+    }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+
+    pool_lock(ctrl);
+    shared_mem_segment_t *s = seg_lookup(ctrl, seg);
+    int ret = -1;
+    if (s != NULL) {
+        s->refcount++;
+        ret = 0;
+    }
+    pool_unlock(ctrl);
+    return ret;
+}
+
+/**
+ * @brief 释放段引用，计数归零时段回到空闲链表
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄
+ * @return 成功返回0，失败返回-1
+ */
+int shm_seg_release(shm_handle_t *handle, uint32_t seg) {
+    if (handle == NULL || handle->shm_ptr == NULL) {
         return -1;
     }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+
+    pool_lock(ctrl);
+    shared_mem_segment_t *s = seg_lookup(ctrl, seg);
+    int ret = -1;
+    // 仍在队列中的段由队列持有引用，不能被外部释放
+    if (s != NULL && s->state == SHARED_MEM_SEG_LOCKED && s->refcount > 0) {
+        if (--s->refcount == 0) {
+            seg_free_locked(ctrl, SEG_INDEX(seg));
+        }
+        ret = 0;
+    }
+    pool_unlock(ctrl);
+    return ret;
+}
+
+/**
+ * @brief 把段提交到池内 FIFO 队列
+ * @param handle 共享内存句柄指针
+ * @param seg 段句柄，调用方的引用转交给队列
+ * @return 成功返回0，失败返回-1
+ */
+int shm_seg_push(shm_handle_t *handle, uint32_t seg) {
+    if (handle == NULL || handle->shm_ptr == NULL) {
+        return -1;
+    }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+
+    pool_lock(ctrl);
+    shared_mem_segment_t *s = seg_lookup(ctrl, seg);
+    if (s == NULL || s->state != SHARED_MEM_SEG_LOCKED || s->refcount != 1) {
+        pool_unlock(ctrl);
+        return -1;
+    }
+
+    uint32_t idx = SEG_INDEX(seg);
+    s->state = SHARED_MEM_SEG_USED;
+    s->seq_num = ctrl->next_seq++;
+    s->next = SHARED_MEM_NIL;
+    if (ctrl->queue_tail == SHARED_MEM_NIL) {
+        ctrl->queue_head = idx;
+    } else {
+        ctrl->segments[ctrl->queue_tail].next = idx;
+    }
+    ctrl->queue_tail = idx;
+    ctrl->queue_len++;
+
+    pthread_cond_signal(&ctrl->cond);
+    pool_unlock(ctrl);
+    return 0;
+}
 
-    if (len > SHARED_MEM_SEG_SIZE) {
+/**
+ * @brief 从池内 FIFO 队列取出最早提交的段
+ * @param handle 共享内存句柄指针
+ * @param timeout_ms 超时时间（毫秒），-1表示无限等待，0表示不等待
+ * @param seg 输出段句柄，调用方持有一个引用，用完需 shm_seg_release
+ * @return 成功返回0，超时返回1，失败返回-1
+ */
+int shm_seg_pop(shm_handle_t *handle, int timeout_ms, uint32_t *seg) {
+    if (handle == NULL || handle->shm_ptr == NULL || seg == NULL) {
         return -1;
     }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
 
-    // 查找空闲段
-    int seg_idx = find_free_segment(&handle->shm_ptr->ctrl);
-    if (seg_idx == -1) {
-        return -1; // 没有空闲段
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        deadline_after(&deadline, timeout_ms);
     }
 
-    // 复制数据到空闲段
-    shared_mem_segment_t *seg = &handle->shm_ptr->ctrl.segments[seg_idx];
-    memcpy(seg->data, data, len);
-    seg->data_len = len;
-    seg->seq_num++;
-    seg->state = SHARED_MEM_SEG_USED;
-    seg->owner_pid = getpid();
-    
-    // 更新空闲段计数
-    handle->shm_ptr->ctrl.free_segments--;
+    pool_lock(ctrl);
+    while (ctrl->queue_head == SHARED_MEM_NIL) {
+        if (timeout_ms == 0 ||
+            pool_wait(ctrl, &ctrl->cond, timeout_ms > 0 ? &deadline : NULL) == ETIMEDOUT) {
+            pool_unlock(ctrl);
+            return 1;
+        }
+    }
+
+    uint32_t idx = ctrl->queue_head;
+    shared_mem_segment_t *s = &ctrl->segments[idx];
+    ctrl->queue_head = s->next;
+    if (ctrl->queue_head == SHARED_MEM_NIL) {
+        ctrl->queue_tail = SHARED_MEM_NIL;
+    }
+    ctrl->queue_len--;
 
+    s->next = SHARED_MEM_NIL;
+    s->state = SHARED_MEM_SEG_LOCKED;
+    s->owner_pid = (uint32_t)getpid();
+    *seg = SEG_HANDLE(idx, s->generation);
+    pool_unlock(ctrl);
     return 0;
 }
 
+/**
+ * @brief 回收已退出进程持有的段
+ * @param handle 共享内存句柄指针
+ * @param pid 已退出的进程ID
+ * @return 重新排队和释放的段数之和，失败返回-1
+ * @details 按属主进程匹配，不看 seq_num：
+ *          1. 从队列取出过（seq_num 非0）且只剩它一个引用的段按 seq_num 升序接回队列头部，保持原来的先后顺序
+ *          2. 其余段（申请后还没提交、或已被 shm_seg_ref 共享）丢弃它的引用，计数归零时回到空闲链表
+ */
+int shm_seg_reclaim(shm_handle_t *handle, pid_t pid) {
+    if (handle == NULL || handle->shm_ptr == NULL || pid <= 0) {
+        return -1;
+    }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
+    uint32_t found[SHARED_MEM_MAX_SEGMENTS];
+    uint32_t count = 0;
+
+    uint32_t released = 0;
+
+    pool_lock(ctrl);
+    for (uint32_t i = 0; i < ctrl->total_segments; i++) {
+        shared_mem_segment_t *s = &ctrl->segments[i];
+        if (s->state != SHARED_MEM_SEG_LOCKED || s->owner_pid != (uint32_t)pid) {
+            continue;
+        }
+        if (s->seq_num == 0 || s->refcount != 1) {
+            // 没有可重新处理的队列位置：只丢弃已退出进程的引用
+            s->owner_pid = 0;
+            if (s->refcount > 0 && --s->refcount == 0) {
+                seg_free_locked(ctrl, i);
+            }
+            released++;
+            continue;
+        }
+        // 插入排序：段数很少
+        uint32_t j = count++;
+        while (j > 0 && (int32_t)(ctrl->segments[found[j - 1]].seq_num - s->seq_num) > 0) {
+            found[j] = found[j - 1];
+            j--;
+        }
+        found[j] = i;
+    }
+
+    // 从后往前插到队列头部
+    for (uint32_t k = count; k > 0; k--) {
+        uint32_t idx = found[k - 1];
+        shared_mem_segment_t *s = &ctrl->segments[idx];
+        s->state = SHARED_MEM_SEG_USED;
+        s->next = ctrl->queue_head;
+        ctrl->queue_head = idx;
+        if (ctrl->queue_tail == SHARED_MEM_NIL) {
+            ctrl->queue_tail = idx;
+        }
+        ctrl->queue_len++;
+    }
+    if (count > 0) {
+        pthread_cond_broadcast(&ctrl->cond);
+    }
+    pool_unlock(ctrl);
+    return (int)(count + released);
+}
+
+/**
+ * @brief 写入数据到共享内存
+ * @param handle 共享内存句柄指针
+ * @param data 要写入的数据指针
+ * @param len 数据长度
+ * @return 成功返回0，失败返回-1
+ */
+int shm_write(shm_handle_t *handle, const uint8_t *data, size_t len) {
+    if (handle == NULL || handle->shm_ptr == NULL || data == NULL) {
+        return -1;
+    }
+
+    uint32_t seg;
+    if (shm_seg_alloc(handle, len, 0, &seg) != 0) {
+        return -1; // 没有空闲段或数据过大
+    }
+
+    uint8_t *ptr = shm_seg_data(handle, seg, NULL);
+    memcpy(ptr, data, len);
+    shm_seg_set_len(handle, seg, len);
+    return shm_seg_push(handle, seg);
+}
+
 /**
  * @brief 从共享内存读取数据
  * @param handle 共享内存句柄指针
@@ -203,88 +752,54 @@ int shm_write(shm_handle_t *handle, const uint8_t *data, size_t len) {
  * @return 成功返回实际读取的数据长度，失败返回-1，超时返回0
  */
 ssize_t shm_read(shm_handle_t *handle, uint8_t *data, size_t len, int timeout_ms) {
-    (void)timeout_ms; // 明确表示该参数是故意未使用的
     if (handle == NULL || handle->shm_ptr == NULL || data == NULL) {
         return -1;
     }
 
-    // 检查是否有已使用的段
-    bool has_data = false;
-    for (int i = 0; i < SHARED_MEM_SEGMENTS; i++) {
-        if (handle->shm_ptr->ctrl.segments[i].state == SHARED_MEM_SEG_USED) {
-            has_data = true;
-            break;
-        }
-    }
-    
-    // 如果没有数据，直接返回
-    if (!has_data) {
-        return 0;
-    }
-
-    // 查找已使用的段
-    int seg_idx = -1;
-    for (int i = 0; i < SHARED_MEM_SEGMENTS; i++) {
-        if (handle->shm_ptr->ctrl.segments[i].state == SHARED_MEM_SEG_USED) {
-            seg_idx = i;
-            break;
-        }
-    }
-    
-    if (seg_idx == -1) {
-        return 0;
+    uint32_t seg;
+    int ret = shm_seg_pop(handle, timeout_ms, &seg);
+    if (ret != 0) {
+        return ret > 0 ? 0 : -1;
     }
 
     // 复制数据
-    shared_mem_segment_t *seg = &handle->shm_ptr->ctrl.segments[seg_idx];
-    size_t copy_len = seg->data_len;
+    size_t cap = 0;
+    const uint8_t *ptr = shm_seg_data(handle, seg, &cap);
+    size_t copy_len = shm_seg_len(handle, seg);
     if (copy_len > len) {
         copy_len = len;
     }
-    memcpy(data, seg->data, copy_len);
+    memcpy(data, ptr, copy_len);
 
-    // 重置段状态
-    seg->state = SHARED_MEM_SEG_FREE;
-    seg->owner_pid = 0;
-    handle->shm_ptr->ctrl.free_segments++;
-
-    return copy_len;
+    shm_seg_release(handle, seg);
+    return (ssize_t)copy_len;
 }
 
 /**
  * @brief 获取共享内存当前数据长度
  * @param handle 共享内存句柄指针
- * @return 数据长度
+ * @return 队列中最早一段的数据长度
  */
 size_t shm_get_data_len(shm_handle_t *handle) {
     if (handle == NULL || handle->shm_ptr == NULL) {
         return 0;
     }
+    shared_mem_ctrl_t *ctrl = &handle->shm_ptr->ctrl;
 
-    // 查找第一个已使用的段
-    for (int i = 0; i < SHARED_MEM_SEGMENTS; i++) {
-        if (handle->shm_ptr->ctrl.segments[i].state == SHARED_MEM_SEG_USED) {
-            return handle->shm_ptr->ctrl.segments[i].data_len;
-        }
-    }
-    return 0;
+    pool_lock(ctrl);
+    size_t len = ctrl->queue_head != SHARED_MEM_NIL ? ctrl->segments[ctrl->queue_head].data_len : 0;
+    pool_unlock(ctrl);
+    return len;
 }
 
 /**
  * @brief 检查共享内存数据是否就绪
  * @param handle 共享内存句柄指针
- * @return 就绪返回true，否则返回false
+ * @return 队列非空返回true，否则返回false
  */
 bool shm_is_ready(shm_handle_t *handle) {
     if (handle == NULL || handle->shm_ptr == NULL) {
         return false;
     }
-
-    // 检查是否有已使用的段
-    for (int i = 0; i < SHARED_MEM_SEGMENTS; i++) {
-        if (handle->shm_ptr->ctrl.segments[i].state == SHARED_MEM_SEG_USED) {
-            return true;
-        }
-    }
-    return false;
+    return __atomic_load_n(&handle->shm_ptr->ctrl.queue_len, __ATOMIC_ACQUIRE) != 0;
 }
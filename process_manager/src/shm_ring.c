@@ -0,0 +1,404 @@
+/**
+ * @file shm_ring.c
+ * @brief 共享内存环形队列实现
+ * @version 1.0
+ * @date 2026-10-14
+ */
+
+#include "shm_ring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/**
+ * @brief 环已初始化魔数 "RNG2"（头部改用健壮互斥锁后的布局）
+ */
+#define SHM_RING_MAGIC 0x524E4732U
+
+/**
+ * @brief 回绕填充记录的长度标记
+ */
+#define SHM_RING_PAD 0xFFFFFFFFU
+
+/**
+ * @brief 记录长度字段大小
+ */
+#define SHM_RING_LEN_SIZE sizeof(uint32_t)
+
+/**
+ * @brief 记录按 8 字节对齐
+ */
+#define SHM_RING_ALIGN(n) (((n) + 7U) & ~7U)
+
+/**
+ * @brief futex 等待（跨进程，不能使用 FUTEX_PRIVATE_FLAG）
+ * @param addr futex 地址
+ * @param val 期望值，*addr 不等于该值时立即返回
+ * @param timeout 相对超时，NULL 表示无限等待
+ */
+static int futex_wait(uint32_t *addr, uint32_t val, const struct timespec *timeout) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+
+/**
+ * @brief futex 唤醒
+ * @param addr futex 地址
+ * @param count 最多唤醒的等待者数
+ */
+static void futex_wake(uint32_t *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+/**
+ * @brief 获取侧锁，持锁进程异常退出时恢复本侧状态
+ * @param r 环形缓冲区头部
+ * @param lock prod_lock 或 cons_lock
+ * @details head/tail 只在记录完整写入/读出之后以一次原子存储发布，持锁者中途退出
+ *          不会留下半条可见记录，索引本身无需回滚；可能丢失的是发布之后的序号递增和唤醒，
+ *          这里补上并唤醒另一侧全部等待者，让它们重新检查，然后将锁标记为一致
+ */
+static void ring_lock(shm_ring_hdr_t *r, pthread_mutex_t *lock) {
+    if (pthread_mutex_lock(lock) != EOWNERDEAD) {
+        return;
+    }
+    fprintf(stderr, "shm_ring: previous lock owner died, recovering\n");
+    if (lock == &r->prod_lock) {
+        __atomic_fetch_add(&r->data_seq, 1, __ATOMIC_SEQ_CST);
+        futex_wake(&r->data_seq, INT_MAX);
+    } else {
+        __atomic_fetch_add(&r->space_seq, 1, __ATOMIC_SEQ_CST);
+        futex_wake(&r->space_seq, INT_MAX);
+    }
+    pthread_mutex_consistent(lock);
+}
+
+/**
+ * @brief 释放侧锁
+ */
+static void ring_unlock(pthread_mutex_t *lock) {
+    pthread_mutex_unlock(lock);
+}
+
+/**
+ * @brief 初始化进程共享的健壮互斥锁
+ * @param lock 锁指针
+ * @return 成功返回0，失败返回错误码
+ */
+static int ring_lock_init(pthread_mutex_t *lock) {
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    int ret = pthread_mutex_init(lock, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+    return ret;
+}
+
+/**
+ * @brief 获取单调时钟（毫秒）
+ */
+static int64_t ring_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 创建环形缓冲区（已存在时重新初始化）
+ * @param ring 句柄指针
+ * @param key System V IPC 键值
+ * @param capacity 数据区大小，0 表示使用默认值
+ * @return 成功返回0，失败返回-1
+ */
+int shm_ring_create(shm_ring_t *ring, key_t key, size_t capacity) {
+    if (ring == NULL) {
+        return -1;
+    }
+
+    // 容量取 2 的幂，便于取模
+    size_t cap = 64;
+    if (capacity == 0) {
+        capacity = SHM_RING_DEFAULT_CAPACITY;
+    }
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    size_t total = sizeof(shm_ring_hdr_t) + cap;
+
+    int shm_id = shmget(key, total, IPC_CREAT | 0666);
+    if (shm_id == -1 && errno == EINVAL) {
+        // 已存在但大小不同（上次以其他容量创建），删除后重建
+        shm_ring_unlink(key);
+        shm_id = shmget(key, total, IPC_CREAT | 0666);
+    }
+    if (shm_id == -1) {
+        perror("shmget");
+        return -1;
+    }
+
+    shm_ring_hdr_t *hdr = (shm_ring_hdr_t *)shmat(shm_id, NULL, 0);
+    if (hdr == (void *)-1) {
+        perror("shmat");
+        return -1;
+    }
+
+    // 魔数最后写入，打开方看到魔数时其余字段已初始化
+    memset(hdr, 0, sizeof(shm_ring_hdr_t));
+    int ret = ring_lock_init(&hdr->prod_lock);
+    if (ret == 0) {
+        ret = ring_lock_init(&hdr->cons_lock);
+    }
+    if (ret != 0) {
+        fprintf(stderr, "pthread_mutex_init: %s\n", strerror(ret));
+        shmdt(hdr);
+        return -1;
+    }
+    hdr->capacity = (uint32_t)cap;
+    hdr->creator_pid = (uint32_t)getpid();
+    __atomic_store_n(&hdr->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+
+    ring->shm_id = shm_id;
+    ring->hdr = hdr;
+    return 0;
+}
+
+/**
+ * @brief 打开已存在且已初始化的环形缓冲区
+ * @param ring 句柄指针
+ * @param key System V IPC 键值
+ * @return 成功返回0，失败返回-1
+ */
+int shm_ring_open(shm_ring_t *ring, key_t key) {
+    if (ring == NULL) {
+        return -1;
+    }
+
+    int shm_id = shmget(key, 0, 0666);
+    if (shm_id == -1) {
+        return -1;
+    }
+
+    shm_ring_hdr_t *hdr = (shm_ring_hdr_t *)shmat(shm_id, NULL, 0);
+    if (hdr == (void *)-1) {
+        return -1;
+    }
+
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC) {
+        shmdt(hdr);
+        return -1;
+    }
+
+    ring->shm_id = shm_id;
+    ring->hdr = hdr;
+    return 0;
+}
+
+/**
+ * @brief 解除映射
+ * @param ring 句柄指针
+ */
+void shm_ring_close(shm_ring_t *ring) {
+    if (ring == NULL || ring->hdr == NULL) {
+        return;
+    }
+    shmdt(ring->hdr);
+    ring->hdr = NULL;
+    ring->shm_id = -1;
+}
+
+/**
+ * @brief 删除环形缓冲区对应的共享内存
+ * @param key System V IPC 键值
+ * @return 成功返回0，失败返回-1
+ */
+int shm_ring_unlink(key_t key) {
+    int shm_id = shmget(key, 0, 0);
+    if (shm_id == -1) {
+        return -1;
+    }
+    return shmctl(shm_id, IPC_RMID, NULL);
+}
+
+/**
+ * @brief 写入一条记录
+ * @param ring 句柄指针
+ * @param hdr 记录头部数据
+ * @param hdr_len 头部长度
+ * @param body 记录正文数据，可为 NULL
+ * @param body_len 正文长度
+ * @return 成功返回0，失败返回-1
+ * @details 记录末尾放不下时先写一条填充记录跳到数据区开头；
+ *          单条记录限制为容量的一半，保证最坏情况下也能放下填充和记录
+ */
+int shm_ring_write(shm_ring_t *ring, const void *hdr, size_t hdr_len,
+                   const void *body, size_t body_len) {
+    return shm_ring_write_timeout(ring, hdr, hdr_len, body, body_len, -1);
+}
+
+/**
+ * @brief 写入一条记录，空间不足时最多等待 timeout_ms
+ * @param ring 句柄指针
+ * @param hdr 记录头部数据
+ * @param hdr_len 头部长度
+ * @param body 记录正文数据，可为 NULL
+ * @param body_len 正文长度
+ * @param timeout_ms 超时时间（毫秒），-1 表示无限等待，0 表示不等待
+ * @return 成功返回0，超时返回1，失败返回-1
+ */
+int shm_ring_write_timeout(shm_ring_t *ring, const void *hdr, size_t hdr_len,
+                           const void *body, size_t body_len, int timeout_ms) {
+    if (ring == NULL || ring->hdr == NULL || hdr == NULL) {
+        return -1;
+    }
+
+    shm_ring_hdr_t *r = ring->hdr;
+    uint32_t cap = r->capacity;
+    uint32_t len = (uint32_t)(hdr_len + body_len);
+    uint32_t need = SHM_RING_ALIGN(SHM_RING_LEN_SIZE + len);
+    if (hdr_len + body_len > cap / 2 || need > cap / 2) {
+        return -1;
+    }
+
+    int64_t deadline = timeout_ms > 0 ? ring_now_ms() + timeout_ms : 0;
+
+    ring_lock(r, &r->prod_lock);
+
+    uint32_t head = r->head;
+    uint32_t pos;
+    uint32_t extra;
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&r->space_seq, __ATOMIC_SEQ_CST);
+        uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        pos = head & (cap - 1);
+        extra = (cap - pos < need) ? cap - pos : 0;
+        if (head - tail + extra + need <= cap) {
+            break;
+        }
+
+        // 空间不足，等待消费者释放（无限等待时与 msgsnd 阻塞语义一致）
+        struct timespec ts;
+        struct timespec *pts = NULL;
+        if (timeout_ms == 0) {
+            ring_unlock(&r->prod_lock);
+            return 1;
+        } else if (timeout_ms > 0) {
+            int64_t remain = deadline - ring_now_ms();
+            if (remain <= 0) {
+                ring_unlock(&r->prod_lock);
+                return 1;
+            }
+            ts.tv_sec = remain / 1000;
+            ts.tv_nsec = (remain % 1000) * 1000000;
+            pts = &ts;
+        }
+        __atomic_fetch_add(&r->prod_waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == tail) {
+            futex_wait(&r->space_seq, seq, pts);
+        }
+        __atomic_fetch_sub(&r->prod_waiters, 1, __ATOMIC_SEQ_CST);
+    }
+
+    // 末尾剩余空间不足时写入填充记录并回绕（剩余空间总是 8 的倍数）
+    if (extra > 0) {
+        uint32_t pad = SHM_RING_PAD;
+        memcpy(&r->data[pos], &pad, sizeof(pad));
+        head += extra;
+        pos = 0;
+    }
+
+    memcpy(&r->data[pos], &len, sizeof(len));
+    memcpy(&r->data[pos + SHM_RING_LEN_SIZE], hdr, hdr_len);
+    if (body != NULL && body_len > 0) {
+        memcpy(&r->data[pos + SHM_RING_LEN_SIZE + hdr_len], body, body_len);
+    }
+
+    // 发布记录，有等待者时才进入内核唤醒
+    __atomic_store_n(&r->head, head + need, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&r->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&r->data_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->cons_waiters, __ATOMIC_SEQ_CST) > 0) {
+        futex_wake(&r->data_seq, INT_MAX);
+    }
+
+    ring_unlock(&r->prod_lock);
+    return 0;
+}
+
+/**
+ * @brief 读取一条记录
+ * @param ring 句柄指针
+ * @param buf 接收缓冲区
+ * @param buf_len 缓冲区长度
+ * @param timeout_ms 超时时间（毫秒），-1 表示无限等待，0 表示不等待
+ * @return 成功返回记录长度，超时返回0，失败返回-1
+ * @details 消费者侧锁只在拷贝记录时持有，等待数据时不持锁，
+ *          因此同一方向上的非阻塞接收者不会被另一个正在等待的接收者卡住
+ */
+ssize_t shm_ring_read(shm_ring_t *ring, void *buf, size_t buf_len, int timeout_ms) {
+    if (ring == NULL || ring->hdr == NULL || buf == NULL) {
+        return -1;
+    }
+
+    shm_ring_hdr_t *r = ring->hdr;
+    uint32_t cap = r->capacity;
+    int64_t deadline = timeout_ms > 0 ? ring_now_ms() + timeout_ms : 0;
+
+    for (;;) {
+        // 先取序号再检查数据，避免检查之后、等待之前的发布被错过
+        uint32_t seq = __atomic_load_n(&r->data_seq, __ATOMIC_SEQ_CST);
+
+        ring_lock(r, &r->cons_lock);
+        uint32_t tail = r->tail;
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (head != tail) {
+            uint32_t pos = tail & (cap - 1);
+            uint32_t len;
+            memcpy(&len, &r->data[pos], sizeof(len));
+            if (len == SHM_RING_PAD) {
+                // 填充记录之后一定紧跟一条有效记录（两者在同一次发布中写入）
+                tail += cap - pos;
+                pos = 0;
+                memcpy(&len, &r->data[pos], sizeof(len));
+            }
+
+            size_t copy_len = len < buf_len ? len : buf_len;
+            memcpy(buf, &r->data[pos + SHM_RING_LEN_SIZE], copy_len);
+
+            __atomic_store_n(&r->tail, tail + SHM_RING_ALIGN(SHM_RING_LEN_SIZE + len), __ATOMIC_RELEASE);
+            __atomic_fetch_sub(&r->count, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&r->space_seq, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&r->prod_waiters, __ATOMIC_SEQ_CST) > 0) {
+                futex_wake(&r->space_seq, INT_MAX);
+            }
+            ring_unlock(&r->cons_lock);
+            return (ssize_t)len;
+        }
+        ring_unlock(&r->cons_lock);
+
+        // 没有数据，计算剩余等待时间
+        struct timespec ts;
+        struct timespec *pts = NULL;
+        if (timeout_ms == 0) {
+            return 0;
+        } else if (timeout_ms > 0) {
+            int64_t remain = deadline - ring_now_ms();
+            if (remain <= 0) {
+                return 0;
+            }
+            ts.tv_sec = remain / 1000;
+            ts.tv_nsec = (remain % 1000) * 1000000;
+            pts = &ts;
+        }
+
+        __atomic_fetch_add(&r->cons_waiters, 1, __ATOMIC_SEQ_CST);
+        futex_wait(&r->data_seq, seq, pts);
+        __atomic_fetch_sub(&r->cons_waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
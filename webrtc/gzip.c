@@ -0,0 +1,215 @@
+#include "gzip.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GZIP_WINDOW 32768
+#define GZIP_HASH_SIZE 4096
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+#define GZIP_MAX_CHAIN 64
+
+#define GZIP_CRC32_POLY 0xedb88320u  // reflected IEEE 802.3
+
+/*
+ * Slice-by-8 tables: crc_table[0] is the byte-at-a-time table and
+ * crc_table[k][b] = (crc_table[k - 1][b] >> 8) ^ crc_table[0][crc_table[k - 1][b] & 0xff],
+ * so eight table lookups advance the CRC over eight bytes.
+ */
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void gzip_crc32_init(void)
+{
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (GZIP_CRC32_POLY & (0u - (crc & 1)));
+        }
+        crc_table[0][b] = crc;
+    }
+    for (int t = 1; t < 8; t++) {
+        for (int b = 0; b < 256; b++) {
+            uint32_t prev = crc_table[t - 1][b];
+            crc_table[t][b] = (prev >> 8) ^ crc_table[0][prev & 0xff];
+        }
+    }
+}
+
+uint32_t gzip_crc32(const uint8_t* data, size_t len)
+{
+    pthread_once(&crc_table_once, gzip_crc32_init);
+
+    uint32_t crc = 0xffffffffu;
+    // Bytes are loaded by index, so neither alignment nor host byte order matters
+    for (; len >= 8; data += 8, len -= 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 |
+                             (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+              crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][data[4]] ^ crc_table[2][data[5]] ^
+              crc_table[1][data[6]] ^ crc_table[0][data[7]];
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+    }
+    return ~crc;
+}
+
+typedef struct {
+    uint8_t* out;
+    size_t len;
+    uint32_t bits;
+    int nbits;
+} GzipBits;
+
+static void gzip_put_bits(GzipBits* w, uint32_t value, int n)
+{
+    w->bits |= value << w->nbits;
+    w->nbits += n;
+    while (w->nbits >= 8) {
+        w->out[w->len++] = (uint8_t)w->bits;
+        w->bits >>= 8;
+        w->nbits -= 8;
+    }
+}
+
+/* Huffman codes are packed most significant bit first */
+static void gzip_put_code(GzipBits* w, uint32_t code, int n)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < n; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    gzip_put_bits(w, reversed, n);
+}
+
+/* Literal/length symbol in the fixed Huffman code of RFC 1951 3.2.6 */
+static void gzip_put_symbol(GzipBits* w, int sym)
+{
+    if (sym < 144) {
+        gzip_put_code(w, 0x30 + sym, 8);
+    } else if (sym < 256) {
+        gzip_put_code(w, 0x190 + sym - 144, 9);
+    } else if (sym < 280) {
+        gzip_put_code(w, sym - 256, 7);
+    } else {
+        gzip_put_code(w, 0xc0 + sym - 280, 8);
+    }
+}
+
+static void gzip_put_match(GzipBits* w, size_t len, size_t dist)
+{
+    static const uint16_t len_base[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const uint8_t len_extra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    static const uint16_t dist_base[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    static const uint8_t dist_extra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+    int l = 28;
+    while (len_base[l] > len) {
+        l--;
+    }
+    gzip_put_symbol(w, 257 + l);
+    gzip_put_bits(w, (uint32_t)(len - len_base[l]), len_extra[l]);
+    int d = 29;
+    while (dist_base[d] > dist) {
+        d--;
+    }
+    gzip_put_code(w, (uint32_t)d, 5);
+    gzip_put_bits(w, (uint32_t)(dist - dist_base[d]), dist_extra[d]);
+}
+
+static uint32_t gzip_hash(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 8 ^ (uint32_t)p[1] << 4 ^ p[2]) & (GZIP_HASH_SIZE - 1);
+}
+
+int gzip_compress(const uint8_t* in, size_t len, uint8_t** out, size_t* out_len)
+{
+    // A 3 byte match can cost 31 bits, so the bound is above the 9 bits of a literal
+    GzipBits w = { .out = malloc(len + len / 2 + 64) };
+    int32_t* head = malloc(sizeof(int32_t) * (GZIP_HASH_SIZE + len));
+    if (!w.out || !head) {
+        free(w.out);
+        free(head);
+        return -1;
+    }
+    int32_t* prev = head + GZIP_HASH_SIZE;
+    for (int i = 0; i < GZIP_HASH_SIZE; i++) {
+        head[i] = -1;
+    }
+
+    static const uint8_t header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+    memcpy(w.out, header, sizeof(header));
+    w.len = sizeof(header);
+    gzip_put_bits(&w, 1, 1);        // BFINAL
+    gzip_put_bits(&w, 1, 2);        // BTYPE: fixed Huffman
+
+    size_t pos = 0;
+    while (pos < len) {
+        size_t best_len = 0;
+        size_t best_dist = 0;
+        if (pos + GZIP_MIN_MATCH <= len) {
+            size_t max = len - pos < GZIP_MAX_MATCH ? len - pos : GZIP_MAX_MATCH;
+            int chain = GZIP_MAX_CHAIN;
+            for (int32_t cand = head[gzip_hash(in + pos)];
+                 cand >= 0 && pos - (size_t)cand <= GZIP_WINDOW && chain-- > 0;
+                 cand = prev[cand]) {
+                size_t n = 0;
+                while (n < max && in[cand + n] == in[pos + n]) {
+                    n++;
+                }
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = pos - (size_t)cand;
+                    if (n == max) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        size_t step = 1;
+        if (best_len >= GZIP_MIN_MATCH) {
+            gzip_put_match(&w, best_len, best_dist);
+            step = best_len;
+        } else {
+            gzip_put_symbol(&w, in[pos]);
+        }
+        for (size_t end = pos + step; pos < end; pos++) {
+            if (pos + GZIP_MIN_MATCH <= len) {
+                uint32_t h = gzip_hash(in + pos);
+                prev[pos] = head[h];
+                head[h] = (int32_t)pos;
+            }
+        }
+    }
+    gzip_put_symbol(&w, 256);
+    if (w.nbits > 0) {
+        gzip_put_bits(&w, 0, 8 - w.nbits);
+    }
+    free(head);
+
+    uint32_t trailer[2] = { gzip_crc32(in, len), (uint32_t)len };
+    for (int i = 0; i < 2; i++) {
+        for (int k = 0; k < 4; k++) {
+            w.out[w.len++] = (uint8_t)(trailer[i] >> (8 * k));
+        }
+    }
+    *out = w.out;
+    *out_len = w.len;
+    return 0;
+}
+
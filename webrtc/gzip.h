@@ -0,0 +1,30 @@
+/*
+ * Minimal gzip (RFC 1952) encoder for the HTTP server's static content.
+ *
+ * The toolchain ships no zlib. Static content is compressed once and
+ * served many times, so the deflate stream is a single fixed-Huffman
+ * block with hash-chain LZ77: small rather than fast or tight.
+ *
+ * gzip_crc32 is the IEEE 802.3 CRC of the gzip trailer, also used for
+ * ETags. It is table driven (slice-by-8); the tables are built on first
+ * use.
+ *
+ * All functions are thread-safe.
+ */
+
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t gzip_crc32(const uint8_t* data, size_t len);
+
+/*
+ * Compress in[0..len) into a malloc()ed gzip member. Returns 0 and sets
+ * *out / *out_len, or -1 if out of memory. The result can be larger
+ * than the input; callers compare and keep whichever is smaller.
+ */
+int gzip_compress(const uint8_t* in, size_t len, uint8_t** out, size_t* out_len);
+
+#endif // GZIP_H
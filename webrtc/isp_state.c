@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+#include "isp_state.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "ss_mpi_isp.h"
+
+#define ISP_STATE_MAGIC 0x31505349u // "ISP1"
+#define ISP_STATE_DRIFT_PCT 10      // rewrite once exposure or a WB gain moved this much
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;                  // sizeof(IspStateFile), guards against layout changes
+    uint32_t exp_time;
+    uint32_t a_gain;
+    uint32_t d_gain;
+    uint32_t ispd_gain;
+    uint32_t exposure;
+    uint32_t iso;
+    uint32_t lines_per500ms;
+    uint16_t wb_r_gain;
+    uint16_t wb_g_gain;
+    uint16_t wb_b_gain;
+    uint16_t reserved;
+    uint32_t checksum;              // sum of the preceding words
+} IspStateFile;
+
+static IspStateFile g_saved;
+
+static uint32_t isp_state_checksum(const IspStateFile* s)
+{
+    const uint32_t* w = (const uint32_t*)s;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(IspStateFile, checksum) / sizeof(uint32_t); i++) {
+        sum = sum * 31 + w[i];
+    }
+    return sum;
+}
+
+static int isp_state_drifted(uint32_t old_value, uint32_t new_value)
+{
+    uint32_t diff = old_value > new_value ? old_value - new_value : new_value - old_value;
+    return (uint64_t)diff * 100 > (uint64_t)old_value * ISP_STATE_DRIFT_PCT;
+}
+
+int isp_state_load(const char* path, ot_isp_init_attr* attr)
+{
+    IspStateFile s;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, &s, sizeof(s));
+    close(fd);
+    if (n != (ssize_t)sizeof(s) || s.magic != ISP_STATE_MAGIC || s.size != sizeof(s) ||
+        s.checksum != isp_state_checksum(&s) || s.exposure == 0) {
+        printf("ISP state %s ignored: missing or invalid\n", path);
+        return -1;
+    }
+
+    attr->exp_time = s.exp_time;
+    attr->a_gain = s.a_gain;
+    attr->d_gain = s.d_gain;
+    attr->ispd_gain = s.ispd_gain;
+    attr->exposure = s.exposure;
+    attr->init_iso = s.iso;
+    attr->lines_per500ms = s.lines_per500ms;
+    attr->wb_r_gain = s.wb_r_gain;
+    attr->wb_g_gain = s.wb_g_gain;
+    attr->wb_b_gain = s.wb_b_gain;
+    attr->quick_start_en = TD_TRUE;
+    g_saved = s;
+    printf("ISP state restored: exposure %u, iso %u, wb %u/%u/%u\n",
+           s.exposure, s.iso, s.wb_r_gain, s.wb_g_gain, s.wb_b_gain);
+    return 0;
+}
+
+int isp_state_save(const char* path, ot_vi_pipe pipe)
+{
+    ot_isp_exp_info exp_info;
+    ot_isp_wb_info wb_info;
+    if (ss_mpi_isp_query_exposure_info(pipe, &exp_info) != 0 ||
+        ss_mpi_isp_query_wb_info(pipe, &wb_info) != 0) {
+        return -1;
+    }
+
+    IspStateFile s;
+    memset(&s, 0, sizeof(s));
+    s.magic = ISP_STATE_MAGIC;
+    s.size = sizeof(s);
+    s.exp_time = exp_info.exp_time;
+    s.a_gain = exp_info.a_gain;
+    s.d_gain = exp_info.d_gain;
+    s.ispd_gain = exp_info.ispd_gain;
+    s.exposure = exp_info.exposure;
+    s.iso = exp_info.iso;
+    s.lines_per500ms = exp_info.lines_per500ms;
+    s.wb_r_gain = wb_info.r_gain;
+    s.wb_g_gain = (uint16_t)((wb_info.gr_gain + wb_info.gb_gain) / 2);
+    s.wb_b_gain = wb_info.b_gain;
+    s.checksum = isp_state_checksum(&s);
+
+    if (g_saved.magic == ISP_STATE_MAGIC &&
+        !isp_state_drifted(g_saved.exposure, s.exposure) &&
+        !isp_state_drifted(g_saved.wb_r_gain, s.wb_r_gain) &&
+        !isp_state_drifted(g_saved.wb_b_gain, s.wb_b_gain)) {
+        return 0;
+    }
+
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    int ok = write(fd, &s, sizeof(s)) == (ssize_t)sizeof(s) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    g_saved = s;
+    return 0;
+}
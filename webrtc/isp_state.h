@@ -0,0 +1,40 @@
+/*
+ * Persisted AE/AWB state for a fast ISP start.
+ *
+ * While streaming, the converged exposure and white balance are queried
+ * from the ISP and written to a small file. On the next start they are
+ * handed to the sensor as its initial attributes (ot_isp_init_attr), so
+ * the first frames come out exposed and balanced for the scene instead
+ * of starting from the driver defaults and converging over a second or
+ * two.
+ *
+ * The file is rewritten atomically (temporary file + rename) and only
+ * when the state has drifted noticeably, so the flash is not worn by a
+ * static scene.
+ */
+
+#ifndef ISP_STATE_H
+#define ISP_STATE_H
+
+#include "ot_common_isp.h"
+
+#ifndef ISP_STATE_PATH
+#define ISP_STATE_PATH "/data/isp_state.bin"
+#endif
+
+#define ISP_STATE_SAVE_MS 60000     // how often the converged state is checked for saving
+
+/*
+ * Fill the exposure/white balance fields of attr from the saved state.
+ * Returns 0 if a valid state was loaded, -1 otherwise (attr untouched).
+ */
+int isp_state_load(const char* path, ot_isp_init_attr* attr);
+
+/*
+ * Query the running ISP of pipe and save its state if it differs from
+ * the last saved one. Returns 0 when nothing had to be written or the
+ * write succeeded.
+ */
+int isp_state_save(const char* path, ot_vi_pipe pipe);
+
+#endif // ISP_STATE_H
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +10,15 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <strings.h>
 
 #include "ot_type.h"
 #include "ot_common_vi.h"
@@ -32,6 +42,12 @@
 #include "ss_mpi_awb.h"
 #include "ot_sns_ctrl.h"
 
+#include "rtp_stream.h"
+#include "venc_ctrl.h"
+#include "isp_state.h"
+#include "osd.h"
+#include "gzip.h"
+
 extern ot_isp_sns_obj g_sns_imx415_obj;
 
 #define MAIN_WIDTH 3840
@@ -39,22 +55,82 @@ extern ot_isp_sns_obj g_sns_imx415_obj;
 #define MAIN_BITRATE 8000000
 #define MAIN_FPS 25
 #define MAIN_GOP 50
+#define MAIN_MIN_BITRATE 2000000
 
 #define MID_WIDTH 1920
 #define MID_HEIGHT 1080
 #define MID_BITRATE 4000000
 #define MID_FPS 25
 #define MID_GOP 50
+#define MID_MIN_BITRATE 1000000
 
 #define SUB_WIDTH 720
 #define SUB_HEIGHT 480
 #define SUB_BITRATE 1000000
 #define SUB_FPS 25
 #define SUB_GOP 50
+#define SUB_MIN_BITRATE 200000
 
 #define JPEG_WIDTH 1920
 #define JPEG_HEIGHT 1080
 
+// JPEG snapshot slots: one published, one being written, one for a slow reader
+#define JPEG_SLOT_COUNT 3
+// A snapshot younger than this is served again instead of encoding a new one
+#define JPEG_FRESH_MS 100
+#define JPEG_ENCODE_TIMEOUT_MS 1000
+
+// OSD overlay ids, also their region handles
+#define OSD_TIME 0
+#define OSD_LABEL 1
+#define OSD_MEASURE 2
+#define OSD_TIME_CELLS 22           // "2026-10-15 12:34:56"
+#define OSD_LABEL_CELLS 11
+#define OSD_MEASURE_CELLS 22
+#define OSD_MARGIN 16
+
+#define VENC_CHN_COUNT 4
+
+// VB blocks per pool: VI raw frames, VI channel output queue, and per VPSS channel
+// (one being written, one queued, one held by the encoder)
+#define VB_RAW_BLKS 6
+#define VB_VI_BLKS 4
+#define VB_CHN_BLKS 3
+#define VENC_MAX_PACKS 16
+#define VENC_SELECT_TIMEOUT_MS 500
+
+#define HTTP_PORT 8080
+#define HTTP_HEADER_MAX 4096
+#define HTTP_BODY_MAX 8192
+#define HTTP_RESPONSE_HEAD_MAX 768
+#define HTTP_MAX_CONNS 16
+#define HTTP_MAX_EVENTS 32
+#define HTTP_TICK_MS 100
+// Keep-alive connections, and writes that make no progress, are closed after this
+#define HTTP_IDLE_TIMEOUT_MS 15000
+#ifndef HTTP_DOC_ROOT
+#define HTTP_DOC_ROOT "/usr/www/webrtc"
+#endif
+
+// /mjpeg viewers get a frame from the JPEG channel at most this often
+#define MJPEG_INTERVAL_MS 200
+#define MJPEG_BOUNDARY "hi3516frame"
+
+/*
+ * One encoded JPEG. refs counts HTTP readers currently sending it; the
+ * stream thread only rewrites a slot that is unpublished and unreferenced,
+ * so readers never wait for the encoder and the encoder never waits for
+ * a slow client.
+ */
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t cap;
+    uint32_t seq;
+    uint64_t time_ms;
+    int refs;
+} JpegSlot;
+
 typedef struct {
     ot_vi_pipe vi_pipe;
     ot_vi_chn vi_chn;
@@ -66,71 +142,951 @@ typedef struct {
     ot_venc_chn venc_chn_mid;
     ot_venc_chn venc_chn_sub;
     ot_venc_chn jpeg_chn;
-    ot_rgn_handle time_rgn;
-    ot_rgn_handle cam_rgn;
-    uint8_t* latest_jpeg;
-    size_t latest_jpeg_size;
+    JpegSlot jpeg_slots[JPEG_SLOT_COUNT];
+    int jpeg_published;             // index of the newest slot, -1 before the first snapshot
+    uint32_t jpeg_seq;              // seq of the newest published snapshot
+    uint64_t jpeg_dropped;          // snapshots dropped because every slot was busy
+    // Guards only the on-demand encode handshake below, never held during I/O
     pthread_mutex_t jpeg_mutex;
+    int jpeg_pending;               // JPEG channel started and its picture not yet fetched
+    uint64_t jpeg_start_ms;         // when the pending picture was requested
+    int jpeg_event_fd;              // eventfd the stream thread signals after each JPEG picture
+    pthread_t stream_tid;
+    int stream_running;
+    uint64_t stream_frames[VENC_CHN_COUNT];
+    uint64_t stream_bytes[VENC_CHN_COUNT];
+    int stream_enabled[RTP_STREAM_COUNT];   // from WEBRTC_STREAMS; the main VPSS channel exists regardless, it feeds /snapshot
+    int pipeline_ready;             // VI -> VPSS -> VENC bound; set once by main, read by the HTTP thread
+    uint64_t isp_save_ms;
     int osd_enabled;
+    time_t osd_second;              // second shown by the timestamp overlay
 } AppContext;
 
 AppContext g_app = {
-    .latest_jpeg = NULL,
-    .latest_jpeg_size = 0,
+    .venc_chn_main = 0,
+    .venc_chn_mid = 1,
+    .venc_chn_sub = 2,
+    .jpeg_chn = 3,
+    .stream_enabled = {1, 1, 1},
+    .jpeg_published = -1,
+    .jpeg_event_fd = -1,
     .osd_enabled = 1
 };
 
-static int http_send_response(int client_fd, const char* status, const char* content_type, const char* body, size_t body_len)
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Take a reference on the newest snapshot. The published index is
+ * re-checked after the increment: if the stream thread republished in
+ * between, the slot may be reused, so drop it and retry.
+ */
+static JpegSlot* jpeg_acquire(void)
+{
+    for (;;) {
+        int idx = __atomic_load_n(&g_app.jpeg_published, __ATOMIC_SEQ_CST);
+        if (idx < 0) {
+            return NULL;
+        }
+        JpegSlot* slot = &g_app.jpeg_slots[idx];
+        __atomic_fetch_add(&slot->refs, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&g_app.jpeg_published, __ATOMIC_SEQ_CST) == idx) {
+            return slot;
+        }
+        __atomic_fetch_sub(&slot->refs, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void jpeg_release(JpegSlot* slot)
+{
+    __atomic_fetch_sub(&slot->refs, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copy one JPEG stream into a free slot and publish it. Runs on the
+ * stream thread; if every other slot is still being read, the snapshot
+ * is dropped rather than waiting.
+ */
+static void jpeg_publish(const ot_venc_stream* stream)
+{
+    int published = __atomic_load_n(&g_app.jpeg_published, __ATOMIC_SEQ_CST);
+    JpegSlot* slot = NULL;
+    int idx;
+    for (idx = 0; idx < JPEG_SLOT_COUNT; idx++) {
+        if (idx != published && __atomic_load_n(&g_app.jpeg_slots[idx].refs, __ATOMIC_SEQ_CST) == 0) {
+            slot = &g_app.jpeg_slots[idx];
+            break;
+        }
+    }
+    if (!slot) {
+        g_app.jpeg_dropped++;
+        return;
+    }
+
+    size_t size = 0;
+    for (td_u32 i = 0; i < stream->pack_cnt; i++) {
+        size += stream->pack[i].len - stream->pack[i].offset;
+    }
+    if (size > slot->cap) {
+        uint8_t* data = realloc(slot->data, size);
+        if (!data) {
+            g_app.jpeg_dropped++;
+            return;
+        }
+        slot->data = data;
+        slot->cap = size;
+    }
+    slot->size = 0;
+    for (td_u32 i = 0; i < stream->pack_cnt; i++) {
+        size_t len = stream->pack[i].len - stream->pack[i].offset;
+        memcpy(slot->data + slot->size, stream->pack[i].addr + stream->pack[i].offset, len);
+        slot->size += len;
+    }
+    slot->seq = g_app.jpeg_seq + 1;
+    slot->time_ms = monotonic_ms();
+    __atomic_store_n(&g_app.jpeg_published, idx, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&g_app.jpeg_seq, slot->seq, __ATOMIC_RELEASE);
+}
+
+/*
+ * Start the JPEG channel for a single picture unless one is already
+ * being encoded. Never waits: the stream thread signals jpeg_event_fd
+ * once the picture is published, and every waiter shares that picture.
+ */
+static int jpeg_trigger(void)
+{
+    if (!__atomic_load_n(&g_app.pipeline_ready, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    int ret = 0;
+    pthread_mutex_lock(&g_app.jpeg_mutex);
+    if (!g_app.jpeg_pending) {
+        ot_venc_start_param start_param = {
+            .recv_pic_num = 1
+        };
+        ret = ss_mpi_venc_start_chn(g_app.jpeg_chn, &start_param);
+        if (ret != 0) {
+            printf("ss_mpi_venc_start_chn(jpeg) failed: %#x\n", ret);
+        } else {
+            g_app.jpeg_pending = 1;
+            g_app.jpeg_start_ms = monotonic_ms();
+        }
+    }
+    pthread_mutex_unlock(&g_app.jpeg_mutex);
+    return ret == 0 ? 0 : -1;
+}
+
+/* Reset a picture that never arrived so the next trigger starts a new one */
+static void jpeg_expire(uint64_t now)
 {
-    char header[512];
-    int header_len = snprintf(header, sizeof(header),
+    pthread_mutex_lock(&g_app.jpeg_mutex);
+    if (g_app.jpeg_pending && now - g_app.jpeg_start_ms >= JPEG_ENCODE_TIMEOUT_MS) {
+        printf("JPEG snapshot timed out\n");
+        ss_mpi_venc_stop_chn(g_app.jpeg_chn);
+        g_app.jpeg_pending = 0;
+    }
+    pthread_mutex_unlock(&g_app.jpeg_mutex);
+}
+
+/*
+ * Fetch and release one stream from a VENC channel. JPEG streams are
+ * published for /snapshot; H.264 streams go to their RTP viewers while
+ * the packs are still held.
+ */
+static void venc_fetch_stream(int index, ot_venc_chn chn)
+{
+    ot_venc_chn_status status;
+    if (ss_mpi_venc_query_status(chn, &status) != 0 || status.cur_packs == 0) {
+        return;
+    }
+
+    ot_venc_pack packs[VENC_MAX_PACKS];
+    ot_venc_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.pack = status.cur_packs <= VENC_MAX_PACKS ? packs : malloc(sizeof(ot_venc_pack) * status.cur_packs);
+    if (!stream.pack) {
+        return;
+    }
+    stream.pack_cnt = status.cur_packs;
+
+    int ret = ss_mpi_venc_get_stream(chn, &stream, 0);
+    if (ret == 0) {
+        for (td_u32 i = 0; i < stream.pack_cnt; i++) {
+            g_app.stream_bytes[index] += stream.pack[i].len - stream.pack[i].offset;
+        }
+        g_app.stream_frames[index]++;
+
+        if (chn == g_app.jpeg_chn) {
+            jpeg_publish(&stream);
+        } else if (index < RTP_STREAM_COUNT) {
+            rtp_stream_send(index, &stream);
+        }
+        ss_mpi_venc_release_stream(chn, &stream);
+
+        if (chn == g_app.jpeg_chn) {
+            // The channel stops after its single picture; stop it explicitly so the next request can restart it
+            ss_mpi_venc_stop_chn(chn);
+            pthread_mutex_lock(&g_app.jpeg_mutex);
+            g_app.jpeg_pending = 0;
+            pthread_mutex_unlock(&g_app.jpeg_mutex);
+            uint64_t one = 1;
+            write(g_app.jpeg_event_fd, &one, sizeof(one));
+        }
+    }
+
+    if (stream.pack != packs) {
+        free(stream.pack);
+    }
+}
+
+/*
+ * Single thread draining all four VENC channels with select(), so a busy
+ * main stream cannot starve the snapshot channel and no channel needs its
+ * own polling loop.
+ */
+static void* venc_stream_thread(void* arg)
+{
+    (void)arg;
+    ot_venc_chn chns[VENC_CHN_COUNT] = {
+        g_app.venc_chn_main, g_app.venc_chn_mid, g_app.venc_chn_sub, g_app.jpeg_chn
+    };
+    int fds[VENC_CHN_COUNT];
+    int max_fd = -1;
+    for (int i = 0; i < VENC_CHN_COUNT; i++) {
+        fds[i] = ss_mpi_venc_get_fd(chns[i]);
+        if (fds[i] > max_fd) {
+            max_fd = fds[i];
+        }
+    }
+
+    printf("VENC stream thread started\n");
+    while (__atomic_load_n(&g_app.stream_running, __ATOMIC_ACQUIRE)) {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        for (int i = 0; i < VENC_CHN_COUNT; i++) {
+            if (fds[i] >= 0) {
+                FD_SET(fds[i], &read_fds);
+            }
+        }
+        struct timeval timeout = {
+            .tv_sec = 0,
+            .tv_usec = VENC_SELECT_TIMEOUT_MS * 1000
+        };
+        int ret = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("VENC select failed: %d\n", errno);
+            break;
+        }
+        for (int i = 0; i < VENC_CHN_COUNT && ret > 0; i++) {
+            if (fds[i] >= 0 && FD_ISSET(fds[i], &read_fds)) {
+                venc_fetch_stream(i, chns[i]);
+            }
+        }
+    }
+    printf("VENC stream thread stopped\n");
+    return NULL;
+}
+
+typedef enum {
+    HTTP_CONN_FREE = 0,
+    HTTP_CONN_READ,                 // collecting a request
+    HTTP_CONN_WRITE,                // draining a response
+    HTTP_CONN_SNAPSHOT,             // parked until the JPEG channel publishes
+    HTTP_CONN_MJPEG                 // multipart viewer waiting for its next frame
+} HttpConnState;
+
+/*
+ * The built-in page rendered for one local address, plain and gzip.
+ * Connections sending it hold a reference, so a re-render for another
+ * address never frees a body that is still being written.
+ */
+typedef struct {
+    int refs;
+    char ip[INET_ADDRSTRLEN];
+    uint8_t* html;
+    size_t html_len;
+    uint8_t* gz;                    // NULL if gzip did not make it smaller
+    size_t gz_len;
+    char etag[16];
+    char etag_gz[20];
+} HttpPage;
+
+/*
+ * One client connection. The request is collected in in[] across reads;
+ * the response is a header, a body from memory (copied, the page, or a
+ * referenced JPEG slot) or from a file, and an optional tail, drained by
+ * writev()/sendfile() as fast as the socket accepts it.
+ */
+typedef struct {
+    int fd;
+    HttpConnState state;
+    uint32_t events;                // epoll events currently registered
+    struct sockaddr_in peer;
+    char local_ip[INET_ADDRSTRLEN]; // address the client reached us on
+    uint64_t active_ms;             // last read or write progress
+    uint64_t wait_ms;               // start of a snapshot wait
+    uint32_t wait_seq;              // snapshot seq when the wait began
+    int keep_alive;
+    int mjpeg;
+    uint32_t mjpeg_seq;             // seq of the last frame sent to this viewer
+    char in[HTTP_HEADER_MAX + HTTP_BODY_MAX + 1];
+    size_t in_len;
+    size_t req_len;                 // bytes of in[] taken by the request being answered
+    char head[HTTP_RESPONSE_HEAD_MAX];
+    size_t head_len;
+    size_t head_off;
+    const uint8_t* body;
+    size_t body_len;
+    size_t body_off;
+    uint8_t* body_owned;            // freed with the response
+    JpegSlot* slot;                 // released with the response
+    HttpPage* page;                 // released with the response
+    int file_fd;
+    off_t file_off;
+    off_t file_end;
+    const char* tail;
+    size_t tail_len;
+    size_t tail_off;
+} HttpConn;
+
+typedef struct {
+    char method[16];
+    char path[256];
+    char version[16];
+    const char* body;
+    int accept_gzip;
+    char if_none_match[80];
+} HttpRequest;
+
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    HttpConn conns[HTTP_MAX_CONNS];
+    int mjpeg_viewers;
+    uint64_t mjpeg_trigger_ms;
+    HttpPage* index;
+} HttpServer;
+
+// epoll data for the two non-connection descriptors; connections use their index
+#define HTTP_EV_LISTEN HTTP_MAX_CONNS
+#define HTTP_EV_JPEG (HTTP_MAX_CONNS + 1)
+#define HTTP_EV_RTCP (HTTP_MAX_CONNS + 2)
+
+static HttpServer g_http = {
+    .epoll_fd = -1,
+    .listen_fd = -1
+};
+
+static void http_page_put(HttpPage* page)
+{
+    if (page && --page->refs == 0) {
+        free(page->html);
+        free(page->gz);
+        free(page);
+    }
+}
+
+/*
+ * Render the built-in page for one local address. The template holds a
+ * single "%s" for the IP and is otherwise copied verbatim, so the "%" in
+ * its CSS never goes through printf.
+ */
+static HttpPage* http_page_render(const char* html_template, const char* ip)
+{
+    HttpPage* page = calloc(1, sizeof(*page));
+    if (!page) {
+        return NULL;
+    }
+    const char* mark = strstr(html_template, "%s");
+    size_t template_len = strlen(html_template);
+    size_t ip_len = strlen(ip);
+    page->html_len = mark ? template_len - 2 + ip_len : template_len;
+    page->html = malloc(page->html_len);
+    if (!page->html) {
+        free(page);
+        return NULL;
+    }
+    if (mark) {
+        size_t prefix = (size_t)(mark - html_template);
+        memcpy(page->html, html_template, prefix);
+        memcpy(page->html + prefix, ip, ip_len);
+        memcpy(page->html + prefix + ip_len, mark + 2, template_len - prefix - 2);
+    } else {
+        memcpy(page->html, html_template, template_len);
+    }
+
+    if (gzip_compress(page->html, page->html_len, &page->gz, &page->gz_len) != 0 || page->gz_len >= page->html_len) {
+        free(page->gz);
+        page->gz = NULL;
+        page->gz_len = 0;
+    }
+    uint32_t crc = gzip_crc32(page->html, page->html_len);
+    snprintf(page->etag, sizeof(page->etag), "\"%08x\"", crc);
+    snprintf(page->etag_gz, sizeof(page->etag_gz), "\"%08x-gz\"", crc);
+    snprintf(page->ip, sizeof(page->ip), "%s", ip);
+    page->refs = 1;
+    printf("Index page for %s: %zu bytes, %zu gzip\n", ip, page->html_len, page->gz_len);
+    return page;
+}
+
+static void http_conn_watch(HttpConn* c, uint32_t events)
+{
+    if (c->events == events) {
+        return;
+    }
+    struct epoll_event ev = {
+        .events = events,
+        .data.u32 = (uint32_t)(c - g_http.conns)
+    };
+    if (epoll_ctl(g_http.epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) == 0) {
+        c->events = events;
+    }
+}
+
+static void http_conn_clear_response(HttpConn* c)
+{
+    if (c->slot) {
+        jpeg_release(c->slot);
+        c->slot = NULL;
+    }
+    http_page_put(c->page);
+    c->page = NULL;
+    free(c->body_owned);
+    c->body_owned = NULL;
+    if (c->file_fd >= 0) {
+        close(c->file_fd);
+        c->file_fd = -1;
+    }
+    c->head_len = c->head_off = 0;
+    c->body = NULL;
+    c->body_len = c->body_off = 0;
+    c->file_off = c->file_end = 0;
+    c->tail = NULL;
+    c->tail_len = c->tail_off = 0;
+}
+
+/*
+ * Queue the status line and headers. A NULL content type and a negative
+ * length leave those headers out (304, and the open-ended MJPEG stream).
+ */
+static int http_queue_head(HttpConn* c, const char* status, const char* content_type,
+                           const char* extra_headers, long long content_length)
+{
+    char type[96] = "";
+    char length[48] = "";
+    if (content_type) {
+        snprintf(type, sizeof(type), "Content-Type: %s\r\n", content_type);
+    }
+    if (content_length >= 0) {
+        snprintf(length, sizeof(length), "Content-Length: %lld\r\n", content_length);
+    }
+    int len = snprintf(c->head, sizeof(c->head),
         "HTTP/1.1 %s\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
+        "%s%s"
+        "Connection: %s\r\n"
+        "%s"
         "\r\n",
-        status, content_type, body_len);
-    
-    write(client_fd, header, header_len);
+        status, type, length, c->keep_alive ? "keep-alive" : "close", extra_headers ? extra_headers : "");
+    if (len < 0 || (size_t)len >= sizeof(c->head)) {
+        return -1;
+    }
+    c->head_len = (size_t)len;
+    c->head_off = 0;
+    c->state = HTTP_CONN_WRITE;
+    return 0;
+}
+
+/* Small generated responses: the body is copied so the caller's buffer may go away */
+static int http_send_response(HttpConn* c, const char* status, const char* content_type, const char* body, size_t body_len)
+{
+    if (http_queue_head(c, status, content_type, NULL, (long long)body_len) != 0) {
+        return -1;
+    }
     if (body && body_len > 0) {
-        write(client_fd, body, body_len);
+        c->body_owned = malloc(body_len);
+        if (!c->body_owned) {
+            return -1;
+        }
+        memcpy(c->body_owned, body, body_len);
+        c->body = c->body_owned;
+        c->body_len = body_len;
     }
-    
     return 0;
 }
 
-static void get_local_ip(char* ip, size_t size)
+static int http_etag_match(const HttpRequest* req, const char* etag)
 {
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0) {
-        strncpy(ip, "127.0.0.1", size);
-        return;
+    return req->if_none_match[0] &&
+           (strcmp(req->if_none_match, "*") == 0 || strstr(req->if_none_match, etag) != NULL);
+}
+
+static int http_send_not_modified(HttpConn* c, const char* etag)
+{
+    char extra[96];
+    snprintf(extra, sizeof(extra), "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+    return http_queue_head(c, "304 Not Modified", NULL, extra, -1);
+}
+
+/* Takes over the caller's reference on slot */
+static int http_send_slot(HttpConn* c, JpegSlot* slot)
+{
+    if (http_queue_head(c, "200 OK", "image/jpeg", "Cache-Control: no-cache\r\n", (long long)slot->size) != 0) {
+        jpeg_release(slot);
+        return -1;
     }
-    
-    struct sockaddr_in serv;
-    memset(&serv, 0, sizeof(serv));
-    serv.sin_family = AF_INET;
-    serv.sin_addr.s_addr = inet_addr("8.8.8.8");
-    serv.sin_port = htons(53);
-    
-    if (connect(sock, (struct sockaddr*)&serv, sizeof(serv)) < 0) {
-        strncpy(ip, "127.0.0.1", size);
-        close(sock);
-        return;
+    c->slot = slot;
+    c->body = slot->data;
+    c->body_len = slot->size;
+    return 0;
+}
+
+/*
+ * The built-in page is rendered and compressed once per local address
+ * instead of on every GET /, then served from memory with an ETag so a
+ * reload costs a 304 or one writev().
+ */
+static int http_send_index(HttpConn* c, const HttpRequest* req, const char* html_template)
+{
+    if (!g_http.index || strcmp(g_http.index->ip, c->local_ip) != 0) {
+        HttpPage* page = http_page_render(html_template, c->local_ip);
+        if (!page) {
+            const char* msg = "Out of memory";
+            return http_send_response(c, "500 Internal Server Error", "text/plain", msg, strlen(msg));
+        }
+        http_page_put(g_http.index);
+        g_http.index = page;
     }
-    
-    struct sockaddr_in local;
-    socklen_t local_len = sizeof(local);
-    getsockname(sock, (struct sockaddr*)&local, &local_len);
-    inet_ntop(AF_INET, &local.sin_addr, ip, size);
-    close(sock);
+
+    HttpPage* page = g_http.index;
+    int gzip = req->accept_gzip && page->gz;
+    const char* etag = gzip ? page->etag_gz : page->etag;
+    if (http_etag_match(req, etag)) {
+        return http_send_not_modified(c, etag);
+    }
+    char extra[160];
+    snprintf(extra, sizeof(extra), "ETag: %s\r\nCache-Control: no-cache\r\nVary: Accept-Encoding\r\n%s",
+             etag, gzip ? "Content-Encoding: gzip\r\n" : "");
+    size_t len = gzip ? page->gz_len : page->html_len;
+    if (http_queue_head(c, "200 OK", "text/html", extra, (long long)len) != 0) {
+        return -1;
+    }
+    page->refs++;
+    c->page = page;
+    c->body = gzip ? page->gz : page->html;
+    c->body_len = len;
+    return 0;
+}
+
+static const char* http_mime_type(const char* path)
+{
+    static const struct {
+        const char* ext;
+        const char* type;
+    } types[] = {
+        { ".html", "text/html" },
+        { ".htm", "text/html" },
+        { ".js", "application/javascript" },
+        { ".css", "text/css" },
+        { ".json", "application/json" },
+        { ".svg", "image/svg+xml" },
+        { ".png", "image/png" },
+        { ".jpg", "image/jpeg" },
+        { ".jpeg", "image/jpeg" },
+        { ".ico", "image/x-icon" },
+        { ".txt", "text/plain" },
+        { ".xml", "application/xml" }
+    };
+    const char* ext = strrchr(path, '.');
+    if (ext) {
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+            if (strcasecmp(ext, types[i].ext) == 0) {
+                return types[i].type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+static int http_open_regular(const char* path, struct stat* st)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0 && (fstat(fd, st) != 0 || !S_ISREG(st->st_mode))) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/*
+ * Serve a file under HTTP_DOC_ROOT with sendfile(). A "<name>.gz" next
+ * to it, compressed at install time, is sent instead when the client
+ * accepts gzip. Returns 1 if there is no such file.
+ */
+static int http_send_file(HttpConn* c, const HttpRequest* req, const char* path)
+{
+    char file[320];
+    char gz_file[sizeof(file) + 3];
+    if (path[0] != '/' || strstr(path, "..") ||
+        (size_t)snprintf(file, sizeof(file), "%s%s", HTTP_DOC_ROOT, path) >= sizeof(file)) {
+        return 1;
+    }
+
+    struct stat st;
+    int gzip = 0;
+    int fd = -1;
+    if (req->accept_gzip) {
+        snprintf(gz_file, sizeof(gz_file), "%s.gz", file);
+        fd = http_open_regular(gz_file, &st);
+        gzip = fd >= 0;
+    }
+    if (fd < 0) {
+        fd = http_open_regular(file, &st);
+    }
+    if (fd < 0) {
+        return 1;
+    }
+
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx%s\"",
+             (unsigned long long)st.st_size, (unsigned long long)st.st_mtime, gzip ? "-gz" : "");
+    if (http_etag_match(req, etag)) {
+        close(fd);
+        return http_send_not_modified(c, etag);
+    }
+    char extra[160];
+    snprintf(extra, sizeof(extra), "ETag: %s\r\nCache-Control: no-cache\r\nVary: Accept-Encoding\r\n%s",
+             etag, gzip ? "Content-Encoding: gzip\r\n" : "");
+    if (http_queue_head(c, "200 OK", http_mime_type(file), extra, (long long)st.st_size) != 0) {
+        close(fd);
+        return -1;
+    }
+    c->file_fd = fd;
+    c->file_off = 0;
+    c->file_end = st.st_size;
+    return 0;
 }
 
-static int handle_http_request(int client_fd, const char* path, const char* method)
+/*
+ * GET /snapshot: serve a picture younger than JPEG_FRESH_MS at once,
+ * otherwise request one and park the connection until the stream thread
+ * publishes it; the event loop keeps serving everyone else meanwhile.
+ */
+static int http_send_snapshot(HttpConn* c)
 {
-    char local_ip[64] = {0};
-    get_local_ip(local_ip, sizeof(local_ip));
+    JpegSlot* slot = jpeg_acquire();
+    if (slot) {
+        if (monotonic_ms() - slot->time_ms < JPEG_FRESH_MS) {
+            return http_send_slot(c, slot);
+        }
+        jpeg_release(slot);
+    }
+
+    uint32_t seq = __atomic_load_n(&g_app.jpeg_seq, __ATOMIC_ACQUIRE);
+    if (jpeg_trigger() != 0) {
+        const char* msg = "Snapshot not ready";
+        return http_send_response(c, "503 Service Unavailable", "text/plain", msg, strlen(msg));
+    }
+    c->state = HTTP_CONN_SNAPSHOT;
+    c->wait_ms = monotonic_ms();
+    c->wait_seq = seq;
+    http_conn_watch(c, 0);
+    return 0;
+}
+
+/* GET /mjpeg: an open-ended multipart/x-mixed-replace response, one part per JPEG picture */
+static int mjpeg_start(HttpConn* c)
+{
+    c->keep_alive = 0;
+    if (http_queue_head(c, "200 OK", "multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY,
+                        "Cache-Control: no-cache\r\n", -1) != 0) {
+        return -1;
+    }
+    c->mjpeg = 1;
+    c->mjpeg_seq = 0;
+    g_http.mjpeg_viewers++;
+    g_http.mjpeg_trigger_ms = monotonic_ms();
+    jpeg_trigger();
+
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &c->peer.sin_addr, client_ip, sizeof(client_ip));
+    printf("MJPEG viewer %s:%d joined (%d viewers)\n", client_ip, ntohs(c->peer.sin_port), g_http.mjpeg_viewers);
+    return 0;
+}
+
+/*
+ * Pull the SDP out of an offer body: either the "sdp" string of the
+ * JSON {type, sdp} object the page posts, or a raw SDP body.
+ */
+static int offer_extract_sdp(const char* body, char* sdp, size_t size)
+{
+    const char* p = strstr(body, "\"sdp\"");
+    if (!p) {
+        snprintf(sdp, size, "%s", body);
+        return 0;
+    }
+    p = strchr(p + 5, ':');
+    if (!p) {
+        return -1;
+    }
+    p++;
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    if (*p++ != '"') {
+        return -1;
+    }
+
+    size_t n = 0;
+    while (*p && *p != '"' && n + 1 < size) {
+        char c = *p++;
+        if (c == '\\' && *p) {
+            c = *p++;
+            if (c == 'r') {
+                c = '\r';
+            } else if (c == 'n') {
+                c = '\n';
+            } else if (c == 't') {
+                c = '\t';
+            }
+        }
+        sdp[n++] = c;
+    }
+    sdp[n] = '\0';
+    return *p == '"' ? 0 : -1;
+}
+
+/*
+ * Receiver address from the offer's m=video port and c= line. Video is
+ * only ever sent to the host that made the offer: a c= address other
+ * than the HTTP peer (or 0.0.0.0) is refused with -2, so an HTTP client
+ * cannot point the stream at a third party.
+ */
+static int offer_parse_dst(const char* sdp, const struct sockaddr_in* peer, struct sockaddr_in* dst)
+{
+    const char* m = strstr(sdp, "m=video ");
+    int port = 0;
+    if (!m || sscanf(m + 8, "%d", &port) != 1 || port < 1024 || port > 65535) {
+        return -1;
+    }
+
+    memset(dst, 0, sizeof(*dst));
+    dst->sin_family = AF_INET;
+    dst->sin_port = htons((uint16_t)port);
+    dst->sin_addr = peer->sin_addr;
+
+    // A media-level c= line overrides the session-level one
+    const char* c = strstr(m, "c=IN IP4 ");
+    if (!c) {
+        c = strstr(sdp, "c=IN IP4 ");
+    }
+    char ip[INET_ADDRSTRLEN] = {0};
+    struct in_addr addr;
+    if (c && sscanf(c + 9, "%15[0-9.]", ip) == 1 && inet_pton(AF_INET, ip, &addr) == 1 &&
+        addr.s_addr != INADDR_ANY && addr.s_addr != peer->sin_addr.s_addr) {
+        return -2;
+    }
+    return 0;
+}
+
+static size_t json_escape(const char* in, char* out, size_t size)
+{
+    size_t n = 0;
+    for (; *in && n + 2 < size; in++) {
+        if (*in == '\r' || *in == '\n') {
+            out[n++] = '\\';
+            out[n++] = *in == '\r' ? 'r' : 'n';
+        } else if (*in == '"' || *in == '\\') {
+            out[n++] = '\\';
+            out[n++] = *in;
+        } else {
+            out[n++] = *in;
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+/*
+ * POST /offer/<main|mid|sub>: add the offerer as a plain RTP/AVP viewer
+ * of the chosen stream and answer with a sendonly H.264 description.
+ * Plain RTP needs a non-browser receiver (ffplay/VLC opening the answer
+ * as an .sdp file) on the offering host. Offers that require DTLS-SRTP
+ * (every browser RTCPeerConnection) are refused with 501; browsers watch
+ * /mjpeg instead.
+ */
+static int handle_offer(HttpConn* c, const char* stream_name, const char* body,
+                        const struct sockaddr_in* peer, const char* local_ip)
+{
+    int stream = rtp_stream_index(stream_name);
+    if (stream < 0) {
+        const char* msg = "Unknown stream, use main, mid or sub";
+        return http_send_response(c, "404 Not Found", "text/plain", msg, strlen(msg));
+    }
+    if (!g_app.stream_enabled[stream]) {
+        const char* msg = "Stream is disabled";
+        return http_send_response(c, "404 Not Found", "text/plain", msg, strlen(msg));
+    }
+    if (!__atomic_load_n(&g_app.pipeline_ready, __ATOMIC_ACQUIRE)) {
+        const char* msg = "Camera is starting";
+        return http_send_response(c, "503 Service Unavailable", "text/plain", msg, strlen(msg));
+    }
+
+    char sdp[HTTP_BODY_MAX];
+    if (!body || offer_extract_sdp(body, sdp, sizeof(sdp)) != 0 || strncmp(sdp, "v=0", 3) != 0) {
+        const char* msg = "Offer body must be an SDP or {\"type\":\"offer\",\"sdp\":...}";
+        return http_send_response(c, "400 Bad Request", "text/plain", msg, strlen(msg));
+    }
+    if (strstr(sdp, "a=fingerprint:") || strstr(sdp, "/SAVPF") || strstr(sdp, "/SAVP ")) {
+        const char* msg = "DTLS-SRTP is not supported; offer RTP/AVP or use an RTP gateway";
+        return http_send_response(c, "501 Not Implemented", "text/plain", msg, strlen(msg));
+    }
+
+    struct sockaddr_in dst;
+    int ret = offer_parse_dst(sdp, peer, &dst);
+    if (ret == -2) {
+        const char* msg = "Video is only sent to the offering host";
+        return http_send_response(c, "403 Forbidden", "text/plain", msg, strlen(msg));
+    }
+    if (ret != 0) {
+        const char* msg = "Offer has no valid m=video port";
+        return http_send_response(c, "400 Bad Request", "text/plain", msg, strlen(msg));
+    }
+
+    uint32_t viewer_id = 0;
+    if (rtp_viewer_add(stream, &dst, &viewer_id) != 0) {
+        const char* msg = "No free viewer slot";
+        return http_send_response(c, "503 Service Unavailable", "text/plain", msg, strlen(msg));
+    }
+    // An idle channel starts now and opens with an IDR; a running one got an IDR request from rtp_viewer_add
+    if (venc_ctrl_acquire(stream) != 0) {
+        rtp_viewer_remove(viewer_id);
+        const char* msg = "Encoder channel could not be started";
+        return http_send_response(c, "503 Service Unavailable", "text/plain", msg, strlen(msg));
+    }
+
+    char sprop[256];
+    char fmtp[320] = "packetization-mode=1";
+    if (rtp_stream_sprop(stream, sprop, sizeof(sprop)) == 0) {
+        snprintf(fmtp, sizeof(fmtp), "packetization-mode=1;sprop-parameter-sets=%s", sprop);
+    }
+    char dst_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &dst.sin_addr, dst_ip, sizeof(dst_ip));
+
+    // Receiver reports, REMB and PLI/FIR drive the viewer's rate and keyframes
+    char rtcp[256] = "";
+    if (rtp_rtcp_port() != 0) {
+        snprintf(rtcp, sizeof(rtcp),
+            "a=rtcp:%u IN IP4 %s\r\n"
+            "a=rtcp-fb:%d nack pli\r\n"
+            "a=rtcp-fb:%d ccm fir\r\n"
+            "a=rtcp-fb:%d goog-remb\r\n",
+            rtp_rtcp_port(), local_ip, RTP_PAYLOAD_TYPE, RTP_PAYLOAD_TYPE, RTP_PAYLOAD_TYPE);
+    }
+
+    char answer[1024];
+    snprintf(answer, sizeof(answer),
+        "v=0\r\n"
+        "o=- %u 1 IN IP4 %s\r\n"
+        "s=Hi3516 %s\r\n"
+        "c=IN IP4 %s\r\n"
+        "t=0 0\r\n"
+        "m=video %d RTP/AVP %d\r\n"
+        "a=rtpmap:%d H264/90000\r\n"
+        "a=fmtp:%d %s\r\n"
+        "%s"
+        "a=sendonly\r\n",
+        viewer_id, local_ip, rtp_stream_name(stream), dst_ip,
+        ntohs(dst.sin_port), RTP_PAYLOAD_TYPE, RTP_PAYLOAD_TYPE, RTP_PAYLOAD_TYPE, fmtp, rtcp);
+
+    char escaped[2048];
+    json_escape(answer, escaped, sizeof(escaped));
+    char response[2304];
+    int len = snprintf(response, sizeof(response),
+        "{\"type\":\"answer\",\"sdp\":\"%s\",\"viewer_id\":%u}", escaped, viewer_id);
+    printf("RTP answer for viewer %u (%s)\n", viewer_id, rtp_stream_name(stream));
+    return http_send_response(c, "200 OK", "application/json", response, (size_t)len);
+}
+
+/* Unsigned value of name=<n> in a query string, 0 if absent */
+static uint32_t query_u32(const char* query, const char* name)
+{
+    size_t name_len = strlen(name);
+    for (const char* p = query; p && *p; p = strchr(p, '&')) {
+        if (*p == '&' || *p == '?') {
+            p++;
+        }
+        if (strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            return (uint32_t)strtoul(p + name_len + 1, NULL, 10);
+        }
+    }
+    return 0;
+}
+
+/*
+ * POST /stream/<main|mid|sub>?bitrate=&fps=&gop=: change a stream's
+ * configured ceiling at runtime. Viewer feedback keeps adapting below it.
+ */
+static int handle_stream_config(HttpConn* c, const char* stream_name, const char* query)
+{
+    int stream = rtp_stream_index(stream_name);
+    if (stream < 0) {
+        const char* msg = "Unknown stream, use main, mid or sub";
+        return http_send_response(c, "404 Not Found", "text/plain", msg, strlen(msg));
+    }
+    if (venc_ctrl_configure(stream, query_u32(query, "bitrate"), query_u32(query, "fps"),
+                            query_u32(query, "gop")) != 0) {
+        const char* msg = "Invalid bitrate, fps or gop";
+        return http_send_response(c, "400 Bad Request", "text/plain", msg, strlen(msg));
+    }
+    char status[1024];
+    size_t len = venc_ctrl_status_json(status, sizeof(status));
+    return http_send_response(c, "200 OK", "application/json", status, len);
+}
+
+/*
+ * POST /osd/<label|measure>: show the first line of the body in an
+ * overlay, e.g. the latest result forwarded from the image processor
+ */
+static int handle_osd_text(HttpConn* c, const char* name, const char* body)
+{
+    int id = -1;
+    if (strcmp(name, "label") == 0) {
+        id = OSD_LABEL;
+    } else if (strcmp(name, "measure") == 0) {
+        id = OSD_MEASURE;
+    }
+    if (id < 0) {
+        const char* msg = "Unknown overlay, use label or measure";
+        return http_send_response(c, "404 Not Found", "text/plain", msg, strlen(msg));
+    }
+    if (!__atomic_load_n(&g_app.pipeline_ready, __ATOMIC_ACQUIRE) || !g_app.osd_enabled) {
+        const char* msg = "OSD is not available";
+        return http_send_response(c, "503 Service Unavailable", "text/plain", msg, strlen(msg));
+    }
     
+    const char* text = body ? body : "";
+    char line[OSD_MAX_CELLS + 1];
+    snprintf(line, sizeof(line), "%.*s", (int)strcspn(text, "\r\n"), text);
+    if (osd_overlay_set_text(id, line) != 0) {
+        const char* msg = "OSD update failed";
+        return http_send_response(c, "500 Internal Server Error", "text/plain", msg, strlen(msg));
+    }
+    return http_send_response(c, "200 OK", "text/plain", "OK", 2);
+}
+
+static int handle_http_request(HttpConn* c, const HttpRequest* req)
+{
+    const char* method = req->method;
+    char path[sizeof(req->path)];
+    snprintf(path, sizeof(path), "%.*s", (int)strcspn(req->path, "?"), req->path);
+
     if (strcmp(method, "GET") == 0) {
         if (strcmp(path, "/") == 0) {
             const char* html_page = "<!DOCTYPE html>"
@@ -144,7 +1100,7 @@ static int handle_http_request(int client_fd, const char* path, const char* meth
 ".container{max-width:1200px;margin:0 auto;padding:10px}"
 "h1{font-size:clamp(1.2rem,4vw,1.8rem);text-align:center;padding:10px 0}"
 "h2{font-size:clamp(1rem,3vw,1.4rem);text-align:center;padding:8px 0}"
-"video{width:100%;max-height:50vh;background:#000;border-radius:8px;display:block}"
+"#video{width:100%;max-height:50vh;background:#000;border-radius:8px;display:block;object-fit:contain}"
 ".controls{display:flex;flex-wrap:wrap;gap:8px;justify-content:center;padding:10px 0}"
 "button{padding:12px 24px;font-size:clamp(14px,3vw,16px);cursor:pointer;border-radius:8px;border:none;flex:1;min-width:120px;max-width:200px}"
 ".btn-main{background:#4CAF50;color:white}"
@@ -167,12 +1123,20 @@ static int handle_http_request(int client_fd, const char* path, const char* meth
 ".config-section{background:#2a2a4e;border-radius:12px;padding:15px;margin:10px 0}"
 ".calib-section{background:#2a2a4e;border-radius:12px;padding:15px;margin:10px 0}"
 "@media(max-width:480px){.container{padding:5px}button{padding:14px 10px;min-width:100px}h1{padding:8px 0}}"
-"@media(orientation:landscape) and (max-height:500px){video{max-height:40vh}.controls{padding:5px 0}}"
+"@media(orientation:landscape) and (max-height:500px){#video{max-height:40vh}.controls{padding:5px 0}}"
 "</style>"
 "</head><body>"
 "<div class=\"container\">"
-"<h1>Hi3516CV610 WebRTC H.264</h1>"
+"<h1>Hi3516CV610 实时视频</h1>"
 "<div id=\"status\" class=\"status disconnected\">未连接</div>"
+"<img id=\"video\" alt=\"\">"
+"<div class=\"controls\">"
+"<button class=\"btn-main\" onclick=\"start()\">播放</button>"
+"<button class=\"btn-stop\" onclick=\"stop()\">停止</button>"
+"<button class=\"btn-snapshot\" onclick=\"snapshot()\">截图</button>"
+"</div>"
+"<div class=\"config-section\">"
+"<h2>H.264 RTP（VLC/ffplay）</h2>"
 "<div class=\"stream-select\">"
 "  <label>码流:</label>"
 "  <select id=\"stream\">"
@@ -180,12 +1144,14 @@ static int handle_http_request(int client_fd, const char* path, const char* meth
 "    <option value=\"mid\">中码流 1080p (1920x1080)</option>"
 "    <option value=\"sub\">子码流 480p (720x480)</option>"
 "  </select>"
+"  <label>本机端口:</label>"
+"  <input type=\"text\" id=\"rtpPort\" value=\"5004\" style=\"max-width:120px;min-width:80px\">"
 "</div>"
-"<video id=\"video\" autoplay playsinline muted></video>"
 "<div class=\"controls\">"
-"<button class=\"btn-main\" onclick=\"start()\">播放</button>"
-"<button class=\"btn-stop\" onclick=\"stop()\">停止</button>"
-"<button class=\"btn-snapshot\" onclick=\"snapshot()\">截图</button>"
+"<button class=\"btn-main\" onclick=\"startRtp()\">推流到本机</button>"
+"<button class=\"btn-stop\" onclick=\"stopRtp()\">停止推流</button>"
+"</div>"
+"<div id=\"rtpStatus\" class=\"status disconnected\">未推流（浏览器不能直接播放 RTP，用 VLC/ffplay 打开下载的 .sdp 文件）</div>"
 "</div>"
 "<div class=\"config-section\">"
 "<h2>服务器配置</h2>"
@@ -215,43 +1181,55 @@ static int handle_http_request(int client_fd, const char* path, const char* meth
 "<p style=\"text-align:center;color:#888;margin-top:10px\">IP: %s</p>"
 "</div>"
 "<script>"
-"let pc = null;"
+"let viewerId = 0;"
 "let uploadInProgress = false;"
-"async function start() {"
-"    if (pc) { pc.close(); }"
+"function start() {"
+"    const v = document.getElementById('video');"
+"    setStatus('connecting', '正在连接...');"
+"    v.onload = () => setStatus('connected', '已连接 ✓ MJPEG');"
+"    v.onerror = () => setStatus('error', '连接失败');"
+"    v.src = '/mjpeg?t=' + Date.now();"
+"}"
+"function stop() {"
+"    const v = document.getElementById('video');"
+"    v.onload = v.onerror = null;"
+"    v.removeAttribute('src');"
+"    setStatus('disconnected', '已停止');"
+"    stopRtp();"
+"}"
+"async function startRtp() {"
+"    stopRtp();"
 "    const stream = document.getElementById('stream').value;"
-"    const streamNames = {main:'主码流 4K', mid:'中码流 1080p', sub:'子码流 480p'};"
-"    setStatus('connecting', '正在连接 ' + streamNames[stream] + '...');"
-"    pc = new RTCPeerConnection({ iceServers: [] });"
-"    pc.addTransceiver('video', {direction: 'recvonly'});"
-"    pc.ontrack = e => { document.getElementById('video').srcObject = e.streams[0]; };"
-"    pc.oniceconnectionstatechange = () => {"
-"        if (pc.iceConnectionState === 'connected') {"
-"            setStatus('connected', '已连接 ✓ ' + streamNames[stream]);"
-"        } else if (pc.iceConnectionState === 'disconnected' || pc.iceConnectionState === 'failed') {"
-"            setStatus('disconnected', '连接断开');"
-"        }"
-"    };"
-"    const offer = await pc.createOffer();"
-"    await pc.setLocalDescription(offer);"
-"    await new Promise(r => {"
-"        if (pc.iceGatheringState === 'complete') r();"
-"        else pc.onicegatheringstatechange = () => { if (pc.iceGatheringState === 'complete') r(); };"
-"    });"
-"    let sdp = pc.localDescription.sdp;"
-"    const lines = sdp.split('\\r\\n').filter(line => !line.includes('.local'));"
-"    sdp = lines.join('\\r\\n');"
-"    const filteredOffer = {type: pc.localDescription.type, sdp: sdp};"
+"    const port = parseInt(document.getElementById('rtpPort').value, 10);"
+"    const offer = 'v=0\\r\\no=- 0 0 IN IP4 0.0.0.0\\r\\ns=-\\r\\nc=IN IP4 0.0.0.0\\r\\nt=0 0\\r\\n' +"
+"        'm=video ' + port + ' RTP/AVP 96\\r\\na=rtpmap:96 H264/90000\\r\\na=recvonly\\r\\n';"
+"    setRtpStatus('connecting', '正在请求 ' + stream + ' ...');"
 "    const resp = await fetch('/offer/' + stream, {"
-"        method: 'POST', headers: {'Content-Type': 'application/json'}, "
-"        body: JSON.stringify(filteredOffer)});"
+"        method: 'POST', headers: {'Content-Type': 'application/json'},"
+"        body: JSON.stringify({type: 'offer', sdp: offer})});"
+"    if (!resp.ok) {"
+"        setRtpStatus('error', '推流失败: ' + await resp.text());"
+"        return;"
+"    }"
 "    const answer = await resp.json();"
-"    await pc.setRemoteDescription(answer);"
+"    viewerId = answer.viewer_id;"
+"    const a = document.createElement('a');"
+"    a.href = URL.createObjectURL(new Blob([answer.sdp], {type: 'application/sdp'}));"
+"    a.download = 'hi3516_' + stream + '.sdp';"
+"    a.click();"
+"    setRtpStatus('connected', '正在推流到本机端口 ' + port + '，用 VLC/ffplay 打开 ' + a.download);"
+"}"
+"function stopRtp() {"
+"    if (!viewerId) return;"
+"    fetch('/stop/' + viewerId, {method: 'POST'});"
+"    viewerId = 0;"
+"    setRtpStatus('disconnected', '已停止推流');"
 "}"
-"function stop() { if (pc) { pc.close(); pc = null; } "
-"setStatus('disconnected', '已停止'); document.getElementById('video').srcObject = null; }"
+"window.addEventListener('pagehide', () => { if (viewerId) navigator.sendBeacon('/stop/' + viewerId); });"
 "function setStatus(cls, txt) { const s = document.getElementById('status'); "
 "s.className = 'status ' + cls; s.textContent = txt; }"
+"function setRtpStatus(cls, txt) { const s = document.getElementById('rtpStatus'); "
+"s.className = 'status ' + cls; s.textContent = txt; }"
 "function setCalibStatus(cls, txt) { const s = document.getElementById('calibStatus'); "
 "s.className = 'status ' + cls; s.textContent = txt; }"
 "function snapshot() {"
@@ -278,7 +1256,7 @@ static int handle_http_request(int client_fd, const char* path, const char* meth
 "        if (!uploadResponse.ok) throw new Error('上传失败');"
 "        const result = await uploadResponse.json();"
 "        setCalibStatus('success', '标定图片上传成功: ' + result.message);"
-"        // 自动检查标定状态"
+"        /* 自动检查标定状态 */"
 "        await checkCalibrationStatus();"
 "    } catch (error) {"
 "        setCalibStatus('error', '上传失败: ' + error.message);"
@@ -353,94 +1331,527 @@ static int handle_http_request(int client_fd, const char* path, const char* meth
 "        setCalibStatus('error', '获取状态失败: ' + error.message);"
 "    }"
 "}"
-"// 页面加载时检查标定状态"
+"/* 页面加载时检查标定状态 */"
 "window.onload = function() {"
 "    checkCalibrationStatus();"
 "};"
 "</script>"
 "</body></html>";
-            char response[16384];
-            snprintf(response, sizeof(response), html_page, local_ip);
-            return http_send_response(client_fd, "200 OK", "text/html", response, strlen(response));
+            // An index.html installed under HTTP_DOC_ROOT takes precedence over the built-in page
+            int ret = http_send_file(c, req, "/index.html");
+            return ret == 1 ? http_send_index(c, req, html_page) : ret;
+        }
+        else if (strcmp(path, "/snapshot") == 0) {
+            return http_send_snapshot(c);
+        }
+        else if (strcmp(path, "/mjpeg") == 0) {
+            return mjpeg_start(c);
+        }
+        else if (strcmp(path, "/streams") == 0) {
+            char status[1024];
+            size_t len = venc_ctrl_status_json(status, sizeof(status));
+            return http_send_response(c, "200 OK", "application/json", status, len);
+        }
+        int ret = http_send_file(c, req, path);
+        if (ret != 1) {
+            return ret;
+        }
+    }
+    else if (strcmp(method, "POST") == 0 && strncmp(path, "/offer/", 7) == 0) {
+        printf("Received offer request for path: %s\n", path);
+        return handle_offer(c, path + 7, req->body, &c->peer, c->local_ip);
+    }
+    else if (strcmp(method, "POST") == 0 && strncmp(path, "/stream/", 8) == 0) {
+        return handle_stream_config(c, path + 8, strchr(req->path, '?'));
+    }
+    else if (strcmp(method, "POST") == 0 && strncmp(path, "/osd/", 5) == 0) {
+        return handle_osd_text(c, path + 5, req->body);
+    }
+    else if (strcmp(method, "POST") == 0 && strncmp(path, "/stop/", 6) == 0) {
+        uint32_t viewer_id = (uint32_t)strtoul(path + 6, NULL, 10);
+        if (rtp_viewer_remove(viewer_id) != 0) {
+            const char* msg = "Unknown viewer";
+            return http_send_response(c, "404 Not Found", "text/plain", msg, strlen(msg));
+        }
+        return http_send_response(c, "200 OK", "text/plain", "OK", 2);
+    }
+    
+    const char* not_found = "Not Found";
+    return http_send_response(c, "404 Not Found", "text/plain", not_found, strlen(not_found));
+}
+
+/* Consume n written bytes from one part of the response, returning what is left over */
+static size_t http_advance(size_t* off, size_t len, size_t n)
+{
+    size_t step = len - *off < n ? len - *off : n;
+    *off += step;
+    return n - step;
+}
+
+/*
+ * Write as much of the queued response as the socket takes: head, memory
+ * body and tail with writev(), a file body with sendfile(). Returns 0
+ * when done, 1 when the socket is full, -1 on error.
+ */
+static int http_conn_flush(HttpConn* c)
+{
+    for (;;) {
+        struct iovec iov[3];
+        int count = 0;
+        if (c->head_off < c->head_len) {
+            iov[count].iov_base = c->head + c->head_off;
+            iov[count++].iov_len = c->head_len - c->head_off;
+        }
+        if (c->body_off < c->body_len) {
+            iov[count].iov_base = (void*)(c->body + c->body_off);
+            iov[count++].iov_len = c->body_len - c->body_off;
+        }
+        if (c->file_fd < 0 && c->tail_off < c->tail_len) {
+            iov[count].iov_base = (void*)(c->tail + c->tail_off);
+            iov[count++].iov_len = c->tail_len - c->tail_off;
+        }
+
+        ssize_t n;
+        if (count > 0) {
+            n = writev(c->fd, iov, count);
+        } else if (c->file_fd >= 0 && c->file_off < c->file_end) {
+            n = sendfile(c->fd, c->file_fd, &c->file_off, (size_t)(c->file_end - c->file_off));
+            if (n == 0) {
+                return -1;      // the file shrank under us
+            }
+        } else if (c->file_fd >= 0) {
+            close(c->file_fd);
+            c->file_fd = -1;
+            continue;
+        } else {
+            return 0;
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
+        }
+        c->active_ms = monotonic_ms();
+        if (count > 0) {
+            size_t left = http_advance(&c->head_off, c->head_len, (size_t)n);
+            left = http_advance(&c->body_off, c->body_len, left);
+            if (c->file_fd < 0) {
+                http_advance(&c->tail_off, c->tail_len, left);
+            }
+        }
+    }
+}
+
+static int mjpeg_send_next(HttpConn* c);
+
+/*
+ * Push the queued response. On completion a keep-alive connection goes
+ * back to reading (any pipelined request is already in in[]), an MJPEG
+ * viewer waits for its next frame, anything else is closed. Returns -1
+ * when the connection must be closed.
+ */
+static int http_conn_send(HttpConn* c)
+{
+    int ret = http_conn_flush(c);
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret > 0) {
+        http_conn_watch(c, EPOLLOUT | (c->mjpeg ? EPOLLRDHUP : 0));
+        return 0;
+    }
+
+    http_conn_clear_response(c);
+    if (c->mjpeg) {
+        c->state = HTTP_CONN_MJPEG;
+        http_conn_watch(c, EPOLLRDHUP);
+        return mjpeg_send_next(c);
+    }
+    if (!c->keep_alive) {
+        return -1;
+    }
+    memmove(c->in, c->in + c->req_len, c->in_len - c->req_len);
+    c->in_len -= c->req_len;
+    c->req_len = 0;
+    c->state = HTTP_CONN_READ;
+    return 0;
+}
+
+/*
+ * Queue the newest picture for an idle viewer. Pictures published while
+ * a slow viewer is still sending the previous one are skipped for it,
+ * so it never holds up the encoder or the other viewers.
+ */
+static int mjpeg_send_next(HttpConn* c)
+{
+    if (__atomic_load_n(&g_app.jpeg_seq, __ATOMIC_ACQUIRE) == c->mjpeg_seq) {
+        return 0;
+    }
+    JpegSlot* slot = jpeg_acquire();
+    if (!slot) {
+        return 0;
+    }
+    if (slot->seq == c->mjpeg_seq) {
+        jpeg_release(slot);
+        return 0;
+    }
+    int len = snprintf(c->head, sizeof(c->head),
+        "--" MJPEG_BOUNDARY "\r\n"
+        "Content-Type: image/jpeg\r\n"
+        "Content-Length: %zu\r\n"
+        "\r\n",
+        slot->size);
+    c->head_len = (size_t)len;
+    c->head_off = 0;
+    c->slot = slot;
+    c->body = slot->data;
+    c->body_len = slot->size;
+    c->tail = "\r\n";
+    c->tail_len = 2;
+    c->mjpeg_seq = slot->seq;
+    c->state = HTTP_CONN_WRITE;
+    return http_conn_send(c);
+}
+
+/* Value of one request header, looked up in the NUL-terminated header block */
+static const char* http_header_value(const char* headers, const char* name, char* value, size_t size)
+{
+    size_t name_len = strlen(name);
+    for (const char* line = strstr(headers, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        const char* p = line + 2;
+        if (strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+            p += name_len + 1;
+            while (*p == ' ' || *p == '\t') {
+                p++;
+            }
+            size_t n = strcspn(p, "\r\n");
+            if (n >= size) {
+                n = size - 1;
+            }
+            memcpy(value, p, n);
+            value[n] = '\0';
+            return value;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Answer the first request in in[] once it is complete: headers up to
+ * the blank line, then Content-Length bytes of body. Returns 0 while
+ * more bytes are needed, 1 once a response is queued or the connection
+ * is parked, -1 to close.
+ */
+static int http_conn_dispatch(HttpConn* c)
+{
+    c->in[c->in_len] = '\0';
+    char* header_end = strstr(c->in, "\r\n\r\n");
+    size_t header_len = header_end ? (size_t)(header_end + 4 - c->in) : c->in_len;
+    if (header_len > HTTP_HEADER_MAX || (!header_end && c->in_len >= HTTP_HEADER_MAX)) {
+        const char* msg = "Request header too large";
+        c->keep_alive = 0;
+        return http_send_response(c, "431 Request Header Fields Too Large", "text/plain", msg, strlen(msg)) == 0 ? 1 : -1;
+    }
+    if (!header_end) {
+        return 0;
+    }
+
+    // Cut the block after the last header line so lookups cannot run into the body
+    header_end[2] = '\0';
+    char value[80];
+    size_t body_len = 0;
+    if (http_header_value(c->in, "Content-Length", value, sizeof(value))) {
+        body_len = strtoul(value, NULL, 10);
+    }
+    if (body_len > HTTP_BODY_MAX) {
+        const char* msg = "Request body too large";
+        c->keep_alive = 0;
+        return http_send_response(c, "413 Payload Too Large", "text/plain", msg, strlen(msg)) == 0 ? 1 : -1;
+    }
+    if (c->in_len < header_len + body_len) {
+        header_end[2] = '\r';
+        return 0;
+    }
+
+    c->req_len = header_len + body_len;
+    char next = c->in[c->req_len];
+    c->in[c->req_len] = '\0';
+
+    int ret;
+    HttpRequest req;
+    memset(&req, 0, sizeof(req));
+    if (sscanf(c->in, "%15s %255s %15s", req.method, req.path, req.version) != 3) {
+        printf("Invalid request format\n");
+        c->keep_alive = 0;
+        ret = http_send_response(c, "400 Bad Request", "text/plain", "Bad Request\n", 12);
+    } else {
+        printf("Request: %s %s %s\n", req.method, req.path, req.version);
+        const char* connection = http_header_value(c->in, "Connection", value, sizeof(value));
+        if (strcmp(req.version, "HTTP/1.1") == 0) {
+            c->keep_alive = !connection || strcasecmp(connection, "close") != 0;
+        } else {
+            c->keep_alive = connection && strcasecmp(connection, "keep-alive") == 0;
         }
-        else if (strcmp(path, "/snapshot") == 0) {
-            pthread_mutex_lock(&g_app.jpeg_mutex);
-            int ret = -1;
-            if (g_app.latest_jpeg && g_app.latest_jpeg_size > 0) {
-                ret = http_send_response(client_fd, "200 OK", "image/jpeg", 
-                                         (const char*)g_app.latest_jpeg, g_app.latest_jpeg_size);
+        const char* encoding = http_header_value(c->in, "Accept-Encoding", value, sizeof(value));
+        req.accept_gzip = encoding && strstr(encoding, "gzip") != NULL;
+        http_header_value(c->in, "If-None-Match", req.if_none_match, sizeof(req.if_none_match));
+        req.body = body_len > 0 ? c->in + header_len : NULL;
+        ret = handle_http_request(c, &req);
+    }
+    c->in[c->req_len] = next;
+    return ret < 0 ? -1 : 1;
+}
+
+static int http_conn_process(HttpConn* c)
+{
+    while (c->state == HTTP_CONN_READ) {
+        int ret = http_conn_dispatch(c);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret == 0) {
+            http_conn_watch(c, EPOLLIN);
+            return 0;
+        }
+        if (c->state == HTTP_CONN_WRITE && http_conn_send(c) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void http_conn_close(HttpConn* c)
+{
+    http_conn_clear_response(c);
+    if (c->mjpeg) {
+        g_http.mjpeg_viewers--;
+        c->mjpeg = 0;
+        printf("MJPEG viewer left (%d viewers)\n", g_http.mjpeg_viewers);
+    }
+    // Closing the socket also drops it from the epoll set
+    close(c->fd);
+    c->fd = -1;
+    c->state = HTTP_CONN_FREE;
+    printf("Connection closed\n");
+}
+
+/* Continue a response queued outside the read path (EPOLLOUT, a published picture, a timeout) */
+static void http_conn_resume(HttpConn* c)
+{
+    if (http_conn_send(c) < 0 || (c->state == HTTP_CONN_READ && http_conn_process(c) < 0)) {
+        http_conn_close(c);
+    }
+}
+
+static int http_conn_read(HttpConn* c)
+{
+    int eof = 0;
+    while (c->in_len < sizeof(c->in) - 1) {
+        ssize_t n = read(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            eof = 1;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        return -1;
+    }
+    c->active_ms = monotonic_ms();
+    if (http_conn_process(c) < 0) {
+        return -1;
+    }
+    // A client that half-closed still gets the answers to what it sent
+    return eof && c->state == HTTP_CONN_READ ? -1 : 0;
+}
+
+static void http_conn_event(HttpConn* c, uint32_t events)
+{
+    if ((events & (EPOLLERR | EPOLLHUP)) || ((events & EPOLLRDHUP) && c->mjpeg)) {
+        http_conn_close(c);
+        return;
+    }
+    if ((events & EPOLLIN) && c->state == HTTP_CONN_READ) {
+        if (http_conn_read(c) < 0) {
+            http_conn_close(c);
+        }
+    } else if ((events & EPOLLOUT) && c->state == HTTP_CONN_WRITE) {
+        http_conn_resume(c);
+    }
+}
+
+static void http_accept(void)
+{
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_fd = accept4(g_http.listen_fd, (struct sockaddr*)&client_addr, &client_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                printf("accept failed: %d\n", errno);
+            }
+            return;
+        }
+
+        char client_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
+        printf("Received connection from %s:%d\n", client_ip, ntohs(client_addr.sin_port));
+
+        HttpConn* c = NULL;
+        for (int i = 0; i < HTTP_MAX_CONNS; i++) {
+            if (g_http.conns[i].state == HTTP_CONN_FREE) {
+                c = &g_http.conns[i];
+                break;
+            }
+        }
+        if (!c) {
+            const char* busy = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 5\r\nConnection: close\r\n\r\nBusy\n";
+            write(client_fd, busy, strlen(busy));
+            close(client_fd);
+            continue;
+        }
+
+        int opt = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        struct sockaddr_in local;
+        socklen_t local_len = sizeof(local);
+        if (getsockname(client_fd, (struct sockaddr*)&local, &local_len) != 0 ||
+            !inet_ntop(AF_INET, &local.sin_addr, c->local_ip, sizeof(c->local_ip))) {
+            snprintf(c->local_ip, sizeof(c->local_ip), "127.0.0.1");
+        }
+
+        struct epoll_event ev = {
+            .events = EPOLLIN,
+            .data.u32 = (uint32_t)(c - g_http.conns)
+        };
+        if (epoll_ctl(g_http.epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) != 0) {
+            printf("epoll_ctl(add) failed: %d\n", errno);
+            close(client_fd);
+            continue;
+        }
+        c->fd = client_fd;
+        c->state = HTTP_CONN_READ;
+        c->events = EPOLLIN;
+        c->peer = client_addr;
+        c->active_ms = monotonic_ms();
+        c->keep_alive = 0;
+        c->mjpeg = 0;
+        c->in_len = 0;
+        c->req_len = 0;
+    }
+}
+
+/* The stream thread published (or dropped) a JPEG picture */
+static void http_on_jpeg(void)
+{
+    uint64_t count;
+    read(g_app.jpeg_event_fd, &count, sizeof(count));
+
+    uint32_t seq = __atomic_load_n(&g_app.jpeg_seq, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < HTTP_MAX_CONNS; i++) {
+        HttpConn* c = &g_http.conns[i];
+        if (c->state == HTTP_CONN_SNAPSHOT) {
+            JpegSlot* slot = NULL;
+            if (seq == c->wait_seq) {
+                // Every slot was busy and the picture was dropped; ask for another
+                if (jpeg_trigger() == 0) {
+                    continue;
+                }
+            } else {
+                slot = jpeg_acquire();
+            }
+            if (slot) {
+                http_send_slot(c, slot);
             } else {
                 const char* msg = "Snapshot not ready";
-                ret = http_send_response(client_fd, "503 Service Unavailable", "text/plain", msg, strlen(msg));
+                http_send_response(c, "503 Service Unavailable", "text/plain", msg, strlen(msg));
             }
-            pthread_mutex_unlock(&g_app.jpeg_mutex);
-            return ret;
+            http_conn_resume(c);
+        } else if (c->state == HTTP_CONN_MJPEG && mjpeg_send_next(c) < 0) {
+            http_conn_close(c);
         }
     }
-    else if (strcmp(method, "POST") == 0 && strncmp(path, "/offer/", 7) == 0) {
-        printf("Received WebRTC offer request for path: %s\n", path);
-        
-        // 读取请求体
-        char body[4096] = {0};
-        int n = read(client_fd, body, sizeof(body) - 1);
-        if (n > 0) {
-            body[n] = '\0';
-            printf("Received offer body (first 200 chars): %.200s...\n", body);
-        }
-        
-        const char* sdp_answer = 
-            "v=0\r\n"
-            "o=- 0 0 IN IP4 0.0.0.0\r\n"
-            "s=Hi3516 WebRTC\r\n"
-            "t=0 0\r\n"
-            "m=video 9 RTP/AVP 96\r\n"
-            "c=IN IP4 0.0.0.0\r\n"
-            "a=rtpmap:96 H264/90000\r\n"
-            "a=fmtp:96 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f\r\n"
-            "a=control:streamid=0\r\n";
-        
-        char response[1024];
-        int sdp_len = strlen(sdp_answer);
-        int resp_len = snprintf(response, sizeof(response), 
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: application/json\r\n"
-            "Content-Length: %u\r\n"
-            "\r\n"
-            "{\"type\":\"answer\",\"sdp\":\"%s\"}",
-            sdp_len, sdp_answer);
-        
-        printf("Sending WebRTC answer, response length: %d\n", resp_len);
-        int ret = write(client_fd, response, resp_len);
-        if (ret < 0) {
-            printf("write failed: %d\n", errno);
-        } else {
-            printf("WebRTC answer sent successfully\n");
+}
+
+/* Redraw the timestamp when the second changes; only the digits that changed are copied */
+static void osd_tick(void)
+{
+    if (!__atomic_load_n(&g_app.pipeline_ready, __ATOMIC_ACQUIRE) || !g_app.osd_enabled) {
+        return;
+    }
+    time_t now = time(NULL);
+    if (now == g_app.osd_second) {
+        return;
+    }
+    g_app.osd_second = now;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char text[OSD_TIME_CELLS + 1];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+    osd_overlay_set_text(OSD_TIME, text);
+}
+
+static void http_tick(uint64_t now)
+{
+    jpeg_expire(now);
+    venc_ctrl_tick(now);
+    osd_tick();
+    if (__atomic_load_n(&g_app.pipeline_ready, __ATOMIC_ACQUIRE) && now - g_app.isp_save_ms >= ISP_STATE_SAVE_MS) {
+        g_app.isp_save_ms = now;
+        isp_state_save(ISP_STATE_PATH, g_app.vi_pipe);
+    }
+    if (g_http.mjpeg_viewers > 0 && now - g_http.mjpeg_trigger_ms >= MJPEG_INTERVAL_MS) {
+        g_http.mjpeg_trigger_ms = now;
+        jpeg_trigger();
+    }
+
+    for (int i = 0; i < HTTP_MAX_CONNS; i++) {
+        HttpConn* c = &g_http.conns[i];
+        if (c->state == HTTP_CONN_SNAPSHOT && now - c->wait_ms >= JPEG_ENCODE_TIMEOUT_MS) {
+            const char* msg = "Snapshot not ready";
+            http_send_response(c, "503 Service Unavailable", "text/plain", msg, strlen(msg));
+            http_conn_resume(c);
+        } else if ((c->state == HTTP_CONN_READ || c->state == HTTP_CONN_WRITE) &&
+                   now - c->active_ms >= HTTP_IDLE_TIMEOUT_MS) {
+            http_conn_close(c);
         }
-        return ret;
     }
-    
-    const char* not_found = "Not Found";
-    return http_send_response(client_fd, "404 Not Found", "text/plain", not_found, strlen(not_found));
 }
 
+/*
+ * Single-threaded epoll loop. Sockets are non-blocking and every
+ * connection keeps its own read and write progress, so a slow phone only
+ * delays itself; snapshot requests and MJPEG viewers wait for the JPEG
+ * channel through jpeg_event_fd instead of blocking the loop.
+ */
 static void* http_server_thread(void* arg)
 {
     (void)arg;
-    int server_fd, client_fd;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    char buffer[4096] = {0};
-    char method[16] = {0}, path[256] = {0}, version[16] = {0};
-    
+    int server_fd;
+    struct sockaddr_in server_addr;
+
     printf("HTTP server thread started\n");
-    
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (server_fd < 0) {
         printf("socket creation failed: %d\n", errno);
         return NULL;
     }
     printf("Socket created successfully\n");
-    
+
     int opt = 1;
     int ret = setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
     if (ret < 0) {
@@ -448,55 +1859,101 @@ static void* http_server_thread(void* arg)
         close(server_fd);
         return NULL;
     }
-    
+
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(8080);
-    
+    server_addr.sin_port = htons(HTTP_PORT);
+
     ret = bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
     if (ret < 0) {
         printf("bind failed: %d\n", errno);
         close(server_fd);
         return NULL;
     }
-    printf("Bound to port 8080 successfully\n");
-    
-    ret = listen(server_fd, 10);
+    printf("Bound to port %d successfully\n", HTTP_PORT);
+
+    ret = listen(server_fd, HTTP_MAX_CONNS);
     if (ret < 0) {
         printf("listen failed: %d\n", errno);
         close(server_fd);
         return NULL;
     }
-    printf("Listening for connections on port 8080\n");
-    
+
+    g_http.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (g_http.epoll_fd < 0) {
+        printf("epoll_create1 failed: %d\n", errno);
+        close(server_fd);
+        return NULL;
+    }
+    g_http.listen_fd = server_fd;
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.u32 = HTTP_EV_LISTEN
+    };
+    struct epoll_event jpeg_ev = {
+        .events = EPOLLIN,
+        .data.u32 = HTTP_EV_JPEG
+    };
+    if (epoll_ctl(g_http.epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) != 0 ||
+        epoll_ctl(g_http.epoll_fd, EPOLL_CTL_ADD, g_app.jpeg_event_fd, &jpeg_ev) != 0) {
+        printf("epoll_ctl failed: %d\n", errno);
+        close(g_http.epoll_fd);
+        close(server_fd);
+        return NULL;
+    }
+    // Viewer RTCP feedback is read here too, it only touches rtp_stream state
+    struct epoll_event rtcp_ev = {
+        .events = EPOLLIN,
+        .data.u32 = HTTP_EV_RTCP
+    };
+    if (rtp_rtcp_fd() >= 0 && epoll_ctl(g_http.epoll_fd, EPOLL_CTL_ADD, rtp_rtcp_fd(), &rtcp_ev) != 0) {
+        printf("epoll_ctl(rtcp) failed: %d\n", errno);
+    }
+    for (int i = 0; i < HTTP_MAX_CONNS; i++) {
+        g_http.conns[i].fd = -1;
+        g_http.conns[i].file_fd = -1;
+    }
+    printf("Listening for connections on port %d\n", HTTP_PORT);
+
+    struct epoll_event events[HTTP_MAX_EVENTS];
     while (1) {
-        client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
-        if (client_fd < 0) {
-            printf("accept failed: %d\n", errno);
-            continue;
+        int n = epoll_wait(g_http.epoll_fd, events, HTTP_MAX_EVENTS, HTTP_TICK_MS);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("epoll_wait failed: %d\n", errno);
+            break;
         }
-        
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-        printf("Received connection from %s:%d\n", client_ip, ntohs(client_addr.sin_port));
-        
-        int n = read(client_fd, buffer, sizeof(buffer) - 1);
-        if (n > 0) {
-            buffer[n] = '\0';
-            if (sscanf(buffer, "%s %s %s", method, path, version) == 3) {
-                printf("Request: %s %s %s\n", method, path, version);
-                handle_http_request(client_fd, path, method);
-            } else {
-                printf("Invalid request format\n");
-                const char* error = "HTTP/1.1 400 Bad Request\r\nContent-Length: 15\r\n\r\nBad Request\n";
-                write(client_fd, error, strlen(error));
+        int accept_ready = 0;
+        for (int i = 0; i < n; i++) {
+            uint32_t id = events[i].data.u32;
+            if (id == HTTP_EV_LISTEN) {
+                accept_ready = 1;
+            } else if (id == HTTP_EV_JPEG) {
+                http_on_jpeg();
+            } else if (id == HTTP_EV_RTCP) {
+                rtp_rtcp_receive();
+            } else if (g_http.conns[id].state != HTTP_CONN_FREE) {
+                http_conn_event(&g_http.conns[id], events[i].events);
             }
         }
-        
-        close(client_fd);
-        printf("Connection closed\n");
+        // Accept last so a slot freed above never picks up a stale event from this batch
+        if (accept_ready) {
+            http_accept();
+        }
+        http_tick(monotonic_ms());
     }
-    
+
+    for (int i = 0; i < HTTP_MAX_CONNS; i++) {
+        if (g_http.conns[i].state != HTTP_CONN_FREE) {
+            http_conn_close(&g_http.conns[i]);
+        }
+    }
+    http_page_put(g_http.index);
+    g_http.index = NULL;
+    close(g_http.epoll_fd);
     close(server_fd);
     return NULL;
 }
@@ -567,28 +2024,33 @@ static int init_vpss()
         return ret;
     }
     
-    chn_attr.width = MID_WIDTH;
-    chn_attr.height = MID_HEIGHT;
-    ret = ss_mpi_vpss_set_chn_attr(g_app.vpss_grp, g_app.vpss_chn_mid, &chn_attr);
-    if (ret != 0) {
-        return ret;
-    }
-    
-    ret = ss_mpi_vpss_enable_chn(g_app.vpss_grp, g_app.vpss_chn_mid);
-    if (ret != 0) {
-        return ret;
-    }
-    
-    chn_attr.width = SUB_WIDTH;
-    chn_attr.height = SUB_HEIGHT;
-    ret = ss_mpi_vpss_set_chn_attr(g_app.vpss_grp, g_app.vpss_chn_sub, &chn_attr);
-    if (ret != 0) {
-        return ret;
+    // Disabled streams get no VPSS channel (and no VB pool, see init_vb)
+    if (g_app.stream_enabled[1]) {
+        chn_attr.width = MID_WIDTH;
+        chn_attr.height = MID_HEIGHT;
+        ret = ss_mpi_vpss_set_chn_attr(g_app.vpss_grp, g_app.vpss_chn_mid, &chn_attr);
+        if (ret != 0) {
+            return ret;
+        }
+        
+        ret = ss_mpi_vpss_enable_chn(g_app.vpss_grp, g_app.vpss_chn_mid);
+        if (ret != 0) {
+            return ret;
+        }
     }
     
-    ret = ss_mpi_vpss_enable_chn(g_app.vpss_grp, g_app.vpss_chn_sub);
-    if (ret != 0) {
-        return ret;
+    if (g_app.stream_enabled[2]) {
+        chn_attr.width = SUB_WIDTH;
+        chn_attr.height = SUB_HEIGHT;
+        ret = ss_mpi_vpss_set_chn_attr(g_app.vpss_grp, g_app.vpss_chn_sub, &chn_attr);
+        if (ret != 0) {
+            return ret;
+        }
+        
+        ret = ss_mpi_vpss_enable_chn(g_app.vpss_grp, g_app.vpss_chn_sub);
+        if (ret != 0) {
+            return ret;
+        }
     }
     
     ret = ss_mpi_vpss_start_grp(g_app.vpss_grp);
@@ -599,97 +2061,18 @@ static int init_vpss()
     return 0;
 }
 
-static int init_venc()
+static int venc_create_h264(ot_venc_chn chn, uint32_t width, uint32_t height, uint32_t bitrate, uint32_t fps, uint32_t gop)
 {
-    g_app.venc_chn_main = 0;
-    g_app.venc_chn_mid = 1;
-    g_app.venc_chn_sub = 2;
-    g_app.jpeg_chn = 3;
-    
-    ot_venc_chn_attr main_attr = {
-        .venc_attr = {
-            .type = OT_PT_H264,
-            .max_pic_width = MAIN_WIDTH,
-            .max_pic_height = MAIN_HEIGHT,
-            .buf_size = MAIN_WIDTH * MAIN_HEIGHT * 2,
-            .profile = 0,
-            .is_by_frame = TD_FALSE,
-            .pic_width = MAIN_WIDTH,
-            .pic_height = MAIN_HEIGHT,
-            .h264_attr = {
-                .rcn_ref_share_buf_en = TD_FALSE,
-                .frame_buf_ratio = 0
-            }
-        },
-        .rc_attr = {
-            .rc_mode = OT_VENC_RC_MODE_H264_CBR,
-            .h264_cbr = {
-                .bit_rate = MAIN_BITRATE,
-                .src_frame_rate = MAIN_FPS,
-                .dst_frame_rate = MAIN_FPS,
-                .gop = MAIN_GOP
-            }
-        },
-        .gop_attr = {
-            .gop_mode = OT_VENC_GOP_MODE_NORMAL_P,
-            .normal_p = {
-                .ip_qp_delta = 0
-            }
-        }
-    };
-    
-    int ret = ss_mpi_venc_create_chn(g_app.venc_chn_main, &main_attr);
-    if (ret != 0) {
-        return ret;
-    }
-    
-    ot_venc_chn_attr mid_attr = {
-        .venc_attr = {
-            .type = OT_PT_H264,
-            .max_pic_width = MID_WIDTH,
-            .max_pic_height = MID_HEIGHT,
-            .buf_size = MID_WIDTH * MID_HEIGHT * 2,
-            .profile = 0,
-            .is_by_frame = TD_FALSE,
-            .pic_width = MID_WIDTH,
-            .pic_height = MID_HEIGHT,
-            .h264_attr = {
-                .rcn_ref_share_buf_en = TD_FALSE,
-                .frame_buf_ratio = 0
-            }
-        },
-        .rc_attr = {
-            .rc_mode = OT_VENC_RC_MODE_H264_CBR,
-            .h264_cbr = {
-                .bit_rate = MID_BITRATE,
-                .src_frame_rate = MID_FPS,
-                .dst_frame_rate = MID_FPS,
-                .gop = MID_GOP
-            }
-        },
-        .gop_attr = {
-            .gop_mode = OT_VENC_GOP_MODE_NORMAL_P,
-            .normal_p = {
-                .ip_qp_delta = 0
-            }
-        }
-    };
-    
-    ret = ss_mpi_venc_create_chn(g_app.venc_chn_mid, &mid_attr);
-    if (ret != 0) {
-        return ret;
-    }
-    
-    ot_venc_chn_attr sub_attr = {
+    ot_venc_chn_attr attr = {
         .venc_attr = {
             .type = OT_PT_H264,
-            .max_pic_width = SUB_WIDTH,
-            .max_pic_height = SUB_HEIGHT,
-            .buf_size = SUB_WIDTH * SUB_HEIGHT * 2,
+            .max_pic_width = width,
+            .max_pic_height = height,
+            .buf_size = width * height * 2,
             .profile = 0,
             .is_by_frame = TD_FALSE,
-            .pic_width = SUB_WIDTH,
-            .pic_height = SUB_HEIGHT,
+            .pic_width = width,
+            .pic_height = height,
             .h264_attr = {
                 .rcn_ref_share_buf_en = TD_FALSE,
                 .frame_buf_ratio = 0
@@ -698,10 +2081,10 @@ static int init_venc()
         .rc_attr = {
             .rc_mode = OT_VENC_RC_MODE_H264_CBR,
             .h264_cbr = {
-                .bit_rate = SUB_BITRATE,
-                .src_frame_rate = SUB_FPS,
-                .dst_frame_rate = SUB_FPS,
-                .gop = SUB_GOP
+                .bit_rate = bitrate,
+                .src_frame_rate = fps,
+                .dst_frame_rate = fps,
+                .gop = gop
             }
         },
         .gop_attr = {
@@ -712,11 +2095,27 @@ static int init_venc()
         }
     };
     
-    ret = ss_mpi_venc_create_chn(g_app.venc_chn_sub, &sub_attr);
-    if (ret != 0) {
-        return ret;
-    }
-    
+    // Started by venc_ctrl when viewers join
+    return ss_mpi_venc_create_chn(chn, &attr);
+}
+
+static int init_venc_main(void)
+{
+    return venc_create_h264(g_app.venc_chn_main, MAIN_WIDTH, MAIN_HEIGHT, MAIN_BITRATE, MAIN_FPS, MAIN_GOP);
+}
+
+static int init_venc_mid(void)
+{
+    return venc_create_h264(g_app.venc_chn_mid, MID_WIDTH, MID_HEIGHT, MID_BITRATE, MID_FPS, MID_GOP);
+}
+
+static int init_venc_sub(void)
+{
+    return venc_create_h264(g_app.venc_chn_sub, SUB_WIDTH, SUB_HEIGHT, SUB_BITRATE, SUB_FPS, SUB_GOP);
+}
+
+static int init_venc_jpeg(void)
+{
     ot_venc_chn_attr jpeg_attr = {
         .venc_attr = {
             .type = OT_PT_JPEG,
@@ -744,125 +2143,81 @@ static int init_venc()
             }
         },
         .gop_attr = {
-            .gop_mode = OT_VENC_GOP_MODE_NORMAL_P,
-            .normal_p = {
-                .ip_qp_delta = 0
-            }
-        }
-    };
-    
-    ret = ss_mpi_venc_create_chn(g_app.jpeg_chn, &jpeg_attr);
-    if (ret != 0) {
-        return ret;
-    }
-    
-    ot_venc_start_param start_param = {
-        .recv_pic_num = 1
+            .gop_mode = OT_VENC_GOP_MODE_NORMAL_P,
+            .normal_p = {
+                .ip_qp_delta = 0
+            }
+        }
     };
-    ret = ss_mpi_venc_start_chn(g_app.venc_chn_main, &start_param);
-    if (ret != 0) {
-        return ret;
-    }
-    
-    ret = ss_mpi_venc_start_chn(g_app.venc_chn_mid, &start_param);
-    if (ret != 0) {
-        return ret;
-    }
-    
-    ret = ss_mpi_venc_start_chn(g_app.venc_chn_sub, &start_param);
-    if (ret != 0) {
-        return ret;
-    }
     
-    return ss_mpi_venc_start_chn(g_app.jpeg_chn, &start_param);
+    // Started per picture by jpeg_trigger()
+    return ss_mpi_venc_create_chn(g_app.jpeg_chn, &jpeg_attr);
 }
 
+/* Overlays are created here and attached in attach_osd() once the encoder channels exist */
 static int init_osd()
 {
     if (!g_app.osd_enabled) {
         return 0;
     }
     
-    ot_rgn_attr time_attr = {
-        .type = OT_RGN_OVERLAY,
-        .attr = {
-            .overlay = {
-                .pixel_format = OT_PIXEL_FORMAT_ARGB_CLUT4,
-                .bg_color = 0,
-                .size = {
-                    .width = 400,
-                    .height = 30
-                },
-                .canvas_num = 1,
-                .clut = {
-                    0x000000,
-                    0xFFFFFF,
-                    0x808080,
-                    0x800000,
-                    0x008000,
-                    0x808000,
-                    0x000080,
-                    0x800080,
-                    0x008080,
-                    0xC0C0C0,
-                    0xFF0000,
-                    0x00FF00,
-                    0xFFFF00,
-                    0x0000FF,
-                    0xFF00FF,
-                    0x00FFFF
-                }
-            }
-        }
-    };
-    
-    g_app.time_rgn = 0;
-    int ret = ss_mpi_rgn_create(g_app.time_rgn, &time_attr);
+    int ret = osd_overlay_create(OSD_TIME, OSD_TIME, OSD_TIME_CELLS);
+    if (ret == 0) {
+        ret = osd_overlay_create(OSD_LABEL, OSD_LABEL, OSD_LABEL_CELLS);
+    }
+    if (ret == 0) {
+        ret = osd_overlay_create(OSD_MEASURE, OSD_MEASURE, OSD_MEASURE_CELLS);
+    }
     if (ret != 0) {
-        return ret;
+        osd_deinit();
     }
-    
-    ot_rgn_attr cam_attr = {
-        .type = OT_RGN_OVERLAY,
-        .attr = {
-            .overlay = {
-                .pixel_format = OT_PIXEL_FORMAT_ARGB_CLUT4,
-                .bg_color = 0,
-                .size = {
-                    .width = 200,
-                    .height = 30
-                },
-                .canvas_num = 1,
-                .clut = {
-                    0x000000,
-                    0xFFFFFF,
-                    0x808080,
-                    0x800000,
-                    0x008000,
-                    0x808000,
-                    0x000080,
-                    0x800080,
-                    0x008080,
-                    0xC0C0C0,
-                    0xFF0000,
-                    0x00FF00,
-                    0xFFFF00,
-                    0x0000FF,
-                    0xFF00FF,
-                    0x00FFFF
-                }
-            }
-        }
+    return ret;
+}
+
+/*
+ * Timestamp top left on every stream and the snapshot, camera label top
+ * right on the H.264 streams, measurement bottom left on every stream.
+ * A region is one canvas however many channels show it.
+ */
+static int attach_osd()
+{
+    const struct {
+        ot_venc_chn chn;
+        int enabled;
+        int32_t width;
+        int32_t height;
+    } chns[] = {
+        {g_app.venc_chn_main, g_app.stream_enabled[0], MAIN_WIDTH, MAIN_HEIGHT},
+        {g_app.venc_chn_mid, g_app.stream_enabled[1], MID_WIDTH, MID_HEIGHT},
+        {g_app.venc_chn_sub, g_app.stream_enabled[2], SUB_WIDTH, SUB_HEIGHT},
+        {g_app.jpeg_chn, 1, JPEG_WIDTH, JPEG_HEIGHT}
     };
     
-    g_app.cam_rgn = 1;
-    ret = ss_mpi_rgn_create(g_app.cam_rgn, &cam_attr);
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(chns) / sizeof(chns[0]) && ret == 0; i++) {
+        if (!chns[i].enabled) {
+            continue;
+        }
+        ot_mpp_chn chn = {
+            .mod_id = OT_ID_VENC,
+            .dev_id = 0,
+            .chn_id = chns[i].chn
+        };
+        ret = osd_overlay_attach(OSD_TIME, &chn, OSD_MARGIN, OSD_MARGIN);
+        if (ret == 0) {
+            ret = osd_overlay_attach(OSD_MEASURE, &chn, OSD_MARGIN, chns[i].height - OSD_MARGIN - OSD_CELL_H);
+        }
+        if (ret == 0 && chns[i].chn != g_app.jpeg_chn) {
+            ret = osd_overlay_attach(OSD_LABEL, &chn,
+                                     chns[i].width - OSD_MARGIN - OSD_LABEL_CELLS * OSD_CELL_W, OSD_MARGIN);
+        }
+    }
     if (ret != 0) {
-        ss_mpi_rgn_destroy(g_app.time_rgn);
-        g_app.time_rgn = 0;
         return ret;
     }
     
+    const char* label = getenv("WEBRTC_OSD_LABEL");
+    osd_overlay_set_text(OSD_LABEL, label ? label : "CAM0");
     return 0;
 }
 
@@ -876,9 +2231,20 @@ static int ss_mpi_vpss_stop_chn(ot_vpss_grp grp, ot_vpss_chn chn)
 
 static void app_deinit()
 {
+    // Keep the latest converged exposure/white balance for the next start
+    if (__atomic_load_n(&g_app.pipeline_ready, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&g_app.pipeline_ready, 0, __ATOMIC_RELEASE);
+        isp_state_save(ISP_STATE_PATH, g_app.vi_pipe);
+    }
+    if (__atomic_load_n(&g_app.stream_running, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&g_app.stream_running, 0, __ATOMIC_RELEASE);
+        pthread_join(g_app.stream_tid, NULL);
+    }
+    venc_ctrl_deinit();
+    rtp_stream_deinit();
+    
     if (g_app.osd_enabled) {
-        ss_mpi_rgn_destroy(g_app.time_rgn);
-        ss_mpi_rgn_destroy(g_app.cam_rgn);
+        osd_deinit();
     }
     
     ss_mpi_venc_stop_chn(g_app.jpeg_chn);
@@ -913,11 +2279,16 @@ static void app_deinit()
     printf("Stopping ISP...\n");
     ss_mpi_isp_exit(g_app.vi_pipe);
     
-    if (g_app.latest_jpeg) {
-        free(g_app.latest_jpeg);
+    for (int i = 0; i < JPEG_SLOT_COUNT; i++) {
+        free(g_app.jpeg_slots[i].data);
+        g_app.jpeg_slots[i].data = NULL;
     }
     
     pthread_mutex_destroy(&g_app.jpeg_mutex);
+    if (g_app.jpeg_event_fd >= 0) {
+        close(g_app.jpeg_event_fd);
+        g_app.jpeg_event_fd = -1;
+    }
     
     printf("Exiting system...\n");
     int ret = ss_mpi_sys_exit();
@@ -931,34 +2302,42 @@ static void app_deinit()
     printf("VB deinitialized\n");
 }
 
+static void vb_add_pool(ot_vb_cfg* cfg, td_u64 blk_size, td_u32 blk_cnt)
+{
+    ot_vb_pool_cfg* pool = &cfg->common_pool[cfg->max_pool_cnt++];
+    pool->blk_size = blk_size;
+    pool->blk_cnt = blk_cnt;
+    pool->remap_mode = OT_VB_REMAP_MODE_NONE;
+    pool->mmz_name[0] = '\0';
+}
+
+/*
+ * One pool per frame size that is actually produced: Bayer raw and the
+ * 4K YUV of the VI channel and main VPSS channel (which also feeds the
+ * JPEG channel) always, the mid and sub pools only when those streams
+ * are enabled. Without a pool of their own, smaller channels would take
+ * 4K blocks.
+ */
 static int init_vb()
 {
     printf("Initializing VB (Video Buffer)...\n");
     
-    // Define VB parameters for 8MP sensor
-    ot_vb_cfg vb_cfg = {
-        .max_pool_cnt = 3,
-        .common_pool = {
-            {
-                .blk_size = MAIN_WIDTH * MAIN_HEIGHT * 1.5, // YUV 420
-                .blk_cnt = 10,
-                .remap_mode = OT_VB_REMAP_MODE_NONE,
-                .mmz_name = ""
-            },
-            {
-                .blk_size = MAIN_WIDTH * MAIN_HEIGHT * 2, // Bayer 12bpp
-                .blk_cnt = 6,
-                .remap_mode = OT_VB_REMAP_MODE_NONE,
-                .mmz_name = ""
-            },
-            {
-                .blk_size = 720 * 480 * 1.5, // Small YUV
-                .blk_cnt = 3,
-                .remap_mode = OT_VB_REMAP_MODE_NONE,
-                .mmz_name = ""
-            }
-        }
-    };
+    ot_vb_cfg vb_cfg;
+    memset(&vb_cfg, 0, sizeof(vb_cfg));
+    vb_add_pool(&vb_cfg, (td_u64)MAIN_WIDTH * MAIN_HEIGHT * 2, VB_RAW_BLKS);                 // Bayer 12bpp
+    vb_add_pool(&vb_cfg, (td_u64)MAIN_WIDTH * MAIN_HEIGHT * 3 / 2, VB_VI_BLKS + VB_CHN_BLKS); // YUV 420
+    if (g_app.stream_enabled[1]) {
+        vb_add_pool(&vb_cfg, (td_u64)MID_WIDTH * MID_HEIGHT * 3 / 2, VB_CHN_BLKS);
+    }
+    if (g_app.stream_enabled[2]) {
+        vb_add_pool(&vb_cfg, (td_u64)SUB_WIDTH * SUB_HEIGHT * 3 / 2, VB_CHN_BLKS);
+    }
+    
+    td_u64 total = 0;
+    for (td_u32 i = 0; i < vb_cfg.max_pool_cnt; i++) {
+        total += vb_cfg.common_pool[i].blk_size * vb_cfg.common_pool[i].blk_cnt;
+    }
+    printf("VB: %u pools, %llu KB\n", vb_cfg.max_pool_cnt, (unsigned long long)(total / 1024));
     
     // Set VB configuration
     int ret = ss_mpi_vb_set_cfg(&vb_cfg);
@@ -978,8 +2357,6 @@ static int init_vb()
     return 0;
 }
 
-
-
 static int register_sensor_and_libs(ot_vi_pipe vi_pipe)
 {
     int ret;
@@ -1002,7 +2379,8 @@ static int register_sensor_and_libs(ot_vi_pipe vi_pipe)
         return -1;
     }
 
-    // 2. Set sensor init attributes
+    // 2. Set sensor init attributes, starting from the last converged AE/AWB state if there is one
+    isp_state_load(ISP_STATE_PATH, &init_attr);
     if (sns_obj->pfn_set_init != NULL) {
         ret = sns_obj->pfn_set_init(vi_pipe, &init_attr);
         if (ret != 0) {
@@ -1121,52 +2499,31 @@ static int bind_modules()
         return ret;
     }
 
-    // 2. VPSS -> VENC (Main)
-    printf("Binding VPSS to VENC (Main)...\n");
-    src_chn.mod_id = OT_ID_VPSS;
-    src_chn.dev_id = g_app.vpss_grp;
-    src_chn.chn_id = g_app.vpss_chn_main;
-    
-    dst_chn.mod_id = OT_ID_VENC;
-    dst_chn.dev_id = 0;
-    dst_chn.chn_id = g_app.venc_chn_main;
-    
-    ret = ss_mpi_sys_bind(&src_chn, &dst_chn);
-    if (ret != 0) {
-        printf("Bind VPSS->VENC(Main) failed: %d\n", ret);
-        return ret;
-    }
-
-    // 3. VPSS -> VENC (Mid)
-    printf("Binding VPSS to VENC (Mid)...\n");
-    src_chn.mod_id = OT_ID_VPSS;
-    src_chn.dev_id = g_app.vpss_grp;
-    src_chn.chn_id = g_app.vpss_chn_mid;
-    
-    dst_chn.mod_id = OT_ID_VENC;
-    dst_chn.dev_id = 0;
-    dst_chn.chn_id = g_app.venc_chn_mid;
-    
-    ret = ss_mpi_sys_bind(&src_chn, &dst_chn);
-    if (ret != 0) {
-        printf("Bind VPSS->VENC(Mid) failed: %d\n", ret);
-        return ret;
-    }
-
-    // 4. VPSS -> VENC (Sub)
-    printf("Binding VPSS to VENC (Sub)...\n");
-    src_chn.mod_id = OT_ID_VPSS;
-    src_chn.dev_id = g_app.vpss_grp;
-    src_chn.chn_id = g_app.vpss_chn_sub;
-    
-    dst_chn.mod_id = OT_ID_VENC;
-    dst_chn.dev_id = 0;
-    dst_chn.chn_id = g_app.venc_chn_sub;
-    
-    ret = ss_mpi_sys_bind(&src_chn, &dst_chn);
-    if (ret != 0) {
-        printf("Bind VPSS->VENC(Sub) failed: %d\n", ret);
-        return ret;
+    // 2-4. VPSS -> VENC (Main, Mid, Sub) for the enabled streams
+    const ot_vpss_chn vpss_chns[RTP_STREAM_COUNT] = {
+        g_app.vpss_chn_main, g_app.vpss_chn_mid, g_app.vpss_chn_sub
+    };
+    const ot_venc_chn venc_chns[RTP_STREAM_COUNT] = {
+        g_app.venc_chn_main, g_app.venc_chn_mid, g_app.venc_chn_sub
+    };
+    for (int i = 0; i < RTP_STREAM_COUNT; i++) {
+        if (!g_app.stream_enabled[i]) {
+            continue;
+        }
+        printf("Binding VPSS to VENC (%s)...\n", rtp_stream_name(i));
+        src_chn.mod_id = OT_ID_VPSS;
+        src_chn.dev_id = g_app.vpss_grp;
+        src_chn.chn_id = vpss_chns[i];
+        
+        dst_chn.mod_id = OT_ID_VENC;
+        dst_chn.dev_id = 0;
+        dst_chn.chn_id = venc_chns[i];
+        
+        ret = ss_mpi_sys_bind(&src_chn, &dst_chn);
+        if (ret != 0) {
+            printf("Bind VPSS->VENC(%s) failed: %d\n", rtp_stream_name(i), ret);
+            return ret;
+        }
     }
 
     // 5. VPSS -> VENC (JPEG) - Shares Main Channel (0)
@@ -1193,54 +2550,10 @@ static void print_error(const char* func, int ret)
     printf("[%s] Failed with error code: %d\n", func, ret);
 }
 
-int main()
+/* VI pipe, ISP and VI channel: the sensor path up to the VPSS input */
+static int init_vi()
 {
-    printf("Starting Hi3516CV610 WebRTC H.264 streaming server...\n");
-    
-    int ret = pthread_mutex_init(&g_app.jpeg_mutex, NULL);
-    if (ret != 0) {
-        printf("pthread_mutex_init failed: %d\n", ret);
-        return -1;
-    }
-    
-    // Initialize VB first
-    ret = init_vb();
-    if (ret != 0) {
-        printf("VB initialization failed\n");
-        goto error;
-    }
-    
-    printf("Initializing system...\n");
-    ret = ss_mpi_sys_init();
-    if (ret != 0) {
-        printf("ss_mpi_sys_init failed: %d\n", ret);
-        goto error;
-    }
-    printf("System initialized successfully\n");
-    
-    // Set VI VPSS mode
-    printf("Setting VI VPSS mode...\n");
-    ot_vi_vpss_mode vi_vpss_mode = {
-        .mode = {
-            OT_VI_OFFLINE_VPSS_OFFLINE,
-            OT_VI_OFFLINE_VPSS_OFFLINE,
-            OT_VI_OFFLINE_VPSS_OFFLINE,
-            OT_VI_OFFLINE_VPSS_OFFLINE
-        }
-    };
-    ret = ss_mpi_sys_set_vi_vpss_mode(&vi_vpss_mode);
-    if (ret != 0) {
-        printf("ss_mpi_sys_set_vi_vpss_mode failed: %d\n", ret);
-        goto error;
-    }
-    
-    // Set AIISP mode
-    ot_vi_aiisp_mode aiisp_mode = OT_VI_AIISP_MODE_DEFAULT;
-    ret = ss_mpi_sys_set_vi_aiisp_mode(0, aiisp_mode);
-    if (ret != 0) {
-        printf("ss_mpi_sys_set_vi_aiisp_mode failed: %d\n", ret);
-        goto error;
-    }
+    int ret;
     
     // Create VI pipe first without starting it
     printf("Creating VI pipe...\n");
@@ -1265,7 +2578,7 @@ int main()
     ret = ss_mpi_vi_create_pipe(g_app.vi_pipe, &pipe_attr);
     if (ret != 0) {
         printf("ss_mpi_vi_create_pipe failed: %d\n", ret);
-        goto error;
+        return ret;
     }
     printf("VI pipe created successfully\n");
     
@@ -1273,7 +2586,7 @@ int main()
     ret = init_isp();
     if (ret != 0) {
         printf("ISP initialization failed\n");
-        goto error;
+        return ret;
     }
     
     // Complete VI initialization
@@ -1300,49 +2613,216 @@ int main()
     if (ret != 0) {
         printf("ss_mpi_vi_set_chn_attr failed: %d\n", ret);
         ss_mpi_vi_destroy_pipe(g_app.vi_pipe);
-        goto error;
+        return ret;
     }
     
     ret = ss_mpi_vi_enable_chn(g_app.vi_pipe, g_app.vi_chn);
     if (ret != 0) {
         printf("ss_mpi_vi_enable_chn failed: %d\n", ret);
         ss_mpi_vi_destroy_pipe(g_app.vi_pipe);
-        goto error;
+        return ret;
     }
     
     ret = ss_mpi_vi_start_pipe(g_app.vi_pipe);
     if (ret != 0) {
         printf("ss_mpi_vi_start_pipe failed: %d\n", ret);
         ss_mpi_vi_destroy_pipe(g_app.vi_pipe);
-        goto error;
+        return ret;
     }
     printf("VI initialized successfully\n");
+    return 0;
+}
+
+/* One startup step on its own thread; ret and ms are valid after init_task_join() */
+typedef struct {
+    const char* name;
+    int (*fn)(void);
+    int enabled;
+    int started;
+    pthread_t tid;
+    int ret;
+    uint64_t ms;
+} InitTask;
+
+static void* init_task_thread(void* arg)
+{
+    InitTask* t = (InitTask*)arg;
+    uint64_t start = monotonic_ms();
+    t->ret = t->fn();
+    t->ms = monotonic_ms() - start;
+    return NULL;
+}
+
+static void init_task_start(InitTask* t)
+{
+    t->ret = 0;
+    if (!t->enabled) {
+        return;
+    }
+    if (pthread_create(&t->tid, NULL, init_task_thread, t) == 0) {
+        t->started = 1;
+        return;
+    }
+    // No thread to spare: run the step inline, startup is only slower
+    init_task_thread(t);
+}
+
+static int init_task_join(InitTask* t)
+{
+    if (t->started) {
+        pthread_join(t->tid, NULL);
+        t->started = 0;
+    }
+    if (t->enabled) {
+        printf("  %-10s %s in %llu ms\n", t->name, t->ret == 0 ? "ready" : "FAILED", (unsigned long long)t->ms);
+    }
+    return t->ret;
+}
+
+/* WEBRTC_STREAMS="main,mid,sub" selects the H.264 streams to set up; all of them by default */
+static void parse_enabled_streams(void)
+{
+    const char* env = getenv("WEBRTC_STREAMS");
+    if (!env || !*env) {
+        return;
+    }
+    char list[64];
+    snprintf(list, sizeof(list), "%s", env);
+    memset(g_app.stream_enabled, 0, sizeof(g_app.stream_enabled));
+    char* save = NULL;
+    for (char* name = strtok_r(list, ", ", &save); name; name = strtok_r(NULL, ", ", &save)) {
+        int stream = rtp_stream_index(name);
+        if (stream < 0) {
+            printf("WEBRTC_STREAMS: unknown stream '%s' ignored\n", name);
+            continue;
+        }
+        g_app.stream_enabled[stream] = 1;
+    }
+    printf("Enabled streams:%s%s%s\n", g_app.stream_enabled[0] ? " main" : "",
+           g_app.stream_enabled[1] ? " mid" : "", g_app.stream_enabled[2] ? " sub" : "");
+}
+
+int main()
+{
+    uint64_t start_ms = monotonic_ms();
+    printf("Starting Hi3516CV610 WebRTC H.264 streaming server...\n");
+    
+    int ret = pthread_mutex_init(&g_app.jpeg_mutex, NULL);
+    if (ret != 0) {
+        printf("pthread_mutex_init failed: %d\n", ret);
+        return -1;
+    }
+    g_app.jpeg_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_app.jpeg_event_fd < 0) {
+        printf("eventfd failed: %d\n", errno);
+        return -1;
+    }
+    // A viewer that disconnects mid-response must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+    parse_enabled_streams();
+    
+    // The HTTP server needs no MPP state: serve the page while the camera comes up,
+    // /snapshot and offers answer 503 until the pipeline is ready
+    ot_venc_chn rtp_chns[RTP_STREAM_COUNT] = {
+        g_app.venc_chn_main, g_app.venc_chn_mid, g_app.venc_chn_sub
+    };
+    rtp_stream_init(rtp_chns);
     
-    printf("Initializing VPSS...\n");
-    ret = init_vpss();
+    printf("Starting HTTP server thread...\n");
+    pthread_t tid;
+    ret = pthread_create(&tid, NULL, http_server_thread, NULL);
     if (ret != 0) {
-        print_error("init_vpss", ret);
+        printf("pthread_create failed: %d\n", ret);
         goto error;
     }
-    printf("VPSS initialized successfully\n");
     
-
+    // VB pools are sized from the enabled streams
+    ret = init_vb();
+    if (ret != 0) {
+        printf("VB initialization failed\n");
+        goto error;
+    }
+    
+    printf("Initializing system...\n");
+    ret = ss_mpi_sys_init();
+    if (ret != 0) {
+        printf("ss_mpi_sys_init failed: %d\n", ret);
+        goto error;
+    }
+    printf("System initialized successfully\n");
+    
+    // Set VI VPSS mode
+    printf("Setting VI VPSS mode...\n");
+    ot_vi_vpss_mode vi_vpss_mode = {
+        .mode = {
+            OT_VI_OFFLINE_VPSS_OFFLINE,
+            OT_VI_OFFLINE_VPSS_OFFLINE,
+            OT_VI_OFFLINE_VPSS_OFFLINE,
+            OT_VI_OFFLINE_VPSS_OFFLINE
+        }
+    };
+    ret = ss_mpi_sys_set_vi_vpss_mode(&vi_vpss_mode);
+    if (ret != 0) {
+        printf("ss_mpi_sys_set_vi_vpss_mode failed: %d\n", ret);
+        goto error;
+    }
     
-    printf("Initializing VENC...\n");
-    ret = init_venc();
+    // Set AIISP mode
+    ot_vi_aiisp_mode aiisp_mode = OT_VI_AIISP_MODE_DEFAULT;
+    ret = ss_mpi_sys_set_vi_aiisp_mode(0, aiisp_mode);
     if (ret != 0) {
-        print_error("init_venc", ret);
+        printf("ss_mpi_sys_set_vi_aiisp_mode failed: %d\n", ret);
         goto error;
     }
-    printf("VENC initialized successfully\n");
     
-    printf("Initializing OSD...\n");
-    ret = init_osd();
+    // Encoder channels and OSD regions only depend on the system being up:
+    // create them while the sensor path (VI, ISP, VPSS) comes up on this thread
+    InitTask tasks[] = {
+        {"venc main", init_venc_main, g_app.stream_enabled[0], 0, 0, 0, 0},
+        {"venc mid", init_venc_mid, g_app.stream_enabled[1], 0, 0, 0, 0},
+        {"venc sub", init_venc_sub, g_app.stream_enabled[2], 0, 0, 0, 0},
+        {"venc jpeg", init_venc_jpeg, 1, 0, 0, 0, 0},
+        {"osd", init_osd, g_app.osd_enabled, 0, 0, 0, 0}
+    };
+    const size_t task_count = sizeof(tasks) / sizeof(tasks[0]);
+    InitTask* osd_task = &tasks[task_count - 1];
+    for (size_t i = 0; i < task_count; i++) {
+        init_task_start(&tasks[i]);
+    }
+    
+    ret = init_vi();
+    if (ret == 0) {
+        printf("Initializing VPSS...\n");
+        ret = init_vpss();
+        if (ret != 0) {
+            print_error("init_vpss", ret);
+        } else {
+            printf("VPSS initialized successfully\n");
+        }
+    }
+    
+    // Every task must finish before anything is torn down
+    printf("Waiting for parallel init steps (sensor path took %llu ms)...\n",
+           (unsigned long long)(monotonic_ms() - start_ms));
+    int venc_ret = 0;
+    for (size_t i = 0; i < task_count; i++) {
+        int task_ret = init_task_join(&tasks[i]);
+        if (&tasks[i] != osd_task && task_ret != 0) {
+            venc_ret = task_ret;
+        }
+    }
     if (ret != 0) {
+        goto error;
+    }
+    if (venc_ret != 0) {
+        print_error("init_venc", venc_ret);
+        ret = venc_ret;
+        goto error;
+    }
+    if (g_app.osd_enabled && (osd_task->ret != 0 || attach_osd() != 0)) {
         printf("OSD init failed, continuing without OSD\n");
+        osd_deinit();
         g_app.osd_enabled = 0;
-    } else {
-        printf("OSD initialized successfully\n");
     }
     
     printf("Modules initialized successfully\n");
@@ -1355,16 +2835,32 @@ int main()
     }
     printf("Modules bound successfully\n");
     
-    printf("Starting HTTP server thread...\n");
-    pthread_t tid;
-    ret = pthread_create(&tid, NULL, http_server_thread, NULL);
+    // The main VPSS channel also feeds the JPEG channel, so it stays enabled while main is idle
+    VencStreamConfig venc_cfg[RTP_STREAM_COUNT] = {
+        {g_app.venc_chn_main, g_app.vpss_grp, g_app.vpss_chn_main, 1, g_app.stream_enabled[0],
+         MAIN_BITRATE, MAIN_MIN_BITRATE, MAIN_FPS, MAIN_GOP},
+        {g_app.venc_chn_mid, g_app.vpss_grp, g_app.vpss_chn_mid, 0, g_app.stream_enabled[1],
+         MID_BITRATE, MID_MIN_BITRATE, MID_FPS, MID_GOP},
+        {g_app.venc_chn_sub, g_app.vpss_grp, g_app.vpss_chn_sub, 0, g_app.stream_enabled[2],
+         SUB_BITRATE, SUB_MIN_BITRATE, SUB_FPS, SUB_GOP}
+    };
+    venc_ctrl_init(venc_cfg);
+    
+    __atomic_store_n(&g_app.stream_running, 1, __ATOMIC_RELEASE);
+    ret = pthread_create(&g_app.stream_tid, NULL, venc_stream_thread, NULL);
     if (ret != 0) {
-        printf("pthread_create failed: %d\n", ret);
+        printf("pthread_create(stream) failed: %d\n", ret);
+        g_app.stream_running = 0;
         goto error;
     }
     
+    g_app.isp_save_ms = monotonic_ms();
+    __atomic_store_n(&g_app.pipeline_ready, 1, __ATOMIC_RELEASE);
+    printf("Pipeline ready %llu ms after start\n", (unsigned long long)(monotonic_ms() - start_ms));
+    
     printf("Hi3516CV610 WebRTC H.264 streaming server started on port 8080\n");
     printf("Please access http://<device-ip>:8080 in your browser\n");
+    printf("MJPEG stream: http://<device-ip>:8080/mjpeg\n");
     
     while (1) {
         sleep(1);
@@ -1375,4 +2871,4 @@ error:
     app_deinit();
     printf("Server stopped with error\n");
     return -1;
-}
\ No newline at end of file
+}
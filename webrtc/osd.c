@@ -0,0 +1,339 @@
+#define _GNU_SOURCE
+#include "osd.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ss_mpi_region.h"
+
+#define OSD_CANVAS_NUM 2            // the hardware reads one canvas while the other is drawn
+#define OSD_GLYPH_FIRST ' '
+#define OSD_GLYPH_LAST 'Z'
+#define OSD_GLYPH_COUNT (OSD_GLYPH_LAST - OSD_GLYPH_FIRST + 1)
+#define OSD_GLYPH_SCALE 3
+#define OSD_GLYPH_X 1               // room for the outline left of the glyph
+#define OSD_GLYPH_Y ((OSD_CELL_H - 7 * OSD_GLYPH_SCALE) / 2)
+#define OSD_CELL_BYTES (OSD_CELL_W / 2)
+#define OSD_DRAWN_UNKNOWN 0xFF
+
+// CLUT indexes
+#define OSD_COLOR_CLEAR 0
+#define OSD_COLOR_TEXT 1
+#define OSD_COLOR_OUTLINE 2
+
+/* Classic 5x7 font, one byte per column, bit 0 is the top row */
+static const uint8_t g_font5x7[OSD_GLYPH_COUNT][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x00, 0x00, 0x5F, 0x00, 0x00}, // '!'
+    {0x00, 0x07, 0x00, 0x07, 0x00}, // '"'
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, // '#'
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, // '$'
+    {0x23, 0x13, 0x08, 0x64, 0x62}, // '%'
+    {0x36, 0x49, 0x55, 0x22, 0x50}, // '&'
+    {0x00, 0x05, 0x03, 0x00, 0x00}, // '''
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, // '('
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, // ')'
+    {0x14, 0x08, 0x3E, 0x08, 0x14}, // '*'
+    {0x08, 0x08, 0x3E, 0x08, 0x08}, // '+'
+    {0x00, 0x50, 0x30, 0x00, 0x00}, // ','
+    {0x08, 0x08, 0x08, 0x08, 0x08}, // '-'
+    {0x00, 0x60, 0x60, 0x00, 0x00}, // '.'
+    {0x20, 0x10, 0x08, 0x04, 0x02}, // '/'
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, // '0'
+    {0x00, 0x42, 0x7F, 0x40, 0x00}, // '1'
+    {0x42, 0x61, 0x51, 0x49, 0x46}, // '2'
+    {0x21, 0x41, 0x45, 0x4B, 0x31}, // '3'
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, // '4'
+    {0x27, 0x45, 0x45, 0x45, 0x39}, // '5'
+    {0x3C, 0x4A, 0x49, 0x49, 0x30}, // '6'
+    {0x01, 0x71, 0x09, 0x05, 0x03}, // '7'
+    {0x36, 0x49, 0x49, 0x49, 0x36}, // '8'
+    {0x06, 0x49, 0x49, 0x29, 0x1E}, // '9'
+    {0x00, 0x36, 0x36, 0x00, 0x00}, // ':'
+    {0x00, 0x56, 0x36, 0x00, 0x00}, // ';'
+    {0x08, 0x14, 0x22, 0x41, 0x00}, // '<'
+    {0x14, 0x14, 0x14, 0x14, 0x14}, // '='
+    {0x00, 0x41, 0x22, 0x14, 0x08}, // '>'
+    {0x02, 0x01, 0x51, 0x09, 0x06}, // '?'
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, // '@'
+    {0x7E, 0x11, 0x11, 0x11, 0x7E}, // 'A'
+    {0x7F, 0x49, 0x49, 0x49, 0x36}, // 'B'
+    {0x3E, 0x41, 0x41, 0x41, 0x22}, // 'C'
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, // 'D'
+    {0x7F, 0x49, 0x49, 0x49, 0x41}, // 'E'
+    {0x7F, 0x09, 0x09, 0x01, 0x01}, // 'F'
+    {0x3E, 0x41, 0x41, 0x51, 0x32}, // 'G'
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, // 'H'
+    {0x00, 0x41, 0x7F, 0x41, 0x00}, // 'I'
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, // 'J'
+    {0x7F, 0x08, 0x14, 0x22, 0x41}, // 'K'
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, // 'L'
+    {0x7F, 0x02, 0x04, 0x02, 0x7F}, // 'M'
+    {0x7F, 0x04, 0x08, 0x10, 0x7F}, // 'N'
+    {0x3E, 0x41, 0x41, 0x41, 0x3E}, // 'O'
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, // 'P'
+    {0x3E, 0x41, 0x51, 0x21, 0x5E}, // 'Q'
+    {0x7F, 0x09, 0x19, 0x29, 0x46}, // 'R'
+    {0x46, 0x49, 0x49, 0x49, 0x31}, // 'S'
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, // 'T'
+    {0x3F, 0x40, 0x40, 0x40, 0x3F}, // 'U'
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, // 'V'
+    {0x7F, 0x20, 0x18, 0x20, 0x7F}, // 'W'
+    {0x63, 0x14, 0x08, 0x14, 0x63}, // 'X'
+    {0x03, 0x04, 0x78, 0x04, 0x03}, // 'Y'
+    {0x61, 0x51, 0x49, 0x45, 0x43}  // 'Z'
+};
+
+typedef struct {
+    int used;
+    ot_rgn_handle handle;
+    uint32_t cells;
+    uint8_t glyphs[OSD_MAX_CELLS];  // what the overlay should show
+    int shown;                      // glyphs has been drawn into the displayed canvas
+    ot_mpp_chn chns[OSD_MAX_ATTACH];
+    int chn_count;
+    // What each canvas holds, told apart by physical address
+    td_phys_addr_t canvas_phys[OSD_CANVAS_NUM];
+    uint8_t drawn[OSD_CANVAS_NUM][OSD_MAX_CELLS];
+    int canvas_next;
+} OsdOverlay;
+
+// Cell bitmaps in canvas layout: CLUT4, left pixel in the low nibble
+static uint8_t g_atlas[OSD_GLYPH_COUNT][OSD_CELL_H][OSD_CELL_BYTES];
+
+static struct {
+    pthread_mutex_t lock;
+    int atlas_ready;
+    OsdOverlay overlays[OSD_MAX_OVERLAYS];
+} g_osd = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void osd_render_glyph(int glyph)
+{
+    uint8_t px[OSD_CELL_H][OSD_CELL_W];
+    memset(px, OSD_COLOR_CLEAR, sizeof(px));
+    for (int col = 0; col < 5; col++) {
+        for (int row = 0; row < 7; row++) {
+            if (!(g_font5x7[glyph][col] & (1 << row))) {
+                continue;
+            }
+            for (int dy = 0; dy < OSD_GLYPH_SCALE; dy++) {
+                for (int dx = 0; dx < OSD_GLYPH_SCALE; dx++) {
+                    px[OSD_GLYPH_Y + row * OSD_GLYPH_SCALE + dy][OSD_GLYPH_X + col * OSD_GLYPH_SCALE + dx] = OSD_COLOR_TEXT;
+                }
+            }
+        }
+    }
+
+    // A one pixel outline keeps the text readable on bright scenes
+    for (int y = 0; y < OSD_CELL_H; y++) {
+        for (int x = 0; x < OSD_CELL_W; x++) {
+            if (px[y][x] != OSD_COLOR_CLEAR) {
+                continue;
+            }
+            for (int ny = y - 1; ny <= y + 1; ny++) {
+                for (int nx = x - 1; nx <= x + 1; nx++) {
+                    if (ny >= 0 && ny < OSD_CELL_H && nx >= 0 && nx < OSD_CELL_W && px[ny][nx] == OSD_COLOR_TEXT) {
+                        px[y][x] = OSD_COLOR_OUTLINE;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < OSD_CELL_H; y++) {
+        for (int b = 0; b < OSD_CELL_BYTES; b++) {
+            g_atlas[glyph][y][b] = (uint8_t)(px[y][b * 2] | (px[y][b * 2 + 1] << 4));
+        }
+    }
+}
+
+static uint8_t osd_glyph_index(char ch)
+{
+    if (ch >= 'a' && ch <= 'z') {
+        ch = (char)(ch - 'a' + 'A');
+    }
+    if (ch < OSD_GLYPH_FIRST || ch > OSD_GLYPH_LAST) {
+        ch = '?';
+    }
+    return (uint8_t)(ch - OSD_GLYPH_FIRST);
+}
+
+/* Copy the cells that differ from what the back canvas holds, then show it */
+static int osd_draw(OsdOverlay* o)
+{
+    ot_rgn_canvas_info info;
+    int ret = ss_mpi_rgn_get_canvas_info(o->handle, &info);
+    if (ret != 0) {
+        printf("ss_mpi_rgn_get_canvas_info(%d) failed: %#x\n", o->handle, ret);
+        return -1;
+    }
+
+    uint8_t* base = (uint8_t*)(uintptr_t)info.virt_addr;
+    int slot = -1;
+    for (int i = 0; i < OSD_CANVAS_NUM; i++) {
+        if (o->canvas_phys[i] == info.phys_addr) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        slot = o->canvas_next;
+        o->canvas_next = (o->canvas_next + 1) % OSD_CANVAS_NUM;
+        o->canvas_phys[slot] = info.phys_addr;
+        o->drawn[slot][0] = OSD_DRAWN_UNKNOWN;
+    }
+    if (o->drawn[slot][0] == OSD_DRAWN_UNKNOWN) {
+        // First time this canvas comes round, or a failed update: its content is undefined
+        memset(base, 0, (size_t)info.stride * info.size.height);
+        memset(o->drawn[slot], OSD_DRAWN_UNKNOWN, sizeof(o->drawn[slot]));
+    }
+
+    for (uint32_t i = 0; i < o->cells; i++) {
+        uint8_t glyph = o->glyphs[i];
+        if (o->drawn[slot][i] == glyph) {
+            continue;
+        }
+        uint8_t* dst = base + i * OSD_CELL_BYTES;
+        for (int y = 0; y < OSD_CELL_H; y++) {
+            memcpy(dst + (size_t)y * info.stride, g_atlas[glyph][y], OSD_CELL_BYTES);
+        }
+        o->drawn[slot][i] = glyph;
+    }
+
+    ret = ss_mpi_rgn_update_canvas(o->handle);
+    if (ret != 0) {
+        printf("ss_mpi_rgn_update_canvas(%d) failed: %#x\n", o->handle, ret);
+        // Whatever the canvas holds now, it is redrawn in full next time
+        o->drawn[slot][0] = OSD_DRAWN_UNKNOWN;
+        return -1;
+    }
+    return 0;
+}
+
+int osd_overlay_create(int id, ot_rgn_handle handle, uint32_t cells)
+{
+    if (id < 0 || id >= OSD_MAX_OVERLAYS || cells == 0 || cells > OSD_MAX_CELLS) {
+        return -1;
+    }
+
+    ot_rgn_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = OT_RGN_OVERLAY;
+    attr.attr.overlay.pixel_format = OT_PIXEL_FORMAT_ARGB_CLUT4;
+    attr.attr.overlay.bg_color = OSD_COLOR_CLEAR;
+    attr.attr.overlay.size.width = cells * OSD_CELL_W;
+    attr.attr.overlay.size.height = OSD_CELL_H;
+    attr.attr.overlay.canvas_num = OSD_CANVAS_NUM;
+    attr.attr.overlay.clut[OSD_COLOR_CLEAR] = 0x00000000;
+    attr.attr.overlay.clut[OSD_COLOR_TEXT] = 0xFFFFFFFF;
+    attr.attr.overlay.clut[OSD_COLOR_OUTLINE] = 0xFF000000;
+
+    pthread_mutex_lock(&g_osd.lock);
+    if (!g_osd.atlas_ready) {
+        for (int g = 0; g < OSD_GLYPH_COUNT; g++) {
+            osd_render_glyph(g);
+        }
+        g_osd.atlas_ready = 1;
+    }
+    OsdOverlay* o = &g_osd.overlays[id];
+    if (o->used) {
+        pthread_mutex_unlock(&g_osd.lock);
+        return -1;
+    }
+    int ret = ss_mpi_rgn_create(handle, &attr);
+    if (ret != 0) {
+        printf("ss_mpi_rgn_create(%d) failed: %#x\n", handle, ret);
+        pthread_mutex_unlock(&g_osd.lock);
+        return -1;
+    }
+    memset(o, 0, sizeof(*o));
+    o->used = 1;
+    o->handle = handle;
+    o->cells = cells;
+    memset(o->glyphs, osd_glyph_index(' '), sizeof(o->glyphs));
+    for (int i = 0; i < OSD_CANVAS_NUM; i++) {
+        o->drawn[i][0] = OSD_DRAWN_UNKNOWN;
+    }
+    pthread_mutex_unlock(&g_osd.lock);
+    return 0;
+}
+
+int osd_overlay_attach(int id, const ot_mpp_chn* chn, int32_t x, int32_t y)
+{
+    if (id < 0 || id >= OSD_MAX_OVERLAYS) {
+        return -1;
+    }
+    ot_rgn_chn_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.is_show = TD_TRUE;
+    attr.type = OT_RGN_OVERLAY;
+    attr.attr.overlay_chn.point.x = x;
+    attr.attr.overlay_chn.point.y = y;
+    attr.attr.overlay_chn.fg_alpha = 255;
+    attr.attr.overlay_chn.bg_alpha = 0;
+    attr.attr.overlay_chn.layer = (td_u32)id;
+
+    pthread_mutex_lock(&g_osd.lock);
+    OsdOverlay* o = &g_osd.overlays[id];
+    int ret = -1;
+    if (o->used && o->chn_count < OSD_MAX_ATTACH) {
+        ret = ss_mpi_rgn_attach_to_chn(o->handle, chn, &attr);
+        if (ret != 0) {
+            printf("ss_mpi_rgn_attach_to_chn(%d -> %d:%d) failed: %#x\n", o->handle, chn->mod_id, chn->chn_id, ret);
+            ret = -1;
+        } else {
+            o->chns[o->chn_count++] = *chn;
+        }
+    }
+    pthread_mutex_unlock(&g_osd.lock);
+    return ret;
+}
+
+int osd_overlay_set_text(int id, const char* text)
+{
+    if (id < 0 || id >= OSD_MAX_OVERLAYS) {
+        return -1;
+    }
+    pthread_mutex_lock(&g_osd.lock);
+    OsdOverlay* o = &g_osd.overlays[id];
+    if (!o->used) {
+        pthread_mutex_unlock(&g_osd.lock);
+        return -1;
+    }
+
+    int changed = !o->shown;
+    const char* p = text;
+    for (uint32_t i = 0; i < o->cells; i++) {
+        uint8_t glyph = osd_glyph_index(*p ? *p++ : ' ');
+        if (o->glyphs[i] != glyph) {
+            o->glyphs[i] = glyph;
+            changed = 1;
+        }
+    }
+    int ret = 0;
+    if (changed) {
+        ret = osd_draw(o);
+        o->shown = ret == 0;
+    }
+    pthread_mutex_unlock(&g_osd.lock);
+    return ret;
+}
+
+void osd_deinit(void)
+{
+    pthread_mutex_lock(&g_osd.lock);
+    for (int id = 0; id < OSD_MAX_OVERLAYS; id++) {
+        OsdOverlay* o = &g_osd.overlays[id];
+        if (!o->used) {
+            continue;
+        }
+        for (int i = 0; i < o->chn_count; i++) {
+            ss_mpi_rgn_detach_from_chn(o->handle, &o->chns[i]);
+        }
+        ss_mpi_rgn_destroy(o->handle);
+        o->used = 0;
+    }
+    pthread_mutex_unlock(&g_osd.lock);
+}
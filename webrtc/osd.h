@@ -0,0 +1,50 @@
+/*
+ * Text overlays drawn into hardware regions from a prerendered glyph atlas.
+ *
+ * Each overlay is one ARGB_CLUT4 region holding a single line of
+ * fixed-width character cells. The region is attached to any number of
+ * encoder channels, so one canvas update shows up on all of them; the
+ * VENC hardware does the blending.
+ *
+ * Glyphs (space to 'Z', lower case folded to upper case) are rendered
+ * once into an atlas of ready-made cell bitmaps, white with a black
+ * outline. A text change only copies the cells whose character changed
+ * into the canvas. Regions are double buffered, so the characters last
+ * drawn are tracked per canvas. Nothing is allocated after
+ * osd_overlay_create().
+ *
+ * All functions are thread-safe.
+ */
+
+#ifndef OSD_H
+#define OSD_H
+
+#include <stdint.h>
+
+#include "ot_common_region.h"
+
+#define OSD_MAX_OVERLAYS 4
+#define OSD_MAX_CELLS 32            // characters per overlay
+#define OSD_MAX_ATTACH 4            // channels per overlay
+#define OSD_CELL_W 18               // 5x7 glyph scaled x3 plus one scaled column of spacing
+#define OSD_CELL_H 30
+
+/*
+ * Create overlay id as region handle, cells characters wide (the region
+ * is cells * OSD_CELL_W x OSD_CELL_H pixels). Renders the atlas on first use.
+ */
+int osd_overlay_create(int id, ot_rgn_handle handle, uint32_t cells);
+
+/* Show overlay id on chn with its top left corner at x, y (even values) */
+int osd_overlay_attach(int id, const ot_mpp_chn* chn, int32_t x, int32_t y);
+
+/*
+ * Set the text of overlay id and redraw the changed cells. Text longer
+ * than the overlay is cut, shorter text leaves the remaining cells blank.
+ */
+int osd_overlay_set_text(int id, const char* text);
+
+/* Detach and destroy every overlay */
+void osd_deinit(void);
+
+#endif // OSD_H
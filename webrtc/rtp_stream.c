@@ -0,0 +1,879 @@
+#define _GNU_SOURCE
+#include "rtp_stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "ss_mpi_venc.h"
+
+#define RTP_HEADER_SIZE 12
+#define RTP_FU_HEADER_SIZE 2
+#define RTP_NAL_FU_A 28
+#define RTP_SEND_BATCH 64
+#define RTP_MAX_NALS 32             // NAL units per frame (SPS, PPS, SEI, slices)
+#define RTP_SOCKET_SNDBUF (1024 * 1024)
+#define RTP_IDR_REQUEST_MS 500      // at most one IDR request per stream in this interval
+#define RTP_SPS_PPS_MAX 64
+
+// RTCP feedback and per-viewer rate estimation
+#define RTCP_PT_SR 200
+#define RTCP_PT_RR 201
+#define RTCP_PT_RTPFB 205
+#define RTCP_PT_PSFB 206
+#define RTCP_FMT_PLI 1
+#define RTCP_FMT_FIR 4
+#define RTCP_FMT_AFB 15             // application layer feedback, carries REMB
+#define RTCP_MAX_PACKET 1500
+#define RTP_FEEDBACK_STALE_MS 5000  // REMB older than this no longer caps the estimate
+#define RTP_VIEWER_TIMEOUT_MS 30000 // no RTCP for this long: the receiver is gone (RFC 3550 6.3.5)
+#define RTP_LOSS_HIGH_Q8 26         // ~10%: back off
+#define RTP_LOSS_LOW_Q8 5           // ~2%: probe upwards
+#define RTP_RATE_INCREASE_PCT 8     // per evaluation while the link is clean
+#define RTP_DROP_DECREASE_PCT 85    // local send queue overflowed
+#define RTP_SWITCH_DOWN_EVALS 3     // evaluations below a stream's floor before moving down
+#define RTP_SWITCH_UP_EVALS 10      // clean evaluations at the stream's ceiling before moving up
+
+#define H264_NAL_IDR 5
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+
+/* One RTP packet: header fields plus a slice of the (uncopied) NAL unit */
+typedef struct {
+    const uint8_t* payload;
+    size_t len;
+    uint8_t fu[RTP_FU_HEADER_SIZE];
+    uint8_t fu_len;                 // 0 for a single NAL unit packet, 2 for FU-A
+    uint8_t marker;                 // last packet of the access unit
+} RtpPacket;
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+} RtpNal;
+
+typedef struct {
+    int used;
+    uint32_t id;
+    int stream;
+    int fd;
+    struct sockaddr_in dst;
+    uint16_t seq;
+    uint32_t ssrc;
+    uint32_t ts_offset;
+    int live;                       // 0 while waiting for an IDR after joining, dropping or switching
+    int ceiling;                    // stream the viewer asked for; it never moves above it
+    uint64_t packets;
+    uint64_t drops;
+    uint64_t eval_drops;            // drops at the previous evaluation
+    uint32_t est_bps;               // bitrate this viewer is believed to sustain
+    uint32_t loss_q8;               // smoothed fraction lost from receiver reports
+    uint32_t remb_bps;
+    uint64_t remb_ms;
+    uint64_t active_ms;             // viewer added or last RTCP packet about it
+    int low_evals;
+    int high_evals;
+} RtpViewer;
+
+typedef struct {
+    ot_venc_chn chn;
+    uint8_t* key_data;              // last IDR access unit, Annex B with 4 byte start codes
+    size_t key_len;
+    size_t key_cap;
+    uint64_t key_pts;
+    uint8_t sps[RTP_SPS_PPS_MAX];
+    size_t sps_len;
+    uint8_t pps[RTP_SPS_PPS_MAX];
+    size_t pps_len;
+    uint64_t idr_request_ms;
+    uint32_t min_bps;
+    uint32_t max_bps;
+    uint32_t rate_bps;              // what the encoder currently produces
+} RtpStreamState;
+
+static struct {
+    pthread_mutex_t lock;
+    int initialized;
+    uint32_t next_id;
+    int rtcp_fd;
+    uint16_t rtcp_port;
+    RtpViewer viewers[RTP_MAX_VIEWERS];
+    RtpStreamState streams[RTP_STREAM_COUNT];
+    // Packet list of the frame being sent, shared by all its viewers
+    RtpPacket* packets;
+    size_t packet_count;
+    size_t packet_cap;
+    // sendmmsg batch, filled per viewer
+    uint8_t headers[RTP_SEND_BATCH][RTP_HEADER_SIZE + RTP_FU_HEADER_SIZE];
+    struct iovec iovs[RTP_SEND_BATCH][2];
+    struct mmsghdr msgs[RTP_SEND_BATCH];
+} g_rtp = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .rtcp_fd = -1
+};
+
+static const char* const g_stream_names[RTP_STREAM_COUNT] = {"main", "mid", "sub"};
+
+static uint64_t rtp_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t rtp_random32(void)
+{
+    static uint32_t state;
+    if (state == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        state = (uint32_t)ts.tv_nsec ^ ((uint32_t)ts.tv_sec << 16) ^ (uint32_t)getpid();
+        if (state == 0) {
+            state = 1;
+        }
+    }
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/*
+ * Split an Annex B buffer into NAL units (start codes removed). Zero
+ * bytes before a 4 byte start code are trimmed from the preceding NAL,
+ * which cannot legally end in 0x00.
+ */
+static size_t rtp_split_nals(const uint8_t* data, size_t len, RtpNal* nals, size_t max_nals, size_t count)
+{
+    size_t i = 0;
+    const uint8_t* start = NULL;
+    while (i + 3 <= len) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (start && count < max_nals) {
+                const uint8_t* end = data + i;
+                while (end > start && end[-1] == 0) {
+                    end--;
+                }
+                if (end > start) {
+                    nals[count].data = start;
+                    nals[count].len = (size_t)(end - start);
+                    count++;
+                }
+            }
+            i += 3;
+            start = data + i;
+            continue;
+        }
+        i++;
+    }
+    if (start && start < data + len && count < max_nals) {
+        nals[count].data = start;
+        nals[count].len = (size_t)(data + len - start);
+        count++;
+    }
+    return count;
+}
+
+static int rtp_reserve_packets(size_t count)
+{
+    if (count <= g_rtp.packet_cap) {
+        return 0;
+    }
+    size_t cap = g_rtp.packet_cap ? g_rtp.packet_cap : 256;
+    while (cap < count) {
+        cap *= 2;
+    }
+    RtpPacket* packets = realloc(g_rtp.packets, cap * sizeof(RtpPacket));
+    if (!packets) {
+        return -1;
+    }
+    g_rtp.packets = packets;
+    g_rtp.packet_cap = cap;
+    return 0;
+}
+
+/* Build the packet list of one access unit: single NAL unit packets or FU-A fragments */
+static int rtp_packetize(const RtpNal* nals, size_t nal_count)
+{
+    g_rtp.packet_count = 0;
+    for (size_t n = 0; n < nal_count; n++) {
+        const uint8_t* nal = nals[n].data;
+        size_t len = nals[n].len;
+        size_t needed = len <= RTP_MAX_PAYLOAD ? 1 : (len - 1 + RTP_MAX_PAYLOAD - 1) / RTP_MAX_PAYLOAD;
+        if (rtp_reserve_packets(g_rtp.packet_count + needed) != 0) {
+            return -1;
+        }
+
+        if (len <= RTP_MAX_PAYLOAD) {
+            RtpPacket* p = &g_rtp.packets[g_rtp.packet_count++];
+            p->payload = nal;
+            p->len = len;
+            p->fu_len = 0;
+            p->marker = 0;
+            continue;
+        }
+
+        // FU-A: the NAL header is replaced by the FU indicator and FU header
+        uint8_t indicator = (nal[0] & 0xE0) | RTP_NAL_FU_A;
+        uint8_t type = nal[0] & 0x1F;
+        size_t offset = 1;
+        while (offset < len) {
+            size_t chunk = len - offset < RTP_MAX_PAYLOAD ? len - offset : RTP_MAX_PAYLOAD;
+            RtpPacket* p = &g_rtp.packets[g_rtp.packet_count++];
+            p->payload = nal + offset;
+            p->len = chunk;
+            p->fu[0] = indicator;
+            p->fu[1] = type | (offset == 1 ? 0x80 : 0) | (offset + chunk == len ? 0x40 : 0);
+            p->fu_len = RTP_FU_HEADER_SIZE;
+            p->marker = 0;
+            offset += chunk;
+        }
+    }
+    if (g_rtp.packet_count > 0) {
+        g_rtp.packets[g_rtp.packet_count - 1].marker = 1;
+    }
+    return 0;
+}
+
+static void rtp_close_viewer(RtpViewer* v, const char* reason)
+{
+    printf("RTP viewer %u (%s -> %s:%d) removed: %s, %llu packets, %llu dropped\n",
+           v->id, g_stream_names[v->stream], inet_ntoa(v->dst.sin_addr), ntohs(v->dst.sin_port),
+           reason, (unsigned long long)v->packets, (unsigned long long)v->drops);
+    close(v->fd);
+    memset(v, 0, sizeof(*v));
+    v->fd = -1;
+}
+
+static void rtp_request_idr(int stream)
+{
+    RtpStreamState* s = &g_rtp.streams[stream];
+    uint64_t now = rtp_now_ms();
+    if (now - s->idr_request_ms < RTP_IDR_REQUEST_MS) {
+        return;
+    }
+    s->idr_request_ms = now;
+    ss_mpi_venc_request_idr(s->chn, TD_TRUE);
+}
+
+/*
+ * Send the current packet list to one viewer. A full socket queue drops
+ * the rest of the frame; the viewer then waits for the next IDR.
+ */
+static void rtp_send_viewer(RtpViewer* v, uint32_t timestamp)
+{
+    uint32_t ts = timestamp + v->ts_offset;
+    size_t sent = 0;
+    while (sent < g_rtp.packet_count) {
+        size_t batch = g_rtp.packet_count - sent;
+        if (batch > RTP_SEND_BATCH) {
+            batch = RTP_SEND_BATCH;
+        }
+        for (size_t i = 0; i < batch; i++) {
+            const RtpPacket* p = &g_rtp.packets[sent + i];
+            uint8_t* h = g_rtp.headers[i];
+            uint16_t seq = (uint16_t)(v->seq + i);
+            h[0] = 0x80;
+            h[1] = (uint8_t)((p->marker ? 0x80 : 0) | RTP_PAYLOAD_TYPE);
+            h[2] = (uint8_t)(seq >> 8);
+            h[3] = (uint8_t)seq;
+            h[4] = (uint8_t)(ts >> 24);
+            h[5] = (uint8_t)(ts >> 16);
+            h[6] = (uint8_t)(ts >> 8);
+            h[7] = (uint8_t)ts;
+            h[8] = (uint8_t)(v->ssrc >> 24);
+            h[9] = (uint8_t)(v->ssrc >> 16);
+            h[10] = (uint8_t)(v->ssrc >> 8);
+            h[11] = (uint8_t)v->ssrc;
+            memcpy(h + RTP_HEADER_SIZE, p->fu, p->fu_len);
+
+            g_rtp.iovs[i][0].iov_base = h;
+            g_rtp.iovs[i][0].iov_len = RTP_HEADER_SIZE + p->fu_len;
+            g_rtp.iovs[i][1].iov_base = (void*)p->payload;
+            g_rtp.iovs[i][1].iov_len = p->len;
+            memset(&g_rtp.msgs[i], 0, sizeof(g_rtp.msgs[i]));
+            g_rtp.msgs[i].msg_hdr.msg_iov = g_rtp.iovs[i];
+            g_rtp.msgs[i].msg_hdr.msg_iovlen = 2;
+        }
+
+        int n = sendmmsg(v->fd, g_rtp.msgs, (unsigned int)batch, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ECONNREFUSED) {
+                // ICMP port unreachable: the receiver has gone away
+                rtp_close_viewer(v, "receiver unreachable");
+                return;
+            }
+            n = 0;
+        }
+        v->seq = (uint16_t)(v->seq + n);
+        v->packets += (uint64_t)n;
+        sent += (size_t)n;
+        if ((size_t)n < batch) {
+            v->drops += g_rtp.packet_count - sent;
+            v->live = 0;
+            rtp_request_idr(v->stream);
+            return;
+        }
+    }
+}
+
+static uint32_t rtp_timestamp(uint64_t pts_us)
+{
+    return (uint32_t)(pts_us * 9 / 100);
+}
+
+/* Cache an IDR access unit and its parameter sets for new viewers */
+static void rtp_cache_keyframe(RtpStreamState* s, const RtpNal* nals, size_t nal_count, uint64_t pts)
+{
+    size_t size = 0;
+    for (size_t n = 0; n < nal_count; n++) {
+        size += 4 + nals[n].len;
+    }
+    if (size > s->key_cap) {
+        uint8_t* data = realloc(s->key_data, size);
+        if (!data) {
+            s->key_len = 0;
+            return;
+        }
+        s->key_data = data;
+        s->key_cap = size;
+    }
+    s->key_len = 0;
+    for (size_t n = 0; n < nal_count; n++) {
+        static const uint8_t start_code[4] = {0, 0, 0, 1};
+        memcpy(s->key_data + s->key_len, start_code, 4);
+        memcpy(s->key_data + s->key_len + 4, nals[n].data, nals[n].len);
+        s->key_len += 4 + nals[n].len;
+
+        uint8_t type = nals[n].data[0] & 0x1F;
+        if (type == H264_NAL_SPS && nals[n].len <= RTP_SPS_PPS_MAX) {
+            memcpy(s->sps, nals[n].data, nals[n].len);
+            s->sps_len = nals[n].len;
+        } else if (type == H264_NAL_PPS && nals[n].len <= RTP_SPS_PPS_MAX) {
+            memcpy(s->pps, nals[n].data, nals[n].len);
+            s->pps_len = nals[n].len;
+        }
+    }
+    s->key_pts = pts;
+}
+
+int rtp_stream_init(const ot_venc_chn chns[RTP_STREAM_COUNT])
+{
+    pthread_mutex_lock(&g_rtp.lock);
+    for (int i = 0; i < RTP_STREAM_COUNT; i++) {
+        memset(&g_rtp.streams[i], 0, sizeof(g_rtp.streams[i]));
+        g_rtp.streams[i].chn = chns[i];
+    }
+    for (int i = 0; i < RTP_MAX_VIEWERS; i++) {
+        memset(&g_rtp.viewers[i], 0, sizeof(g_rtp.viewers[i]));
+        g_rtp.viewers[i].fd = -1;
+    }
+    g_rtp.next_id = 1;
+
+    // Feedback is optional: without the socket viewers are only paced by local send drops
+    g_rtp.rtcp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = 0
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (g_rtp.rtcp_fd < 0 || bind(g_rtp.rtcp_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        getsockname(g_rtp.rtcp_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+        printf("RTCP socket failed: %d, viewer feedback disabled\n", errno);
+        if (g_rtp.rtcp_fd >= 0) {
+            close(g_rtp.rtcp_fd);
+        }
+        g_rtp.rtcp_fd = -1;
+        g_rtp.rtcp_port = 0;
+    } else {
+        g_rtp.rtcp_port = ntohs(addr.sin_port);
+        printf("RTCP feedback on port %u\n", g_rtp.rtcp_port);
+    }
+
+    g_rtp.initialized = 1;
+    pthread_mutex_unlock(&g_rtp.lock);
+    return 0;
+}
+
+void rtp_stream_deinit(void)
+{
+    pthread_mutex_lock(&g_rtp.lock);
+    for (int i = 0; i < RTP_MAX_VIEWERS; i++) {
+        if (g_rtp.viewers[i].used) {
+            rtp_close_viewer(&g_rtp.viewers[i], "shutdown");
+        }
+    }
+    for (int i = 0; i < RTP_STREAM_COUNT; i++) {
+        free(g_rtp.streams[i].key_data);
+        memset(&g_rtp.streams[i], 0, sizeof(g_rtp.streams[i]));
+    }
+    free(g_rtp.packets);
+    g_rtp.packets = NULL;
+    g_rtp.packet_cap = 0;
+    if (g_rtp.rtcp_fd >= 0) {
+        close(g_rtp.rtcp_fd);
+        g_rtp.rtcp_fd = -1;
+        g_rtp.rtcp_port = 0;
+    }
+    g_rtp.initialized = 0;
+    pthread_mutex_unlock(&g_rtp.lock);
+}
+
+int rtp_stream_index(const char* name)
+{
+    for (int i = 0; i < RTP_STREAM_COUNT; i++) {
+        if (strcmp(name, g_stream_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* rtp_stream_name(int stream)
+{
+    return stream >= 0 && stream < RTP_STREAM_COUNT ? g_stream_names[stream] : "unknown";
+}
+
+int rtp_viewer_add(int stream, const struct sockaddr_in* dst, uint32_t* viewer_id)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT || !dst) {
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        printf("RTP socket failed: %d\n", errno);
+        return -1;
+    }
+    int sndbuf = RTP_SOCKET_SNDBUF;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    if (connect(fd, (const struct sockaddr*)dst, sizeof(*dst)) != 0) {
+        printf("RTP connect failed: %d\n", errno);
+        close(fd);
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_rtp.lock);
+    RtpViewer* v = NULL;
+    for (int i = 0; i < RTP_MAX_VIEWERS && g_rtp.initialized; i++) {
+        if (!g_rtp.viewers[i].used) {
+            v = &g_rtp.viewers[i];
+            break;
+        }
+    }
+    if (!v) {
+        pthread_mutex_unlock(&g_rtp.lock);
+        close(fd);
+        printf("RTP viewer table full\n");
+        return -1;
+    }
+
+    v->used = 1;
+    v->id = g_rtp.next_id++;
+    v->stream = stream;
+    v->fd = fd;
+    v->dst = *dst;
+    v->seq = (uint16_t)rtp_random32();
+    v->ssrc = rtp_random32();
+    v->ts_offset = rtp_random32();
+    v->live = 0;
+    v->ceiling = stream;
+    v->packets = 0;
+    v->drops = 0;
+    v->eval_drops = 0;
+    v->est_bps = g_rtp.streams[stream].rate_bps ? g_rtp.streams[stream].rate_bps : g_rtp.streams[stream].max_bps;
+    v->loss_q8 = 0;
+    v->remb_bps = 0;
+    v->remb_ms = 0;
+    v->active_ms = rtp_now_ms();
+    v->low_evals = 0;
+    v->high_evals = 0;
+    if (viewer_id) {
+        *viewer_id = v->id;
+    }
+
+    // Show the cached keyframe at once; live frames resume at the requested IDR
+    RtpStreamState* s = &g_rtp.streams[stream];
+    if (s->key_len > 0) {
+        RtpNal nals[RTP_MAX_NALS];
+        size_t count = rtp_split_nals(s->key_data, s->key_len, nals, RTP_MAX_NALS, 0);
+        if (rtp_packetize(nals, count) == 0) {
+            rtp_send_viewer(v, rtp_timestamp(s->key_pts));
+        }
+    }
+    rtp_request_idr(stream);
+    printf("RTP viewer %u added: %s -> %s:%d\n", v->id, g_stream_names[stream],
+           inet_ntoa(dst->sin_addr), ntohs(dst->sin_port));
+    pthread_mutex_unlock(&g_rtp.lock);
+    return 0;
+}
+
+int rtp_viewer_remove(uint32_t viewer_id)
+{
+    int ret = -1;
+    pthread_mutex_lock(&g_rtp.lock);
+    for (int i = 0; i < RTP_MAX_VIEWERS; i++) {
+        if (g_rtp.viewers[i].used && g_rtp.viewers[i].id == viewer_id) {
+            rtp_close_viewer(&g_rtp.viewers[i], "stopped");
+            ret = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_rtp.lock);
+    return ret;
+}
+
+static size_t rtp_base64(const uint8_t* in, size_t len, char* out, size_t size)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint32_t)in[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            v |= in[i + 2];
+        }
+        if (o + 4 >= size) {
+            break;
+        }
+        out[o++] = table[(v >> 18) & 0x3F];
+        out[o++] = table[(v >> 12) & 0x3F];
+        out[o++] = i + 1 < len ? table[(v >> 6) & 0x3F] : '=';
+        out[o++] = i + 2 < len ? table[v & 0x3F] : '=';
+    }
+    out[o] = '\0';
+    return o;
+}
+
+int rtp_stream_sprop(int stream, char* out, size_t size)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT || size == 0) {
+        return -1;
+    }
+    int ret = -1;
+    pthread_mutex_lock(&g_rtp.lock);
+    RtpStreamState* s = &g_rtp.streams[stream];
+    if (s->sps_len > 0 && s->pps_len > 0) {
+        size_t n = rtp_base64(s->sps, s->sps_len, out, size);
+        if (n + 2 < size) {
+            out[n++] = ',';
+            rtp_base64(s->pps, s->pps_len, out + n, size - n);
+            ret = 0;
+        }
+    }
+    pthread_mutex_unlock(&g_rtp.lock);
+    return ret;
+}
+
+void rtp_stream_send(int stream, const ot_venc_stream* venc_stream)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT || !venc_stream || venc_stream->pack_cnt == 0) {
+        return;
+    }
+
+    RtpNal nals[RTP_MAX_NALS];
+    size_t nal_count = 0;
+    for (td_u32 i = 0; i < venc_stream->pack_cnt; i++) {
+        const ot_venc_pack* pack = &venc_stream->pack[i];
+        nal_count = rtp_split_nals(pack->addr + pack->offset, pack->len - pack->offset,
+                                   nals, RTP_MAX_NALS, nal_count);
+    }
+    int key = 0;
+    for (size_t n = 0; n < nal_count; n++) {
+        if ((nals[n].data[0] & 0x1F) == H264_NAL_IDR) {
+            key = 1;
+            break;
+        }
+    }
+    uint64_t pts = venc_stream->pack[0].pts;
+
+    pthread_mutex_lock(&g_rtp.lock);
+    if (!g_rtp.initialized) {
+        pthread_mutex_unlock(&g_rtp.lock);
+        return;
+    }
+    RtpStreamState* s = &g_rtp.streams[stream];
+    if (key) {
+        rtp_cache_keyframe(s, nals, nal_count, pts);
+    }
+
+    int packetized = 0;
+    for (int i = 0; i < RTP_MAX_VIEWERS; i++) {
+        RtpViewer* v = &g_rtp.viewers[i];
+        if (!v->used || v->stream != stream) {
+            continue;
+        }
+        if (!v->live) {
+            if (!key) {
+                continue;
+            }
+            v->live = 1;
+        }
+        if (!packetized) {
+            if (rtp_packetize(nals, nal_count) != 0) {
+                break;
+            }
+            packetized = 1;
+        }
+        rtp_send_viewer(v, rtp_timestamp(pts));
+    }
+    pthread_mutex_unlock(&g_rtp.lock);
+}
+
+void rtp_stream_set_limits(int stream, uint32_t min_bps, uint32_t max_bps)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT) {
+        return;
+    }
+    pthread_mutex_lock(&g_rtp.lock);
+    g_rtp.streams[stream].min_bps = min_bps;
+    g_rtp.streams[stream].max_bps = max_bps;
+    for (int i = 0; i < RTP_MAX_VIEWERS; i++) {
+        RtpViewer* v = &g_rtp.viewers[i];
+        if (v->used && v->stream == stream && v->est_bps > max_bps) {
+            v->est_bps = max_bps;
+        }
+    }
+    pthread_mutex_unlock(&g_rtp.lock);
+}
+
+void rtp_stream_set_rate(int stream, uint32_t bps)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT) {
+        return;
+    }
+    pthread_mutex_lock(&g_rtp.lock);
+    g_rtp.streams[stream].rate_bps = bps;
+    pthread_mutex_unlock(&g_rtp.lock);
+}
+
+void rtp_stream_reset(int stream)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT) {
+        return;
+    }
+    pthread_mutex_lock(&g_rtp.lock);
+    g_rtp.streams[stream].key_len = 0;
+    pthread_mutex_unlock(&g_rtp.lock);
+}
+
+int rtp_rtcp_fd(void)
+{
+    return g_rtp.rtcp_fd;
+}
+
+uint16_t rtp_rtcp_port(void)
+{
+    return g_rtp.rtcp_port;
+}
+
+static uint32_t rtcp_read32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/*
+ * Viewer whose media SSRC is ssrc; feedback is only accepted from that
+ * viewer's host. Any such packet shows the receiver is still there.
+ */
+static RtpViewer* rtcp_find_viewer(uint32_t ssrc, const struct sockaddr_in* from)
+{
+    for (int i = 0; i < RTP_MAX_VIEWERS; i++) {
+        RtpViewer* v = &g_rtp.viewers[i];
+        if (v->used && v->ssrc == ssrc && v->dst.sin_addr.s_addr == from->sin_addr.s_addr) {
+            v->active_ms = rtp_now_ms();
+            return v;
+        }
+    }
+    return NULL;
+}
+
+/* Report blocks of an SR or RR: fraction lost is smoothed per viewer */
+static void rtcp_report_blocks(const uint8_t* p, size_t len, int count, const struct sockaddr_in* from)
+{
+    for (int i = 0; i < count && len >= 24; i++, p += 24, len -= 24) {
+        RtpViewer* v = rtcp_find_viewer(rtcp_read32(p), from);
+        if (v) {
+            v->loss_q8 = (v->loss_q8 * 3 + p[4]) / 4;
+        }
+    }
+}
+
+/* One RTCP packet of a compound datagram; len covers the common header */
+static void rtcp_handle_packet(const uint8_t* p, size_t len, const struct sockaddr_in* from)
+{
+    int fmt = p[0] & 0x1F;
+    int pt = p[1];
+    if (pt == RTCP_PT_SR && len >= 28) {
+        rtcp_report_blocks(p + 28, len - 28, fmt, from);
+    } else if (pt == RTCP_PT_RR && len >= 8) {
+        rtcp_report_blocks(p + 8, len - 8, fmt, from);
+    } else if (pt == RTCP_PT_PSFB && fmt == RTCP_FMT_PLI && len >= 12) {
+        RtpViewer* v = rtcp_find_viewer(rtcp_read32(p + 8), from);
+        if (v) {
+            rtp_request_idr(v->stream);
+        }
+    } else if (pt == RTCP_PT_PSFB && fmt == RTCP_FMT_FIR) {
+        // FCI entries: SSRC, sequence number, 3 reserved bytes
+        for (size_t off = 12; off + 8 <= len; off += 8) {
+            RtpViewer* v = rtcp_find_viewer(rtcp_read32(p + off), from);
+            if (v) {
+                rtp_request_idr(v->stream);
+            }
+        }
+    } else if (pt == RTCP_PT_PSFB && fmt == RTCP_FMT_AFB && len >= 20 && memcmp(p + 12, "REMB", 4) == 0) {
+        // Num SSRC (8 bits), BR Exp (6 bits), BR Mantissa (18 bits), then the SSRC list
+        int num = p[16];
+        int exp = p[17] >> 2;
+        uint64_t bps = (uint64_t)(((uint32_t)(p[17] & 0x03) << 16) | (uint32_t)p[18] << 8 | p[19]) << exp;
+        uint32_t capped = bps > UINT32_MAX ? UINT32_MAX : (uint32_t)bps;
+        uint64_t now = rtp_now_ms();
+        for (int i = 0; i < num && 20 + (size_t)(i + 1) * 4 <= len; i++) {
+            RtpViewer* v = rtcp_find_viewer(rtcp_read32(p + 20 + i * 4), from);
+            if (v) {
+                v->remb_bps = capped;
+                v->remb_ms = now;
+            }
+        }
+    }
+    // Generic NACK (RTPFB) is not answered: nothing is kept for retransmission
+}
+
+void rtp_rtcp_receive(void)
+{
+    uint8_t buf[RTCP_MAX_PACKET];
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(g_rtp.rtcp_fd, buf, sizeof(buf), 0, (struct sockaddr*)&from, &from_len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        pthread_mutex_lock(&g_rtp.lock);
+        size_t off = 0;
+        while (off + 4 <= (size_t)n && (buf[off] >> 6) == 2) {
+            size_t len = ((size_t)(buf[off + 2] << 8 | buf[off + 3]) + 1) * 4;
+            if (off + len > (size_t)n) {
+                break;
+            }
+            rtcp_handle_packet(buf + off, len, &from);
+            off += len;
+        }
+        pthread_mutex_unlock(&g_rtp.lock);
+    }
+}
+
+/* Move a viewer to another stream; it resumes at that stream's next IDR */
+static void rtp_switch_viewer(RtpViewer* v, int stream, uint32_t est_bps)
+{
+    printf("RTP viewer %u switched %s -> %s (estimate %u bps, loss %u/256)\n", v->id,
+           g_stream_names[v->stream], g_stream_names[stream], v->est_bps, v->loss_q8);
+    v->stream = stream;
+    v->live = 0;
+    v->est_bps = est_bps;
+    v->low_evals = 0;
+    v->high_evals = 0;
+    rtp_request_idr(stream);
+}
+
+/* Loss-based estimate, capped by a recent REMB and by the stream's ceiling */
+static void rtp_update_estimate(RtpViewer* v, uint64_t now)
+{
+    const RtpStreamState* s = &g_rtp.streams[v->stream];
+    uint64_t est = v->est_bps;
+    uint64_t dropped = v->drops - v->eval_drops;
+    v->eval_drops = v->drops;
+
+    if (dropped > 0) {
+        est = est * RTP_DROP_DECREASE_PCT / 100;
+    } else if (v->loss_q8 > RTP_LOSS_HIGH_Q8) {
+        est = est * (512 - v->loss_q8) / 512;
+    } else if (v->loss_q8 < RTP_LOSS_LOW_Q8) {
+        est = est * (100 + RTP_RATE_INCREASE_PCT) / 100;
+    }
+    if (v->remb_ms != 0 && now - v->remb_ms < RTP_FEEDBACK_STALE_MS && est > v->remb_bps) {
+        est = v->remb_bps;
+    }
+    if (s->max_bps != 0 && est > s->max_bps) {
+        est = s->max_bps;
+    }
+    v->est_bps = (uint32_t)est;
+}
+
+void rtp_stream_evaluate(RtpStreamFeedback out[RTP_STREAM_COUNT])
+{
+    memset(out, 0, sizeof(RtpStreamFeedback) * RTP_STREAM_COUNT);
+
+    // Taken under the lock so no feedback time recorded meanwhile lies ahead of it
+    pthread_mutex_lock(&g_rtp.lock);
+    uint64_t now = rtp_now_ms();
+    for (int i = 0; i < RTP_MAX_VIEWERS; i++) {
+        RtpViewer* v = &g_rtp.viewers[i];
+        if (!v->used) {
+            continue;
+        }
+        // Without the RTCP socket there is no liveness signal; such viewers stay until stopped
+        if (g_rtp.rtcp_fd < 0) {
+            v->active_ms = now;
+        } else if (now - v->active_ms >= RTP_VIEWER_TIMEOUT_MS) {
+            rtp_close_viewer(v, "no receiver reports");
+            continue;
+        }
+        rtp_update_estimate(v, now);
+
+        // Streams are ordered main, mid, sub: a higher index is a lower rendition.
+        // Streams without limits were not set up and are skipped over.
+        const RtpStreamState* s = &g_rtp.streams[v->stream];
+        int lower = v->stream + 1;
+        while (lower < RTP_STREAM_COUNT && g_rtp.streams[lower].max_bps == 0) {
+            lower++;
+        }
+        int upper = v->stream - 1;
+        while (upper >= 0 && g_rtp.streams[upper].max_bps == 0) {
+            upper--;
+        }
+        v->low_evals = v->est_bps < s->min_bps ? v->low_evals + 1 : 0;
+        v->high_evals = v->est_bps >= s->max_bps && v->loss_q8 < RTP_LOSS_LOW_Q8 ? v->high_evals + 1 : 0;
+        if (lower < RTP_STREAM_COUNT && v->low_evals >= RTP_SWITCH_DOWN_EVALS) {
+            const RtpStreamState* l = &g_rtp.streams[lower];
+            rtp_switch_viewer(v, lower, v->est_bps < l->max_bps ? v->est_bps : l->max_bps);
+        } else if (upper >= v->ceiling && v->high_evals >= RTP_SWITCH_UP_EVALS) {
+            // Start the probe at the upper stream's floor so its other viewers are not pulled far down
+            const RtpStreamState* u = &g_rtp.streams[upper];
+            uint32_t probe = u->rate_bps < u->min_bps * 3 / 2 ? u->rate_bps : u->min_bps * 3 / 2;
+            rtp_switch_viewer(v, upper, probe > u->min_bps ? probe : u->min_bps);
+        }
+
+        RtpStreamFeedback* f = &out[v->stream];
+        if (f->viewers == 0 || v->est_bps < f->target_bps) {
+            f->target_bps = v->est_bps;
+        }
+        if (v->loss_q8 > f->loss_q8) {
+            f->loss_q8 = v->loss_q8;
+        }
+        if (v->active_ms > f->active_ms) {
+            f->active_ms = v->active_ms;
+        }
+        f->viewers++;
+    }
+    pthread_mutex_unlock(&g_rtp.lock);
+}
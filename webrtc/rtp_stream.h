@@ -0,0 +1,110 @@
+/*
+ * RTP (RFC 6184) sender for the H.264 VENC channels.
+ *
+ * Packets are built straight from the ot_venc_stream packs: every RTP
+ * packet is a two-element iovec (header, slice of the pack), so the
+ * bitstream is never copied on the live path. Each viewer owns a
+ * connected non-blocking UDP socket, which gives it its own kernel send
+ * queue; a viewer whose queue overflows drops to "wait for IDR" instead
+ * of stalling the others.
+ *
+ * The last IDR access unit of each stream is cached so a new viewer gets
+ * a decodable picture immediately, and an IDR is requested so its live
+ * stream resynchronises on the next frame.
+ *
+ * Receivers report back on one shared RTCP socket (advertised with
+ * a=rtcp in the answer). Packets are matched to viewers by their media
+ * SSRC: receiver reports feed a smoothed loss fraction, REMB caps the
+ * viewer's estimate and PLI/FIR request an IDR. rtp_stream_evaluate()
+ * turns that feedback into a per-viewer bitrate estimate, moves viewers
+ * whose estimate stays below a stream's floor to the next lower stream
+ * (and back up, never above the stream they asked for), and returns the
+ * per-stream figures the encoder is tuned to. A viewer nothing has been
+ * heard from for RTP_VIEWER_TIMEOUT_MS (a closed player sends no more
+ * receiver reports) is removed there as well.
+ *
+ * All functions are thread-safe; rtp_stream_send() is called from the
+ * VENC stream thread while the stream's packs are still held.
+ */
+
+#ifndef RTP_STREAM_H
+#define RTP_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "ot_common_venc.h"
+
+#define RTP_STREAM_COUNT 3          // main, mid, sub
+#define RTP_MAX_VIEWERS 8
+#define RTP_PAYLOAD_TYPE 96
+#define RTP_MAX_PAYLOAD 1200        // keeps IP + UDP + RTP + FU-A under a 1500 byte MTU
+
+/* Feedback summary of one stream, produced by rtp_stream_evaluate() */
+typedef struct {
+    int viewers;                    // viewers currently on the stream
+    uint32_t target_bps;            // lowest viewer estimate, 0 without viewers
+    uint32_t loss_q8;               // worst smoothed loss fraction, 1/256 units
+    uint64_t active_ms;             // latest RTCP from any viewer (CLOCK_MONOTONIC ms), 0 without viewers
+} RtpStreamFeedback;
+
+/* Set up the sender; chns maps stream index (main, mid, sub) to its VENC channel */
+int rtp_stream_init(const ot_venc_chn chns[RTP_STREAM_COUNT]);
+
+/* Remove every viewer and free the keyframe caches */
+void rtp_stream_deinit(void);
+
+/* "main" / "mid" / "sub" to stream index, -1 if unknown */
+int rtp_stream_index(const char* name);
+
+const char* rtp_stream_name(int stream);
+
+/*
+ * Start sending stream to dst. The cached keyframe is sent right away.
+ * Returns 0 and the new viewer id, or -1 if the table is full or the
+ * socket could not be created.
+ */
+int rtp_viewer_add(int stream, const struct sockaddr_in* dst, uint32_t* viewer_id);
+
+/* Stop a viewer; returns -1 if the id is unknown */
+int rtp_viewer_remove(uint32_t viewer_id);
+
+/*
+ * Base64 SPS and PPS of stream for the SDP sprop-parameter-sets
+ * attribute ("<sps>,<pps>"). Returns -1 before the first IDR.
+ */
+int rtp_stream_sprop(int stream, char* out, size_t size);
+
+/* Packetize one H.264 frame and send it to every viewer of stream */
+void rtp_stream_send(int stream, const ot_venc_stream* venc_stream);
+
+/*
+ * Bitrate range of stream. Viewers whose estimate stays below min_bps
+ * move to the next lower stream; estimates never exceed max_bps.
+ */
+void rtp_stream_set_limits(int stream, uint32_t min_bps, uint32_t max_bps);
+
+/* Bitrate the encoder currently produces for stream; new viewers start from it */
+void rtp_stream_set_rate(int stream, uint32_t bps);
+
+/* Forget the cached keyframe, e.g. after the stream's channel was stopped */
+void rtp_stream_reset(int stream);
+
+/* Non-blocking RTCP socket to poll for input, -1 if it could not be opened */
+int rtp_rtcp_fd(void);
+
+/* Local port of the RTCP socket, 0 if there is none */
+uint16_t rtp_rtcp_port(void);
+
+/* Read and apply every pending RTCP packet */
+void rtp_rtcp_receive(void);
+
+/*
+ * Update every viewer's estimate from the feedback gathered since the
+ * last call, switch viewers between streams, and fill out[] per stream.
+ * Call about once a second.
+ */
+void rtp_stream_evaluate(RtpStreamFeedback out[RTP_STREAM_COUNT]);
+
+#endif // RTP_STREAM_H
@@ -0,0 +1,321 @@
+#define _GNU_SOURCE
+#include "venc_ctrl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "ss_mpi_venc.h"
+#include "ss_mpi_vpss.h"
+
+#define VENC_LOSS_HIGH_Q8 26        // ~10% loss: halve the GOP so a lost reference heals sooner
+#define VENC_FPS_DROP_DIV 4         // below bitrate / 4 the frame rate is halved ...
+#define VENC_FPS_RESTORE_DIV 3      // ... and restored above bitrate / 3
+#define VENC_RATE_STEP_PCT 5        // smaller bitrate changes are not applied
+
+typedef struct {
+    VencStreamConfig cfg;
+    uint32_t src_fps;               // VPSS output rate, the ceiling for cfg.fps
+    int running;
+    uint64_t last_viewer_ms;        // channel start or latest sign of life from one of its viewers
+    int viewers;
+    uint32_t loss_q8;
+    int fps_reduced;
+    // What the channel is currently set to
+    uint32_t bitrate;
+    uint32_t fps;
+    uint32_t gop;
+} VencStream;
+
+static struct {
+    pthread_mutex_t lock;
+    int initialized;
+    uint64_t eval_ms;
+    VencStream streams[RTP_STREAM_COUNT];
+} g_venc = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static uint64_t venc_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Apply rate control settings to a created channel, running or not */
+static int venc_apply(int stream, uint32_t bitrate, uint32_t fps, uint32_t gop)
+{
+    VencStream* s = &g_venc.streams[stream];
+    if (bitrate == s->bitrate && fps == s->fps && gop == s->gop) {
+        return 0;
+    }
+
+    ot_venc_chn_attr attr;
+    int ret = ss_mpi_venc_get_chn_attr(s->cfg.chn, &attr);
+    if (ret != 0) {
+        printf("ss_mpi_venc_get_chn_attr(%s) failed: %#x\n", rtp_stream_name(stream), ret);
+        return -1;
+    }
+    attr.rc_attr.h264_cbr.bit_rate = bitrate;
+    attr.rc_attr.h264_cbr.src_frame_rate = s->src_fps;
+    attr.rc_attr.h264_cbr.dst_frame_rate = fps;
+    attr.rc_attr.h264_cbr.gop = gop;
+    ret = ss_mpi_venc_set_chn_attr(s->cfg.chn, &attr);
+    if (ret != 0) {
+        printf("ss_mpi_venc_set_chn_attr(%s) failed: %#x\n", rtp_stream_name(stream), ret);
+        return -1;
+    }
+
+    printf("VENC %s: %u bps, %u fps, gop %u\n", rtp_stream_name(stream), bitrate, fps, gop);
+    s->bitrate = bitrate;
+    s->fps = fps;
+    s->gop = gop;
+    rtp_stream_set_rate(stream, bitrate);
+    return 0;
+}
+
+static int venc_start(int stream, uint64_t now)
+{
+    VencStream* s = &g_venc.streams[stream];
+    if (!s->cfg.vpss_shared) {
+        int ret = ss_mpi_vpss_enable_chn(s->cfg.vpss_grp, s->cfg.vpss_chn);
+        if (ret != 0) {
+            printf("ss_mpi_vpss_enable_chn(%s) failed: %#x\n", rtp_stream_name(stream), ret);
+            return -1;
+        }
+    }
+
+    // Every start begins at the configured rate; feedback takes it from there
+    s->fps_reduced = 0;
+    venc_apply(stream, s->cfg.bitrate, s->cfg.fps, s->cfg.gop);
+
+    ot_venc_start_param start_param = {
+        .recv_pic_num = -1
+    };
+    int ret = ss_mpi_venc_start_chn(s->cfg.chn, &start_param);
+    if (ret != 0) {
+        printf("ss_mpi_venc_start_chn(%s) failed: %#x\n", rtp_stream_name(stream), ret);
+        if (!s->cfg.vpss_shared) {
+            ss_mpi_vpss_disable_chn(s->cfg.vpss_grp, s->cfg.vpss_chn);
+        }
+        return -1;
+    }
+    s->running = 1;
+    s->last_viewer_ms = now;
+    printf("VENC %s started\n", rtp_stream_name(stream));
+    return 0;
+}
+
+static void venc_stop(int stream)
+{
+    VencStream* s = &g_venc.streams[stream];
+    ss_mpi_venc_stop_chn(s->cfg.chn);
+    if (!s->cfg.vpss_shared) {
+        ss_mpi_vpss_disable_chn(s->cfg.vpss_grp, s->cfg.vpss_chn);
+    }
+    s->running = 0;
+    // The cached keyframe is stale now; the next viewer waits for the restart's IDR
+    rtp_stream_reset(stream);
+    printf("VENC %s stopped, no active viewers\n", rtp_stream_name(stream));
+}
+
+/* Fit a running channel to its slowest viewer */
+static void venc_tune(int stream, const RtpStreamFeedback* fb)
+{
+    VencStream* s = &g_venc.streams[stream];
+    const VencStreamConfig* cfg = &s->cfg;
+
+    // Viewers below the floor are moved to a lower stream, they must not starve the others meanwhile
+    uint32_t target = fb->target_bps;
+    if (target < cfg->min_bitrate) {
+        target = cfg->min_bitrate;
+    }
+    if (target > cfg->bitrate) {
+        target = cfg->bitrate;
+    }
+
+    // Fewer, better frames once the budget is a fraction of what the resolution was configured for
+    if (!s->fps_reduced && target < cfg->bitrate / VENC_FPS_DROP_DIV) {
+        s->fps_reduced = 1;
+    } else if (s->fps_reduced && target > cfg->bitrate / VENC_FPS_RESTORE_DIV) {
+        s->fps_reduced = 0;
+    }
+    uint32_t fps = s->fps_reduced && cfg->fps > 1 ? cfg->fps / 2 : cfg->fps;
+
+    // Keep the GOP duration as configured, shorter while viewers lose packets
+    uint32_t gop = cfg->gop * fps / cfg->fps;
+    if (fb->loss_q8 > VENC_LOSS_HIGH_Q8) {
+        gop /= 2;
+    }
+    if (gop < 1) {
+        gop = 1;
+    }
+
+    uint32_t bitrate = s->bitrate;
+    uint32_t step = s->bitrate / 100 * VENC_RATE_STEP_PCT;
+    if (target > bitrate + step || target + step < bitrate || target == cfg->bitrate || target == cfg->min_bitrate) {
+        bitrate = target;
+    }
+    venc_apply(stream, bitrate, fps, gop);
+}
+
+int venc_ctrl_init(const VencStreamConfig cfg[RTP_STREAM_COUNT])
+{
+    pthread_mutex_lock(&g_venc.lock);
+    for (int i = 0; i < RTP_STREAM_COUNT; i++) {
+        VencStream* s = &g_venc.streams[i];
+        memset(s, 0, sizeof(*s));
+        s->cfg = cfg[i];
+        s->src_fps = cfg[i].fps;
+        if (!cfg[i].enabled) {
+            rtp_stream_set_limits(i, 0, 0);
+            continue;
+        }
+        // The channel was created with the configured attributes
+        s->bitrate = cfg[i].bitrate;
+        s->fps = cfg[i].fps;
+        s->gop = cfg[i].gop;
+        rtp_stream_set_limits(i, cfg[i].min_bitrate, cfg[i].bitrate);
+        rtp_stream_set_rate(i, cfg[i].bitrate);
+        // init_vpss enabled every channel; idle ones stay off until a viewer arrives
+        if (!cfg[i].vpss_shared) {
+            ss_mpi_vpss_disable_chn(cfg[i].vpss_grp, cfg[i].vpss_chn);
+        }
+    }
+    g_venc.eval_ms = venc_now_ms();
+    g_venc.initialized = 1;
+    pthread_mutex_unlock(&g_venc.lock);
+    return 0;
+}
+
+void venc_ctrl_deinit(void)
+{
+    pthread_mutex_lock(&g_venc.lock);
+    for (int i = 0; i < RTP_STREAM_COUNT && g_venc.initialized; i++) {
+        if (g_venc.streams[i].running) {
+            venc_stop(i);
+        }
+    }
+    g_venc.initialized = 0;
+    pthread_mutex_unlock(&g_venc.lock);
+}
+
+int venc_ctrl_acquire(int stream)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT) {
+        return -1;
+    }
+    int ret = 0;
+    uint64_t now = venc_now_ms();
+    pthread_mutex_lock(&g_venc.lock);
+    if (!g_venc.initialized || !g_venc.streams[stream].cfg.enabled) {
+        ret = -1;
+    } else if (!g_venc.streams[stream].running) {
+        ret = venc_start(stream, now);
+    } else {
+        g_venc.streams[stream].last_viewer_ms = now;
+    }
+    pthread_mutex_unlock(&g_venc.lock);
+    return ret;
+}
+
+void venc_ctrl_tick(uint64_t now_ms)
+{
+    pthread_mutex_lock(&g_venc.lock);
+    if (!g_venc.initialized || now_ms - g_venc.eval_ms < VENC_CTRL_EVAL_MS) {
+        pthread_mutex_unlock(&g_venc.lock);
+        return;
+    }
+    g_venc.eval_ms = now_ms;
+
+    RtpStreamFeedback fb[RTP_STREAM_COUNT];
+    rtp_stream_evaluate(fb);
+    for (int i = 0; i < RTP_STREAM_COUNT; i++) {
+        VencStream* s = &g_venc.streams[i];
+        s->viewers = fb[i].viewers;
+        s->loss_q8 = fb[i].loss_q8;
+
+        // A viewer counts while it keeps reporting, not for as long as it has a slot
+        uint64_t active_ms = fb[i].active_ms < now_ms ? fb[i].active_ms : now_ms;
+        int live = fb[i].viewers > 0 && now_ms - active_ms < VENC_CTRL_LINGER_MS;
+        if (live) {
+            // Also starts streams that viewers were switched onto
+            if (!s->running && venc_start(i, now_ms) != 0) {
+                continue;
+            }
+            if (active_ms > s->last_viewer_ms) {
+                s->last_viewer_ms = active_ms;
+            }
+            venc_tune(i, &fb[i]);
+        } else if (s->running && now_ms - s->last_viewer_ms >= VENC_CTRL_LINGER_MS) {
+            venc_stop(i);
+        }
+    }
+    pthread_mutex_unlock(&g_venc.lock);
+}
+
+int venc_ctrl_configure(int stream, uint32_t bitrate, uint32_t fps, uint32_t gop)
+{
+    if (stream < 0 || stream >= RTP_STREAM_COUNT) {
+        return -1;
+    }
+    pthread_mutex_lock(&g_venc.lock);
+    VencStream* s = &g_venc.streams[stream];
+    VencStreamConfig cfg = s->cfg;
+    if (bitrate != 0) {
+        cfg.bitrate = bitrate;
+    }
+    if (fps != 0) {
+        cfg.fps = fps;
+    }
+    if (gop != 0) {
+        cfg.gop = gop;
+    }
+    if (!g_venc.initialized || !cfg.enabled || cfg.fps > s->src_fps || cfg.bitrate < cfg.min_bitrate) {
+        pthread_mutex_unlock(&g_venc.lock);
+        return -1;
+    }
+    s->cfg = cfg;
+    rtp_stream_set_limits(stream, cfg.min_bitrate, cfg.bitrate);
+    // A stopped channel picks the new values up when it starts
+    int ret = 0;
+    if (s->running) {
+        s->fps_reduced = 0;
+        ret = venc_apply(stream, cfg.bitrate, cfg.fps, cfg.gop);
+    }
+    pthread_mutex_unlock(&g_venc.lock);
+    return ret;
+}
+
+size_t venc_ctrl_status_json(char* out, size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    size_t n = 0;
+    out[n++] = '[';
+    pthread_mutex_lock(&g_venc.lock);
+    for (int i = 0; i < RTP_STREAM_COUNT && n < size; i++) {
+        const VencStream* s = &g_venc.streams[i];
+        int len = snprintf(out + n, size - n,
+            "%s{\"stream\":\"%s\",\"running\":%s,\"viewers\":%d,\"bitrate\":%u,\"fps\":%u,\"gop\":%u,"
+            "\"max_bitrate\":%u,\"min_bitrate\":%u,\"max_fps\":%u,\"loss\":%.3f}",
+            i ? "," : "", rtp_stream_name(i), s->running ? "true" : "false", s->viewers,
+            s->bitrate, s->fps, s->gop, s->cfg.bitrate, s->cfg.min_bitrate, s->cfg.fps,
+            s->loss_q8 / 256.0);
+        if (len < 0) {
+            break;
+        }
+        n += (size_t)len;
+    }
+    pthread_mutex_unlock(&g_venc.lock);
+    if (n + 2 > size) {
+        out[size - 1] = '\0';
+        return size - 1;
+    }
+    out[n++] = ']';
+    out[n] = '\0';
+    return n;
+}
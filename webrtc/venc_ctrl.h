@@ -0,0 +1,70 @@
+/*
+ * On-demand H.264 channels with viewer-driven rate control.
+ *
+ * The three H.264 channels are created at startup but only encode while
+ * someone watches: a channel starts when its first viewer joins (the
+ * first picture of a started channel is an IDR) and stops once none of
+ * its viewers has sent RTCP for VENC_CTRL_LINGER_MS, whether or not they
+ * still hold a viewer slot. A stream whose VPSS channel feeds nothing
+ * else has that channel disabled while stopped too.
+ *
+ * Once a second the RTP feedback (rtp_stream_evaluate) sets each running
+ * channel's bitrate to its slowest viewer's estimate, halves the frame
+ * rate when that falls far below the configured bitrate, and shortens
+ * the GOP while viewers report heavy loss. Changes are applied with
+ * ss_mpi_venc_set_chn_attr on the running channel.
+ *
+ * Streams not enabled at startup have no channel; they are reported with
+ * zero limits to rtp_stream so viewers are never switched onto them.
+ *
+ * All functions are thread-safe.
+ */
+
+#ifndef VENC_CTRL_H
+#define VENC_CTRL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ot_common_venc.h"
+#include "ot_common_vpss.h"
+#include "rtp_stream.h"
+
+#define VENC_CTRL_LINGER_MS 15000   // keep encoding this long after the last viewer report (RTCP every <= 7.5 s)
+#define VENC_CTRL_EVAL_MS 1000
+
+typedef struct {
+    ot_venc_chn chn;
+    ot_vpss_grp vpss_grp;
+    ot_vpss_chn vpss_chn;
+    int vpss_shared;                // VPSS channel also feeds another consumer, never disabled
+    int enabled;                    // 0: channel was not created, viewers are never put on it
+    uint32_t bitrate;               // configured (highest) bitrate
+    uint32_t min_bitrate;           // viewers estimated below this move to the next lower stream
+    uint32_t fps;                   // configured (highest) frame rate, also the VPSS rate
+    uint32_t gop;                   // GOP in frames at the configured frame rate
+} VencStreamConfig;
+
+/* Take over the created, not yet started, H.264 channels */
+int venc_ctrl_init(const VencStreamConfig cfg[RTP_STREAM_COUNT]);
+
+/* Stop every running channel */
+void venc_ctrl_deinit(void);
+
+/* Make sure stream is encoding, e.g. right after a viewer joined */
+int venc_ctrl_acquire(int stream);
+
+/* Start/stop channels and apply feedback; call every few hundred ms */
+void venc_ctrl_tick(uint64_t now_ms);
+
+/*
+ * Change the configured bitrate, frame rate or GOP of stream at runtime;
+ * 0 keeps the current value. Returns -1 for an unknown stream or a value
+ * out of range.
+ */
+int venc_ctrl_configure(int stream, uint32_t bitrate, uint32_t fps, uint32_t gop);
+
+/* JSON array describing every stream's state, returns its length */
+size_t venc_ctrl_status_json(char* out, size_t size);
+
+#endif // VENC_CTRL_H